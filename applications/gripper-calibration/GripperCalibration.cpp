@@ -17,8 +17,11 @@ http://www.cisst.org/cisst/license.txt.
 */
 
 // system
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <limits>
+#include <vector>
 
 // cisst/saw
 #include <cisstCommon/cmnPath.h>
@@ -28,11 +31,68 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstCommon/cmnXMLPath.h>
 #include <cisstCommon/cmnCommandLineOptions.h>
 #include <cisstOSAbstraction/osaSleep.h>
+#include <cisstOSAbstraction/osaGetTime.h>
 #include <sawRobotIO1394/mtsRobotIO1394.h>
 #include <sawRobotIO1394/mtsRobot1394.h>
 
 using namespace sawRobotIO1394;
 
+namespace {
+    // compute new scale and offset (in degrees, as in the XML file) so
+    // the pot values for [minRad, maxRad] using the previous scale and
+    // offset map to [0, userMaxRad]
+    void ComputeScaleOffset(const double minRad, const double maxRad,
+                            const double previousOffset, const double previousScale,
+                            const double userMaxRad,
+                            double & newScale, double & newOffset)
+    {
+        // find corresponding pot values using previous scale and offset - carefull, offsets are in degrees in the file
+        const double minVolt = (minRad - previousOffset * cmnPI / 180.0) / previousScale;
+        const double maxVolt = (maxRad - previousOffset * cmnPI / 180.0) / previousScale;
+        // compute new scale and offset to match pot -> [0, user-max]
+        newScale = (userMaxRad - 0.0) / (maxVolt - minVolt);
+        newOffset = - newScale * minVolt * 180.0 / cmnPI; // also convert back to degrees
+    }
+
+    // range using percentiles instead of min/max so a few noisy
+    // samples don't affect the calibration.  Samples are reordered.
+    void RobustRange(std::vector<double> & samples, const double outliers,
+                     double & minRad, double & maxRad)
+    {
+        const size_t last = samples.size() - 1;
+        const size_t lower = static_cast<size_t>(outliers * last);
+        const size_t upper = last - lower;
+        std::nth_element(samples.begin(), samples.begin() + lower, samples.end());
+        minRad = samples[lower];
+        std::nth_element(samples.begin() + lower, samples.begin() + upper, samples.end());
+        maxRad = samples[upper];
+    }
+
+    // number of full open/close cycles, with hysteresis so noise around
+    // the thresholds doesn't count
+    size_t CountCycles(const std::vector<double> & samples,
+                       const double minRad, const double maxRad)
+    {
+        const double low = minRad + 0.2 * (maxRad - minRad);
+        const double high = maxRad - 0.2 * (maxRad - minRad);
+        size_t cycles = 0;
+        bool opened = false;
+        bool closed = false;
+        for (const double value : samples) {
+            if (value > high) {
+                opened = true;
+            } else if (value < low) {
+                if (opened && closed) {
+                    ++cycles;
+                    opened = false;
+                }
+                closed = true;
+            }
+        }
+        return cycles;
+    }
+}
+
 int main(int argc, char * argv[])
 {
     cmnCommandLineOptions options;
@@ -44,6 +104,14 @@ int main(int argc, char * argv[])
     options.AddOptionOneValue("p", "port",
                               "firewire port number(s)",
                               cmnCommandLineOptions::OPTIONAL_OPTION, &portName);
+    double streamDuration = 0.0;
+    options.AddOptionOneValue("s", "stream",
+                              "streaming mode, collect samples at full IO rate for the given duration (in seconds) while the gripper is opened and closed continuously, then save the new config file without prompts",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &streamDuration);
+    double userMaxDeg = 60.0;
+    options.AddOptionOneValue("m", "max",
+                              "desired max for the gripper in degrees, only used in streaming mode (default is 60)",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &userMaxDeg);
     std::string errorMessage;
     if (!options.Parse(argc, argv, errorMessage)) {
         std::cerr << "Error: " << errorMessage << std::endl;
@@ -97,6 +165,66 @@ int main(int argc, char * argv[])
         std::cerr << "Caught exception: " << e.what() << std::endl;
     }
 
+    if (streamDuration > 0.0) {
+        std::cout << std::endl
+                  << "Streaming mode, collecting data for " << streamDuration << " seconds." << std::endl
+                  << "Fully open and close the gripper up to the second spring on the MTM continuously, at least 3 times." << std::endl
+                  << "NOTE: It is very important to not close the gripper all the way; stop when you feel some resistance from the second spring." << std::endl
+                  << "Press any key to start." << std::endl;
+        cmnGetChar();
+
+        // sample as fast as the IO allows, no display while collecting
+        std::vector<double> samples;
+        samples.reserve(static_cast<size_t>(streamDuration * 20000.0));
+        const double startTime = osaGetTime();
+        while ((osaGetTime() - startTime) < streamDuration) {
+            port->Read();
+            samples.push_back(robot->PotPosition().at(0));
+        }
+        const double elapsed = osaGetTime() - startTime;
+        if (samples.size() < 100) {
+            std::cerr << "Error: only collected " << samples.size() << " samples." << std::endl;
+            delete port;
+            return -1;
+        }
+
+        std::vector<double> sorted(samples);
+        double minRad, maxRad;
+        RobustRange(sorted, 0.001, minRad, maxRad);
+        const size_t cycles = CountCycles(samples, minRad, maxRad);
+        std::cout << "Status: collected " << samples.size() << " samples ("
+                  << std::fixed << std::setprecision(0) << samples.size() / elapsed << " Hz), range ["
+                  << std::setprecision(3) << minRad * cmn180_PI << ", " << maxRad * cmn180_PI
+                  << "] degrees, " << cycles << " open/close cycles." << std::endl;
+        if (cycles < 3) {
+            std::cerr << "Error: not enough open/close cycles, the gripper must be opened and closed at least 3 times." << std::endl;
+            delete port;
+            return -1;
+        }
+
+        cmnXMLPath xmlConfig;
+        xmlConfig.SetInputSource(configFile);
+        double previousOffset;
+        double previousScale;
+        const char * context = "Config";
+        xmlConfig.GetXMLValue(context, "Robot[1]/Actuator[1]/AnalogIn/VoltsToPosSI/@Offset", previousOffset);
+        xmlConfig.GetXMLValue(context, "Robot[1]/Actuator[1]/AnalogIn/VoltsToPosSI/@Scale", previousScale);
+        double newScale, newOffset;
+        ComputeScaleOffset(minRad, maxRad, previousOffset, previousScale,
+                           userMaxDeg * cmnPI / 180.0, newScale, newOffset);
+        std::cout << "Status: offset and scale in XML configuration file: " << previousOffset << " " << previousScale << std::endl
+                  << "Status: new offset and scale:                       " << newOffset << " " << newScale << std::endl;
+        xmlConfig.SetXMLValue(context, "Robot[1]/Actuator[1]/AnalogIn/VoltsToPosSI/@Offset", newOffset);
+        xmlConfig.SetXMLValue(context, "Robot[1]/Actuator[1]/AnalogIn/VoltsToPosSI/@Scale", newScale);
+        const std::string newConfigFile = configFile + "-new";
+        xmlConfig.SaveAs(newConfigFile);
+        std::cout << "Status: new config file is \"" << newConfigFile << "\"" << std::endl
+                  << "You can copy the new file over the old one using:\n  cp -i "
+                  << newConfigFile << " " << configFile << std::endl;
+        delete port;
+        return 0;
+    }
+
     std::cout << std::endl
               << "Press any key to start collecting data." << std::endl;
     cmnGetChar();
@@ -158,17 +286,12 @@ int main(int argc, char * argv[])
         xmlConfig.GetXMLValue(context, "Robot[1]/Actuator[1]/AnalogIn/VoltsToPosSI/@Scale", previousScale);
 
         // compute new offsets assuming a range [0, user-max]
-        double userMaxDeg;
         std::cout << "Enter the new desired max for the gripper, 60 (degrees) is recommended to match the maximum tool opening." << std::endl;
         std::cin >> userMaxDeg;
         cmnGetChar(); // to get the CR
-        double userMaxRad = userMaxDeg * cmnPI / 180.0;
-        // find corresponding pot values using previous scale and offset - carefull, offsets are in degrees in the file
-        double minVolt = (minRad - previousOffset * cmnPI / 180.0) / previousScale;
-        double maxVolt = (maxRad - previousOffset * cmnPI / 180.0) / previousScale;
-        // compute new scale and offset to match pot -> [0, user-max]
-        double newScale = (userMaxRad - 0.0) / (maxVolt - minVolt);
-        double newOffset = - newScale * minVolt * 180.0 / cmnPI; // also convert back to degrees
+        double newScale, newOffset;
+        ComputeScaleOffset(minRad, maxRad, previousOffset, previousScale,
+                           userMaxDeg * cmnPI / 180.0, newScale, newOffset);
 
         // ask one last confirmation from user
         std::cout << "Status: offset and scale in XML configuration file: " << previousOffset << " " << previousScale << std::endl
@@ -0,0 +1,178 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+/*
+  Same as sawIntuitiveResearchKitQtConsoleJSON without any GUI.  The
+  console, data collection and user components are created from the
+  same configuration files and the main thread just waits for SIGINT
+  or SIGTERM to stop all components.  Meant for computers without
+  display, all interactions go through the console's interfaces (e.g.
+  ROS, foot pedals).
+*/
+
+// system
+#include <csignal>
+#include <iostream>
+
+// cisst/saw
+#include <cisstCommon/cmnPath.h>
+#include <cisstCommon/cmnCommandLineOptions.h>
+#include <cisstOSAbstraction/osaSleep.h>
+#include <cisstMultiTask/mtsCollectorFactory.h>
+#include <cisstMultiTask/mtsManagerLocal.h>
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConsole.h>
+
+namespace {
+    volatile std::sig_atomic_t StopRequested = 0;
+
+    void SignalHandler(int CMN_UNUSED(signal))
+    {
+        StopRequested = 1;
+    }
+}
+
+void fileExists(const std::string & description, const std::string & filename)
+{
+    if (!cmnPath::Exists(filename)) {
+        std::cerr << "File not found: " << description
+                  << "; " << filename << std::endl;
+        exit(-1);
+    } else {
+        std::cout << "File found: " << description
+                  << "; " << filename << std::endl;
+    }
+}
+
+
+int main(int argc, char ** argv)
+{
+    // log configuration
+    cmnLogger::SetMask(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskDefaultLog(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskFunction(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskClassMatching("mtsIntuitiveResearchKit", CMN_LOG_ALLOW_ALL);
+    cmnLogger::AddChannel(std::cerr, CMN_LOG_ALLOW_ERRORS_AND_WARNINGS);
+
+    // parse options
+    cmnCommandLineOptions options;
+    std::string jsonMainConfigFile;
+    std::string jsonCollectionConfigFile;
+    std::list<std::string> managerConfig;
+    std::string configCacheDirectory;
+    std::string host;
+
+    options.AddOptionOneValue("j", "json-config",
+                              "json configuration file",
+                              cmnCommandLineOptions::REQUIRED_OPTION, &jsonMainConfigFile);
+
+    options.AddOptionOneValue("c", "collection-config",
+                              "json configuration file for data collection using cisstMultiTask state table collector",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &jsonCollectionConfigFile);
+
+    options.AddOptionNoValue("C", "calibration-mode",
+                             "run in calibration mode, doesn't use potentiometers to monitor encoder values and always force re-homing.  This mode should only be used when calibrating your potentiometers.");
+
+    options.AddOptionMultipleValues("m", "component-manager",
+                                    "JSON files to configure component manager",
+                                    cmnCommandLineOptions::OPTIONAL_OPTION, &managerConfig);
+
+    options.AddOptionOneValue("k", "config-cache",
+                              "directory used to cache parsed configuration files, unchanged files are not re-parsed on restart",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &configCacheDirectory);
+
+    options.AddOptionOneValue("H", "host",
+                              "name of this computer for configuration files with \"distributed\", overrides \"distributed\":\"host\"",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &host);
+
+    // check that all required options have been provided
+    std::string errorMessage;
+    if (!options.Parse(argc, argv, errorMessage)) {
+        std::cerr << "Error: " << errorMessage << std::endl;
+        options.PrintUsage(std::cerr);
+        return -1;
+    }
+    std::string arguments;
+    options.PrintParsedArguments(arguments);
+    std::cout << "Options provided:" << std::endl << arguments << std::endl;
+
+    // make sure the json config file exists and can be parsed
+    fileExists("JSON configuration", jsonMainConfigFile);
+
+    // parsed configuration cache, must be set before any file is parsed
+    if (options.IsSet("config-cache")) {
+        if (!cmnPath::Exists(configCacheDirectory)) {
+            std::cerr << "Configuration cache directory not found: "
+                      << configCacheDirectory << std::endl;
+            return -1;
+        }
+        mtsIntuitiveResearchKitConfigCache::SetDirectory(configCacheDirectory);
+    }
+
+    mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
+
+    // console
+    mtsIntuitiveResearchKitConsole * console = new mtsIntuitiveResearchKitConsole("console");
+    console->set_calibration_mode(options.IsSet("calibration-mode"));
+    if (options.IsSet("host")) {
+        console->set_host(host);
+    }
+    console->Configure(jsonMainConfigFile);
+    componentManager->AddComponent(console);
+    console->Connect();
+
+    // configure data collection if needed
+    if (options.IsSet("collection-config")) {
+        // make sure the json config file exists
+        fileExists("JSON data collection configuration", jsonCollectionConfigFile);
+
+        mtsCollectorFactory * collectorFactory = new mtsCollectorFactory("collectors");
+        collectorFactory->Configure(jsonCollectionConfigFile);
+        componentManager->AddComponent(collectorFactory);
+        collectorFactory->Connect();
+    }
+
+    // custom user component
+    if (!componentManager->ConfigureJSON(managerConfig)) {
+        CMN_LOG_INIT_ERROR << "Configure: failed to configure component-manager, check cisstLog for error messages" << std::endl;
+        return -1;
+    }
+
+    // install handlers before starting threads so they are inherited
+    std::signal(SIGINT, SignalHandler);
+    std::signal(SIGTERM, SignalHandler);
+
+    //-------------- create the components ------------------
+    componentManager->CreateAllAndWait(2.0 * cmn_s);
+    componentManager->StartAllAndWait(2.0 * cmn_s);
+
+    std::cout << "Running without GUI, press Ctrl-C or send SIGTERM to stop" << std::endl;
+    while (!StopRequested) {
+        osaSleep(100.0 * cmn_ms);
+    }
+    std::cout << "Stopping all components" << std::endl;
+
+    componentManager->KillAllAndWait(2.0 * cmn_s);
+    componentManager->Cleanup();
+
+    // stop all logs
+    cmnLogger::Kill();
+
+    return 0;
+}
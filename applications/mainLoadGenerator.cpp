@@ -0,0 +1,523 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+/*
+  Full system load generator used to size computers before buying
+  hardware.  Generates a console configuration with N kinematic
+  simulated MTM/PSM pairs and their tele-operations, optionally an
+  ECM with its tele-operation and a simulated SUJ.  Arms are
+  simulated so no IO is needed.  Once all tele-operations are
+  following, each MTM is driven with a sine wave (servo_jp) and the
+  program reports the CPU used by each component (computation time
+  over period), period jitter, deadline misses and MTM to PSM
+  tele-operation latency.  Results can be saved in a JSON file.
+*/
+
+// system
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <cmath>
+
+#include <cisstCommon/cmnPortability.h>
+#if (CISST_OS == CISST_LINUX)
+#include <sys/resource.h>
+#endif
+
+// cisst/saw
+#include <cisstCommon/cmnPath.h>
+#include <cisstCommon/cmnCommandLineOptions.h>
+#include <cisstOSAbstraction/osaSleep.h>
+#include <cisstOSAbstraction/osaGetTime.h>
+#include <cisstMultiTask/mtsManagerLocal.h>
+#include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <cisstMultiTask/mtsIntervalStatistics.h>
+#include <cisstParameterTypes/prmStateJoint.h>
+#include <cisstParameterTypes/prmPositionJointSet.h>
+#include <cisstParameterTypes/prmOperatingState.h>
+#include <cisstParameterTypes/prmEventButton.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConsole.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
+
+class LoadGenerator: public mtsComponent
+{
+public:
+    LoadGenerator(const std::string & name):
+        mtsComponent(name)
+    {
+        mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired("Console");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("power_on", Console.power_on);
+            interfaceRequired->AddFunction("home", Console.home);
+            interfaceRequired->AddFunction("teleop_enable", Console.teleop_enable);
+            interfaceRequired->AddFunction("emulate_operator_present", Console.emulate_operator_present);
+        }
+    }
+
+    struct {
+        mtsFunctionVoid power_on;
+        mtsFunctionVoid home;
+        mtsFunctionWrite teleop_enable;
+        mtsFunctionWrite emulate_operator_present;
+    } Console;
+
+    /*! Any component with period statistics, i.e. arms, SUJ and
+      tele-operations */
+    struct ComponentType {
+        std::string name;
+        std::string interface_name;
+        double period;
+        bool is_arm;
+        bool needs_homing;
+        bool needs_following;
+        mtsFunctionRead period_statistics;
+        mtsFunctionRead timing_statistics;
+        mtsFunctionVoid timing_statistics_reset;
+        mtsFunctionRead operating_state;
+        // MTM input
+        mtsFunctionRead measured_js;
+        mtsFunctionWrite servo_jp;
+        vctDoubleVec initial;
+        // PSM latency
+        mtsFunctionRead servo_cp_latency;
+        std::vector<double> latencies;
+        // tele-operation
+        std::atomic<bool> following;
+        void FollowingEventHandler(const bool & value) {
+            following = value;
+        }
+    };
+
+    std::list<ComponentType> Components;
+
+    ComponentType & AddComponent(const std::string & name,
+                                 const std::string & interfaceName,
+                                 const double period,
+                                 const bool isArm) {
+        Components.emplace_back();
+        ComponentType & component = Components.back();
+        component.name = name;
+        component.interface_name = interfaceName;
+        component.period = period;
+        component.is_arm = isArm;
+        component.needs_homing = false;
+        component.needs_following = false;
+        component.following = false;
+        mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired(name);
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("period_statistics", component.period_statistics);
+            if (isArm) {
+                interfaceRequired->AddFunction("operating_state", component.operating_state);
+                interfaceRequired->AddFunction("timing_statistics", component.timing_statistics, MTS_OPTIONAL);
+                interfaceRequired->AddFunction("timing_statistics_reset", component.timing_statistics_reset, MTS_OPTIONAL);
+                interfaceRequired->AddFunction("measured_js", component.measured_js, MTS_OPTIONAL);
+                interfaceRequired->AddFunction("servo_jp", component.servo_jp, MTS_OPTIONAL);
+                interfaceRequired->AddFunction("servo_cp/latency", component.servo_cp_latency, MTS_OPTIONAL);
+            } else {
+                interfaceRequired->AddEventHandlerWrite(&ComponentType::FollowingEventHandler,
+                                                        &component, "following", MTS_EVENT_NOT_QUEUED);
+            }
+        }
+        return component;
+    }
+};
+
+bool WaitFor(std::function<bool(void)> condition, const double timeout)
+{
+    const double start = osaGetTime();
+    while (!condition()) {
+        if ((osaGetTime() - start) > timeout) {
+            return false;
+        }
+        osaSleep(10.0 * cmn_ms);
+    }
+    return true;
+}
+
+// percentile from sorted samples, nearest rank
+double Percentile(const std::vector<double> & sorted, const double percent)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+    if (rank > 0) {
+        --rank;
+    }
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+// process CPU time (user and system) in seconds
+double ProcessCPUTime(void)
+{
+#if (CISST_OS == CISST_LINUX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+            + 1.0e-6 * static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+    }
+#endif
+    return 0.0;
+}
+
+Json::Value ComponentReport(LoadGenerator::ComponentType & component)
+{
+    Json::Value result;
+    mtsIntervalStatistics statistics;
+    component.period_statistics(statistics);
+    const double periodAverage = statistics.PeriodAvg();
+    const double cpu = (periodAverage > 0.0) ? (statistics.ComputeAvg() / periodAverage) : 0.0;
+    result["name"] = component.name;
+    result["nominal-period"] = component.period;
+    result["period-average"] = periodAverage;
+    result["period-jitter"] = statistics.PeriodStdDev();
+    result["period-max"] = statistics.PeriodMax();
+    result["compute-average"] = statistics.ComputeAvg();
+    result["compute-max"] = statistics.ComputeMax();
+    result["cpu"] = cpu;
+
+    std::cout << std::left << std::setw(16) << component.name << std::right << std::fixed
+              << std::setprecision(3)
+              << " period " << std::setw(7) << 1000.0 * periodAverage
+              << "ms, jitter " << std::setw(7) << 1000.0 * statistics.PeriodStdDev()
+              << "ms, max " << std::setw(7) << 1000.0 * statistics.PeriodMax()
+              << "ms, cpu " << std::setprecision(1) << std::setw(5) << 100.0 * cpu << "%";
+
+    mtsIntuitiveResearchKitArmTiming timing;
+    if (component.is_arm
+        && component.timing_statistics.IsValid()
+        && component.timing_statistics(timing).IsOK()) {
+        result["deadline-misses"] = static_cast<Json::UInt64>(timing.deadline_misses());
+        result["iterations"] = static_cast<Json::UInt64>(timing.iterations());
+        std::cout << ", deadline misses " << timing.deadline_misses() << "/" << timing.iterations();
+    }
+
+    if (!component.latencies.empty()) {
+        std::vector<double> & samples = component.latencies;
+        std::sort(samples.begin(), samples.end());
+        double sum = 0.0;
+        for (const double sample : samples) {
+            sum += sample;
+        }
+        Json::Value latency;
+        latency["samples"] = static_cast<Json::UInt64>(samples.size());
+        latency["average"] = sum / samples.size();
+        latency["p50"] = Percentile(samples, 50.0);
+        latency["p99"] = Percentile(samples, 99.0);
+        latency["max"] = samples.back();
+        result["teleop-latency"] = latency;
+        std::cout << ", teleop latency p50 " << std::setprecision(3)
+                  << 1000.0 * Percentile(samples, 50.0)
+                  << "ms, p99 " << 1000.0 * Percentile(samples, 99.0) << "ms";
+    }
+    std::cout << std::endl;
+    return result;
+}
+
+int main(int argc, char ** argv)
+{
+    // log configuration
+    cmnLogger::SetMask(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskDefaultLog(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskFunction(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskClassMatching("mtsIntuitiveResearchKit", CMN_LOG_ALLOW_ALL);
+    cmnLogger::AddChannel(std::cerr, CMN_LOG_ALLOW_ERRORS_AND_WARNINGS);
+
+    // parse options
+    cmnCommandLineOptions options;
+    int numberOfPairs = 1;
+    double armPeriod = mtsIntuitiveResearchKit::ArmPeriod;
+    double teleopPeriod = mtsIntuitiveResearchKit::TeleopPeriod;
+    double duration = 10.0 * cmn_s;
+    double amplitude = 5.0; // degrees
+    double frequency = 0.5; // Hz
+    double pollPeriod = 1.0 * cmn_ms;
+    std::string outputFile;
+
+    options.AddOptionOneValue("n", "pairs",
+                              "number of simulated MTM/PSM pairs with tele-operation",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &numberOfPairs);
+    options.AddOptionNoValue("e", "ecm",
+                             "add a simulated ECM and ECM tele-operation (requires at least 2 pairs)");
+    options.AddOptionNoValue("s", "suj",
+                             "add a simulated SUJ, used as base frame for PSM1 to PSM3 and ECM");
+    options.AddOptionOneValue("p", "arm-period",
+                              "period for all arms in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &armPeriod);
+    options.AddOptionOneValue("t", "teleop-period",
+                              "period for all tele-operations in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &teleopPeriod);
+    options.AddOptionOneValue("d", "duration",
+                              "duration of the measurement in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &duration);
+    options.AddOptionOneValue("a", "amplitude",
+                              "amplitude of MTM motion on first joint in degrees",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &amplitude);
+    options.AddOptionOneValue("f", "frequency",
+                              "frequency of MTM motion in Hz",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &frequency);
+    options.AddOptionOneValue("o", "output",
+                              "JSON file to save results",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &outputFile);
+
+    std::string errorMessage;
+    if (!options.Parse(argc, argv, errorMessage)) {
+        std::cerr << "Error: " << errorMessage << std::endl;
+        options.PrintUsage(std::cerr);
+        return -1;
+    }
+    const bool hasECM = options.IsSet("ecm");
+    const bool hasSUJ = options.IsSet("suj");
+    if (numberOfPairs < 1) {
+        std::cerr << "Error: number of pairs must be at least 1" << std::endl;
+        return -1;
+    }
+    if (hasECM && (numberOfPairs < 2)) {
+        std::cerr << "Error: ECM tele-operation requires at least 2 MTMs" << std::endl;
+        return -1;
+    }
+    std::string arguments;
+    options.PrintParsedArguments(arguments);
+    std::cout << "Options provided:" << std::endl << arguments << std::endl;
+
+    mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
+    LoadGenerator * generator = new LoadGenerator("load-generator");
+
+    // generate console configuration, all arms simulated.  MTMs
+    // alternate between right and left configuration files, only
+    // PSM1 to PSM3 and ECM can use the SUJ
+    Json::Value jsonConfig;
+    jsonConfig["io"]["physical-footpedals-required"] = false;
+    if (hasSUJ) {
+        Json::Value jsonArm;
+        jsonArm["name"] = "SUJ";
+        jsonArm["type"] = "SUJ";
+        jsonArm["simulation"] = "KINEMATIC";
+        jsonArm["kinematic"] = "arm/suj-simulated.json";
+        jsonConfig["arms"].append(jsonArm);
+        generator->AddComponent("SUJ", "Arm", 0.0, true);
+    }
+    for (int pair = 1; pair <= numberOfPairs; ++pair) {
+        const std::string index = std::to_string(pair);
+        Json::Value jsonArm;
+        jsonArm["name"] = "MTM" + index;
+        jsonArm["type"] = "MTM";
+        jsonArm["simulation"] = "KINEMATIC";
+        jsonArm["arm"] = (pair % 2) ? "arm/MTMR_KIN_SIMULATED.json" : "arm/MTML_KIN_SIMULATED.json";
+        jsonArm["period"] = armPeriod;
+        jsonConfig["arms"].append(jsonArm);
+        generator->AddComponent(jsonArm["name"].asString(), "Arm", armPeriod, true).needs_homing = true;
+
+        jsonArm["name"] = "PSM" + index;
+        jsonArm["type"] = "PSM";
+        jsonArm["arm"] = "arm/PSM_KIN_SIMULATED_LARGE_NEEDLE_DRIVER_400006.json";
+        if (hasSUJ && (pair <= 3)) {
+            jsonArm["base-frame"]["component"] = "SUJ";
+            jsonArm["base-frame"]["interface"] = jsonArm["name"];
+        }
+        jsonConfig["arms"].append(jsonArm);
+        generator->AddComponent(jsonArm["name"].asString(), "Arm", armPeriod, true).needs_homing = true;
+
+        Json::Value jsonTeleop;
+        jsonTeleop["mtm"] = "MTM" + index;
+        jsonTeleop["psm"] = "PSM" + index;
+        jsonTeleop["period"] = teleopPeriod;
+        jsonTeleop["configure-parameter"]["ignore-jaw"] = true;
+        jsonTeleop["configure-parameter"]["align-mtm"] = false;
+        jsonConfig["psm-teleops"].append(jsonTeleop);
+        generator->AddComponent("MTM" + index + "-PSM" + index, "Setting", teleopPeriod, false).needs_following = true;
+    }
+    if (hasECM) {
+        Json::Value jsonArm;
+        jsonArm["name"] = "ECM";
+        jsonArm["type"] = "ECM";
+        jsonArm["simulation"] = "KINEMATIC";
+        jsonArm["arm"] = "arm/ECM_KIN_SIMULATED_STRAIGHT.json";
+        jsonArm["period"] = armPeriod;
+        if (hasSUJ) {
+            jsonArm["base-frame"]["component"] = "SUJ";
+            jsonArm["base-frame"]["interface"] = "ECM";
+        }
+        jsonConfig["arms"].append(jsonArm);
+        generator->AddComponent("ECM", "Arm", armPeriod, true).needs_homing = true;
+        // ECM tele-operation is loaded but camera is never pressed
+        jsonConfig["ecm-teleop"]["mtm-left"] = "MTM2";
+        jsonConfig["ecm-teleop"]["mtm-right"] = "MTM1";
+        jsonConfig["ecm-teleop"]["ecm"] = "ECM";
+        jsonConfig["ecm-teleop"]["period"] = teleopPeriod;
+        generator->AddComponent("MTM2-MTM1-ECM", "Setting", teleopPeriod, false);
+    }
+
+    const std::string configFile = cmnPath::GetWorkingDirectory() + "/dvrk-load-generator.json";
+    {
+        std::ofstream configStream(configFile);
+        Json::StyledWriter writer;
+        configStream << writer.write(jsonConfig);
+    }
+
+    // console
+    mtsIntuitiveResearchKitConsole * console = new mtsIntuitiveResearchKitConsole("console");
+    console->Configure(configFile);
+    if (!console->Configured()) {
+        std::cerr << "Error: failed to configure console, check cisstLog for error messages" << std::endl;
+        return -1;
+    }
+    componentManager->AddComponent(console);
+    console->Connect();
+
+    componentManager->AddComponent(generator);
+    componentManager->Connect(generator->GetName(), "Console", "console", "Main");
+    for (auto & component : generator->Components) {
+        componentManager->Connect(generator->GetName(), component.name,
+                                  component.name, component.interface_name);
+    }
+
+    componentManager->CreateAllAndWait(5.0 * cmn_s);
+    componentManager->StartAllAndWait(5.0 * cmn_s);
+
+    int result = 0;
+
+    // power and home
+    generator->Console.power_on();
+    generator->Console.home();
+    if (!WaitFor([&]() {
+                prmOperatingState state;
+                for (auto & component : generator->Components) {
+                    if (component.needs_homing) {
+                        component.operating_state(state);
+                        if (!state.IsHomed()) {
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            }, 60.0 * cmn_s)) {
+        std::cerr << "Error: timeout while homing arms" << std::endl;
+        result = -1;
+    }
+
+    // engage all PSM tele-operations
+    if (result == 0) {
+        generator->Console.teleop_enable(true);
+        prmEventButton button;
+        button.SetType(prmEventButton::PRESSED);
+        generator->Console.emulate_operator_present(button);
+        if (!WaitFor([&]() {
+                    for (auto & component : generator->Components) {
+                        if (component.needs_following && !component.following) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }, 30.0 * cmn_s)) {
+            std::cerr << "Error: timeout while engaging tele-operations" << std::endl;
+            result = -1;
+        }
+    }
+
+    if (result == 0) {
+        // find MTMs and PSMs, initial positions
+        std::vector<LoadGenerator::ComponentType *> mtms, psms;
+        prmStateJoint measured;
+        for (auto & component : generator->Components) {
+            if (component.name.compare(0, 3, "MTM") == 0) {
+                if (component.is_arm) {
+                    component.measured_js(measured);
+                    component.initial.ForceAssign(measured.Position());
+                    mtms.push_back(&component);
+                }
+            } else if (component.name.compare(0, 3, "PSM") == 0) {
+                psms.push_back(&component);
+            }
+            if (component.is_arm && component.timing_statistics_reset.IsValid()) {
+                component.timing_statistics_reset();
+            }
+        }
+
+        const double radians = amplitude * cmnPI_180;
+        prmPositionJointSet servo;
+        vct3 latency;
+        const double cpuStart = ProcessCPUTime();
+        const double start = osaGetTime();
+        double now = start;
+        while ((now - start) < duration) {
+            now = osaGetTime();
+            const double elapsed = now - start;
+            // sine on first joint, phase offset between MTMs
+            for (size_t index = 0; index < mtms.size(); ++index) {
+                LoadGenerator::ComponentType * mtm = mtms.at(index);
+                servo.Goal().ForceAssign(mtm->initial);
+                servo.Goal().Element(0) += radians * std::sin(2.0 * cmnPI * frequency * elapsed
+                                                              + static_cast<double>(index));
+                mtm->servo_jp(servo);
+            }
+            // MTM measured_cp to PSM PID, measured by the PSM
+            for (auto psm : psms) {
+                psm->servo_cp_latency(latency);
+                if (latency.Element(0) > 0.0) {
+                    psm->latencies.push_back(latency.Element(0));
+                }
+            }
+            osaSleep(pollPeriod);
+        }
+        const double cpuUsed = ProcessCPUTime() - cpuStart;
+        const double wallTime = osaGetTime() - start;
+
+        // send MTMs back to start
+        for (auto mtm : mtms) {
+            servo.Goal().ForceAssign(mtm->initial);
+            mtm->servo_jp(servo);
+        }
+
+        // report
+        std::cout << std::endl << numberOfPairs << " MTM/PSM pairs"
+                  << (hasECM ? ", ECM" : "") << (hasSUJ ? ", SUJ" : "") << std::endl;
+        Json::Value jsonResult;
+        jsonResult["pairs"] = numberOfPairs;
+        jsonResult["ecm"] = hasECM;
+        jsonResult["suj"] = hasSUJ;
+        jsonResult["duration"] = wallTime;
+        for (auto & component : generator->Components) {
+            jsonResult["components"].append(ComponentReport(component));
+        }
+        // number of cores used by the whole process, including the console and this program
+        const double cores = (wallTime > 0.0) ? (cpuUsed / wallTime) : 0.0;
+        jsonResult["process-cpu-cores"] = cores;
+        std::cout << "Process CPU: " << std::setprecision(2) << cores << " core(s)" << std::endl;
+
+        if (!outputFile.empty()) {
+            std::ofstream outputStream(outputFile);
+            Json::StyledWriter writer;
+            outputStream << writer.write(jsonResult);
+        }
+    }
+
+    generator->Console.teleop_enable(false);
+
+    componentManager->KillAllAndWait(5.0 * cmn_s);
+    componentManager->Cleanup();
+
+    // stop all logs
+    cmnLogger::Kill();
+
+    return result;
+}
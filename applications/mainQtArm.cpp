@@ -163,6 +163,7 @@ int main(int argc, char ** argv)
         std::cerr << "Arm name should be either PSM1, PSM2, PSM3, MTML, MTMR or ECM, not " << armName << std::endl;
         return -1;
     }
+    console->RunStartupTasks();
     console->AddArm(arm);
     console->Connect();
 
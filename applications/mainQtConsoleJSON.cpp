@@ -25,6 +25,7 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstCommon/cmnPath.h>
 #include <cisstCommon/cmnCommandLineOptions.h>
 #include <cisstCommon/cmnQt.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConsole.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConsoleQt.h>
 
@@ -64,6 +65,8 @@ int main(int argc, char ** argv)
     std::string jsonCollectionConfigFile;
     std::list<std::string> managerConfig;
     std::string qtStyle;
+    std::string configCacheDirectory;
+    std::string host;
 
     options.AddOptionOneValue("j", "json-config",
                               "json configuration file",
@@ -87,6 +90,14 @@ int main(int argc, char ** argv)
     options.AddOptionNoValue("D", "dark-mode",
                              "replaces the default Qt palette with darker colors");
 
+    options.AddOptionOneValue("k", "config-cache",
+                              "directory used to cache parsed configuration files, unchanged files are not re-parsed on restart",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &configCacheDirectory);
+
+    options.AddOptionOneValue("H", "host",
+                              "name of this computer for configuration files with \"distributed\", overrides \"distributed\":\"host\"",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &host);
+
     // check that all required options have been provided
     std::string errorMessage;
     if (!options.Parse(argc, argv, errorMessage)) {
@@ -101,11 +112,24 @@ int main(int argc, char ** argv)
     // make sure the json config file exists and can be parsed
     fileExists("JSON configuration", jsonMainConfigFile);
 
+    // parsed configuration cache, must be set before any file is parsed
+    if (options.IsSet("config-cache")) {
+        if (!cmnPath::Exists(configCacheDirectory)) {
+            std::cerr << "Configuration cache directory not found: "
+                      << configCacheDirectory << std::endl;
+            return -1;
+        }
+        mtsIntuitiveResearchKitConfigCache::SetDirectory(configCacheDirectory);
+    }
+
     mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
 
     // console
     mtsIntuitiveResearchKitConsole * console = new mtsIntuitiveResearchKitConsole("console");
     console->set_calibration_mode(options.IsSet("calibration-mode"));
+    if (options.IsSet("host")) {
+        console->set_host(host);
+    }
     console->Configure(jsonMainConfigFile);
     componentManager->AddComponent(console);
     console->Connect();
@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-27
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+/*
+  Convert a binary file created by mtsIntuitiveResearchKitRecorder to
+  CSV, one file per arm named <prefix>-<arm>.csv.  The first line of
+  each CSV file contains the column names.
+*/
+
+// system
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+// cisst/saw
+#include <cisstCommon/cmnCommandLineOptions.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRecorder.h>
+
+int main(int argc, char ** argv)
+{
+    // parse options
+    cmnCommandLineOptions options;
+    std::string inputFile;
+    std::string outputPrefix;
+
+    options.AddOptionOneValue("i", "input",
+                              "binary file created by the recorder",
+                              cmnCommandLineOptions::REQUIRED_OPTION, &inputFile);
+    options.AddOptionOneValue("o", "output",
+                              "prefix for CSV files, default is input file name",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &outputPrefix);
+
+    std::string errorMessage;
+    if (!options.Parse(argc, argv, errorMessage)) {
+        std::cerr << "Error: " << errorMessage << std::endl;
+        options.PrintUsage(std::cerr);
+        return -1;
+    }
+    if (outputPrefix == "") {
+        outputPrefix = inputFile;
+    }
+
+    mtsIntuitiveResearchKitRecorderReader reader;
+    if (!reader.Open(inputFile, errorMessage)) {
+        std::cerr << "Error: " << errorMessage << std::endl;
+        return -1;
+    }
+
+    // one CSV file per arm
+    std::vector<std::unique_ptr<std::ofstream>> outputs;
+    for (size_t arm = 0; arm < reader.NumberOfArms(); ++arm) {
+        const std::string fileName = outputPrefix + "-" + reader.ArmName(arm) + ".csv";
+        std::unique_ptr<std::ofstream> output(new std::ofstream(fileName));
+        if (!output->is_open()) {
+            std::cerr << "Error: failed to create \"" << fileName << "\"" << std::endl;
+            return -1;
+        }
+        *output << std::setprecision(17);
+        const std::vector<std::string> & columns = reader.ColumnNames(arm);
+        for (size_t column = 0; column < columns.size(); ++column) {
+            *output << (column ? "," : "") << columns[column];
+        }
+        *output << std::endl;
+        outputs.push_back(std::move(output));
+        std::cout << "Writing \"" << fileName << "\"" << std::endl;
+    }
+
+    // records
+    size_t records = 0;
+    size_t arm;
+    std::vector<double> record;
+    while (reader.Next(arm, record)) {
+        std::ofstream & output = *(outputs[arm]);
+        for (size_t column = 0; column < record.size(); ++column) {
+            output << (column ? "," : "") << record[column];
+        }
+        output << '\n';
+        ++records;
+    }
+    if (reader.Truncated()) {
+        std::cerr << "Warning: file truncated or corrupted after record " << records << std::endl;
+    }
+    std::cout << records << " record(s) converted" << std::endl;
+    return 0;
+}
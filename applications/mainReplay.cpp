@@ -0,0 +1,536 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-29
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+/*
+  Replay a session recorded with mtsIntuitiveResearchKitRecorder
+  through the MTM/PSM tele-operation, both arms in kinematic
+  simulation and no GUI.  The recorded MTM joint positions are sent
+  to the simulated MTM one sample at a time, in lock step: the next
+  sample is sent only after the MTM and the PSM have each completed
+  at least two periods.  Each arm reports its periods using a
+  recorder channel (see mtsIntuitiveResearchKitArm::SetRecorderChannel).
+  The sequence of PSM setpoints is then independent of the arm
+  periods and scheduling, so the same recording always produces the
+  same output and the arms can run faster than real time.
+
+  The PSM setpoints are saved in <prefix>-psm.csv (one line per
+  sample) and compared to a previous replay's output if provided.  A
+  JSON report with the compute time per period and the divergence is
+  saved in <prefix>-report.json.  The program returns a non zero
+  value if the divergence exceeds a given limit so it can be used to
+  check that performance changes don't modify the tele-operation
+  output.
+*/
+
+// system
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <cmath>
+
+// cisst/saw
+#include <cisstCommon/cmnPath.h>
+#include <cisstCommon/cmnCommandLineOptions.h>
+#include <cisstOSAbstraction/osaSleep.h>
+#include <cisstOSAbstraction/osaGetTime.h>
+#include <cisstMultiTask/mtsManagerLocal.h>
+#include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <cisstMultiTask/mtsIntervalStatistics.h>
+#include <cisstParameterTypes/prmPositionJointSet.h>
+#include <cisstParameterTypes/prmOperatingState.h>
+#include <cisstParameterTypes/prmEventButton.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConsole.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArm.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRecorder.h>
+
+class Replay: public mtsComponent
+{
+public:
+    Replay(const std::string & name):
+        mtsComponent(name),
+        m_following(false)
+    {
+        mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired("Console");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("power_on", Console.power_on);
+            interfaceRequired->AddFunction("home", Console.home);
+            interfaceRequired->AddFunction("teleop_enable", Console.teleop_enable);
+            interfaceRequired->AddFunction("emulate_operator_present", Console.emulate_operator_present);
+        }
+        interfaceRequired = AddInterfaceRequired("MTM");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("servo_jp", MTM.servo_jp);
+            interfaceRequired->AddFunction("move_jp", MTM.move_jp);
+            interfaceRequired->AddFunction("operating_state", MTM.operating_state);
+            interfaceRequired->AddFunction("period_statistics", MTM.period_statistics);
+        }
+        interfaceRequired = AddInterfaceRequired("PSM");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("operating_state", PSM.operating_state);
+            interfaceRequired->AddFunction("period_statistics", PSM.period_statistics);
+        }
+        interfaceRequired = AddInterfaceRequired("Teleop");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("period_statistics", Teleop.period_statistics);
+            interfaceRequired->AddEventHandlerWrite(&Replay::FollowingEventHandler,
+                                                    this, "following", MTS_EVENT_NOT_QUEUED);
+        }
+    }
+
+    struct {
+        mtsFunctionVoid power_on;
+        mtsFunctionVoid home;
+        mtsFunctionWrite teleop_enable;
+        mtsFunctionWrite emulate_operator_present;
+    } Console;
+
+    struct {
+        mtsFunctionWrite servo_jp;
+        mtsFunctionWrite move_jp;
+        mtsFunctionRead operating_state;
+        mtsFunctionRead period_statistics;
+    } MTM;
+
+    struct {
+        mtsFunctionRead operating_state;
+        mtsFunctionRead period_statistics;
+    } PSM;
+
+    struct {
+        mtsFunctionRead period_statistics;
+    } Teleop;
+
+    std::atomic<bool> m_following;
+
+    void FollowingEventHandler(const bool & following) {
+        m_following = following;
+    }
+};
+
+bool WaitFor(std::function<bool(void)> condition, const double timeout)
+{
+    const double start = osaGetTime();
+    while (!condition()) {
+        if ((osaGetTime() - start) > timeout) {
+            return false;
+        }
+        osaSleep(10.0 * cmn_ms);
+    }
+    return true;
+}
+
+// wait for an arm to complete a number of periods, copy last record
+bool WaitForPeriods(mtsIntuitiveResearchKitRecorderChannel & channel,
+                    const size_t periods,
+                    std::vector<double> & last,
+                    const double timeout)
+{
+    size_t count = 0;
+    const double start = osaGetTime();
+    while (count < periods) {
+        const double * records;
+        const size_t available = channel.Available(records);
+        if (available > 0) {
+            const double * record = records + (available - 1) * channel.RecordSize();
+            last.assign(record, record + channel.RecordSize());
+            channel.Release(available);
+            count += available;
+        } else {
+            if ((osaGetTime() - start) > timeout) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+    }
+    return true;
+}
+
+// discard all records
+void Drain(mtsIntuitiveResearchKitRecorderChannel & channel)
+{
+    const double * records;
+    size_t available;
+    while ((available = channel.Available(records)) > 0) {
+        channel.Release(available);
+    }
+}
+
+Json::Value ComputeReport(const std::string & name,
+                          mtsFunctionRead & period_statistics)
+{
+    Json::Value result;
+    mtsIntervalStatistics statistics;
+    period_statistics(statistics);
+    result["period-average"] = statistics.PeriodAvg();
+    result["compute-average"] = statistics.ComputeAvg();
+    result["compute-max"] = statistics.ComputeMax();
+    std::cout << name << " compute per period (ms): average " << 1000.0 * statistics.ComputeAvg()
+              << ", max " << 1000.0 * statistics.ComputeMax() << std::endl;
+    return result;
+}
+
+int main(int argc, char ** argv)
+{
+    // log configuration
+    cmnLogger::SetMask(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskDefaultLog(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskFunction(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskClassMatching("mtsIntuitiveResearchKit", CMN_LOG_ALLOW_ALL);
+    cmnLogger::AddChannel(std::cerr, CMN_LOG_ALLOW_ERRORS_AND_WARNINGS);
+
+    // parse options
+    cmnCommandLineOptions options;
+    std::string inputFile;
+    std::string mtmName = "MTMR";
+    std::string mtmConfig = "arm/MTMR_KIN_SIMULATED.json";
+    std::string psmConfig = "arm/PSM_KIN_SIMULATED_LARGE_NEEDLE_DRIVER_400006.json";
+    double period = 0.5 * cmn_ms;
+    std::string outputPrefix = "replay";
+    std::string referenceFile;
+    double maxDivergence = 0.0;
+    int maxSamples = 0;
+
+    options.AddOptionOneValue("i", "input",
+                              "binary file created by the recorder",
+                              cmnCommandLineOptions::REQUIRED_OPTION, &inputFile);
+    options.AddOptionOneValue("m", "mtm",
+                              "name of the MTM in the recorded file, measured_js is required",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &mtmName);
+    options.AddOptionOneValue("M", "mtm-config",
+                              "configuration file for the simulated MTM",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &mtmConfig);
+    options.AddOptionOneValue("P", "psm-config",
+                              "configuration file for the simulated PSM",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &psmConfig);
+    options.AddOptionOneValue("p", "period",
+                              "period used for both arms during the replay in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &period);
+    options.AddOptionOneValue("o", "output",
+                              "prefix for output files",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &outputPrefix);
+    options.AddOptionOneValue("r", "reference",
+                              "PSM setpoints from a previous replay (<prefix>-psm.csv) to compute the divergence",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &referenceFile);
+    options.AddOptionOneValue("l", "max-divergence",
+                              "maximum joint divergence with reference, returns an error if exceeded",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &maxDivergence);
+    options.AddOptionOneValue("n", "samples",
+                              "maximum number of MTM samples to replay, 0 for all",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &maxSamples);
+
+    std::string errorMessage;
+    if (!options.Parse(argc, argv, errorMessage)) {
+        std::cerr << "Error: " << errorMessage << std::endl;
+        options.PrintUsage(std::cerr);
+        return -1;
+    }
+    if (period <= 0.0) {
+        std::cerr << "Error: period must be positive" << std::endl;
+        return -1;
+    }
+
+    // recorded file
+    mtsIntuitiveResearchKitRecorderReader reader;
+    if (!reader.Open(inputFile, errorMessage)) {
+        std::cerr << "Error: " << errorMessage << std::endl;
+        return -1;
+    }
+    const int mtmIndex = reader.ArmIndex(mtmName);
+    if (mtmIndex < 0) {
+        std::cerr << "Error: arm \"" << mtmName << "\" not found in \"" << inputFile << "\"" << std::endl;
+        return -1;
+    }
+    const size_t nbMTMJoints = 7;
+    const int firstColumn = reader.ColumnIndex(mtmIndex, "measured_js/position/0");
+    if ((firstColumn < 0)
+        || (reader.ColumnIndex(mtmIndex, "measured_js/position/" + std::to_string(nbMTMJoints - 1)) < 0)) {
+        std::cerr << "Error: measured_js for " << nbMTMJoints << " joints not found for \""
+                  << mtmName << "\"" << std::endl;
+        return -1;
+    }
+
+    // first MTM sample, used to position the MTM before tele-operation
+    size_t arm;
+    std::vector<double> record;
+    bool found = false;
+    while (!found && reader.Next(arm, record)) {
+        found = (arm == static_cast<size_t>(mtmIndex));
+    }
+    if (!found) {
+        std::cerr << "Error: no sample found for \"" << mtmName << "\"" << std::endl;
+        return -1;
+    }
+
+    std::ifstream reference;
+    if (!referenceFile.empty()) {
+        reference.open(referenceFile);
+        if (!reference.is_open()) {
+            std::cerr << "Error: failed to open reference \"" << referenceFile << "\"" << std::endl;
+            return -1;
+        }
+        std::string header;
+        std::getline(reference, header);
+    }
+
+    // generate console configuration, both arms simulated
+    Json::Value jsonConfig;
+    jsonConfig["io"]["physical-footpedals-required"] = false;
+    jsonConfig["flight-recorder"]["duration"] = 0.0;
+    Json::Value jsonArm;
+    jsonArm["name"] = "MTMR";
+    jsonArm["type"] = "MTM";
+    jsonArm["simulation"] = "KINEMATIC";
+    jsonArm["arm"] = mtmConfig;
+    jsonArm["period"] = period;
+    jsonConfig["arms"].append(jsonArm);
+    jsonArm["name"] = "PSM1";
+    jsonArm["type"] = "PSM";
+    jsonArm["arm"] = psmConfig;
+    jsonArm["period"] = period;
+    jsonConfig["arms"].append(jsonArm);
+    Json::Value jsonTeleop;
+    jsonTeleop["mtm"] = "MTMR";
+    jsonTeleop["psm"] = "PSM1";
+    // tele-operation runs right after the MTM
+    jsonTeleop["execution"] = "CHAINED_MTM";
+    jsonTeleop["configure-parameter"]["ignore-jaw"] = true;
+    jsonTeleop["configure-parameter"]["align-mtm"] = false;
+    jsonConfig["psm-teleops"].append(jsonTeleop);
+
+    const std::string configFile = cmnPath::GetWorkingDirectory() + "/dvrk-replay.json";
+    {
+        std::ofstream configStream(configFile);
+        Json::StyledWriter writer;
+        configStream << writer.write(jsonConfig);
+    }
+
+    mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
+
+    // console
+    mtsIntuitiveResearchKitConsole * console = new mtsIntuitiveResearchKitConsole("console");
+    console->Configure(configFile);
+    if (!console->Configured()) {
+        std::cerr << "Error: failed to configure console, check cisstLog for error messages" << std::endl;
+        return -1;
+    }
+    componentManager->AddComponent(console);
+    console->Connect();
+
+    // recorder channels to track each arm's periods
+    mtsIntuitiveResearchKitArm * mtm = dynamic_cast<mtsIntuitiveResearchKitArm *>(componentManager->GetComponent("MTMR"));
+    mtsIntuitiveResearchKitArm * psm = dynamic_cast<mtsIntuitiveResearchKitArm *>(componentManager->GetComponent("PSM1"));
+    if (!mtm || !psm) {
+        std::cerr << "Error: can't find simulated arms" << std::endl;
+        return -1;
+    }
+    // number of joints is not known here, use a large enough value
+    const size_t nbPSMJoints = 8;
+    mtsIntuitiveResearchKitRecorderChannel mtmChannel("MTMR", mtsIntuitiveResearchKitRecorderChannel::FIELD_MEASURED_JS,
+                                                      nbMTMJoints, 1024);
+    mtsIntuitiveResearchKitRecorderChannel psmChannel("PSM1", mtsIntuitiveResearchKitRecorderChannel::FIELD_SETPOINT_JS,
+                                                      nbPSMJoints, 1024);
+    mtm->SetRecorderChannel(&mtmChannel);
+    psm->SetRecorderChannel(&psmChannel);
+
+    // replay
+    Replay * replay = new Replay("replay");
+    componentManager->AddComponent(replay);
+    componentManager->Connect(replay->GetName(), "Console", "console", "Main");
+    componentManager->Connect(replay->GetName(), "MTM", "MTMR", "Arm");
+    componentManager->Connect(replay->GetName(), "PSM", "PSM1", "Arm");
+    componentManager->Connect(replay->GetName(), "Teleop", "MTMR-PSM1", "Setting");
+
+    componentManager->CreateAllAndWait(2.0 * cmn_s);
+    componentManager->StartAllAndWait(2.0 * cmn_s);
+
+    int result = 0;
+    prmOperatingState mtmState, psmState;
+    prmPositionJointSet mtmServo;
+    prmEventButton button;
+    mtmServo.Goal().SetSize(nbMTMJoints);
+    mtmServo.Goal().Assign(record.data() + firstColumn);
+
+    // power and home
+    replay->Console.power_on();
+    replay->Console.home();
+    if (!WaitFor([&]() {
+                replay->MTM.operating_state(mtmState);
+                replay->PSM.operating_state(psmState);
+                return mtmState.IsHomed() && psmState.IsHomed();
+            }, 20.0 * cmn_s)) {
+        std::cerr << "Error: timeout while homing arms" << std::endl;
+        result = -1;
+    }
+
+    // move MTM to first recorded position
+    if (result == 0) {
+        replay->MTM.move_jp(mtmServo);
+        osaSleep(10.0 * cmn_ms);
+        if (!WaitFor([&]() {
+                    replay->MTM.operating_state(mtmState);
+                    return !mtmState.IsBusy();
+                }, 20.0 * cmn_s)) {
+            std::cerr << "Error: timeout while moving MTM to first recorded position" << std::endl;
+            result = -1;
+        }
+    }
+
+    // engage tele-operation
+    if (result == 0) {
+        replay->Console.teleop_enable(true);
+        button.SetType(prmEventButton::PRESSED);
+        replay->Console.emulate_operator_present(button);
+        if (!WaitFor([&]() {
+                    return replay->m_following.load();
+                }, 20.0 * cmn_s)) {
+            std::cerr << "Error: timeout while engaging tele-operation" << std::endl;
+            result = -1;
+        }
+    }
+
+    size_t samples = 0;
+    double divergenceMax = 0.0;
+    double divergenceSumSquares = 0.0;
+    size_t divergenceSamples = 0;
+    double firstTime = record[0];
+    double lastTime = firstTime;
+    double wallTime = 0.0;
+
+    if (result == 0) {
+        const std::string psmFile = outputPrefix + "-psm.csv";
+        std::ofstream psmOutput(psmFile);
+        psmOutput << std::setprecision(17) << "sample,time";
+        for (size_t joint = 0; joint < nbPSMJoints; ++joint) {
+            psmOutput << ",setpoint_js/position/" << joint;
+        }
+        psmOutput << std::endl;
+
+        std::vector<double> mtmLast, psmLast, referenceValues;
+        const double timeout = 1.0 * cmn_s;
+        Drain(mtmChannel);
+        Drain(psmChannel);
+        const double start = osaGetTime();
+
+        do {
+            if (arm != static_cast<size_t>(mtmIndex)) {
+                continue;
+            }
+            lastTime = record[0];
+            mtmServo.Goal().Assign(record.data() + firstColumn);
+            replay->MTM.servo_jp(mtmServo);
+            // MTM processed the goal and tele-operation ran at least once,
+            // then PSM processed the tele-operation's goal
+            if (!WaitForPeriods(mtmChannel, 2, mtmLast, timeout)
+                || !WaitForPeriods(psmChannel, 2, psmLast, timeout)) {
+                std::cerr << "Error: timeout while replaying sample " << samples << std::endl;
+                result = -1;
+                break;
+            }
+            if (!replay->m_following) {
+                std::cerr << "Error: tele-operation stopped at sample " << samples << std::endl;
+                result = -1;
+                break;
+            }
+
+            // PSM setpoint positions start after time and valid
+            const double * psmPosition = psmLast.data() + 2;
+            psmOutput << samples << "," << (lastTime - firstTime);
+            for (size_t joint = 0; joint < nbPSMJoints; ++joint) {
+                psmOutput << "," << psmPosition[joint];
+            }
+            psmOutput << '\n';
+
+            // compare with reference
+            std::string line;
+            if (reference.is_open() && std::getline(reference, line)) {
+                std::stringstream lineStream(line);
+                std::string value;
+                referenceValues.clear();
+                while (std::getline(lineStream, value, ',')) {
+                    referenceValues.push_back(std::stod(value));
+                }
+                for (size_t joint = 0; (joint < nbPSMJoints) && (joint + 2 < referenceValues.size()); ++joint) {
+                    const double difference = std::abs(psmPosition[joint] - referenceValues[joint + 2]);
+                    divergenceMax = std::max(divergenceMax, difference);
+                    divergenceSumSquares += difference * difference;
+                    ++divergenceSamples;
+                }
+            }
+
+            ++samples;
+            if ((maxSamples > 0) && (samples >= static_cast<size_t>(maxSamples))) {
+                break;
+            }
+        } while (reader.Next(arm, record));
+        wallTime = osaGetTime() - start;
+        if (reader.Truncated()) {
+            std::cerr << "Warning: recorded file truncated or corrupted" << std::endl;
+        }
+        std::cout << "Saved PSM setpoints in \"" << psmFile << "\"" << std::endl;
+
+        // report
+        Json::Value jsonResult;
+        const double recordedTime = lastTime - firstTime;
+        jsonResult["samples"] = static_cast<Json::UInt64>(samples);
+        jsonResult["recorded-duration"] = recordedTime;
+        jsonResult["replay-duration"] = wallTime;
+        jsonResult["real-time-factor"] = (wallTime > 0.0) ? (recordedTime / wallTime) : 0.0;
+        std::cout << std::endl << "Replayed " << samples << " samples, " << recordedTime
+                  << "s recorded in " << wallTime << "s" << std::endl;
+        jsonResult["compute"]["MTM"] = ComputeReport("MTM", replay->MTM.period_statistics);
+        jsonResult["compute"]["PSM"] = ComputeReport("PSM", replay->PSM.period_statistics);
+        jsonResult["compute"]["teleop"] = ComputeReport("Teleop", replay->Teleop.period_statistics);
+        jsonResult["dropped"]["MTM"] = static_cast<Json::UInt64>(mtmChannel.Dropped());
+        jsonResult["dropped"]["PSM"] = static_cast<Json::UInt64>(psmChannel.Dropped());
+        if (reference.is_open()) {
+            const double rms = (divergenceSamples > 0) ?
+                std::sqrt(divergenceSumSquares / static_cast<double>(divergenceSamples)) : 0.0;
+            jsonResult["divergence"]["max"] = divergenceMax;
+            jsonResult["divergence"]["rms"] = rms;
+            std::cout << "Divergence with reference: max " << divergenceMax
+                      << ", rms " << rms << std::endl;
+            if ((maxDivergence > 0.0) && (divergenceMax > maxDivergence)) {
+                std::cerr << "Error: divergence " << divergenceMax
+                          << " exceeds " << maxDivergence << std::endl;
+                result = -1;
+            }
+        }
+        std::ofstream reportStream(outputPrefix + "-report.json");
+        Json::StyledWriter writer;
+        reportStream << writer.write(jsonResult);
+    }
+
+    replay->Console.teleop_enable(false);
+
+    componentManager->KillAllAndWait(2.0 * cmn_s);
+    componentManager->Cleanup();
+
+    mtm->SetRecorderChannel(nullptr);
+    psm->SetRecorderChannel(nullptr);
+
+    // stop all logs
+    cmnLogger::Kill();
+
+    return result;
+}
@@ -0,0 +1,499 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-20
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+/*
+  Motion to motion latency benchmark for the MTM/PSM tele-operation.
+  Both arms run in kinematic simulation, the MTM is driven using
+  servo_jp with a scripted step or sine input and the PSM setpoint
+  (i.e. joint position sent to the PID) is monitored to measure how
+  long it takes for a change on the MTM to reach the PSM PID.  Run
+  once per set of periods/execution mode, results can be saved in a
+  JSON file and the program returns a non zero value if the 99th
+  percentile exceeds a given limit so it can be used for regression
+  testing.
+*/
+
+// system
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <cmath>
+
+// cisst/saw
+#include <cisstCommon/cmnPath.h>
+#include <cisstCommon/cmnCommandLineOptions.h>
+#include <cisstOSAbstraction/osaSleep.h>
+#include <cisstOSAbstraction/osaGetTime.h>
+#include <cisstMultiTask/mtsManagerLocal.h>
+#include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <cisstMultiTask/mtsIntervalStatistics.h>
+#include <cisstParameterTypes/prmStateJoint.h>
+#include <cisstParameterTypes/prmPositionJointSet.h>
+#include <cisstParameterTypes/prmOperatingState.h>
+#include <cisstParameterTypes/prmEventButton.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConsole.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
+
+class TeleopLatencyBenchmark: public mtsComponent
+{
+public:
+    TeleopLatencyBenchmark(const std::string & name):
+        mtsComponent(name),
+        m_following(false)
+    {
+        mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired("Console");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("power_on", Console.power_on);
+            interfaceRequired->AddFunction("home", Console.home);
+            interfaceRequired->AddFunction("teleop_enable", Console.teleop_enable);
+            interfaceRequired->AddFunction("emulate_operator_present", Console.emulate_operator_present);
+        }
+        interfaceRequired = AddInterfaceRequired("MTM");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("measured_js", MTM.measured_js);
+            interfaceRequired->AddFunction("servo_jp", MTM.servo_jp);
+            interfaceRequired->AddFunction("operating_state", MTM.operating_state);
+            interfaceRequired->AddFunction("period_statistics", MTM.period_statistics);
+            interfaceRequired->AddFunction("timing_statistics", MTM.timing_statistics);
+        }
+        interfaceRequired = AddInterfaceRequired("PSM");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("setpoint_js", PSM.setpoint_js);
+            interfaceRequired->AddFunction("operating_state", PSM.operating_state);
+            interfaceRequired->AddFunction("period_statistics", PSM.period_statistics);
+            interfaceRequired->AddFunction("timing_statistics", PSM.timing_statistics);
+            interfaceRequired->AddFunction("servo_cp/latency", PSM.servo_cp_latency);
+        }
+        interfaceRequired = AddInterfaceRequired("Teleop");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("period_statistics", Teleop.period_statistics);
+            interfaceRequired->AddEventHandlerWrite(&TeleopLatencyBenchmark::FollowingEventHandler,
+                                                    this, "following", MTS_EVENT_NOT_QUEUED);
+        }
+    }
+
+    struct {
+        mtsFunctionVoid power_on;
+        mtsFunctionVoid home;
+        mtsFunctionWrite teleop_enable;
+        mtsFunctionWrite emulate_operator_present;
+    } Console;
+
+    struct {
+        mtsFunctionRead measured_js;
+        mtsFunctionWrite servo_jp;
+        mtsFunctionRead operating_state;
+        mtsFunctionRead period_statistics;
+        mtsFunctionRead timing_statistics;
+    } MTM;
+
+    struct {
+        mtsFunctionRead setpoint_js;
+        mtsFunctionRead operating_state;
+        mtsFunctionRead period_statistics;
+        mtsFunctionRead timing_statistics;
+        mtsFunctionRead servo_cp_latency;
+    } PSM;
+
+    struct {
+        mtsFunctionRead period_statistics;
+    } Teleop;
+
+    std::atomic<bool> m_following;
+
+    void FollowingEventHandler(const bool & following) {
+        m_following = following;
+    }
+};
+
+// percentile from sorted samples, nearest rank
+double Percentile(const std::vector<double> & sorted, const double percent)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+    if (rank > 0) {
+        --rank;
+    }
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+Json::Value LatencyReport(const std::string & name,
+                          std::vector<double> & samples)
+{
+    Json::Value result;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0, sumSquares = 0.0;
+    for (const auto & sample : samples) {
+        sum += sample;
+        sumSquares += sample * sample;
+    }
+    const double count = static_cast<double>(samples.size());
+    const double mean = samples.empty() ? 0.0 : sum / count;
+    const double variance = samples.empty() ? 0.0 : std::max(0.0, sumSquares / count - mean * mean);
+    result["samples"] = static_cast<Json::UInt64>(samples.size());
+    result["mean"] = mean;
+    result["jitter"] = std::sqrt(variance); // standard deviation
+    result["min"] = samples.empty() ? 0.0 : samples.front();
+    result["p50"] = Percentile(samples, 50.0);
+    result["p90"] = Percentile(samples, 90.0);
+    result["p99"] = Percentile(samples, 99.0);
+    result["max"] = samples.empty() ? 0.0 : samples.back();
+
+    std::cout << name << " latency (ms, " << samples.size() << " samples):"
+              << " mean " << 1000.0 * mean
+              << ", jitter " << 1000.0 * std::sqrt(variance)
+              << ", p50 " << 1000.0 * result["p50"].asDouble()
+              << ", p90 " << 1000.0 * result["p90"].asDouble()
+              << ", p99 " << 1000.0 * result["p99"].asDouble()
+              << ", max " << 1000.0 * result["max"].asDouble() << std::endl;
+    return result;
+}
+
+Json::Value SchedulingReport(const std::string & name,
+                             const double nominalPeriod,
+                             mtsFunctionRead & period_statistics,
+                             mtsFunctionRead * timing_statistics = nullptr)
+{
+    Json::Value result;
+    mtsIntervalStatistics statistics;
+    period_statistics(statistics);
+    result["nominal-period"] = nominalPeriod;
+    result["period-average"] = statistics.PeriodAvg();
+    result["period-jitter"] = statistics.PeriodStdDev();
+    result["period-min"] = statistics.PeriodMin();
+    result["period-max"] = statistics.PeriodMax();
+    result["compute-average"] = statistics.ComputeAvg();
+    result["compute-max"] = statistics.ComputeMax();
+    // time spent between iterations not used for computation
+    const double overhead = (nominalPeriod > 0.0) ? (statistics.PeriodAvg() - nominalPeriod) : 0.0;
+    result["scheduling-overhead"] = overhead;
+
+    std::cout << name << " period (ms): average " << 1000.0 * statistics.PeriodAvg()
+              << ", jitter " << 1000.0 * statistics.PeriodStdDev()
+              << ", max " << 1000.0 * statistics.PeriodMax()
+              << ", compute " << 1000.0 * statistics.ComputeAvg();
+    if (nominalPeriod > 0.0) {
+        std::cout << ", overhead " << 1000.0 * overhead;
+    }
+    std::cout << std::endl;
+
+    if (timing_statistics) {
+        mtsIntuitiveResearchKitArmTiming timing;
+        if (((*timing_statistics)(timing)).IsOK()) {
+            result["deadline-misses"] = static_cast<Json::UInt64>(timing.deadline_misses());
+            result["iterations"] = static_cast<Json::UInt64>(timing.iterations());
+            std::cout << name << " deadline misses: " << timing.deadline_misses()
+                      << "/" << timing.iterations() << std::endl;
+        }
+    }
+    return result;
+}
+
+bool WaitFor(std::function<bool(void)> condition, const double timeout)
+{
+    const double start = osaGetTime();
+    while (!condition()) {
+        if ((osaGetTime() - start) > timeout) {
+            return false;
+        }
+        osaSleep(10.0 * cmn_ms);
+    }
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    // log configuration
+    cmnLogger::SetMask(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskDefaultLog(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskFunction(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskClassMatching("mtsIntuitiveResearchKit", CMN_LOG_ALLOW_ALL);
+    cmnLogger::AddChannel(std::cerr, CMN_LOG_ALLOW_ERRORS_AND_WARNINGS);
+
+    // parse options
+    cmnCommandLineOptions options;
+    double mtmPeriod = mtsIntuitiveResearchKit::ArmPeriod;
+    double psmPeriod = mtsIntuitiveResearchKit::ArmPeriod;
+    double teleopPeriod = mtsIntuitiveResearchKit::TeleopPeriod;
+    std::string execution = "PERIODIC";
+    std::string input = "step";
+    double duration = 10.0 * cmn_s;
+    double amplitude = 5.0; // degrees
+    double frequency = 2.0; // Hz
+    double pollPeriod = 0.1 * cmn_ms;
+    double maxLatency = 0.0;
+    std::string outputFile;
+
+    options.AddOptionOneValue("m", "mtm-period",
+                              "MTM arm period in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &mtmPeriod);
+    options.AddOptionOneValue("p", "psm-period",
+                              "PSM arm period in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &psmPeriod);
+    options.AddOptionOneValue("t", "teleop-period",
+                              "tele-operation period in seconds, ignored for chained executions",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &teleopPeriod);
+    options.AddOptionOneValue("e", "execution",
+                              "tele-operation execution, PERIODIC, CHAINED_PSM or CHAINED_MTM",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &execution);
+    options.AddOptionOneValue("i", "input",
+                              "MTM input, step or sine",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &input);
+    options.AddOptionOneValue("d", "duration",
+                              "duration of the measurement in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &duration);
+    options.AddOptionOneValue("a", "amplitude",
+                              "amplitude of MTM motion on first joint in degrees",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &amplitude);
+    options.AddOptionOneValue("f", "frequency",
+                              "frequency of MTM motion in Hz (sine) or number of steps per second",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &frequency);
+    options.AddOptionOneValue("s", "poll-period",
+                              "period used to poll the PSM setpoint in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &pollPeriod);
+    options.AddOptionOneValue("l", "max-latency",
+                              "maximum 99th percentile motion to motion latency in seconds, returns an error if exceeded",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &maxLatency);
+    options.AddOptionOneValue("o", "output",
+                              "JSON file to save results",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &outputFile);
+
+    std::string errorMessage;
+    if (!options.Parse(argc, argv, errorMessage)) {
+        std::cerr << "Error: " << errorMessage << std::endl;
+        options.PrintUsage(std::cerr);
+        return -1;
+    }
+    if ((input != "step") && (input != "sine")) {
+        std::cerr << "Error: input must be step or sine" << std::endl;
+        return -1;
+    }
+    if (frequency <= 0.0) {
+        std::cerr << "Error: frequency must be positive" << std::endl;
+        return -1;
+    }
+    std::string arguments;
+    options.PrintParsedArguments(arguments);
+    std::cout << "Options provided:" << std::endl << arguments << std::endl;
+
+    // generate console configuration, both arms simulated
+    Json::Value jsonConfig;
+    jsonConfig["io"]["physical-footpedals-required"] = false;
+    Json::Value jsonArm;
+    jsonArm["name"] = "MTMR";
+    jsonArm["type"] = "MTM";
+    jsonArm["simulation"] = "KINEMATIC";
+    jsonArm["arm"] = "arm/MTMR_KIN_SIMULATED.json";
+    jsonArm["period"] = mtmPeriod;
+    jsonConfig["arms"].append(jsonArm);
+    jsonArm["name"] = "PSM1";
+    jsonArm["type"] = "PSM";
+    jsonArm["arm"] = "arm/PSM_KIN_SIMULATED_LARGE_NEEDLE_DRIVER_400006.json";
+    jsonArm["period"] = psmPeriod;
+    jsonConfig["arms"].append(jsonArm);
+    Json::Value jsonTeleop;
+    jsonTeleop["mtm"] = "MTMR";
+    jsonTeleop["psm"] = "PSM1";
+    jsonTeleop["period"] = teleopPeriod;
+    jsonTeleop["execution"] = execution;
+    jsonTeleop["configure-parameter"]["ignore-jaw"] = true;
+    jsonTeleop["configure-parameter"]["align-mtm"] = false;
+    jsonConfig["psm-teleops"].append(jsonTeleop);
+
+    const std::string configFile = cmnPath::GetWorkingDirectory() + "/dvrk-teleop-latency-benchmark.json";
+    {
+        std::ofstream configStream(configFile);
+        Json::StyledWriter writer;
+        configStream << writer.write(jsonConfig);
+    }
+
+    mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
+
+    // console
+    mtsIntuitiveResearchKitConsole * console = new mtsIntuitiveResearchKitConsole("console");
+    console->Configure(configFile);
+    if (!console->Configured()) {
+        std::cerr << "Error: failed to configure console, check cisstLog for error messages" << std::endl;
+        return -1;
+    }
+    componentManager->AddComponent(console);
+    console->Connect();
+
+    // benchmark
+    TeleopLatencyBenchmark * benchmark = new TeleopLatencyBenchmark("benchmark");
+    componentManager->AddComponent(benchmark);
+    componentManager->Connect(benchmark->GetName(), "Console", "console", "Main");
+    componentManager->Connect(benchmark->GetName(), "MTM", "MTMR", "Arm");
+    componentManager->Connect(benchmark->GetName(), "PSM", "PSM1", "Arm");
+    componentManager->Connect(benchmark->GetName(), "Teleop", "MTMR-PSM1", "Setting");
+
+    componentManager->CreateAllAndWait(2.0 * cmn_s);
+    componentManager->StartAllAndWait(2.0 * cmn_s);
+
+    int result = 0;
+    prmOperatingState mtmState, psmState;
+    prmStateJoint mtmMeasured, psmSetpoint;
+    prmPositionJointSet mtmServo;
+    prmEventButton button;
+    std::vector<double> motionLatencies, servoLatencies;
+
+    // power and home
+    benchmark->Console.power_on();
+    benchmark->Console.home();
+    if (!WaitFor([&]() {
+                benchmark->MTM.operating_state(mtmState);
+                benchmark->PSM.operating_state(psmState);
+                return mtmState.IsHomed() && psmState.IsHomed();
+            }, 20.0 * cmn_s)) {
+        std::cerr << "Error: timeout while homing arms" << std::endl;
+        result = -1;
+    }
+
+    // engage tele-operation
+    if (result == 0) {
+        benchmark->Console.teleop_enable(true);
+        button.SetType(prmEventButton::PRESSED);
+        benchmark->Console.emulate_operator_present(button);
+        if (!WaitFor([&]() {
+                    return benchmark->m_following.load();
+                }, 20.0 * cmn_s)) {
+            std::cerr << "Error: timeout while engaging tele-operation" << std::endl;
+            result = -1;
+        }
+    }
+
+    if (result == 0) {
+        benchmark->MTM.measured_js(mtmMeasured);
+        const vctDoubleVec initial(mtmMeasured.Position());
+        mtmServo.Goal().ForceAssign(initial);
+        const double radians = amplitude * cmnPI_180;
+        // PSM setpoint change smaller than this is considered noise
+        const double threshold = 1.0e-6;
+
+        benchmark->PSM.setpoint_js(psmSetpoint);
+        vctDoubleVec previousPSM(psmSetpoint.Position());
+        double previousTimestamp = psmSetpoint.Timestamp();
+        vct3 servoLatency;
+
+        const double start = osaGetTime();
+        double stepTime = 0.0;
+        bool waitingForStep = false;
+        size_t stepIndex = 0;
+        double now = start;
+
+        while ((now - start) < duration) {
+            now = osaGetTime();
+            const double elapsed = now - start;
+            if (input == "step") {
+                // new step every 1 / frequency, toggle between initial and offset
+                const size_t index = static_cast<size_t>(elapsed * frequency);
+                if (index != stepIndex) {
+                    stepIndex = index;
+                    benchmark->PSM.setpoint_js(psmSetpoint);
+                    previousPSM.Assign(psmSetpoint.Position());
+                    mtmServo.Goal().Element(0) = initial.Element(0) + ((stepIndex % 2) ? radians : 0.0);
+                    stepTime = osaGetTime();
+                    benchmark->MTM.servo_jp(mtmServo);
+                    waitingForStep = true;
+                }
+            } else {
+                mtmServo.Goal().Element(0) = initial.Element(0) + radians * std::sin(2.0 * cmnPI * frequency * elapsed);
+                benchmark->MTM.servo_jp(mtmServo);
+            }
+
+            benchmark->PSM.setpoint_js(psmSetpoint);
+            if (psmSetpoint.Timestamp() != previousTimestamp) {
+                previousTimestamp = psmSetpoint.Timestamp();
+                if (waitingForStep) {
+                    double change = 0.0;
+                    for (size_t joint = 0; joint < previousPSM.size(); ++joint) {
+                        change = std::max(change, std::abs(psmSetpoint.Position().Element(joint)
+                                                           - previousPSM.Element(joint)));
+                    }
+                    if (change > threshold) {
+                        motionLatencies.push_back(osaGetTime() - stepTime);
+                        waitingForStep = false;
+                    }
+                }
+                // MTM measured_cp to PSM PID, measured by the PSM
+                benchmark->PSM.servo_cp_latency(servoLatency);
+                if (servoLatency.Element(0) > 0.0) {
+                    servoLatencies.push_back(servoLatency.Element(0));
+                }
+            }
+            osaSleep(pollPeriod);
+        }
+        // send MTM back to start
+        mtmServo.Goal().Assign(initial);
+        benchmark->MTM.servo_jp(mtmServo);
+
+        // report
+        Json::Value jsonResult;
+        jsonResult["execution"] = execution;
+        jsonResult["input"] = input;
+        jsonResult["duration"] = duration;
+        std::cout << std::endl << "Execution " << execution << ", input " << input << std::endl;
+        if (input == "step") {
+            jsonResult["motion-to-motion"] = LatencyReport("Motion to motion", motionLatencies);
+        }
+        jsonResult["servo-cp"] = LatencyReport("MTM measured_cp to PSM PID", servoLatencies);
+        jsonResult["scheduling"]["MTM"] = SchedulingReport("MTM", mtmPeriod,
+                                                           benchmark->MTM.period_statistics,
+                                                           &(benchmark->MTM.timing_statistics));
+        jsonResult["scheduling"]["PSM"] = SchedulingReport("PSM", psmPeriod,
+                                                           benchmark->PSM.period_statistics,
+                                                           &(benchmark->PSM.timing_statistics));
+        jsonResult["scheduling"]["teleop"] = SchedulingReport("Teleop",
+                                                              (execution == "PERIODIC") ? teleopPeriod : 0.0,
+                                                              benchmark->Teleop.period_statistics);
+
+        if (!outputFile.empty()) {
+            std::ofstream outputStream(outputFile);
+            Json::StyledWriter writer;
+            outputStream << writer.write(jsonResult);
+        }
+
+        // regression check
+        if (maxLatency > 0.0) {
+            const std::string key = (input == "step") ? "motion-to-motion" : "servo-cp";
+            const double p99 = jsonResult[key]["p99"].asDouble();
+            if (jsonResult[key]["samples"].asUInt64() == 0) {
+                std::cerr << "Error: no latency sample collected" << std::endl;
+                result = -1;
+            } else if (p99 > maxLatency) {
+                std::cerr << "Error: 99th percentile latency " << 1000.0 * p99
+                          << "ms exceeds " << 1000.0 * maxLatency << "ms" << std::endl;
+                result = -1;
+            }
+        }
+    }
+
+    benchmark->Console.teleop_enable(false);
+
+    componentManager->KillAllAndWait(2.0 * cmn_s);
+    componentManager->Cleanup();
+
+    // stop all logs
+    cmnLogger::Kill();
+
+    return result;
+}
@@ -62,6 +62,7 @@ mtsIntuitiveResearchKitArmQtWidget::mtsIntuitiveResearchKitArmQtWidget(const std
         InterfaceRequired->AddFunction("body/measured_cf", Arm.measured_cf_body, MTS_OPTIONAL);
         InterfaceRequired->AddFunction("move_jp", Arm.move_jp, MTS_OPTIONAL);
         InterfaceRequired->AddFunction("period_statistics", Arm.period_statistics);
+        InterfaceRequired->AddFunction("gui_snapshot", Arm.gui_snapshot, MTS_OPTIONAL);
         InterfaceRequired->AddEventReceiver("trajectory_j/ratio", Arm.trajectory_j_ratio, MTS_OPTIONAL);
         InterfaceRequired->AddFunction("trajectory_j/set_ratio", Arm.trajectory_j_set_ratio, MTS_OPTIONAL);
 
@@ -107,33 +108,45 @@ void mtsIntuitiveResearchKitArmQtWidget::closeEvent(QCloseEvent * event)
 
 void mtsIntuitiveResearchKitArmQtWidget::timerEvent(QTimerEvent * CMN_UNUSED(event))
 {
-    // make sure we should update the display
-    if (this->isHidden()) {
+    // make sure we should update the display, see global refresh policy
+    if (!RefreshPolicy.Due(this)) {
         return;
     }
+    mtsIntuitiveResearchKitQtRefresh::Scope refreshScope(RefreshPolicy);
 
     mtsExecutionResult executionResult;
 
-    executionResult = Arm.measured_js(StateJoint);
-    if (executionResult) {
-        if ((ConfigurationJoint.Name().size() != StateJoint.Name().size())
-            && (Arm.configuration_js.IsValid())) {
-            Arm.configuration_js(ConfigurationJoint);
-            QSJWidget->SetConfiguration(ConfigurationJoint);
+    // single read if the arm provides a snapshot, first snapshot is
+    // empty since the arm only updates it once it has been read
+    SnapshotValid = false;
+    if (Arm.gui_snapshot.IsValid()) {
+        executionResult = Arm.gui_snapshot(Snapshot);
+        if (!executionResult || (Snapshot.timestamp == 0.0)) {
+            return;
+        }
+        SnapshotValid = true;
+        Snapshot.measured_js.To(StateJoint);
+        Snapshot.measured_cp.To(Position);
+        Wrench.Valid() = Snapshot.body_measured_cf_valid;
+        Wrench.Timestamp() = Snapshot.body_measured_cf_timestamp;
+        Wrench.Force().Assign(Snapshot.body_measured_cf);
+    } else {
+        Arm.measured_js(StateJoint);
+        Arm.measured_cp(Position);
+        if (Arm.measured_cf_body.IsValid()) {
+            Arm.measured_cf_body(Wrench);
         }
-        QSJWidget->SetValue(StateJoint);
     }
 
-    executionResult = Arm.measured_cp(Position);
-    if (executionResult) {
-        QCPGWidget->SetValue(Position);
+    if ((ConfigurationJoint.Name().size() != StateJoint.Name().size())
+        && (Arm.configuration_js.IsValid())) {
+        Arm.configuration_js(ConfigurationJoint);
+        QSJWidget->SetConfiguration(ConfigurationJoint);
     }
-
-    executionResult = Arm.measured_cf_body(Wrench);
-    if (executionResult) {
-        if (Wrench.Valid()) {
-            QFTWidget->SetValue(Wrench.F(), Wrench.T(), Wrench.Timestamp());
-        }
+    QSJWidget->SetValue(StateJoint);
+    QCPGWidget->SetValue(Position);
+    if (Wrench.Valid()) {
+        QFTWidget->SetValue(Wrench.F(), Wrench.T(), Wrench.Timestamp());
     }
 
     Arm.period_statistics(IntervalStatistics);
@@ -16,6 +16,8 @@ http://www.cisst.org/cisst/license.txt.
 --- end cisst license ---
 */
 
+#include <set>
+
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConsoleQt.h>
 
 // cisst/saw
@@ -38,6 +40,7 @@ http://www.cisst.org/cisst/license.txt.
 #include <sawIntuitiveResearchKit/mtsTeleOperationPSMQtWidget.h>
 #include <sawIntuitiveResearchKit/mtsTeleOperationECMQtWidget.h>
 #include <sawIntuitiveResearchKit/mtsSocketBaseQtWidget.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitQtRefresh.h>
 
 #include <QTabWidget>
 
@@ -51,6 +54,12 @@ void mtsIntuitiveResearchKitConsoleQt::Configure(mtsIntuitiveResearchKitConsole
 {
     mtsComponentManager * componentManager = mtsComponentManager::GetInstance();
 
+    // global refresh policy for all widgets
+    if (!mtsIntuitiveResearchKitQtRefresh::Configure(console->m_gui_configuration)) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to configure \"gui\"" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
     mtsIntuitiveResearchKitConsoleQtWidget * consoleGUI = new mtsIntuitiveResearchKitConsoleQtWidget("consoleGUI");
     componentManager->AddComponent(consoleGUI);
     // connect consoleGUI to console
@@ -110,6 +119,9 @@ void mtsIntuitiveResearchKitConsoleQt::Configure(mtsIntuitiveResearchKitConsole
         armTabWidget = TabWidget; // use current tab widget
     }
 
+    // arms sharing a socket bridge only need one socket widget
+    std::set<std::string> socketComponents;
+
     const mtsIntuitiveResearchKitConsole::ArmList::iterator armsEnd = console->mArms.end();
     mtsIntuitiveResearchKitConsole::ArmList::iterator armIter;
     for (armIter = console->mArms.begin(); armIter != armsEnd; ++armIter) {
@@ -170,7 +182,8 @@ void mtsIntuitiveResearchKitConsoleQt::Configure(mtsIntuitiveResearchKitConsole
             armTabWidget->addTab(armGUI, name.c_str());
 
             // PSM server
-            if (armIter->second->m_socket_server) {
+            if (armIter->second->m_socket_server
+                && socketComponents.insert(armIter->second->SocketComponentName()).second) {
                 socketGUI = new mtsSocketBaseQtWidget(name + "-Server-GUI");
                 socketGUI->Configure();
                 componentManager->AddComponent(socketGUI);
@@ -208,12 +221,15 @@ void mtsIntuitiveResearchKitConsoleQt::Configure(mtsIntuitiveResearchKitConsole
 
         case mtsIntuitiveResearchKitConsole::Arm::ARM_PSM_SOCKET:
 
+            if (!socketComponents.insert(armIter->second->ComponentName()).second) {
+                break;
+            }
             socketGUI = new mtsSocketBaseQtWidget(name + "-GUI");
             socketGUI->setObjectName(name.c_str());
             socketGUI->Configure();
             componentManager->AddComponent(socketGUI);
             Connections.Add(socketGUI->GetName(), "SocketBase",
-                            armIter->second->m_name, "System");
+                            armIter->second->ComponentName(), "System");
             armTabWidget->addTab(socketGUI, name.c_str());
             break;
 
@@ -53,7 +53,7 @@ CMN_IMPLEMENT_SERVICES(mtsIntuitiveResearchKitConsoleQtWidget);
 mtsIntuitiveResearchKitConsoleQtWidget::mtsIntuitiveResearchKitConsoleQtWidget(const std::string & componentName):
     mtsComponent(componentName)
 {
-    QMMessage = new mtsMessageQtWidget();
+    QMMessage = new mtsIntuitiveResearchKitMessageQtWidget();
 
     mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired("Main");
     if (interfaceRequired) {
@@ -0,0 +1,272 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+// system include
+#include <algorithm>
+
+// cisst
+#include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitMessageQtWidget.h>
+
+#include <QListView>
+#include <QLabel>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QBrush>
+#include <QColor>
+
+mtsIntuitiveResearchKitMessageQtModel::mtsIntuitiveResearchKitMessageQtModel(const size_t capacity,
+                                                                             QObject * parent):
+    QAbstractListModel(parent),
+    m_entries(capacity),
+    m_first(0),
+    m_size(0)
+{
+}
+
+int mtsIntuitiveResearchKitMessageQtModel::rowCount(const QModelIndex & parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return static_cast<int>(m_size);
+}
+
+QVariant mtsIntuitiveResearchKitMessageQtModel::data(const QModelIndex & index, int role) const
+{
+    if (!index.isValid() || (index.row() >= static_cast<int>(m_size))) {
+        return QVariant();
+    }
+    const EntryType & entry = Entry(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        {
+            QString text = entry.time.toString("hh:mm:ss.zzz") + " ";
+            switch (entry.level) {
+            case LEVEL_ERROR:
+                text.append("Error: ");
+                break;
+            case LEVEL_WARNING:
+                text.append("Warning: ");
+                break;
+            default:
+                break;
+            }
+            text.append(entry.text);
+            if (entry.count > 1) {
+                text.append(QString(" (%1 times)").arg(entry.count));
+            }
+            return text;
+        }
+    case Qt::ForegroundRole:
+        switch (entry.level) {
+        case LEVEL_ERROR:
+            return QBrush(QColor(Qt::red));
+        case LEVEL_WARNING:
+            return QBrush(QColor(255, 100, 0));
+        default:
+            return QVariant();
+        }
+    default:
+        return QVariant();
+    }
+}
+
+void mtsIntuitiveResearchKitMessageQtModel::Append(const std::vector<EntryType> & entries)
+{
+    auto entry = entries.begin();
+    const auto end = entries.end();
+    if (entry == end) {
+        return;
+    }
+
+    // same as last row, only update count
+    if (m_size > 0) {
+        EntryType & last = Entry(m_size - 1);
+        if ((last.level == entry->level) && (last.text == entry->text)) {
+            last.count += entry->count;
+            last.time = entry->time;
+            const QModelIndex lastIndex = index(static_cast<int>(m_size) - 1);
+            emit dataChanged(lastIndex, lastIndex);
+            ++entry;
+        }
+    }
+
+    const size_t capacity = m_entries.size();
+    size_t nbNew = std::min(static_cast<size_t>(end - entry), capacity);
+    if (nbNew == 0) {
+        return;
+    }
+    // only keep the most recent entries if there are too many
+    entry = end - nbNew;
+
+    // remove oldest rows to make room
+    if ((m_size + nbNew) > capacity) {
+        const size_t nbRemoved = m_size + nbNew - capacity;
+        beginRemoveRows(QModelIndex(), 0, static_cast<int>(nbRemoved) - 1);
+        m_first = (m_first + nbRemoved) % capacity;
+        m_size -= nbRemoved;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(),
+                    static_cast<int>(m_size),
+                    static_cast<int>(m_size + nbNew) - 1);
+    for (; entry != end; ++entry) {
+        m_size++;
+        Entry(m_size - 1) = *entry;
+    }
+    endInsertRows();
+}
+
+void mtsIntuitiveResearchKitMessageQtModel::Clear(void)
+{
+    beginResetModel();
+    m_first = 0;
+    m_size = 0;
+    endResetModel();
+}
+
+mtsIntuitiveResearchKitMessageQtWidget::mtsIntuitiveResearchKitMessageQtWidget(QWidget * parent):
+    QWidget(parent),
+    m_dropped(0),
+    m_dropped_total(0)
+{
+    m_pending.reserve(PENDING_SIZE);
+    m_updating.reserve(MAX_ROWS_PER_UPDATE);
+    m_model = new mtsIntuitiveResearchKitMessageQtModel(HISTORY_SIZE, this);
+}
+
+void mtsIntuitiveResearchKitMessageQtWidget::SetInterfaceRequired(mtsInterfaceRequired * interfaceRequired)
+{
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitMessageQtWidget::ErrorEventHandler,
+                                            this, "error");
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitMessageQtWidget::WarningEventHandler,
+                                            this, "warning");
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitMessageQtWidget::StatusEventHandler,
+                                            this, "status");
+}
+
+void mtsIntuitiveResearchKitMessageQtWidget::setupUi(void)
+{
+    QVBoxLayout * layout = new QVBoxLayout;
+    layout->setContentsMargins(0, 0, 0, 0);
+    this->setLayout(layout);
+
+    QLVMessages = new QListView();
+    QLVMessages->setModel(m_model);
+    // all rows have the same height so the view only lays out visible rows
+    QLVMessages->setUniformItemSizes(true);
+    QLVMessages->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    QLVMessages->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    layout->addWidget(QLVMessages);
+
+    QHBoxLayout * buttonsLayout = new QHBoxLayout;
+    layout->addLayout(buttonsLayout);
+    QLDropped = new QLabel("");
+    buttonsLayout->addWidget(QLDropped);
+    buttonsLayout->addStretch();
+    QPBClear = new QPushButton("Clear");
+    buttonsLayout->addWidget(QPBClear);
+    connect(QPBClear, SIGNAL(clicked()),
+            this, SLOT(SlotClear()));
+
+    startTimer(UPDATE_PERIOD_MS);
+}
+
+void mtsIntuitiveResearchKitMessageQtWidget::timerEvent(QTimerEvent * CMN_UNUSED(event))
+{
+    size_t dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending.empty() && (m_dropped == 0)) {
+            return;
+        }
+        // leave extra messages for next update, handlers will drop
+        // new messages if the pending buffer is full
+        const size_t nbRows = std::min(m_pending.size(),
+                                       static_cast<size_t>(MAX_ROWS_PER_UPDATE));
+        m_updating.assign(m_pending.begin(), m_pending.begin() + nbRows);
+        m_pending.erase(m_pending.begin(), m_pending.begin() + nbRows);
+        dropped = m_dropped;
+        m_dropped = 0;
+    }
+
+    // only scroll if user is looking at the latest messages
+    QScrollBar * scrollBar = QLVMessages->verticalScrollBar();
+    const bool atBottom = (scrollBar->value() == scrollBar->maximum());
+    m_model->Append(m_updating);
+    m_updating.clear();
+    if (atBottom) {
+        QLVMessages->scrollToBottom();
+    }
+
+    if (dropped != 0) {
+        m_dropped_total += dropped;
+        QLDropped->setText(QString("%1 message(s) dropped").arg(m_dropped_total));
+    }
+}
+
+void mtsIntuitiveResearchKitMessageQtWidget::SlotClear(void)
+{
+    m_model->Clear();
+    m_dropped_total = 0;
+    QLDropped->setText("");
+}
+
+void mtsIntuitiveResearchKitMessageQtWidget::ErrorEventHandler(const mtsMessage & message)
+{
+    Queue(mtsIntuitiveResearchKitMessageQtModel::LEVEL_ERROR, message.Message);
+}
+
+void mtsIntuitiveResearchKitMessageQtWidget::WarningEventHandler(const mtsMessage & message)
+{
+    Queue(mtsIntuitiveResearchKitMessageQtModel::LEVEL_WARNING, message.Message);
+}
+
+void mtsIntuitiveResearchKitMessageQtWidget::StatusEventHandler(const mtsMessage & message)
+{
+    Queue(mtsIntuitiveResearchKitMessageQtModel::LEVEL_STATUS, message.Message);
+}
+
+void mtsIntuitiveResearchKitMessageQtWidget::Queue(const mtsIntuitiveResearchKitMessageQtModel::LevelType level,
+                                                   const std::string & text)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // coalesce with last queued message
+    if (!m_pending.empty()) {
+        mtsIntuitiveResearchKitMessageQtModel::EntryType & last = m_pending.back();
+        if ((last.level == level) && (last.text == text.c_str())) {
+            last.count++;
+            last.time = QTime::currentTime();
+            return;
+        }
+    }
+    if (m_pending.size() >= PENDING_SIZE) {
+        m_dropped++;
+        return;
+    }
+    mtsIntuitiveResearchKitMessageQtModel::EntryType entry;
+    entry.level = level;
+    entry.time = QTime::currentTime();
+    entry.text = QString(text.c_str());
+    entry.count = 1;
+    m_pending.push_back(entry);
+}
@@ -154,7 +154,11 @@ void mtsIntuitiveResearchKitPSMQtWidget::timerEventDerived(void)
     }
 
     // get jaw data
-    Jaw.measured_js(m_jaw_measured_js);
+    if (SnapshotValid) {
+        Snapshot.tool_js.To(m_jaw_measured_js);
+    } else {
+        Jaw.measured_js(m_jaw_measured_js);
+    }
 
     QString text;
     if (m_jaw_measured_js.Position().size() > 0) {
@@ -170,10 +174,14 @@ void mtsIntuitiveResearchKitPSMQtWidget::timerEventDerived(void)
         QLEJawVelocity->setText("");
     }
     if (m_jaw_measured_js.Effort().size() > 0) {
-        m_signal_jaw->AppendPoint(vctDouble2(m_jaw_measured_js.Timestamp(),
-                                             -(cmn180_PI) * m_jaw_measured_js.Effort().at(0)));
-        m_signal_jaw_zero->AppendPoint(vctDouble2(m_jaw_measured_js.Timestamp(), 0.0));
-        QVP2DJaw->update();
+        if (SnapshotValid) {
+            PlotJawSamples();
+        } else {
+            m_signal_jaw->AppendPoint(vctDouble2(m_jaw_measured_js.Timestamp(),
+                                                 -(cmn180_PI) * m_jaw_measured_js.Effort().at(0)));
+            m_signal_jaw_zero->AppendPoint(vctDouble2(m_jaw_measured_js.Timestamp(), 0.0));
+            QVP2DJaw->update();
+        }
         text.setNum(m_jaw_measured_js.Effort().at(0), 'f', 3);
         QLEJawEffort->setText(text);
     } else {
@@ -181,6 +189,38 @@ void mtsIntuitiveResearchKitPSMQtWidget::timerEventDerived(void)
     }
 }
 
+void mtsIntuitiveResearchKitPSMQtWidget::PlotJawSamples(void)
+{
+    // same snapshot read twice, samples already plotted
+    if (Snapshot.timestamp == m_jaw_plot_timestamp) {
+        return;
+    }
+    m_jaw_plot_timestamp = Snapshot.timestamp;
+
+    // one bucket per pixel column, resize signals to match
+    const int width = QVP2DJaw->width();
+    if (width != m_jaw_plot_width) {
+        m_jaw_plot_width = width;
+        m_jaw_decimator.SetResolution(10.0, width);
+        m_signal_jaw->SetSize(m_jaw_decimator.NumberOfPoints());
+        m_signal_jaw_zero->SetSize(m_jaw_decimator.NumberOfPoints());
+    }
+
+    size_t added = 0;
+    for (size_t index = 0; index < Snapshot.plot_size; ++index) {
+        added += m_jaw_decimator.Add(Snapshot.plot_time.at(index),
+                                     -(cmn180_PI) * Snapshot.plot_tool_effort.at(index),
+                                     [this](const double time, const double value) {
+                                         m_signal_jaw->AppendPoint(vctDouble2(time, value));
+                                         m_signal_jaw_zero->AppendPoint(vctDouble2(time, 0.0));
+                                     });
+    }
+    // only repaint if something changed
+    if (added > 0) {
+        QVP2DJaw->update();
+    }
+}
+
 void mtsIntuitiveResearchKitPSMQtWidget::SetDirectControl(const bool direct)
 {
     mtsIntuitiveResearchKitArmQtWidget::SetDirectControl(direct);
@@ -0,0 +1,215 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitQtRefresh.h>
+
+#include <cisstCommon/cmnLogger.h>
+#include <cisstCommon/cmnUnits.h>
+#include <cisstOSAbstraction/osaGetTime.h>
+
+#if (CISST_OS == CISST_LINUX)
+#include <time.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+
+#include <QDir>
+#include <QWidget>
+
+namespace {
+    struct {
+        double period = 50.0 * cmn_ms;
+        double period_max = 1.0 * cmn_s;
+        double cpu_budget = 0.1;
+        double battery_period = 200.0 * cmn_ms;
+        double report_interval = 0.0;
+        // runtime
+        double current_period = 50.0 * cmn_ms;
+        bool on_battery = false;
+        double window_start = 0.0;
+        double window_time = 0.0;
+        size_t window_refreshes = 0;
+        double load = 0.0;
+        double total_time = 0.0;
+        double last_report = 0.0;
+        double last_battery_check = -1.0e9;
+    } Policy;
+
+    // window used to evaluate the load and adjust the period
+    const double WindowDuration = 1.0 * cmn_s;
+    const double BatteryCheckInterval = 10.0 * cmn_s;
+
+    double RefreshTime(void)
+    {
+#if (CISST_OS == CISST_LINUX)
+        struct timespec now;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0) {
+            return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) * 1.0e-9;
+        }
+#endif
+        return osaGetTime();
+    }
+
+    // true if at least one mains power supply exists and none is online
+    bool OnBattery(void)
+    {
+#if (CISST_OS == CISST_LINUX)
+        QDir supplies("/sys/class/power_supply");
+        bool hasMains = false;
+        for (const QString & name : supplies.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            const std::string path = supplies.absoluteFilePath(name).toStdString();
+            std::ifstream typeFile(path + "/type");
+            std::string type;
+            if (!(typeFile >> type) || (type != "Mains")) {
+                continue;
+            }
+            hasMains = true;
+            std::ifstream onlineFile(path + "/online");
+            int online = 0;
+            if ((onlineFile >> online) && (online != 0)) {
+                return false;
+            }
+        }
+        return hasMains;
+#else
+        return false;
+#endif
+    }
+
+    void EvaluateWindow(const double now)
+    {
+        const double duration = now - Policy.window_start;
+        if (duration < WindowDuration) {
+            return;
+        }
+        Policy.load = Policy.window_time / duration;
+
+        // battery
+        if ((now - Policy.last_battery_check) >= BatteryCheckInterval) {
+            Policy.last_battery_check = now;
+            const bool onBattery = OnBattery();
+            if (onBattery != Policy.on_battery) {
+                Policy.on_battery = onBattery;
+                CMN_LOG_INIT_VERBOSE << "mtsIntuitiveResearchKitQtRefresh: "
+                                     << (onBattery ? "running on battery" : "running on mains power")
+                                     << std::endl;
+            }
+        }
+        const double minimum = Policy.on_battery ?
+            std::max(Policy.period, Policy.battery_period) : Policy.period;
+
+        // adapt period to stay within CPU budget
+        if (Policy.cpu_budget > 0.0) {
+            if (Policy.load > Policy.cpu_budget) {
+                Policy.current_period *= 1.5;
+            } else if (Policy.load < 0.5 * Policy.cpu_budget) {
+                Policy.current_period /= 1.5;
+            }
+        } else {
+            Policy.current_period = minimum;
+        }
+        Policy.current_period = std::min(std::max(Policy.current_period, minimum),
+                                         std::max(Policy.period_max, minimum));
+
+        if ((Policy.report_interval > 0.0)
+            && ((now - Policy.last_report) >= Policy.report_interval)) {
+            Policy.last_report = now;
+            CMN_LOG_INIT_WARNING << "mtsIntuitiveResearchKitQtRefresh: load "
+                                 << Policy.load * 100.0 << "%, "
+                                 << Policy.window_refreshes << " refreshes in "
+                                 << duration << "s, period "
+                                 << Policy.current_period * 1000.0 << "ms, total "
+                                 << Policy.total_time << "s" << std::endl;
+        }
+        Policy.window_start = now;
+        Policy.window_time = 0.0;
+        Policy.window_refreshes = 0;
+    }
+}
+
+bool mtsIntuitiveResearchKitQtRefresh::Configure(const Json::Value & jsonConfig)
+{
+    Json::Value jsonValue;
+    const struct {
+        const char * name;
+        double * value;
+    } fields[] = {{"period", &Policy.period},
+                  {"period-max", &Policy.period_max},
+                  {"cpu-budget", &Policy.cpu_budget},
+                  {"battery-period", &Policy.battery_period},
+                  {"report-interval", &Policy.report_interval}};
+    for (const auto & field : fields) {
+        jsonValue = jsonConfig[field.name];
+        if (!jsonValue.empty()) {
+            if (!jsonValue.isNumeric() || (jsonValue.asDouble() < 0.0)) {
+                CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitQtRefresh::Configure: \""
+                                   << field.name << "\" must be a positive number" << std::endl;
+                return false;
+            }
+            *(field.value) = jsonValue.asDouble();
+        }
+    }
+    if (Policy.period <= 0.0) {
+        CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitQtRefresh::Configure: \"period\" can't be 0" << std::endl;
+        return false;
+    }
+    Policy.current_period = Policy.period;
+    return true;
+}
+
+bool mtsIntuitiveResearchKitQtRefresh::Due(const QWidget * widget)
+{
+    // hidden tab or minimized window
+    if (!widget->isVisible()
+        || (widget->window() && widget->window()->isMinimized())) {
+        return false;
+    }
+    const double now = osaGetTime();
+    // 1 ms tolerance so a timer with the same period doesn't skip every other tick
+    if ((now - mLastRefresh) < (Policy.current_period - 1.0 * cmn_ms)) {
+        return false;
+    }
+    mLastRefresh = now;
+    mStart = RefreshTime();
+    return true;
+}
+
+void mtsIntuitiveResearchKitQtRefresh::End(void)
+{
+    const double elapsed = RefreshTime() - mStart;
+    Policy.window_time += elapsed;
+    Policy.total_time += elapsed;
+    ++Policy.window_refreshes;
+    EvaluateWindow(osaGetTime());
+}
+
+double mtsIntuitiveResearchKitQtRefresh::Period(void)
+{
+    return Policy.current_period;
+}
+
+double mtsIntuitiveResearchKitQtRefresh::Load(void)
+{
+    return Policy.load;
+}
+
+double mtsIntuitiveResearchKitQtRefresh::TotalTime(void)
+{
+    return Policy.total_time;
+}
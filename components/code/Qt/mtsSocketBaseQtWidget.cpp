@@ -42,6 +42,9 @@ mtsSocketBaseQtWidget::mtsSocketBaseQtWidget(const std::string & componentName,
         interfaceRequired->AddFunction("GetPacketsLost", SocketBase.GetPacketsLost);
         interfaceRequired->AddFunction("GetPacketsDelayed", SocketBase.GetPacketsDelayed);
         interfaceRequired->AddFunction("GetLoopTime", SocketBase.GetLoopTime);
+        interfaceRequired->AddFunction("GetOneWayLatency", SocketBase.GetOneWayLatency);
+        interfaceRequired->AddFunction("GetJitter", SocketBase.GetJitter);
+        interfaceRequired->AddFunction("GetClockOffset", SocketBase.GetClockOffset);
         interfaceRequired->AddFunction("GetLastReceivedPacketId", SocketBase.GetLastReceivedPacketId);
         interfaceRequired->AddFunction("GetLastSentPacketId", SocketBase.GetLastSentPacketId);
         interfaceRequired->AddFunction("period_statistics", SocketBase.period_statistics);
@@ -82,10 +85,11 @@ void mtsSocketBaseQtWidget::closeEvent(QCloseEvent * event)
 
 void mtsSocketBaseQtWidget::timerEvent(QTimerEvent * CMN_UNUSED(event))
 {
-    // make sure we should update the display
-    if (this->isHidden()) {
+    // make sure we should update the display, see global refresh policy
+    if (!RefreshPolicy.Due(this)) {
         return;
     }
+    mtsIntuitiveResearchKitQtRefresh::Scope refreshScope(RefreshPolicy);
 
     unsigned int packet;
     SocketBase.GetLastSentPacketId(packet);
@@ -104,6 +108,14 @@ void mtsSocketBaseQtWidget::timerEvent(QTimerEvent * CMN_UNUSED(event))
     SocketBase.GetLoopTime(loopTime);
     SocketBase.QLLoopTime->setText(QString::number(loopTime * 1000.0, 'g', 3));
 
+    double time;
+    SocketBase.GetOneWayLatency(time);
+    SocketBase.QLOneWayLatency->setText(QString::number(time * 1000.0, 'g', 3));
+    SocketBase.GetJitter(time);
+    SocketBase.QLJitter->setText(QString::number(time * 1000.0, 'g', 3));
+    SocketBase.GetClockOffset(time);
+    SocketBase.QLClockOffset->setText(QString::number(time * 1000.0, 'g', 6));
+
     SocketBase.period_statistics(IntervalStatistics);
     QMIntervalStatistics->SetValue(IntervalStatistics);
 }
@@ -146,6 +158,21 @@ void mtsSocketBaseQtWidget::setupUi(void)
     SocketBase.QLLoopTime = new QLabel();
     grid->addWidget(SocketBase.QLLoopTime, row, 1);
     row++;
+
+    grid->addWidget(new QLabel("One way latency (ms)"), row, 0);
+    SocketBase.QLOneWayLatency = new QLabel();
+    grid->addWidget(SocketBase.QLOneWayLatency, row, 1);
+    row++;
+
+    grid->addWidget(new QLabel("Jitter (ms)"), row, 0);
+    SocketBase.QLJitter = new QLabel();
+    grid->addWidget(SocketBase.QLJitter, row, 1);
+    row++;
+
+    grid->addWidget(new QLabel("Clock offset (ms)"), row, 0);
+    SocketBase.QLClockOffset = new QLabel();
+    grid->addWidget(SocketBase.QLClockOffset, row, 1);
+    row++;
     socketlayout->addStretch();
 
     // timing
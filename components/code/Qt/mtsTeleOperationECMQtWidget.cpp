@@ -112,10 +112,11 @@ void mtsTeleOperationECMQtWidget::closeEvent(QCloseEvent * event)
 
 void mtsTeleOperationECMQtWidget::timerEvent(QTimerEvent * CMN_UNUSED(event))
 {
-    // make sure we should update the display
-    if (this->isHidden()) {
+    // make sure we should update the display, see global refresh policy
+    if (!m_refresh.Due(this)) {
         return;
     }
+    mtsIntuitiveResearchKitQtRefresh::Scope refreshScope(m_refresh);
 
     // retrieve transformations
     TeleOperation.MTML_measured_cp(m_MTML_measured_cp);
@@ -65,6 +65,7 @@ mtsTeleOperationPSMQtWidget::mtsTeleOperationPSMQtWidget(const std::string & com
         interfaceRequired->AddFunction("alignment_offset", TeleOperation.alignment_offset);
         interfaceRequired->AddFunction("registration_rotation", TeleOperation.registration_rotation);
         interfaceRequired->AddFunction("period_statistics", TeleOperation.period_statistics);
+        interfaceRequired->AddFunction("gui_snapshot", TeleOperation.gui_snapshot, MTS_OPTIONAL);
         // events
         interfaceRequired->AddEventHandlerWrite(&mtsTeleOperationPSMQtWidget::DesiredStateEventHandler,
                                                 this, "desired_state");
@@ -126,18 +127,32 @@ void mtsTeleOperationPSMQtWidget::closeEvent(QCloseEvent * event)
 
 void mtsTeleOperationPSMQtWidget::timerEvent(QTimerEvent * CMN_UNUSED(event))
 {
-    // make sure we should update the display
-    if (this->isHidden()) {
+    // make sure we should update the display, see global refresh policy
+    if (!m_refresh.Due(this)) {
         return;
     }
-
-    // retrieve transformations
-    TeleOperation.MTM_measured_cp(m_MTM_measured_cp);
+    mtsIntuitiveResearchKitQtRefresh::Scope refreshScope(m_refresh);
+
+    // retrieve transformations, single read if available
+    if (TeleOperation.gui_snapshot.IsValid()) {
+        TeleOperation.gui_snapshot(m_snapshot);
+        // first snapshot is empty, see mtsTeleOperationPSM::gui_snapshot
+        if (m_snapshot.timestamp == 0.0) {
+            return;
+        }
+        m_snapshot.MTM_measured_cp.To(m_MTM_measured_cp);
+        m_snapshot.PSM_setpoint_cp.To(m_PSM_setpoint_cp);
+        m_registration_rotation.Assign(m_snapshot.registration_rotation);
+        m_alignment_offset.Assign(m_snapshot.alignment_offset);
+    } else {
+        TeleOperation.MTM_measured_cp(m_MTM_measured_cp);
+        TeleOperation.PSM_setpoint_cp(m_PSM_setpoint_cp);
+        TeleOperation.registration_rotation(m_registration_rotation);
+        TeleOperation.alignment_offset(m_alignment_offset);
+    }
     QCPGMTMWidget->SetValue(m_MTM_measured_cp);
 
     // for PSM, check if the registration rotation is needed
-    TeleOperation.PSM_setpoint_cp(m_PSM_setpoint_cp);
-    TeleOperation.registration_rotation(m_registration_rotation);
     if (m_registration_rotation.Equal(vctMatRot3::Identity())) {
         QCPGPSMWidget->SetValue(m_PSM_setpoint_cp);
     } else {
@@ -154,7 +169,6 @@ void mtsTeleOperationPSMQtWidget::timerEvent(QTimerEvent * CMN_UNUSED(event))
     }
 
     // alignment offset
-    TeleOperation.alignment_offset(m_alignment_offset);
     QVRAlignOffset->SetValue(m_alignment_offset);
 
     TeleOperation.period_statistics(m_interval_statistics);
@@ -118,7 +118,8 @@ void mtsDaVinciHeadSensor::HeadSensorEventHandler(const size_t sensorNumber,
     // changed
     prmEventButton payload;
     payload.SetValid(true);
-    payload.SetTimestamp(StateTable.GetTic());
+    // keep timestamp of the sensor edge so latency can be measured downstream
+    payload.SetTimestamp((event.Timestamp() > 0.0) ? event.Timestamp() : StateTable.GetTic());
     if (operatorPresent) {
         payload.SetType(prmEventButton::PRESSED);
         MessageEvents.OperatorPresent(payload);
@@ -18,6 +18,10 @@ http://www.cisst.org/cisst/license.txt.
 
 // system include
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
 #include <time.h>
 
 // cisst
@@ -25,12 +29,16 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstNumerical/nmrIsOrthonormal.h>
 #include <cisstMultiTask/mtsInterfaceProvided.h>
 #include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <cisstMultiTask/mtsManagerLocal.h>
 #include <cisstParameterTypes/prmEventButton.h>
 #include <sawControllers/osaCartesianImpedanceController.h>
 
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitRevision.h>
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitConfig.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArm.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRecorder.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
+#include <sawIntuitiveResearchKit/robManipulatorFixed.h>
 
 CMN_IMPLEMENT_SERVICES_DERIVED_ONEARG(mtsIntuitiveResearchKitArm, mtsTaskPeriodic, mtsTaskPeriodicConstructorArg);
 
@@ -39,6 +47,7 @@ mtsIntuitiveResearchKitArm::mtsIntuitiveResearchKitArm(const std::string & compo
     mArmState(componentName, "DISABLED"),
     mStateTableState(100, "State"),
     mStateTableConfiguration(100, "Configuration"),
+    mStateTableJacobian(mtsIntuitiveResearchKit::JacobianStateTableSize, "Jacobian"),
     mControlCallback(0)
 {
     mCartesianImpedanceController = new osaCartesianImpedanceController();
@@ -49,6 +58,7 @@ mtsIntuitiveResearchKitArm::mtsIntuitiveResearchKitArm(const mtsTaskPeriodicCons
     mArmState(arg.Name, "DISABLED"),
     mStateTableState(100, "State"),
     mStateTableConfiguration(100, "Configuration"),
+    mStateTableJacobian(mtsIntuitiveResearchKit::JacobianStateTableSize, "Jacobian"),
     mControlCallback(0)
 {
     mCartesianImpedanceController = new osaCartesianImpedanceController();
@@ -62,6 +72,9 @@ mtsIntuitiveResearchKitArm::~mtsIntuitiveResearchKitArm()
     if (mCartesianImpedanceController) {
         delete mCartesianImpedanceController;
     }
+    if (m_kinematics) {
+        delete m_kinematics;
+    }
 }
 
 void mtsIntuitiveResearchKitArm::CreateManipulator(void)
@@ -72,8 +85,30 @@ void mtsIntuitiveResearchKitArm::CreateManipulator(void)
     Manipulator = new robManipulator();
 }
 
+namespace {
+    // samples kept between GUI snapshots, 20 ms at 1.5 kHz is 30
+    // samples so this leaves room for slow refreshes
+    const size_t GUI_PLOT_CAPACITY = 512;
+    // stop sampling if no widget read the snapshot for this long
+    const double GUI_PLOT_TIMEOUT = 1.0;
+}
+
 void mtsIntuitiveResearchKitArm::Init(void)
 {
+    // buffers for plots, allocated once
+    m_gui_snapshot.plot_time.SetSize(GUI_PLOT_CAPACITY, 0.0);
+    m_gui_snapshot.plot_tool_effort.SetSize(GUI_PLOT_CAPACITY, 0.0);
+    m_gui_snapshot.data.plot_time.SetSize(GUI_PLOT_CAPACITY, 0.0);
+    m_gui_snapshot.data.plot_tool_effort.SetSize(GUI_PLOT_CAPACITY, 0.0);
+
+    // messages that can be sent every cycle
+    m_message_sites.servo_cp_ik =
+        m_messages.AddSite(mtsIntuitiveResearchKitMessages::LEVEL_ERROR,
+                           "servo_cp, unable to solve inverse kinematics");
+    m_message_sites.joint_filter_budget =
+        m_messages.AddSite(mtsIntuitiveResearchKitMessages::LEVEL_WARNING,
+                           "joint filter exceeded its time budget");
+
     // configure state machine common to all arms (ECM/MTM/PSM)
     // possible states
     mArmState.AddState("POWERING");
@@ -178,15 +213,15 @@ void mtsIntuitiveResearchKitArm::Init(void)
                                this);
 
     // state table to maintain state :-)
-    mStateTableState.AddData(mStateTableStateDesired, "desired_state");
+    AddStateData(mStateTableState, mStateTableStateDesired, "desired_state");
     m_operating_state.SetValid(true);
-    mStateTableState.AddData(m_operating_state, "operating_state");
+    AddStateData(mStateTableState, m_operating_state, "operating_state");
     AddStateTable(&mStateTableState);
     mStateTableState.SetAutomaticAdvance(false);
 
     // state table for configuration
-    mStateTableConfiguration.AddData(m_kin_configuration_js, "kin/configuration_js");
-    mStateTableConfiguration.AddData(m_pid_configuration_js, "pid/configuration_js");
+    AddStateData(mStateTableConfiguration, m_kin_configuration_js, "kin/configuration_js");
+    AddStateData(mStateTableConfiguration, m_pid_configuration_js, "pid/configuration_js");
     AddStateTable(&mStateTableConfiguration);
     mStateTableConfiguration.SetAutomaticAdvance(false);
 
@@ -206,7 +241,7 @@ void mtsIntuitiveResearchKitArm::Init(void)
 
     m_effort_orientation_locked = false;
 
-    mSafeForCartesianControlCounter = 0;
+    mSafeForCartesianControlTimeLastMessage = 0.0;
     mArmNotReadyCounter = 0;
     mArmNotReadyTimeLastMessage = 0.0;
 
@@ -221,9 +256,12 @@ void mtsIntuitiveResearchKitArm::Init(void)
     m_trajectory_j.a.SetSize(NumberOfJoints());
     m_trajectory_j.goal.SetSize(NumberOfJoints());
     m_trajectory_j.goal_v.SetSize(NumberOfJoints());
+    m_trajectory_j.goal_relative.SetSize(NumberOfJoints());
     m_trajectory_j.goal_error.SetSize(NumberOfJoints());
     m_trajectory_j.goal_tolerance.SetSize(NumberOfJoints());
     m_trajectory_j.is_active = false;
+    m_trajectory_c.is_active = false;
+    trajectory_queue_allocate(mtsIntuitiveResearchKit::TrajectoryQueueSize);
 
     // initialize velocity
     m_measured_cv.SetVelocityLinear(vct3(0.0));
@@ -235,12 +273,13 @@ void mtsIntuitiveResearchKitArm::Init(void)
 
     // jacobian
     ResizeKinematicsData();
-    this->StateTable.AddData(m_body_jacobian, "body_jacobian");
-    this->StateTable.AddData(m_spatial_jacobian, "spatial_jacobian");
+    // jacobians are large and rarely needed in history, separate table
+    // so its size can be set independently, see "state-tables"
+    AddStateData(mStateTableJacobian, m_body_jacobian, "body_jacobian");
+    AddStateData(mStateTableJacobian, m_spatial_jacobian, "spatial_jacobian");
+    AddStateTable(&mStateTableJacobian);
 
-    // efforts for kinematics
-    mEffortJointSet.SetSize(NumberOfJointsKinematics());
-    mEffortJointSet.ForceTorque().SetAll(0.0);
+    // estimated wrench
     m_body_measured_cf.SetValid(false);
     m_spatial_measured_cf.SetValid(false);
 
@@ -251,41 +290,62 @@ void mtsIntuitiveResearchKitArm::Init(void)
     m_measured_cp.SetAutomaticTimestamp(false); // based on PID timestamp
     m_measured_cp.SetReferenceFrame(GetName() + "_base");
     m_measured_cp.SetMovingFrame(GetName());
-    this->StateTable.AddData(m_measured_cp, "measured_cp");
+    AddStateData(StateTable, m_measured_cp, "measured_cp");
 
     m_setpoint_cp.SetAutomaticTimestamp(false); // based on PID timestamp
     m_setpoint_cp.SetReferenceFrame(GetName() + "_base");
     m_setpoint_cp.SetMovingFrame(GetName() + "_setpoint");
-    this->StateTable.AddData(m_setpoint_cp, "setpoint_cp");
+    AddStateData(StateTable, m_setpoint_cp, "setpoint_cp");
 
     m_local_measured_cp.SetAutomaticTimestamp(false); // based on PID timestamp
     m_local_measured_cp.SetReferenceFrame(GetName() + "_base");
     m_local_measured_cp.SetMovingFrame(GetName());
-    this->StateTable.AddData(m_local_measured_cp, "local/measured_cp");
+    AddStateData(StateTable, m_local_measured_cp, "local/measured_cp");
 
     m_local_setpoint_cp.SetAutomaticTimestamp(false); // based on PID timestamp
     m_local_setpoint_cp.SetReferenceFrame(GetName() + "_base");
     m_local_setpoint_cp.SetMovingFrame(GetName() + "_setpoint");
-    this->StateTable.AddData(m_local_setpoint_cp, "local/setpoint_cp");
+    AddStateData(StateTable, m_local_setpoint_cp, "local/setpoint_cp");
 
-    this->StateTable.AddData(m_base_frame, "base_frame");
+    AddStateData(StateTable, m_base_frame, "base_frame");
 
     m_measured_cv.SetAutomaticTimestamp(false); // keep PID timestamp
     m_measured_cv.SetMovingFrame(GetName());
     m_measured_cv.SetReferenceFrame(GetName() + "_base");
-    this->StateTable.AddData(m_measured_cv, "measured_cv");
+    AddStateData(StateTable, m_measured_cv, "measured_cv");
 
     m_body_measured_cf.SetAutomaticTimestamp(false); // keep PID timestamp
-    this->StateTable.AddData(m_body_measured_cf, "body/measured_cf");
+    AddStateData(StateTable, m_body_measured_cf, "body/measured_cf");
 
     m_spatial_measured_cf.SetAutomaticTimestamp(false); // keep PID timestamp
-    this->StateTable.AddData(m_spatial_measured_cf, "spatial/measured_cf");
+    AddStateData(StateTable, m_spatial_measured_cf, "spatial/measured_cf");
+
+    m_servo_cp_latency.SetAll(0.0);
+    m_servo_cp_latency_samples = 0;
+    AddStateData(StateTable, m_servo_cp_latency, "servo_cp/latency");
+    m_servo_commands.sequence = 0;
+
+    // accessors used by read commands for demand driven derived state
+    m_derived_state.local_setpoint_cp_accessor = this->StateTable.GetAccessorByInstance(m_local_setpoint_cp);
+    m_derived_state.setpoint_cp_accessor = this->StateTable.GetAccessorByInstance(m_setpoint_cp);
+    m_derived_state.measured_cv_accessor = this->StateTable.GetAccessorByInstance(m_measured_cv);
+    m_derived_state.body_jacobian_accessor = this->mStateTableJacobian.GetAccessorByInstance(m_body_jacobian);
+    m_derived_state.spatial_jacobian_accessor = this->mStateTableJacobian.GetAccessorByInstance(m_spatial_jacobian);
 
     m_kin_measured_js.SetAutomaticTimestamp(false); // keep PID timestamp
-    this->StateTable.AddData(m_kin_measured_js, "kin/measured_js");
+    AddStateData(StateTable, m_kin_measured_js, "kin/measured_js");
 
     m_kin_setpoint_js.SetAutomaticTimestamp(false); // keep PID timestamp
-    this->StateTable.AddData(m_kin_setpoint_js, "kin/setpoint_js");
+    AddStateData(StateTable, m_kin_setpoint_js, "kin/setpoint_js");
+
+    // accessors used to read all measured values at the same index
+    m_measured_bundle.measured_js_accessor = this->StateTable.GetAccessorByInstance(m_kin_measured_js);
+    m_measured_bundle.setpoint_js_accessor = this->StateTable.GetAccessorByInstance(m_kin_setpoint_js);
+    m_measured_bundle.measured_cp_accessor = this->StateTable.GetAccessorByInstance(m_measured_cp);
+    m_measured_bundle.body_measured_cf_accessor = this->StateTable.GetAccessorByInstance(m_body_measured_cf);
+    m_wrench_estimation.body_cf_accessor = m_measured_bundle.body_measured_cf_accessor;
+    m_wrench_estimation.spatial_cf_accessor = this->StateTable.GetAccessorByInstance(m_spatial_measured_cf);
+    m_measured_bundle.operating_state_accessor = this->mStateTableState.GetAccessorByInstance(m_operating_state);
 
     // PID
     PIDInterface = AddInterfaceRequired("PID");
@@ -324,6 +384,8 @@ void mtsIntuitiveResearchKitArm::Init(void)
         IOInterface->AddFunction("UsePotsForSafetyCheck", IO.UsePotsForSafetyCheck);
         IOInterface->AddFunction("BrakeRelease", IO.BrakeRelease);
         IOInterface->AddFunction("BrakeEngage", IO.BrakeEngage);
+        IOInterface->AddFunction("measured_js", IO.measured_js, MTS_OPTIONAL);
+        IOInterface->AddFunction("GetAnalogInputPosSI", IO.GetAnalogInputPosSI, MTS_OPTIONAL);
         IOInterface->AddEventHandlerWrite(&mtsIntuitiveResearchKitArm::BiasEncoderEventHandler, this, "BiasEncoder");
     }
 
@@ -337,44 +399,62 @@ void mtsIntuitiveResearchKitArm::Init(void)
         m_arm_interface->AddCommandReadState(this->StateTable, m_kin_measured_js, "measured_js");
         m_arm_interface->AddCommandReadState(this->StateTable, m_kin_setpoint_js, "setpoint_js");
         m_arm_interface->AddCommandReadState(this->StateTable, m_local_measured_cp, "local/measured_cp");
-        m_arm_interface->AddCommandReadState(this->StateTable, m_local_setpoint_cp, "local/setpoint_cp");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::local_setpoint_cp,
+                                        this, "local/setpoint_cp");
         m_arm_interface->AddCommandReadState(this->StateTable, m_measured_cp, "measured_cp");
-        m_arm_interface->AddCommandReadState(this->StateTable, m_setpoint_cp, "setpoint_cp");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::setpoint_cp,
+                                        this, "setpoint_cp");
         m_arm_interface->AddCommandReadState(this->StateTable, m_base_frame, "base_frame");
-        m_arm_interface->AddCommandReadState(this->StateTable, m_measured_cv, "measured_cv");
-        m_arm_interface->AddCommandReadState(this->StateTable, m_body_measured_cf, "body/measured_cf");
-        m_arm_interface->AddCommandReadState(this->StateTable, m_body_jacobian, "body/jacobian");
-        m_arm_interface->AddCommandReadState(this->StateTable, m_spatial_measured_cf, "spatial/measured_cf");
-        m_arm_interface->AddCommandReadState(this->StateTable, m_spatial_jacobian, "spatial/jacobian");
+        m_arm_interface->AddCommandReadState(this->StateTable, m_servo_cp_latency, "servo_cp/latency");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::measured_cv,
+                                        this, "measured_cv");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::body_measured_cf,
+                                        this, "body/measured_cf");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::body_jacobian,
+                                        this, "body/jacobian", m_body_jacobian);
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::spatial_measured_cf,
+                                        this, "spatial/measured_cf");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::spatial_jacobian,
+                                        this, "spatial/jacobian", m_spatial_jacobian);
         m_arm_interface->AddCommandReadState(this->mStateTableState,
                                              m_operating_state, "operating_state");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::measured_bundle,
+                                        this, "measured_bundle");
         // Set
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::set_base_frame,
                                          this, "set_base_frame");
         m_arm_interface->AddCommandVoid(&mtsIntuitiveResearchKitArm::Freeze,
                                         this, "Freeze");
-        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::servo_jp,
-                                         this, "servo_jp");
+        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::servo_jp_latest,
+                                         this, "servo_jp", prmPositionJointSet(), MTS_COMMAND_NOT_QUEUED);
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::servo_jr,
                                          this, "servo_jr");
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::move_jp,
                                          this, "move_jp");
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::move_jr,
                                          this, "move_jr");
-        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::servo_cp,
-                                         this, "servo_cp");
+        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::servo_cp_latest,
+                                         this, "servo_cp", prmPositionCartesianSet(), MTS_COMMAND_NOT_QUEUED);
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::servo_cr,
                                          this, "servo_cr_not_working_yet");
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::move_cp,
                                          this, "move_cp");
-        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::servo_jf,
-                                         this, "servo_jf");
-        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::body_servo_cf,
-                                         this, "body/servo_cf");
+        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::move_jp_queue,
+                                         this, "move_jp_queue");
+        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::move_cp_queue,
+                                         this, "move_cp_queue");
+        m_arm_interface->AddCommandVoid(&mtsIntuitiveResearchKitArm::trajectory_queue_clear,
+                                        this, "trajectory_queue/clear");
+        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::servo_jf_latest,
+                                         this, "servo_jf", prmForceTorqueJointSet(), MTS_COMMAND_NOT_QUEUED);
+        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::body_servo_cf_latest,
+                                         this, "body/servo_cf", prmForceCartesianSet(), MTS_COMMAND_NOT_QUEUED);
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::body_set_cf_orientation_absolute,
                                          this, "body/set_cf_orientation_absolute");
-        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::spatial_servo_cf,
-                                         this, "spatial/servo_cf");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::body_cf_orientation_absolute,
+                                        this, "body/cf_orientation_absolute");
+        m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::spatial_servo_cf_latest,
+                                         this, "spatial/servo_cf", prmForceCartesianSet(), MTS_COMMAND_NOT_QUEUED);
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::use_gravity_compensation,
                                          this, "use_gravity_compensation");
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::set_cartesian_impedance_gains,
@@ -395,6 +475,7 @@ void mtsIntuitiveResearchKitArm::Init(void)
         m_arm_interface->AddEventWrite(m_trajectory_j.ratio_a_event, "trajectory_j/ratio_a", double());
         m_arm_interface->AddEventWrite(m_trajectory_j.ratio_event, "trajectory_j/ratio", double());
         m_arm_interface->AddEventWrite(m_trajectory_j.goal_reached_event, "goal_reached", bool());
+        m_arm_interface->AddEventWrite(m_trajectory_queue.waypoint_reached_event, "trajectory_queue/waypoint_reached", int());
         // Arm State
         m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitArm::state_command,
                                          this, "state_command", std::string(""));
@@ -406,8 +487,24 @@ void mtsIntuitiveResearchKitArm::Init(void)
         // Stats
         m_arm_interface->AddCommandReadState(StateTable, StateTable.PeriodStats,
                                              "period_statistics");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::state_tables_memory,
+                                        this, "state_tables/memory", std::string(""));
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::timing_statistics,
+                                        this, "timing_statistics");
+        m_arm_interface->AddCommandVoid(&mtsIntuitiveResearchKitArm::timing_statistics_reset,
+                                        this, "timing_statistics_reset");
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::servo_statistics,
+                                        this, "servo_statistics");
+        m_arm_interface->AddCommandVoid(&mtsIntuitiveResearchKitArm::servo_statistics_reset,
+                                        this, "servo_statistics_reset");
+
+        // GUI
+        m_arm_interface->AddCommandRead(&mtsIntuitiveResearchKitArm::gui_snapshot,
+                                        this, "gui_snapshot");
     }
 
+    TimingInit();
+
     // SetState will send log events, it needs to happen after the
     // provided interface has been created
     SetDesiredState("DISABLED");
@@ -465,6 +562,8 @@ void mtsIntuitiveResearchKitArm::state_command(const std::string & command)
                 return;
             }
             if (command == "unhome") {
+                m_calibration_snapshot.Invalidate();
+                m_calibration_restored = false;
                 UnHome();
                 UpdateHomed(false);
                 return;
@@ -486,67 +585,317 @@ void mtsIntuitiveResearchKitArm::state_command(const std::string & command)
     }
 }
 
-void mtsIntuitiveResearchKitArm::UpdateConfigurationJointKinematic(void)
+void mtsIntuitiveResearchKitArm::PrepareKinematicsData(robManipulator & manipulator,
+                                                       const size_t numberOfJoints,
+                                                       KinematicsDataType & data) const
 {
+    data.number_of_joints = numberOfJoints;
+
     // get names, types and joint limits for kinematics config from the manipulator
     // name and types need conversion
-    mStateTableConfiguration.Start();
-    m_kin_configuration_js.Name().SetSize(NumberOfJointsKinematics());
-    m_kin_configuration_js.Type().SetSize(NumberOfJointsKinematics());
-    const size_t jointsConfiguredSoFar = this->Manipulator->links.size();
+    data.configuration_js.Name().SetSize(numberOfJoints);
+    data.configuration_js.Type().SetSize(numberOfJoints);
+    const size_t jointsConfiguredSoFar = manipulator.links.size();
     std::vector<std::string> names(jointsConfiguredSoFar);
     std::vector<robJoint::Type> types(jointsConfiguredSoFar);
-    this->Manipulator->GetJointNames(names);
-    this->Manipulator->GetJointTypes(types);
+    manipulator.GetJointNames(names);
+    manipulator.GetJointTypes(types);
     for (size_t index = 0; index < jointsConfiguredSoFar; ++index) {
-        m_kin_configuration_js.Name().at(index) = names.at(index);
+        data.configuration_js.Name().at(index) = names.at(index);
         switch (types.at(index)) {
         case robJoint::HINGE:
-            m_kin_configuration_js.Type().at(index) = PRM_JOINT_REVOLUTE;
+            data.configuration_js.Type().at(index) = PRM_JOINT_REVOLUTE;
             break;
         case robJoint::SLIDER:
-            m_kin_configuration_js.Type().at(index) = PRM_JOINT_PRISMATIC;
+            data.configuration_js.Type().at(index) = PRM_JOINT_PRISMATIC;
             break;
         default:
-            m_kin_configuration_js.Type().at(index) = PRM_JOINT_UNDEFINED;
+            data.configuration_js.Type().at(index) = PRM_JOINT_UNDEFINED;
             break;
         }
     }
     // position limits can be read as is
-    m_kin_configuration_js.PositionMin().SetSize(NumberOfJointsKinematics());
-    m_kin_configuration_js.PositionMax().SetSize(NumberOfJointsKinematics());
-    this->Manipulator->GetJointLimits(m_kin_configuration_js.PositionMin().Ref(jointsConfiguredSoFar),
-                                      m_kin_configuration_js.PositionMax().Ref(jointsConfiguredSoFar));
+    data.configuration_js.PositionMin().SetSize(numberOfJoints);
+    data.configuration_js.PositionMax().SetSize(numberOfJoints);
+    manipulator.GetJointLimits(data.configuration_js.PositionMin().Ref(jointsConfiguredSoFar),
+                               data.configuration_js.PositionMax().Ref(jointsConfiguredSoFar));
+
+    // fixed size kinematics if available, then single pass
+    robManipulatorFixedBase * fixedSize = dynamic_cast<robManipulatorFixedBase *>(&manipulator);
+    if (fixedSize) {
+        fixedSize->ConfigureFixedSize();
+    }
+    data.evaluator.Configure(manipulator);
+
+    // wrench estimation
+    data.estimator.SetMethod(m_wrench_estimation.method);
+    data.estimator.SetDamping(m_wrench_estimation.damping);
+    data.estimator.Configure(numberOfJoints);
+    data.wrench_staging.jacobian.SetSize(6, numberOfJoints);
+    data.wrench_staging.jacobian.SetAll(0.0);
+    data.wrench_staging.effort.SetSize(numberOfJoints);
+    data.wrench_staging.effort.SetAll(0.0);
+    data.wrench_staging.valid = false;
+    // data is not shared yet so we can write and fetch to size all
+    // three buffers, the arm never allocates when publishing
+    for (size_t buffer = 0; buffer < 3; ++buffer) {
+        data.wrench_latest.Write(data.wrench_staging, 0);
+        data.wrench_latest.Fetch();
+    }
+
+    // efforts
+    data.effort_set.SetSize(numberOfJoints);
+    data.effort_set.ForceTorque().SetAll(0.0);
+    data.effort.SetSize(numberOfJoints);
+    data.effort.SetAll(0.0);
+    data.effort_preload.SetSize(numberOfJoints);
+    data.effort_preload.SetAll(0.0);
+}
+
+void mtsIntuitiveResearchKitArm::SwapKinematicsData(KinematicsDataType * & data)
+{
+    // configuration_js is in a state table, assign names and types
+    // already converted
+    mStateTableConfiguration.Start();
+    m_kin_configuration_js = data->configuration_js;
     mStateTableConfiguration.Advance();
+
+    // jacobians are in a state table, can't swap
+    m_body_jacobian.SetSize(6, data->number_of_joints);
+    m_body_jacobian.SetAll(0.0);
+    m_spatial_jacobian.SetSize(6, data->number_of_joints);
+    m_spatial_jacobian.SetAll(0.0);
+
+    // lazy readers use the estimator and outputs, keep them out
+    // while these are swapped
+    m_wrench_estimation.readers_mutex.Lock();
+    std::swap(m_kinematics, data);
+    m_wrench_estimation.published_valid = false;
+    m_wrench_estimation.body_cf.Force().SetAll(0.0);
+    m_wrench_estimation.body_cf.SetValid(false);
+    m_wrench_estimation.spatial_cf.Force().SetAll(0.0);
+    m_wrench_estimation.spatial_cf.SetValid(false);
+    m_wrench_estimation.readers_mutex.Unlock();
+
+    SaveRobotDataBuffersPointers();
 }
 
 void mtsIntuitiveResearchKitArm::ResizeKinematicsData(void)
 {
-    m_body_jacobian.SetSize(6, NumberOfJointsKinematics());
-    m_spatial_jacobian.SetSize(6, NumberOfJointsKinematics());
-    m_body_jacobian_transpose.ForceAssign(m_body_jacobian.Transpose());
-    m_spatial_jacobian_transpose.ForceAssign(m_spatial_jacobian.Transpose());
-    mJacobianPInverseData.Allocate(m_body_jacobian_transpose);
-    mEffortJointSet.SetSize(NumberOfJointsKinematics());
-    mEffortJointSet.ForceTorque().SetAll(0.0);
-    mEffortJoint.SetSize(NumberOfJointsKinematics());
-    mEffortJoint.SetAll(0.0);
+    KinematicsDataType * data = new KinematicsDataType;
+    PrepareKinematicsData(*Manipulator, NumberOfJointsKinematics(), *data);
+    SwapKinematicsData(data);
+    if (data) {
+        delete data;
+    }
+    m_wrench_estimation.wrench.SetSize(6);
+    m_wrench_estimation.spatial_wrench.SetSize(6);
+    // buffers used in GetRobotData
+    m_robot_data_buffers.actuator_amp_status.SetSize(NumberOfJoints());
+    m_robot_data_buffers.brake_amp_status.SetSize(NumberOfBrakes());
+    m_robot_data_buffers.cartesian_velocity.SetSize(6);
+    SaveRobotDataBuffersPointers();
+}
+
+void mtsIntuitiveResearchKitArm::SaveRobotDataBuffersPointers(void)
+{
+    m_robot_data_buffers.pointers.resize(5);
+    m_robot_data_buffers.pointers[0] = m_robot_data_buffers.actuator_amp_status.Pointer();
+    m_robot_data_buffers.pointers[1] = m_robot_data_buffers.brake_amp_status.Pointer();
+    m_robot_data_buffers.pointers[2] = m_robot_data_buffers.cartesian_velocity.Pointer();
+    m_robot_data_buffers.pointers[3] = m_body_jacobian.Pointer();
+    m_robot_data_buffers.pointers[4] = m_spatial_jacobian.Pointer();
+}
+
+void mtsIntuitiveResearchKitArm::CheckRobotDataBuffersPointers(void)
+{
+    if ((m_robot_data_buffers.pointers[0] != m_robot_data_buffers.actuator_amp_status.Pointer())
+        || (m_robot_data_buffers.pointers[1] != m_robot_data_buffers.brake_amp_status.Pointer())
+        || (m_robot_data_buffers.pointers[2] != m_robot_data_buffers.cartesian_velocity.Pointer())
+        || (m_robot_data_buffers.pointers[3] != m_body_jacobian.Pointer())
+        || (m_robot_data_buffers.pointers[4] != m_spatial_jacobian.Pointer())) {
+        m_robot_data_buffers.moved_buffers++;
+        CMN_LOG_CLASS_RUN_WARNING << GetName() << ": GetRobotData, preallocated buffers have been resized "
+                                  << m_robot_data_buffers.moved_buffers << " time(s)" << std::endl;
+        SaveRobotDataBuffersPointers();
+    }
+}
+
+void mtsIntuitiveResearchKitArm::EstimateWrench(const WrenchInputs & inputs) const
+{
+    vctDoubleVec & wrench = m_wrench_estimation.wrench;
+    const bool solved = m_kinematics->estimator.EstimateBody(inputs.jacobian,
+                                                                   inputs.effort,
+                                                                   wrench);
+    // spatial, derived from body
+    robWrenchEstimator::BodyToSpatial(inputs.rotation_local,
+                                      wrench, m_wrench_estimation.spatial_wrench);
+    m_wrench_estimation.spatial_cf.Force().Assign(m_wrench_estimation.spatial_wrench);
+    // body, possibly with absolute orientation
+    if (m_body_cf_orientation_absolute) {
+        vct3 relative, absolute;
+        // forces
+        relative.Assign(wrench.Ref(3, 0));
+        inputs.rotation.ApplyTo(relative, absolute);
+        m_wrench_estimation.body_cf.Force().Ref<3>(0).Assign(absolute);
+        // torques
+        relative.Assign(wrench.Ref(3, 3));
+        inputs.rotation.ApplyTo(relative, absolute);
+        m_wrench_estimation.body_cf.Force().Ref<3>(3).Assign(absolute);
+    } else {
+        m_wrench_estimation.body_cf.Force().Assign(wrench);
+    }
+    // valid/timestamp
+    const bool valid = inputs.valid && solved;
+    m_wrench_estimation.body_cf.SetValid(valid);
+    m_wrench_estimation.body_cf.SetTimestamp(inputs.timestamp);
+    m_wrench_estimation.spatial_cf.SetValid(valid);
+    m_wrench_estimation.spatial_cf.SetTimestamp(inputs.timestamp);
+}
+
+void mtsIntuitiveResearchKitArm::WrenchInputsInvalidate(void)
+{
+    // lazy readers only need to know once
+    if (m_wrench_estimation.lazy && m_wrench_estimation.published_valid) {
+        m_kinematics->wrench_staging.valid = false;
+        m_kinematics->wrench_latest.Write(m_kinematics->wrench_staging, 0);
+        m_wrench_estimation.published_valid = false;
+    }
+}
+
+void mtsIntuitiveResearchKitArm::body_measured_cf(prmForceCartesianGet & wrench) const
+{
+    DerivedStateRequest(m_derived_state.measured_cf);
+    if (!m_wrench_estimation.lazy) {
+        m_wrench_estimation.body_cf_accessor->GetLatest(wrench);
+        return;
+    }
+    m_wrench_estimation.readers_mutex.Lock();
+    if (m_kinematics->wrench_latest.Fetch()) {
+        EstimateWrench(m_kinematics->wrench_latest.Value());
+    }
+    wrench = m_wrench_estimation.body_cf;
+    m_wrench_estimation.readers_mutex.Unlock();
+}
+
+void mtsIntuitiveResearchKitArm::spatial_measured_cf(prmForceCartesianGet & wrench) const
+{
+    DerivedStateRequest(m_derived_state.measured_cf);
+    if (!m_wrench_estimation.lazy) {
+        m_wrench_estimation.spatial_cf_accessor->GetLatest(wrench);
+        return;
+    }
+    m_wrench_estimation.readers_mutex.Lock();
+    if (m_kinematics->wrench_latest.Fetch()) {
+        EstimateWrench(m_kinematics->wrench_latest.Value());
+    }
+    wrench = m_wrench_estimation.spatial_cf;
+    m_wrench_estimation.readers_mutex.Unlock();
+}
+
+bool mtsIntuitiveResearchKitArm::DerivedStateNeeded(const std::atomic<double> & lastRequest) const
+{
+    if (!m_derived_state.demand_driven) {
+        return true;
+    }
+    return ((StateTable.GetTic() - lastRequest.load()) <= m_derived_state.timeout);
+}
+
+void mtsIntuitiveResearchKitArm::DerivedStateRequest(std::atomic<double> & lastRequest) const
+{
+    if (m_derived_state.demand_driven) {
+        lastRequest.store(mtsManagerLocal::GetInstance()->GetTimeServer().GetRelativeTime());
+    }
+}
+
+void mtsIntuitiveResearchKitArm::local_setpoint_cp(prmPositionCartesianGet & pose) const
+{
+    DerivedStateRequest(m_derived_state.setpoint_cp);
+    m_derived_state.local_setpoint_cp_accessor->GetLatest(pose);
+}
+
+void mtsIntuitiveResearchKitArm::setpoint_cp(prmPositionCartesianGet & pose) const
+{
+    DerivedStateRequest(m_derived_state.setpoint_cp);
+    m_derived_state.setpoint_cp_accessor->GetLatest(pose);
+}
+
+void mtsIntuitiveResearchKitArm::measured_cv(prmVelocityCartesianGet & velocity) const
+{
+    DerivedStateRequest(m_derived_state.measured_cv);
+    m_derived_state.measured_cv_accessor->GetLatest(velocity);
+}
+
+void mtsIntuitiveResearchKitArm::measured_bundle(mtsIntuitiveResearchKitArmMeasured & bundle) const
+{
+    DerivedStateRequest(m_derived_state.setpoint_cp);
+    DerivedStateRequest(m_derived_state.measured_cv);
+    DerivedStateRequest(m_derived_state.measured_cf);
+
+    // same index for all values from the main state table
+    const mtsStateIndex index = StateTable.GetIndexReader();
+    prmStateJoint js;
+    m_measured_bundle.measured_js_accessor->Get(index, js);
+    bundle.measured_js.From(js);
+    m_measured_bundle.setpoint_js_accessor->Get(index, js);
+    bundle.setpoint_js.From(js);
+
+    prmPositionCartesianGet cp;
+    m_measured_bundle.measured_cp_accessor->Get(index, cp);
+    bundle.measured_cp.From(cp);
+    m_derived_state.setpoint_cp_accessor->Get(index, cp);
+    bundle.setpoint_cp.From(cp);
+
+    prmVelocityCartesianGet cv;
+    m_derived_state.measured_cv_accessor->Get(index, cv);
+    bundle.measured_cv_valid = cv.Valid();
+    bundle.measured_cv_timestamp = cv.Timestamp();
+    bundle.measured_cv.Ref<3>(0).Assign(cv.VelocityLinear());
+    bundle.measured_cv.Ref<3>(3).Assign(cv.VelocityAngular());
+
+    // in lazy mode, the wrench in the state table is not valid
+    prmForceCartesianGet cf;
+    if (m_wrench_estimation.lazy) {
+        body_measured_cf(cf);
+    } else {
+        m_measured_bundle.body_measured_cf_accessor->Get(index, cf);
+    }
+    bundle.body_measured_cf_valid = cf.Valid();
+    bundle.body_measured_cf_timestamp = cf.Timestamp();
+    bundle.body_measured_cf.Assign(cf.Force());
+
+    prmOperatingState state;
+    m_measured_bundle.operating_state_accessor->GetLatest(state);
+    bundle.operating_state = prmOperatingState::StateTypeToString(state.State());
+    bundle.is_homed = state.IsHomed();
+    bundle.is_busy = state.IsBusy();
+}
+
+void mtsIntuitiveResearchKitArm::body_jacobian(vctDoubleMat & jacobian) const
+{
+    DerivedStateRequest(m_derived_state.jacobian);
+    m_derived_state.body_jacobian_accessor->GetLatest(jacobian);
+}
+
+void mtsIntuitiveResearchKitArm::spatial_jacobian(vctDoubleMat & jacobian) const
+{
+    DerivedStateRequest(m_derived_state.jacobian);
+    m_derived_state.spatial_jacobian_accessor->GetLatest(jacobian);
 }
 
 void mtsIntuitiveResearchKitArm::Configure(const std::string & filename)
 {
+    m_configuration_failed = false;
     try {
-        std::ifstream jsonStream;
         Json::Value jsonConfig;
-        Json::Reader jsonReader;
 
-        jsonStream.open(filename.c_str());
-        if (!jsonReader.parse(jsonStream, jsonConfig)) {
+        std::string jsonErrors;
+        if (!mtsIntuitiveResearchKitConfigCache::Parse(filename, jsonConfig, jsonErrors)) {
             CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
                                      << ": failed to parse configuration file \""
                                      << filename << "\"\n"
-                                     << jsonReader.getFormattedErrorMessages();
-            exit(EXIT_FAILURE);
+                                     << jsonErrors;
+            ConfigurationFailure();
         }
 
         CMN_LOG_CLASS_INIT_VERBOSE << "Configure: " << this->GetName()
@@ -581,7 +930,7 @@ void mtsIntuitiveResearchKitArm::Configure(const std::string & filename)
                 CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
                                          << " using file \"" << filename << "\" can't find kinematic file \""
                                          << jsonKinematic.asString() << "\"" << std::endl;
-                exit(EXIT_FAILURE);
+                ConfigurationFailure();
             } else {
                 ConfigureDH(fileKinematic);
             }
@@ -589,6 +938,22 @@ void mtsIntuitiveResearchKitArm::Configure(const std::string & filename)
             // arm specific configuration
             PostConfigure(jsonConfig, configPath, filename);
 
+            // joint state filters, after PostConfigure so derived classes all configured
+            const Json::Value jsonJointFilters = jsonConfig["joint-filters"];
+            if (!jsonJointFilters.isNull()) {
+                robJointFilter::ContextType context;
+                context.arm_name = this->GetName();
+                context.period = ExpectedPeriod();
+                context.config_path = configPath;
+                std::string errorMessage;
+                if (!m_joint_filters.Configure(jsonJointFilters, context, errorMessage)) {
+                    CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
+                                             << ", failed to configure \"joint-filters\": "
+                                             << errorMessage << std::endl;
+                    ConfigurationFailure();
+                }
+            }
+
         } else {
             std::stringstream message;
             message << "Configure " << this->GetName() << ":" << std::endl
@@ -600,7 +965,7 @@ void mtsIntuitiveResearchKitArm::Configure(const std::string & filename)
                     << "----------------------------------------------------";
             std::cerr << "mtsIntuitiveResearchKitConsole::" << message.str() << std::endl;
             CMN_LOG_CLASS_INIT_ERROR << message.str() << std::endl;
-            exit(EXIT_FAILURE);
+            ConfigurationFailure();
         }
 
         // should arm go to zero position when homing, default set in Init method
@@ -615,13 +980,222 @@ void mtsIntuitiveResearchKitArm::Configure(const std::string & filename)
             m_re_home = jsonAlwaysHome.asBool();
         }
 
+        // predictive joint limit guard
+        const Json::Value jsonLimitGuard = jsonConfig["limit-guard"];
+        if (!jsonLimitGuard.isNull()) {
+            m_limit_guard.enabled = jsonLimitGuard.get("enabled", true).asBool();
+            m_limit_guard.margin = jsonLimitGuard.get("margin", 0.0).asDouble();
+            const Json::Value jsonDeceleration = jsonLimitGuard["deceleration"];
+            if (jsonDeceleration.isArray()) {
+                m_limit_guard.deceleration.SetSize(jsonDeceleration.size());
+                for (unsigned int index = 0; index < jsonDeceleration.size(); ++index) {
+                    m_limit_guard.deceleration.at(index) = jsonDeceleration[index].asDouble();
+                }
+            } else if (!jsonDeceleration.isNull()) {
+                m_limit_guard.deceleration.SetSize(NumberOfJoints());
+                m_limit_guard.deceleration.SetAll(jsonDeceleration.asDouble());
+            }
+            if ((m_limit_guard.margin < 0.0)
+                || (!m_limit_guard.deceleration.empty()
+                    && ((m_limit_guard.deceleration.size() != NumberOfJoints())
+                        || (m_limit_guard.deceleration.MinElement() <= 0.0)))) {
+                CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
+                                         << ", \"limit-guard\" requires a positive margin and "
+                                         << NumberOfJoints() << " strictly positive decelerations" << std::endl;
+                ConfigurationFailure();
+            }
+        }
+
+        // adaptive encoder bias from pots
+        const Json::Value jsonEncoderBias = jsonConfig["encoder-bias"];
+        if (!jsonEncoderBias.isNull()) {
+            m_encoder_bias.enabled = jsonEncoderBias.get("adaptive", true).asBool();
+            m_encoder_bias.min_samples = jsonEncoderBias.get("min-samples", 50).asUInt();
+            m_encoder_bias.max_samples = jsonEncoderBias.get("max-samples", 1970).asUInt();
+            m_encoder_bias.revolute_tolerance = jsonEncoderBias.get("revolute-tolerance",
+                                                                    m_encoder_bias.revolute_tolerance).asDouble();
+            m_encoder_bias.prismatic_tolerance = jsonEncoderBias.get("prismatic-tolerance",
+                                                                     m_encoder_bias.prismatic_tolerance).asDouble();
+            if ((m_encoder_bias.min_samples < 2)
+                || (m_encoder_bias.max_samples < m_encoder_bias.min_samples)
+                || (m_encoder_bias.revolute_tolerance <= 0.0)
+                || (m_encoder_bias.prismatic_tolerance <= 0.0)) {
+                CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
+                                         << ", \"encoder-bias\" requires min-samples >= 2, max-samples >= min-samples and positive tolerances"
+                                         << std::endl;
+                ConfigurationFailure();
+            }
+        }
+
+        // snapshot of calibration to skip homing after software restart
+        std::string snapshotError;
+        if (!m_calibration_snapshot.Configure(jsonConfig["calibration-snapshot"],
+                                              this->GetName(), snapshotError)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
+                                     << ", failed to configure \"calibration-snapshot\": "
+                                     << snapshotError << std::endl;
+            ConfigurationFailure();
+        }
+
+        // demand driven derived state
+        const Json::Value jsonDerivedState = jsonConfig["derived-state"];
+        if (!jsonDerivedState.isNull()) {
+            const Json::Value jsonDemandDriven = jsonDerivedState["demand-driven"];
+            if (!jsonDemandDriven.isNull()) {
+                m_derived_state.demand_driven = jsonDemandDriven.asBool();
+            }
+            const Json::Value jsonTimeout = jsonDerivedState["timeout"];
+            if (!jsonTimeout.isNull()) {
+                m_derived_state.timeout = jsonTimeout.asDouble();
+            }
+        }
+
+        // history length of state tables
+        const Json::Value jsonStateTables = jsonConfig["state-tables"];
+        if (!jsonStateTables.isNull()) {
+            const std::vector<std::pair<std::string, mtsStateTable *> > tables =
+                {{"main", &StateTable},
+                 {"state", &mStateTableState},
+                 {"configuration", &mStateTableConfiguration},
+                 {"jacobian", &mStateTableJacobian}};
+            for (const auto & table : tables) {
+                const Json::Value jsonSize = jsonStateTables[table.first];
+                if (jsonSize.isNull()) {
+                    continue;
+                }
+                if ((jsonSize.asInt() < static_cast<int>(mtsIntuitiveResearchKit::MinimumStateTableSize))
+                    || !table.second->SetSize(jsonSize.asUInt())) {
+                    CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
+                                             << ", failed to set size of state table \"" << table.first
+                                             << "\" to " << jsonSize.asInt() << ", must be at least "
+                                             << mtsIntuitiveResearchKit::MinimumStateTableSize << std::endl;
+                    ConfigurationFailure();
+                }
+            }
+        }
+
+        // per stage timing of the control loop
+        const Json::Value jsonTiming = jsonConfig["timing-statistics"];
+        if (!jsonTiming.isNull()) {
+            const Json::Value jsonEnabled = jsonTiming["enabled"];
+            if (!jsonEnabled.isNull()) {
+                m_timing.enabled = jsonEnabled.asBool();
+            }
+            const Json::Value jsonInterval = jsonTiming["publish-interval"];
+            if (!jsonInterval.isNull()) {
+                m_timing.publish_interval = jsonInterval.asDouble();
+            }
+        }
+
+        // interpolation between servo goals
+        const Json::Value jsonServoInterpolation = jsonConfig["servo-interpolation"];
+        if (!jsonServoInterpolation.isNull()) {
+            const Json::Value jsonType = jsonServoInterpolation["type"];
+            if (!jsonType.isNull()) {
+                const std::string type = jsonType.asString();
+                if (type == "none") {
+                    m_servo_interpolation.type = SERVO_INTERPOLATION_NONE;
+                } else if (type == "linear") {
+                    m_servo_interpolation.type = SERVO_INTERPOLATION_LINEAR;
+                } else if (type == "minimum-jerk") {
+                    m_servo_interpolation.type = SERVO_INTERPOLATION_MINIMUM_JERK;
+                } else {
+                    CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
+                                             << ": \"servo-interpolation\" \"type\" must be either \"none\", \"linear\" or \"minimum-jerk\", found \""
+                                             << type << "\"" << std::endl;
+                    ConfigurationFailure();
+                }
+            }
+            const Json::Value jsonMaxInterval = jsonServoInterpolation["max-interval"];
+            if (!jsonMaxInterval.isNull()) {
+                m_servo_interpolation.max_interval = jsonMaxInterval.asDouble();
+            }
+        }
+
+        // cartesian trajectory limits for move_cp
+        const Json::Value jsonTrajectoryCartesian = jsonConfig["trajectory-cartesian"];
+        if (!jsonTrajectoryCartesian.isNull()) {
+            const struct {
+                const char * name;
+                double * value;
+            } limits[] = {{"v-linear", &m_trajectory_c.v_linear},
+                          {"a-linear", &m_trajectory_c.a_linear},
+                          {"v-angular", &m_trajectory_c.v_angular},
+                          {"a-angular", &m_trajectory_c.a_angular}};
+            for (const auto & limit : limits) {
+                *(limit.value) = jsonTrajectoryCartesian.get(limit.name, *(limit.value)).asDouble();
+                if (*(limit.value) <= 0.0) {
+                    CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
+                                             << ": \"trajectory-cartesian\" \"" << limit.name
+                                             << "\" must be strictly positive" << std::endl;
+                    ConfigurationFailure();
+                }
+            }
+        }
+
+        // waypoint queue for move_jp_queue and move_cp_queue
+        const Json::Value jsonTrajectoryQueue = jsonConfig["trajectory-queue"];
+        if (!jsonTrajectoryQueue.isNull()) {
+            const Json::Value jsonSize = jsonTrajectoryQueue["size"];
+            if (!jsonSize.isNull()) {
+                if (!jsonSize.isIntegral() || (jsonSize.asInt() < 1)) {
+                    CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
+                                             << ": \"trajectory-queue\" \"size\" must be a strictly positive integer" << std::endl;
+                    ConfigurationFailure();
+                }
+                trajectory_queue_allocate(jsonSize.asUInt());
+            }
+            m_trajectory_queue.blend_time = jsonTrajectoryQueue.get("blend-time", m_trajectory_queue.blend_time).asDouble();
+            if (m_trajectory_queue.blend_time < 0.0) {
+                CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
+                                         << ": \"trajectory-queue\" \"blend-time\" must be positive" << std::endl;
+                ConfigurationFailure();
+            }
+        }
+
+        // wrench estimation from joint efforts
+        const Json::Value jsonWrenchEstimation = jsonConfig["wrench-estimation"];
+        if (!jsonWrenchEstimation.isNull()) {
+            const Json::Value jsonMethod = jsonWrenchEstimation["method"];
+            if (!jsonMethod.isNull()) {
+                const std::string method = jsonMethod.asString();
+                if (method == "svd") {
+                    m_wrench_estimation.method = robWrenchEstimator::SVD;
+                } else if (method == "damped-least-squares") {
+                    m_wrench_estimation.method = robWrenchEstimator::DAMPED_LEAST_SQUARES;
+                } else {
+                    CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
+                                             << ": \"wrench-estimation\" \"method\" must be either \"svd\" or \"damped-least-squares\", found \""
+                                             << method << "\"" << std::endl;
+                    ConfigurationFailure();
+                }
+            }
+            const Json::Value jsonDamping = jsonWrenchEstimation["damping"];
+            if (!jsonDamping.isNull()) {
+                m_wrench_estimation.damping = jsonDamping.asDouble();
+            }
+            // new estimators use these, update the current one too
+            m_kinematics->estimator.SetMethod(m_wrench_estimation.method);
+            m_kinematics->estimator.SetDamping(m_wrench_estimation.damping);
+            const Json::Value jsonLazy = jsonWrenchEstimation["lazy"];
+            if (!jsonLazy.isNull()) {
+                m_wrench_estimation.lazy = jsonLazy.asBool();
+            }
+        }
+
+    } catch (ConfigurationError &) {
+        // error already logged
+        m_configuration_failed = true;
     } catch (std::exception & e) {
         CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName() << ": parsing file \""
                                  << filename << "\", got error: " << e.what() << std::endl;
-        exit(EXIT_FAILURE);
+        m_configuration_failed = true;
     } catch (...) {
         CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName() << ": make sure the file \""
                                  << filename << "\" is in JSON format" << std::endl;
+        m_configuration_failed = true;
+    }
+    if (m_configuration_failed && m_exit_on_configuration_failure) {
         exit(EXIT_FAILURE);
     }
 }
@@ -638,7 +1212,7 @@ void mtsIntuitiveResearchKitArm::ConfigureDH(const Json::Value & jsonConfig,
             CMN_LOG_CLASS_INIT_ERROR << "ConfigureDH " << this->GetName()
                                      << ": the base offset rotation doesn't seem to be orthonormal"
                                      << std::endl;
-            exit(EXIT_FAILURE);
+            ConfigurationFailure();
         }
     }
 
@@ -648,14 +1222,14 @@ void mtsIntuitiveResearchKitArm::ConfigureDH(const Json::Value & jsonConfig,
         CMN_LOG_CLASS_INIT_ERROR << "ConfigureDH " << this->GetName()
                                  << ": can find \"DH\" data in configuration file \""
                                  << filename << "\"" << std::endl;
-        exit(EXIT_FAILURE);
+        ConfigurationFailure();
     }
     if (this->Manipulator->LoadRobot(jsonDH) != robManipulator::ESUCCESS) {
         CMN_LOG_CLASS_INIT_ERROR << "ConfigureDH " << this->GetName()
                                  << ": failed to load \"DH\" parameters from file \""
                                  << filename << "\", error is "
                                  << this->Manipulator->LastError() << std::endl;
-        exit(EXIT_FAILURE);
+        ConfigurationFailure();
     }
     std::stringstream dhResult;
     this->Manipulator->PrintKinematics(dhResult);
@@ -666,32 +1240,29 @@ void mtsIntuitiveResearchKitArm::ConfigureDH(const Json::Value & jsonConfig,
     // configuration
     if (mConfigurationFile == "") {
         mConfigurationFile = filename;
+        mConfigurationDH = jsonConfig;
         CMN_LOG_CLASS_INIT_VERBOSE << "ConfigureDH " << this->GetName()
                                    << ": saved base configuration file name: "
                                    << mConfigurationFile << std::endl;
     }
 
-    // update ConfigurationJointKinematic from manipulator
-    UpdateConfigurationJointKinematic();
-
-    // resize data members using kinematics (jacobians and effort vectors)
+    // update ConfigurationJointKinematic and resize data members
+    // using kinematics (jacobians and effort vectors)
     ResizeKinematicsData();
 }
 
 void mtsIntuitiveResearchKitArm::ConfigureDH(const std::string & filename)
 {
     try {
-        std::ifstream jsonStream;
         Json::Value jsonConfig;
-        Json::Reader jsonReader;
 
-        jsonStream.open(filename.c_str());
-        if (!jsonReader.parse(jsonStream, jsonConfig)) {
+        std::string jsonErrors;
+        if (!mtsIntuitiveResearchKitConfigCache::Parse(filename, jsonConfig, jsonErrors)) {
             CMN_LOG_CLASS_INIT_ERROR << "ConfigureDH " << this->GetName()
                                      << ": failed to parse kinematic (DH) configuration file \""
                                      << filename << "\"\n"
-                                     << jsonReader.getFormattedErrorMessages();
-            exit(EXIT_FAILURE);
+                                     << jsonErrors;
+            ConfigurationFailure();
         }
 
         CMN_LOG_CLASS_INIT_VERBOSE << "ConfigureDH: " << this->GetName()
@@ -704,27 +1275,60 @@ void mtsIntuitiveResearchKitArm::ConfigureDH(const std::string & filename)
             ConfigureDH(jsonConfig, filename);
         }
 
+    } catch (ConfigurationError &) {
+        throw;
     } catch (std::exception & e) {
         CMN_LOG_CLASS_INIT_ERROR << "ConfigureDH " << this->GetName() << ": parsing file \""
                                  << filename << "\", got error: " << e.what() << std::endl;
-        exit(EXIT_FAILURE);
+        ConfigurationFailure();
     } catch (...) {
         CMN_LOG_CLASS_INIT_ERROR << "ConfigureDH " << this->GetName() << ": make sure the file \""
                                  << filename << "\" is in JSON format" << std::endl;
-        exit(EXIT_FAILURE);
+        ConfigurationFailure();
     }
 }
 
 void mtsIntuitiveResearchKitArm::Startup(void)
 {
+    // startup is called from the task's thread
+    m_real_time.Apply(this->GetName());
+    m_heartbeat.Configure(this->GetName(), ExpectedPeriod());
+    m_messages.Start(this->GetName());
+
+    // allocate flight recorder buffers before the arm starts running
+    std::vector<std::string> columns = {"operating_state", "commands"};
+    const size_t nbJoints = NumberOfJointsKinematics();
+    for (const std::string & field : {"measured_js/position/", "measured_js/velocity/",
+                                      "measured_js/effort/", "setpoint_js/position/"}) {
+        for (size_t joint = 0; joint < nbJoints; ++joint) {
+            columns.push_back(field + std::to_string(joint));
+        }
+    }
+    for (const std::string & axis : {"x", "y", "z"}) {
+        columns.push_back("measured_cp/translation/" + axis);
+    }
+    const size_t nbSamples = (m_flight_recorder.duration > 0.0) ?
+        static_cast<size_t>(m_flight_recorder.duration / ExpectedPeriod()) : 0;
+    m_flight_recorder.history.Allocate(this->GetName(), columns, nbSamples,
+                                       m_flight_recorder.directory);
+
     SetDesiredState("DISABLED");
     trajectory_j_set_ratio(mtsIntuitiveResearchKit::JointTrajectory::ratio);
 }
 
 void mtsIntuitiveResearchKitArm::Run(void)
 {
+    // heartbeat for the health monitor, updated when Run returns
+    mtsIntuitiveResearchKitHeartbeat::ScopedCycle heartbeat(m_heartbeat);
+    if (m_timing.enabled) {
+        m_timing.start = osaGetTime();
+        m_timing.mark = m_timing.start;
+        m_timing.active = TIMING_EVENTS;
+        m_timing.depth = 0;
+    }
     // collect data from required interfaces
     ProcessQueuedEvents();
+    TimingSwitch(TIMING_STATE_MACHINE);
     try {
         mArmState.Run();
     } catch (std::exception & e) {
@@ -732,9 +1336,298 @@ void mtsIntuitiveResearchKitArm::Run(void)
                                    + ", caught exception \"" + e.what() + "\"");
         SetDesiredState("DISABLED");
     }
+    TimingSwitch(TIMING_COMMANDS);
     // trigger ExecOut event
     RunEvent();
+    // queued commands first, see m_servo_commands
     ProcessQueuedCommands();
+    ServoCommandsProcess();
+    if (m_recorder_channel) {
+        RecorderPush();
+    }
+    FlightRecorderSample();
+    {
+        const double now = StateTable.GetTic();
+        if ((now - m_gui_snapshot.last_publish) < GUI_PLOT_TIMEOUT) {
+            GUIPlotSample(now);
+        }
+        if (m_gui_snapshot.requested.load(std::memory_order_relaxed)
+            && ((now - m_gui_snapshot.last_publish) >= m_gui_snapshot.publish_interval)) {
+            GUISnapshotPublish(now);
+        }
+    }
+    m_messages.Dispatch(m_arm_interface);
+    TimingEnd();
+}
+
+void mtsIntuitiveResearchKitArm::FlightRecorderSample(void)
+{
+    double * sample = m_flight_recorder.history.Sample(StateTable.GetTic());
+    if (!sample) {
+        return;
+    }
+    sample[1] = static_cast<double>(m_operating_state.State());
+    sample[2] = static_cast<double>(m_flight_recorder.commands);
+    m_flight_recorder.commands = 0;
+    double * cursor = sample + 3;
+    const size_t nbJoints = NumberOfJointsKinematics();
+    for (const vctDoubleVec * vector : {&m_kin_measured_js.Position(), &m_kin_measured_js.Velocity(),
+                                        &m_kin_measured_js.Effort(), &m_kin_setpoint_js.Position()}) {
+        const size_t size = std::min(vector->size(), nbJoints);
+        std::copy(vector->Pointer(), vector->Pointer() + size, cursor);
+        std::fill(cursor + size, cursor + nbJoints, 0.0);
+        cursor += nbJoints;
+    }
+    const vct3 & translation = m_measured_cp.Position().Translation();
+    cursor[0] = translation.X();
+    cursor[1] = translation.Y();
+    cursor[2] = translation.Z();
+}
+
+void mtsIntuitiveResearchKitArm::RecorderPush(void)
+{
+    double * record = m_recorder_channel->Reserve();
+    if (!record) {
+        return;
+    }
+    const unsigned int fields = m_recorder_channel->Fields();
+    const size_t nbJoints = m_recorder_channel->NumberOfJoints();
+    unsigned int valid = 0;
+    double * cursor = record + 2;
+
+    const auto copyVector = [&](const vctDoubleVec & vector) {
+        const size_t size = std::min(vector.size(), nbJoints);
+        for (size_t index = 0; index < size; ++index) {
+            cursor[index] = vector.Element(index);
+        }
+        for (size_t index = size; index < nbJoints; ++index) {
+            cursor[index] = 0.0;
+        }
+        cursor += nbJoints;
+    };
+
+    if (fields & mtsIntuitiveResearchKitRecorderChannel::FIELD_MEASURED_JS) {
+        if (m_kin_measured_js.Valid()) {
+            valid |= mtsIntuitiveResearchKitRecorderChannel::FIELD_MEASURED_JS;
+        }
+        copyVector(m_kin_measured_js.Position());
+        copyVector(m_kin_measured_js.Velocity());
+        copyVector(m_kin_measured_js.Effort());
+    }
+    if (fields & mtsIntuitiveResearchKitRecorderChannel::FIELD_SETPOINT_JS) {
+        if (m_kin_setpoint_js.Valid()) {
+            valid |= mtsIntuitiveResearchKitRecorderChannel::FIELD_SETPOINT_JS;
+        }
+        copyVector(m_kin_setpoint_js.Position());
+        copyVector(m_kin_setpoint_js.Velocity());
+        copyVector(m_kin_setpoint_js.Effort());
+    }
+    if (fields & mtsIntuitiveResearchKitRecorderChannel::FIELD_MEASURED_CP) {
+        if (m_measured_cp.Valid()) {
+            valid |= mtsIntuitiveResearchKitRecorderChannel::FIELD_MEASURED_CP;
+        }
+        const vctFrm3 & frame = m_measured_cp.Position();
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t col = 0; col < 3; ++col) {
+                cursor[3 * row + col] = frame.Rotation().Element(row, col);
+            }
+            cursor[9 + row] = frame.Translation().Element(row);
+        }
+        cursor += 12;
+    }
+    if (fields & mtsIntuitiveResearchKitRecorderChannel::FIELD_BODY_MEASURED_CF) {
+        // not valid if the wrench estimation is lazy
+        if (m_body_measured_cf.Valid()) {
+            valid |= mtsIntuitiveResearchKitRecorderChannel::FIELD_BODY_MEASURED_CF;
+        }
+        for (size_t index = 0; index < 6; ++index) {
+            cursor[index] = m_body_measured_cf.Force().Element(index);
+        }
+        cursor += 6;
+    }
+    record[0] = StateTable.GetTic();
+    record[1] = static_cast<double>(valid);
+    m_recorder_channel->Commit();
+}
+
+void mtsIntuitiveResearchKitArm::TimingInit(void)
+{
+    const size_t nbStages = TIMING_NUMBER_OF_STAGES;
+    mtsIntuitiveResearchKitArmTiming & snapshot = m_timing.snapshot;
+    snapshot.stage_names = {"events", "robot_data", "state_machine",
+                            "control", "servo_cf", "pid", "commands", "total"};
+    CMN_ASSERT(snapshot.stage_names.size() == nbStages);
+    snapshot.stage_last.SetSize(nbStages);
+    snapshot.stage_average.SetSize(nbStages);
+    snapshot.stage_max.SetSize(nbStages);
+    snapshot.histogram_bounds.SetSize(TIMING_NUMBER_OF_BUCKETS - 1);
+    snapshot.histogram.resize(TIMING_NUMBER_OF_BUCKETS);
+    snapshot.period = ExpectedPeriod();
+    for (size_t index = 0; index < (TIMING_NUMBER_OF_BUCKETS - 1); ++index) {
+        snapshot.histogram_bounds[index] = m_timing.bucket_ratios[index] * snapshot.period;
+    }
+    TimingReset();
+}
+
+void mtsIntuitiveResearchKitArm::TimingReset(void)
+{
+    m_timing.current.SetAll(0.0);
+    m_timing.sum.SetAll(0.0);
+    m_timing.max.SetAll(0.0);
+    m_timing.histogram.SetAll(0);
+    m_timing.iterations = 0;
+    m_timing.deadline_misses = 0;
+    m_timing.reset_requested = false;
+}
+
+void mtsIntuitiveResearchKitArm::TimingEnd(void)
+{
+    if (!m_timing.enabled) {
+        return;
+    }
+    if (m_timing.reset_requested) {
+        TimingReset();
+        return;
+    }
+    // charge last stage
+    const double now = osaGetTime();
+    m_timing.current[m_timing.active] += now - m_timing.mark;
+    const double total = now - m_timing.start;
+    m_timing.current[TIMING_TOTAL] = total;
+
+    m_timing.sum.Add(m_timing.current);
+    m_timing.max.MaxOf(m_timing.max, m_timing.current);
+    ++m_timing.iterations;
+
+    // histogram and deadline based on expected period
+    const double period = m_timing.snapshot.period;
+    if (total > period) {
+        ++m_timing.deadline_misses;
+    }
+    size_t bucket = 0;
+    while ((bucket < (TIMING_NUMBER_OF_BUCKETS - 1))
+           && (total >= m_timing.bucket_ratios[bucket] * period)) {
+        ++bucket;
+    }
+    ++m_timing.histogram[bucket];
+
+    if ((now - m_timing.last_publish) >= m_timing.publish_interval) {
+        TimingPublish(now);
+    }
+    m_timing.current.SetAll(0.0);
+}
+
+void mtsIntuitiveResearchKitArm::TimingPublish(const double now)
+{
+    m_timing.last_publish = now;
+    mtsIntuitiveResearchKitArmTiming & snapshot = m_timing.snapshot;
+    m_timing.mutex.Lock();
+    snapshot.iterations = m_timing.iterations;
+    snapshot.deadline_misses = m_timing.deadline_misses;
+    snapshot.stage_last.Assign(m_timing.current.Pointer());
+    snapshot.stage_average.Assign(m_timing.sum.Pointer());
+    if (m_timing.iterations > 0) {
+        snapshot.stage_average.Divide(static_cast<double>(m_timing.iterations));
+    }
+    snapshot.stage_max.Assign(m_timing.max.Pointer());
+    for (size_t index = 0; index < TIMING_NUMBER_OF_BUCKETS; ++index) {
+        snapshot.histogram[index] = m_timing.histogram[index];
+    }
+    snapshot.timestamp = StateTable.GetTic();
+    m_timing.mutex.Unlock();
+}
+
+void mtsIntuitiveResearchKitArm::timing_statistics(mtsIntuitiveResearchKitArmTiming & timing) const
+{
+    m_timing.mutex.Lock();
+    timing = m_timing.snapshot;
+    m_timing.mutex.Unlock();
+}
+
+void mtsIntuitiveResearchKitArm::state_tables_memory(std::string & report) const
+{
+    const mtsStateTable * tables[] = {&StateTable, &mStateTableState,
+                                      &mStateTableConfiguration, &mStateTableJacobian};
+    std::stringstream stream;
+    size_t total = 0;
+    for (const mtsStateTable * table : tables) {
+        // Tic, Toc and Period are added by the state table itself
+        size_t rowSize = 3 * sizeof(mtsDouble);
+        for (const auto & data : m_state_tables_memory) {
+            if (data.table == table) {
+                rowSize += data.size();
+            }
+        }
+        const size_t tableSize = rowSize * table->GetHistoryLength();
+        total += tableSize;
+        stream << table->GetName() << ": " << table->GetHistoryLength() << " x "
+               << rowSize << " bytes = " << tableSize / 1024 << " KiB" << std::endl;
+        for (const auto & data : m_state_tables_memory) {
+            if (data.table == table) {
+                stream << "  " << data.name << ": " << data.size() << " bytes" << std::endl;
+            }
+        }
+    }
+    stream << "total: " << total / 1024 << " KiB" << std::endl;
+    report = stream.str();
+}
+
+void mtsIntuitiveResearchKitArm::GUISnapshotPublish(const double now)
+{
+    m_gui_snapshot.last_publish = now;
+    m_gui_snapshot.requested = false;
+    mtsIntuitiveResearchKitArmSnapshot & snapshot = m_gui_snapshot.data;
+    m_gui_snapshot.mutex.Lock();
+    snapshot.measured_js.From(m_kin_measured_js);
+    snapshot.measured_cp.From(m_measured_cp);
+    snapshot.body_measured_cf_valid = m_body_measured_cf.Valid();
+    snapshot.body_measured_cf_timestamp = m_body_measured_cf.Timestamp();
+    snapshot.body_measured_cf.Assign(m_body_measured_cf.Force());
+    GUISnapshotDerived(snapshot);
+    // samples since last snapshot, oldest first
+    const size_t count = m_gui_snapshot.plot_count;
+    const size_t first = m_gui_snapshot.plot_head + GUI_PLOT_CAPACITY - count;
+    for (size_t index = 0; index < count; ++index) {
+        const size_t ring = (first + index) % GUI_PLOT_CAPACITY;
+        snapshot.plot_time.at(index) = m_gui_snapshot.plot_time.at(ring);
+        snapshot.plot_tool_effort.at(index) = m_gui_snapshot.plot_tool_effort.at(ring);
+    }
+    snapshot.plot_size = count;
+    m_gui_snapshot.plot_count = 0;
+    snapshot.timestamp = now;
+    m_gui_snapshot.mutex.Unlock();
+}
+
+void mtsIntuitiveResearchKitArm::GUIPlotSample(const double now)
+{
+    double effort;
+    if (!GUIPlotToolEffort(effort)) {
+        return;
+    }
+    const size_t index = m_gui_snapshot.plot_head;
+    m_gui_snapshot.plot_time.at(index) = now;
+    m_gui_snapshot.plot_tool_effort.at(index) = effort;
+    m_gui_snapshot.plot_head = (index + 1) % GUI_PLOT_CAPACITY;
+    // oldest samples are overwritten if the GUI is too slow
+    if (m_gui_snapshot.plot_count < GUI_PLOT_CAPACITY) {
+        ++m_gui_snapshot.plot_count;
+    }
+}
+
+void mtsIntuitiveResearchKitArm::gui_snapshot(mtsIntuitiveResearchKitArmSnapshot & snapshot) const
+{
+    m_gui_snapshot.mutex.Lock();
+    snapshot = m_gui_snapshot.data;
+    m_gui_snapshot.mutex.Unlock();
+    // ask Run to update the snapshot for next read
+    m_gui_snapshot.requested = true;
+}
+
+void mtsIntuitiveResearchKitArm::timing_statistics_reset(void)
+{
+    // reset happens at the end of the current iteration
+    m_timing.reset_requested = true;
+    m_servo_cp_latency_samples = 0;
 }
 
 void mtsIntuitiveResearchKitArm::Cleanup(void)
@@ -751,6 +1644,7 @@ void mtsIntuitiveResearchKitArm::Cleanup(void)
         values.SetAll(0.0);
         IO.SetEncoderPosition(values);
     }
+    m_messages.Stop();
     CMN_LOG_CLASS_INIT_VERBOSE << GetName() << ": Cleanup" << std::endl;
 }
 
@@ -765,9 +1659,9 @@ void mtsIntuitiveResearchKitArm::GetRobotData(void)
 {
     // check that the robot still has power
     if (m_powered && !m_simulated) {
-        vctBoolVec actuatorAmplifiersStatus(NumberOfJoints());
+        vctBoolVec & actuatorAmplifiersStatus = m_robot_data_buffers.actuator_amp_status;
         IO.GetActuatorAmpStatus(actuatorAmplifiersStatus);
-        vctBoolVec brakeAmplifiersStatus(NumberOfBrakes());
+        vctBoolVec & brakeAmplifiersStatus = m_robot_data_buffers.brake_amp_status;
         if (HasBrakes()) {
             IO.GetBrakeAmpStatus(brakeAmplifiersStatus);
         }
@@ -815,6 +1709,15 @@ void mtsIntuitiveResearchKitArm::GetRobotData(void)
         // update joint states used for kinematics
         UpdateStateJointKinematics();
 
+        // optional filters, in place
+        if (!m_joint_filters.Empty()) {
+            const double now = StateTable.GetTic();
+            if (!m_joint_filters.Filter(now, m_kin_measured_js)) {
+                m_messages.Send(m_message_sites.joint_filter_budget, now,
+                                static_cast<double>(m_joint_filters.Overruns()));
+            }
+        }
+
     } else {
         // set joint to zeros
         m_pid_measured_js.Position().Zeros();
@@ -831,8 +1734,29 @@ void mtsIntuitiveResearchKitArm::GetRobotData(void)
     // when the robot is ready, we can compute cartesian position
     if (IsCartesianReady()) {
         CMN_ASSERT(IsJointReady());
-        // update cartesian position
-        m_local_measured_cp_frame = Manipulator->ForwardKinematics(m_kin_measured_js.Position());
+        // find which derived quantities are needed, either by control or a user
+        const bool controlNeedsAll =
+            (m_control_mode == mtsIntuitiveResearchKitArmTypes::USER_MODE)
+            || (m_control_space == mtsIntuitiveResearchKitArmTypes::USER_SPACE);
+        const bool controlNeedsEffort =
+            controlNeedsAll
+            || ((m_control_mode == mtsIntuitiveResearchKitArmTypes::EFFORT_MODE)
+                && (m_control_space == mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE));
+        const bool needWrench = controlNeedsAll || DerivedStateNeeded(m_derived_state.measured_cf);
+        const bool needVelocity = controlNeedsEffort || DerivedStateNeeded(m_derived_state.measured_cv);
+        const bool needJacobian = controlNeedsEffort || needVelocity || needWrench
+            || DerivedStateNeeded(m_derived_state.jacobian);
+        const bool needSetpoint = controlNeedsAll || DerivedStateNeeded(m_derived_state.setpoint_cp);
+
+        // update cartesian position and jacobians in a single pass
+        if (needJacobian) {
+            m_kinematics->evaluator.Evaluate(*Manipulator, m_kin_measured_js.Position(),
+                                            m_local_measured_cp_frame,
+                                            m_body_jacobian, m_spatial_jacobian);
+        } else {
+            m_kinematics->evaluator.Evaluate(*Manipulator, m_kin_measured_js.Position(),
+                                            m_local_measured_cp_frame);
+        }
         m_measured_cp_frame = m_base_frame * m_local_measured_cp_frame;
         // normalize
         m_local_measured_cp_frame.Rotation().NormalizedSelf();
@@ -845,69 +1769,62 @@ void mtsIntuitiveResearchKitArm::GetRobotData(void)
         m_measured_cp.SetTimestamp(m_kin_measured_js.Timestamp());
         m_measured_cp.SetValid(m_base_frame_valid);
 
-        // update jacobians
-        Manipulator->JacobianSpatial(m_kin_measured_js.Position(), m_spatial_jacobian);
-        Manipulator->JacobianBody(m_kin_measured_js.Position(), m_body_jacobian);
-
         // update cartesian velocity using the jacobian and joint
         // velocities.
-        vctDoubleVec cartesianVelocity(6);
-        cartesianVelocity.ProductOf(m_body_jacobian, m_kin_measured_js.Velocity());
-        vct3 relative, absolute;
-        // linear
-        relative.Assign(cartesianVelocity.Ref(3, 0));
-        m_measured_cp_frame.Rotation().ApplyTo(relative, absolute);
-        m_measured_cv.SetVelocityLinear(absolute);
-        // angular
-        relative.Assign(cartesianVelocity.Ref(3, 3));
-        m_measured_cp_frame.Rotation().ApplyTo(relative, absolute);
-        m_measured_cv.SetVelocityAngular(absolute);
-        // valid/timestamp
-        m_measured_cv.SetValid(true);
-        m_measured_cv.SetTimestamp(m_kin_measured_js.Timestamp());
-
-        // update wrench based on measured joint current efforts
-        m_body_jacobian_transpose.Assign(m_body_jacobian.Transpose());
-        nmrPInverse(m_body_jacobian_transpose, mJacobianPInverseData);
-        vctDoubleVec wrench(6);
-        wrench.ProductOf(mJacobianPInverseData.PInverse(), m_kin_measured_js.Effort());
-        if (m_body_cf_orientation_absolute) {
-            // forces
-            relative.Assign(wrench.Ref(3, 0));
+        if (needVelocity) {
+            vctDoubleVec & cartesianVelocity = m_robot_data_buffers.cartesian_velocity;
+            cartesianVelocity.ProductOf(m_body_jacobian, m_kin_measured_js.Velocity());
+            vct3 relative, absolute;
+            // linear
+            relative.Assign(cartesianVelocity.Ref(3, 0));
             m_measured_cp_frame.Rotation().ApplyTo(relative, absolute);
-            m_body_measured_cf.Force().Ref<3>(0).Assign(absolute);
-            // torques
-            relative.Assign(wrench.Ref(3, 3));
+            m_measured_cv.SetVelocityLinear(absolute);
+            // angular
+            relative.Assign(cartesianVelocity.Ref(3, 3));
             m_measured_cp_frame.Rotation().ApplyTo(relative, absolute);
-            m_body_measured_cf.Force().Ref<3>(3).Assign(absolute);
+            m_measured_cv.SetVelocityAngular(absolute);
+            m_measured_cv.SetValid(true);
         } else {
-            m_body_measured_cf.Force().Assign(wrench);
+            m_measured_cv.SetValid(false);
         }
-        // valid/timestamp
-        m_body_measured_cf.SetValid(true);
-        m_body_measured_cf.SetTimestamp(m_kin_measured_js.Timestamp());
+        m_measured_cv.SetTimestamp(m_kin_measured_js.Timestamp());
 
-        m_spatial_jacobian_transpose.Assign(m_spatial_jacobian.Transpose());
-        nmrPInverse(m_spatial_jacobian_transpose, mJacobianPInverseData);
-        wrench.ProductOf(mJacobianPInverseData.PInverse(), m_kin_measured_js.Effort());
-        m_spatial_measured_cf.Force().Assign(wrench);
-        // valid/timestamp
-        m_spatial_measured_cf.SetValid(true);
-        m_spatial_measured_cf.SetTimestamp(m_kin_measured_js.Timestamp());
+        // save data needed to estimate wrench based on measured
+        // joint current efforts
+        if (needWrench) {
+            WrenchInputs & inputs = m_kinematics->wrench_staging;
+            inputs.jacobian.Assign(m_body_jacobian);
+            inputs.effort.Assign(m_kin_measured_js.Effort());
+            inputs.rotation_local.Assign(m_local_measured_cp_frame.Rotation());
+            inputs.rotation.Assign(m_measured_cp_frame.Rotation());
+            inputs.timestamp = m_kin_measured_js.Timestamp();
+            inputs.valid = true;
+            if (m_wrench_estimation.lazy) {
+                m_kinematics->wrench_latest.Write(inputs, 0);
+                m_wrench_estimation.published_valid = true;
+            } else {
+                EstimateWrench(inputs);
+                m_body_measured_cf.Force().Assign(m_wrench_estimation.body_cf.Force());
+                m_spatial_measured_cf.Force().Assign(m_wrench_estimation.spatial_cf.Force());
+            }
+            // valid/timestamp, wrench in state table is not valid in lazy mode
+            m_body_measured_cf.SetValid(!m_wrench_estimation.lazy);
+            m_body_measured_cf.SetTimestamp(m_kin_measured_js.Timestamp());
+            m_spatial_measured_cf.SetValid(!m_wrench_estimation.lazy);
+            m_spatial_measured_cf.SetTimestamp(m_kin_measured_js.Timestamp());
+        } else {
+            m_body_measured_cf.SetValid(false);
+            m_spatial_measured_cf.SetValid(false);
+            WrenchInputsInvalidate();
+        }
 
         // update cartesian position desired based on joint desired
-        m_local_setpoint_cp_frame = Manipulator->ForwardKinematics(m_kin_setpoint_js.Position());
-        m_setpoint_cp_frame = m_base_frame * m_local_setpoint_cp_frame;
-        // normalize
-        m_local_setpoint_cp_frame.Rotation().NormalizedSelf();
-        m_setpoint_cp_frame.Rotation().NormalizedSelf();
-        // prm type
-        m_local_setpoint_cp.Position().From(m_local_setpoint_cp_frame);
-        m_local_setpoint_cp.SetTimestamp(m_kin_setpoint_js.Timestamp());
-        m_local_setpoint_cp.SetValid(true);
-        m_setpoint_cp.Position().From(m_setpoint_cp_frame);
-        m_setpoint_cp.SetTimestamp(m_kin_setpoint_js.Timestamp());
-        m_setpoint_cp.SetValid(m_base_frame_valid);
+        if (needSetpoint) {
+            UpdateSetpointCartesian();
+        } else {
+            m_local_setpoint_cp.SetValid(false);
+            m_setpoint_cp.SetValid(false);
+        }
 
     } else {
         // set cartesian data to "zero"
@@ -919,12 +1836,38 @@ void mtsIntuitiveResearchKitArm::GetRobotData(void)
         m_measured_cv.SetValid(false);
         m_body_measured_cf.SetValid(false);
         m_spatial_measured_cf.SetValid(false);
+        WrenchInputsInvalidate();
         // update cartesian position desired
         m_local_setpoint_cp_frame.Assign(vctFrm4x4::Identity());
         m_setpoint_cp_frame.Assign(vctFrm4x4::Identity());
         m_local_setpoint_cp.SetValid(false);
         m_setpoint_cp.SetValid(false);
     }
+
+#ifndef NDEBUG
+    // debug builds, make sure we didn't resize any preallocated buffer
+    CheckRobotDataBuffersPointers();
+#endif
+}
+
+void mtsIntuitiveResearchKitArm::UpdateSetpointCartesian(void)
+{
+    if (!IsCartesianReady()) {
+        return;
+    }
+    m_kinematics->evaluator.Evaluate(*Manipulator, m_kin_setpoint_js.Position(),
+                                    m_local_setpoint_cp_frame);
+    m_setpoint_cp_frame = m_base_frame * m_local_setpoint_cp_frame;
+    // normalize
+    m_local_setpoint_cp_frame.Rotation().NormalizedSelf();
+    m_setpoint_cp_frame.Rotation().NormalizedSelf();
+    // prm type
+    m_local_setpoint_cp.Position().From(m_local_setpoint_cp_frame);
+    m_local_setpoint_cp.SetTimestamp(m_kin_setpoint_js.Timestamp());
+    m_local_setpoint_cp.SetValid(true);
+    m_setpoint_cp.Position().From(m_setpoint_cp_frame);
+    m_setpoint_cp.SetTimestamp(m_kin_setpoint_js.Timestamp());
+    m_setpoint_cp.SetValid(m_base_frame_valid);
 }
 
 void mtsIntuitiveResearchKitArm::UpdateStateJointKinematics(void)
@@ -988,12 +1931,15 @@ void mtsIntuitiveResearchKitArm::StateChanged(void)
     mStateTableState.Advance();
     // push all state events
     StateEvents();
+    m_flight_recorder.history.Event(StateTable.GetTic(), "state " + state);
     m_arm_interface->SendStatus(this->GetName() + ": current state " + state);
 }
 
 void mtsIntuitiveResearchKitArm::RunAllStates(void)
 {
+    TimingEnter(TIMING_ROBOT_DATA);
     GetRobotData();
+    TimingExit();
 }
 
 void mtsIntuitiveResearchKitArm::EnterDisabled(void)
@@ -1064,9 +2010,9 @@ void mtsIntuitiveResearchKitArm::TransitionPowering(void)
     const double currentTime = this->StateTable.GetTic();
 
     // check power status
-    vctBoolVec actuatorAmplifiersStatus(NumberOfJoints());
+    vctBoolVec & actuatorAmplifiersStatus = m_robot_data_buffers.actuator_amp_status;
     IO.GetActuatorAmpStatus(actuatorAmplifiersStatus);
-    vctBoolVec brakeAmplifiersStatus(NumberOfBrakes());
+    vctBoolVec & brakeAmplifiersStatus = m_robot_data_buffers.brake_amp_status;
     if (HasBrakes()) {
         IO.GetBrakeAmpStatus(brakeAmplifiersStatus);
     }
@@ -1129,16 +2075,93 @@ void mtsIntuitiveResearchKitArm::EnterCalibratingEncodersFromPots(void)
 
     // request bias encoder
     const double currentTime = this->StateTable.GetTic();
+    mHomingBiasEncoderRequested = true;
+    mHomingTimer = currentTime;
+    m_encoder_bias.sampling = false;
+
+    // adaptive bias requires pots
+    const bool adaptive = m_encoder_bias.enabled && IO.GetAnalogInputPosSI.IsValid();
     const int nb_samples = 1970; // birth year, state table contains 1999 elements so anything under that would work
     if (m_re_home || m_calibration_mode) {
-        // positive number to ignore encoder preloads
-        IO.BiasEncoder(nb_samples);
+        if (adaptive) {
+            EncoderBiasStart();
+        } else {
+            // positive number to ignore encoder preloads
+            IO.BiasEncoder(nb_samples);
+        }
     } else {
-        // negative numbers means that we first check if encoders have already been preloaded
-        IO.BiasEncoder(-nb_samples);
+        // negative numbers means that we first check if encoders
+        // have already been preloaded, for adaptive bias, the single
+        // sample bias is replaced by the average computed later
+        IO.BiasEncoder(adaptive ? -1 : -nb_samples);
     }
-    mHomingBiasEncoderRequested = true;
-    mHomingTimer = currentTime;
+}
+
+void mtsIntuitiveResearchKitArm::EncoderBiasStart(void)
+{
+    m_encoder_bias.sampling = true;
+    m_encoder_bias.nb_samples = 0;
+    m_encoder_bias.last_timestamp = -1.0;
+}
+
+bool mtsIntuitiveResearchKitArm::EncoderBiasSample(void)
+{
+    auto & bias = m_encoder_bias;
+    if (!IO.GetAnalogInputPosSI(bias.pots).IsOK()) {
+        return false;
+    }
+    // arm might run faster than IO, skip repeated samples
+    if (bias.pots.Timestamp() == bias.last_timestamp) {
+        return false;
+    }
+    bias.last_timestamp = bias.pots.Timestamp();
+
+    const vctDoubleVec & position = bias.pots.Position();
+    const size_t nbActuators = position.size();
+    if (bias.nb_samples == 0) {
+        bias.mean.SetSize(nbActuators);
+        bias.mean.SetAll(0.0);
+        bias.m2.SetSize(nbActuators);
+        bias.m2.SetAll(0.0);
+        // tolerance based on joint type, assume actuators match joints
+        bias.tolerance.SetSize(nbActuators);
+        bias.tolerance.SetAll(bias.revolute_tolerance);
+        const prmConfigurationJoint & configuration =
+            (m_pid_configuration_js.Type().size() == nbActuators) ? m_pid_configuration_js : m_kin_configuration_js;
+        if (configuration.Type().size() == nbActuators) {
+            for (size_t index = 0; index < nbActuators; ++index) {
+                if (configuration.Type().at(index) == PRM_JOINT_PRISMATIC) {
+                    bias.tolerance.at(index) = bias.prismatic_tolerance;
+                }
+            }
+        }
+    } else if (bias.mean.size() != nbActuators) {
+        return false;
+    }
+
+    // running mean and variance (Welford)
+    ++bias.nb_samples;
+    const double n = static_cast<double>(bias.nb_samples);
+    for (size_t index = 0; index < nbActuators; ++index) {
+        const double delta = position.at(index) - bias.mean.at(index);
+        bias.mean.at(index) += delta / n;
+        bias.m2.at(index) += delta * (position.at(index) - bias.mean.at(index));
+    }
+
+    if (bias.nb_samples >= bias.max_samples) {
+        return true;
+    }
+    if (bias.nb_samples < bias.min_samples) {
+        return false;
+    }
+    // standard error of the mean, i.e. sqrt(variance / n)
+    for (size_t index = 0; index < nbActuators; ++index) {
+        const double standardError = std::sqrt(bias.m2.at(index) / ((n - 1.0) * n));
+        if (standardError > bias.tolerance.at(index)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void mtsIntuitiveResearchKitArm::TransitionCalibratingEncodersFromPots(void)
@@ -1149,6 +2172,22 @@ void mtsIntuitiveResearchKitArm::TransitionCalibratingEncodersFromPots(void)
         return;
     }
 
+    if (m_encoder_bias.sampling && EncoderBiasSample()) {
+        m_encoder_bias.sampling = false;
+        IO.SetEncoderPosition(m_encoder_bias.mean);
+        mHomingBiasEncoderRequested = false;
+        m_encoders_biased_from_pots = true;
+        // some encoders need to be biased not from pots: MTM roll
+        m_encoders_biased = false;
+        std::stringstream message;
+        message << this->GetName() << ": encoders biased using " << m_encoder_bias.nb_samples
+                << " potentiometer values in "
+                << std::fixed << std::setprecision(2) << this->StateTable.GetTic() - mHomingTimer << "s";
+        m_arm_interface->SendStatus(message.str());
+        mArmState.SetCurrentState("ENCODERS_BIASED");
+        return;
+    }
+
     const double currentTime = this->StateTable.GetTic();
     const double timeToBias = 30.0 * cmn_s; // large timeout
     if ((currentTime - mHomingTimer) > timeToBias) {
@@ -1219,8 +2258,12 @@ void mtsIntuitiveResearchKitArm::EnterHoming(void)
     CMN_ASSERT(IsJointReady());
     GetRobotData();
 
-    // compute joint goal position
+    // compute joint goal position, stay in place if calibration was
+    // restored from snapshot
     this->SetGoalHomingArm();
+    if (m_calibration_restored) {
+        m_trajectory_j.goal.Assign(m_pid_setpoint_js.Position());
+    }
     // initialize trajectory with current position and velocities
     m_servo_jp.Assign(m_pid_setpoint_js.Position());
     m_servo_jv.Assign(m_pid_measured_js.Velocity());
@@ -1294,10 +2337,19 @@ void mtsIntuitiveResearchKitArm::EnterHomed(void)
     SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::UNDEFINED_SPACE,
                            mtsIntuitiveResearchKitArmTypes::UNDEFINED_MODE);
 
+    // limits might have changed (e.g. PSM tool)
+    LimitGuardActivate(true);
+
     if (m_simulated) {
         return;
     }
 
+    // save calibration so homing can be skipped after restart
+    if (!m_calibration_mode) {
+        CalibrationSnapshotSave();
+    }
+    m_calibration_restored = false;
+
     // enable PID and start from current position
     mtsIntuitiveResearchKitArm::servo_jp_internal(m_pid_setpoint_js.Position());
     PID.EnableTrackingError(UsePIDTrackingError());
@@ -1307,8 +2359,75 @@ void mtsIntuitiveResearchKitArm::EnterHomed(void)
     PID.EnableJoints(vctBoolVec(NumberOfJoints(), true));
 }
 
+void mtsIntuitiveResearchKitArm::CalibrationSnapshotUpdate(void)
+{
+    // rewrite so the snapshot doesn't claim a state we lost, e.g. tool removed
+    if (m_operating_state.IsHomed() && !m_calibration_mode && !m_simulated) {
+        CalibrationSnapshotSave();
+    } else {
+        m_calibration_snapshot.Invalidate();
+    }
+}
+
+void mtsIntuitiveResearchKitArm::CalibrationSnapshotSave(void)
+{
+    if (!m_calibration_snapshot.Enabled()) {
+        return;
+    }
+    mtsStdString serialNumber;
+    prmStateJoint encoders, pots;
+    if (!IO.GetSerialNumber(serialNumber).IsOK()
+        || !IO.measured_js(encoders).IsOK()
+        || !IO.GetAnalogInputPosSI(pots).IsOK()) {
+        m_arm_interface->SendWarning(this->GetName() + ": unable to read IO data to save calibration snapshot");
+        return;
+    }
+    Json::Value extra;
+    CalibrationSnapshotExtra(extra);
+    std::string errorMessage;
+    if (!m_calibration_snapshot.Save(serialNumber, encoders.Position(), pots.Position(),
+                                     extra, errorMessage)) {
+        m_arm_interface->SendWarning(this->GetName() + ": failed to save calibration snapshot, " + errorMessage);
+    }
+}
+
+bool mtsIntuitiveResearchKitArm::CalibrationSnapshotValidate(void)
+{
+    mtsStdString serialNumber;
+    prmStateJoint encoders, pots;
+    if (!IO.GetSerialNumber(serialNumber).IsOK()
+        || !IO.measured_js(encoders).IsOK()
+        || !IO.GetAnalogInputPosSI(pots).IsOK()) {
+        m_arm_interface->SendWarning(this->GetName() + ": unable to read IO data to check calibration snapshot");
+        return false;
+    }
+    // tolerances depend on joint type, assume actuators match joints
+    // (PID configuration is only defined for PSMs)
+    vctBoolVec prismatic;
+    const size_t nbActuators = encoders.Position().size();
+    const prmConfigurationJoint & configuration =
+        (m_pid_configuration_js.Type().size() == nbActuators) ? m_pid_configuration_js : m_kin_configuration_js;
+    if (configuration.Type().size() == nbActuators) {
+        prismatic.SetSize(nbActuators);
+        for (size_t index = 0; index < nbActuators; ++index) {
+            prismatic.at(index) = (configuration.Type().at(index) == PRM_JOINT_PRISMATIC);
+        }
+    }
+    Json::Value extra;
+    std::string errorMessage;
+    if (!m_calibration_snapshot.Validate(serialNumber, encoders.Position(), pots.Position(),
+                                         prismatic, extra, errorMessage)) {
+        m_arm_interface->SendStatus(this->GetName() + ": calibration snapshot not used, " + errorMessage);
+        return false;
+    }
+    CalibrationSnapshotRestore(extra);
+    m_arm_interface->SendStatus(this->GetName() + ": calibration restored from snapshot, skipping homing");
+    return true;
+}
+
 void mtsIntuitiveResearchKitArm::LeaveHomed(void)
 {
+    LimitGuardActivate(false);
     // no control mode defined
     SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::UNDEFINED_SPACE,
                            mtsIntuitiveResearchKitArmTypes::UNDEFINED_MODE);
@@ -1317,7 +2436,9 @@ void mtsIntuitiveResearchKitArm::LeaveHomed(void)
 void mtsIntuitiveResearchKitArm::RunHomed(void)
 {
     if (mControlCallback) {
+        TimingEnter(TIMING_CONTROL);
         mControlCallback->Execute();
+        TimingExit();
     }
 }
 
@@ -1332,10 +2453,33 @@ void mtsIntuitiveResearchKitArm::EnterFault(void)
 {
     IO.PowerOffSequence(false);
     UpdateOperatingStateAndBusy(prmOperatingState::FAULT, false);
+    m_flight_recorder.history.Trigger(StateTable.GetTic(), "fault");
 }
 
 void mtsIntuitiveResearchKitArm::control_servo_jp(void)
 {
+    if (m_servo_interpolation.type != SERVO_INTERPOLATION_NONE) {
+        if (!m_new_pid_goal && !m_servo_interpolation.active) {
+            return;
+        }
+        if (m_servo_interpolation.new_goal) {
+            // start from last setpoint sent
+            if (m_servo_interpolation.jp.size() != m_servo_jp.size()) {
+                m_servo_interpolation.jp.ForceAssign(m_servo_jp);
+            }
+            m_servo_interpolation.start_jp.ForceAssign(m_servo_interpolation.jp);
+            m_servo_interpolation.goal_jp.ForceAssign(m_servo_jp);
+        }
+        const double ratio = ServoInterpolationRatio();
+        m_servo_interpolation.jp.DifferenceOf(m_servo_interpolation.goal_jp,
+                                              m_servo_interpolation.start_jp);
+        m_servo_interpolation.jp.Multiply(ratio);
+        m_servo_interpolation.jp.Add(m_servo_interpolation.start_jp);
+        servo_jp_internal(m_servo_interpolation.jp);
+        m_new_pid_goal = false;
+        return;
+    }
+
     if (m_new_pid_goal) {
         servo_jp_internal(m_servo_jp);
         // reset flag
@@ -1343,6 +2487,43 @@ void mtsIntuitiveResearchKitArm::control_servo_jp(void)
     }
 }
 
+double mtsIntuitiveResearchKitArm::ServoInterpolationRatio(void)
+{
+    const double now = StateTable.GetTic();
+    if (m_servo_interpolation.new_goal) {
+        m_servo_interpolation.new_goal = false;
+        const double goalTime = (m_servo_interpolation.goal_time > 0.0) ? m_servo_interpolation.goal_time : now;
+        double duration = goalTime - m_servo_interpolation.previous_goal_time;
+        // first goal or client paused, no interpolation
+        if (!m_servo_interpolation.active
+            || (duration > m_servo_interpolation.max_interval)
+            || (duration < 0.0)) {
+            duration = 0.0;
+        }
+        m_servo_interpolation.previous_goal_time = goalTime;
+        m_servo_interpolation.start_time = now;
+        m_servo_interpolation.duration = duration;
+        m_servo_interpolation.active = true;
+    }
+
+    if (m_servo_interpolation.duration <= 0.0) {
+        return 1.0;
+    }
+    double ratio = (now - m_servo_interpolation.start_time) / m_servo_interpolation.duration;
+    if (ratio >= 1.0) {
+        ratio = 1.0;
+        // keep sending until the client is considered paused
+        if ((now - m_servo_interpolation.start_time) > m_servo_interpolation.max_interval) {
+            m_servo_interpolation.active = false;
+        }
+    }
+    if (m_servo_interpolation.type == SERVO_INTERPOLATION_MINIMUM_JERK) {
+        // 10 r^3 - 15 r^4 + 6 r^5, zero velocity and acceleration at both ends
+        ratio = ratio * ratio * ratio * (10.0 + ratio * (-15.0 + ratio * 6.0));
+    }
+    return ratio;
+}
+
 void mtsIntuitiveResearchKitArm::control_move_jp(void)
 {
     // check if there's anything to do
@@ -1365,9 +2546,17 @@ void mtsIntuitiveResearchKitArm::control_move_jp(void)
         if (m_trajectory_j.end_time == 0.0) {
             m_trajectory_j.end_time = currentTime + m_trajectory_j.Reflexxes.Duration();
         }
+        // blend with next waypoint
+        if (m_trajectory_queue.is_active
+            && (m_trajectory_queue.size > 0)
+            && ((m_trajectory_j.end_time - currentTime) <= m_trajectory_queue.blend_time)) {
+            trajectory_queue_next();
+        }
         break;
     case robReflexxes::Reflexxes_FINAL_STATE_REACHED:
-        control_move_jp_on_stop(true); // goal reached
+        if (!(m_trajectory_queue.is_active && trajectory_queue_next())) {
+            control_move_jp_on_stop(true); // goal reached
+        }
         break;
     default:
         m_arm_interface->SendError(this->GetName() + ": error while evaluating trajectory");
@@ -1378,34 +2567,117 @@ void mtsIntuitiveResearchKitArm::control_move_jp(void)
 
 void mtsIntuitiveResearchKitArm::control_servo_cp(void)
 {
+    const bool interpolate = (m_servo_interpolation.type != SERVO_INTERPOLATION_NONE);
+    bool newGoal = m_new_pid_goal;
+    if (interpolate) {
+        newGoal = m_servo_interpolation.new_goal;
+        if (!m_new_pid_goal && !m_servo_interpolation.active) {
+            return;
+        }
+        if (m_servo_interpolation.new_goal) {
+            // start from last setpoint sent
+            if (!m_servo_interpolation.active) {
+                m_servo_interpolation.cp = CartesianSetParam.Goal();
+            }
+            m_servo_interpolation.start_cp = m_servo_interpolation.cp;
+            m_servo_interpolation.goal_cp = CartesianSetParam.Goal();
+        }
+        const double ratio = ServoInterpolationRatio();
+        const vctFrm3 & start = m_servo_interpolation.start_cp;
+        const vctFrm3 & goal = m_servo_interpolation.goal_cp;
+        vctFrm3 & current = m_servo_interpolation.cp;
+        // translation is linear, rotation along the axis between start and goal
+        current.Translation().DifferenceOf(goal.Translation(), start.Translation());
+        current.Translation().Multiply(ratio);
+        current.Translation().Add(start.Translation());
+        const vctAxAnRot3 delta(start.Rotation().Inverse() * goal.Rotation(), VCT_NORMALIZE);
+        current.Rotation().ProductOf(start.Rotation(),
+                                     vctMatRot3(vctAxAnRot3(delta.Axis(), ratio * delta.Angle()), VCT_NORMALIZE));
+        m_new_pid_goal = true;
+    }
+
     if (m_new_pid_goal) {
         // copy current position
         vctDoubleVec jointSet(m_kin_measured_js.Position());
 
         // compute desired arm position
-        CartesianPositionFrm.From(CartesianSetParam.Goal());
+        if (interpolate) {
+            CartesianPositionFrm.From(m_servo_interpolation.cp);
+        } else {
+            CartesianPositionFrm.From(CartesianSetParam.Goal());
+        }
         if (this->InverseKinematics(jointSet, m_base_frame.Inverse() * CartesianPositionFrm) == robManipulator::ESUCCESS) {
             // finally send new joint values
             servo_jp_internal(jointSet);
-        } else {
-            // shows robManipulator error if used
-            if (this->Manipulator) {
-                m_arm_interface->SendError(this->GetName()
-                                           + ": unable to solve inverse kinematics ("
-                                           + this->Manipulator->LastError() + ")");
-            } else {
-                m_arm_interface->SendError(this->GetName() + ": unable to solve inverse kinematics");
+            if (newGoal) {
+                ServoCpLatencyUpdate();
             }
+        } else {
+            // servo goals can be sent at a high rate, limit messages
+            m_messages.Send(m_message_sites.servo_cp_ik, StateTable.GetTic());
         }
         // reset flag
         m_new_pid_goal = false;
     }
 }
 
+void mtsIntuitiveResearchKitArm::ServoCpLatencyUpdate(void)
+{
+    const double goalTime = CartesianSetParam.Timestamp();
+    if (goalTime <= 0.0) {
+        return;
+    }
+    const double latency = mtsManagerLocal::GetInstance()->GetTimeServer().GetRelativeTime() - goalTime;
+    if ((latency < 0.0) || (latency > 1.0 * cmn_s)) {
+        return;
+    }
+    // last, exponential moving average and max
+    m_servo_cp_latency[0] = latency;
+    if (m_servo_cp_latency_samples == 0) {
+        m_servo_cp_latency[1] = latency;
+        m_servo_cp_latency[2] = latency;
+    } else {
+        m_servo_cp_latency[1] += 0.01 * (latency - m_servo_cp_latency[1]);
+        if (latency > m_servo_cp_latency[2]) {
+            m_servo_cp_latency[2] = latency;
+        }
+    }
+    ++m_servo_cp_latency_samples;
+}
+
 void mtsIntuitiveResearchKitArm::control_move_cp(void)
 {
-    // trajectories are computed in joint space for now
-    control_move_jp();
+    // check if there's anything to do
+    if (!m_trajectory_j.is_active || !m_trajectory_c.is_active) {
+        return;
+    }
+
+    const bool goalReached = m_trajectory_c.generator.Evaluate(StateTable.GetTic(),
+                                                               m_trajectory_c.cp);
+    CartesianPositionFrm.From(m_trajectory_c.cp);
+    // warm start from previous solution
+    if (this->InverseKinematics(m_trajectory_c.jp, CartesianPositionFrm) == robManipulator::ESUCCESS) {
+        servo_jp_internal(m_trajectory_c.jp);
+        if (m_trajectory_queue.is_active && (m_trajectory_queue.size > 0)) {
+            // blend with next waypoint
+            if (goalReached
+                || (m_trajectory_c.generator.RemainingTime(StateTable.GetTic()) <= m_trajectory_queue.blend_time)) {
+                trajectory_queue_next();
+            }
+        } else if (goalReached) {
+            control_move_jp_on_stop(true); // goal reached
+        }
+    } else {
+        // shows robManipulator error if used
+        if (this->Manipulator) {
+            m_arm_interface->SendError(this->GetName()
+                                       + ": unable to solve inverse kinematics along cartesian trajectory ("
+                                       + this->Manipulator->LastError() + ")");
+        } else {
+            m_arm_interface->SendError(this->GetName() + ": unable to solve inverse kinematics along cartesian trajectory");
+        }
+        control_move_jp_on_stop(false); // goal NOT reached
+    }
 }
 
 bool mtsIntuitiveResearchKitArm::ArmIsReady(const std::string & methodName,
@@ -1498,12 +2770,21 @@ void mtsIntuitiveResearchKitArm::trajectory_j_update_reflexxes(void)
                                m_trajectory_j.v_max);
     m_trajectory_j.a.ProductOf(m_trajectory_j.ratio_a,
                                m_trajectory_j.a_max);
+    // use nominal period, Reflexxes is evaluated once per iteration
+    m_trajectory_j.reflexxes_period = ExpectedPeriod();
     m_trajectory_j.Reflexxes.Set(m_trajectory_j.v,
                                  m_trajectory_j.a,
-                                 StateTable.PeriodStats.PeriodAvg(),
+                                 m_trajectory_j.reflexxes_period,
                                  robReflexxes::Reflexxes_TIME);
 }
 
+void mtsIntuitiveResearchKitArm::trajectory_j_warm_reflexxes(void)
+{
+    if (m_trajectory_j.reflexxes_period != ExpectedPeriod()) {
+        trajectory_j_update_reflexxes();
+    }
+}
+
 void mtsIntuitiveResearchKitArm::SetControlSpaceAndMode(const mtsIntuitiveResearchKitArmTypes::ControlSpace space,
                                                         const mtsIntuitiveResearchKitArmTypes::ControlMode mode,
                                                         mtsCallableVoidBase * callback)
@@ -1516,20 +2797,33 @@ void mtsIntuitiveResearchKitArm::SetControlSpaceAndMode(const mtsIntuitiveResear
         return;
     }
 
+    // any change restarts servo interpolation from current setpoint
+    m_servo_interpolation.new_goal = false;
+    m_servo_interpolation.active = false;
+    m_servo_interpolation.jp.SetSize(0);
+
     // transitions
     if (space != m_control_space) {
+        // joint and cartesian trajectories use different generators,
+        // restart joint trajectory generator from current setpoint
+        m_trajectory_c.is_active = false;
+        if ((mode == mtsIntuitiveResearchKitArmTypes::TRAJECTORY_MODE)
+            && (m_control_mode == mtsIntuitiveResearchKitArmTypes::TRAJECTORY_MODE)) {
+            m_servo_jp.Assign(m_pid_setpoint_js.Position(), NumberOfJoints());
+            m_servo_jv.Assign(m_pid_measured_js.Velocity(), NumberOfJoints());
+        }
         // check if the arm is ready to use in cartesian space
         if (space == mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE) {
             if (this->IsSafeForCartesianControl()) {
                 // set flag
                 m_control_space = space;
-                mSafeForCartesianControlCounter = 0;
+                mSafeForCartesianControlTimeLastMessage = 0.0;
             } else {
-                if (mSafeForCartesianControlCounter == 0) {
-                    // message if needed
+                // throttle messages in time
+                if ((StateTable.GetTic() - mSafeForCartesianControlTimeLastMessage) > 1.0 * cmn_s) {
                     m_arm_interface->SendWarning(this->GetName() + ": tool/endoscope needs to be inserted past the cannula to switch to cartesian space");
+                    mSafeForCartesianControlTimeLastMessage = StateTable.GetTic();
                 }
-                mSafeForCartesianControlCounter = (mSafeForCartesianControlCounter + 1) % 1000;
                 return;
             }
         } else {
@@ -1566,19 +2860,15 @@ void mtsIntuitiveResearchKitArm::SetControlSpaceAndMode(const mtsIntuitiveResear
             if (m_control_mode == mtsIntuitiveResearchKitArmTypes::POSITION_MODE) {
                 m_servo_jv.Assign(m_pid_measured_js.Velocity(), NumberOfJoints());
             } else {
-                // we're switching from effort or no mode
-                m_servo_jv.SetSize(NumberOfJoints());
+                // we're switching from effort or no mode, size set in Configure
                 m_servo_jv.SetAll(0.0);
             }
-            m_trajectory_j.Reflexxes.Set(m_trajectory_j.v,
-                                         m_trajectory_j.a,
-                                         StateTable.PeriodStats.PeriodAvg(),
-                                         robReflexxes::Reflexxes_TIME);
+            trajectory_j_warm_reflexxes();
             break;
         case mtsIntuitiveResearchKitArmTypes::EFFORT_MODE:
             // configure PID
             PID.EnableTrackingError(false);
-            mEffortJoint.Assign(vctDoubleVec(NumberOfJointsKinematics(), 0.0));
+            m_kinematics->effort.Assign(vctDoubleVec(NumberOfJointsKinematics(), 0.0));
             SetControlEffortActiveJoints();
             break;
         default:
@@ -1654,8 +2944,13 @@ void mtsIntuitiveResearchKitArm::control_move_jp_on_start(void)
 
 void mtsIntuitiveResearchKitArm::control_move_jp_on_stop(const bool goal_reached)
 {
+    if (m_trajectory_queue.is_active && goal_reached) {
+        m_trajectory_queue.waypoint_reached_event(m_trajectory_queue.index);
+    }
+    trajectory_queue_reset();
     m_trajectory_j.goal_reached_event(goal_reached);
     m_trajectory_j.is_active = false;
+    m_trajectory_c.is_active = false;
     UpdateIsBusy(false);
 }
 
@@ -1672,7 +2967,7 @@ void mtsIntuitiveResearchKitArm::SetControlEffortActiveJoints(void)
 }
 
 void mtsIntuitiveResearchKitArm::control_servo_cf_preload(vctDoubleVec & effortPreload,
-                                                          vctDoubleVec & wrenchPreload)
+                                                          vct6 & wrenchPreload)
 {
     effortPreload.Zeros();
     wrenchPreload.Zeros();
@@ -1681,29 +2976,87 @@ void mtsIntuitiveResearchKitArm::control_servo_cf_preload(vctDoubleVec & effortP
 void mtsIntuitiveResearchKitArm::control_servo_jf(void)
 {
     // effort required
-    mEffortJoint.Assign(mEffortJointSet.ForceTorque());
+    m_kinematics->effort.Assign(m_kinematics->effort_set.ForceTorque());
 
     // add gravity compensation if needed
     if (m_gravity_compensation) {
-        control_add_gravity_compensation(mEffortJoint);
+        control_add_gravity_compensation(m_kinematics->effort);
     }
 
     // add custom efforts
-    control_add_jf(mEffortJoint);
+    control_add_jf(m_kinematics->effort);
 
     // convert to cisstParameterTypes
-    servo_jf_internal(mEffortJoint);
+    servo_jf_internal(m_kinematics->effort);
+}
+
+namespace {
+    // 6xN known at compile time so the compiler can fully unroll,
+    // jacobian is row major and compact
+    template <size_t _numberOfJoints>
+    void JacobianTransposeProductFixed(const double * jacobian,
+                                       const double * wrench,
+                                       const double * effortPreload,
+                                       double * effort)
+    {
+        for (size_t joint = 0; joint < _numberOfJoints; ++joint) {
+            double value = effortPreload[joint];
+            for (size_t row = 0; row < 6; ++row) {
+                value += jacobian[row * _numberOfJoints + joint] * wrench[row];
+            }
+            effort[joint] = value;
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitArm::JacobianTransposeProduct(const vctDoubleMat & jacobian,
+                                                          const vct6 & wrench,
+                                                          const vctDoubleVec & effortPreload,
+                                                          vctDoubleVec & effort)
+{
+    const size_t nbJoints = effort.size();
+    // fixed size for the arms we know (ECM, PSM, MTM, PSM snake like
+    // tool), the jacobian storage is dynamic as it's in a state table
+    if ((jacobian.col_stride() == 1)
+        && (jacobian.row_stride() == static_cast<vctDoubleMat::stride_type>(nbJoints))) {
+        const double * jacobianPointer = jacobian.Pointer();
+        switch (nbJoints) {
+        case 4:
+            JacobianTransposeProductFixed<4>(jacobianPointer, wrench.Pointer(), effortPreload.Pointer(), effort.Pointer());
+            return;
+        case 6:
+            JacobianTransposeProductFixed<6>(jacobianPointer, wrench.Pointer(), effortPreload.Pointer(), effort.Pointer());
+            return;
+        case 7:
+            JacobianTransposeProductFixed<7>(jacobianPointer, wrench.Pointer(), effortPreload.Pointer(), effort.Pointer());
+            return;
+        case 8:
+            JacobianTransposeProductFixed<8>(jacobianPointer, wrench.Pointer(), effortPreload.Pointer(), effort.Pointer());
+            return;
+        default:
+            break;
+        }
+    }
+    // any size, iterate on columns and unroll rows
+    for (size_t joint = 0; joint < nbJoints; ++joint) {
+        double value = effortPreload.Element(joint);
+        for (size_t row = 0; row < 6; ++row) {
+            value += jacobian.Element(row, joint) * wrench.Element(row);
+        }
+        effort.Element(joint) = value;
+    }
 }
 
 void mtsIntuitiveResearchKitArm::control_servo_cf(void)
 {
-    // update torques based on wrench
-    vctDoubleVec wrench(6);
+    TimingEnter(TIMING_SERVO_CF);
 
-    // get force preload from derived classes, in most cases 0, platform control for MTM
-    vctDoubleVec effortPreload(NumberOfJointsKinematics());
-    vctDoubleVec wrenchPreload(6);
+    // update torques based on wrench, all buffers are preallocated
+    vct6 & wrench = m_servo_cf_buffers.wrench;
+    vct6 & wrenchPreload = m_servo_cf_buffers.wrench_preload;
+    vctDoubleVec & effortPreload = m_kinematics->effort_preload;
 
+    // get force preload from derived classes, in most cases 0, platform control for MTM
     control_servo_cf_preload(effortPreload, wrenchPreload);
 
     // body wrench
@@ -1723,35 +3076,36 @@ void mtsIntuitiveResearchKitArm::control_servo_cf(void)
                 // force
                 relative.Assign(m_cf_set.Force().Ref<3>(0));
                 m_measured_cp_frame.Rotation().ApplyInverseTo(relative, absolute);
-                wrench.Ref(3, 0).Assign(absolute);
+                wrench.Ref<3>(0).Assign(absolute);
                 // torque
                 relative.Assign(m_cf_set.Force().Ref<3>(3));
                 m_measured_cp_frame.Rotation().ApplyInverseTo(relative, absolute);
-                wrench.Ref(3, 3).Assign(absolute);
+                wrench.Ref<3>(3).Assign(absolute);
             } else {
                 wrench.Assign(m_cf_set.Force());
             }
         }
-        mEffortJoint.ProductOf(m_body_jacobian.Transpose(), wrench + wrenchPreload);
-        mEffortJoint.Add(effortPreload);
+        wrench.Add(wrenchPreload);
+        JacobianTransposeProduct(m_body_jacobian, wrench, effortPreload, m_kinematics->effort);
     }
     // spatial wrench
     else if (m_cf_type == WRENCH_SPATIAL) {
-        wrench.Assign(m_cf_set.Force());
-        mEffortJoint.ProductOf(m_spatial_jacobian.Transpose(), wrench + wrenchPreload);
-        mEffortJoint.Add(effortPreload);
+        wrench.SumOf(m_cf_set.Force(), wrenchPreload);
+        JacobianTransposeProduct(m_spatial_jacobian, wrench, effortPreload, m_kinematics->effort);
     }
 
     // add gravity compensation if needed
     if (m_gravity_compensation) {
-        control_add_gravity_compensation(mEffortJoint);
+        control_add_gravity_compensation(m_kinematics->effort);
     }
 
     // add custom efforts
-    control_add_jf(mEffortJoint);
+    control_add_jf(m_kinematics->effort);
+
+    TimingExit();
 
     // send to PID
-    servo_jf_internal(mEffortJoint);
+    servo_jf_internal(m_kinematics->effort);
 
     // lock orientation if needed
     if (m_effort_orientation_locked) {
@@ -1764,7 +3118,9 @@ void mtsIntuitiveResearchKitArm::servo_jf_internal(const vctDoubleVec & newEffor
     // convert to cisstParameterTypes
     mTorqueSetParam.SetForceTorque(newEffort);
     mTorqueSetParam.SetTimestamp(StateTable.GetTic());
+    TimingEnter(TIMING_PID);
     PID.servo_jf(mTorqueSetParam);
+    TimingExit();
 }
 
 void mtsIntuitiveResearchKitArm::servo_jp_internal(const vctDoubleVec & newPosition)
@@ -1772,13 +3128,108 @@ void mtsIntuitiveResearchKitArm::servo_jp_internal(const vctDoubleVec & newPosit
     // feed forward
     if (use_feed_forward()) {
         update_feed_forward(m_feed_forward_jf.ForceTorque());
+        TimingEnter(TIMING_PID);
         PID.feed_forward_jf(m_feed_forward_jf);
+        TimingExit();
     }
     // position
     m_servo_jp_param.Goal().Zeros();
     m_servo_jp_param.Goal().Assign(newPosition, NumberOfJoints());
+    LimitGuard(m_servo_jp_param.Goal());
     m_servo_jp_param.SetTimestamp(StateTable.GetTic());
+    TimingEnter(TIMING_PID);
     PID.servo_jp(m_servo_jp_param);
+    TimingExit();
+}
+
+void mtsIntuitiveResearchKitArm::LimitGuardActivate(const bool active)
+{
+    auto & guard = m_limit_guard;
+    guard.active = false;
+    if (!guard.enabled || !active) {
+        return;
+    }
+    prmConfigurationJoint configuration;
+    if (!PID.configuration_js(configuration).IsOK()) {
+        return;
+    }
+    const size_t nbJoints = configuration.PositionMin().size();
+    if ((configuration.PositionMax().size() != nbJoints)
+        || (nbJoints == 0)) {
+        return;
+    }
+    guard.lower.ForceAssign(configuration.PositionMin());
+    guard.lower.Add(guard.margin);
+    guard.upper.ForceAssign(configuration.PositionMax());
+    guard.upper.Subtract(guard.margin);
+    if (guard.deceleration.size() == nbJoints) {
+        guard.decelerationUsed.ForceAssign(guard.deceleration);
+    } else if (m_trajectory_j.a.size() == nbJoints) {
+        guard.decelerationUsed.ForceAssign(m_trajectory_j.a);
+    } else {
+        return;
+    }
+    guard.active = true;
+}
+
+void mtsIntuitiveResearchKitArm::LimitGuard(vctDoubleVec & goal)
+{
+    auto & guard = m_limit_guard;
+    if (!guard.active) {
+        return;
+    }
+    // previous goal sent to PID
+    const vctDoubleVec & previous = m_pid_setpoint_js.Position();
+    const size_t nbJoints = std::min(goal.size(), guard.lower.size());
+    if (previous.size() < nbJoints) {
+        return;
+    }
+    const double dt = ExpectedPeriod();
+    double scale = 1.0;
+    bool clamped = false;
+    for (size_t index = 0; index < nbJoints; ++index) {
+        const double step = goal.Element(index) - previous.Element(index);
+        if (step == 0.0) {
+            continue;
+        }
+        // distance left in the direction of motion
+        const double distance = (step > 0.0)
+            ? guard.upper.Element(index) - previous.Element(index)
+            : previous.Element(index) - guard.lower.Element(index);
+        if (distance <= 0.0) {
+            // already past limit, can only move back in
+            goal.Element(index) = previous.Element(index);
+            clamped = true;
+            continue;
+        }
+        // largest velocity v such that v dt + v^2 / 2a <= distance
+        const double a = guard.decelerationUsed.Element(index);
+        const double adt = a * dt;
+        const double allowedStep = (-adt + std::sqrt(adt * adt + 2.0 * a * distance)) * dt;
+        const double absStep = std::abs(step);
+        if (absStep > allowedStep) {
+            scale = std::min(scale, allowedStep / absStep);
+        }
+    }
+    if (scale < 1.0) {
+        for (size_t index = 0; index < nbJoints; ++index) {
+            goal.Element(index) = previous.Element(index)
+                + scale * (goal.Element(index) - previous.Element(index));
+        }
+    }
+    if ((scale < 1.0) || clamped) {
+        ++guard.scaled;
+        const double now = StateTable.GetTic();
+        if ((now - guard.time_last_message) > 1.0 * cmn_s) {
+            guard.time_last_message = now;
+            std::stringstream message;
+            message << this->GetName() << ": joint limit guard active, motion scaled by "
+                    << std::fixed << std::setprecision(2) << scale
+                    << " (" << guard.scaled << " times)";
+            m_arm_interface->SendWarning(message.str());
+            m_flight_recorder.history.Event(now, "limit guard");
+        }
+    }
 }
 
 void mtsIntuitiveResearchKitArm::Freeze(void)
@@ -1797,6 +3248,7 @@ void mtsIntuitiveResearchKitArm::Freeze(void)
 
 void mtsIntuitiveResearchKitArm::servo_jp(const prmPositionJointSet & newPosition)
 {
+    m_flight_recorder.commands |= FLIGHT_SERVO_JP;
     if (!ArmIsReady("servo_jp", mtsIntuitiveResearchKitArmTypes::JOINT_SPACE)) {
         return;
     }
@@ -1807,6 +3259,113 @@ void mtsIntuitiveResearchKitArm::servo_jp(const prmPositionJointSet & newPositio
     // set goal
     m_servo_jp.Assign(newPosition.Goal(), NumberOfJointsKinematics());
     m_new_pid_goal = true;
+    m_servo_interpolation.new_goal = true;
+    m_servo_interpolation.goal_time = newPosition.Timestamp();
+}
+
+void mtsIntuitiveResearchKitArm::servo_jp_latest(const prmPositionJointSet & newPosition)
+{
+    m_servo_commands.servo_jp.Write(newPosition, ++m_servo_commands.sequence);
+}
+
+void mtsIntuitiveResearchKitArm::servo_cp_latest(const prmPositionCartesianSet & newPosition)
+{
+    m_servo_commands.servo_cp.Write(newPosition, ++m_servo_commands.sequence);
+}
+
+void mtsIntuitiveResearchKitArm::servo_jf_latest(const prmForceTorqueJointSet & newEffort)
+{
+    m_servo_commands.servo_jf.Write(newEffort, ++m_servo_commands.sequence);
+}
+
+void mtsIntuitiveResearchKitArm::body_servo_cf_latest(const prmForceCartesianSet & newForce)
+{
+    m_servo_commands.body_servo_cf.Write(newForce, ++m_servo_commands.sequence);
+}
+
+void mtsIntuitiveResearchKitArm::spatial_servo_cf_latest(const prmForceCartesianSet & newForce)
+{
+    m_servo_commands.spatial_servo_cf.Write(newForce, ++m_servo_commands.sequence);
+}
+
+void mtsIntuitiveResearchKitArm::ServoCommandsProcess(void)
+{
+    // fetch all new commands
+    size_t sequences[SERVO_NUMBER_OF_COMMANDS];
+    bool fresh[SERVO_NUMBER_OF_COMMANDS];
+    size_t nbFresh = 0;
+    fresh[SERVO_JP] = m_servo_commands.servo_jp.Fetch();
+    sequences[SERVO_JP] = m_servo_commands.servo_jp.Sequence();
+    fresh[SERVO_CP] = m_servo_commands.servo_cp.Fetch();
+    sequences[SERVO_CP] = m_servo_commands.servo_cp.Sequence();
+    fresh[SERVO_JF] = m_servo_commands.servo_jf.Fetch();
+    sequences[SERVO_JF] = m_servo_commands.servo_jf.Sequence();
+    fresh[BODY_SERVO_CF] = m_servo_commands.body_servo_cf.Fetch();
+    sequences[BODY_SERVO_CF] = m_servo_commands.body_servo_cf.Sequence();
+    fresh[SPATIAL_SERVO_CF] = m_servo_commands.spatial_servo_cf.Fetch();
+    sequences[SPATIAL_SERVO_CF] = m_servo_commands.spatial_servo_cf.Sequence();
+    for (size_t index = 0; index < SERVO_NUMBER_OF_COMMANDS; ++index) {
+        if (fresh[index]) {
+            ++nbFresh;
+        }
+    }
+
+    // apply in the order they were received, usually there's only one
+    for (; nbFresh > 0; --nbFresh) {
+        size_t oldest = SERVO_NUMBER_OF_COMMANDS;
+        for (size_t index = 0; index < SERVO_NUMBER_OF_COMMANDS; ++index) {
+            if (fresh[index]
+                && ((oldest == SERVO_NUMBER_OF_COMMANDS)
+                    || (sequences[index] < sequences[oldest]))) {
+                oldest = index;
+            }
+        }
+        fresh[oldest] = false;
+        switch (oldest) {
+        case SERVO_JP:
+            servo_jp(m_servo_commands.servo_jp.Value());
+            break;
+        case SERVO_CP:
+            servo_cp(m_servo_commands.servo_cp.Value());
+            break;
+        case SERVO_JF:
+            servo_jf(m_servo_commands.servo_jf.Value());
+            break;
+        case BODY_SERVO_CF:
+            body_servo_cf(m_servo_commands.body_servo_cf.Value());
+            break;
+        case SPATIAL_SERVO_CF:
+            spatial_servo_cf(m_servo_commands.spatial_servo_cf.Value());
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitArm::servo_statistics(mtsIntuitiveResearchKitServoStatistics & statistics) const
+{
+    statistics.command_names = {"servo_jp", "servo_cp", "servo_jf",
+                                "body/servo_cf", "spatial/servo_cf"};
+    statistics.received = {m_servo_commands.servo_jp.Received(),
+                           m_servo_commands.servo_cp.Received(),
+                           m_servo_commands.servo_jf.Received(),
+                           m_servo_commands.body_servo_cf.Received(),
+                           m_servo_commands.spatial_servo_cf.Received()};
+    statistics.superseded = {m_servo_commands.servo_jp.Superseded(),
+                             m_servo_commands.servo_cp.Superseded(),
+                             m_servo_commands.servo_jf.Superseded(),
+                             m_servo_commands.body_servo_cf.Superseded(),
+                             m_servo_commands.spatial_servo_cf.Superseded()};
+}
+
+void mtsIntuitiveResearchKitArm::servo_statistics_reset(void)
+{
+    m_servo_commands.servo_jp.ResetCounters();
+    m_servo_commands.servo_cp.ResetCounters();
+    m_servo_commands.servo_jf.ResetCounters();
+    m_servo_commands.body_servo_cf.ResetCounters();
+    m_servo_commands.spatial_servo_cf.ResetCounters();
 }
 
 void mtsIntuitiveResearchKitArm::servo_jr(const prmPositionJointSet & difference)
@@ -1824,13 +3383,17 @@ void mtsIntuitiveResearchKitArm::servo_jr(const prmPositionJointSet & difference
     }
     m_servo_jp.Ref(NumberOfJointsKinematics()).Add(difference.Goal());
     m_new_pid_goal = true;
+    m_servo_interpolation.new_goal = true;
+    m_servo_interpolation.goal_time = difference.Timestamp();
 }
 
 void mtsIntuitiveResearchKitArm::move_jp(const prmPositionJointSet & newPosition)
 {
+    m_flight_recorder.commands |= FLIGHT_MOVE_JP;
     if (!ArmIsReady("move_jp", mtsIntuitiveResearchKitArmTypes::JOINT_SPACE)) {
         return;
     }
+    trajectory_queue_reset();
 
     // set control mode
     SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::JOINT_SPACE,
@@ -1847,6 +3410,7 @@ void mtsIntuitiveResearchKitArm::move_jr(const prmPositionJointSet & newPosition
     if (!ArmIsReady("move_jr", mtsIntuitiveResearchKitArmTypes::JOINT_SPACE)) {
         return;
     }
+    trajectory_queue_reset();
 
     // set control mode
     SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::JOINT_SPACE,
@@ -1855,9 +3419,8 @@ void mtsIntuitiveResearchKitArm::move_jr(const prmPositionJointSet & newPosition
     UpdateIsBusy(true);
     // if trajectory is active, add to existing goal
     if (m_trajectory_j.is_active) {
-        vctDoubleVec relative(m_trajectory_j.goal.size());
-        ToJointsPID(newPosition.Goal(), relative);
-        m_trajectory_j.goal.Add(relative);
+        ToJointsPID(newPosition.Goal(), m_trajectory_j.goal_relative);
+        m_trajectory_j.goal.Add(m_trajectory_j.goal_relative);
     } else {
         // new goal, goal + setpoint
         ToJointsPID(newPosition.Goal(), m_trajectory_j.goal);
@@ -1870,6 +3433,7 @@ void mtsIntuitiveResearchKitArm::move_jr(const prmPositionJointSet & newPosition
 
 void mtsIntuitiveResearchKitArm::servo_cp(const prmPositionCartesianSet & newPosition)
 {
+    m_flight_recorder.commands |= FLIGHT_SERVO_CP;
     if (!ArmIsReady("servo_cp", mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE)) {
         return;
     }
@@ -1880,6 +3444,8 @@ void mtsIntuitiveResearchKitArm::servo_cp(const prmPositionCartesianSet & newPos
     // set goal
     CartesianSetParam = newPosition;
     m_new_pid_goal = true;
+    m_servo_interpolation.new_goal = true;
+    m_servo_interpolation.goal_time = newPosition.Timestamp();
 }
 
 void mtsIntuitiveResearchKitArm::servo_cr(const prmPositionCartesianSet & difference)
@@ -1898,9 +3464,11 @@ void mtsIntuitiveResearchKitArm::servo_cr(const prmPositionCartesianSet & differ
 
 void mtsIntuitiveResearchKitArm::move_cp(const prmPositionCartesianSet & newPosition)
 {
+    m_flight_recorder.commands |= FLIGHT_MOVE_CP;
     if (!ArmIsReady("move_cp", mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE)) {
         return;
     }
+    trajectory_queue_reset();
 
     // set control mode
     SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE,
@@ -1909,15 +3477,15 @@ void mtsIntuitiveResearchKitArm::move_cp(const prmPositionCartesianSet & newPosi
     // copy current position
     vctDoubleVec jointSet(m_kin_measured_js.Position());
 
-    // compute desired slave position
+    // compute desired position in arm's base frame
     CartesianPositionFrm.From(newPosition.Goal());
+    CartesianPositionFrm = m_base_frame.Inverse() * CartesianPositionFrm;
 
-    if (this->InverseKinematics(jointSet, m_base_frame.Inverse() * CartesianPositionFrm) == robManipulator::ESUCCESS) {
-        // make sure trajectory is reset
-        control_move_jp_on_start();
-        // new goal
-        ToJointsPID(jointSet, m_trajectory_j.goal);
-        m_trajectory_j.goal_v.SetAll(0.0);
+    // make sure the goal can be reached before moving
+    if (this->InverseKinematics(jointSet, CartesianPositionFrm) == robManipulator::ESUCCESS) {
+        vctFrm3 goal;
+        goal.From(CartesianPositionFrm);
+        trajectory_c_start(goal);
     } else {
         // shows robManipulator error if used
         if (this->Manipulator) {
@@ -1932,9 +3500,185 @@ void mtsIntuitiveResearchKitArm::move_cp(const prmPositionCartesianSet & newPosi
     }
 }
 
+void mtsIntuitiveResearchKitArm::trajectory_c_start(const vctFrm3 & goal,
+                                                    const bool updateBusy)
+{
+    vctFrm3 start;
+    double linearVelocity = 0.0;
+    double angularVelocity = 0.0;
+    if (m_trajectory_j.is_active && m_trajectory_c.is_active) {
+        // new goal during a trajectory, start from current position and velocity
+        start = m_trajectory_c.cp;
+        linearVelocity = m_trajectory_c.generator.LinearVelocity();
+        angularVelocity = m_trajectory_c.generator.AngularVelocity();
+    } else {
+        start.From(m_local_setpoint_cp_frame);
+        m_trajectory_c.jp.Assign(m_kin_setpoint_js.Position());
+        m_trajectory_c.cp = start;
+    }
+    m_trajectory_c.generator.SetLimits(m_trajectory_j.ratio_v * m_trajectory_c.v_linear,
+                                       m_trajectory_j.ratio_a * m_trajectory_c.a_linear,
+                                       m_trajectory_j.ratio_v * m_trajectory_c.v_angular,
+                                       m_trajectory_j.ratio_a * m_trajectory_c.a_angular);
+    m_trajectory_c.generator.Start(start, goal, StateTable.GetTic(),
+                                   linearVelocity, angularVelocity);
+    // make sure trajectory is reset
+    if (updateBusy) {
+        control_move_jp_on_start();
+    } else {
+        m_trajectory_j.is_active = true;
+        m_trajectory_j.end_time = 0.0;
+    }
+    m_trajectory_c.is_active = true;
+}
+
+void mtsIntuitiveResearchKitArm::move_jp_queue(const prmPositionJointSet & newPosition)
+{
+    m_flight_recorder.commands |= FLIGHT_MOVE_JP;
+    if (!ArmIsReady("move_jp_queue", mtsIntuitiveResearchKitArmTypes::JOINT_SPACE)) {
+        return;
+    }
+    // set control mode if the arm is not already following the queue
+    if (!m_trajectory_queue.is_active) {
+        SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::JOINT_SPACE,
+                               mtsIntuitiveResearchKitArmTypes::TRAJECTORY_MODE);
+    }
+    TrajectoryWaypoint * waypoint = trajectory_queue_push("move_jp_queue",
+                                                          mtsIntuitiveResearchKitArmTypes::JOINT_SPACE);
+    if (!waypoint) {
+        return;
+    }
+    ToJointsPID(newPosition.Goal(), waypoint->jp);
+    if (!m_trajectory_queue.is_active) {
+        trajectory_queue_next();
+    }
+}
+
+void mtsIntuitiveResearchKitArm::move_cp_queue(const prmPositionCartesianSet & newPosition)
+{
+    m_flight_recorder.commands |= FLIGHT_MOVE_CP;
+    if (!ArmIsReady("move_cp_queue", mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE)) {
+        return;
+    }
+
+    // compute desired position in arm's base frame
+    CartesianPositionFrm.From(newPosition.Goal());
+    CartesianPositionFrm = m_base_frame.Inverse() * CartesianPositionFrm;
+
+    // make sure the waypoint can be reached before queuing it
+    vctDoubleVec jointSet(m_kin_measured_js.Position());
+    if (this->InverseKinematics(jointSet, CartesianPositionFrm) != robManipulator::ESUCCESS) {
+        m_arm_interface->SendError(this->GetName() + ": move_cp_queue, unable to solve inverse kinematics for waypoint");
+        return;
+    }
+    // set control mode if the arm is not already following the queue
+    if (!m_trajectory_queue.is_active) {
+        SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE,
+                               mtsIntuitiveResearchKitArmTypes::TRAJECTORY_MODE);
+        // space change might have been refused
+        if (m_control_space != mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE) {
+            return;
+        }
+    }
+    TrajectoryWaypoint * waypoint = trajectory_queue_push("move_cp_queue",
+                                                          mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE);
+    if (!waypoint) {
+        return;
+    }
+    waypoint->cp.From(CartesianPositionFrm);
+    if (!m_trajectory_queue.is_active) {
+        trajectory_queue_next();
+    }
+}
+
+void mtsIntuitiveResearchKitArm::trajectory_queue_clear(void)
+{
+    // keep current trajectory, drop waypoints not started
+    m_trajectory_queue.size = 0;
+}
+
+mtsIntuitiveResearchKitArm::TrajectoryWaypoint *
+mtsIntuitiveResearchKitArm::trajectory_queue_push(const std::string & methodName,
+                                                  const mtsIntuitiveResearchKitArmTypes::ControlSpace space)
+{
+    const bool queueInUse = m_trajectory_queue.is_active || (m_trajectory_queue.size > 0);
+    if (queueInUse && (space != m_trajectory_queue.space)) {
+        m_arm_interface->SendError(this->GetName() + ": " + methodName
+                                   + ", can't mix joint and cartesian waypoints");
+        return 0;
+    }
+    const size_t capacity = m_trajectory_queue.waypoints.size();
+    if (m_trajectory_queue.size == capacity) {
+        m_arm_interface->SendError(this->GetName() + ": " + methodName
+                                   + ", waypoint queue is full (" + std::to_string(capacity) + ")");
+        return 0;
+    }
+    m_trajectory_queue.space = space;
+    const size_t tail = (m_trajectory_queue.head + m_trajectory_queue.size) % capacity;
+    ++m_trajectory_queue.size;
+    return &(m_trajectory_queue.waypoints[tail]);
+}
+
+bool mtsIntuitiveResearchKitArm::trajectory_queue_next(void)
+{
+    if (m_trajectory_queue.size == 0) {
+        return false;
+    }
+    // previous waypoint passed, arm is already busy
+    const bool blending = m_trajectory_queue.is_active && m_trajectory_j.is_active;
+    if (m_trajectory_queue.is_active) {
+        m_trajectory_queue.waypoint_reached_event(m_trajectory_queue.index);
+    }
+    const TrajectoryWaypoint & waypoint = m_trajectory_queue.waypoints[m_trajectory_queue.head];
+    m_trajectory_queue.head = (m_trajectory_queue.head + 1) % m_trajectory_queue.waypoints.size();
+    --m_trajectory_queue.size;
+    ++m_trajectory_queue.index;
+    m_trajectory_queue.is_active = true;
+    if (m_trajectory_queue.space == mtsIntuitiveResearchKitArmTypes::JOINT_SPACE) {
+        // Reflexxes uses current position and velocity
+        if (blending) {
+            m_trajectory_j.end_time = 0.0;
+        } else {
+            control_move_jp_on_start();
+        }
+        m_trajectory_j.goal.Assign(waypoint.jp);
+        m_trajectory_j.goal_v.SetAll(0.0);
+    } else {
+        trajectory_c_start(waypoint.cp, !blending);
+    }
+    return true;
+}
+
+void mtsIntuitiveResearchKitArm::trajectory_queue_reset(void)
+{
+    m_trajectory_queue.head = 0;
+    m_trajectory_queue.size = 0;
+    m_trajectory_queue.is_active = false;
+    m_trajectory_queue.index = -1;
+}
+
+void mtsIntuitiveResearchKitArm::trajectory_queue_allocate(const size_t capacity)
+{
+    m_trajectory_queue.waypoints.resize(capacity);
+    for (auto & waypoint : m_trajectory_queue.waypoints) {
+        waypoint.jp.SetSize(NumberOfJoints());
+    }
+    trajectory_queue_reset();
+}
+
 void mtsIntuitiveResearchKitArm::set_base_frame(const prmPositionCartesianSet & newBaseFrame)
 {
     if (newBaseFrame.Valid()) {
+        // SUJ and ECM mostly re-send the same frame, nothing to do
+        // then.  Compare to the last goal received since m_base_frame
+        // is normalized
+        if (this->m_base_frame_valid
+            && this->m_base_frame_goal.Translation().Equal(newBaseFrame.Goal().Translation())
+            && this->m_base_frame_goal.Rotation().Equal(newBaseFrame.Goal().Rotation())
+            && (this->m_measured_cp.ReferenceFrame() == newBaseFrame.ReferenceFrame())) {
+            return;
+        }
+        this->m_base_frame_goal.Assign(newBaseFrame.Goal());
         this->m_base_frame.FromNormalized(newBaseFrame.Goal());
         this->m_base_frame_valid = true;
         this->m_measured_cp.SetReferenceFrame(newBaseFrame.ReferenceFrame());
@@ -1947,16 +3691,28 @@ void mtsIntuitiveResearchKitArm::set_base_frame(const prmPositionCartesianSet &
 void mtsIntuitiveResearchKitArm::ErrorEventHandler(const mtsMessage & message)
 {
     m_arm_interface->SendError(this->GetName() + ": received [" + message.Message + "]");
+    m_flight_recorder.history.Event(StateTable.GetTic(), "error " + message.Message);
     SetDesiredState("FAULT");
 }
 
 void mtsIntuitiveResearchKitArm::PositionLimitEventHandler(const vctBoolVec & CMN_UNUSED(flags))
 {
     m_arm_interface->SendWarning(this->GetName() + ": PID position limit");
+    m_flight_recorder.history.Event(StateTable.GetTic(), "PID position limit");
+    m_flight_recorder.history.Trigger(StateTable.GetTic(), "PID position limit");
 }
 
 void mtsIntuitiveResearchKitArm::BiasEncoderEventHandler(const int & nbSamples)
 {
+    // encoders not preloaded, adaptive bias will replace the single
+    // sample bias requested to check preloads
+    if ((nbSamples > 0) && mHomingBiasEncoderRequested
+        && m_encoder_bias.enabled && IO.GetAnalogInputPosSI.IsValid()
+        && !m_encoder_bias.sampling) {
+        EncoderBiasStart();
+        return;
+    }
+
     // encoders are biased from pots
     m_encoders_biased_from_pots = true;
 
@@ -1973,6 +3729,11 @@ void mtsIntuitiveResearchKitArm::BiasEncoderEventHandler(const int & nbSamples)
         // pots and MTM search for roll limits.
         m_encoders_biased = true;
         m_arm_interface->SendStatus(this->GetName() + ": encoders seem to be already biased");
+        // if the arm was fully homed before restart, we can skip the
+        // rest of the homing procedure
+        if (mHomingBiasEncoderRequested && m_calibration_snapshot.Enabled()) {
+            m_calibration_restored = CalibrationSnapshotValidate();
+        }
     }
 
     if (mHomingBiasEncoderRequested) {
@@ -2005,6 +3766,7 @@ void mtsIntuitiveResearchKitArm::local_query_cp(const vctDoubleVec & jointValues
 
 void mtsIntuitiveResearchKitArm::servo_jf(const prmForceTorqueJointSet & effort)
 {
+    m_flight_recorder.commands |= FLIGHT_SERVO_JF;
     if (!ArmIsReady("servo_jf", mtsIntuitiveResearchKitArmTypes::JOINT_SPACE)) {
         return;
     }
@@ -2014,11 +3776,12 @@ void mtsIntuitiveResearchKitArm::servo_jf(const prmForceTorqueJointSet & effort)
                            mtsIntuitiveResearchKitArmTypes::EFFORT_MODE);
 
     // set new effort
-    mEffortJointSet.ForceTorque().Assign(effort.ForceTorque());
+    m_kinematics->effort_set.ForceTorque().Assign(effort.ForceTorque());
 }
 
 void mtsIntuitiveResearchKitArm::body_servo_cf(const prmForceCartesianSet & wrench)
 {
+    m_flight_recorder.commands |= FLIGHT_SERVO_CF;
     if (!ArmIsReady("body_servo_cf", mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE)) {
         return;
     }
@@ -2038,6 +3801,7 @@ void mtsIntuitiveResearchKitArm::body_servo_cf(const prmForceCartesianSet & wren
 
 void mtsIntuitiveResearchKitArm::spatial_servo_cf(const prmForceCartesianSet & wrench)
 {
+    m_flight_recorder.commands |= FLIGHT_SERVO_CF;
     if (!ArmIsReady("spatial_servo_cf", mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE)) {
         return;
     }
@@ -2060,6 +3824,11 @@ void mtsIntuitiveResearchKitArm::body_set_cf_orientation_absolute(const bool & a
     m_body_cf_orientation_absolute = absolute;
 }
 
+void mtsIntuitiveResearchKitArm::body_cf_orientation_absolute(bool & absolute) const
+{
+    absolute = m_body_cf_orientation_absolute;
+}
+
 void mtsIntuitiveResearchKitArm::use_gravity_compensation(const bool & gravityCompensation)
 {
     m_gravity_compensation = gravityCompensation;
@@ -0,0 +1,262 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+
+#include <cisstCommon/cmnConstants.h>
+#include <cisstCommon/cmnUnits.h>
+#include <cisstCommon/cmnPath.h>
+#include <cisstCommon/cmnLogger.h>
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitCalibrationSnapshot.h>
+
+mtsIntuitiveResearchKitCalibrationSnapshot::~mtsIntuitiveResearchKitCalibrationSnapshot()
+{
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_one();
+        // pending request is processed before the thread exits
+        m_thread.join();
+    }
+}
+
+bool mtsIntuitiveResearchKitCalibrationSnapshot::Configure(const Json::Value & jsonConfig,
+                                                           const std::string & armName,
+                                                           std::string & errorMessage)
+{
+    m_arm_name = armName;
+    m_filename.clear();
+    m_revolute_tolerance = 3.0 * cmnPI_180;
+    m_prismatic_tolerance = 3.0 * cmn_mm;
+    m_max_age = 3600.0 * cmn_s;
+    m_restore_engaged = false;
+
+    if (jsonConfig.isNull()) {
+        return true;
+    }
+
+    const Json::Value jsonDirectory = jsonConfig["directory"];
+    if (jsonDirectory.isNull() || jsonDirectory.asString().empty()) {
+        errorMessage = "\"directory\" must be defined to use calibration snapshots";
+        return false;
+    }
+
+    Json::Value jsonValue = jsonConfig["revolute-tolerance"];
+    if (!jsonValue.isNull()) {
+        m_revolute_tolerance = jsonValue.asDouble();
+    }
+    jsonValue = jsonConfig["prismatic-tolerance"];
+    if (!jsonValue.isNull()) {
+        m_prismatic_tolerance = jsonValue.asDouble();
+    }
+    jsonValue = jsonConfig["max-age"];
+    if (!jsonValue.isNull()) {
+        m_max_age = jsonValue.asDouble();
+    }
+    m_restore_engaged = jsonConfig.get("restore-engaged", m_restore_engaged).asBool();
+    if ((m_revolute_tolerance <= 0.0)
+        || (m_prismatic_tolerance <= 0.0)
+        || (m_max_age <= 0.0)) {
+        errorMessage = "\"revolute-tolerance\", \"prismatic-tolerance\" and \"max-age\" must be strictly positive";
+        return false;
+    }
+
+    m_filename = jsonDirectory.asString() + "/" + m_arm_name + "-calibration.json";
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&mtsIntuitiveResearchKitCalibrationSnapshot::WriterThread, this);
+    }
+    return true;
+}
+
+bool mtsIntuitiveResearchKitCalibrationSnapshot::Save(const std::string & serialNumber,
+                                                      const vctDoubleVec & encoders,
+                                                      const vctDoubleVec & potentiometers,
+                                                      const Json::Value & extra,
+                                                      std::string & errorMessage)
+{
+    if (!Enabled()) {
+        return true;
+    }
+    if (encoders.size() != potentiometers.size()) {
+        errorMessage = "encoders and potentiometers sizes don't match";
+        return false;
+    }
+
+    Json::Value jsonSnapshot;
+    jsonSnapshot["arm"] = m_arm_name;
+    jsonSnapshot["serial-number"] = serialNumber;
+    jsonSnapshot["time"] = static_cast<Json::Int64>(std::time(nullptr));
+    Json::Value jsonOffsets(Json::arrayValue);
+    for (size_t index = 0; index < encoders.size(); ++index) {
+        jsonOffsets.append(encoders.at(index) - potentiometers.at(index));
+    }
+    jsonSnapshot["offsets"] = jsonOffsets;
+    jsonSnapshot["extra"] = extra;
+    Request(REQUEST_SAVE, jsonSnapshot);
+    return true;
+}
+
+void mtsIntuitiveResearchKitCalibrationSnapshot::Request(const RequestType type,
+                                                         const Json::Value & snapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // only the latest request matters, e.g. remove after save
+        m_request = type;
+        m_request_snapshot = snapshot;
+    }
+    m_condition.notify_one();
+}
+
+void mtsIntuitiveResearchKitCalibrationSnapshot::WriterThread(void)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_condition.wait(lock, [this] {
+                return m_stop || (m_request != REQUEST_NONE);
+            });
+        if (m_request == REQUEST_NONE) {
+            // stop requested and nothing pending
+            return;
+        }
+        const RequestType type = m_request;
+        Json::Value snapshot;
+        snapshot.swap(m_request_snapshot);
+        m_request = REQUEST_NONE;
+        lock.unlock();
+        if (type == REQUEST_SAVE) {
+            std::string errorMessage;
+            if (!Write(snapshot, errorMessage)) {
+                CMN_LOG_RUN_WARNING << "mtsIntuitiveResearchKitCalibrationSnapshot: " << m_arm_name
+                                    << ", failed to save calibration snapshot, " << errorMessage << std::endl;
+            }
+        } else {
+            std::remove(m_filename.c_str());
+        }
+        lock.lock();
+    }
+}
+
+bool mtsIntuitiveResearchKitCalibrationSnapshot::Write(const Json::Value & jsonSnapshot,
+                                                       std::string & errorMessage) const
+{
+    const std::string temporary = m_filename + ".tmp";
+    {
+        std::ofstream file(temporary.c_str());
+        if (!file.is_open()) {
+            errorMessage = "unable to open \"" + temporary + "\"";
+            return false;
+        }
+        Json::StyledWriter writer;
+        file << writer.write(jsonSnapshot);
+        if (!file) {
+            errorMessage = "failed to write \"" + temporary + "\"";
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), m_filename.c_str()) != 0) {
+        errorMessage = "failed to rename \"" + temporary + "\" to \"" + m_filename + "\"";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool mtsIntuitiveResearchKitCalibrationSnapshot::Validate(const std::string & serialNumber,
+                                                          const vctDoubleVec & encoders,
+                                                          const vctDoubleVec & potentiometers,
+                                                          const vctBoolVec & prismatic,
+                                                          Json::Value & extra,
+                                                          std::string & errorMessage) const
+{
+    if (!Enabled()) {
+        errorMessage = "calibration snapshots are not enabled";
+        return false;
+    }
+    if (!cmnPath::Exists(m_filename)) {
+        errorMessage = "no calibration snapshot found";
+        return false;
+    }
+
+    Json::Value jsonSnapshot;
+    {
+        std::ifstream file(m_filename.c_str());
+        Json::Reader reader;
+        if (!file.is_open() || !reader.parse(file, jsonSnapshot)) {
+            errorMessage = "failed to parse \"" + m_filename + "\"";
+            return false;
+        }
+    }
+
+    if (jsonSnapshot["arm"].asString() != m_arm_name) {
+        errorMessage = "snapshot was saved for a different arm";
+        return false;
+    }
+    if (jsonSnapshot["serial-number"].asString() != serialNumber) {
+        errorMessage = "snapshot was saved with a different controller (serial number "
+            + jsonSnapshot["serial-number"].asString() + ")";
+        return false;
+    }
+
+    const double age = static_cast<double>(std::time(nullptr) - jsonSnapshot["time"].asInt64());
+    if ((age < 0.0) || (age > m_max_age)) {
+        std::stringstream message;
+        message << "snapshot is too old (" << age << "s)";
+        errorMessage = message.str();
+        return false;
+    }
+
+    const Json::Value jsonOffsets = jsonSnapshot["offsets"];
+    const size_t nbActuators = encoders.size();
+    if ((jsonOffsets.size() != nbActuators)
+        || (potentiometers.size() != nbActuators)) {
+        errorMessage = "snapshot size doesn't match the number of actuators";
+        return false;
+    }
+
+    for (size_t index = 0; index < nbActuators; ++index) {
+        const bool isPrismatic = (prismatic.size() == nbActuators) && prismatic.at(index);
+        const double tolerance = isPrismatic ? m_prismatic_tolerance : m_revolute_tolerance;
+        const double offset = encoders.at(index) - potentiometers.at(index);
+        const double error = std::fabs(offset - jsonOffsets[static_cast<Json::ArrayIndex>(index)].asDouble());
+        if (error > tolerance) {
+            std::stringstream message;
+            message << "encoders and potentiometers don't match the snapshot for actuator "
+                    << index + 1 << " (" << error << " > " << tolerance << ")";
+            errorMessage = message.str();
+            return false;
+        }
+    }
+
+    extra = jsonSnapshot["extra"];
+    return true;
+}
+
+void mtsIntuitiveResearchKitCalibrationSnapshot::Invalidate(void)
+{
+    if (Enabled()) {
+        Request(REQUEST_REMOVE, Json::Value());
+    }
+}
@@ -0,0 +1,335 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+
+#include <cisstCommon/cmnPortability.h>
+#include <cisstCommon/cmnLogger.h>
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
+
+// "DVRKCFG2", first 8 bytes of cache files, change if encoding changes
+#define CONFIG_CACHE_MAGIC "DVRKCFG2"
+
+namespace {
+
+    std::atomic<size_t> hits(0);
+    std::atomic<size_t> misses(0);
+
+    enum {TAG_NULL, TAG_INT, TAG_UINT, TAG_REAL, TAG_STRING, TAG_BOOLEAN, TAG_ARRAY, TAG_OBJECT};
+
+    // FNV-1a, only used to generate cache file names
+    uint64_t Hash(const std::string & text)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char character : text) {
+            hash ^= static_cast<unsigned char>(character);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    template <typename _type>
+    void Write(std::string & buffer, const _type value)
+    {
+        buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void WriteString(std::string & buffer, const std::string & text)
+    {
+        Write(buffer, static_cast<uint32_t>(text.size()));
+        buffer.append(text);
+    }
+
+    void Encode(std::string & buffer, const Json::Value & value)
+    {
+        switch (value.type()) {
+        case Json::nullValue:
+            Write(buffer, static_cast<uint8_t>(TAG_NULL));
+            break;
+        case Json::intValue:
+            Write(buffer, static_cast<uint8_t>(TAG_INT));
+            Write(buffer, static_cast<int64_t>(value.asLargestInt()));
+            break;
+        case Json::uintValue:
+            Write(buffer, static_cast<uint8_t>(TAG_UINT));
+            Write(buffer, static_cast<uint64_t>(value.asLargestUInt()));
+            break;
+        case Json::realValue:
+            Write(buffer, static_cast<uint8_t>(TAG_REAL));
+            Write(buffer, value.asDouble());
+            break;
+        case Json::stringValue:
+            Write(buffer, static_cast<uint8_t>(TAG_STRING));
+            WriteString(buffer, value.asString());
+            break;
+        case Json::booleanValue:
+            Write(buffer, static_cast<uint8_t>(TAG_BOOLEAN));
+            Write(buffer, static_cast<uint8_t>(value.asBool()));
+            break;
+        case Json::arrayValue:
+            Write(buffer, static_cast<uint8_t>(TAG_ARRAY));
+            Write(buffer, static_cast<uint32_t>(value.size()));
+            for (Json::ArrayIndex index = 0; index < value.size(); ++index) {
+                Encode(buffer, value[index]);
+            }
+            break;
+        case Json::objectValue:
+            {
+                Write(buffer, static_cast<uint8_t>(TAG_OBJECT));
+                const Json::Value::Members members = value.getMemberNames();
+                Write(buffer, static_cast<uint32_t>(members.size()));
+                for (const auto & member : members) {
+                    WriteString(buffer, member);
+                    Encode(buffer, value[member]);
+                }
+            }
+            break;
+        }
+    }
+
+    class Decoder {
+    public:
+        Decoder(const std::string & buffer, const size_t offset):
+            m_buffer(buffer),
+            m_offset(offset)
+        {}
+
+        template <typename _type>
+        bool Read(_type & value) {
+            if (m_offset + sizeof(value) > m_buffer.size()) {
+                return false;
+            }
+            memcpy(&value, m_buffer.data() + m_offset, sizeof(value));
+            m_offset += sizeof(value);
+            return true;
+        }
+
+        bool ReadString(std::string & text) {
+            uint32_t size;
+            if (!Read(size) || (m_offset + size > m_buffer.size())) {
+                return false;
+            }
+            text.assign(m_buffer.data() + m_offset, size);
+            m_offset += size;
+            return true;
+        }
+
+        bool Decode(Json::Value & value) {
+            uint8_t tag;
+            if (!Read(tag)) {
+                return false;
+            }
+            switch (tag) {
+            case TAG_NULL:
+                value = Json::Value(Json::nullValue);
+                return true;
+            case TAG_INT:
+                {
+                    int64_t data;
+                    if (!Read(data)) return false;
+                    value = Json::Value(static_cast<Json::LargestInt>(data));
+                    return true;
+                }
+            case TAG_UINT:
+                {
+                    uint64_t data;
+                    if (!Read(data)) return false;
+                    value = Json::Value(static_cast<Json::LargestUInt>(data));
+                    return true;
+                }
+            case TAG_REAL:
+                {
+                    double data;
+                    if (!Read(data)) return false;
+                    value = Json::Value(data);
+                    return true;
+                }
+            case TAG_STRING:
+                {
+                    std::string data;
+                    if (!ReadString(data)) return false;
+                    value = Json::Value(data);
+                    return true;
+                }
+            case TAG_BOOLEAN:
+                {
+                    uint8_t data;
+                    if (!Read(data)) return false;
+                    value = Json::Value(data != 0);
+                    return true;
+                }
+            case TAG_ARRAY:
+                {
+                    uint32_t size;
+                    if (!Read(size)) return false;
+                    value = Json::Value(Json::arrayValue);
+                    if (size > 0) {
+                        value.resize(size);
+                    }
+                    for (uint32_t index = 0; index < size; ++index) {
+                        if (!Decode(value[index])) return false;
+                    }
+                    return true;
+                }
+            case TAG_OBJECT:
+                {
+                    uint32_t size;
+                    if (!Read(size)) return false;
+                    value = Json::Value(Json::objectValue);
+                    std::string key;
+                    for (uint32_t index = 0; index < size; ++index) {
+                        if (!ReadString(key) || !Decode(value[key])) return false;
+                    }
+                    return true;
+                }
+            default:
+                return false;
+            }
+        }
+
+    protected:
+        const std::string & m_buffer;
+        size_t m_offset;
+    };
+
+    // header identifying a version of a source file.  Seconds are not
+    // enough, a file can be edited twice in the same second without
+    // changing its size so use the nanoseconds when available
+    bool SourceHeader(const std::string & filename, std::string & header)
+    {
+        struct stat status;
+        if (stat(filename.c_str(), &status) != 0) {
+            return false;
+        }
+#if (CISST_OS == CISST_LINUX)
+        const int64_t nanoseconds = status.st_mtim.tv_nsec;
+#elif (CISST_OS == CISST_DARWIN)
+        const int64_t nanoseconds = status.st_mtimespec.tv_nsec;
+#else
+        const int64_t nanoseconds = 0;
+#endif
+        header.clear();
+        header.append(CONFIG_CACHE_MAGIC, 8);
+        Write(header, static_cast<int64_t>(status.st_mtime));
+        Write(header, nanoseconds);
+        Write(header, static_cast<uint64_t>(status.st_size));
+        WriteString(header, filename);
+        return true;
+    }
+
+    std::string CacheFileName(const std::string & directory, const std::string & filename)
+    {
+        std::stringstream name;
+        name << directory << "/" << std::hex << Hash(filename) << ".dvrk-cache";
+        return name.str();
+    }
+}
+
+std::string & mtsIntuitiveResearchKitConfigCache::DirectoryReference(void)
+{
+    static std::string directory;
+    return directory;
+}
+
+void mtsIntuitiveResearchKitConfigCache::SetDirectory(const std::string & directory)
+{
+    DirectoryReference() = directory;
+}
+
+const std::string & mtsIntuitiveResearchKitConfigCache::Directory(void)
+{
+    return DirectoryReference();
+}
+
+size_t mtsIntuitiveResearchKitConfigCache::Hits(void)
+{
+    return hits.load();
+}
+
+size_t mtsIntuitiveResearchKitConfigCache::Misses(void)
+{
+    return misses.load();
+}
+
+bool mtsIntuitiveResearchKitConfigCache::Parse(const std::string & filename,
+                                               Json::Value & jsonValue,
+                                               std::string & errorMessage)
+{
+    const std::string & directory = Directory();
+    std::string header, cacheFileName;
+    const bool useCache = !directory.empty() && SourceHeader(filename, header);
+
+    // try to use the cache first
+    if (useCache) {
+        cacheFileName = CacheFileName(directory, filename);
+        std::ifstream cacheStream(cacheFileName, std::ios::binary);
+        if (cacheStream.is_open()) {
+            std::stringstream content;
+            content << cacheStream.rdbuf();
+            const std::string buffer = content.str();
+            if ((buffer.size() > header.size())
+                && (buffer.compare(0, header.size(), header) == 0)) {
+                Decoder decoder(buffer, header.size());
+                if (decoder.Decode(jsonValue)) {
+                    ++hits;
+                    return true;
+                }
+            }
+        }
+    }
+
+    // parse
+    std::ifstream jsonStream(filename.c_str());
+    Json::Reader jsonReader;
+    if (!jsonReader.parse(jsonStream, jsonValue)) {
+        errorMessage = jsonReader.getFormattedErrorMessages();
+        return false;
+    }
+    ++misses;
+
+    // save in cache, temporary file first
+    if (useCache) {
+        std::string buffer = header;
+        Encode(buffer, jsonValue);
+        std::stringstream temporary;
+        temporary << cacheFileName << "." << std::hash<std::thread::id>()(std::this_thread::get_id());
+        {
+            std::ofstream cacheStream(temporary.str(), std::ios::binary | std::ios::trunc);
+            if (!cacheStream.is_open()) {
+                CMN_LOG_INIT_WARNING << "mtsIntuitiveResearchKitConfigCache::Parse: can't create \""
+                                     << temporary.str() << "\", is the cache directory valid?" << std::endl;
+                return true;
+            }
+            cacheStream.write(buffer.data(), buffer.size());
+        }
+        std::remove(cacheFileName.c_str()); // rename fails on Windows if file exists
+        if (std::rename(temporary.str().c_str(), cacheFileName.c_str()) != 0) {
+            std::remove(temporary.str().c_str());
+        }
+    }
+    return true;
+}
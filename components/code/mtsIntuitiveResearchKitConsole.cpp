@@ -18,12 +18,19 @@ http://www.cisst.org/cisst/license.txt.
 
 // system include
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <iomanip>
 
 // cisst
 #include <cisstCommon/cmnPath.h>
 #include <cisstCommon/cmnClassRegister.h>
 #include <cisstCommon/cmnRandomSequence.h>
 #include <cisstOSAbstraction/osaDynamicLoader.h>
+#include <cisstOSAbstraction/osaGetTime.h>
 
 #include <cisstMultiTask/mtsInterfaceRequired.h>
 #include <cisstMultiTask/mtsInterfaceProvided.h>
@@ -46,6 +53,13 @@ http://www.cisst.org/cisst/license.txt.
 #include <sawIntuitiveResearchKit/mtsDaVinciEndoscopeFocus.h>
 #include <sawIntuitiveResearchKit/mtsTeleOperationPSM.h>
 #include <sawIntuitiveResearchKit/mtsTeleOperationECM.h>
+#include <sawIntuitiveResearchKit/mtsTeleOperationExecutor.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitUDPStreamer.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitSharedMemory.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRecorder.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitProximityMonitor.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitHealth.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConsole.h>
 
 #include <json/json.h>
@@ -74,23 +88,28 @@ void mtsIntuitiveResearchKitConsole::Arm::ConfigurePID(const std::string & confi
     m_PID_configuration_file = configFile;
     m_PID_component_name = m_name + "-PID";
 
-    mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
     mtsPID * pid = new mtsPID(m_PID_component_name,
                               (periodInSeconds != 0.0) ? periodInSeconds : mtsIntuitiveResearchKit::IOPeriod);
-    bool hasIO = true;
-    pid->Configure(m_PID_configuration_file);
-    if (m_simulation == SIMULATION_KINEMATIC) {
-        pid->SetSimulated();
-        hasIO = false;
-    }
-    componentManager->AddComponent(pid);
-    if (hasIO) {
-        componentManager->Connect(PIDComponentName(), "RobotJointTorqueInterface", IOComponentName(), Name());
-        if (periodInSeconds == 0.0) {
-            componentManager->Connect(PIDComponentName(), "ExecIn",
-                                      IOComponentName(), "ExecOut");
-        }
-    }
+    const bool hasIO = (m_simulation != SIMULATION_KINEMATIC);
+    // mtsPID::Configure might exit on errors, keep it in the
+    // console's thread, see RunStartupTasks
+    m_console->AddStartupTask(Name(), "PID",
+                              nullptr,
+                              [=] {
+                                  pid->Configure(m_PID_configuration_file);
+                                  if (!hasIO) {
+                                      pid->SetSimulated();
+                                  }
+                                  mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
+                                  componentManager->AddComponent(pid);
+                                  if (hasIO) {
+                                      componentManager->Connect(PIDComponentName(), "RobotJointTorqueInterface", IOComponentName(), Name());
+                                      if (periodInSeconds == 0.0) {
+                                          componentManager->Connect(PIDComponentName(), "ExecIn",
+                                                                    IOComponentName(), "ExecOut");
+                                      }
+                                  }
+                              });
 }
 
 void mtsIntuitiveResearchKitConsole::Arm::ConfigureArm(const ArmType armType,
@@ -101,6 +120,15 @@ void mtsIntuitiveResearchKitConsole::Arm::ConfigureArm(const ArmType armType,
     bool armPSMOrDerived = false;
     bool armECMOrDerived = false;
 
+    // chained arms don't have their own thread, the period is only
+    // used for computations
+    const bool chained = (m_execution == EXECUTION_CHAINED_IO);
+    const double armPeriod = chained ? 0.0 : periodInSeconds;
+    if (chained) {
+        m_console->mConnections.Add(Name(), "ExecIn",
+                                    IOComponentName(), "ExecOut");
+    }
+
     mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
     m_arm_configuration_file = kinematicsConfigFile;
     // for research kit arms, create, add to manager and connect to
@@ -108,40 +136,111 @@ void mtsIntuitiveResearchKitConsole::Arm::ConfigureArm(const ArmType armType,
     switch (armType) {
     case ARM_MTM:
         {
-            mtsIntuitiveResearchKitMTM * mtm = new mtsIntuitiveResearchKitMTM(Name(), periodInSeconds);
+            mtsIntuitiveResearchKitMTM * mtm = new mtsIntuitiveResearchKitMTM(Name(), armPeriod);
+            mtm->SetChainedPeriod(periodInSeconds);
             if (m_simulation == SIMULATION_KINEMATIC) {
                 mtm->set_simulated();
             }
             mtm->set_calibration_mode(m_calibration_mode);
-            mtm->Configure(m_arm_configuration_file);
-            SetBaseFrameIfNeeded(mtm);
-            componentManager->AddComponent(mtm);
+            mtm->SetRealTime(m_real_time);
+            mtm->SetExitOnConfigurationFailure(false); // see RunStartupTasks
+            m_console->AddStartupTask(Name(), "arm",
+                                      [=] {
+                                          mtm->Configure(m_arm_configuration_file);
+                                          return !mtm->ConfigurationFailed();
+                                      },
+                                      [=] {
+                                          SetBaseFrameIfNeeded(mtm);
+                                          mtsManagerLocal::GetInstance()->AddComponent(mtm);
+                                      });
         }
         break;
     case ARM_PSM:
         armPSMOrDerived = true;
         {
-            mtsIntuitiveResearchKitPSM * psm = new mtsIntuitiveResearchKitPSM(Name(), periodInSeconds);
+            mtsIntuitiveResearchKitPSM * psm = new mtsIntuitiveResearchKitPSM(Name(), armPeriod);
+            psm->SetChainedPeriod(periodInSeconds);
             if (m_simulation == SIMULATION_KINEMATIC) {
                 psm->set_simulated();
             }
             psm->set_calibration_mode(m_calibration_mode);
-            psm->Configure(m_arm_configuration_file);
-            SetBaseFrameIfNeeded(psm);
-            componentManager->AddComponent(psm);
+            psm->SetRealTime(m_real_time);
+            psm->SetExitOnConfigurationFailure(false); // see RunStartupTasks
+            m_console->AddStartupTask(Name(), "arm",
+                                      [=] {
+                                          psm->Configure(m_arm_configuration_file);
+                                          return !psm->ConfigurationFailed();
+                                      },
+                                      [=] {
+                                          SetBaseFrameIfNeeded(psm);
+                                          mtsManagerLocal::GetInstance()->AddComponent(psm);
+                                      });
 
             if (m_socket_server) {
-                mtsSocketServerPSM *serverPSM = new mtsSocketServerPSM(SocketComponentName(), periodInSeconds, m_IP, m_port);
+                // arms sharing a bridge use the component created by the first one
+                mtsSocketServerPSM * serverPSM = 0;
+                if (m_socket_bridge != "") {
+                    serverPSM = dynamic_cast<mtsSocketServerPSM *>(componentManager->GetComponent(SocketComponentName()));
+                }
+                if (serverPSM) {
+                    if (serverPSM->AddArm(Name())) {
+                        m_console->mConnections.Add(SocketComponentName(), Name(),
+                                                    ComponentName(), InterfaceName());
+                    } else {
+                        CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitConsole::Arm::ConfigureArm: failed to add \""
+                                           << Name() << "\" to socket bridge \"" << m_socket_bridge << "\""
+                                           << std::endl;
+                    }
+                    break;
+                }
+                const std::string serverInterface = (m_socket_bridge == "") ? "PSM" : Name();
+                serverPSM = new mtsSocketServerPSM(SocketComponentName(), periodInSeconds, m_IP, m_port,
+                                                   serverInterface);
+                if (m_socket_pod) {
+                    serverPSM->SetWireFormat(mtsSocketBasePSM::WIRE_POD);
+                }
+                // server replies with compact packets if it receives some
+                serverPSM->SetCompactResolution(m_socket_compact_translation, m_socket_compact_rotation);
+                serverPSM->SetCompactKeyframePeriod(m_socket_compact_keyframe);
+                if (m_socket_receive_thread) {
+                    serverPSM->SetReceiveMode(mtsSocketBasePSM::RECEIVE_THREAD);
+                }
+                serverPSM->SetPlayoutDelay(m_socket_playout_delay);
                 serverPSM->Configure();
                 componentManager->AddComponent(serverPSM);
-                m_console->mConnections.Add(SocketComponentName(), "PSM",
+                m_console->mConnections.Add(SocketComponentName(), serverInterface,
                                             ComponentName(), InterfaceName());
             }
         }
         break;
     case ARM_PSM_SOCKET:
         {
-            mtsSocketClientPSM * clientPSM = new mtsSocketClientPSM(Name(), periodInSeconds, m_IP, m_port);
+            // arms sharing a bridge use the component created by the first one
+            mtsSocketClientPSM * clientPSM = 0;
+            if (m_socket_bridge != "") {
+                clientPSM = dynamic_cast<mtsSocketClientPSM *>(componentManager->GetComponent(ComponentName()));
+            }
+            if (clientPSM) {
+                if (!clientPSM->AddArm(InterfaceName())) {
+                    CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitConsole::Arm::ConfigureArm: failed to add \""
+                                       << Name() << "\" to socket bridge \"" << m_socket_bridge << "\""
+                                       << std::endl;
+                }
+                break;
+            }
+            clientPSM = new mtsSocketClientPSM(ComponentName(), periodInSeconds, m_IP, m_port,
+                                               InterfaceName());
+            if (m_socket_compact) {
+                clientPSM->SetWireFormat(mtsSocketBasePSM::WIRE_COMPACT);
+            } else if (m_socket_pod) {
+                clientPSM->SetWireFormat(mtsSocketBasePSM::WIRE_POD);
+            }
+            clientPSM->SetCompactResolution(m_socket_compact_translation, m_socket_compact_rotation);
+            clientPSM->SetCompactKeyframePeriod(m_socket_compact_keyframe);
+            if (m_socket_receive_thread) {
+                clientPSM->SetReceiveMode(mtsSocketBasePSM::RECEIVE_THREAD);
+            }
+            clientPSM->SetRedundancy(m_socket_redundancy);
             clientPSM->Configure();
             componentManager->AddComponent(clientPSM);
         }
@@ -149,19 +248,30 @@ void mtsIntuitiveResearchKitConsole::Arm::ConfigureArm(const ArmType armType,
     case ARM_ECM:
         armECMOrDerived = true;
         {
-            mtsIntuitiveResearchKitECM * ecm = new mtsIntuitiveResearchKitECM(Name(), periodInSeconds);
+            mtsIntuitiveResearchKitECM * ecm = new mtsIntuitiveResearchKitECM(Name(), armPeriod);
+            ecm->SetChainedPeriod(periodInSeconds);
             if (m_simulation == SIMULATION_KINEMATIC) {
                 ecm->set_simulated();
             }
             ecm->set_calibration_mode(m_calibration_mode);
-            ecm->Configure(m_arm_configuration_file);
-            SetBaseFrameIfNeeded(ecm);
-            componentManager->AddComponent(ecm);
+            ecm->SetRealTime(m_real_time);
+            ecm->SetExitOnConfigurationFailure(false); // see RunStartupTasks
+            m_console->AddStartupTask(Name(), "arm",
+                                      [=] {
+                                          ecm->Configure(m_arm_configuration_file);
+                                          return !ecm->ConfigurationFailed();
+                                      },
+                                      [=] {
+                                          SetBaseFrameIfNeeded(ecm);
+                                          mtsManagerLocal::GetInstance()->AddComponent(ecm);
+                                      });
         }
         break;
     case ARM_SUJ:
         {
-            mtsIntuitiveResearchKitSUJ * suj = new mtsIntuitiveResearchKitSUJ(Name(), periodInSeconds);
+            mtsIntuitiveResearchKitSUJ * suj = new mtsIntuitiveResearchKitSUJ(Name(), armPeriod);
+            suj->SetChainedPeriod(periodInSeconds);
+            suj->SetRealTime(m_real_time);
             if (m_simulation == SIMULATION_KINEMATIC) {
                 suj->set_simulated();
             } else if (m_simulation == SIMULATION_NONE) {
@@ -188,8 +298,13 @@ void mtsIntuitiveResearchKitConsole::Arm::ConfigureArm(const ArmType armType,
                 m_console->mConnections.Add(Name(), "SUJ-Clutch-4",
                                             IOComponentName(), "SUJ-Clutch-4");
             }
-            suj->Configure(m_arm_configuration_file);
-            componentManager->AddComponent(suj);
+            // SUJ configuration exits on errors, keep it in the console's thread
+            m_console->AddStartupTask(Name(), "arm",
+                                      nullptr,
+                                      [=] {
+                                          suj->Configure(m_arm_configuration_file);
+                                          mtsManagerLocal::GetInstance()->AddComponent(suj);
+                                      });
         }
         break;
     case ARM_MTM_DERIVED:
@@ -203,8 +318,16 @@ void mtsIntuitiveResearchKitConsole::Arm::ConfigureArm(const ArmType armType,
                         mtm->set_simulated();
                     }
                     mtm->set_calibration_mode(m_calibration_mode);
-                    mtm->Configure(m_arm_configuration_file);
-                    SetBaseFrameIfNeeded(mtm);
+                    mtm->SetRealTime(m_real_time);
+                    mtm->SetExitOnConfigurationFailure(false); // see RunStartupTasks
+                    m_console->AddStartupTask(Name(), "arm",
+                                              [=] {
+                                                  mtm->Configure(m_arm_configuration_file);
+                                                  return !mtm->ConfigurationFailed();
+                                              },
+                                              [=] {
+                                                  SetBaseFrameIfNeeded(mtm);
+                                              });
                 } else {
                     CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitConsole::Arm::ConfigureArm: component \""
                                        << Name() << "\" doesn't seem to be derived from mtsIntuitiveResearchKitMTM."
@@ -229,8 +352,16 @@ void mtsIntuitiveResearchKitConsole::Arm::ConfigureArm(const ArmType armType,
                         psm->set_simulated();
                     }
                     psm->set_calibration_mode(m_calibration_mode);
-                    psm->Configure(m_arm_configuration_file);
-                    SetBaseFrameIfNeeded(psm);
+                    psm->SetRealTime(m_real_time);
+                    psm->SetExitOnConfigurationFailure(false); // see RunStartupTasks
+                    m_console->AddStartupTask(Name(), "arm",
+                                              [=] {
+                                                  psm->Configure(m_arm_configuration_file);
+                                                  return !psm->ConfigurationFailed();
+                                              },
+                                              [=] {
+                                                  SetBaseFrameIfNeeded(psm);
+                                              });
                 } else {
                     CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitConsole::Arm::ConfigureArm: component \""
                                        << Name() << "\" doesn't seem to be derived from mtsIntuitiveResearchKitPSM."
@@ -255,8 +386,16 @@ void mtsIntuitiveResearchKitConsole::Arm::ConfigureArm(const ArmType armType,
                         ecm->set_simulated();
                     }
                     ecm->set_calibration_mode(m_calibration_mode);
-                    ecm->Configure(m_arm_configuration_file);
-                    SetBaseFrameIfNeeded(ecm);
+                    ecm->SetRealTime(m_real_time);
+                    ecm->SetExitOnConfigurationFailure(false); // see RunStartupTasks
+                    m_console->AddStartupTask(Name(), "arm",
+                                              [=] {
+                                                  ecm->Configure(m_arm_configuration_file);
+                                                  return !ecm->ConfigurationFailed();
+                                              },
+                                              [=] {
+                                                  SetBaseFrameIfNeeded(ecm);
+                                              });
                 } else {
                     CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitConsole::Arm::ConfigureArm: component \""
                                        << Name() << "\" doesn't seem to be derived from mtsIntuitiveResearchKitECM."
@@ -373,6 +512,8 @@ void mtsIntuitiveResearchKitConsole::TeleopECM::ConfigureTeleop(const TeleopECMT
         {
             mtsTeleOperationECM * teleop = new mtsTeleOperationECM(m_name, periodInSeconds);
             teleop->Configure(jsonConfig);
+            teleop->SetRealTime(m_real_time);
+            teleop->SetChainedPeriod(m_chained_period);
             componentManager->AddComponent(teleop);
         }
         break;
@@ -384,6 +525,7 @@ void mtsIntuitiveResearchKitConsole::TeleopECM::ConfigureTeleop(const TeleopECMT
                 mtsTeleOperationECM * teleop = dynamic_cast<mtsTeleOperationECM *>(component);
                 if (teleop) {
                     teleop->Configure(jsonConfig);
+                    teleop->SetRealTime(m_real_time);
                 } else {
                     CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitConsole::Arm::ConfigureTeleop: component \""
                                        << Name() << "\" doesn't seem to be derived from mtsTeleOperationECM."
@@ -410,12 +552,34 @@ mtsIntuitiveResearchKitConsole::TeleopPSM::TeleopPSM(const std::string & name,
                                                      const std::string & nameMTM,
                                                      const std::string & namePSM):
     mSelected(false),
+    m_index(0),
+    m_mtm_index(0),
+    m_psm_index(0),
     m_name(name),
+    m_execution(EXECUTION_PERIODIC),
     mMTMName(nameMTM),
     mPSMName(namePSM)
 {
 }
 
+void mtsIntuitiveResearchKitConsole::TeleopPSM::DesiredStateEventHandler(const std::string & state)
+{
+    // events are queued so this might be the echo of an older
+    // command, never trust it to update the cache, only forget the
+    // last command if it doesn't match so the next one is always sent
+    StateCommandType command = COMMAND_NONE;
+    if (state == "ENABLED") {
+        command = COMMAND_ENABLE;
+    } else if (state == "DISABLED") {
+        command = COMMAND_DISABLE;
+    } else if (state == "ALIGNING_MTM") {
+        command = COMMAND_ALIGN_MTM;
+    }
+    if (command != m_last_state_command) {
+        m_last_state_command = COMMAND_NONE;
+    }
+}
+
 void mtsIntuitiveResearchKitConsole::TeleopPSM::ConfigureTeleop(const TeleopPSMType type,
                                                                 const double & periodInSeconds,
                                                                 const Json::Value & jsonConfig)
@@ -428,6 +592,8 @@ void mtsIntuitiveResearchKitConsole::TeleopPSM::ConfigureTeleop(const TeleopPSMT
         {
             mtsTeleOperationPSM * teleop = new mtsTeleOperationPSM(m_name, periodInSeconds);
             teleop->Configure(jsonConfig);
+            teleop->SetRealTime(m_real_time);
+            teleop->SetChainedPeriod(m_chained_period);
             componentManager->AddComponent(teleop);
         }
         break;
@@ -439,6 +605,7 @@ void mtsIntuitiveResearchKitConsole::TeleopPSM::ConfigureTeleop(const TeleopPSMT
                 mtsTeleOperationPSM * teleop = dynamic_cast<mtsTeleOperationPSM *>(component);
                 if (teleop) {
                     teleop->Configure(jsonConfig);
+                    teleop->SetRealTime(m_real_time);
                 } else {
                     CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitConsole::Arm::ConfigureTeleop: component \""
                                        << Name() << "\" doesn't seem to be derived from mtsTeleOperationPSM."
@@ -483,6 +650,8 @@ mtsIntuitiveResearchKitConsole::mtsIntuitiveResearchKitConsole(const std::string
                                    "power_on");
         mInterface->AddCommandVoid(&mtsIntuitiveResearchKitConsole::home, this,
                                    "home");
+        mInterface->AddCommandRead(&mtsIntuitiveResearchKitConsole::power_sequence_timeline, this,
+                                   "power_sequence_timeline", std::string());
         mInterface->AddEventWrite(ConfigurationEvents.ArmCurrentState,
                                   "ArmCurrentState", prmKeyValue());
         mInterface->AddCommandWrite(&mtsIntuitiveResearchKitConsole::teleop_enable, this,
@@ -521,6 +690,10 @@ mtsIntuitiveResearchKitConsole::mtsIntuitiveResearchKitConsole(const std::string
         // misc.
         mInterface->AddCommandRead(&mtsIntuitiveResearchKitConsole::calibration_mode, this,
                                    "calibration_mode", false);
+        mInterface->AddCommandRead(&mtsIntuitiveResearchKitConsole::distributed_links, this,
+                                   "distributed/links", std::vector<std::string>());
+        mInterface->AddCommandRead(&mtsIntuitiveResearchKitConsole::distributed_latencies, this,
+                                   "distributed/latencies", vctDoubleVec());
     }
 }
 
@@ -551,19 +724,26 @@ void mtsIntuitiveResearchKitConsole::calibration_mode(bool & result) const
     result = m_calibration_mode;
 }
 
+void mtsIntuitiveResearchKitConsole::set_host(const std::string & host)
+{
+    m_distributed.host = host;
+}
+
+const std::string & mtsIntuitiveResearchKitConsole::host(void) const
+{
+    return m_distributed.host;
+}
+
 void mtsIntuitiveResearchKitConsole::Configure(const std::string & filename)
 {
     mConfigured = false;
 
-    std::ifstream jsonStream;
-    jsonStream.open(filename.c_str());
-
     Json::Value jsonConfig, jsonValue;
-    Json::Reader jsonReader;
-    if (!jsonReader.parse(jsonStream, jsonConfig)) {
+    std::string jsonErrors;
+    if (!mtsIntuitiveResearchKitConfigCache::Parse(filename, jsonConfig, jsonErrors)) {
         CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to parse configuration" << std::endl
                                  << "File: " << filename << std::endl << "Error(s):" << std::endl
-                                 << jsonReader.getFormattedErrorMessages();
+                                 << jsonErrors;
         this->mConfigured = false;
         exit(EXIT_FAILURE);
     }
@@ -620,6 +800,31 @@ void mtsIntuitiveResearchKitConsole::Configure(const std::string & filename)
         mChatty = false;
     }
 
+    jsonValue = jsonConfig["direct-inputs"];
+    if (!jsonValue.empty()) {
+        m_direct_inputs = jsonValue.asBool();
+    }
+
+    // number of arms allowed to power at the same time in each power group
+    jsonValue = jsonConfig["power-sequence"]["simultaneous"];
+    if (!jsonValue.empty()) {
+        const int simultaneous = jsonValue.asInt();
+        if (simultaneous < 1) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: power-sequence:simultaneous must be at least 1" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        m_power_sequence.simultaneous = simultaneous;
+    }
+    jsonValue = jsonConfig["power-sequence"]["timeout"];
+    if (!jsonValue.empty()) {
+        const double timeout = jsonValue.asDouble();
+        if (timeout <= 0.0) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: power-sequence:timeout must be strictly positive" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        m_power_sequence.timeout = timeout;
+    }
+
     // get user preferences
     jsonValue = jsonConfig["io"];
     if (!jsonValue.empty()) {
@@ -649,6 +854,21 @@ void mtsIntuitiveResearchKitConsole::Configure(const std::string & filename)
             port = jsonValue.asString();
         }
 
+        // default execution for all arms using the IO
+        jsonValue = jsonConfig["io"]["arm-execution"];
+        if (!jsonValue.empty()) {
+            const std::string executionString = jsonValue.asString();
+            if (executionString == "PERIODIC") {
+                m_arm_execution = Arm::EXECUTION_PERIODIC;
+            } else if (executionString == "CHAINED_IO") {
+                m_arm_execution = Arm::EXECUTION_CHAINED_IO;
+            } else {
+                CMN_LOG_CLASS_INIT_ERROR << "Configure: invalid io:arm-execution \""
+                                         << executionString << "\", needs to be PERIODIC or CHAINED_IO" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+
         jsonValue = jsonConfig["io"]["watchdog-timeout"];
         if (!jsonValue.empty()) {
             watchdogTimeout = jsonValue.asDouble();
@@ -673,12 +893,22 @@ void mtsIntuitiveResearchKitConsole::Configure(const std::string & filename)
     } else {
         CMN_LOG_CLASS_INIT_VERBOSE << "Configure: using default io:period, io:port, io:firewire-protocol and io:watchdog-timeout" << std::endl;
     }
+    mtsIntuitiveResearchKitRealTime realTimeIO;
+    if (!ConfigureRealTimeJSON(jsonConfig["io"]["real-time"], m_IO_component_name, periodIO, realTimeIO)) {
+        exit(EXIT_FAILURE);
+    }
     CMN_LOG_CLASS_INIT_VERBOSE << "Configure:" << std::endl
                                << "     - Period IO is " << periodIO << std::endl
                                << "     - Port is " << port << std::endl
                                << "     - Protocol is " << protocol << std::endl
                                << "     - Watchdog timeout is " << watchdogTimeout << std::endl;
 
+    // arms running on other computers
+    if (!ConfigureDistributedJSON(jsonConfig)) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to configure distributed" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
     const Json::Value arms = jsonConfig["arms"];
     for (unsigned int index = 0; index < arms.size(); ++index) {
         if (!ConfigureArmJSON(arms[index], m_IO_component_name, configPath)) {
@@ -686,6 +916,7 @@ void mtsIntuitiveResearchKitConsole::Configure(const std::string & filename)
             exit(EXIT_FAILURE);
         }
     }
+    AddDistributedLinks();
 
     // loop over all arms to check if IO is needed, also check if some IO configuration files are listed in "io"
     mHasIO = false;
@@ -816,9 +1047,27 @@ void mtsIntuitiveResearchKitConsole::Configure(const std::string & filename)
         }
         // and add the io component!
         mtsComponentManager::GetInstance()->AddComponent(io);
+        // real-time settings, the IO thread is not ours so use a hook
+        // called from the IO's ExecOut
+        if (realTimeIO.IsSet()) {
+            const std::string hookName = m_IO_component_name + "-real-time";
+            mtsIntuitiveResearchKitRealTimeHook * hook =
+                new mtsIntuitiveResearchKitRealTimeHook(hookName, m_IO_component_name, realTimeIO);
+            mtsComponentManager::GetInstance()->AddComponent(hook);
+            mConnections.Add(hookName, "ExecIn",
+                             m_IO_component_name, "ExecOut");
+        }
     }
 
-    // now can configure PID and Arms
+    // startup options
+    jsonValue = jsonConfig["startup"];
+    if (!jsonValue.empty()) {
+        m_startup.parallel = jsonValue.get("parallel", m_startup.parallel).asBool();
+        m_startup.threads = jsonValue.get("threads", m_startup.threads).asUInt();
+        m_startup.report = jsonValue.get("report", m_startup.report).asBool();
+    }
+
+    // now can configure PID and Arms, see RunStartupTasks
     for (auto iter = mArms.begin(); iter != end; ++iter) {
         const std::string pidConfig = iter->second->m_PID_configuration_file;
         if (!pidConfig.empty()) {
@@ -827,14 +1076,72 @@ void mtsIntuitiveResearchKitConsole::Configure(const std::string & filename)
         // for generic arms, nothing to do
         if (!iter->second->m_generic) {
             const std::string armConfig = iter->second->m_arm_configuration_file;
+            // chained arms run at the IO rate
+            if (iter->second->m_execution == Arm::EXECUTION_CHAINED_IO) {
+                iter->second->m_arm_period = periodIO;
+            }
             iter->second->ConfigureArm(iter->second->m_type, armConfig,
                                        iter->second->m_arm_period);
         }
     }
+    RunStartupTasks();
+
+    // single thread for all teleops
+    const Json::Value jsonExecutor = jsonConfig["teleop-executor"];
+    if (!jsonExecutor.isNull()) {
+        m_teleop_executor.enabled = jsonExecutor.get("enabled", true).asBool();
+        m_teleop_executor.period = jsonExecutor.get("period", m_teleop_executor.period).asDouble();
+        m_teleop_executor.cpu = jsonExecutor.get("cpu", m_teleop_executor.cpu).asInt();
+        if (m_teleop_executor.period <= 0.0) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: teleop-executor period must be strictly positive" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (m_teleop_executor.enabled) {
+            mtsTeleOperationExecutor * executor = new mtsTeleOperationExecutor(m_teleop_executor.name,
+                                                                               m_teleop_executor.period);
+            mtsIntuitiveResearchKitRealTime realTime;
+            realTime.SetCPU(m_teleop_executor.cpu);
+            if (!ConfigureRealTimeJSON(jsonExecutor["real-time"], m_teleop_executor.name,
+                                       m_teleop_executor.period, realTime)) {
+                exit(EXIT_FAILURE);
+            }
+            executor->SetRealTime(realTime);
+            mtsManagerLocal::GetInstance()->AddComponent(executor);
+        }
+    }
+
+    // multi-arm UDP streamers
+    const Json::Value jsonStreamers = jsonConfig["streamers"];
+    for (unsigned int index = 0; index < jsonStreamers.size(); ++index) {
+        if (IsLocalSection(jsonStreamers[index])
+            && !ConfigureStreamerJSON(jsonStreamers[index])) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to configure streamers[" << index << "]" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // shared memory for same host clients
+    const Json::Value jsonSharedMemory = jsonConfig["shared-memory"];
+    for (unsigned int index = 0; index < jsonSharedMemory.size(); ++index) {
+        if (IsLocalSection(jsonSharedMemory[index])
+            && !ConfigureSharedMemoryJSON(jsonSharedMemory[index])) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to configure shared-memory[" << index << "]" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // binary recorder
+    const Json::Value jsonRecorder = jsonConfig["recorder"];
+    if (!jsonRecorder.isNull() && IsLocalSection(jsonRecorder)) {
+        if (!ConfigureRecorderJSON(jsonRecorder)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to configure recorder" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
 
     // look for ECM teleop
     const Json::Value ecmTeleop = jsonConfig["ecm-teleop"];
-    if (!ecmTeleop.isNull()) {
+    if (!ecmTeleop.isNull() && IsLocalArm(ecmTeleop.get("mtm-left", "").asString())) {
         if (!ConfigureECMTeleopJSON(ecmTeleop)) {
             CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to configure ecm-teleop" << std::endl;
             exit(EXIT_FAILURE);
@@ -850,6 +1157,37 @@ void mtsIntuitiveResearchKitConsole::Configure(const std::string & filename)
         }
     }
 
+    // flight recorder for all arms and tele-operation components,
+    // enabled by default
+    const Json::Value jsonFlightRecorder = jsonConfig["flight-recorder"];
+    if (!jsonFlightRecorder.isNull()) {
+        if (!ConfigureFlightRecorderJSON(jsonFlightRecorder)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to configure flight-recorder" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // proximity monitor between patient side arms
+    const Json::Value jsonProximity = jsonConfig["proximity-monitor"];
+    if (!jsonProximity.isNull() && IsLocalSection(jsonProximity)) {
+        if (!ConfigureProximityMonitorJSON(jsonProximity)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to configure proximity-monitor" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // heartbeats for all tasks, after all components are created
+    const Json::Value jsonHealth = jsonConfig["health-monitor"];
+    if (!jsonHealth.isNull() && IsLocalSection(jsonHealth)) {
+        if (!ConfigureHealthMonitorJSON(jsonHealth)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: failed to configure health-monitor" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // GUI settings, parsed by mtsIntuitiveResearchKitConsoleQt if used
+    m_gui_configuration = jsonConfig["gui"];
+
     // see which event is used for operator present
     // find name of button event used to detect if operator is present
 
@@ -989,6 +1327,9 @@ void mtsIntuitiveResearchKitConsole::Configure(const std::string & filename)
         }
     }
 
+    // warn if high rate threads share a CPU
+    mtsIntuitiveResearchKitRealTime::CheckConflicts(m_real_time_tasks);
+
     mConfigured = true;
 }
 
@@ -1006,8 +1347,8 @@ void mtsIntuitiveResearchKitConsole::Startup(void)
     message.append(CISST_VERSION);
     mInterface->SendStatus(message);
 
-    // emit events for active PSM teleop pairs
-    EventSelectedTeleopPSMs();
+    // emit events for all PSM teleop pairs
+    EventSelectedTeleopPSMs(true);
     // emit scale event
     ConfigurationEvents.scale(mtsIntuitiveResearchKit::TeleOperationPSM::Scale);
     // emit volume event
@@ -1057,11 +1398,13 @@ void mtsIntuitiveResearchKitConsole::Run(void)
 {
     ProcessQueuedCommands();
     ProcessQueuedEvents();
+    PowerSequenceCheckTimeouts();
 }
 
 void mtsIntuitiveResearchKitConsole::Cleanup(void)
 {
     CMN_LOG_CLASS_INIT_VERBOSE << "Cleanup" << std::endl;
+    PowerSequenceWatchdogStop();
 }
 
 bool mtsIntuitiveResearchKitConsole::AddArm(Arm * newArm)
@@ -1144,6 +1487,7 @@ bool mtsIntuitiveResearchKitConsole::AddTeleopPSMInterfaces(TeleopPSM * teleop)
     if (teleop->InterfaceRequired) {
         teleop->InterfaceRequired->AddFunction("state_command", teleop->state_command);
         teleop->InterfaceRequired->AddFunction("set_scale", teleop->set_scale);
+        teleop->InterfaceRequired->AddEventHandlerWrite(&TeleopPSM::DesiredStateEventHandler, teleop, "desired_state");
         teleop->InterfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::ErrorEventHandler, this, "error");
         teleop->InterfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::WarningEventHandler, this, "warning");
         teleop->InterfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::StatusEventHandler, this, "status");
@@ -1200,6 +1544,141 @@ void mtsIntuitiveResearchKitConsole::AddFootpedalInterfaces(void)
     if (operatorProvided) {
         operatorProvided->AddEventWrite(console_events.operator_present, "Button", prmEventButton());
     }
+
+    // teleops also receive the inputs directly from sources so they
+    // don't have to wait for the console to process and forward the
+    // events.  Console still manages the teleops' states.
+    if (!m_direct_inputs) {
+        return;
+    }
+    iter = mDInputSources.find("Clutch");
+    if (iter != endDInputs) {
+        for (auto & teleop : mTeleopsPSM) {
+            mConnections.Add(teleop.first, "ClutchDirect",
+                             iter->second.first, iter->second.second);
+        }
+        if (mTeleopECM) {
+            mConnections.Add(mTeleopECM->Name(), "ClutchDirect",
+                             iter->second.first, iter->second.second);
+        }
+    }
+    iter = mDInputSources.find("OperatorPresent");
+    if (iter != endDInputs) {
+        for (auto & teleop : mTeleopsPSM) {
+            mConnections.Add(teleop.first, "OperatorPresentDirect",
+                             iter->second.first, iter->second.second);
+        }
+    }
+    iter = mDInputSources.find("Camera");
+    if (iter != endDInputs) {
+        for (auto & teleop : mTeleopsPSM) {
+            mConnections.Add(teleop.first, "CameraDirect",
+                             iter->second.first, iter->second.second);
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitConsole::AddStartupTask(const std::string & arm,
+                                                    const std::string & stage,
+                                                    const std::function<bool(void)> & configure,
+                                                    const std::function<void(void)> & finish)
+{
+    StartupTask task;
+    task.arm = arm;
+    task.stage = stage;
+    task.configure = configure;
+    task.finish = finish;
+    m_startup.tasks.push_back(task);
+}
+
+void mtsIntuitiveResearchKitConsole::RunStartupTasks(void)
+{
+    std::vector<StartupTask> & tasks = m_startup.tasks;
+    if (tasks.empty()) {
+        return;
+    }
+    const double start = osaGetTime();
+
+    // configure steps only touch their own component, run on a pool
+    // of threads taking tasks in order.  Errors are reported to this
+    // thread, workers never exit.
+    const auto configure = [](StartupTask & task) {
+        if (!task.configure) {
+            return;
+        }
+        const double taskStart = osaGetTime();
+        try {
+            task.succeeded = task.configure();
+        } catch (std::exception & e) {
+            task.error = e.what();
+            task.succeeded = false;
+        } catch (...) {
+            task.error = "unknown exception";
+            task.succeeded = false;
+        }
+        task.configure_time = osaGetTime() - taskStart;
+    };
+    size_t nbThreads = m_startup.threads;
+    if (nbThreads == 0) {
+        nbThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    nbThreads = std::min(nbThreads, tasks.size());
+    if (!m_startup.parallel || (nbThreads < 2)) {
+        for (auto & task : tasks) {
+            configure(task);
+        }
+    } else {
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for (size_t thread = 0; thread < nbThreads; ++thread) {
+            threads.push_back(std::thread([&] {
+                        size_t index;
+                        while ((index = next++) < tasks.size()) {
+                            configure(tasks[index]);
+                        }
+                    }));
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+    }
+    const double configureTime = osaGetTime() - start;
+
+    // same behavior as sequential configuration, exit on first error
+    for (const auto & task : tasks) {
+        if (!task.succeeded) {
+            CMN_LOG_CLASS_INIT_ERROR << "RunStartupTasks: failed to configure " << task.arm
+                                     << " " << task.stage
+                                     << (task.error.empty() ? "" : ", ") << task.error
+                                     << ", see previous messages" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // adding components and connecting is sequential, in the order
+    // tasks were added
+    for (auto & task : tasks) {
+        const double taskStart = osaGetTime();
+        task.finish();
+        task.finish_time = osaGetTime() - taskStart;
+    }
+    const double totalTime = osaGetTime() - start;
+
+    // timing report
+    std::stringstream report;
+    report << "startup: " << tasks.size() << " task(s) using "
+           << (m_startup.parallel ? nbThreads : 1) << " thread(s), configure "
+           << 1000.0 * configureTime << "ms, total " << 1000.0 * totalTime << "ms" << std::endl;
+    for (const auto & task : tasks) {
+        report << " - " << task.arm << " " << task.stage
+               << ": configure " << 1000.0 * task.configure_time
+               << "ms, finish " << 1000.0 * task.finish_time << "ms" << std::endl;
+    }
+    if (m_startup.report) {
+        std::cout << "mtsIntuitiveResearchKitConsole::" << report.str();
+    }
+    CMN_LOG_CLASS_INIT_VERBOSE << "RunStartupTasks: " << report.str();
+    tasks.clear();
 }
 
 bool mtsIntuitiveResearchKitConsole::ConfigureArmJSON(const Json::Value & jsonArm,
@@ -1207,6 +1686,20 @@ bool mtsIntuitiveResearchKitConsole::ConfigureArmJSON(const Json::Value & jsonAr
                                                       const cmnPath & configPath)
 {
     const std::string armName = jsonArm["name"].asString();
+
+    // distributed, skip arms on other hosts unless a local teleop uses them
+    const auto peer = m_distributed.psm_peers.find(armName);
+    const bool remotePSM = !IsLocalArm(armName)
+        && (peer != m_distributed.psm_peers.end())
+        && (peer->second == m_distributed.host);
+    const bool servedPSM = IsLocalArm(armName)
+        && (peer != m_distributed.psm_peers.end());
+    if (!IsLocalArm(armName) && !remotePSM) {
+        CMN_LOG_CLASS_INIT_VERBOSE << "ConfigureArmJSON: arm " << armName << " runs on host \""
+                                   << m_distributed.arm_hosts.at(armName) << "\", skipped" << std::endl;
+        return true;
+    }
+
     const auto armIterator = mArms.find(armName);
     Arm * armPointer = 0;
     if (armIterator == mArms.end()) {
@@ -1279,6 +1772,19 @@ bool mtsIntuitiveResearchKitConsole::ConfigureArmJSON(const Json::Value & jsonAr
         return false;
     }
 
+    // PSM on another host used by a local teleop, replaced by a socket client
+    if (remotePSM) {
+        if (!((armPointer->m_type == Arm::ARM_PSM)
+              || (armPointer->m_type == Arm::ARM_PSM_DERIVED)
+              || (armPointer->m_type == Arm::ARM_PSM_SOCKET))) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureArmJSON: arm " << armName
+                                     << ": only PSMs can be used by a tele-operation on a different host" << std::endl;
+            return false;
+        }
+        armPointer->m_type = Arm::ARM_PSM_SOCKET;
+        armPointer->m_native_or_derived = false;
+    }
+
     jsonValue = jsonArm["serial"];
     if (!jsonValue.empty()) {
         armPointer->m_serial = jsonValue.asString();
@@ -1313,6 +1819,12 @@ bool mtsIntuitiveResearchKitConsole::ConfigureArmJSON(const Json::Value & jsonAr
         armPointer->m_skip_ROS_bridge = jsonValue.asBool();
     }
 
+    // power group, arms sharing a power supply
+    jsonValue = jsonArm["power-group"];
+    if (!jsonValue.empty()) {
+        armPointer->m_power_group = jsonValue.asString();
+    }
+
     // component and interface, defaults
     armPointer->m_arm_component_name = armName;
     armPointer->m_arm_interface_name = "Arm";
@@ -1331,13 +1843,30 @@ bool mtsIntuitiveResearchKitConsole::ConfigureArmJSON(const Json::Value & jsonAr
     if (!jsonValue.empty()) {
         armPointer->m_socket_server = jsonValue.asBool();
     }
+    if (servedPSM) {
+        armPointer->m_socket_server = true;
+    }
 
     // for socket client or server, look for remote IP / port
     if (armPointer->m_type == Arm::ARM_PSM_SOCKET || armPointer->m_socket_server) {
         armPointer->m_socket_component_name = armPointer->m_name + "-SocketServer";
+        // arms sharing a bridge use a single component and connection,
+        // on the client side each arm is an interface of the bridge
+        armPointer->m_socket_bridge = jsonArm.get("socket-bridge", "").asString();
+        if (armPointer->m_socket_bridge != "") {
+            armPointer->m_socket_component_name = armPointer->m_socket_bridge;
+            if (armPointer->m_type == Arm::ARM_PSM_SOCKET) {
+                armPointer->m_arm_component_name = armPointer->m_socket_bridge;
+                armPointer->m_arm_interface_name = armPointer->m_name;
+            }
+        }
         jsonValue = jsonArm["remote-ip"];
         if(!jsonValue.empty()){
             armPointer->m_IP = jsonValue.asString();
+        } else if (remotePSM) {
+            armPointer->m_IP = m_distributed.hosts.at(m_distributed.arm_hosts.at(armName));
+        } else if (servedPSM) {
+            armPointer->m_IP = m_distributed.hosts.at(peer->second);
         } else {
             CMN_LOG_CLASS_INIT_ERROR << "ConfigureArmJSON: can't find \"server-ip\" for arm \""
                                      << armName << "\"" << std::endl;
@@ -1351,6 +1880,66 @@ bool mtsIntuitiveResearchKitConsole::ConfigureArmJSON(const Json::Value & jsonAr
                                      << armName << "\"" << std::endl;
             return false;
         }
+        jsonValue = jsonArm["socket-format"];
+        if (!jsonValue.empty()) {
+            const std::string format = jsonValue.asString();
+            if (format == "POD") {
+                armPointer->m_socket_pod = true;
+            } else if (format == "COMPACT") {
+                armPointer->m_socket_pod = true;
+                armPointer->m_socket_compact = true;
+            } else if (format == "CISST") {
+                armPointer->m_socket_pod = false;
+            } else {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureArmJSON: invalid \"socket-format\" \"" << format
+                                         << "\" for arm \"" << armName << "\", must be POD, COMPACT or CISST" << std::endl;
+                return false;
+            }
+        }
+        jsonValue = jsonArm["socket-compact"];
+        if (!jsonValue.empty()) {
+            armPointer->m_socket_compact_translation =
+                jsonValue.get("translation-resolution", armPointer->m_socket_compact_translation).asDouble();
+            armPointer->m_socket_compact_rotation =
+                jsonValue.get("rotation-resolution", armPointer->m_socket_compact_rotation).asDouble();
+            armPointer->m_socket_compact_keyframe =
+                jsonValue.get("keyframe-period", armPointer->m_socket_compact_keyframe).asUInt();
+            if ((armPointer->m_socket_compact_translation <= 0.0)
+                || (armPointer->m_socket_compact_rotation <= 0.0)) {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureArmJSON: \"socket-compact\" resolutions for arm \""
+                                         << armName << "\" must be strictly positive" << std::endl;
+                return false;
+            }
+        }
+        jsonValue = jsonArm["socket-receive"];
+        if (!jsonValue.empty()) {
+            const std::string mode = jsonValue.asString();
+            if (mode == "THREAD") {
+                armPointer->m_socket_receive_thread = true;
+            } else if (mode == "BLOCKING") {
+                armPointer->m_socket_receive_thread = false;
+            } else {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureArmJSON: invalid \"socket-receive\" \"" << mode
+                                         << "\" for arm \"" << armName << "\", must be THREAD or BLOCKING" << std::endl;
+                return false;
+            }
+        }
+        armPointer->m_socket_playout_delay = jsonArm.get("socket-playout-delay", 0.0).asDouble();
+        if (armPointer->m_socket_playout_delay < 0.0) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureArmJSON: \"socket-playout-delay\" for arm \""
+                                     << armName << "\" must be positive" << std::endl;
+            return false;
+        }
+        jsonValue = jsonArm["socket-redundancy"];
+        if (!jsonValue.empty()) {
+            const int redundancy = jsonValue.asInt();
+            if ((redundancy < 0) || (redundancy > POD_MAX_REDUNDANCY)) {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureArmJSON: \"socket-redundancy\" for arm \""
+                                         << armName << "\" must be between 0 and " << POD_MAX_REDUNDANCY << std::endl;
+                return false;
+            }
+            armPointer->m_socket_redundancy = redundancy;
+        }
     }
 
     // IO for anything not simulated or socket client
@@ -1524,6 +2113,44 @@ bool mtsIntuitiveResearchKitConsole::ConfigureArmJSON(const Json::Value & jsonAr
         armPointer->m_arm_period = jsonValue.asFloat();
     }
 
+    // execution mode, chained runs in IO thread
+    const bool canChain = (((armPointer->m_type == Arm::ARM_MTM)
+                            || (armPointer->m_type == Arm::ARM_PSM)
+                            || (armPointer->m_type == Arm::ARM_ECM)
+                            || (armPointer->m_type == Arm::ARM_SUJ))
+                           && (armPointer->m_simulation == Arm::SIMULATION_NONE));
+    jsonValue = jsonArm["execution"];
+    if (!jsonValue.empty()) {
+        const std::string executionString = jsonValue.asString();
+        if (executionString == "PERIODIC") {
+            armPointer->m_execution = Arm::EXECUTION_PERIODIC;
+        } else if (executionString == "CHAINED_IO") {
+            if (!canChain) {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureArmJSON: arm " << armName
+                                         << ": \"execution\" CHAINED_IO is only supported for non simulated MTM, PSM, ECM and SUJ" << std::endl;
+                return false;
+            }
+            armPointer->m_execution = Arm::EXECUTION_CHAINED_IO;
+        } else {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureArmJSON: arm " << armName << ": invalid execution \""
+                                     << executionString << "\", needs to be PERIODIC or CHAINED_IO" << std::endl;
+            return false;
+        }
+    } else if (canChain) {
+        // io default only applies to arms that can be chained
+        armPointer->m_execution = m_arm_execution;
+    }
+
+    // real-time settings for the arm thread
+    jsonValue = jsonArm["real-time"];
+    if (!jsonValue.empty() && (armPointer->m_execution == Arm::EXECUTION_CHAINED_IO)) {
+        CMN_LOG_CLASS_INIT_WARNING << "ConfigureArmJSON: arm " << armName
+                                   << ": \"real-time\" is ignored since the arm runs in the IO thread" << std::endl;
+    } else if (!ConfigureRealTimeJSON(jsonValue, armName,
+                                      armPointer->m_arm_period, armPointer->m_real_time)) {
+        return false;
+    }
+
     // add the arm if it's a new one
     if (armIterator == mArms.end()) {
         AddArm(armPointer);
@@ -1531,6 +2158,518 @@ bool mtsIntuitiveResearchKitConsole::ConfigureArmJSON(const Json::Value & jsonAr
     return true;
 }
 
+bool mtsIntuitiveResearchKitConsole::ConfigureRealTimeJSON(const Json::Value & jsonRealTime,
+                                                           const std::string & name,
+                                                           const double & period,
+                                                           mtsIntuitiveResearchKitRealTime & realTime)
+{
+    if (!jsonRealTime.empty()) {
+        std::string errorMessage;
+        if (!realTime.Configure(jsonRealTime, errorMessage)) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureRealTimeJSON: \"real-time\" for \""
+                                     << name << "\", " << errorMessage << std::endl;
+            return false;
+        }
+    }
+    if (realTime.IsSet()) {
+        m_real_time_tasks.push_back({name, period, realTime});
+    }
+    return true;
+}
+
+bool mtsIntuitiveResearchKitConsole::ConfigureStreamerJSON(const Json::Value & jsonStreamer)
+{
+    const std::string name = jsonStreamer["name"].asString();
+    if (name == "") {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureStreamerJSON: \"name\" is required" << std::endl;
+        return false;
+    }
+    const double period = jsonStreamer.get("period", mtsIntuitiveResearchKit::ArmPeriod).asDouble();
+    if (period <= 0.0) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureStreamerJSON: period must be strictly positive for \""
+                                 << name << "\"" << std::endl;
+        return false;
+    }
+
+    // use the console arms to set the default jaw command
+    Json::Value jsonConfig = jsonStreamer;
+    Json::Value & jsonArms = jsonConfig["arms"];
+    for (unsigned int index = 0; index < jsonArms.size(); ++index) {
+        const std::string armName = jsonArms[index]["name"].asString();
+        const auto armIterator = mArms.find(armName);
+        if (armIterator == mArms.end()) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureStreamerJSON: arm \"" << armName
+                                     << "\" used by \"" << name << "\" is not defined" << std::endl;
+            return false;
+        }
+        if (jsonArms[index]["jaw-command"].empty()) {
+            switch (armIterator->second->m_type) {
+            case Arm::ARM_MTM:
+            case Arm::ARM_MTM_GENERIC:
+            case Arm::ARM_MTM_DERIVED:
+                jsonArms[index]["jaw-command"] = "gripper/measured_js";
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    mtsIntuitiveResearchKitUDPStreamer * streamer = new mtsIntuitiveResearchKitUDPStreamer(name, period);
+    if (!streamer->Configure(jsonConfig)) {
+        delete streamer;
+        return false;
+    }
+    mtsManagerLocal::GetInstance()->AddComponent(streamer);
+    for (auto & armName : streamer->ArmInterfaceNames()) {
+        const Arm * arm = mArms[armName];
+        mConnections.Add(name, armName,
+                         arm->ComponentName(), arm->InterfaceName());
+    }
+    return true;
+}
+
+bool mtsIntuitiveResearchKitConsole::ConfigureSharedMemoryJSON(const Json::Value & jsonSharedMemory)
+{
+    const std::string name = jsonSharedMemory["name"].asString();
+    if (name == "") {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureSharedMemoryJSON: \"name\" is required" << std::endl;
+        return false;
+    }
+    const double period = jsonSharedMemory.get("period", mtsIntuitiveResearchKit::ArmPeriod).asDouble();
+    if (period <= 0.0) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureSharedMemoryJSON: period must be strictly positive for \""
+                                 << name << "\"" << std::endl;
+        return false;
+    }
+    const Json::Value jsonArms = jsonSharedMemory["arms"];
+    for (unsigned int index = 0; index < jsonArms.size(); ++index) {
+        const std::string armName = jsonArms[index].asString();
+        if (mArms.find(armName) == mArms.end()) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureSharedMemoryJSON: arm \"" << armName
+                                     << "\" used by \"" << name << "\" is not defined" << std::endl;
+            return false;
+        }
+    }
+
+    mtsIntuitiveResearchKitSharedMemory * sharedMemory = new mtsIntuitiveResearchKitSharedMemory(name, period);
+    if (!sharedMemory->Configure(jsonSharedMemory)) {
+        delete sharedMemory;
+        return false;
+    }
+    mtsManagerLocal::GetInstance()->AddComponent(sharedMemory);
+    for (auto & armName : sharedMemory->ArmInterfaceNames()) {
+        const Arm * arm = mArms[armName];
+        mConnections.Add(name, armName,
+                         arm->ComponentName(), arm->InterfaceName());
+    }
+    return true;
+}
+
+bool mtsIntuitiveResearchKitConsole::ConfigureRecorderJSON(const Json::Value & jsonRecorder)
+{
+    const std::string name = jsonRecorder.get("name", "recorder").asString();
+    const double period = jsonRecorder.get("period", 0.05).asDouble();
+    if (period <= 0.0) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureRecorderJSON: period must be strictly positive" << std::endl;
+        return false;
+    }
+    const Json::Value jsonArms = jsonRecorder["arms"];
+    if (jsonArms.empty()) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureRecorderJSON: \"arms\" must be provided" << std::endl;
+        return false;
+    }
+
+    mtsIntuitiveResearchKitRecorder * recorder = new mtsIntuitiveResearchKitRecorder(name, period);
+    const std::string fileName = jsonRecorder["file"].asString();
+    if (fileName != "") {
+        recorder->SetFileName(fileName);
+    }
+
+    for (unsigned int index = 0; index < jsonArms.size(); ++index) {
+        const std::string armName = jsonArms[index]["name"].asString();
+        const auto armIterator = mArms.find(armName);
+        if (armIterator == mArms.end()) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureRecorderJSON: arm \"" << armName
+                                     << "\" is not defined" << std::endl;
+            delete recorder;
+            return false;
+        }
+        // only research kit arms running in this process can be recorded
+        mtsIntuitiveResearchKitArm * arm =
+            dynamic_cast<mtsIntuitiveResearchKitArm *>(mtsManagerLocal::GetInstance()->GetComponent(armIterator->second->ComponentName()));
+        if (!arm) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureRecorderJSON: arm \"" << armName
+                                     << "\" is not a research kit arm component in this process" << std::endl;
+            delete recorder;
+            return false;
+        }
+        unsigned int fields = 0;
+        const Json::Value jsonFields = jsonArms[index]["fields"];
+        if (jsonFields.empty()) {
+            fields = mtsIntuitiveResearchKitRecorderChannel::FIELD_MEASURED_JS
+                | mtsIntuitiveResearchKitRecorderChannel::FIELD_SETPOINT_JS;
+        }
+        for (unsigned int fieldIndex = 0; fieldIndex < jsonFields.size(); ++fieldIndex) {
+            const std::string field = jsonFields[fieldIndex].asString();
+            if (field == "measured_js") {
+                fields |= mtsIntuitiveResearchKitRecorderChannel::FIELD_MEASURED_JS;
+            } else if (field == "setpoint_js") {
+                fields |= mtsIntuitiveResearchKitRecorderChannel::FIELD_SETPOINT_JS;
+            } else if (field == "measured_cp") {
+                fields |= mtsIntuitiveResearchKitRecorderChannel::FIELD_MEASURED_CP;
+            } else if (field == "body/measured_cf") {
+                fields |= mtsIntuitiveResearchKitRecorderChannel::FIELD_BODY_MEASURED_CF;
+            } else {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureRecorderJSON: invalid field \"" << field
+                                         << "\" for arm \"" << armName
+                                         << "\", valid values are measured_js, setpoint_js, measured_cp and body/measured_cf"
+                                         << std::endl;
+                delete recorder;
+                return false;
+            }
+        }
+        arm->SetRecorderChannel(recorder->AddChannel(armName, fields,
+                                                     arm->NumberOfJointsKinematics()));
+    }
+    mtsManagerLocal::GetInstance()->AddComponent(recorder);
+    return true;
+}
+
+bool mtsIntuitiveResearchKitConsole::ConfigureFlightRecorderJSON(const Json::Value & jsonFlightRecorder)
+{
+    const double duration = jsonFlightRecorder.get("duration", 5.0).asDouble();
+    if (duration < 0.0) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureFlightRecorderJSON: duration must be positive" << std::endl;
+        return false;
+    }
+    const std::string directory = jsonFlightRecorder.get("directory", "").asString();
+
+    mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
+    for (auto & arm : mArms) {
+        mtsIntuitiveResearchKitArm * component =
+            dynamic_cast<mtsIntuitiveResearchKitArm *>(componentManager->GetComponent(arm.second->ComponentName()));
+        if (component) {
+            component->SetFlightRecorder(duration, directory);
+        }
+    }
+    for (auto & teleop : mTeleopsPSM) {
+        mtsTeleOperationPSM * component =
+            dynamic_cast<mtsTeleOperationPSM *>(componentManager->GetComponent(teleop.second->Name()));
+        if (component) {
+            component->SetFlightRecorder(duration, directory);
+        }
+    }
+    if (mTeleopECM) {
+        mtsTeleOperationECM * component =
+            dynamic_cast<mtsTeleOperationECM *>(componentManager->GetComponent(mTeleopECM->Name()));
+        if (component) {
+            component->SetFlightRecorder(duration, directory);
+        }
+    }
+    return true;
+}
+
+bool mtsIntuitiveResearchKitConsole::ConfigureProximityMonitorJSON(const Json::Value & jsonProximity)
+{
+    const std::string name = jsonProximity.get("name", "proximity-monitor").asString();
+    const double period = jsonProximity.get("period", 5.0 * cmn_ms).asDouble();
+    if (period <= 0.0) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureProximityMonitorJSON: period must be strictly positive" << std::endl;
+        return false;
+    }
+    const Json::Value jsonArms = jsonProximity["arms"];
+    for (unsigned int index = 0; index < jsonArms.size(); ++index) {
+        const std::string armName = jsonArms[index].asString();
+        if (mArms.find(armName) == mArms.end()) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureProximityMonitorJSON: arm \"" << armName
+                                     << "\" is not defined" << std::endl;
+            return false;
+        }
+    }
+
+    mtsIntuitiveResearchKitProximityMonitor * monitor = new mtsIntuitiveResearchKitProximityMonitor(name, period);
+    if (!monitor->Configure(jsonProximity)) {
+        delete monitor;
+        return false;
+    }
+    mtsManagerLocal::GetInstance()->AddComponent(monitor);
+    for (auto & armName : monitor->ArmInterfaceNames()) {
+        const Arm * arm = mArms[armName];
+        mConnections.Add(name, armName,
+                         arm->ComponentName(), arm->InterfaceName());
+    }
+
+    mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired(name);
+    if (!interfaceRequired) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureProximityMonitorJSON: failed to add interface for \""
+                                 << name << "\"" << std::endl;
+        return false;
+    }
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::ProximityStopEventHandler, this, "proximity_stop");
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::ErrorEventHandler, this, "error");
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::WarningEventHandler, this, "warning");
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::StatusEventHandler, this, "status");
+    mConnections.Add(this->GetName(), name,
+                     name, "ProximityMonitor");
+    return true;
+}
+
+bool mtsIntuitiveResearchKitConsole::ConfigureHealthMonitorJSON(const Json::Value & jsonHealth)
+{
+    const std::string name = jsonHealth.get("name", "health-monitor").asString();
+    const double period = jsonHealth.get("period", 10.0 * cmn_ms).asDouble();
+    if (period <= 0.0) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureHealthMonitorJSON: period must be strictly positive" << std::endl;
+        return false;
+    }
+    const std::string segment = jsonHealth.get("segment", "/dvrk-health").asString();
+    if ((segment.size() < 2) || (segment[0] != '/')) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureHealthMonitorJSON: \"segment\" must start with \"/\", found \""
+                                 << segment << "\"" << std::endl;
+        return false;
+    }
+
+    mtsIntuitiveResearchKitHealthMonitor * monitor = new mtsIntuitiveResearchKitHealthMonitor(name, period);
+    if (!monitor->Configure(jsonHealth)) {
+        delete monitor;
+        return false;
+    }
+    // tasks register on their first Run so the table has to be ready now
+    if (!mtsIntuitiveResearchKitHealthTable::Instance().Open(segment)) {
+        CMN_LOG_CLASS_INIT_WARNING << "ConfigureHealthMonitorJSON: failed to create shared memory \""
+                                   << segment << "\" (already exists or not permitted), health table is only available in this process" << std::endl;
+    }
+    mtsComponentManager * componentManager = mtsComponentManager::GetInstance();
+    componentManager->AddComponent(monitor);
+
+    // IO thread is not ours, use a hook called from the IO's ExecOut
+    mtsTaskPeriodic * io = dynamic_cast<mtsTaskPeriodic *>(componentManager->GetComponent(m_IO_component_name));
+    if (io) {
+        const std::string hookName = m_IO_component_name + "-heartbeat";
+        mtsIntuitiveResearchKitHeartbeatHook * hook =
+            new mtsIntuitiveResearchKitHeartbeatHook(hookName, m_IO_component_name, io->GetPeriodicity());
+        componentManager->AddComponent(hook);
+        mConnections.Add(hookName, "ExecIn",
+                         m_IO_component_name, "ExecOut");
+    }
+
+    mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired(name);
+    if (!interfaceRequired) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureHealthMonitorJSON: failed to add interface for \""
+                                 << name << "\"" << std::endl;
+        return false;
+    }
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::ErrorEventHandler, this, "error");
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::WarningEventHandler, this, "warning");
+    interfaceRequired->AddEventHandlerWrite(&mtsIntuitiveResearchKitConsole::StatusEventHandler, this, "status");
+    mConnections.Add(this->GetName(), name,
+                     name, "HealthMonitor");
+    return true;
+}
+
+void mtsIntuitiveResearchKitConsole::ProximityStopEventHandler(const prmKeyValue & arms)
+{
+    // disable tele-operation for selected teleops using either arm,
+    // UpdateTeleopState will re-enable them when the operator re-engages
+    bool stopped = false;
+    for (const auto & armName : {arms.Key, arms.Value}) {
+        const auto psm = m_teleop_psm_pairs.psm_indices.find(armName);
+        if (psm == m_teleop_psm_pairs.psm_indices.end()) {
+            continue;
+        }
+        const int selected = m_teleop_psm_pairs.selected_by_psm[psm->second];
+        if (selected < 0) {
+            continue;
+        }
+        TeleopPSM * teleop = m_teleop_psm_pairs.teleops[selected];
+        if (teleop->m_last_state_command != TeleopPSM::COMMAND_DISABLE) {
+            TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_DISABLE);
+            stopped = true;
+        }
+    }
+    if (stopped) {
+        // other teleops might still be running, the flag is needed to
+        // disable them (e.g. camera pedal), see UpdateTeleopState
+        bool running = false;
+        for (auto teleop : m_teleop_psm_pairs.teleops) {
+            if (teleop->Selected()
+                && (teleop->m_last_state_command != TeleopPSM::COMMAND_DISABLE)) {
+                running = true;
+            }
+        }
+        if (!running) {
+            mTeleopPSMRunning = false;
+        }
+        mInterface->SendWarning(this->GetName() + ": tele-operation stopped, "
+                                + arms.Key + " and " + arms.Value + " are too close");
+    }
+}
+
+bool mtsIntuitiveResearchKitConsole::ConfigureDistributedJSON(const Json::Value & jsonConfig)
+{
+    const Json::Value jsonDistributed = jsonConfig["distributed"];
+    if (jsonDistributed.isNull()) {
+        if (!m_distributed.host.empty()) {
+            CMN_LOG_CLASS_INIT_WARNING << "ConfigureDistributedJSON: host \"" << m_distributed.host
+                                       << "\" ignored since configuration doesn't have \"distributed\"" << std::endl;
+            m_distributed.host.clear();
+        }
+        return true;
+    }
+
+    // IP address of each host
+    const Json::Value jsonHosts = jsonDistributed["hosts"];
+    if (!jsonHosts.isObject() || jsonHosts.empty()) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureDistributedJSON: "hosts" must be an object with the IP address of each host" << std::endl;
+        return false;
+    }
+    for (const auto & hostName : jsonHosts.getMemberNames()) {
+        m_distributed.hosts[hostName] = jsonHosts[hostName].asString();
+    }
+
+    // host name provided before configuration takes precedence
+    if (m_distributed.host.empty()) {
+        m_distributed.host = jsonDistributed.get("host", "").asString();
+    }
+    if (m_distributed.hosts.find(m_distributed.host) == m_distributed.hosts.end()) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureDistributedJSON: host \"" << m_distributed.host
+                                 << "\" for this console is not defined in \"hosts\"" << std::endl;
+        return false;
+    }
+
+    // all arms must have a host
+    const Json::Value jsonArms = jsonConfig["arms"];
+    for (unsigned int index = 0; index < jsonArms.size(); ++index) {
+        const std::string armName = jsonArms[index]["name"].asString();
+        const std::string armHost = jsonArms[index].get("host", "").asString();
+        if (m_distributed.hosts.find(armHost) == m_distributed.hosts.end()) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureDistributedJSON: arm \"" << armName
+                                     << "\" must have a \"host\" defined in \"hosts\"" << std::endl;
+            return false;
+        }
+        m_distributed.arm_hosts[armName] = armHost;
+    }
+
+    // PSM teleops with arms on different hosts, only one MTM host per PSM
+    const Json::Value jsonTeleops = jsonConfig["psm-teleops"];
+    for (unsigned int index = 0; index < jsonTeleops.size(); ++index) {
+        const std::string mtmName = jsonTeleops[index].get("mtm", jsonTeleops[index]["master"]).asString();
+        const std::string psmName = jsonTeleops[index].get("psm", jsonTeleops[index]["slave"]).asString();
+        const auto mtmHost = m_distributed.arm_hosts.find(mtmName);
+        const auto psmHost = m_distributed.arm_hosts.find(psmName);
+        if ((mtmHost == m_distributed.arm_hosts.end())
+            || (psmHost == m_distributed.arm_hosts.end())
+            || (mtmHost->second == psmHost->second)) {
+            continue;
+        }
+        const auto peer = m_distributed.psm_peers.find(psmName);
+        if ((peer != m_distributed.psm_peers.end())
+            && (peer->second != mtmHost->second)) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureDistributedJSON: psm \"" << psmName
+                                     << "\" is used by tele-operations on hosts \"" << peer->second
+                                     << "\" and \"" << mtmHost->second << "\", only one remote host is supported" << std::endl;
+            return false;
+        }
+        m_distributed.psm_peers[psmName] = mtmHost->second;
+    }
+
+    // ECM teleop can't span hosts
+    const Json::Value jsonECMTeleop = jsonConfig["ecm-teleop"];
+    if (!jsonECMTeleop.isNull()) {
+        const std::string hostLeft = m_distributed.arm_hosts[jsonECMTeleop.get("mtm-left", "").asString()];
+        const std::string hostRight = m_distributed.arm_hosts[jsonECMTeleop.get("mtm-right", "").asString()];
+        const std::string hostECM = m_distributed.arm_hosts[jsonECMTeleop.get("ecm", "").asString()];
+        if ((hostLeft != hostRight) || (hostLeft != hostECM)) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureDistributedJSON: "mtm-left", "mtm-right" and "ecm" used by "ecm-teleop" must run on the same host" << std::endl;
+            return false;
+        }
+    }
+
+    CMN_LOG_CLASS_INIT_VERBOSE << "ConfigureDistributedJSON: console running on host \""
+                               << m_distributed.host << "\"" << std::endl;
+    return true;
+}
+
+bool mtsIntuitiveResearchKitConsole::IsLocalArm(const std::string & armName) const
+{
+    if (m_distributed.host.empty()) {
+        return true;
+    }
+    const auto armHost = m_distributed.arm_hosts.find(armName);
+    // unknown arms are reported later
+    if (armHost == m_distributed.arm_hosts.end()) {
+        return true;
+    }
+    return (armHost->second == m_distributed.host);
+}
+
+bool mtsIntuitiveResearchKitConsole::IsLocalSection(const Json::Value & jsonSection) const
+{
+    if (m_distributed.host.empty()) {
+        return true;
+    }
+    const std::string sectionHost = jsonSection.get("host", "").asString();
+    return (sectionHost.empty() || (sectionHost == m_distributed.host));
+}
+
+void mtsIntuitiveResearchKitConsole::AddDistributedLinks(void)
+{
+    for (const auto & iter : mArms) {
+        const Arm * arm = iter.second;
+        std::string component;
+        if (arm->m_type == Arm::ARM_PSM_SOCKET) {
+            component = arm->ComponentName();
+        } else if (arm->m_socket_server) {
+            component = arm->SocketComponentName();
+        } else {
+            continue;
+        }
+        // arms sharing a socket bridge have a single link
+        const auto found = std::find_if(m_distributed.links.begin(), m_distributed.links.end(),
+                                        [&component](const DistributedLink & link) {
+                                            return link.component == component;
+                                        });
+        if (found != m_distributed.links.end()) {
+            continue;
+        }
+        m_distributed.links.emplace_back();
+        DistributedLink & link = m_distributed.links.back();
+        link.component = component;
+        link.remote_host = arm->m_IP;
+        const std::string interfaceName = "Link-" + component;
+        mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired(interfaceName);
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("GetOneWayLatency", link.GetOneWayLatency);
+            mConnections.Add(this->GetName(), interfaceName,
+                             component, "System");
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitConsole::distributed_links(std::vector<std::string> & links) const
+{
+    links.clear();
+    for (const auto & link : m_distributed.links) {
+        links.push_back(link.component + "@" + link.remote_host);
+    }
+}
+
+void mtsIntuitiveResearchKitConsole::distributed_latencies(vctDoubleVec & latencies) const
+{
+    latencies.SetSize(m_distributed.links.size());
+    size_t index = 0;
+    for (const auto & link : m_distributed.links) {
+        double latency;
+        if (link.GetOneWayLatency(latency).IsOK()) {
+            latencies.at(index) = latency;
+        } else {
+            latencies.at(index) = -1.0;
+        }
+        ++index;
+    }
+}
+
 bool mtsIntuitiveResearchKitConsole::ConfigureECMTeleopJSON(const Json::Value & jsonTeleop)
 {
     std::string mtmLeftName = jsonTeleop["mtm-left"].asString();
@@ -1667,6 +2806,21 @@ bool mtsIntuitiveResearchKitConsole::ConfigureECMTeleopJSON(const Json::Value &
         CMN_LOG_CLASS_INIT_ERROR << "ConfigureECMTeleopJSON: teleop " << name << ": \"rotation\" must now be defined under \"configure-parameter\" or in a separate configuration file" << std::endl;
         return false;
     }
+    // run in shared executor thread
+    if (m_teleop_executor.enabled
+        && (mTeleopECM->m_type == TeleopECM::TELEOP_ECM)) {
+        period = 0.0;
+        mTeleopECM->m_chained_period = m_teleop_executor.period;
+        mConnections.Add(name, "ExecIn", m_teleop_executor.name, "ExecOut");
+    }
+    // real-time settings, only if teleop has its own thread
+    jsonValue = jsonTeleop["real-time"];
+    if (!jsonValue.empty() && (period == 0.0)) {
+        CMN_LOG_CLASS_INIT_WARNING << "ConfigureECMTeleopJSON: teleop " << name
+                                   << ": \"real-time\" is ignored since the teleop runs in the teleop-executor thread" << std::endl;
+    } else if (!ConfigureRealTimeJSON(jsonValue, name, period, mTeleopECM->m_real_time)) {
+        return false;
+    }
     const Json::Value jsonTeleopConfig = jsonTeleop["configure-parameter"];
     mTeleopECM->ConfigureTeleop(mTeleopECM->m_type, period, jsonTeleopConfig);
     AddTeleopECMInterfaces(mTeleopECM);
@@ -1693,6 +2847,14 @@ bool mtsIntuitiveResearchKitConsole::ConfigurePSMTeleopJSON(const Json::Value &
         return false;
     }
 
+    // distributed, teleops run on the MTM's host
+    if (!IsLocalArm(mtmName)) {
+        CMN_LOG_CLASS_INIT_VERBOSE << "ConfigurePSMTeleopJSON: teleop " << mtmName << "-" << psmName
+                                   << " runs on host \"" << m_distributed.arm_hosts.at(mtmName)
+                                   << "\", skipped" << std::endl;
+        return true;
+    }
+
     std::string mtmComponent, mtmInterface, psmComponent, psmInterface;
     // check that both arms have been defined and have correct type
     Arm * armPointer;
@@ -1763,12 +2925,29 @@ bool mtsIntuitiveResearchKitConsole::ConfigurePSMTeleopJSON(const Json::Value &
                              baseFrameComponent, baseFrameInterface);
         }
 
-        // insert
-        mTeleopsPSMByMTM.insert(std::make_pair(mtmName, teleopPointer));
-        mTeleopsPSMByPSM.insert(std::make_pair(psmName, teleopPointer));
+        // insert in pair tables
+        auto & pairs = m_teleop_psm_pairs;
+        teleopPointer->m_index = pairs.teleops.size();
+        pairs.teleops.push_back(teleopPointer);
+        auto mtmIndex = pairs.mtm_indices.find(mtmName);
+        if (mtmIndex == pairs.mtm_indices.end()) {
+            mtmIndex = pairs.mtm_indices.insert(std::make_pair(mtmName, pairs.mtm_names.size())).first;
+            pairs.mtm_names.push_back(mtmName);
+            pairs.teleops_by_mtm.push_back(std::vector<size_t>());
+            pairs.selected_by_mtm.push_back(-1);
+        }
+        teleopPointer->m_mtm_index = mtmIndex->second;
+        pairs.teleops_by_mtm.at(mtmIndex->second).push_back(teleopPointer->m_index);
+        auto psmIndex = pairs.psm_indices.find(psmName);
+        if (psmIndex == pairs.psm_indices.end()) {
+            psmIndex = pairs.psm_indices.insert(std::make_pair(psmName, pairs.psm_names.size())).first;
+            pairs.psm_names.push_back(psmName);
+            pairs.selected_by_psm.push_back(-1);
+        }
+        teleopPointer->m_psm_index = psmIndex->second;
 
         // first MTM with multiple PSMs is selected for single tap
-        if ((mTeleopsPSMByMTM.count(mtmName) > 1)
+        if ((pairs.teleops_by_mtm.at(mtmIndex->second).size() > 1)
             && (mTeleopMTMToCycle == "")) {
             mTeleopMTMToCycle = mtmName;
         }
@@ -1776,7 +2955,7 @@ bool mtsIntuitiveResearchKitConsole::ConfigurePSMTeleopJSON(const Json::Value &
         std::string mtmUsingThatPSM;
         GetMTMSelectedForPSM(psmName, mtmUsingThatPSM);
         if (mtmUsingThatPSM != "") {
-            teleopPointer->SetSelected(false);
+            SetTeleopPSMSelected(teleopPointer, false);
             CMN_LOG_CLASS_INIT_WARNING << "ConfigurePSMTeleopJSON: psm \""
                                        << psmName << "\" is already selected to be controlled by mtm \""
                                        << mtmUsingThatPSM << "\", component \""
@@ -1787,7 +2966,7 @@ bool mtsIntuitiveResearchKitConsole::ConfigurePSMTeleopJSON(const Json::Value &
             std::string psmUsingThatMTM;
             GetPSMSelectedForMTM(mtmName, psmUsingThatMTM);
             if (psmUsingThatMTM != "") {
-                teleopPointer->SetSelected(false);
+                SetTeleopPSMSelected(teleopPointer, false);
                 CMN_LOG_CLASS_INIT_WARNING << "ConfigurePSMTeleopJSON: mtm \""
                                            << mtmName << "\" is already selected to control psm \""
                                            << psmUsingThatMTM << "\", component \""
@@ -1795,7 +2974,7 @@ bool mtsIntuitiveResearchKitConsole::ConfigurePSMTeleopJSON(const Json::Value &
                                            << std::endl;
             } else {
                 // neither the MTM nor PSM are used, let's activate that pair
-                teleopPointer->SetSelected(true);
+                SetTeleopPSMSelected(teleopPointer, true);
             }
         }
         // finally add the new teleop
@@ -1837,6 +3016,54 @@ bool mtsIntuitiveResearchKitConsole::ConfigurePSMTeleopJSON(const Json::Value &
         CMN_LOG_CLASS_INIT_ERROR << "ConfigurePSMTeleopJSON: teleop " << name << ": \"rotation\" must now be defined under \"configure-parameter\" or in a separate configuration file" << std::endl;
         return false;
     }
+
+    // execution mode, chained runs in arm thread
+    jsonValue = jsonTeleop["execution"];
+    if (!jsonValue.empty()) {
+        std::string executionString = jsonValue.asString();
+        if (executionString == "PERIODIC") {
+            teleopPointer->m_execution = TeleopPSM::EXECUTION_PERIODIC;
+        } else if (executionString == "CHAINED_PSM") {
+            teleopPointer->m_execution = TeleopPSM::EXECUTION_CHAINED_PSM;
+        } else if (executionString == "CHAINED_MTM") {
+            teleopPointer->m_execution = TeleopPSM::EXECUTION_CHAINED_MTM;
+        } else {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigurePSMTeleopJSON: teleop " << name << ": invalid execution \""
+                                     << executionString << "\", needs to be PERIODIC, CHAINED_PSM or CHAINED_MTM" << std::endl;
+            return false;
+        }
+    }
+    if (teleopPointer->m_execution != TeleopPSM::EXECUTION_PERIODIC) {
+        if (teleopPointer->m_type != TeleopPSM::TELEOP_PSM) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigurePSMTeleopJSON: teleop " << name
+                                     << ": \"execution\" other than PERIODIC is only supported for type TELEOP_PSM" << std::endl;
+            return false;
+        }
+        // period 0 means the task waits for ExecIn event
+        period = 0.0;
+        const std::string & armComponent =
+            (teleopPointer->m_execution == TeleopPSM::EXECUTION_CHAINED_PSM) ? psmComponent : mtmComponent;
+        const std::string & armName =
+            (teleopPointer->m_execution == TeleopPSM::EXECUTION_CHAINED_PSM) ? psmName : mtmName;
+        teleopPointer->m_chained_period = mArms[armName]->m_arm_period;
+        mConnections.Add(name, "ExecIn", armComponent, "ExecOut");
+    } else if (m_teleop_executor.enabled
+               && (teleopPointer->m_type == TeleopPSM::TELEOP_PSM)) {
+        // run in shared executor thread
+        period = 0.0;
+        teleopPointer->m_chained_period = m_teleop_executor.period;
+        mConnections.Add(name, "ExecIn", m_teleop_executor.name, "ExecOut");
+    }
+
+    // real-time settings, only if teleop has its own thread
+    jsonValue = jsonTeleop["real-time"];
+    if (!jsonValue.empty() && (period == 0.0)) {
+        CMN_LOG_CLASS_INIT_WARNING << "ConfigurePSMTeleopJSON: teleop " << name
+                                   << ": \"real-time\" is ignored since the teleop runs in the arm or teleop-executor thread" << std::endl;
+    } else if (!ConfigureRealTimeJSON(jsonValue, name, period, teleopPointer->m_real_time)) {
+        return false;
+    }
+
     const Json::Value jsonTeleopConfig = jsonTeleop["configure-parameter"];
     teleopPointer->ConfigureTeleop(teleopPointer->m_type, period, jsonTeleopConfig);
     AddTeleopPSMInterfaces(teleopPointer);
@@ -1961,6 +3188,10 @@ bool mtsIntuitiveResearchKitConsole::Connect(void)
 void mtsIntuitiveResearchKitConsole::power_off(void)
 {
     teleop_enable(false);
+    // cancel sequence in progress
+    m_power_sequence.command.clear();
+    m_power_sequence.pending.clear();
+    PowerSequenceWatchdogStop();
     for (auto & arm : mArms) {
         arm.second->state_command(std::string("disable"));
     }
@@ -1969,17 +3200,233 @@ void mtsIntuitiveResearchKitConsole::power_off(void)
 void mtsIntuitiveResearchKitConsole::power_on(void)
 {
     DisableFaultyArms();
-    for (auto & arm : mArms) {
-        arm.second->state_command(std::string("enable"));
-    }
+    PowerSequenceStart("enable");
 }
 
 void mtsIntuitiveResearchKitConsole::home(void)
 {
     DisableFaultyArms();
-    for (auto & arm : mArms) {
-        arm.second->state_command(std::string("home"));
+    PowerSequenceStart("home");
+}
+
+void mtsIntuitiveResearchKitConsole::PowerSequenceStart(const std::string & command)
+{
+    auto & sequence = m_power_sequence;
+    sequence.command = command;
+    sequence.start_time = mtsManagerLocal::GetInstance()->GetTimeServer().GetRelativeTime();
+    sequence.pending.clear();
+    sequence.powering.clear();
+    sequence.arms.clear();
+
+    for (auto & armIter : mArms) {
+        Arm * arm = armIter.second;
+        PowerSequenceEntry & entry = sequence.arms[arm->Name()];
+        entry.group = arm->m_power_group;
+        // arms already powered don't need to wait for their group
+        const auto armState = ArmStates.find(arm->Name());
+        const bool powered = (armState != ArmStates.end())
+            && (armState->second.State() == prmOperatingState::ENABLED);
+        if (powered) {
+            entry.powered = 0.0;
+            if ((command == "enable")
+                || armState->second.IsEnabledHomedAndNotBusy()) {
+                entry.ready = 0.0;
+            }
+        }
+        if (entry.group.empty() || powered) {
+            PowerSequenceRequest(arm);
+        } else if (sequence.powering[entry.group] < sequence.simultaneous) {
+            ++(sequence.powering[entry.group]);
+            PowerSequenceRequest(arm);
+        } else {
+            sequence.pending[entry.group].push_back(arm);
+        }
+    }
+    PowerSequenceWatchdogStart();
+}
+
+void mtsIntuitiveResearchKitConsole::PowerSequenceRequest(Arm * arm)
+{
+    auto & sequence = m_power_sequence;
+    sequence.arms[arm->Name()].requested
+        = mtsManagerLocal::GetInstance()->GetTimeServer().GetRelativeTime() - sequence.start_time;
+    arm->state_command(sequence.command);
+}
+
+void mtsIntuitiveResearchKitConsole::PowerSequenceUpdate(const std::string & armName,
+                                                         const prmOperatingState & currentState)
+{
+    auto & sequence = m_power_sequence;
+    if (sequence.command.empty()) {
+        return;
+    }
+    auto entryIter = sequence.arms.find(armName);
+    if ((entryIter == sequence.arms.end())
+        || (entryIter->second.requested < 0.0)
+        || (entryIter->second.ready >= 0.0)) {
+        return;
+    }
+    PowerSequenceEntry & entry = entryIter->second;
+    const double now = mtsManagerLocal::GetInstance()->GetTimeServer().GetRelativeTime() - sequence.start_time;
+
+    // an arm back to DISABLED after it started failed, an older
+    // DISABLED event might still be in the queue when we request
+    const bool disabled = (currentState.State() == prmOperatingState::DISABLED);
+    if (currentState.IsBusy() || !disabled) {
+        entry.started = true;
+    }
+    const bool fault = (currentState.State() == prmOperatingState::FAULT)
+        || (disabled && !currentState.IsBusy() && entry.started);
+
+    // power done (or failed), let the next arm in the group power
+    if ((entry.powered < 0.0)
+        && (fault || (currentState.State() == prmOperatingState::ENABLED))) {
+        PowerSequencePowered(entry, now);
+    }
+
+    if (fault) {
+        entry.fault = true;
+        entry.ready = now;
+        mInterface->SendWarning(this->GetName() + ": " + armName + " failed to "
+                                + sequence.command + " during power sequence");
+    } else if ((sequence.command == "enable") && (entry.powered >= 0.0)) {
+        entry.ready = now;
+    } else if (currentState.IsEnabledHomedAndNotBusy()) {
+        entry.ready = now;
+    }
+
+    PowerSequenceCheckDone(now);
+}
+
+void mtsIntuitiveResearchKitConsole::PowerSequencePowered(PowerSequenceEntry & entry,
+                                                          const double now)
+{
+    auto & sequence = m_power_sequence;
+    entry.powered = now;
+    if (!entry.group.empty()) {
+        --(sequence.powering[entry.group]);
+        auto & pending = sequence.pending[entry.group];
+        if (!pending.empty()) {
+            Arm * next = pending.front();
+            pending.pop_front();
+            ++(sequence.powering[entry.group]);
+            PowerSequenceRequest(next);
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitConsole::PowerSequenceCheckTimeouts(void)
+{
+    auto & sequence = m_power_sequence;
+    if (sequence.command.empty()) {
+        return;
+    }
+    const double now = mtsManagerLocal::GetInstance()->GetTimeServer().GetRelativeTime() - sequence.start_time;
+    bool changed = false;
+    for (auto & arm : sequence.arms) {
+        PowerSequenceEntry & entry = arm.second;
+        if ((entry.requested < 0.0)
+            || (entry.ready >= 0.0)
+            || ((now - entry.requested) < sequence.timeout)) {
+            continue;
+        }
+        // give up on this arm so the rest of its group can power
+        if (entry.powered < 0.0) {
+            PowerSequencePowered(entry, now);
+        }
+        entry.fault = true;
+        entry.ready = now;
+        changed = true;
+        std::stringstream message;
+        message << this->GetName() << ": " << arm.first << " failed to "
+                << sequence.command << " during power sequence (timeout after "
+                << std::fixed << std::setprecision(1) << sequence.timeout << "s)";
+        mInterface->SendWarning(message.str());
+    }
+    if (changed) {
+        PowerSequenceCheckDone(now);
+    }
+}
+
+void mtsIntuitiveResearchKitConsole::PowerSequenceCheckDone(const double now)
+{
+    auto & sequence = m_power_sequence;
+    // check if all arms are ready
+    size_t nbFaults = 0;
+    for (const auto & arm : sequence.arms) {
+        if (arm.second.ready < 0.0) {
+            return;
+        }
+        if (arm.second.fault) {
+            ++nbFaults;
+        }
     }
+    std::stringstream message;
+    message << this->GetName() << ": all arms "
+            << ((sequence.command == "enable") ? "powered" : "homed")
+            << " in " << std::fixed << std::setprecision(1) << now << "s";
+    if (nbFaults != 0) {
+        message << " (" << nbFaults << " failed)";
+    }
+    mInterface->SendStatus(message.str());
+    std::string timeline;
+    power_sequence_timeline(timeline);
+    CMN_LOG_CLASS_RUN_VERBOSE << "PowerSequenceCheckDone: timeline" << std::endl << timeline;
+    sequence.command.clear();
+    PowerSequenceWatchdogStop();
+}
+
+void mtsIntuitiveResearchKitConsole::PowerSequenceWatchdogStart(void)
+{
+    auto & watchdog = m_power_sequence_watchdog;
+    if (watchdog.thread.joinable()) {
+        return;
+    }
+    watchdog.stop = false;
+    watchdog.thread = std::thread([this] {
+        auto & watchdog = m_power_sequence_watchdog;
+        std::unique_lock<std::mutex> lock(watchdog.mutex);
+        while (!watchdog.condition.wait_for(lock, std::chrono::milliseconds(500),
+                                            [&watchdog] { return watchdog.stop; })) {
+            // Run checks the timeouts
+            Thread.Wakeup();
+        }
+    });
+}
+
+void mtsIntuitiveResearchKitConsole::PowerSequenceWatchdogStop(void)
+{
+    auto & watchdog = m_power_sequence_watchdog;
+    if (!watchdog.thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(watchdog.mutex);
+        watchdog.stop = true;
+    }
+    watchdog.condition.notify_all();
+    watchdog.thread.join();
+}
+
+void mtsIntuitiveResearchKitConsole::power_sequence_timeline(std::string & timeline) const
+{
+    std::stringstream result;
+    result << std::fixed << std::setprecision(2);
+    for (const auto & arm : m_power_sequence.arms) {
+        const PowerSequenceEntry & entry = arm.second;
+        result << arm.first;
+        if (!entry.group.empty()) {
+            result << " [" << entry.group << "]";
+        }
+        result << ": requested " << entry.requested
+               << "s, powered " << entry.powered
+               << "s, ready " << entry.ready << "s";
+        if (entry.fault) {
+            result << ", fault";
+        }
+        result << std::endl;
+    }
+    timeline = result.str();
 }
 
 void mtsIntuitiveResearchKitConsole::DisableFaultyArms(void)
@@ -2006,8 +3453,10 @@ void mtsIntuitiveResearchKitConsole::teleop_enable(const bool & enable)
 
 void mtsIntuitiveResearchKitConsole::cycle_teleop_psm_by_mtm(const std::string & mtmName)
 {
+    const auto & pairs = m_teleop_psm_pairs;
     // try to cycle through all the teleopPSMs associated to the MTM
-    if (mTeleopsPSMByMTM.count(mtmName) == 0) {
+    const auto mtmIndex = pairs.mtm_indices.find(mtmName);
+    if (mtmIndex == pairs.mtm_indices.end()) {
         // we use empty string to query, no need to send warning about bad mtm name
         if (mtmName != "") {
             mInterface->SendWarning(this->GetName()
@@ -2015,66 +3464,58 @@ void mtsIntuitiveResearchKitConsole::cycle_teleop_psm_by_mtm(const std::string &
                                     + mtmName
                                     + "\"");
         }
-    } else if (mTeleopsPSMByMTM.count(mtmName) == 1) {
+    } else if (pairs.teleops_by_mtm.at(mtmIndex->second).size() == 1) {
         mInterface->SendStatus(this->GetName()
                                + ": only one PSM teleoperation found for MTM \""
                                + mtmName
                                + "\", cycling has no effect");
     } else {
-        // find range of teleops
-        auto range = mTeleopsPSMByMTM.equal_range(mtmName);
-        for (auto iter = range.first;
-             iter != range.second;
-             ++iter) {
-            // find first teleop currently selected
-            if (iter->second->Selected()) {
-                // toggle to next one
-                auto nextTeleop = iter;
-                nextTeleop++;
-                // if next one is last one, go back to first
-                if (nextTeleop == range.second) {
-                    nextTeleop = range.first;
-                }
-                // now make sure the PSM in next teleop is not used
-                std::string mtmUsingThatPSM;
-                GetMTMSelectedForPSM(nextTeleop->second->mPSMName, mtmUsingThatPSM);
-                if (mtmUsingThatPSM != "") {
-                    // message
-                    mInterface->SendWarning(this->GetName()
-                                            + ": cycling from \""
-                                            + iter->second->m_name
-                                            + "\" to \""
-                                            + nextTeleop->second->m_name
-                                            + "\" failed, PSM is already controlled by \""
-                                            + mtmUsingThatPSM
-                                            + "\"");
-                } else {
-                    // mark which one should be active
-                    iter->second->SetSelected(false);
-                    nextTeleop->second->SetSelected(true);
-                    // if teleop PSM is active, enable/disable components now
-                    if (mTeleopEnabled) {
-                        iter->second->state_command(std::string("disable"));
-                        if (mTeleopPSMRunning) {
-                            nextTeleop->second->state_command(std::string("enable"));
-                        } else {
-                            nextTeleop->second->state_command(std::string("align_mtm"));
-                        }
+        const auto & teleops = pairs.teleops_by_mtm.at(mtmIndex->second);
+        const int selected = pairs.selected_by_mtm.at(mtmIndex->second);
+        if (selected >= 0) {
+            // toggle to next one, if current is last one, go back to first
+            const size_t position = std::find(teleops.begin(), teleops.end(),
+                                              static_cast<size_t>(selected)) - teleops.begin();
+            TeleopPSM * currentTeleop = pairs.teleops.at(selected);
+            TeleopPSM * nextTeleop = pairs.teleops.at(teleops.at((position + 1) % teleops.size()));
+            // now make sure the PSM in next teleop is not used
+            const int teleopUsingThatPSM = pairs.selected_by_psm.at(nextTeleop->m_psm_index);
+            if (teleopUsingThatPSM >= 0) {
+                // message
+                mInterface->SendWarning(this->GetName()
+                                        + ": cycling from \""
+                                        + currentTeleop->m_name
+                                        + "\" to \""
+                                        + nextTeleop->m_name
+                                        + "\" failed, PSM is already controlled by \""
+                                        + pairs.teleops.at(teleopUsingThatPSM)->mMTMName
+                                        + "\"");
+                // make sure users get the current status for that pair
+                nextTeleop->m_selection_event_pending = true;
+            } else {
+                // mark which one should be active
+                SetTeleopPSMSelected(currentTeleop, false);
+                SetTeleopPSMSelected(nextTeleop, true);
+                // if teleop PSM is active, enable/disable components now
+                if (mTeleopEnabled) {
+                    TeleopPSMStateCommand(currentTeleop, TeleopPSM::COMMAND_DISABLE);
+                    if (mTeleopPSMRunning) {
+                        TeleopPSMStateCommand(nextTeleop, TeleopPSM::COMMAND_ENABLE);
+                    } else {
+                        TeleopPSMStateCommand(nextTeleop, TeleopPSM::COMMAND_ALIGN_MTM);
                     }
-                    // message
-                    mInterface->SendStatus(this->GetName()
-                                           + ": cycling from \""
-                                           + iter->second->m_name
-                                           + "\" to \""
-                                           + nextTeleop->second->m_name
-                                           + "\"");
                 }
-                // stop for loop
-                break;
+                // message
+                mInterface->SendStatus(this->GetName()
+                                       + ": cycling from \""
+                                       + currentTeleop->m_name
+                                       + "\" to \""
+                                       + nextTeleop->m_name
+                                       + "\"");
             }
         }
     }
-    // in all cases, emit events so users can figure out which components are selected
+    // emit events for pairs that changed
     EventSelectedTeleopPSMs();
 }
 
@@ -2083,24 +3524,25 @@ void mtsIntuitiveResearchKitConsole::select_teleop_psm(const prmKeyValue & mtmPs
     // for readability
     const std::string mtmName = mtmPsm.Key;
     const std::string psmName = mtmPsm.Value;
+    const auto & pairs = m_teleop_psm_pairs;
 
     // if the psm value is empty, disable any teleop for the mtm -- this can be used to free the mtm
     if (psmName == "") {
-        auto range = mTeleopsPSMByMTM.equal_range(mtmName);
-        for (auto iter = range.first;
-             iter != range.second;
-             ++iter) {
+        const auto mtmIndex = pairs.mtm_indices.find(mtmName);
+        if (mtmIndex != pairs.mtm_indices.end()) {
             // look for the teleop that was selected if any
-            if (iter->second->Selected()) {
-                iter->second->SetSelected(false);
+            const int selected = pairs.selected_by_mtm.at(mtmIndex->second);
+            if (selected >= 0) {
+                TeleopPSM * teleop = pairs.teleops.at(selected);
+                SetTeleopPSMSelected(teleop, false);
                 // if teleop PSM is active, enable/disable components now
                 if (mTeleopEnabled) {
-                    iter->second->state_command(std::string("disable"));
+                    TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_DISABLE);
                 }
                 // message
                 mInterface->SendWarning(this->GetName()
                                         + ": teleop \""
-                                        + iter->second->Name()
+                                        + teleop->Name()
                                         + "\" has been unselected ");
             }
         }
@@ -2119,19 +3561,26 @@ void mtsIntuitiveResearchKitConsole::select_teleop_psm(const prmKeyValue & mtmPs
         EventSelectedTeleopPSMs();
         return;
     }
+    TeleopPSM * teleop = teleopIterator->second;
     // there seems to be some redundant information here, let's use it for a safety check
-    CMN_ASSERT(mtmName == teleopIterator->second->mMTMName);
-    CMN_ASSERT(psmName == teleopIterator->second->mPSMName);
+    CMN_ASSERT(mtmName == teleop->mMTMName);
+    CMN_ASSERT(psmName == teleop->mPSMName);
+    // already selected, nothing to do
+    if (teleop->Selected()) {
+        teleop->m_selection_event_pending = true;
+        EventSelectedTeleopPSMs();
+        return;
+    }
     // check that the PSM is available to be used
-    std::string mtmUsingThatPSM;
-    GetMTMSelectedForPSM(psmName, mtmUsingThatPSM);
-    if (mtmUsingThatPSM != "") {
+    const int teleopUsingThatPSM = pairs.selected_by_psm.at(teleop->m_psm_index);
+    if (teleopUsingThatPSM >= 0) {
         mInterface->SendWarning(this->GetName()
                                 + ": unable to select \""
                                 + name
                                 + "\", PSM is already controlled by \""
-                                + mtmUsingThatPSM
+                                + pairs.teleops.at(teleopUsingThatPSM)->mMTMName
                                 + "\"");
+        teleop->m_selection_event_pending = true;
         EventSelectedTeleopPSMs();
         return;
     }
@@ -2140,77 +3589,128 @@ void mtsIntuitiveResearchKitConsole::select_teleop_psm(const prmKeyValue & mtmPs
     select_teleop_psm(prmKeyValue(mtmName, ""));
 
     // now turn on the teleop
-    teleopIterator->second->SetSelected(true);
+    SetTeleopPSMSelected(teleop, true);
     // if teleop PSM is active, enable/disable components now
     if (mTeleopEnabled) {
         if (mTeleopPSMRunning) {
-            teleopIterator->second->state_command(std::string("enable"));
+            TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_ENABLE);
         } else {
-            teleopIterator->second->state_command(std::string("align_mtm"));
+            TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_ALIGN_MTM);
         }
     }
     // message
     mInterface->SendStatus(this->GetName()
                            + ": \""
-                           + teleopIterator->second->m_name
+                           + teleop->m_name
                            + "\" has been selected");
 
-    // always send a message to let user know the current status
+    // send events for pairs that changed
     EventSelectedTeleopPSMs();
 }
 
 bool mtsIntuitiveResearchKitConsole::GetPSMSelectedForMTM(const std::string & mtmName, std::string & psmName) const
 {
-    bool mtmFound = false;
+    const auto & pairs = m_teleop_psm_pairs;
     psmName = "";
-    // find range of teleops
-    auto range = mTeleopsPSMByMTM.equal_range(mtmName);
-    for (auto iter = range.first;
-         iter != range.second;
-         ++iter) {
-        mtmFound = true;
-        if (iter->second->Selected()) {
-            psmName = iter->second->mPSMName;
-        }
+    const auto mtmIndex = pairs.mtm_indices.find(mtmName);
+    if (mtmIndex == pairs.mtm_indices.end()) {
+        return false;
     }
-    return mtmFound;
+    const int selected = pairs.selected_by_mtm.at(mtmIndex->second);
+    if (selected >= 0) {
+        psmName = pairs.teleops.at(selected)->mPSMName;
+    }
+    return true;
 }
 
 bool mtsIntuitiveResearchKitConsole::GetMTMSelectedForPSM(const std::string & psmName, std::string & mtmName) const
 {
-    bool psmFound = false;
+    const auto & pairs = m_teleop_psm_pairs;
     mtmName = "";
-    for (auto & iter : mTeleopsPSM) {
-        if (iter.second->mPSMName == psmName) {
-            psmFound = true;
-            if (iter.second->Selected()) {
-                mtmName = iter.second->mMTMName;
-            }
+    const auto psmIndex = pairs.psm_indices.find(psmName);
+    if (psmIndex == pairs.psm_indices.end()) {
+        return false;
+    }
+    const int selected = pairs.selected_by_psm.at(psmIndex->second);
+    if (selected >= 0) {
+        mtmName = pairs.teleops.at(selected)->mMTMName;
+    }
+    return true;
+}
+
+void mtsIntuitiveResearchKitConsole::SetTeleopPSMSelected(TeleopPSM * teleop, const bool selected)
+{
+    if (teleop->mSelected == selected) {
+        return;
+    }
+    teleop->mSelected = selected;
+    teleop->m_selection_event_pending = true;
+    auto & pairs = m_teleop_psm_pairs;
+    const int index = static_cast<int>(teleop->m_index);
+    int & byMTM = pairs.selected_by_mtm.at(teleop->m_mtm_index);
+    int & byPSM = pairs.selected_by_psm.at(teleop->m_psm_index);
+    if (selected) {
+        byMTM = index;
+        byPSM = index;
+    } else {
+        if (byMTM == index) {
+            byMTM = -1;
+        }
+        if (byPSM == index) {
+            byPSM = -1;
         }
     }
-    return psmFound;
 }
 
-void mtsIntuitiveResearchKitConsole::EventSelectedTeleopPSMs(void) const
+void mtsIntuitiveResearchKitConsole::TeleopPSMStateCommand(TeleopPSM * teleop,
+                                                           const TeleopPSM::StateCommandType command)
 {
-    for (auto & iter : mTeleopsPSM) {
-        if (iter.second->Selected()) {
-            ConfigurationEvents.teleop_psm_selected(prmKeyValue(iter.second->mMTMName,
-                                                                iter.second->mPSMName));
+    if (teleop->m_last_state_command == command) {
+        return;
+    }
+    teleop->m_last_state_command = command;
+    switch (command) {
+    case TeleopPSM::COMMAND_DISABLE:
+        teleop->state_command(std::string("disable"));
+        break;
+    case TeleopPSM::COMMAND_ENABLE:
+        teleop->state_command(std::string("enable"));
+        break;
+    case TeleopPSM::COMMAND_ALIGN_MTM:
+        teleop->state_command(std::string("align_mtm"));
+        break;
+    default:
+        break;
+    }
+}
+
+void mtsIntuitiveResearchKitConsole::EventSelectedTeleopPSMs(const bool all)
+{
+    for (auto teleop : m_teleop_psm_pairs.teleops) {
+        if (!all && !teleop->m_selection_event_pending) {
+            continue;
+        }
+        teleop->m_selection_event_pending = false;
+        if (teleop->Selected()) {
+            ConfigurationEvents.teleop_psm_selected(prmKeyValue(teleop->mMTMName,
+                                                                teleop->mPSMName));
         } else {
-            ConfigurationEvents.teleop_psm_unselected(prmKeyValue(iter.second->mMTMName,
-                                                                  iter.second->mPSMName));
+            ConfigurationEvents.teleop_psm_unselected(prmKeyValue(teleop->mMTMName,
+                                                                  teleop->mPSMName));
         }
     }
 }
 
 void mtsIntuitiveResearchKitConsole::UpdateTeleopState(void)
 {
+    // only teleops that need to change state get a command, see TeleopPSMStateCommand
+    const auto & teleopsPSM = m_teleop_psm_pairs.teleops;
+
     // Check if teleop is enabled
     if (!mTeleopEnabled) {
         bool freezeNeeded = false;
-        for (auto & iterTeleopPSM : mTeleopsPSM) {
-            iterTeleopPSM.second->state_command(std::string("disable"));
+        for (auto teleop : teleopsPSM) {
+            TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_DISABLE);
             if (mTeleopPSMRunning) {
                 freezeNeeded = true;
             }
@@ -2261,11 +3761,11 @@ void mtsIntuitiveResearchKitConsole::UpdateTeleopState(void)
     // Check if operator is present
     if (!readyForTeleop) {
         // keep MTMs aligned
-        for (auto & iterTeleopPSM : mTeleopsPSM) {
-            if (iterTeleopPSM.second->Selected()) {
-                iterTeleopPSM.second->state_command(std::string("align_mtm"));
+        for (auto teleop : teleopsPSM) {
+            if (teleop->Selected()) {
+                TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_ALIGN_MTM);
             } else {
-                iterTeleopPSM.second->state_command(std::string("disable"));
+                TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_DISABLE);
             }
         }
         mTeleopPSMRunning = false;
@@ -2283,8 +3783,8 @@ void mtsIntuitiveResearchKitConsole::UpdateTeleopState(void)
         if (!mTeleopECMRunning) {
             // if PSM was running so we need to stop it
             if (mTeleopPSMRunning) {
-                for (auto & iterTeleopPSM : mTeleopsPSM) {
-                    iterTeleopPSM.second->state_command(std::string("disable"));
+                for (auto teleop : teleopsPSM) {
+                    TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_DISABLE);
                 }
                 mTeleopPSMRunning = false;
             }
@@ -2303,11 +3803,11 @@ void mtsIntuitiveResearchKitConsole::UpdateTeleopState(void)
                 mTeleopECMRunning = false;
             }
             // PSM wasn't running, let's start it
-            for (auto & iterTeleopPSM : mTeleopsPSM) {
-                if (iterTeleopPSM.second->Selected()) {
-                    iterTeleopPSM.second->state_command(std::string("enable"));
+            for (auto teleop : teleopsPSM) {
+                if (teleop->Selected()) {
+                    TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_ENABLE);
                 } else {
-                    iterTeleopPSM.second->state_command(std::string("disable"));
+                    TeleopPSMStateCommand(teleop, TeleopPSM::COMMAND_DISABLE);
                 }
                 mTeleopPSMRunning = true;
             }
@@ -2494,7 +3994,7 @@ void mtsIntuitiveResearchKitConsole::SetArmCurrentState(const std::string & armN
             } else {
                 // special case for PSMs when coming back from busy state
                 // (e.g. engaging adapter or instrument)
-                const auto count = mTeleopsPSMByPSM.count(armName);
+                const auto count = m_teleop_psm_pairs.psm_indices.count(armName);
                 if (count != 0) {
                     if (!armState->second.IsBusy() && currentState.IsEnabledHomedAndNotBusy()) {
                         teleop_enable(true);
@@ -2506,6 +4006,7 @@ void mtsIntuitiveResearchKitConsole::SetArmCurrentState(const std::string & armN
 
     // save state
     ArmStates[armName] = currentState;
+    PowerSequenceUpdate(armName, currentState);
 
     // emit event (for Qt GUI)
     std::string payload = "";
@@ -26,6 +26,7 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstParameterTypes/prmEventButton.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitECM.h>
 #include <sawIntuitiveResearchKit/robManipulatorECM.h>
+#include <sawIntuitiveResearchKit/robManipulatorFixed.h>
 
 CMN_IMPLEMENT_SERVICES_DERIVED_ONEARG(mtsIntuitiveResearchKitECM, mtsTaskPeriodic, mtsTaskPeriodicConstructorArg);
 
@@ -63,11 +64,11 @@ void mtsIntuitiveResearchKitECM::PostConfigure(const Json::Value & jsonConfig,
         CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
                                  << ": \"endoscope\" must be defined (from file \""
                                  << filename << "\")" << std::endl;
-        exit(EXIT_FAILURE);
+        ConfigurationFailure();
     }
 
     if (!m_endoscope_configured) {
-        exit(EXIT_FAILURE);
+        ConfigurationFailure();
     }
 
     // check that Rtw0 is not set
@@ -75,7 +76,7 @@ void mtsIntuitiveResearchKitECM::PostConfigure(const Json::Value & jsonConfig,
         CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
                                  << ": you can't define the base-offset for the ECM, it is hard coded so gravity compensation works properly.  We always assume the ECM is mounted at 45 degrees! (from file \""
                                  << filename << "\")" << std::endl;
-        exit(EXIT_FAILURE);
+        ConfigurationFailure();
     }
 
     // 45 degrees rotation to make sure Z points up, this helps with
@@ -117,7 +118,7 @@ void mtsIntuitiveResearchKitECM::CreateManipulator(void)
     if (Manipulator) {
         delete Manipulator;
     }
-    Manipulator = new robManipulatorECM();
+    Manipulator = new robManipulatorFixed<4, robManipulatorECM>();
 }
 
 void mtsIntuitiveResearchKitECM::Init(void)
@@ -245,11 +246,11 @@ void mtsIntuitiveResearchKitECM::EnterManual(void)
 void mtsIntuitiveResearchKitECM::RunManual(void)
 {
     // zero efforts
-    mEffortJoint.SetAll(0.0);
+    m_kinematics->effort.SetAll(0.0);
     if (m_gravity_compensation) {
-        control_add_gravity_compensation(mEffortJoint);
+        control_add_gravity_compensation(m_kinematics->effort);
     }
-    servo_jf_internal(mEffortJoint);
+    servo_jf_internal(m_kinematics->effort);
 }
 
 void mtsIntuitiveResearchKitECM::LeaveManual(void)
@@ -350,6 +351,8 @@ void mtsIntuitiveResearchKitECM::set_endoscope_type(const std::string & endoscop
     Manipulator->DeleteTools();
     ToolOffset = new robManipulator(ToolOffsetTransformation);
     Manipulator->Attach(ToolOffset);
+    // evaluator caches the tool offset
+    m_kinematics->evaluator.Configure(*Manipulator);
 
     // update estimated mass for gravity compensation
     double mass;
@@ -0,0 +1,171 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-28
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+
+#include <cisstCommon/cmnLogger.h>
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitFlightRecorder.h>
+
+mtsIntuitiveResearchKitFlightRecorder::mtsIntuitiveResearchKitFlightRecorder(void):
+    m_dumping(false)
+{
+}
+
+mtsIntuitiveResearchKitFlightRecorder::~mtsIntuitiveResearchKitFlightRecorder()
+{
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_one();
+        m_thread.join();
+    }
+}
+
+void mtsIntuitiveResearchKitFlightRecorder::Allocate(const std::string & name,
+                                                     const std::vector<std::string> & columns,
+                                                     const size_t numberOfSamples,
+                                                     const std::string & directory)
+{
+    m_name = name;
+    m_columns = {"time"};
+    m_columns.insert(m_columns.end(), columns.begin(), columns.end());
+    m_sample_size = m_columns.size();
+    m_capacity = numberOfSamples;
+    m_directory = directory;
+    m_head = 0;
+    m_event_head = 0;
+    if (m_capacity == 0) {
+        return;
+    }
+    m_samples.assign(m_sample_size * m_capacity, 0.0);
+    m_dump_samples.assign(m_samples.size(), 0.0);
+    m_events.resize(NUMBER_OF_EVENTS);
+    m_dump_events.resize(NUMBER_OF_EVENTS);
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&mtsIntuitiveResearchKitFlightRecorder::WriterThread, this);
+    }
+}
+
+void mtsIntuitiveResearchKitFlightRecorder::Event(const double time, const std::string & text)
+{
+    if (m_capacity == 0) {
+        return;
+    }
+    EventType & event = m_events[m_event_head % NUMBER_OF_EVENTS];
+    ++m_event_head;
+    event.time = time;
+    strncpy(event.text, text.c_str(), EVENT_SIZE - 1);
+    event.text[EVENT_SIZE - 1] = '\0';
+}
+
+bool mtsIntuitiveResearchKitFlightRecorder::Trigger(const double time, const std::string & reason)
+{
+    if ((m_capacity == 0)
+        || m_dumping.load(std::memory_order_acquire)) {
+        return false;
+    }
+    // history duration, assumes constant period
+    const size_t used = std::min(m_head, m_capacity);
+    if (m_triggered && (used > 0)) {
+        const double * oldest = m_samples.data() + ((m_head - used) % m_capacity) * m_sample_size;
+        if (time - m_last_trigger < time - oldest[0]) {
+            return false;
+        }
+    }
+    m_triggered = true;
+    m_last_trigger = time;
+    Event(time, "trigger: " + reason);
+
+    // copy everything for writer thread
+    std::copy(m_samples.begin(), m_samples.end(), m_dump_samples.begin());
+    std::copy(m_events.begin(), m_events.end(), m_dump_events.begin());
+    m_dump_head = m_head;
+    m_dump_event_head = m_event_head;
+    m_dump_reason.time = time;
+    strncpy(m_dump_reason.text, reason.c_str(), EVENT_SIZE - 1);
+    m_dump_reason.text[EVENT_SIZE - 1] = '\0';
+    {
+        // only locked on trigger, makes sure the writer doesn't miss the notification
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_dumping.store(true, std::memory_order_release);
+    }
+    m_condition.notify_one();
+    return true;
+}
+
+void mtsIntuitiveResearchKitFlightRecorder::WriterThread(void)
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] {
+                    return m_stop || m_dumping.load(std::memory_order_acquire);
+                });
+            if (m_stop) {
+                return;
+            }
+        }
+
+        // file name based on local date and time
+        char date[32];
+        const std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%d-%H-%M-%S", std::localtime(&now));
+        std::string fileName = m_name + "-flight-" + date + ".csv";
+        if (m_directory != "") {
+            fileName = m_directory + "/" + fileName;
+        }
+
+        std::ofstream file(fileName);
+        if (!file.is_open()) {
+            CMN_LOG_RUN_ERROR << "mtsIntuitiveResearchKitFlightRecorder: " << m_name
+                              << ", failed to create \"" << fileName << "\"" << std::endl;
+        } else {
+            file << std::setprecision(17);
+            file << "# " << m_name << ", trigger at " << m_dump_reason.time
+                 << ": " << m_dump_reason.text << std::endl;
+            const size_t nbEvents = std::min(m_dump_event_head, static_cast<size_t>(NUMBER_OF_EVENTS));
+            for (size_t index = m_dump_event_head - nbEvents; index < m_dump_event_head; ++index) {
+                const EventType & event = m_dump_events[index % NUMBER_OF_EVENTS];
+                file << "# " << event.time << " " << event.text << std::endl;
+            }
+            for (size_t column = 0; column < m_sample_size; ++column) {
+                file << (column ? "," : "") << m_columns[column];
+            }
+            file << std::endl;
+            const size_t nbSamples = std::min(m_dump_head, m_capacity);
+            for (size_t index = m_dump_head - nbSamples; index < m_dump_head; ++index) {
+                const double * sample = m_dump_samples.data() + (index % m_capacity) * m_sample_size;
+                for (size_t column = 0; column < m_sample_size; ++column) {
+                    file << (column ? "," : "") << sample[column];
+                }
+                file << '\n';
+            }
+            file.close();
+            CMN_LOG_RUN_WARNING << "mtsIntuitiveResearchKitFlightRecorder: " << m_name
+                                << ", saved " << nbSamples << " sample(s) in \"" << fileName << "\"" << std::endl;
+        }
+        m_dumping.store(false, std::memory_order_release);
+    }
+}
@@ -0,0 +1,311 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-11-29
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <cisstCommon/cmnPortability.h>
+
+#if (CISST_OS == CISST_LINUX) || (CISST_OS == CISST_DARWIN)
+#define HEALTH_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if (CISST_OS == CISST_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#include <cisstMultiTask/mtsInterfaceProvided.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitHealth.h>
+
+CMN_IMPLEMENT_SERVICES(mtsIntuitiveResearchKitHeartbeatHook);
+CMN_IMPLEMENT_SERVICES_DERIVED(mtsIntuitiveResearchKitHealthMonitor, mtsTaskPeriodic);
+
+namespace {
+    // nice value used for the monitor's thread
+    const int HealthMonitorNice = 10;
+}
+
+mtsIntuitiveResearchKitHealthTable & mtsIntuitiveResearchKitHealthTable::Instance(void)
+{
+    static mtsIntuitiveResearchKitHealthTable instance;
+    return instance;
+}
+
+mtsIntuitiveResearchKitHealthTable::~mtsIntuitiveResearchKitHealthTable()
+{
+    Close();
+}
+
+bool mtsIntuitiveResearchKitHealthTable::Open(const std::string & segmentName)
+{
+    m_mutex.Lock();
+    if (m_layout) {
+        m_mutex.Unlock();
+        return m_shared;
+    }
+    m_shared = false;
+#ifdef HEALTH_POSIX
+    // never reuse an existing segment, it might belong to another process
+    m_file_descriptor = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (m_file_descriptor >= 0) {
+        if (ftruncate(m_file_descriptor, sizeof(mtsHealthLayout)) == 0) {
+            void * address = mmap(nullptr, sizeof(mtsHealthLayout),
+                                  PROT_READ | PROT_WRITE, MAP_SHARED, m_file_descriptor, 0);
+            if (address != MAP_FAILED) {
+                m_layout = static_cast<mtsHealthLayout *>(address);
+                m_segment_name = segmentName;
+                m_shared = true;
+            }
+        }
+        if (!m_shared) {
+            close(m_file_descriptor);
+            m_file_descriptor = -1;
+            shm_unlink(segmentName.c_str());
+        }
+    }
+#endif
+    if (!m_shared) {
+        // local table, new segment is filled with zeros so do the same
+        m_layout = static_cast<mtsHealthLayout *>(calloc(1, sizeof(mtsHealthLayout)));
+    }
+    if (m_layout) {
+        m_layout->Version = HEALTH_VERSION;
+        // magic is set last so readers know the segment is ready
+        std::atomic_thread_fence(std::memory_order_release);
+        m_layout->Magic = HEALTH_MAGIC;
+    }
+    m_mutex.Unlock();
+    return m_shared;
+}
+
+void mtsIntuitiveResearchKitHealthTable::Close(void)
+{
+    m_mutex.Lock();
+    if (m_layout) {
+        if (m_shared) {
+#ifdef HEALTH_POSIX
+            munmap(m_layout, sizeof(mtsHealthLayout));
+            close(m_file_descriptor);
+            m_file_descriptor = -1;
+            shm_unlink(m_segment_name.c_str());
+#endif
+        } else {
+            free(m_layout);
+        }
+        m_layout = nullptr;
+    }
+    m_mutex.Unlock();
+}
+
+mtsHealthTask * mtsIntuitiveResearchKitHealthTable::Register(const std::string & name,
+                                                              const double period)
+{
+    mtsHealthTask * result = nullptr;
+    m_mutex.Lock();
+    if (m_layout) {
+        const uint32_t index = m_layout->NumberOfTasks.load(std::memory_order_relaxed);
+        if (index < HEALTH_MAX_TASKS) {
+            result = &(m_layout->Tasks[index]);
+            strncpy(result->Name, name.c_str(), HEALTH_NAME_SIZE - 1);
+            result->Period = period;
+            result->CycleStart.store(Now(), std::memory_order_relaxed);
+            result->Registered.store(1, std::memory_order_release);
+            m_layout->NumberOfTasks.store(index + 1, std::memory_order_release);
+        }
+    }
+    m_mutex.Unlock();
+    return result;
+}
+
+int64_t mtsIntuitiveResearchKitHealthTable::Now(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+mtsIntuitiveResearchKitHeartbeatHook::mtsIntuitiveResearchKitHeartbeatHook(const std::string & componentName,
+                                                                           const std::string & targetName,
+                                                                           const double targetPeriod):
+    mtsTaskPeriodic(componentName, 0.0)
+{
+    m_heartbeat.Configure(targetName, targetPeriod);
+}
+
+void mtsIntuitiveResearchKitHeartbeatHook::Run(void)
+{
+    m_heartbeat.Beat();
+}
+
+mtsIntuitiveResearchKitHealthMonitor::mtsIntuitiveResearchKitHealthMonitor(const std::string & componentName,
+                                                                           const double periodInSeconds):
+    mtsTaskPeriodic(componentName, periodInSeconds)
+{
+    StateTable.AddData(m_task_names, "task_names");
+    StateTable.AddData(m_cycle_times, "cycle_times");
+    StateTable.AddData(m_ages, "ages");
+    StateTable.AddData(m_overruns, "overruns");
+    StateTable.AddData(m_stalled, "stalled");
+    StateTable.AddData(m_number_of_stalls, "number_of_stalls");
+
+    m_interface = AddInterfaceProvided("HealthMonitor");
+    if (m_interface) {
+        m_interface->AddMessageEvents();
+        m_interface->AddCommandReadState(StateTable, m_task_names, "task_names");
+        m_interface->AddCommandReadState(StateTable, m_cycle_times, "cycle_times");
+        m_interface->AddCommandReadState(StateTable, m_ages, "ages");
+        m_interface->AddCommandReadState(StateTable, m_overruns, "overruns");
+        m_interface->AddCommandReadState(StateTable, m_stalled, "stalled");
+        m_interface->AddCommandReadState(StateTable, m_number_of_stalls, "number_of_stalls");
+    }
+}
+
+bool mtsIntuitiveResearchKitHealthMonitor::Configure(const Json::Value & jsonConfig)
+{
+    m_stall_factor = jsonConfig.get("stall-factor", m_stall_factor).asDouble();
+    m_stall_timeout = jsonConfig.get("stall-timeout", m_stall_timeout).asDouble();
+    if ((m_stall_factor < 1.0) || (m_stall_timeout <= 0.0)) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: \"stall-factor\" must be greater or equal to 1 and \"stall-timeout\" strictly positive for "
+                                 << this->GetName() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void mtsIntuitiveResearchKitHealthMonitor::Startup(void)
+{
+#if (CISST_OS == CISST_LINUX)
+    // don't inherit a real-time policy and let all other threads go first
+    struct sched_param parameters;
+    parameters.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &parameters);
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), HealthMonitorNice) != 0) {
+        CMN_LOG_CLASS_INIT_WARNING << "Startup: " << this->GetName()
+                                   << ", failed to lower thread priority" << std::endl;
+    }
+#endif
+}
+
+void mtsIntuitiveResearchKitHealthMonitor::Run(void)
+{
+    ProcessQueuedCommands();
+
+    const mtsHealthLayout * layout = mtsIntuitiveResearchKitHealthTable::Instance().Layout();
+    if (!layout) {
+        return;
+    }
+
+    // tasks register on their first cycle
+    const uint32_t numberOfTasks = layout->NumberOfTasks.load(std::memory_order_acquire);
+    if (numberOfTasks > m_tasks.size()) {
+        AddTasks(*layout, numberOfTasks);
+    }
+
+    // if this thread was late itself, ages are not meaningful
+    const int64_t now = mtsIntuitiveResearchKitHealthTable::Now();
+    const bool late = (m_last_run != 0)
+        && ((now - m_last_run) > static_cast<int64_t>(m_stall_timeout * 1.0e9));
+    m_last_run = now;
+    for (size_t index = 0; index < m_tasks.size(); ++index) {
+        UpdateTask(index, layout->Tasks[index], now, late);
+    }
+}
+
+void mtsIntuitiveResearchKitHealthMonitor::AddTasks(const mtsHealthLayout & layout,
+                                                    const uint32_t numberOfTasks)
+{
+    for (size_t index = m_tasks.size(); index < numberOfTasks; ++index) {
+        const mtsHealthTask & task = layout.Tasks[index];
+        if (!task.Registered.load(std::memory_order_acquire)) {
+            break;
+        }
+        TaskData data;
+        data.m_name = std::string(task.Name, strnlen(task.Name, HEALTH_NAME_SIZE));
+        const double threshold = std::max(m_stall_factor * task.Period, m_stall_timeout);
+        data.m_stall_threshold = static_cast<int64_t>(threshold * 1.0e9);
+        m_tasks.push_back(data);
+        m_last_overrun_report.push_back(0.0);
+        if (!m_task_names.empty()) {
+            m_task_names.append(",");
+        }
+        m_task_names.append(data.m_name);
+        CMN_LOG_CLASS_INIT_VERBOSE << "AddTasks: " << this->GetName() << " monitoring \""
+                                   << data.m_name << "\", stall after "
+                                   << threshold << "s" << std::endl;
+    }
+    // resizing is fine, this thread is not time critical
+    m_cycle_times.resize(m_tasks.size());
+    m_ages.resize(m_tasks.size());
+    m_overruns.resize(m_tasks.size());
+    m_stalled.resize(m_tasks.size());
+}
+
+void mtsIntuitiveResearchKitHealthMonitor::UpdateTask(const size_t index,
+                                                      const mtsHealthTask & task,
+                                                      const int64_t now,
+                                                      const bool late)
+{
+    TaskData & data = m_tasks[index];
+    const int64_t age = now - task.CycleStart.load(std::memory_order_relaxed);
+    m_ages.at(index) = age * 1.0e-9;
+    m_cycle_times.at(index) = task.CycleTime.load(std::memory_order_relaxed) * 1.0e-9;
+
+    // stalls
+    const bool stalled = late ? data.m_stalled : (age > data.m_stall_threshold);
+    if (stalled != data.m_stalled) {
+        data.m_stalled = stalled;
+        std::stringstream message;
+        message << this->GetName() << ": " << data.m_name;
+        if (stalled) {
+            ++m_number_of_stalls;
+            message << " stalled, no cycle for "
+                    << std::fixed << std::setprecision(1) << age * 1.0e-6 << "ms";
+            m_interface->SendError(message.str());
+        } else {
+            message << " running again";
+            m_interface->SendStatus(message.str());
+        }
+    }
+    m_stalled.at(index) = stalled;
+
+    // overruns, one message per task and report period
+    const uint64_t overruns = task.Overruns.load(std::memory_order_relaxed);
+    m_overruns.at(index) = static_cast<unsigned int>(overruns);
+    if (overruns > data.m_overruns) {
+        const double time = now * 1.0e-9;
+        if ((time - m_last_overrun_report.at(index)) >= m_overrun_report_period) {
+            m_last_overrun_report.at(index) = time;
+            std::stringstream message;
+            message << this->GetName() << ": " << data.m_name << " "
+                    << (overruns - data.m_overruns) << " overrun(s), last cycle "
+                    << std::fixed << std::setprecision(3) << m_cycle_times.at(index) * 1000.0 << "ms";
+            m_interface->SendWarning(message.str());
+            data.m_overruns = overruns;
+        }
+    }
+}
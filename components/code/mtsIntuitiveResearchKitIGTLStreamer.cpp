@@ -0,0 +1,217 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-11-15
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+// system include
+#include <algorithm>
+#include <cmath>
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitIGTLStreamer.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
+#include <cisstMultiTask/mtsInterfaceProvided.h>
+#include <cisstMultiTask/mtsInterfaceRequired.h>
+
+CMN_IMPLEMENT_SERVICES_DERIVED_ONEARG(mtsIntuitiveResearchKitIGTLStreamer, mtsTaskPeriodic, mtsTaskPeriodicConstructorArg);
+
+mtsIntuitiveResearchKitIGTLStreamer::mtsIntuitiveResearchKitIGTLStreamer(const std::string & componentName,
+                                                                         const double periodInSeconds):
+    mtsTaskPeriodic(componentName, periodInSeconds)
+{
+    Init();
+}
+
+mtsIntuitiveResearchKitIGTLStreamer::mtsIntuitiveResearchKitIGTLStreamer(const mtsTaskPeriodicConstructorArg & arg):
+    mtsTaskPeriodic(arg)
+{
+    Init();
+}
+
+mtsIntuitiveResearchKitIGTLStreamer::~mtsIntuitiveResearchKitIGTLStreamer()
+{
+    for (auto client : m_clients) {
+        delete client;
+    }
+}
+
+void mtsIntuitiveResearchKitIGTLStreamer::Init(void)
+{
+    mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired("Arm");
+    if (interfaceRequired) {
+        interfaceRequired->AddFunction("measured_bundle", m_arm.measured_bundle);
+    }
+}
+
+void mtsIntuitiveResearchKitIGTLStreamer::Configure(const std::string & filename)
+{
+    Json::Value jsonConfig;
+
+    if (filename == "") {
+        return;
+    }
+
+    std::string jsonErrors;
+    if (!mtsIntuitiveResearchKitConfigCache::Parse(filename, jsonConfig, jsonErrors)) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
+                                 << ": failed to parse configuration file \""
+                                 << filename << "\"\n"
+                                 << jsonErrors;
+        exit(EXIT_FAILURE);
+    }
+
+    CMN_LOG_CLASS_INIT_VERBOSE << "Configure: " << this->GetName()
+                               << " using file \"" << filename << "\"" << std::endl
+                               << "----> content of configuration file: " << std::endl
+                               << jsonConfig << std::endl
+                               << "<----" << std::endl;
+
+    mtsIntuitiveResearchKitIGTLStreamer::Configure(jsonConfig);
+}
+
+void mtsIntuitiveResearchKitIGTLStreamer::Configure(const Json::Value & jsonConfig)
+{
+    // base component configuration
+    mtsComponent::ConfigureJSON(jsonConfig);
+
+    const Json::Value jsonClients = jsonConfig["clients"];
+    if (jsonClients.empty()) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: \"clients\" is required for "
+                                 << this->GetName() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned int index = 0; index < jsonClients.size(); ++index) {
+        const Json::Value jsonClient = jsonClients[index];
+        const std::string name = jsonClient["name"].asString();
+        if (name == "") {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: \"name\" is required for clients["
+                                     << index << "]" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        const double rate = jsonClient.get("rate", 30.0).asDouble();
+        if (!AddClient(name, rate)) {
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+bool mtsIntuitiveResearchKitIGTLStreamer::AddClient(const std::string & name, const double rate)
+{
+    if (rate <= 0.0) {
+        CMN_LOG_CLASS_INIT_ERROR << "AddClient: rate for \"" << name
+                                 << "\" must be positive, found: " << rate << std::endl;
+        return false;
+    }
+    mtsInterfaceProvided * interfaceProvided = AddInterfaceProvided(name);
+    if (!interfaceProvided) {
+        CMN_LOG_CLASS_INIT_ERROR << "AddClient: failed to create interface \""
+                                 << name << "\", name might be already used" << std::endl;
+        return false;
+    }
+
+    ClientType * client = new ClientType;
+    client->m_name = name;
+    // number of periods between frames, at least one
+    const double periods = 1.0 / (rate * this->GetPeriodicity());
+    client->m_decimation = std::max(1u, static_cast<unsigned int>(std::round(periods)));
+
+    // state table names must be unique, prefix with client name
+    const std::string prefix = name + "_";
+    this->StateTable.AddData(client->m_measured_js, prefix + "measured_js");
+    this->StateTable.AddData(client->m_setpoint_js, prefix + "setpoint_js");
+    this->StateTable.AddData(client->m_measured_cp, prefix + "measured_cp");
+    this->StateTable.AddData(client->m_setpoint_cp, prefix + "setpoint_cp");
+    this->StateTable.AddData(client->m_measured_cv, prefix + "measured_cv");
+    this->StateTable.AddData(client->m_body_measured_cf, prefix + "body_measured_cf");
+    this->StateTable.AddData(client->m_operating_state, prefix + "operating_state");
+
+    interfaceProvided->AddCommandReadState(this->StateTable, client->m_measured_js, "measured_js");
+    interfaceProvided->AddCommandReadState(this->StateTable, client->m_setpoint_js, "setpoint_js");
+    interfaceProvided->AddCommandReadState(this->StateTable, client->m_measured_cp, "measured_cp");
+    interfaceProvided->AddCommandReadState(this->StateTable, client->m_setpoint_cp, "setpoint_cp");
+    interfaceProvided->AddCommandReadState(this->StateTable, client->m_measured_cv, "measured_cv");
+    interfaceProvided->AddCommandReadState(this->StateTable, client->m_body_measured_cf, "body/measured_cf");
+    interfaceProvided->AddCommandReadState(this->StateTable, client->m_operating_state, "operating_state");
+    interfaceProvided->AddEventVoid(client->frame_event, "frame");
+
+    CMN_LOG_CLASS_INIT_VERBOSE << "AddClient: " << name << " every "
+                               << client->m_decimation << " period(s)" << std::endl;
+    m_clients.push_back(client);
+    return true;
+}
+
+void mtsIntuitiveResearchKitIGTLStreamer::Startup(void)
+{
+}
+
+void mtsIntuitiveResearchKitIGTLStreamer::Run(void)
+{
+    ProcessQueuedEvents();
+    ProcessQueuedCommands();
+
+    // only read from the arm if a client needs a frame this period
+    bool needed = false;
+    for (auto client : m_clients) {
+        ++client->m_counter;
+        if (client->m_counter >= client->m_decimation) {
+            needed = true;
+        }
+    }
+    if (!needed) {
+        return;
+    }
+
+    if (!m_arm.measured_bundle(m_bundle).IsOK()) {
+        return;
+    }
+
+    for (auto client : m_clients) {
+        if (client->m_counter >= client->m_decimation) {
+            // coalesce, skip if the arm didn't publish new data since last frame
+            if (m_bundle.measured_js.timestamp != client->m_last_timestamp) {
+                client->m_counter = 0;
+                client->m_last_timestamp = m_bundle.measured_js.timestamp;
+                Publish(client);
+                client->frame_event();
+            }
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitIGTLStreamer::Publish(ClientType * client)
+{
+    m_bundle.measured_js.To(client->m_measured_js);
+    m_bundle.setpoint_js.To(client->m_setpoint_js);
+    m_bundle.measured_cp.To(client->m_measured_cp);
+    m_bundle.setpoint_cp.To(client->m_setpoint_cp);
+
+    client->m_measured_cv.Valid() = m_bundle.measured_cv_valid;
+    client->m_measured_cv.Timestamp() = m_bundle.measured_cv_timestamp;
+    client->m_measured_cv.VelocityLinear().Assign(m_bundle.measured_cv.Ref<3>(0));
+    client->m_measured_cv.VelocityAngular().Assign(m_bundle.measured_cv.Ref<3>(3));
+
+    client->m_body_measured_cf.Valid() = m_bundle.body_measured_cf_valid;
+    client->m_body_measured_cf.Timestamp() = m_bundle.body_measured_cf_timestamp;
+    client->m_body_measured_cf.Force().Assign(m_bundle.body_measured_cf);
+
+    client->m_operating_state.State() = prmOperatingState::StateTypeFromString(m_bundle.operating_state);
+    client->m_operating_state.IsHomed() = m_bundle.is_homed;
+    client->m_operating_state.IsBusy() = m_bundle.is_busy;
+    client->m_operating_state.Valid() = true;
+}
+
+void mtsIntuitiveResearchKitIGTLStreamer::Cleanup(void)
+{
+}
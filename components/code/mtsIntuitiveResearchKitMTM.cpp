@@ -30,8 +30,10 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstParameterTypes/prmMaskedVector.h>
 
 #include <sawIntuitiveResearchKit/robManipulatorMTM.h>
+#include <sawIntuitiveResearchKit/robManipulatorFixed.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitMTM.h>
-#include "robGravityCompensationMTM.h"
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
+#include <sawIntuitiveResearchKit/robGravityCompensationMTM.h>
 
 CMN_IMPLEMENT_SERVICES_DERIVED_ONEARG(mtsIntuitiveResearchKitMTM, mtsTaskPeriodic, mtsTaskPeriodicConstructorArg);
 
@@ -98,6 +100,7 @@ void mtsIntuitiveResearchKitMTM::Init(void)
 
     // joint values when orientation is locked
     mEffortOrientationJoint.SetSize(NumberOfJoints());
+    m_orientation_lock.joints.SetSize(NumberOfJointsKinematics());
 
     // initialize gripper state
     m_gripper_measured_js.Name().SetSize(1);
@@ -129,7 +132,8 @@ void mtsIntuitiveResearchKitMTM::Init(void)
     // last 3 joints tend to be weaker
     PID.DefaultTrackingErrorTolerance.Ref(3, 4) = 30.0 * cmnPI_180;
 
-    this->StateTable.AddData(m_gripper_measured_js, "gripper/measured_js");
+    AddStateData(StateTable, m_gripper_measured_js, "gripper/measured_js");
+    AddStateData(StateTable, m_gravity_compensation_cache.hits, "gravity_compensation/cache_hits");
 
     // Gripper IO
     GripperIOInterface = AddInterfaceRequired("GripperIO");
@@ -142,11 +146,16 @@ void mtsIntuitiveResearchKitMTM::Init(void)
     m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitMTM::lock_orientation, this, "lock_orientation");
     m_arm_interface->AddCommandVoid(&mtsIntuitiveResearchKitMTM::unlock_orientation, this, "unlock_orientation");
     m_arm_interface->AddEventWrite(mtm_events.orientation_locked, "orientation_locked", false);
+    m_arm_interface->AddCommandWrite(&mtsIntuitiveResearchKitMTM::align_cp, this, "align_cp");
 
     // Gripper
     m_arm_interface->AddCommandReadState(this->StateTable, m_gripper_measured_js, "gripper/measured_js");
     m_arm_interface->AddEventVoid(gripper_events.pinch, "gripper/pinch");
     m_arm_interface->AddEventWrite(gripper_events.closed, "gripper/closed", true);
+
+    // Gravity compensation
+    m_arm_interface->AddCommandReadState(this->StateTable, m_gravity_compensation_cache.hits,
+                                         "gravity_compensation/cache_hits");
 }
 
 void mtsIntuitiveResearchKitMTM::PreConfigure(const Json::Value & jsonConfig,
@@ -162,12 +171,31 @@ void mtsIntuitiveResearchKitMTM::PreConfigure(const Json::Value & jsonConfig,
                                      << " can't find gravity-compensation file \""
                                      << jsonGC.asString() << "\" defined in \""
                                      << filename << "\"" << std::endl;
-            exit(EXIT_FAILURE);
+            ConfigurationFailure();
         } else {
             ConfigureGC(fileGC);
         }
     }
 
+    // gravity compensation cache, tolerance and error in radians
+    const auto jsonGCCache = jsonConfig["gravity-compensation-cache"];
+    if (!jsonGCCache.isNull()) {
+        const auto tolerance = jsonGCCache.get("tolerance", 0.0).asDouble();
+        const auto maxError = jsonGCCache.get("max-error", 0.0).asDouble();
+        if ((tolerance < 0.0) || (maxError < 0.0)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
+                                     << " gravity-compensation-cache tolerance and max-error must be positive, found: "
+                                     << tolerance << " and " << maxError << std::endl;
+            ConfigurationFailure();
+        }
+        m_gravity_compensation_cache.tolerance = tolerance;
+        m_gravity_compensation_cache.max_error = maxError;
+    }
+    if (GravityCompensationMTM) {
+        GravityCompensationMTM->SetCacheTolerance(m_gravity_compensation_cache.tolerance);
+        GravityCompensationMTM->SetIncrementalMaxError(m_gravity_compensation_cache.max_error);
+    }
+
     // platform gain
     const auto jsonPlatformGain = jsonConfig["platform-gain"];
     if (!jsonPlatformGain.isNull()) {
@@ -176,7 +204,7 @@ void mtsIntuitiveResearchKitMTM::PreConfigure(const Json::Value & jsonConfig,
             CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
                                      << " platform-gain must be between 0 and 1, found: "
                                      << gain << std::endl;
-            exit(EXIT_FAILURE);
+            ConfigurationFailure();
         } else {
             m_platform_gain = gain;
         }
@@ -203,7 +231,7 @@ void mtsIntuitiveResearchKitMTM::PreConfigure(const Json::Value & jsonConfig,
             CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
                                      << " kinematic-type \"" << kinematicType << "\" is not valid.  Valid options are: "
                                      << allOptions << std::endl;
-            exit(EXIT_FAILURE);
+            ConfigurationFailure();
         }
     }
 }
@@ -211,16 +239,14 @@ void mtsIntuitiveResearchKitMTM::PreConfigure(const Json::Value & jsonConfig,
 void mtsIntuitiveResearchKitMTM::ConfigureGC(const std::string & filename)
 {
     try {
-        std::ifstream jsonStream;
         Json::Value jsonConfig;
-        Json::Reader jsonReader;
 
-        jsonStream.open(filename.c_str());
-        if (!jsonReader.parse(jsonStream, jsonConfig)) {
+        std::string jsonErrors;
+        if (!mtsIntuitiveResearchKitConfigCache::Parse(filename, jsonConfig, jsonErrors)) {
             CMN_LOG_CLASS_INIT_ERROR << "ConfigureGC " << this->GetName()
                                      << ": failed to parse gravity compensation (GC) configuration file \""
                                      << filename << "\"\n"
-                                     << jsonReader.getFormattedErrorMessages();
+                                     << jsonErrors;
             return;
         }
 
@@ -236,7 +262,7 @@ void mtsIntuitiveResearchKitMTM::ConfigureGC(const std::string & filename)
                 CMN_LOG_CLASS_INIT_ERROR << "ConfigureGC " << this->GetName()
                                          << ": failed to create an instance of robGravityCompensationMTM with \""
                                          << filename << "\" because " << result.ErrorMessage << std::endl;
-                exit(EXIT_FAILURE);
+                ConfigurationFailure();
             }
             GravityCompensationMTM = result.Pointer;
             if (!result.ErrorMessage.empty()) {
@@ -245,6 +271,8 @@ void mtsIntuitiveResearchKitMTM::ConfigureGC(const std::string & filename)
                                            << filename << "\" warns " << result.ErrorMessage << std::endl;
             }
         }
+    } catch (ConfigurationError &) {
+        throw;
     } catch (...) {
         CMN_LOG_CLASS_INIT_ERROR << "ConfigureGC " << this->GetName() << ": make sure the file \""
                                  << filename << "\" is in JSON format" << std::endl;
@@ -288,9 +316,9 @@ void mtsIntuitiveResearchKitMTM::CreateManipulator(void)
     }
 
     if (mKinematicType == MTM_ITERATIVE) {
-        Manipulator = new robManipulator();
+        Manipulator = new robManipulatorFixed<7>();
     } else {
-        Manipulator = new robManipulatorMTM();
+        Manipulator = new robManipulatorFixed<7, robManipulatorMTM>();
     }
 }
 
@@ -531,28 +559,78 @@ void mtsIntuitiveResearchKitMTM::GetRobotData(void)
 
 void mtsIntuitiveResearchKitMTM::control_servo_cf_orientation_locked(void)
 {
-    // don't get current joint values!
-    // always initialize IK from position when locked
-    vctDoubleVec jointSet(mEffortOrientationJoint);
-    // compute desired position from current position and locked orientation
-    CartesianPositionFrm.Translation().Assign(m_local_measured_cp_frame.Translation());
-    CartesianPositionFrm.Rotation().From(mEffortOrientation);
-    // important note, lock uses numerical IK as it finds a solution close to current position
-    if (Manipulator->InverseKinematics(jointSet, CartesianPositionFrm) == robManipulator::ESUCCESS) {
+    vctDoubleVec & jointSet = m_orientation_lock.joints;
+    if (!(m_orientation_lock.warm && orientation_locked_incremental_step())) {
+        // don't get current joint values!
+        // always initialize IK from position when locked
+        jointSet.Assign(mEffortOrientationJoint);
+        // compute desired position from current position and locked orientation
+        CartesianPositionFrm.Translation().Assign(m_local_measured_cp_frame.Translation());
+        CartesianPositionFrm.Rotation().From(mEffortOrientation);
+        // important note, lock uses numerical IK as it finds a solution close to current position
+        if (Manipulator->InverseKinematics(jointSet, CartesianPositionFrm) != robManipulator::ESUCCESS) {
+            m_orientation_lock.warm = false;
+            m_arm_interface->SendWarning(this->GetName() + ": unable to solve inverse kinematics in control_servo_cf_orientation_locked");
+            return;
+        }
         // find closest solution mod 2 pi
         const double difference = m_pid_measured_js.Position()[JNT_WRIST_ROLL] - jointSet[JNT_WRIST_ROLL];
         const double differenceInTurns = nearbyint(difference / (2.0 * cmnPI));
         jointSet[JNT_WRIST_ROLL] = jointSet[JNT_WRIST_ROLL] + differenceInTurns * 2.0 * cmnPI;
-        // initialize trajectory
-        m_trajectory_j.goal.Ref(NumberOfJointsKinematics()).Assign(jointSet);
-        m_trajectory_j.Reflexxes.Evaluate(m_servo_jp,
-                                          m_servo_jv,
-                                          m_trajectory_j.goal,
-                                          m_trajectory_j.goal_v);
-        servo_jp_internal(m_servo_jp);
-    } else {
-        m_arm_interface->SendWarning(this->GetName() + ": unable to solve inverse kinematics in control_servo_cf_orientation_locked");
+        m_orientation_lock.warm = true;
     }
+    // initialize trajectory
+    m_trajectory_j.goal.Ref(NumberOfJointsKinematics()).Assign(jointSet);
+    m_trajectory_j.Reflexxes.Evaluate(m_servo_jp,
+                                      m_servo_jv,
+                                      m_trajectory_j.goal,
+                                      m_trajectory_j.goal_v);
+    servo_jp_internal(m_servo_jp);
+}
+
+bool mtsIntuitiveResearchKitMTM::orientation_locked_incremental_step(void)
+{
+    // jacobian is computed in GetRobotData when in cartesian effort mode
+    if (m_spatial_jacobian.cols() < NumberOfJointsKinematics()) {
+        return false;
+    }
+    vctDoubleVec & q = m_orientation_lock.joints;
+    // first 3 joints are in effort mode, only wrist orientation matters
+    q.Ref(3, 0).Assign(m_kin_measured_js.Position().Ref(3, 0));
+    m_kinematics->evaluator.Evaluate(*Manipulator, q, m_orientation_lock.pose);
+
+    // orientation error in base frame
+    const vctMatRot3 current(m_orientation_lock.pose.Rotation(), VCT_NORMALIZE);
+    const vctAxAnRot3 error(mEffortOrientation * current.Inverse(), VCT_NORMALIZE);
+    if (error.Angle() > mtsIntuitiveResearchKit::MTMOrientationLock::IncrementalMaxError) {
+        return false;
+    }
+    const vct3 e(error.Axis() * error.Angle());
+
+    // angular part of the spatial jacobian for the wrist joints.
+    // jacobian is computed with the measured positions, wrist joints
+    // are in position mode so close enough to q
+    vct3 a, b, c;
+    for (size_t row = 0; row < 3; ++row) {
+        a[row] = m_spatial_jacobian.Element(row + 3, 4);
+        b[row] = m_spatial_jacobian.Element(row + 3, 5);
+        c[row] = m_spatial_jacobian.Element(row + 3, 6);
+    }
+
+    // solve 3x3 system using Cramer's rule, axes are unit vectors so
+    // the determinant is in [-1, 1]
+    vct3 bc, ec, be;
+    bc.CrossProductOf(b, c);
+    const double determinant = a.DotProduct(bc);
+    if (std::abs(determinant) < mtsIntuitiveResearchKit::MTMOrientationLock::IncrementalMinDeterminant) {
+        return false;
+    }
+    ec.CrossProductOf(e, c);
+    be.CrossProductOf(b, e);
+    q[4] += e.DotProduct(bc) / determinant;
+    q[5] += a.DotProduct(ec) / determinant;
+    q[6] += a.DotProduct(be) / determinant;
+    return true;
 }
 
 void mtsIntuitiveResearchKitMTM::SetControlEffortActiveJoints(void)
@@ -572,7 +650,7 @@ void mtsIntuitiveResearchKitMTM::SetControlEffortActiveJoints(void)
 }
 
 void mtsIntuitiveResearchKitMTM::control_servo_cf_preload(vctDoubleVec & effortPreload,
-                                                          vctDoubleVec & wrenchPreload)
+                                                          vct6 & wrenchPreload)
 {
     // not handling this yet
     if (m_cf_type == WRENCH_SPATIAL) {
@@ -633,14 +711,12 @@ void mtsIntuitiveResearchKitMTM::lock_orientation(const vctMatRot3 & orientation
     // if we just started lock
     if (!m_effort_orientation_locked) {
         m_effort_orientation_locked = true;
+        m_orientation_lock.warm = false;
         SetControlEffortActiveJoints();
         // initialize trajectory
         m_servo_jp.Assign(m_pid_measured_js.Position(), NumberOfJoints());
         m_servo_jv.Assign(m_pid_measured_js.Velocity(), NumberOfJoints());
-        m_trajectory_j.Reflexxes.Set(m_trajectory_j.v,
-                                     m_trajectory_j.a,
-                                     StateTable.PeriodStats.PeriodAvg(),
-                                     robReflexxes::Reflexxes_TIME);
+        trajectory_j_warm_reflexxes();
     }
     // in any case, update desired orientation in local coordinate system
     // mEffortOrientation.Assign(m_base_frame.Rotation().Inverse() * orientation);
@@ -662,11 +738,103 @@ void mtsIntuitiveResearchKitMTM::unlock_orientation(void)
 }
 
 
+void mtsIntuitiveResearchKitMTM::align_cp(const prmPositionCartesianSet & goal)
+{
+    if (!ArmIsReady("align_cp", mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE)) {
+        return;
+    }
+
+    // start from current setpoint if not already aligning
+    if ((m_control_space != mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE)
+        || (m_control_mode != mtsIntuitiveResearchKitArmTypes::USER_MODE)) {
+        SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE,
+                               mtsIntuitiveResearchKitArmTypes::USER_MODE,
+                               &mtsIntuitiveResearchKitMTM::control_align_cp, this);
+        // space change might have been refused
+        if (m_control_space != mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE) {
+            return;
+        }
+        // user mode doesn't configure the PID, same as position mode
+        PID.EnableTrackingError(UsePIDTrackingError());
+        PID.EnableTorqueMode(vctBoolVec(NumberOfJoints(), false));
+        m_effort_orientation_locked = false;
+        m_servo_jp.Assign(m_pid_setpoint_js.Position(), NumberOfJoints());
+        m_align.cp.From(m_local_setpoint_cp_frame);
+        m_align.jp.ForceAssign(m_kin_setpoint_js.Position());
+        m_align.v_linear = 0.0;
+        m_align.v_angular = 0.0;
+        m_align.time = StateTable.GetTic();
+    }
+
+    // compute goal in arm's base frame
+    CartesianPositionFrm.From(goal.Goal());
+    CartesianPositionFrm = m_base_frame.Inverse() * CartesianPositionFrm;
+    m_align.goal.From(CartesianPositionFrm);
+}
+
+namespace {
+    // speed along the remaining distance, accelerate up to the
+    // maximum velocity and decelerate to stop at the goal
+    double AlignSpeed(const double speed, const double distance,
+                      const double velocity, const double acceleration,
+                      const double dt)
+    {
+        return std::min(std::min(speed + acceleration * dt, velocity),
+                        std::sqrt(2.0 * acceleration * distance));
+    }
+}
+
+void mtsIntuitiveResearchKitMTM::control_align_cp(void)
+{
+    const double now = StateTable.GetTic();
+    // don't jump after a long period without control
+    const double dt = std::min(now - m_align.time, 10.0 * cmn_ms);
+    m_align.time = now;
+    if (dt <= 0.0) {
+        return;
+    }
+
+    // translation, straight line toward goal
+    vctFrm3 & cp = m_align.cp;
+    const vct3 linear(m_align.goal.Translation() - cp.Translation());
+    const double distance = linear.Norm();
+    m_align.v_linear = AlignSpeed(m_align.v_linear, distance,
+                                  m_trajectory_j.ratio_v * m_trajectory_c.v_linear,
+                                  m_trajectory_j.ratio_a * m_trajectory_c.a_linear,
+                                  dt);
+    if (distance > 0.0) {
+        const double step = std::min(distance, m_align.v_linear * dt);
+        cp.Translation().Add(linear * (step / distance));
+    }
+
+    // rotation along the axis between current and goal
+    const vctAxAnRot3 delta(cp.Rotation().Inverse() * m_align.goal.Rotation(), VCT_NORMALIZE);
+    m_align.v_angular = AlignSpeed(m_align.v_angular, delta.Angle(),
+                                   m_trajectory_j.ratio_v * m_trajectory_c.v_angular,
+                                   m_trajectory_j.ratio_a * m_trajectory_c.a_angular,
+                                   dt);
+    if (delta.Angle() > 0.0) {
+        const double step = std::min(delta.Angle(), m_align.v_angular * dt);
+        const vctMatRot3 start(cp.Rotation());
+        cp.Rotation().ProductOf(start, vctMatRot3(vctAxAnRot3(delta.Axis(), step), VCT_NORMALIZE));
+        cp.Rotation().NormalizedSelf();
+    }
+
+    // warm start from previous solution
+    CartesianPositionFrm.From(cp);
+    if (this->InverseKinematics(m_align.jp, CartesianPositionFrm) == robManipulator::ESUCCESS) {
+        servo_jp_internal(m_align.jp);
+    } else {
+        m_messages.Send(m_message_sites.servo_cp_ik, now);
+    }
+}
+
 void mtsIntuitiveResearchKitMTM::control_add_gravity_compensation(vctDoubleVec & efforts)
 {
     if (GravityCompensationMTM) {
         GravityCompensationMTM->AddGravityCompensationEfforts(m_kin_measured_js.Position(),
                                                               m_kin_measured_js.Velocity(),
                                                               efforts);
+        m_gravity_compensation_cache.hits = GravityCompensationMTM->CacheHits();
     }
 }
@@ -0,0 +1,191 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <chrono>
+#include <sstream>
+
+#include <cisstCommon/cmnLogger.h>
+#include <cisstMultiTask/mtsInterfaceProvided.h>
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitMessages.h>
+
+mtsIntuitiveResearchKitMessages::mtsIntuitiveResearchKitMessages(void):
+    m_queue(QUEUE_SIZE),
+    m_head(0),
+    m_tail(0),
+    m_dropped(0),
+    m_pending(false),
+    m_stop(false)
+{
+}
+
+mtsIntuitiveResearchKitMessages::~mtsIntuitiveResearchKitMessages()
+{
+    Stop();
+}
+
+size_t mtsIntuitiveResearchKitMessages::AddSite(const LevelType level,
+                                                const std::string & text,
+                                                const double period)
+{
+    SiteType site;
+    site.level = level;
+    site.text = text;
+    site.period = period;
+    site.last_sent = -1.0e9;
+    site.count = 0;
+    site.total = 0;
+    m_sites.push_back(site);
+    return m_sites.size() - 1;
+}
+
+void mtsIntuitiveResearchKitMessages::Start(const std::string & name)
+{
+    m_name = name;
+    if (!m_thread.joinable()) {
+        m_stop = false;
+        m_thread = std::thread(&mtsIntuitiveResearchKitMessages::FormattingThread, this);
+    }
+}
+
+void mtsIntuitiveResearchKitMessages::Stop(void)
+{
+    if (m_thread.joinable()) {
+        m_stop = true;
+        m_thread.join();
+    }
+}
+
+void mtsIntuitiveResearchKitMessages::SendInternal(const size_t site, const double time,
+                                                   const bool hasValue, const double value)
+{
+    SiteType & data = m_sites[site];
+    data.count++;
+    data.total++;
+    if ((time - data.last_sent) < data.period) {
+        return;
+    }
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if ((head - m_tail.load(std::memory_order_acquire)) >= QUEUE_SIZE) {
+        // try again next occurrence
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    EntryType & entry = m_queue[head % QUEUE_SIZE];
+    entry.site = site;
+    entry.count = data.count;
+    entry.time = time;
+    entry.has_value = hasValue;
+    entry.value = value;
+    m_head.store(head + 1, std::memory_order_release);
+    data.last_sent = time;
+    data.count = 0;
+}
+
+void mtsIntuitiveResearchKitMessages::FormattingThread(void)
+{
+    std::vector<MessageType> formatted;
+    size_t lastDropped = 0;
+    while (!m_stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        const size_t head = m_head.load(std::memory_order_acquire);
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (head == tail) {
+            continue;
+        }
+        for (; tail != head; ++tail) {
+            const EntryType & entry = m_queue[tail % QUEUE_SIZE];
+            const SiteType & site = m_sites[entry.site];
+            std::stringstream text;
+            text << m_name << ": " << site.text;
+            if (entry.has_value) {
+                text << " (" << entry.value << ")";
+            }
+            if (entry.count > 1) {
+                text << " (" << entry.count << " times)";
+            }
+            MessageType message;
+            message.level = site.level;
+            message.text = text.str();
+            switch (site.level) {
+            case LEVEL_ERROR:
+                CMN_LOG_RUN_ERROR << message.text << std::endl;
+                break;
+            case LEVEL_WARNING:
+                CMN_LOG_RUN_WARNING << message.text << std::endl;
+                break;
+            default:
+                CMN_LOG_RUN_VERBOSE << message.text << std::endl;
+                break;
+            }
+            formatted.push_back(message);
+        }
+        m_tail.store(tail, std::memory_order_release);
+
+        const size_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != lastDropped) {
+            CMN_LOG_RUN_WARNING << m_name << ": " << (dropped - lastDropped)
+                                << " message(s) dropped, queue full" << std::endl;
+            lastDropped = dropped;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_formatted.insert(m_formatted.end(), formatted.begin(), formatted.end());
+        formatted.clear();
+        m_pending = true;
+    }
+}
+
+void mtsIntuitiveResearchKitMessages::Dispatch(const SenderType & sender)
+{
+    if (!m_pending.load(std::memory_order_acquire)) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return;
+        }
+        m_dispatching.swap(m_formatted);
+        m_pending = false;
+    }
+    for (const auto & message : m_dispatching) {
+        sender(message.level, message.text);
+    }
+    m_dispatching.clear();
+}
+
+void mtsIntuitiveResearchKitMessages::Dispatch(mtsInterfaceProvided * interfaceProvided)
+{
+    if (!m_pending.load(std::memory_order_acquire)) {
+        return;
+    }
+    Dispatch([interfaceProvided](const LevelType level, const std::string & text) {
+            switch (level) {
+            case LEVEL_ERROR:
+                interfaceProvided->SendError(text);
+                break;
+            case LEVEL_WARNING:
+                interfaceProvided->SendWarning(text);
+                break;
+            default:
+                interfaceProvided->SendStatus(text);
+                break;
+            }
+        });
+}
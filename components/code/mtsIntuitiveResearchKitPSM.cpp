@@ -19,11 +19,18 @@ http://www.cisst.org/cisst/license.txt.
 // system include
 #include <iostream>
 #include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
 
 // cisst
 #include <sawIntuitiveResearchKit/robManipulatorPSMSnake.h>
+#include <sawIntuitiveResearchKit/robManipulatorPSM.h>
+#include <sawIntuitiveResearchKit/robManipulatorFixed.h>
 
 #include <cisstCommon/cmnPath.h>
+#include <cisstNumerical/nmrIsOrthonormal.h>
 #include <cisstMultiTask/mtsInterfaceProvided.h>
 #include <cisstMultiTask/mtsInterfaceRequired.h>
 #include <cisstParameterTypes/prmEventButton.h>
@@ -31,6 +38,7 @@ http://www.cisst.org/cisst/license.txt.
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitRevision.h>
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitConfig.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitPSM.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
 
 CMN_IMPLEMENT_SERVICES_DERIVED_ONEARG(mtsIntuitiveResearchKitPSM, mtsTaskPeriodic, mtsTaskPeriodicConstructorArg);
 
@@ -96,11 +104,15 @@ void mtsIntuitiveResearchKitPSM::PostConfigure(const Json::Value & jsonConfig,
                                      << " using file \"" << filename << "\" can't find tool index file \""
                                      << toolIndexFile << "\" in path: "
                                      << configPath << std::endl;
-            exit(EXIT_FAILURE);
+            ConfigurationFailure();
         }
         load_tool_list(configPath, toolIndexFile);
     }
 
+    // parse all tool definitions now so tool changes don't require
+    // any file I/O
+    mToolList.LoadDefinitions(ToolPath());
+
     // tool detection
     const auto jsonToolDetection = jsonConfig["tool-detection"];
     if (!jsonToolDetection.isNull()) {
@@ -117,23 +129,135 @@ void mtsIntuitiveResearchKitPSM::PostConfigure(const Json::Value & jsonConfig,
                                              << ", \"" << fixedTool << "\" found in file \""
                                              << filename << "\" is not a supported type." << std::endl
                                              << "Supported tool types are:\n" << mToolList.PossibleNames("\n") << std::endl;
-                    exit(EXIT_FAILURE);
+                    ConfigurationFailure();
                 }
                 // now look for the file to configure the tool
-                mToolConfigured = ConfigureTool(mToolList.File(mToolIndex));
+                mToolConfigured = ConfigureTool(mToolIndex);
                 if (!mToolConfigured) {
-                    exit(EXIT_FAILURE);
+                    ConfigurationFailure();
                 }
             } else {
                 CMN_LOG_CLASS_INIT_ERROR << "PostConfigure: " << this->GetName()
                                          << " can't find field \"tool\" in file \""
                                          << filename << "\" which is required since \"tool-detection\" is set to \"FIXED\"" << std::endl;
-                exit(EXIT_FAILURE);
+                ConfigurationFailure();
             }
         }
     } else {
         mToolDetection = mtsIntuitiveResearchKitToolTypes::AUTOMATIC;
     }
+
+    // compliance and backlash compensation, file can contain multiple arms
+    const auto jsonCompensation = jsonConfig["compensation"];
+    if (!jsonCompensation.isNull()) {
+        // don't compensate twice
+        const auto jsonJointFilters = jsonConfig["joint-filters"];
+        for (unsigned int index = 0; index < jsonJointFilters.size(); ++index) {
+            if (jsonJointFilters[index].get("type", "").asString() == "psm-compensation") {
+                CMN_LOG_CLASS_INIT_ERROR << "PostConfigure: " << this->GetName()
+                                         << " using file \"" << filename << "\" can't use both \"compensation\" and a \"psm-compensation\" joint filter" << std::endl;
+                ConfigurationFailure();
+            }
+        }
+        const auto compensationFile = jsonCompensation.asString();
+        const auto fullname = configPath.Find(compensationFile);
+        Json::Value jsonCompensationConfig;
+        std::string errorMessage;
+        if ((fullname == "")
+            || !mtsIntuitiveResearchKitConfigCache::Parse(fullname, jsonCompensationConfig, errorMessage)) {
+            CMN_LOG_CLASS_INIT_ERROR << "PostConfigure: " << this->GetName()
+                                     << " using file \"" << filename << "\" can't find or parse compensation file \""
+                                     << compensationFile << "\" in path: "
+                                     << configPath << std::endl
+                                     << errorMessage << std::endl;
+            ConfigurationFailure();
+        }
+        robPSMCompensation compensation;
+        if (!compensation.Configure(jsonCompensationConfig, errorMessage)) {
+            CMN_LOG_CLASS_INIT_ERROR << "PostConfigure: " << this->GetName()
+                                     << ", invalid compensation file \"" << fullname << "\": "
+                                     << errorMessage << std::endl;
+            ConfigurationFailure();
+        }
+        const robPSMCompensation::ParametersType * parameters = compensation.Find(this->GetName());
+        if (!parameters) {
+            CMN_LOG_CLASS_INIT_ERROR << "PostConfigure: " << this->GetName()
+                                     << ", can't find parameters for this arm in compensation file \""
+                                     << fullname << "\"" << std::endl;
+            ConfigurationFailure();
+        }
+        m_compensation.parameters = *parameters;
+        m_compensation.enabled = true;
+    }
+
+    // early detection of adapter/tool engagement
+    const auto jsonEngageDetection = jsonConfig["engage-detection"];
+    if (!jsonEngageDetection.isNull()) {
+        m_engage_detection.enabled = jsonEngageDetection.get("enabled", true).asBool();
+        const auto jsonTrackingError = jsonEngageDetection["tracking-error"];
+        if (!jsonTrackingError.isNull()) {
+            m_engage_detection.tracking_error = jsonTrackingError.asDouble();
+        }
+        if (m_engage_detection.tracking_error <= 0.0) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
+                                     << ", \"engage-detection\": \"tracking-error\" must be positive" << std::endl;
+            ConfigurationFailure();
+        }
+    }
+
+    // reject goals out of reach before inverse kinematics
+    const auto jsonReachability = jsonConfig["reachability-map"];
+    if (!jsonReachability.isNull()) {
+        m_reachability.enabled = jsonReachability.get("enabled", true).asBool();
+        m_reachability.resolution = jsonReachability.get("resolution", m_reachability.resolution).asDouble();
+        if ((m_reachability.resolution <= 0.0) || (m_reachability.resolution > 10.0 * cmnPI_180)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: " << this->GetName()
+                                     << ", \"reachability-map\": \"resolution\" must be positive and lower than 10 degrees" << std::endl;
+            ConfigurationFailure();
+        }
+    }
+
+    // bounded inverse kinematics for snake like tools
+    const auto jsonSnakeIK = jsonConfig["snake-inverse-kinematics"];
+    if (!jsonSnakeIK.isNull()) {
+        const auto jsonBounded = jsonSnakeIK["bounded"];
+        if (!jsonBounded.isNull()) {
+            m_snake_ik.bounded = jsonBounded.asBool();
+        }
+        const auto jsonMaxIterations = jsonSnakeIK["max-iterations"];
+        if (!jsonMaxIterations.isNull()) {
+            m_snake_ik.max_iterations = jsonMaxIterations.asUInt();
+        }
+        const auto jsonMaxTime = jsonSnakeIK["max-time"];
+        if (!jsonMaxTime.isNull()) {
+            m_snake_ik.max_time = jsonMaxTime.asDouble();
+        }
+        const auto jsonMaxResidual = jsonSnakeIK["max-residual"];
+        if (!jsonMaxResidual.isNull()) {
+            m_snake_ik.max_residual = jsonMaxResidual.asDouble();
+        }
+    }
+}
+
+cmnPath mtsIntuitiveResearchKitPSM::ToolPath(void) const
+{
+    // construct path using working directory and share/arm
+    cmnPath path(cmnPath::GetWorkingDirectory());
+    // find the file in tool
+    path.Add(std::string(sawIntuitiveResearchKit_SOURCE_DIR) + "/../share/tool", cmnPath::TAIL);
+    // find file if specified as share/<system>/...
+    path.Add(std::string(sawIntuitiveResearchKit_SOURCE_DIR) + "/../share", cmnPath::TAIL);
+    return path;
+}
+
+bool mtsIntuitiveResearchKitPSM::ConfigureTool(const size_t & index)
+{
+    // use pre-parsed definition if available, no file I/O
+    if (mToolList.HasDefinition(index)) {
+        return ConfigureTool(mToolList.Definition(index),
+                             mToolList.DefinitionFile(index));
+    }
+    return ConfigureTool(mToolList.File(index));
 }
 
 bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
@@ -144,13 +268,7 @@ bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
     if (cmnPath::Exists(filename)) {
         fullFilename = filename;
     } else {
-        // construct path using working directory and share/arm
-        cmnPath path(cmnPath::GetWorkingDirectory());
-        // find the file in tool
-        path.Add(std::string(sawIntuitiveResearchKit_SOURCE_DIR) + "/../share/tool", cmnPath::TAIL);
-        // find file if specified as share/<system>/...
-        path.Add(std::string(sawIntuitiveResearchKit_SOURCE_DIR) + "/../share", cmnPath::TAIL);
-        fullFilename = path.Find(filename);
+        fullFilename = ToolPath().Find(filename);
         // still not found, try to add suffix to search again
         if (fullFilename == "") {
             CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
@@ -160,80 +278,130 @@ bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
         }
     }
 
-    try {
-        std::ifstream jsonStream;
-        Json::Value jsonConfig;
-        Json::Reader jsonReader;
+    Json::Value jsonConfig;
+    std::string jsonErrors;
+    if (!mtsIntuitiveResearchKitConfigCache::Parse(fullFilename, jsonConfig, jsonErrors)) {
+        CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
+                                 << ": failed to parse configuration file \""
+                                 << fullFilename << "\"\n"
+                                 << jsonErrors;
+        return false;
+    }
 
-        jsonStream.open(fullFilename.c_str());
-        if (!jsonReader.parse(jsonStream, jsonConfig)) {
-            CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
-                                     << ": failed to parse configuration file \""
-                                     << fullFilename << "\"\n"
-                                     << jsonReader.getFormattedErrorMessages();
-            return false;
-        }
+    return ConfigureTool(jsonConfig, fullFilename);
+}
+
+bool mtsIntuitiveResearchKitPSM::ConfigureTool(const Json::Value & jsonConfig,
+                                               const std::string & fullFilename)
+{
+    CMN_ASSERT(Manipulator);
+    ToolPreparationType tool;
+    if (!PrepareTool(jsonConfig, fullFilename, Manipulator->Rtw0, tool)) {
+        return false;
+    }
+    ApplyTool(tool);
+    DisposeTool(tool);
+    return true;
+}
 
+bool mtsIntuitiveResearchKitPSM::PrepareTool(const Json::Value & jsonConfig,
+                                             const std::string & fullFilename,
+                                             const vctFrm4x4 & Rtw0,
+                                             ToolPreparationType & tool) const
+{
+    try {
         CMN_LOG_CLASS_INIT_VERBOSE << "Configure: " << this->GetName()
                                    << " using file \"" << fullFilename << "\"" << std::endl
                                    << "----> content of configuration file: " << std::endl
                                    << jsonConfig << std::endl
                                    << "<----" << std::endl;
 
-        mSnakeLike = false;
+        tool.snake_like = false;
         const Json::Value snakeLike = jsonConfig["snake-like"];
         if (!snakeLike.isNull()) {
-            mSnakeLike = snakeLike.asBool();
+            tool.snake_like = snakeLike.asBool();
         }
 
-        // snake require the derived manipulator class so we might
-        // have to delete create manipulator
-
-        // preserve Rtw0 just in case we need to create a new instance
-        // of robManipulator
-        CMN_ASSERT(Manipulator);
-        vctFrm4x4 oldRtw0 = Manipulator->Rtw0;
-        bool newInstance = false;
-
-        if (mSnakeLike) {
-            // maybe we already have it?
-            if (!dynamic_cast<robManipulatorPSMSnake *>(this->Manipulator)) {
-                delete this->Manipulator;
-                this->Manipulator = new robManipulatorPSMSnake();
-                newInstance = true;
-            }
-        } else {
-            // make sure we have the base robManipulator class
-            if (dynamic_cast<robManipulatorPSMSnake *>(this->Manipulator)) {
-                delete this->Manipulator;
-                this->Manipulator = new robManipulator();
-                newInstance = true;
+        // which IK to use, closed form is only available for non snake tools
+        tool.kinematic_type = PSM_ITERATIVE;
+        const Json::Value jsonKinematic = jsonConfig["kinematic-type"];
+        if (!jsonKinematic.isNull()) {
+            const std::string kinematicType = jsonKinematic.asString();
+            if (kinematicType == "CLOSED") {
+                if (tool.snake_like) {
+                    CMN_LOG_CLASS_INIT_WARNING << "ConfigureTool " << this->GetName()
+                                               << ": kinematic-type \"CLOSED\" is not supported for snake like tools, using \"ITERATIVE\" for \""
+                                               << fullFilename << "\"" << std::endl;
+                } else {
+                    tool.kinematic_type = PSM_CLOSED;
+                }
+            } else if (kinematicType != "ITERATIVE") {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
+                                         << ": kinematic-type \"" << kinematicType
+                                         << "\" is not valid.  Valid options are: ITERATIVE, CLOSED" << std::endl;
+                return false;
             }
         }
 
-        // configure new instance and restore Rtw0 in case user have
-        // overriden the content of config file
-        if (newInstance) {
-            ConfigureDH(mConfigurationFile);
-            Manipulator->Rtw0.Assign(oldRtw0);
+        // snake require the derived manipulator class, always use a
+        // new instance so the current one can be used until the tool
+        // is applied
+        if (tool.snake_like) {
+            tool.manipulator = new robManipulatorFixed<8, robManipulatorPSMSnake>();
+        } else if (tool.kinematic_type == PSM_CLOSED) {
+            // fixed size with closed form inverse kinematics
+            tool.manipulator = new robManipulatorFixed<6, robManipulatorPSM>();
+        } else {
+            // fixed size, 6 joints, robManipulator class
+            tool.manipulator = new robManipulatorFixed<6>();
         }
 
-        // remove tool tip offset
-        Manipulator->DeleteTools();
-        // in any case, we just need the first 3 links
-        Manipulator->Truncate(3);
+        // base arm kinematics, we just need the first 3 links.  Rtw0
+        // is preserved in case user have overriden the content of
+        // config file
+        if (tool.manipulator->LoadRobot(mConfigurationDH["DH"]) != robManipulator::ESUCCESS) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
+                                     << ": failed to load \"DH\" parameters from file \""
+                                     << mConfigurationFile << "\", error is "
+                                     << tool.manipulator->LastError() << std::endl;
+            return false;
+        }
+        tool.manipulator->Truncate(3);
+        tool.manipulator->Rtw0.Assign(Rtw0);
 
         // now configure the links specific to the tool
-        ConfigureDH(jsonConfig, fullFilename);
+        const Json::Value jsonBase = jsonConfig["base-offset"];
+        if (!jsonBase.isNull()) {
+            cmnDataJSON<vctFrm4x4>::DeSerializeText(tool.manipulator->Rtw0, jsonBase);
+            if (!nmrIsOrthonormal(tool.manipulator->Rtw0.Rotation())) {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
+                                         << ": the base offset rotation doesn't seem to be orthonormal in \""
+                                         << fullFilename << "\"" << std::endl;
+                return false;
+            }
+        }
+        const Json::Value jsonDH = jsonConfig["DH"];
+        if (jsonDH.isNull()) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
+                                     << ": can find \"DH\" data in \"" << fullFilename << "\"" << std::endl;
+            return false;
+        }
+        if (tool.manipulator->LoadRobot(jsonDH) != robManipulator::ESUCCESS) {
+            CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
+                                     << ": failed to load \"DH\" parameters from file \""
+                                     << fullFilename << "\", error is "
+                                     << tool.manipulator->LastError() << std::endl;
+            return false;
+        }
 
         // check that the kinematic chain length makes sense
         size_t expectedNumberOfJoint;
-        if (mSnakeLike) {
+        if (tool.snake_like) {
             expectedNumberOfJoint = 8;
         } else {
             expectedNumberOfJoint = 6;
         }
-        size_t numberOfJointsLoaded = this->Manipulator->links.size();
+        size_t numberOfJointsLoaded = tool.manipulator->links.size();
 
         if (expectedNumberOfJoint != numberOfJointsLoaded) {
             CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
@@ -249,23 +417,32 @@ bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
             CMN_LOG_CLASS_INIT_WARNING << "ConfigureTool " << this->GetName()
                                        << ": can find \"tooltip-offset\" data in \"" << fullFilename << "\"" << std::endl;
         } else {
-            cmnDataJSON<vctFrm4x4>::DeSerializeText(ToolOffsetTransformation, jsonToolTip);
-            ToolOffset = new robManipulator(ToolOffsetTransformation);
-            Manipulator->Attach(ToolOffset);
+            cmnDataJSON<vctFrm4x4>::DeSerializeText(tool.tool_offset_transformation, jsonToolTip);
+            tool.tool_offset = new robManipulator(tool.tool_offset_transformation);
+            tool.manipulator->Attach(tool.tool_offset);
         }
 
+        // reachability map, uses tool tip so needs to be built after the tool offset
+        if (m_reachability.enabled) {
+            std::string errorMessage;
+            if (!tool.reachability.Build(*(tool.manipulator), m_reachability.resolution, errorMessage)) {
+                CMN_LOG_CLASS_INIT_WARNING << "ConfigureTool " << this->GetName()
+                                           << ": failed to build reachability map for \""
+                                           << fullFilename << "\", " << errorMessage << std::endl;
+            }
+        }
+
+        // everything sized by the number of joints, configured
+        // evaluator and estimator
+        tool.kinematics = new KinematicsDataType;
+        PrepareKinematicsData(*(tool.manipulator), expectedNumberOfJoint, *(tool.kinematics));
+
         // keep info in log
         std::stringstream dhResult;
-        this->Manipulator->PrintKinematics(dhResult);
+        tool.manipulator->PrintKinematics(dhResult);
         CMN_LOG_CLASS_INIT_VERBOSE << "ConfigureTool " << this->GetName()
                                    << ": loaded kinematics" << std::endl << dhResult.str() << std::endl;
 
-        // update ConfigurationJointKinematic from manipulator
-        UpdateConfigurationJointKinematic();
-
-        // resize data members using kinematics (jacobians and effort vectors)
-        ResizeKinematicsData();
-
         // load coupling information (required)
         const Json::Value jsonCoupling = jsonConfig["coupling"];
         if (jsonCoupling.isNull()) {
@@ -279,10 +456,10 @@ bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
         cmnDataJSON<prmActuatorJointCoupling>::DeSerializeText(toolCoupling4,
                                                                jsonCoupling);
         // build a coupling matrix for all 7 actuators/dofs
-        CouplingChange.ToolCoupling
+        tool.coupling
             .ActuatorToJointPosition().ForceAssign(vctDynamicMatrix<double>::Eye(NumberOfJoints()));
         // assign 4x4 matrix starting at position 3, 3
-        CouplingChange.ToolCoupling
+        tool.coupling
             .ActuatorToJointPosition().Ref(4, 4, 3, 3).Assign(toolCoupling4.ActuatorToJointPosition());
 
         // load jaw data, i.e. joint and torque limits
@@ -298,8 +475,8 @@ bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
                                      << ": can find \"jaw::qmin\" data in \"" << fullFilename << "\"" << std::endl;
             return false;
         } else {
-            CouplingChange.jaw_configuration_js.PositionMin().SetSize(1);
-            CouplingChange.jaw_configuration_js.PositionMin().at(0) = jsonJawQMin.asDouble();
+            tool.jaw_configuration_js.PositionMin().SetSize(1);
+            tool.jaw_configuration_js.PositionMin().at(0) = jsonJawQMin.asDouble();
         }
         const Json::Value jsonJawQMax = jsonJaw["qmax"];
         if (jsonJawQMax.isNull()) {
@@ -307,8 +484,8 @@ bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
                                      << ": can find \"jaw::qmax\" data in \"" << fullFilename << "\"" << std::endl;
             return false;
         } else {
-            CouplingChange.jaw_configuration_js.PositionMax().SetSize(1);
-            CouplingChange.jaw_configuration_js.PositionMax().at(0) = jsonJawQMax.asDouble();
+            tool.jaw_configuration_js.PositionMax().SetSize(1);
+            tool.jaw_configuration_js.PositionMax().at(0) = jsonJawQMax.asDouble();
         }
         const Json::Value jsonJawFTMax = jsonJaw["ftmax"];
         if (jsonJawFTMax.isNull()) {
@@ -316,16 +493,16 @@ bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
                                      << ": can find \"jaw::ftmax\" data in \"" << fullFilename << "\"" << std::endl;
             return false;
         } else {
-            CouplingChange.jaw_configuration_js.EffortMin().SetSize(1);
-            CouplingChange.jaw_configuration_js.EffortMax().SetSize(1);
-            CouplingChange.jaw_configuration_js.EffortMax().at(0) = jsonJawFTMax.asDouble();
-            CouplingChange.jaw_configuration_js.EffortMin().at(0) = -jsonJawFTMax.asDouble();
+            tool.jaw_configuration_js.EffortMin().SetSize(1);
+            tool.jaw_configuration_js.EffortMax().SetSize(1);
+            tool.jaw_configuration_js.EffortMax().at(0) = jsonJawFTMax.asDouble();
+            tool.jaw_configuration_js.EffortMin().at(0) = -jsonJawFTMax.asDouble();
         }
 
-        CouplingChange.jaw_configuration_js.Name().SetSize(1);
-        CouplingChange.jaw_configuration_js.Name().at(0) = "jaw";
-        CouplingChange.jaw_configuration_js.Type().SetSize(1);
-        CouplingChange.jaw_configuration_js.Type().at(0) = PRM_JOINT_REVOLUTE;
+        tool.jaw_configuration_js.Name().SetSize(1);
+        tool.jaw_configuration_js.Name().at(0) = "jaw";
+        tool.jaw_configuration_js.Type().SetSize(1);
+        tool.jaw_configuration_js.Type().at(0) = PRM_JOINT_REVOLUTE;
 
         // load lower/upper position used to engage the tool(required)
         const Json::Value jsonEngagePosition = jsonConfig["tool-engage-position"];
@@ -335,18 +512,18 @@ bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
             return false;
         }
         // lower
-        cmnDataJSON<vctDoubleVec>::DeSerializeText(CouplingChange.ToolEngageLowerPosition,
+        cmnDataJSON<vctDoubleVec>::DeSerializeText(tool.engage_lower_position,
                                                    jsonEngagePosition["lower"]);
-        if (CouplingChange.ToolEngageLowerPosition.size() != 4) {
+        if (tool.engage_lower_position.size() != 4) {
             CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
                                      << ": \"tool-engage-position\" : \"lower\" must contain 4 elements in \""
                                      << fullFilename << "\"" << std::endl;
             return false;
         }
         // upper
-        cmnDataJSON<vctDoubleVec>::DeSerializeText(CouplingChange.ToolEngageUpperPosition,
+        cmnDataJSON<vctDoubleVec>::DeSerializeText(tool.engage_upper_position,
                                                    jsonEngagePosition["upper"]);
-        if (CouplingChange.ToolEngageUpperPosition.size() != 4) {
+        if (tool.engage_upper_position.size() != 4) {
             CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
                                      << ": \"tool-engage-position\" : \"upper\" must contain 4 elements in \""
                                      << fullFilename << "\"" << std::endl;
@@ -359,9 +536,226 @@ bool mtsIntuitiveResearchKitPSM::ConfigureTool(const std::string & filename)
         return false;
     }
 
+    tool.valid = true;
     return true;
 }
 
+void mtsIntuitiveResearchKitPSM::ApplyTool(ToolPreparationType & tool)
+{
+    // swap manipulators, tool keeps the previous one until disposed
+    std::swap(Manipulator, tool.manipulator);
+    std::swap(ToolOffset, tool.tool_offset);
+    ToolOffsetTransformation.Assign(tool.tool_offset_transformation);
+    mSnakeLike = tool.snake_like;
+    mKinematicType = tool.kinematic_type;
+    std::swap(m_reachability.map, tool.reachability);
+
+    // configuration_js, jacobians, efforts, evaluator and estimator
+    // prepared with the manipulator
+    SwapKinematicsData(tool.kinematics);
+
+    // coupling, jaw and engage positions
+    CouplingChange.ToolCoupling = tool.coupling;
+    CouplingChange.jaw_configuration_js = tool.jaw_configuration_js;
+    CouplingChange.ToolEngageLowerPosition.ForceAssign(tool.engage_lower_position);
+    CouplingChange.ToolEngageUpperPosition.ForceAssign(tool.engage_upper_position);
+}
+
+void mtsIntuitiveResearchKitPSM::DisposeTool(ToolPreparationType & tool)
+{
+    // the tool offset is attached to the manipulator
+    if (tool.manipulator) {
+        tool.manipulator->DeleteTools();
+        delete tool.manipulator;
+        tool.manipulator = nullptr;
+        tool.tool_offset = nullptr;
+    }
+    if (tool.tool_offset) {
+        delete tool.tool_offset;
+        tool.tool_offset = nullptr;
+    }
+    if (tool.kinematics) {
+        delete tool.kinematics;
+        tool.kinematics = nullptr;
+    }
+}
+
+namespace {
+    // the control thread doesn't lock to notify the preparation
+    // thread so a wake up can be missed, check retired tools
+    // periodically
+    const std::chrono::milliseconds TOOL_PREPARATION_RETIRED_PERIOD(100);
+}
+
+void mtsIntuitiveResearchKitPSM::RequestToolPreparation(const size_t & index)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_tool_preparation.mutex);
+        m_tool_preparation.sequence++;
+        m_tool_preparation.requested = true;
+        m_tool_preparation.index = index;
+        m_tool_preparation.Rtw0.Assign(Manipulator->Rtw0);
+        if (!m_tool_preparation.thread.joinable()) {
+            m_tool_preparation.stop = false;
+            m_tool_preparation.thread = std::thread(&mtsIntuitiveResearchKitPSM::ToolPreparationLoop, this);
+        }
+    }
+    m_tool_preparation.condition.notify_one();
+}
+
+void mtsIntuitiveResearchKitPSM::CancelToolPreparation(void)
+{
+    std::lock_guard<std::mutex> lock(m_tool_preparation.mutex);
+    m_tool_preparation.sequence++;
+    m_tool_preparation.requested = false;
+}
+
+void mtsIntuitiveResearchKitPSM::ToolPreparationLoop(void)
+{
+    std::unique_lock<std::mutex> lock(m_tool_preparation.mutex);
+    while (true) {
+        m_tool_preparation.condition.wait_for(lock, TOOL_PREPARATION_RETIRED_PERIOD, [this] {
+                return m_tool_preparation.stop
+                    || m_tool_preparation.requested
+                    || (m_tool_preparation.retired.load() != nullptr);
+            });
+        // release tools replaced by the control thread, without lock
+        ToolPreparationType * retired = m_tool_preparation.retired.exchange(nullptr);
+        if (retired) {
+            lock.unlock();
+            while (retired) {
+                ToolPreparationType * next = retired->next_retired;
+                DisposeTool(*retired);
+                delete retired;
+                retired = next;
+            }
+            lock.lock();
+        }
+        if (m_tool_preparation.stop) {
+            return;
+        }
+        if (!m_tool_preparation.requested) {
+            continue;
+        }
+        m_tool_preparation.requested = false;
+        ToolPreparationType * tool = new ToolPreparationType;
+        tool->sequence = m_tool_preparation.sequence;
+        tool->index = m_tool_preparation.index;
+        const vctFrm4x4 Rtw0(m_tool_preparation.Rtw0);
+
+        // parse (if not pre-parsed) and prepare without lock
+        lock.unlock();
+        if (mToolList.HasDefinition(tool->index)) {
+            PrepareTool(mToolList.Definition(tool->index),
+                        mToolList.DefinitionFile(tool->index),
+                        Rtw0, *tool);
+        } else {
+            const std::string filename = mToolList.File(tool->index);
+            std::string fullFilename = filename;
+            if (!cmnPath::Exists(filename)) {
+                fullFilename = ToolPath().Find(filename);
+            }
+            Json::Value jsonConfig;
+            std::string jsonErrors;
+            if (fullFilename == "") {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
+                                         << ": failed to locate tool file for \""
+                                         << filename << "\"" << std::endl;
+            } else if (!mtsIntuitiveResearchKitConfigCache::Parse(fullFilename, jsonConfig, jsonErrors)) {
+                CMN_LOG_CLASS_INIT_ERROR << "ConfigureTool " << this->GetName()
+                                         << ": failed to parse configuration file \""
+                                         << fullFilename << "\"\n"
+                                         << jsonErrors;
+            } else {
+                PrepareTool(jsonConfig, fullFilename, Rtw0, *tool);
+            }
+        }
+        // publish, drop previous result if not used by control thread
+        ToolPreparationType * previous = m_tool_preparation.ready.exchange(tool);
+        if (previous) {
+            DisposeTool(*previous);
+            delete previous;
+        }
+        lock.lock();
+    }
+}
+
+void mtsIntuitiveResearchKitPSM::ToolPreparationProcess(void)
+{
+    ToolPreparationType * tool = m_tool_preparation.ready.exchange(nullptr);
+    if (!tool) {
+        return;
+    }
+    // stale result, request has been cancelled or replaced
+    if (tool->sequence != m_tool_preparation.sequence) {
+        RetireTool(tool);
+        return;
+    }
+    if (tool->valid) {
+        ApplyTool(*tool);
+        mToolIndex = tool->index;
+        mToolConfigured = true;
+        mToolTypeRequested = false;
+        set_tool_present(true);
+        if (mToolList.Generation(mToolIndex) == "S") {
+            mEngageDepth = mtsIntuitiveResearchKit::PSM::EngageDepthS;
+        } else {
+            mEngageDepth = mtsIntuitiveResearchKit::PSM::EngageDepthClassic;
+        }
+    } else {
+        m_arm_interface->SendError(this->GetName() + ": failed to configure tool \""
+                                   + mToolList.Name(tool->index) + "\", check terminal output and cisstLog file");
+        ToolEvents.tool_type(std::string("ERROR"));
+    }
+    // previous manipulator is released by the preparation thread
+    RetireTool(tool);
+}
+
+void mtsIntuitiveResearchKitPSM::RetireTool(ToolPreparationType * tool)
+{
+    // control thread, push on lock free list and never wait for
+    // the preparation thread
+    tool->next_retired = m_tool_preparation.retired.load();
+    while (!m_tool_preparation.retired.compare_exchange_weak(tool->next_retired, tool)) {}
+    m_tool_preparation.condition.notify_one();
+}
+
+void mtsIntuitiveResearchKitPSM::StopToolPreparation(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_tool_preparation.mutex);
+        m_tool_preparation.stop = true;
+    }
+    m_tool_preparation.condition.notify_one();
+    if (m_tool_preparation.thread.joinable()) {
+        m_tool_preparation.thread.join();
+    }
+    ToolPreparationType * tool = m_tool_preparation.ready.exchange(nullptr);
+    if (tool) {
+        RetireTool(tool);
+    }
+    ToolPreparationType * retired = m_tool_preparation.retired.exchange(nullptr);
+    while (retired) {
+        ToolPreparationType * next = retired->next_retired;
+        DisposeTool(*retired);
+        delete retired;
+        retired = next;
+    }
+}
+
+void mtsIntuitiveResearchKitPSM::Run(void)
+{
+    // swap in tool prepared in background at beginning of cycle
+    ToolPreparationProcess();
+    mtsIntuitiveResearchKitArm::Run();
+}
+
+void mtsIntuitiveResearchKitPSM::Cleanup(void)
+{
+    StopToolPreparation();
+    mtsIntuitiveResearchKitArm::Cleanup();
+}
+
 void mtsIntuitiveResearchKitPSM::UpdateStateJointKinematics(void)
 {
     // if there is no tool, report joints as PID joints
@@ -398,66 +792,109 @@ void mtsIntuitiveResearchKitPSM::UpdateStateJointKinematics(void)
     m_jaw_setpoint_js.Timestamp() = m_pid_setpoint_js.Timestamp();
     m_jaw_setpoint_js.Valid() = m_pid_setpoint_js.Timestamp();
 
-    if (!mSnakeLike) {
-
-        // most tool, copy first n joints (6) from PID for kinematics
-        // measured p/v/e
-        m_kin_measured_js.Position().Assign(m_pid_measured_js.Position().Ref(NumberOfJointsKinematics()));
-        m_kin_measured_js.Velocity().Assign(m_pid_measured_js.Velocity().Ref(NumberOfJointsKinematics()));
-        m_kin_measured_js.Effort().Assign(m_pid_measured_js.Effort().Ref(NumberOfJointsKinematics()));
-        m_kin_measured_js.Timestamp() = m_pid_measured_js.Timestamp();
-        m_kin_measured_js.Valid() = m_pid_measured_js.Valid();
-
-        // setpoint p/e
-        m_kin_setpoint_js.Position().Assign(m_pid_setpoint_js.Position().Ref(NumberOfJointsKinematics()));
-        m_kin_setpoint_js.Effort().Assign(m_pid_setpoint_js.Effort().Ref(NumberOfJointsKinematics()));
-        m_kin_setpoint_js.Timestamp() = m_pid_setpoint_js.Timestamp();
-        m_kin_setpoint_js.Valid() = m_pid_setpoint_js.Valid();
+    // most tools use the first 6 PID joints, snake like tools split
+    // PID joints 5 and 6 in 2 kinematic joints each
+    if (m_joint_mapping.nb_kinematics != NumberOfJointsKinematics()) {
+        UpdateJointMapping();
+    }
+    // measured p/v/e
+    MapStateJointKinematics(m_pid_measured_js, m_kin_measured_js, true);
+    // setpoint p/e
+    MapStateJointKinematics(m_pid_setpoint_js, m_kin_setpoint_js, false);
+
+    // compensation for first 2 joints, same cycle so kinematics use compensated positions
+    if (m_compensation.enabled) {
+        robPSMCompensation::Compensate(m_compensation.parameters,
+                                       m_kin_measured_js.Position(),
+                                       m_kin_measured_js.Effort());
+    }
+}
 
+void mtsIntuitiveResearchKitPSM::UpdateJointMapping(void)
+{
+    auto & mapping = m_joint_mapping;
+    mapping.nb_kinematics = NumberOfJointsKinematics();
+    mapping.kinematics_from_pid.SetAll(0.0);
+    mapping.pid_from_kinematics.SetAll(0.0);
+    mapping.pid.SetAll(0.0);
+    mapping.kinematics_joints.SetAll(0.0);
+    // first 4 joints are always the same
+    for (size_t index = 0; index < 4; ++index) {
+        mapping.kinematics_from_pid.Element(index, index) = 1.0;
+        mapping.pid_from_kinematics.Element(index, index) = 1.0;
+    }
+    if (mSnakeLike) {
+        // PID joint 4 is split in kinematic joints 4 and 7, 5 in 5 and 6
+        mapping.kinematics_from_pid.Element(4, 4) = 0.5;
+        mapping.kinematics_from_pid.Element(7, 4) = 0.5;
+        mapping.kinematics_from_pid.Element(5, 5) = 0.5;
+        mapping.kinematics_from_pid.Element(6, 5) = 0.5;
+        mapping.pid_from_kinematics.Element(4, 4) = 1.0;
+        mapping.pid_from_kinematics.Element(4, 7) = 1.0;
+        mapping.pid_from_kinematics.Element(5, 5) = 1.0;
+        mapping.pid_from_kinematics.Element(5, 6) = 1.0;
     } else {
+        for (size_t index = 4; index < 6; ++index) {
+            mapping.kinematics_from_pid.Element(index, index) = 1.0;
+            mapping.pid_from_kinematics.Element(index, index) = 1.0;
+        }
+    }
+}
 
-        // measured p/v/e
-        m_kin_measured_js.Position().Assign(m_pid_measured_js.Position(), 4);
-        m_kin_measured_js.Position().at(4) = m_kin_measured_js.Position().at(7) = m_pid_measured_js.Position().at(4) / 2.0;
-        m_kin_measured_js.Position().at(5) = m_kin_measured_js.Position().at(6) = m_pid_measured_js.Position().at(5) / 2.0;
-
-        m_kin_measured_js.Velocity().Assign(m_pid_measured_js.Velocity(), 4);
-        m_kin_measured_js.Velocity().at(4) = m_kin_measured_js.Velocity().at(7) = m_pid_measured_js.Velocity().at(4) / 2.0;
-        m_kin_measured_js.Velocity().at(5) = m_kin_measured_js.Velocity().at(6) = m_pid_measured_js.Velocity().at(5) / 2.0;
-
-        m_kin_measured_js.Effort().Assign(m_pid_measured_js.Effort(), 4);
-        m_kin_measured_js.Effort().at(4) = m_kin_measured_js.Effort().at(7) = m_pid_measured_js.Effort().at(4) / 2.0;
-        m_kin_measured_js.Effort().at(5) = m_kin_measured_js.Effort().at(6) = m_pid_measured_js.Effort().at(5) / 2.0;
-        m_kin_measured_js.Timestamp() = m_pid_measured_js.Timestamp();
-        m_kin_measured_js.Valid() = m_pid_measured_js.Valid();
-
-        // setpoint p/e
-        m_kin_setpoint_js.Position().Assign(m_pid_setpoint_js.Position(), 4);
-        m_kin_setpoint_js.Position().at(4) = m_kin_setpoint_js.Position().at(7) = m_pid_setpoint_js.Position().at(4) / 2.0;
-        m_kin_setpoint_js.Position().at(5) = m_kin_setpoint_js.Position().at(6) = m_pid_setpoint_js.Position().at(5) / 2.0;
+void mtsIntuitiveResearchKitPSM::MapStateJointKinematics(const prmStateJoint & pid,
+                                                         prmStateJoint & kinematics,
+                                                         const bool velocity)
+{
+    auto & mapping = m_joint_mapping;
+    const size_t nbPID = std::min(pid.Position().size(), static_cast<size_t>(7));
+    const size_t nbKinematics = mapping.nb_kinematics;
+    const bool hasVelocity = velocity && (pid.Velocity().size() >= nbPID);
+    const bool hasEffort = (pid.Effort().size() >= nbPID);
+
+    // pack p/v/e in columns and convert all at once
+    for (size_t index = 0; index < nbPID; ++index) {
+        mapping.pid.Element(index, 0) = pid.Position().Element(index);
+        mapping.pid.Element(index, 1) = hasVelocity ? pid.Velocity().Element(index) : 0.0;
+        mapping.pid.Element(index, 2) = hasEffort ? pid.Effort().Element(index) : 0.0;
+    }
+    mapping.kinematics.ProductOf(mapping.kinematics_from_pid, mapping.pid);
 
-        m_kin_setpoint_js.Effort().Assign(m_pid_measured_js.Effort(), 4);
-        m_kin_setpoint_js.Effort().at(4) = m_kin_setpoint_js.Effort().at(7) = m_pid_setpoint_js.Effort().at(4) / 2.0;
-        m_kin_setpoint_js.Effort().at(5) = m_kin_setpoint_js.Effort().at(6) = m_pid_setpoint_js.Effort().at(5) / 2.0;
-        m_kin_setpoint_js.Timestamp() = m_pid_setpoint_js.Timestamp();
-        m_kin_setpoint_js.Valid() = m_pid_setpoint_js.Valid();
+    if (kinematics.Position().size() != nbKinematics) {
+        kinematics.Position().SetSize(nbKinematics);
+    }
+    if (kinematics.Effort().size() != nbKinematics) {
+        kinematics.Effort().SetSize(nbKinematics);
     }
+    if (velocity && (kinematics.Velocity().size() != nbKinematics)) {
+        kinematics.Velocity().SetSize(nbKinematics);
+    }
+    for (size_t index = 0; index < nbKinematics; ++index) {
+        kinematics.Position().Element(index) = mapping.kinematics.Element(index, 0);
+        if (velocity) {
+            kinematics.Velocity().Element(index) = mapping.kinematics.Element(index, 1);
+        }
+        kinematics.Effort().Element(index) = mapping.kinematics.Element(index, 2);
+    }
+    kinematics.Timestamp() = pid.Timestamp();
+    kinematics.Valid() = pid.Valid();
 }
 
 void mtsIntuitiveResearchKitPSM::ToJointsPID(const vctDoubleVec & jointsKinematics, vctDoubleVec & jointsPID)
 {
     if (IsCartesianReady()) {
-        // tool is present
-        if (mSnakeLike) {
-            CMN_ASSERT(jointsKinematics.size() == 8);
-            jointsPID.Assign(jointsKinematics, 4);
-            // Test if position 4 and 7 are very much apart; throw error maybe ?
-            jointsPID.at(4) = jointsKinematics.at(4) + jointsKinematics.at(7);
-            // Same goes for 5 and 6
-            jointsPID.at(5) = jointsKinematics.at(5) + jointsKinematics.at(6);
-        } else {
-            CMN_ASSERT(jointsKinematics.size() >= 6);
-            jointsPID.Assign(jointsKinematics, 6);
+        // tool is present, only first 6 PID joints are set
+        if (m_joint_mapping.nb_kinematics != NumberOfJointsKinematics()) {
+            UpdateJointMapping();
+        }
+        auto & mapping = m_joint_mapping;
+        CMN_ASSERT(jointsKinematics.size() >= mapping.nb_kinematics);
+        CMN_ASSERT(jointsPID.size() >= 6);
+        for (size_t index = 0; index < mapping.nb_kinematics; ++index) {
+            mapping.kinematics_joints.Element(index) = jointsKinematics.Element(index);
+        }
+        mapping.pid_joints.ProductOf(mapping.pid_from_kinematics, mapping.kinematics_joints);
+        for (size_t index = 0; index < 6; ++index) {
+            jointsPID.Element(index) = mapping.pid_joints.Element(index);
         }
     } else {
         // joint space, no tool yet so we can control all 7 actuators
@@ -475,19 +912,30 @@ robManipulator::Errno mtsIntuitiveResearchKitPSM::InverseKinematics(vctDoubleVec
 
     // if too close to zero we're going to run into issue in any case
     if (distanceToRCM < 1.0 * cmn_mm) {
-        m_arm_interface->SendWarning(GetName() + ": InverseKinematics, can't solve IK too close to RCM");
+        m_messages.Send(m_ik_message_sites.too_close_to_rcm, StateTable.GetTic());
+        return robManipulator::EFAILURE;
+    }
+
+    // reject goals out of reach without running the solver
+    if (!m_reachability.map.Reachable(cartesianGoal.Translation())) {
+        m_messages.Send(m_ik_message_sites.out_of_reach, StateTable.GetTic());
         return robManipulator::EFAILURE;
     }
 
     // IK
-    robManipulator::Errno Err = Manipulator->InverseKinematics(jointSet, cartesianGoal);;
+    robManipulator::Errno Err;
+    if (mSnakeLike && m_snake_ik.bounded) {
+        Err = InverseKinematicsSnakeBounded(jointSet, cartesianGoal);
+    } else {
+        Err = Manipulator->InverseKinematics(jointSet, cartesianGoal);
+    }
 
     // check equality constraint for snake like kinematic
     if (mSnakeLike) {
         // Check for equality Snake joints (4,7) and (5,6)
         if (fabs(jointSet.at(4) - jointSet.at(7)) > 0.00001 ||
             fabs(jointSet.at(5) - jointSet.at(6)) > 0.00001) {
-            m_arm_interface->SendWarning(GetName() + ": InverseKinematics, equality constraint violated");
+            m_messages.Send(m_ik_message_sites.snake_equality, StateTable.GetTic());
         }
     }
 
@@ -498,14 +946,20 @@ robManipulator::Errno mtsIntuitiveResearchKitPSM::InverseKinematics(vctDoubleVec
         const double differenceInTurns = nearbyint(difference / (2.0 * cmnPI));
         jointSet.at(3) = jointSet.at(3) + differenceInTurns * 2.0 * cmnPI;
 
-        // project away from RCM if not safe, using axis at end of shaft
-        vctFrm4x4 f4;
-        if (Manipulator->links.size() >= 4) {
-            f4 = Manipulator->ForwardKinematics(jointSet, 4);
+        // project away from RCM if not safe, using axis at end of shaft.
+        // closed form solver already computed the distance
+        const robManipulatorPSM * closed = dynamic_cast<robManipulatorPSM *>(Manipulator);
+        if (closed && !closed->UsedIterative()) {
+            distanceToRCM = closed->DistanceToRCM();
         } else {
-            f4 = Manipulator->ForwardKinematics(jointSet);
+            vctFrm4x4 f4;
+            if (Manipulator->links.size() >= 4) {
+                f4 = Manipulator->ForwardKinematics(jointSet, 4);
+            } else {
+                f4 = Manipulator->ForwardKinematics(jointSet);
+            }
+            distanceToRCM = f4.Translation().Norm();
         }
-        distanceToRCM = f4.Translation().Norm();
 
         // if not far enough, distance for axis 4 is fully determine by insertion joint so add to it
         if (distanceToRCM < mtsIntuitiveResearchKit::PSM::SafeDistanceFromRCM) {
@@ -525,6 +979,64 @@ robManipulator::Errno mtsIntuitiveResearchKitPSM::InverseKinematics(vctDoubleVec
     return robManipulator::EFAILURE;
 }
 
+robManipulator::Errno mtsIntuitiveResearchKitPSM::InverseKinematicsSnakeBounded(vctDoubleVec & jointSet,
+                                                                                const vctFrm4x4 & cartesianGoal)
+{
+    robManipulatorPSMSnake * snake = dynamic_cast<robManipulatorPSMSnake *>(Manipulator);
+    if (!snake) {
+        return Manipulator->InverseKinematics(jointSet, cartesianGoal);
+    }
+
+    // warm start if we have a recent solution
+    const double now = StateTable.GetTic();
+    const double dt = now - m_snake_ik.previous_time;
+    const bool warmStart = m_snake_ik.previous_valid
+        && (m_snake_ik.previous.size() == jointSet.size())
+        && (dt > 0.0)
+        && (dt < 5.0 * ExpectedPeriod());
+    if (warmStart) {
+        jointSet.Assign(m_snake_ik.previous);
+    }
+
+    snake->SetBoundedBudget(m_snake_ik.max_iterations, m_snake_ik.max_time);
+    robManipulator::Errno result =
+        snake->InverseKinematicsBounded(jointSet, cartesianGoal,
+                                        warmStart ? m_snake_ik.velocity : m_snake_ik.no_velocity,
+                                        dt);
+
+    // accept partial solution if close enough
+    const robManipulatorPSMSnake::BoundedStatusType & status = snake->BoundedStatus();
+    if (result != robManipulator::ESUCCESS) {
+        if (status.residual <= m_snake_ik.max_residual) {
+            result = robManipulator::ESUCCESS;
+            m_snake_ik.not_converged++;
+            CMN_LOG_CLASS_RUN_DEBUG << "InverseKinematicsSnakeBounded: using partial solution after "
+                                    << status.iterations << " iterations, residual "
+                                    << status.residual << std::endl;
+        }
+    }
+
+    // save for next warm start
+    if (result == robManipulator::ESUCCESS) {
+        if (m_snake_ik.previous.size() != jointSet.size()) {
+            m_snake_ik.previous.SetSize(jointSet.size());
+            m_snake_ik.velocity.SetSize(jointSet.size());
+        }
+        if (warmStart) {
+            m_snake_ik.velocity.DifferenceOf(jointSet, m_snake_ik.previous);
+            m_snake_ik.velocity.Divide(dt);
+        } else {
+            m_snake_ik.velocity.SetAll(0.0);
+        }
+        m_snake_ik.previous.Assign(jointSet);
+        m_snake_ik.previous_time = now;
+        m_snake_ik.previous_valid = true;
+    } else {
+        m_snake_ik.previous_valid = false;
+    }
+    return result;
+}
+
 bool mtsIntuitiveResearchKitPSM::IsSafeForCartesianControl(void) const
 {
     vctFrm4x4 f4;
@@ -543,6 +1055,17 @@ void mtsIntuitiveResearchKitPSM::Init(void)
     // main initialization from base type
     mtsIntuitiveResearchKitArm::Init();
 
+    // inverse kinematics messages
+    m_ik_message_sites.too_close_to_rcm =
+        m_messages.AddSite(mtsIntuitiveResearchKitMessages::LEVEL_WARNING,
+                           "InverseKinematics, can't solve IK too close to RCM");
+    m_ik_message_sites.out_of_reach =
+        m_messages.AddSite(mtsIntuitiveResearchKitMessages::LEVEL_WARNING,
+                           "InverseKinematics, goal is out of reach");
+    m_ik_message_sites.snake_equality =
+        m_messages.AddSite(mtsIntuitiveResearchKitMessages::LEVEL_WARNING,
+                           "InverseKinematics, equality constraint violated");
+
     // state machine specific to PSM, see base class for other states
     mArmState.AddState("CHANGING_COUPLING_ADAPTER");
     mArmState.AddState("ENGAGING_ADAPTER");
@@ -653,13 +1176,13 @@ void mtsIntuitiveResearchKitPSM::Init(void)
     // Main interface should have been created by base class init
     CMN_ASSERT(m_arm_interface);
     m_jaw_measured_js.SetAutomaticTimestamp(false);
-    StateTable.AddData(m_jaw_measured_js, "jaw/measured_js");
+    AddStateData(StateTable, m_jaw_measured_js, "jaw/measured_js");
 
     m_jaw_setpoint_js.SetAutomaticTimestamp(false);
-    StateTable.AddData(m_jaw_setpoint_js, "jaw/setpoint_js");
+    AddStateData(StateTable, m_jaw_setpoint_js, "jaw/setpoint_js");
 
     // state table for configuration
-    mStateTableConfiguration.AddData(CouplingChange.jaw_configuration_js, "jaw/configuration_js");
+    AddStateData(mStateTableConfiguration, CouplingChange.jaw_configuration_js, "jaw/configuration_js");
 
     // jaw interface
     m_arm_interface->AddCommandReadState(this->StateTable, m_jaw_measured_js, "jaw/measured_js");
@@ -732,6 +1255,8 @@ bool mtsIntuitiveResearchKitPSM::IsHomed(void) const
 
 void mtsIntuitiveResearchKitPSM::UnHome(void)
 {
+    Adapter.RestoredEngaged = false;
+    Tool.RestoredEngaged.clear();
     if (Tool.IsPresent) {
         Tool.IsEngaged = false;
         return;
@@ -776,6 +1301,24 @@ void mtsIntuitiveResearchKitPSM::SetGoalHomingArm(void)
     }
 }
 
+void mtsIntuitiveResearchKitPSM::CalibrationSnapshotExtra(Json::Value & extra) const
+{
+    extra["adapter-engaged"] = Adapter.IsPresent && Adapter.IsEngaged;
+    if (Tool.IsPresent && Tool.IsEngaged) {
+        extra["tool-engaged"] = mToolList.Name(mToolIndex);
+    }
+}
+
+void mtsIntuitiveResearchKitPSM::CalibrationSnapshotRestore(const Json::Value & extra)
+{
+    // engagement is only skipped if explicitly requested
+    if (!m_calibration_snapshot.RestoreEngaged()) {
+        return;
+    }
+    Adapter.RestoredEngaged = extra["adapter-engaged"].asBool();
+    Tool.RestoredEngaged = extra["tool-engaged"].asString();
+}
+
 void mtsIntuitiveResearchKitPSM::TransitionHomed(void)
 {
     if (!m_simulated) {
@@ -1014,8 +1557,10 @@ void mtsIntuitiveResearchKitPSM::EnterEngagingAdapter(void)
         return;
     }
     // if for some reason we don't need to engage, basically, adapter
-    // was found before homing
-    if (!Adapter.NeedEngage) {
+    // was found before homing or was engaged before restart
+    if (!Adapter.NeedEngage || Adapter.RestoredEngaged) {
+        Adapter.NeedEngage = false;
+        Adapter.RestoredEngaged = false;
         Adapter.IsEngaged = true;
         mArmState.SetCurrentState("HOMED");
         return;
@@ -1066,6 +1611,7 @@ void mtsIntuitiveResearchKitPSM::RunEngagingAdapter(void)
         SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::JOINT_SPACE,
                                mtsIntuitiveResearchKitArmTypes::TRAJECTORY_MODE);
         control_move_jp_on_start();
+        EngagingStart(currentTime);
         EngagingStage = 2;
         return;
     }
@@ -1076,6 +1622,10 @@ void mtsIntuitiveResearchKitPSM::RunEngagingAdapter(void)
                                       m_trajectory_j.goal_v);
     servo_jp_internal(m_servo_jp);
 
+    if (EngagingSkipIfDetected(currentTime, "adapter")) {
+        return;
+    }
+
     const robReflexxes::ResultType trajectoryResult = m_trajectory_j.Reflexxes.ResultValue();
 
     switch (trajectoryResult) {
@@ -1091,7 +1641,9 @@ void mtsIntuitiveResearchKitPSM::RunEngagingAdapter(void)
     case robReflexxes::Reflexxes_FINAL_STATE_REACHED:
         {
             // check if we were in last phase
+            EngagingPhaseEnd(currentTime);
             if (EngagingStage > LastEngagingStage) {
+                EngagingReport(currentTime, "adapter");
                 Adapter.NeedEngage = false;
                 Adapter.IsEngaged = true;
                 control_move_jp_on_stop(true); // goal reached
@@ -1118,11 +1670,79 @@ void mtsIntuitiveResearchKitPSM::RunEngagingAdapter(void)
     }
 }
 
+void mtsIntuitiveResearchKitPSM::EngagingStart(const double currentTime)
+{
+    m_engage_detection.engaged.SetSize(4);
+    m_engage_detection.engaged.SetAll(false);
+    m_engage_detection.start_time = currentTime;
+    m_engage_detection.phase_start_time = currentTime;
+    m_engage_detection.phases.clear();
+}
+
+void mtsIntuitiveResearchKitPSM::EngagingPhaseEnd(const double currentTime)
+{
+    m_engage_detection.phases.push_back(currentTime - m_engage_detection.phase_start_time);
+    m_engage_detection.phase_start_time = currentTime;
+}
+
+bool mtsIntuitiveResearchKitPSM::EngagingSkipIfDetected(const double currentTime,
+                                                        const std::string & what)
+{
+    // nothing to skip if already going back to zero
+    if (!m_engage_detection.enabled
+        || (EngagingStage > LastEngagingStage)) {
+        return false;
+    }
+    for (size_t index = 0; index < 4; ++index) {
+        const double error = std::abs(m_pid_setpoint_js.Position().at(index + 3)
+                                      - m_pid_measured_js.Position().at(index + 3));
+        if (error > m_engage_detection.tracking_error) {
+            m_engage_detection.engaged.at(index) = true;
+        }
+    }
+    if (!m_engage_detection.engaged.All()) {
+        return false;
+    }
+    // all engaged, go back to zero from current position
+    EngagingPhaseEnd(currentTime);
+    m_servo_jp.Ref(4, 3).Assign(m_pid_measured_js.Position().Ref(4, 3));
+    m_servo_jv.Ref(4, 3).SetAll(0.0);
+    m_trajectory_j.goal.Ref(4, 3).SetAll(0.0);
+    m_trajectory_j.end_time = 0.0;
+    std::stringstream message;
+    message << this->GetName() << ": " << what << " engagement detected during phase "
+            << EngagingStage - 1 << " of " << LastEngagingStage - 1 << ", skipping remaining phases";
+    m_arm_interface->SendStatus(message.str());
+    EngagingStage = LastEngagingStage + 1;
+    return true;
+}
+
+void mtsIntuitiveResearchKitPSM::EngagingReport(const double currentTime,
+                                                const std::string & what)
+{
+    std::stringstream message;
+    message << this->GetName() << ": " << what << " engaged in "
+            << std::fixed << std::setprecision(2)
+            << currentTime - m_engage_detection.start_time << "s, phases:";
+    for (const auto & duration : m_engage_detection.phases) {
+        message << " " << duration;
+    }
+    CMN_LOG_CLASS_RUN_VERBOSE << message.str() << std::endl;
+    m_arm_interface->SendStatus(message.str());
+}
+
 void mtsIntuitiveResearchKitPSM::EnterChangingCouplingTool(void)
 {
     UpdateOperatingStateAndBusy(prmOperatingState::ENABLED, true);
     CouplingChange.Started = false;
     CouplingChange.CouplingForTool = true; // Load tool coupling
+    // same tool was engaged before restart
+    if (!Tool.RestoredEngaged.empty()
+        && (Tool.RestoredEngaged == mToolList.Name(mToolIndex))) {
+        m_arm_interface->SendStatus(this->GetName() + ": tool engaged restored from calibration snapshot");
+        Tool.NeedEngage = false;
+    }
+    Tool.RestoredEngaged.clear();
     if (Tool.NeedEngage) {
         CouplingChange.NextState = "ENGAGING_TOOL";
     } else {
@@ -1194,6 +1814,7 @@ void mtsIntuitiveResearchKitPSM::RunEngagingTool(void)
         SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::JOINT_SPACE,
                                mtsIntuitiveResearchKitArmTypes::TRAJECTORY_MODE);
         control_move_jp_on_start();
+        EngagingStart(currentTime);
         EngagingStage = 2;
         return;
     }
@@ -1204,6 +1825,9 @@ void mtsIntuitiveResearchKitPSM::RunEngagingTool(void)
                                       m_trajectory_j.goal_v);
     servo_jp_internal(m_servo_jp);
 
+    if (EngagingSkipIfDetected(currentTime, "tool")) {
+        return;
+    }
 
     const robReflexxes::ResultType trajectoryResult = m_trajectory_j.Reflexxes.ResultValue();
 
@@ -1220,7 +1844,9 @@ void mtsIntuitiveResearchKitPSM::RunEngagingTool(void)
     case robReflexxes::Reflexxes_FINAL_STATE_REACHED:
         {
             // check if we were in last phase
+            EngagingPhaseEnd(currentTime);
             if (EngagingStage > LastEngagingStage) {
+                EngagingReport(currentTime, "tool");
                 Tool.NeedEngage = false;
                 control_move_jp_on_stop(true); // goal reached
                 mArmState.SetCurrentState("TOOL_ENGAGED");
@@ -1299,6 +1925,7 @@ void mtsIntuitiveResearchKitPSM::jaw_servo_jp(const prmPositionJointSet & jawPos
                                    mtsIntuitiveResearchKitArmTypes::POSITION_MODE);
             // make sure all other joints have a reasonable cartesian
             // goal for all other joints
+            UpdateSetpointCartesian();
             CartesianSetParam.Goal().Assign(m_setpoint_cp.Position());
         }
         break;
@@ -1360,8 +1987,11 @@ void mtsIntuitiveResearchKitPSM::servo_jp_internal(const vctDoubleVec & newPosit
     m_servo_jp_param.Goal().Zeros();
     ToJointsPID(newPosition, m_servo_jp_param.Goal());
     m_servo_jp_param.Goal().at(6) = m_jaw_servo_jp;
+    LimitGuard(m_servo_jp_param.Goal());
     m_servo_jp_param.SetTimestamp(StateTable.GetTic());
+    TimingEnter(TIMING_PID);
     PID.servo_jp(m_servo_jp_param);
+    TimingExit();
 }
 
 void mtsIntuitiveResearchKitPSM::jaw_servo_jf(const prmForceTorqueJointSet & effort)
@@ -1386,7 +2016,7 @@ void mtsIntuitiveResearchKitPSM::jaw_servo_jf(const prmForceTorqueJointSet & eff
         SetControlSpaceAndMode(mtsIntuitiveResearchKitArmTypes::CARTESIAN_SPACE,
                                mtsIntuitiveResearchKitArmTypes::EFFORT_MODE);
         // make sure all other joints have a reasonable goal
-        mEffortJointSet.ForceTorque().SetAll(0.0);
+        m_kinematics->effort_set.ForceTorque().SetAll(0.0);
     }
 
     // save the desired effort
@@ -1405,7 +2035,7 @@ void mtsIntuitiveResearchKitPSM::servo_jf_internal(const vctDoubleVec & newEffor
     if (mSnakeLike) {
         std::cerr << CMN_LOG_DETAILS << " need to convert 8 joints from snake to 6 for force control" << std::endl;
     } else {
-        torqueDesired.Assign(mEffortJoint, NumberOfJointsKinematics());
+        torqueDesired.Assign(m_kinematics->effort, NumberOfJointsKinematics());
     }
     // add torque for jaws
     torqueDesired.at(6) = m_jaw_servo_jf;
@@ -1413,7 +2043,9 @@ void mtsIntuitiveResearchKitPSM::servo_jf_internal(const vctDoubleVec & newEffor
     // convert to cisstParameterTypes
     mTorqueSetParam.SetForceTorque(torqueDesired);
     mTorqueSetParam.SetTimestamp(StateTable.GetTic());
+    TimingEnter(TIMING_PID);
     PID.servo_jf(mTorqueSetParam);
+    TimingExit();
 }
 
 void mtsIntuitiveResearchKitPSM::control_move_jp_on_stop(const bool goal_reached)
@@ -1429,6 +2061,8 @@ void mtsIntuitiveResearchKitPSM::CouplingEventHandler(const prmActuatorJointCoup
 {
     CouplingChange.ReceivedCoupling = true;
     CouplingChange.LastCoupling.Assign(coupling);
+    // kinematics mapping depends on tool
+    m_joint_mapping.nb_kinematics = 0;
     // refresh robot data
     GetRobotData();
 }
@@ -1450,6 +2084,9 @@ void mtsIntuitiveResearchKitPSM::set_adapter_present(const bool & present)
         Adapter.NeedEngage = true;
     } else {
         Adapter.NeedEngage = false;
+        Adapter.RestoredEngaged = false;
+        Tool.RestoredEngaged.clear();
+        CalibrationSnapshotUpdate();
         mArmState.SetCurrentState("HOMED");
     }
 }
@@ -1476,6 +2113,8 @@ void mtsIntuitiveResearchKitPSM::set_tool_present(const bool & present)
         Tool.NeedEngage = true;
         ToolEvents.tool_type(mToolList.Name(mToolIndex));
     } else {
+        Tool.RestoredEngaged.clear();
+        CalibrationSnapshotUpdate();
         ToolEvents.tool_type(std::string());
     }
 }
@@ -1483,10 +2122,8 @@ void mtsIntuitiveResearchKitPSM::set_tool_present(const bool & present)
 void mtsIntuitiveResearchKitPSM::set_tool_type(const std::string & toolType)
 {
     if (mToolTypeRequested || m_simulated) {
+        // mToolTypeRequested is reset once the tool is configured
         EventHandlerToolType(toolType);
-        if (mToolConfigured) {
-            mToolTypeRequested = false;
-        }
     } else {
         m_arm_interface->SendWarning(this->GetName() + ": received request to set tool type but not expecting it now.  Request ignored.");
     }
@@ -1516,6 +2153,7 @@ void mtsIntuitiveResearchKitPSM::EventHandlerTool(const prmEventButton & button)
         switch (mToolDetection) {
         case mtsIntuitiveResearchKitToolTypes::AUTOMATIC:
         case mtsIntuitiveResearchKitToolTypes::MANUAL:
+            CancelToolPreparation();
             mToolConfigured = false;
             set_tool_present(false);
             break;
@@ -1566,20 +2204,11 @@ void mtsIntuitiveResearchKitPSM::EventHandlerToolType(const std::string & toolTy
         ToolEvents.tool_type(std::string("ERROR"));
         return;
     }
-    // supported tools
+    // supported tools, configuration is prepared in background and
+    // applied at the beginning of a later Run, see ToolPreparationProcess
     const std::string toolFile = mToolList.File(mToolIndex);
     m_arm_interface->SendStatus(this->GetName() + ": using tool file \"" + toolFile
                                 + "\" for: " + mToolList.FullDescription(mToolIndex));
-    mToolConfigured = ConfigureTool(toolFile);
-    if (mToolConfigured) {
-        set_tool_present(true);
-        if (mToolList.Generation(mToolIndex) == "S") {
-            mEngageDepth = mtsIntuitiveResearchKit::PSM::EngageDepthS;
-        } else {
-            mEngageDepth = mtsIntuitiveResearchKit::PSM::EngageDepthClassic;
-        }
-    } else {
-        m_arm_interface->SendError(this->GetName() + ": failed to configure tool \"" + toolType + "\", check terminal output and cisstLog file");
-        ToolEvents.tool_type(std::string("ERROR"));
-    }
+    mToolConfigured = false;
+    RequestToolPreparation(mToolIndex);
 }
@@ -0,0 +1,342 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <cisstMultiTask/mtsInterfaceProvided.h>
+#include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <cisstMultiTask/mtsManagerLocal.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitProximityMonitor.h>
+
+CMN_IMPLEMENT_SERVICES_DERIVED(mtsIntuitiveResearchKitProximityMonitor, mtsTaskPeriodic);
+
+namespace {
+    inline double ProximityClamp(const double value) {
+        return std::min(1.0, std::max(0.0, value));
+    }
+    // arms have to move away by this ratio of the threshold to change level
+    const double ProximityHysteresis = 0.1;
+    // time between two stop events for the same pair
+    const double ProximityStopPeriod = 0.5;
+}
+
+mtsIntuitiveResearchKitProximityMonitor::mtsIntuitiveResearchKitProximityMonitor(const std::string & componentName,
+                                                                                 const double periodInSeconds):
+    mtsTaskPeriodic(componentName, periodInSeconds),
+    m_minimum_distance(std::numeric_limits<double>::max())
+{
+    StateTable.AddData(m_minimum_distance, "minimum_distance");
+
+    m_interface = AddInterfaceProvided("ProximityMonitor");
+    if (m_interface) {
+        m_interface->AddMessageEvents();
+        m_interface->AddCommandReadState(StateTable, m_minimum_distance, "minimum_distance");
+        m_interface->AddEventWrite(proximity_stop, "proximity_stop", prmKeyValue());
+    }
+}
+
+mtsIntuitiveResearchKitProximityMonitor::~mtsIntuitiveResearchKitProximityMonitor()
+{
+    for (auto arm : m_arms) {
+        delete arm;
+    }
+}
+
+bool mtsIntuitiveResearchKitProximityMonitor::Configure(const Json::Value & jsonConfig)
+{
+    m_radius = jsonConfig.get("radius", m_radius).asDouble();
+    m_body_radius = jsonConfig.get("body-radius", m_body_radius).asDouble();
+    m_body_length = jsonConfig.get("body-length", m_body_length).asDouble();
+    m_warning_distance = jsonConfig.get("warning-distance", m_warning_distance).asDouble();
+    m_stop_distance = jsonConfig.get("stop-distance", m_stop_distance).asDouble();
+    if ((m_radius < 0.0) || (m_body_radius < 0.0) || (m_body_length < 0.0)) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: \"radius\", \"body-radius\" and \"body-length\" must be positive for "
+                                 << this->GetName() << std::endl;
+        return false;
+    }
+    if ((m_stop_distance < 0.0) || (m_warning_distance < m_stop_distance)) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: \"stop-distance\" must be positive and lower than \"warning-distance\" for "
+                                 << this->GetName() << std::endl;
+        return false;
+    }
+
+    const Json::Value jsonArms = jsonConfig["arms"];
+    if (jsonArms.size() < 2) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: \"arms\" must contain at least two arms for "
+                                 << this->GetName() << std::endl;
+        return false;
+    }
+    for (unsigned int index = 0; index < jsonArms.size(); ++index) {
+        const std::string name = jsonArms[index].asString();
+        if (name == "") {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: invalid name for arms[" << index << "] in "
+                                     << this->GetName() << std::endl;
+            return false;
+        }
+        if (this->GetInterfaceRequired(name)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: arm \"" << name << "\" is already used by "
+                                     << this->GetName() << std::endl;
+            return false;
+        }
+        ArmData * arm = new ArmData;
+        arm->m_name = name;
+        mtsInterfaceRequired * required = AddInterfaceRequired(name);
+        if (!required) {
+            delete arm;
+            return false;
+        }
+        required->AddFunction("measured_cp", arm->measured_cp);
+        required->AddFunction("base_frame", arm->base_frame);
+        m_arms.push_back(arm);
+    }
+
+    // all buffers are allocated here so Run never allocates
+    const size_t nbArms = m_arms.size();
+    m_capsules.resize(2 * nbArms);
+    m_sorted.reserve(2 * nbArms);
+    m_pair_distances.resize(nbArms * nbArms);
+    m_pair_levels.resize(nbArms * nbArms, LEVEL_CLEAR);
+    m_pair_last_stop.resize(nbArms * nbArms, 0.0);
+    return true;
+}
+
+std::vector<std::string> mtsIntuitiveResearchKitProximityMonitor::ArmInterfaceNames(void) const
+{
+    std::vector<std::string> result;
+    for (auto arm : m_arms) {
+        result.push_back(arm->m_name);
+    }
+    return result;
+}
+
+double mtsIntuitiveResearchKitProximityMonitor::SegmentsDistance(const vct3 & p1, const vct3 & q1,
+                                                                 const vct3 & p2, const vct3 & q2)
+{
+    // see Ericson, Real-Time Collision Detection, 5.1.9
+    const double epsilon = 1e-12;
+    const vct3 d1 = q1 - p1;
+    const vct3 d2 = q2 - p2;
+    const vct3 r = p1 - p2;
+    const double a = d1.DotProduct(d1);
+    const double e = d2.DotProduct(d2);
+    const double f = d2.DotProduct(r);
+    double s, t;
+
+    if ((a <= epsilon) && (e <= epsilon)) {
+        return r.Norm();
+    }
+    if (a <= epsilon) {
+        s = 0.0;
+        t = ProximityClamp(f / e);
+    } else {
+        const double c = d1.DotProduct(r);
+        if (e <= epsilon) {
+            t = 0.0;
+            s = ProximityClamp(-c / a);
+        } else {
+            const double b = d1.DotProduct(d2);
+            const double denominator = a * e - b * b;
+            s = (denominator > epsilon) ? ProximityClamp((b * f - c * e) / denominator) : 0.0;
+            t = (b * s + f) / e;
+            if (t < 0.0) {
+                t = 0.0;
+                s = ProximityClamp(-c / a);
+            } else if (t > 1.0) {
+                t = 1.0;
+                s = ProximityClamp((b - c) / a);
+            }
+        }
+    }
+    const vct3 closest1 = p1 + s * d1;
+    const vct3 closest2 = p2 + t * d2;
+    return (closest1 - closest2).Norm();
+}
+
+void mtsIntuitiveResearchKitProximityMonitor::Startup(void)
+{
+    std::fill(m_pair_levels.begin(), m_pair_levels.end(), LEVEL_CLEAR);
+}
+
+void mtsIntuitiveResearchKitProximityMonitor::UpdateCapsules(void)
+{
+    // capsules are inflated by half the warning distance so
+    // overlapping boxes contain all pairs that might need a warning
+    const double margin = 0.5 * m_warning_distance * (1.0 + ProximityHysteresis);
+    m_sorted.clear();
+    for (size_t index = 0; index < m_arms.size(); ++index) {
+        ArmData * arm = m_arms[index];
+        arm->m_valid =
+            arm->measured_cp(arm->m_measured_cp).IsOK()
+            && arm->m_measured_cp.Valid()
+            && arm->base_frame(arm->m_base_frame).IsOK();
+        if (!arm->m_valid) {
+            continue;
+        }
+        const vct3 tip = arm->m_measured_cp.Position().Translation();
+        const vct3 rcm = arm->m_base_frame.Translation();
+        vct3 axis = rcm - tip;
+        const double shaftLength = axis.Norm();
+        if (shaftLength > 0.0) {
+            axis.Divide(shaftLength);
+        }
+
+        Capsule & shaft = m_capsules[2 * index];
+        shaft.arm = index;
+        shaft.p = tip;
+        shaft.q = rcm;
+        shaft.radius = m_radius;
+
+        Capsule & body = m_capsules[2 * index + 1];
+        body.arm = index;
+        body.p = rcm;
+        body.q = rcm + m_body_length * axis;
+        body.radius = m_body_radius;
+
+        for (size_t capsule = 2 * index; capsule < 2 * index + 2; ++capsule) {
+            Capsule & c = m_capsules[capsule];
+            const double inflate = c.radius + margin;
+            for (size_t i = 0; i < 3; ++i) {
+                c.lower[i] = std::min(c.p[i], c.q[i]) - inflate;
+                c.upper[i] = std::max(c.p[i], c.q[i]) + inflate;
+            }
+            m_sorted.push_back(capsule);
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitProximityMonitor::Run(void)
+{
+    ProcessQueuedCommands();
+    ProcessQueuedEvents();
+
+    UpdateCapsules();
+    std::fill(m_pair_distances.begin(), m_pair_distances.end(),
+              std::numeric_limits<double>::max());
+
+    // sweep and prune along the axis with the largest spread
+    size_t axis = 0;
+    if (!m_sorted.empty()) {
+        vct3 lower(std::numeric_limits<double>::max());
+        vct3 upper(-std::numeric_limits<double>::max());
+        for (auto index : m_sorted) {
+            const vct3 center = 0.5 * (m_capsules[index].p + m_capsules[index].q);
+            for (size_t i = 0; i < 3; ++i) {
+                lower[i] = std::min(lower[i], center[i]);
+                upper[i] = std::max(upper[i], center[i]);
+            }
+        }
+        const vct3 spread = upper - lower;
+        if (spread[1] > spread[axis]) {
+            axis = 1;
+        }
+        if (spread[2] > spread[axis]) {
+            axis = 2;
+        }
+    }
+    std::sort(m_sorted.begin(), m_sorted.end(),
+              [this, axis](const size_t a, const size_t b) {
+                  return m_capsules[a].lower[axis] < m_capsules[b].lower[axis];
+              });
+
+    const size_t nbArms = m_arms.size();
+    for (size_t i = 0; i < m_sorted.size(); ++i) {
+        const Capsule & c1 = m_capsules[m_sorted[i]];
+        for (size_t j = i + 1;
+             (j < m_sorted.size()) && (m_capsules[m_sorted[j]].lower[axis] <= c1.upper[axis]);
+             ++j) {
+            const Capsule & c2 = m_capsules[m_sorted[j]];
+            if ((c1.arm == c2.arm)
+                || (m_arms[c1.arm]->m_measured_cp.ReferenceFrame()
+                    != m_arms[c2.arm]->m_measured_cp.ReferenceFrame())) {
+                continue;
+            }
+            bool overlap = true;
+            for (size_t k = 0; k < 3; ++k) {
+                if ((c1.upper[k] < c2.lower[k]) || (c2.upper[k] < c1.lower[k])) {
+                    overlap = false;
+                }
+            }
+            if (!overlap) {
+                continue;
+            }
+            const double distance =
+                SegmentsDistance(c1.p, c1.q, c2.p, c2.q) - c1.radius - c2.radius;
+            const size_t pair = std::min(c1.arm, c2.arm) * nbArms + std::max(c1.arm, c2.arm);
+            m_pair_distances[pair] = std::min(m_pair_distances[pair], distance);
+        }
+    }
+
+    const double now = mtsManagerLocal::GetInstance()->GetTimeServer().GetRelativeTime();
+    m_minimum_distance = std::numeric_limits<double>::max();
+    for (size_t arm1 = 0; arm1 < nbArms; ++arm1) {
+        for (size_t arm2 = arm1 + 1; arm2 < nbArms; ++arm2) {
+            const double distance = m_pair_distances[arm1 * nbArms + arm2];
+            m_minimum_distance = std::min(m_minimum_distance, distance);
+            UpdatePair(arm1, arm2, distance, now);
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitProximityMonitor::UpdatePair(const size_t arm1, const size_t arm2,
+                                                         const double distance, const double now)
+{
+    const size_t pair = arm1 * m_arms.size() + arm2;
+    LevelType & level = m_pair_levels[pair];
+    const std::string & name1 = m_arms[arm1]->m_name;
+    const std::string & name2 = m_arms[arm2]->m_name;
+
+    // find new level, moving to a lower level requires some margin
+    LevelType newLevel = LEVEL_CLEAR;
+    const double hysteresis = (level == LEVEL_CLEAR) ? 0.0 : ProximityHysteresis;
+    if (distance < m_stop_distance * (1.0 + ((level == LEVEL_STOP) ? hysteresis : 0.0))) {
+        newLevel = LEVEL_STOP;
+    } else if (distance < m_warning_distance * (1.0 + hysteresis)) {
+        newLevel = LEVEL_WARNING;
+    }
+
+    if (newLevel != level) {
+        std::stringstream message;
+        message << this->GetName() << ": " << name1 << " and " << name2;
+        switch (newLevel) {
+        case LEVEL_CLEAR:
+            message << " are clear";
+            m_interface->SendStatus(message.str());
+            break;
+        case LEVEL_WARNING:
+            message << " are close (" << std::fixed << std::setprecision(1)
+                    << distance * 1000.0 << "mm)";
+            m_interface->SendWarning(message.str());
+            break;
+        case LEVEL_STOP:
+            message << " are too close (" << std::fixed << std::setprecision(1)
+                    << distance * 1000.0 << "mm)";
+            m_interface->SendWarning(message.str());
+            break;
+        }
+        level = newLevel;
+    }
+
+    if ((level == LEVEL_STOP)
+        && ((now - m_pair_last_stop[pair]) > ProximityStopPeriod)) {
+        m_pair_last_stop[pair] = now;
+        proximity_stop(prmKeyValue(name1, name2));
+    }
+}
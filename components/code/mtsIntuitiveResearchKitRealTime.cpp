@@ -0,0 +1,204 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <cisstCommon/cmnPortability.h>
+
+#if (CISST_OS == CISST_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRealTime.h>
+
+CMN_IMPLEMENT_SERVICES(mtsIntuitiveResearchKitRealTimeHook);
+
+namespace {
+    // touch stack one page at a time, recursion so each chunk is in a new frame
+    const size_t StackChunkSize = 16 * 1024;
+
+    void PrefaultStack(const size_t remaining)
+    {
+        volatile char chunk[StackChunkSize];
+        for (size_t index = 0; index < StackChunkSize; index += 4096) {
+            chunk[index] = 0;
+        }
+        if (remaining > StackChunkSize) {
+            PrefaultStack(remaining - StackChunkSize);
+        }
+        // use chunk after recursion to prevent tail call optimization
+        chunk[0] = chunk[StackChunkSize - 1];
+    }
+
+    std::atomic<bool> MemoryLocked(false);
+}
+
+bool mtsIntuitiveResearchKitRealTime::Configure(const Json::Value & jsonConfig,
+                                                std::string & errorMessage)
+{
+    Json::Value jsonValue;
+
+    jsonValue = jsonConfig["priority"];
+    if (!jsonValue.empty()) {
+        m_priority = jsonValue.asInt();
+        if ((m_priority < 0) || (m_priority > 99)) {
+            errorMessage = "\"priority\" must be between 0 and 99";
+            return false;
+        }
+    }
+
+    jsonValue = jsonConfig["cpus"];
+    if (!jsonValue.empty()) {
+        if (!jsonValue.isArray()) {
+            errorMessage = "\"cpus\" must be an array of CPU indices";
+            return false;
+        }
+        m_cpus.clear();
+        for (const auto & cpu : jsonValue) {
+            if (!cpu.isInt() || (cpu.asInt() < 0)) {
+                errorMessage = "\"cpus\" must only contain positive integers";
+                return false;
+            }
+            m_cpus.push_back(cpu.asInt());
+        }
+    }
+
+    m_lock_memory = jsonConfig.get("lock-memory", m_lock_memory).asBool();
+
+    jsonValue = jsonConfig["stack-prefault"];
+    if (!jsonValue.empty()) {
+        if (!jsonValue.isIntegral() || (jsonValue.asInt64() < 0)) {
+            errorMessage = "\"stack-prefault\" must be a positive number of bytes";
+            return false;
+        }
+        m_stack_prefault = jsonValue.asUInt64();
+    }
+    return true;
+}
+
+bool mtsIntuitiveResearchKitRealTime::IsSet(void) const
+{
+    return (m_priority > 0) || !m_cpus.empty() || m_lock_memory || (m_stack_prefault > 0);
+}
+
+bool mtsIntuitiveResearchKitRealTime::Apply(const std::string & name) const
+{
+    if (!IsSet()) {
+        return true;
+    }
+#if (CISST_OS == CISST_LINUX)
+    bool result = true;
+    // process wide, only once
+    if (m_lock_memory && !MemoryLocked.exchange(true)) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitRealTime::Apply: " << name
+                               << ", mlockall failed (" << strerror(errno) << ")" << std::endl;
+            MemoryLocked = false;
+            result = false;
+        }
+    }
+    if (!m_cpus.empty()) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (const int cpu : m_cpus) {
+            CPU_SET(cpu, &cpuSet);
+        }
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0) {
+            CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitRealTime::Apply: " << name
+                               << ", failed to set CPU affinity" << std::endl;
+            result = false;
+        }
+    }
+    if (m_priority > 0) {
+        struct sched_param parameters;
+        parameters.sched_priority = m_priority;
+        const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+        if (error != 0) {
+            CMN_LOG_INIT_ERROR << "mtsIntuitiveResearchKitRealTime::Apply: " << name
+                               << ", failed to set SCHED_FIFO priority " << m_priority
+                               << " (" << strerror(error) << ")" << std::endl;
+            result = false;
+        }
+    }
+    if (m_stack_prefault > 0) {
+        PrefaultStack(m_stack_prefault);
+    }
+    if (result) {
+        CMN_LOG_INIT_VERBOSE << "mtsIntuitiveResearchKitRealTime::Apply: " << name
+                             << ", real-time settings applied" << std::endl;
+    }
+    return result;
+#else
+    CMN_LOG_INIT_WARNING << "mtsIntuitiveResearchKitRealTime::Apply: " << name
+                         << ", real-time settings are only supported on Linux" << std::endl;
+    return false;
+#endif
+}
+
+size_t mtsIntuitiveResearchKitRealTime::CheckConflicts(const std::vector<TaskType> & tasks,
+                                                       const double highRatePeriod)
+{
+    size_t conflicts = 0;
+    for (size_t first = 0; first < tasks.size(); ++first) {
+        const TaskType & task1 = tasks[first];
+        if ((task1.period <= 0.0) || (task1.period > highRatePeriod)) {
+            continue;
+        }
+        for (size_t second = first + 1; second < tasks.size(); ++second) {
+            const TaskType & task2 = tasks[second];
+            if ((task2.period <= 0.0) || (task2.period > highRatePeriod)) {
+                continue;
+            }
+            for (const int cpu : task1.settings.CPUs()) {
+                if (std::find(task2.settings.CPUs().begin(),
+                              task2.settings.CPUs().end(),
+                              cpu) != task2.settings.CPUs().end()) {
+                    CMN_LOG_INIT_WARNING << "mtsIntuitiveResearchKitRealTime::CheckConflicts: high rate tasks \""
+                                         << task1.name << "\" (" << task1.period * 1000.0 << "ms) and \""
+                                         << task2.name << "\" (" << task2.period * 1000.0
+                                         << "ms) can both run on CPU " << cpu << std::endl;
+                    ++conflicts;
+                    break;
+                }
+            }
+        }
+    }
+    return conflicts;
+}
+
+mtsIntuitiveResearchKitRealTimeHook::mtsIntuitiveResearchKitRealTimeHook(const std::string & componentName,
+                                                                         const std::string & targetName,
+                                                                         const mtsIntuitiveResearchKitRealTime & settings):
+    mtsTaskPeriodic(componentName, 0.0),
+    m_target_name(targetName),
+    m_settings(settings)
+{
+}
+
+void mtsIntuitiveResearchKitRealTimeHook::Run(void)
+{
+    if (!m_applied) {
+        m_applied = true;
+        m_settings.Apply(m_target_name);
+    }
+}
@@ -0,0 +1,368 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-27
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <cisstCommon/cmnPortability.h>
+
+#if (CISST_OS == CISST_LINUX) || (CISST_OS == CISST_DARWIN)
+#define RECORDER_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <json/json.h>
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRecorder.h>
+
+CMN_IMPLEMENT_SERVICES_DERIVED(mtsIntuitiveResearchKitRecorder, mtsTaskPeriodic);
+
+mtsIntuitiveResearchKitRecorderChannel::mtsIntuitiveResearchKitRecorderChannel(const std::string & name,
+                                                                               const unsigned int fields,
+                                                                               const size_t numberOfJoints,
+                                                                               const size_t capacity):
+    m_name(name),
+    m_fields(fields),
+    m_number_of_joints(numberOfJoints),
+    m_capacity(capacity),
+    m_head(0),
+    m_tail(0),
+    m_dropped(0)
+{
+    m_record_size = ColumnNames().size();
+    m_buffer.resize(m_record_size * m_capacity, 0.0);
+}
+
+std::vector<std::string> mtsIntuitiveResearchKitRecorderChannel::ColumnNames(void) const
+{
+    std::vector<std::string> names = {"time", "valid"};
+    const auto addJoints = [&](const std::string & prefix) {
+        for (const std::string & type : {"position", "velocity", "effort"}) {
+            for (size_t joint = 0; joint < m_number_of_joints; ++joint) {
+                names.push_back(prefix + "/" + type + "/" + std::to_string(joint));
+            }
+        }
+    };
+    if (m_fields & FIELD_MEASURED_JS) {
+        addJoints("measured_js");
+    }
+    if (m_fields & FIELD_SETPOINT_JS) {
+        addJoints("setpoint_js");
+    }
+    if (m_fields & FIELD_MEASURED_CP) {
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t col = 0; col < 3; ++col) {
+                names.push_back("measured_cp/rotation/" + std::to_string(row) + std::to_string(col));
+            }
+        }
+        names.push_back("measured_cp/translation/x");
+        names.push_back("measured_cp/translation/y");
+        names.push_back("measured_cp/translation/z");
+    }
+    if (m_fields & FIELD_BODY_MEASURED_CF) {
+        for (const std::string & axis : {"fx", "fy", "fz", "tx", "ty", "tz"}) {
+            names.push_back("body/measured_cf/" + axis);
+        }
+    }
+    return names;
+}
+
+mtsIntuitiveResearchKitRecorder::mtsIntuitiveResearchKitRecorder(const std::string & componentName,
+                                                                 const double periodInSeconds):
+    mtsTaskPeriodic(componentName, periodInSeconds),
+    m_file_name(componentName + ".dvrk-rec"),
+    m_chunk_size(64 * 1024 * 1024),
+    m_file_descriptor(-1),
+    m_chunk(nullptr),
+    m_chunk_offset(0),
+    m_chunk_used(0),
+    m_error(false),
+    m_records(0)
+{
+}
+
+mtsIntuitiveResearchKitRecorder::~mtsIntuitiveResearchKitRecorder()
+{
+    for (auto channel : m_channels) {
+        delete channel;
+    }
+}
+
+mtsIntuitiveResearchKitRecorderChannel *
+mtsIntuitiveResearchKitRecorder::AddChannel(const std::string & name,
+                                            const unsigned int fields,
+                                            const size_t numberOfJoints)
+{
+    // ring large enough for a few periods of the recorder at 2 kHz
+    const size_t capacity = std::max(static_cast<size_t>(1024),
+                                     static_cast<size_t>(4.0 * GetPeriodicity() * 2000.0));
+    mtsIntuitiveResearchKitRecorderChannel * channel =
+        new mtsIntuitiveResearchKitRecorderChannel(name, fields, numberOfJoints, capacity);
+    m_channels.push_back(channel);
+    return channel;
+}
+
+void mtsIntuitiveResearchKitRecorder::Startup(void)
+{
+#ifdef RECORDER_POSIX
+    m_file_descriptor = open(m_file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_file_descriptor < 0) {
+        CMN_LOG_CLASS_INIT_ERROR << "Startup: " << this->GetName()
+                                 << ", failed to create file \"" << m_file_name << "\"" << std::endl;
+        m_error = true;
+        return;
+    }
+    if (!MapChunk(0)) {
+        return;
+    }
+
+    // schema
+    Json::Value schema;
+    for (auto channel : m_channels) {
+        Json::Value arm;
+        arm["name"] = channel->Name();
+        arm["record-size"] = static_cast<Json::UInt64>(channel->RecordSize());
+        arm["number-of-joints"] = static_cast<Json::UInt64>(channel->NumberOfJoints());
+        for (const auto & column : channel->ColumnNames()) {
+            arm["columns"].append(column);
+        }
+        schema["arms"].append(arm);
+    }
+    Json::FastWriter writer;
+    std::string schemaText = writer.write(schema);
+    schemaText.resize(((schemaText.size() + 7) / 8) * 8, ' ');
+
+    const uint32_t version = RECORDER_VERSION;
+    const uint32_t schemaSize = static_cast<uint32_t>(schemaText.size());
+    Write(RECORDER_MAGIC, 8);
+    Write(&version, sizeof(version));
+    Write(&schemaSize, sizeof(schemaSize));
+    Write(schemaText.data(), schemaText.size());
+
+    CMN_LOG_CLASS_INIT_VERBOSE << "Startup: " << this->GetName()
+                               << ", recording to \"" << m_file_name << "\"" << std::endl;
+#else
+    CMN_LOG_CLASS_INIT_ERROR << "Startup: " << this->GetName()
+                             << ", recorder is only supported on POSIX systems" << std::endl;
+    m_error = true;
+#endif
+}
+
+void mtsIntuitiveResearchKitRecorder::Run(void)
+{
+    ProcessQueuedCommands();
+    ProcessQueuedEvents();
+    Drain();
+}
+
+void mtsIntuitiveResearchKitRecorder::Drain(void)
+{
+    for (uint32_t index = 0; index < m_channels.size(); ++index) {
+        mtsIntuitiveResearchKitRecorderChannel * channel = m_channels[index];
+        const size_t recordBytes = channel->RecordSize() * sizeof(double);
+        const uint32_t header[2] = {index, 0};
+        const double * records;
+        size_t count;
+        // two passes max since the ring wraps once
+        while ((count = channel->Available(records)) > 0) {
+            if (!m_error) {
+                for (size_t record = 0; record < count; ++record) {
+                    Write(header, sizeof(header));
+                    Write(records + record * channel->RecordSize(), recordBytes);
+                }
+                m_records += count;
+            }
+            // always release so the arm doesn't start dropping
+            channel->Release(count);
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitRecorder::Cleanup(void)
+{
+    Drain();
+#ifdef RECORDER_POSIX
+    if (m_chunk) {
+        munmap(m_chunk, m_chunk_size);
+        m_chunk = nullptr;
+    }
+    if (m_file_descriptor >= 0) {
+        // remove unused part of last chunk
+        if (ftruncate(m_file_descriptor, m_chunk_offset + m_chunk_used) != 0) {
+            CMN_LOG_CLASS_RUN_ERROR << "Cleanup: " << this->GetName()
+                                    << ", failed to truncate \"" << m_file_name << "\"" << std::endl;
+        }
+        close(m_file_descriptor);
+        m_file_descriptor = -1;
+    }
+#endif
+    for (auto channel : m_channels) {
+        if (channel->Dropped() > 0) {
+            CMN_LOG_CLASS_RUN_WARNING << "Cleanup: " << this->GetName() << ", "
+                                      << channel->Dropped() << " record(s) dropped for "
+                                      << channel->Name() << std::endl;
+        }
+    }
+    CMN_LOG_CLASS_RUN_VERBOSE << "Cleanup: " << this->GetName() << ", "
+                              << m_records << " record(s) saved in \"" << m_file_name << "\"" << std::endl;
+}
+
+bool mtsIntuitiveResearchKitRecorder::MapChunk(const size_t offset)
+{
+#ifdef RECORDER_POSIX
+    if (m_chunk) {
+        munmap(m_chunk, m_chunk_size);
+        m_chunk = nullptr;
+    }
+    if (ftruncate(m_file_descriptor, offset + m_chunk_size) != 0) {
+        CMN_LOG_CLASS_RUN_ERROR << "MapChunk: " << this->GetName()
+                                << ", failed to grow \"" << m_file_name << "\"" << std::endl;
+        m_error = true;
+        return false;
+    }
+    void * address = mmap(nullptr, m_chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          m_file_descriptor, offset);
+    if (address == MAP_FAILED) {
+        CMN_LOG_CLASS_RUN_ERROR << "MapChunk: " << this->GetName()
+                                << ", failed to map \"" << m_file_name << "\"" << std::endl;
+        m_error = true;
+        return false;
+    }
+    m_chunk = static_cast<char *>(address);
+    m_chunk_offset = offset;
+    m_chunk_used = 0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool mtsIntuitiveResearchKitRecorder::Write(const void * data, const size_t size)
+{
+    const char * source = static_cast<const char *>(data);
+    size_t left = size;
+    while (left > 0) {
+        if (m_error) {
+            return false;
+        }
+        if (m_chunk_used == m_chunk_size) {
+            if (!MapChunk(m_chunk_offset + m_chunk_size)) {
+                return false;
+            }
+        }
+        const size_t bytes = std::min(left, m_chunk_size - m_chunk_used);
+        memcpy(m_chunk + m_chunk_used, source, bytes);
+        m_chunk_used += bytes;
+        source += bytes;
+        left -= bytes;
+    }
+    return true;
+}
+
+bool mtsIntuitiveResearchKitRecorderReader::Open(const std::string & fileName,
+                                                 std::string & errorMessage)
+{
+    m_arms.clear();
+    m_truncated = false;
+    m_file.open(fileName, std::ios::binary);
+    if (!m_file.is_open()) {
+        errorMessage = "failed to open \"" + fileName + "\"";
+        return false;
+    }
+
+    // header
+    char magic[8];
+    uint32_t version, schemaSize;
+    m_file.read(magic, sizeof(magic));
+    m_file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    m_file.read(reinterpret_cast<char *>(&schemaSize), sizeof(schemaSize));
+    if (!m_file || (strncmp(magic, RECORDER_MAGIC, sizeof(magic)) != 0)) {
+        errorMessage = "\"" + fileName + "\" is not a recorder file";
+        return false;
+    }
+    if (version != RECORDER_VERSION) {
+        errorMessage = "unsupported version " + std::to_string(version)
+            + ", expected " + std::to_string(RECORDER_VERSION);
+        return false;
+    }
+
+    // schema
+    std::string schemaText(schemaSize, ' ');
+    m_file.read(&schemaText[0], schemaSize);
+    Json::Value schema;
+    Json::Reader reader;
+    if (!m_file || !reader.parse(schemaText, schema)) {
+        errorMessage = "failed to parse schema: " + reader.getFormattedErrorMessages();
+        return false;
+    }
+    const Json::Value jsonArms = schema["arms"];
+    for (unsigned int index = 0; index < jsonArms.size(); ++index) {
+        ArmType arm;
+        arm.name = jsonArms[index]["name"].asString();
+        arm.record_size = jsonArms[index]["record-size"].asUInt();
+        const Json::Value jsonColumns = jsonArms[index]["columns"];
+        for (unsigned int column = 0; column < jsonColumns.size(); ++column) {
+            arm.columns.push_back(jsonColumns[column].asString());
+        }
+        m_arms.push_back(arm);
+    }
+    return true;
+}
+
+int mtsIntuitiveResearchKitRecorderReader::ArmIndex(const std::string & name) const
+{
+    for (size_t index = 0; index < m_arms.size(); ++index) {
+        if (m_arms[index].name == name) {
+            return static_cast<int>(index);
+        }
+    }
+    return -1;
+}
+
+int mtsIntuitiveResearchKitRecorderReader::ColumnIndex(const size_t arm, const std::string & column) const
+{
+    const std::vector<std::string> & columns = m_arms.at(arm).columns;
+    const auto found = std::find(columns.begin(), columns.end(), column);
+    if (found == columns.end()) {
+        return -1;
+    }
+    return static_cast<int>(found - columns.begin());
+}
+
+bool mtsIntuitiveResearchKitRecorderReader::Next(size_t & arm, std::vector<double> & record)
+{
+    uint32_t header[2];
+    if (!m_file.read(reinterpret_cast<char *>(header), sizeof(header))) {
+        return false;
+    }
+    if (header[0] >= m_arms.size()) {
+        m_truncated = true;
+        return false;
+    }
+    arm = header[0];
+    record.resize(m_arms[arm].record_size);
+    if (!m_file.read(reinterpret_cast<char *>(record.data()), record.size() * sizeof(double))) {
+        m_truncated = true;
+        return false;
+    }
+    return true;
+}
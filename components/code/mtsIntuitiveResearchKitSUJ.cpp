@@ -17,12 +17,15 @@ http://www.cisst.org/cisst/license.txt.
 */
 
 // system include
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <time.h>
 
 // cisst
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitSUJ.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKit.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
 #include <cisstMultiTask/mtsInterfaceProvided.h>
 #include <cisstMultiTask/mtsInterfaceRequired.h>
 #include <cisstParameterTypes/prmStateJoint.h>
@@ -38,6 +41,8 @@ const size_t MUX_MAX_INDEX = 15;
 
 // empirical value, tradeoff between speed and stability of analog
 // input
+// default number of samples per mux index at the default arm period,
+// converted to a duration so the scan time doesn't depend on the period
 const size_t ANALOG_SAMPLE_NUMBER = 60;
 
 // DO NOT set value below 3, this value might go down when the
@@ -360,6 +365,15 @@ public:
     mtsFunctionWrite mSetArmBaseFrame;
     vctFrame4x4<double> mBaseFrame;
     bool mBaseFrameValid;
+    // last base frame sent to the arm, set_base_frame is only called
+    // when it changes
+    struct {
+        bool sent = false;
+        vctFrm4x4 goal;
+        bool valid = false;
+        std::string reference_frame;
+        double time = 0.0;
+    } mBaseFrameSent;
     // for ECM only, get current position
     mtsFunctionRead mGetArmPositionCartesianLocal;
 
@@ -402,6 +416,9 @@ mtsIntuitiveResearchKitSUJ::mtsIntuitiveResearchKitSUJ(const mtsTaskPeriodicCons
 void mtsIntuitiveResearchKitSUJ::Init(void)
 {
     mSimulatedTimer = 0.0;
+    m_mux_message_site =
+        m_messages.AddSite(mtsIntuitiveResearchKitMessages::LEVEL_WARNING,
+                           "unexpected multiplexer value");
 
     // initialize arm pointers
     for (size_t armIndex = 0; armIndex < 4; ++armIndex) {
@@ -469,7 +486,14 @@ void mtsIntuitiveResearchKitSUJ::Init(void)
     mMuxState.SetSize(4);
     mVoltages.SetSize(4);
     mBrakeCurrents.SetSize(4);
-    mVoltageSamples.SetSize(mVoltageSamplesNumber);
+    mVoltageSum.SetSize(4);
+    m_mux_scan.sample_min.SetSize(4);
+    m_mux_scan.sample_max.SetSize(4);
+    m_mux_scan.samples_min = mVoltageSamplesNumber;
+    mVoltageSamplesComplete = false;
+    mVoltagesByMux.SetSize(MUX_MAX_INDEX + 1, 4);
+    mVoltagesByMux.SetAll(0.0);
+    mPotPositions.SetSize(2 * MUX_ARRAY_SIZE, 4);
     mVoltageSamplesCounter = 0;
 
     // Arm IO
@@ -531,16 +555,13 @@ void mtsIntuitiveResearchKitSUJ::Init(void)
 
 void mtsIntuitiveResearchKitSUJ::Configure(const std::string & filename)
 {
-    std::ifstream jsonStream;
-    jsonStream.open(filename.c_str());
-
     Json::Value jsonConfig;
-    Json::Reader jsonReader;
-    if (!jsonReader.parse(jsonStream, jsonConfig)) {
+    std::string jsonErrors;
+    if (!mtsIntuitiveResearchKitConfigCache::Parse(filename, jsonConfig, jsonErrors)) {
         CMN_LOG_CLASS_INIT_ERROR << "Configure "<< this->GetName()
                                  << ": failed to parse configuration file \""
                                  << filename << "\"\n"
-                                 << jsonReader.getFormattedErrorMessages();
+                                 << jsonErrors;
         exit(EXIT_FAILURE);
     }
 
@@ -553,6 +574,38 @@ void mtsIntuitiveResearchKitSUJ::Configure(const std::string & filename)
     // base component configuration
     mtsComponent::ConfigureJSON(jsonConfig);
 
+    // multiplexer scan, all optional.  Default number of samples
+    // based on sampling time so it doesn't depend on the SUJ period
+    double sampleTime = ANALOG_SAMPLE_NUMBER * mtsIntuitiveResearchKit::ArmPeriod;
+    const Json::Value jsonMux = jsonConfig["mux"];
+    if (!jsonMux.isNull()) {
+        sampleTime = jsonMux.get("sample-time", sampleTime).asDouble();
+        if (sampleTime <= 0.0) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: \"mux\": \"sample-time\" must be strictly positive" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    mVoltageSamplesNumber = std::max(static_cast<size_t>(1),
+                                     static_cast<size_t>(std::lround(sampleTime / ExpectedPeriod())));
+    m_mux_scan.samples_min = mVoltageSamplesNumber;
+    if (!jsonMux.isNull()) {
+        m_mux_scan.settle_time = jsonMux.get("settle-time", m_mux_scan.settle_time).asDouble();
+        mVoltageSamplesNumber = jsonMux.get("samples-max", static_cast<Json::UInt>(mVoltageSamplesNumber)).asUInt();
+        m_mux_scan.samples_min = jsonMux.get("samples-min", static_cast<Json::UInt>(mVoltageSamplesNumber)).asUInt();
+        m_mux_scan.noise_tolerance = jsonMux.get("noise-tolerance", m_mux_scan.noise_tolerance).asDouble();
+        m_mux_scan.partial_updates = jsonMux.get("partial-updates", m_mux_scan.partial_updates).asBool();
+        if ((mVoltageSamplesNumber == 0)
+            || (m_mux_scan.samples_min == 0)
+            || (m_mux_scan.samples_min > mVoltageSamplesNumber)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: \"mux\": \"samples-min\" and \"samples-max\" must be greater than 0 and min can't be greater than max" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (m_mux_scan.settle_time < 0.0) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: \"mux\": \"settle-time\" can't be negative" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
     // find all arms, there should be 4 of them
     const Json::Value jsonArms = jsonConfig["arms"];
     if (jsonArms.size() != 4) {
@@ -694,6 +747,36 @@ void mtsIntuitiveResearchKitSUJ::Configure(const std::string & filename)
         arm->mWorldToSUJ.From(transform);
         cmnDataJSON<vctFrm3>::DeSerializeText(transform, jsonArm["suj-tip-to-tool-origin"]);
         arm->mSUJToArmBase.From(transform);
+
+        // pot settings are used by mux index, check sizes now
+        for (size_t potArray = 0; potArray < 2; ++potArray) {
+            if ((arm->mVoltageToPositionOffsets[potArray].size() != MUX_ARRAY_SIZE)
+                || (arm->mVoltageToPositionScales[potArray].size() != MUX_ARRAY_SIZE)) {
+                CMN_LOG_CLASS_INIT_ERROR << "Configure: offsets and scales for SUJ \""
+                                         << name << "\" must contain " << MUX_ARRAY_SIZE
+                                         << " elements" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // copy pot settings in contiguous buffers, one row per mux index
+    // and one column per arm, see GetAndConvertPotentiometerValues
+    mPotScales.SetSize(2 * MUX_ARRAY_SIZE, 4);
+    mPotOffsets.SetSize(2 * MUX_ARRAY_SIZE, 4);
+    mPotScales.SetAll(0.0);
+    mPotOffsets.SetAll(0.0);
+    for (size_t armIndex = 0; armIndex < 4; ++armIndex) {
+        arm = Arms[armIndex];
+        if (!arm) {
+            continue;
+        }
+        for (size_t potArray = 0; potArray < 2; ++potArray) {
+            for (size_t pot = 0; pot < MUX_ARRAY_SIZE; ++pot) {
+                mPotScales.Element(potArray * MUX_ARRAY_SIZE + pot, armIndex) = arm->mVoltageToPositionScales[potArray][pot];
+                mPotOffsets.Element(potArray * MUX_ARRAY_SIZE + pot, armIndex) = arm->mVoltageToPositionOffsets[potArray][pot];
+            }
+        }
     }
 }
 
@@ -710,7 +793,7 @@ void mtsIntuitiveResearchKitSUJ::UpdateOperatingStateAndBusy(const prmOperatingS
 
 void mtsIntuitiveResearchKitSUJ::StateChanged(void)
 {
-    const std::string newState = mArmState.CurrentState();
+    const std::string & newState = mArmState.CurrentState();
     // update state table
     mStateTableState.Start();
     mStateTableStateCurrent = newState;
@@ -843,17 +926,23 @@ void mtsIntuitiveResearchKitSUJ::TransitionEnabled(void)
 {
     // move to next stage if desired state is different
     if (mArmState.DesiredStateIsNotCurrent()) {
-        mArmState.SetCurrentState(mArmState.DesiredState());
+        mArmState.SetCurrentState(mArmState.DesiredStateIndex());
     }
 }
 
 void mtsIntuitiveResearchKitSUJ::Startup(void)
 {
+    // startup is called from the task's thread
+    m_real_time.Apply(this->GetName());
+    m_heartbeat.Configure(this->GetName(), ExpectedPeriod());
+    m_messages.Start(this->GetName());
     SetDesiredState("DISABLED");
 }
 
 void mtsIntuitiveResearchKitSUJ::Run(void)
 {
+    // heartbeat for the health monitor, updated when Run returns
+    mtsIntuitiveResearchKitHeartbeat::ScopedCycle heartbeat(m_heartbeat);
     // collect data from required interfaces
     ProcessQueuedEvents();
     try {
@@ -867,7 +956,24 @@ void mtsIntuitiveResearchKitSUJ::Run(void)
     RunEvent();
     ProcessQueuedCommands();
 
+    // same messages as DispatchError/Warning/Status
+    m_messages.Dispatch([this](const mtsIntuitiveResearchKitMessages::LevelType level,
+                               const std::string & message) {
+            switch (level) {
+            case mtsIntuitiveResearchKitMessages::LEVEL_ERROR:
+                DispatchError(message);
+                break;
+            case mtsIntuitiveResearchKitMessages::LEVEL_WARNING:
+                DispatchWarning(message);
+                break;
+            default:
+                DispatchStatus(message);
+                break;
+            }
+        });
+
     // update all base frame kinematics
+    const double currentTime = this->StateTable.GetTic();
     // first see if there's an ECM connected
     prmPositionCartesianGet ecmPositionParam;
     prmPositionCartesianGet ecmTipToSUJBase;
@@ -906,19 +1012,32 @@ void mtsIntuitiveResearchKitSUJ::Run(void)
         arm->m_measured_cp.Position().From(armBase);
         arm->m_measured_cp.SetTimestamp(arm->m_measured_js.Timestamp());
         arm->EventPositionCartesian(arm->m_measured_cp);
-        // - set base frame for the arm
-        prmPositionCartesianSet positionSet;
-        positionSet.Goal().Assign(arm->m_measured_cp.Position());
-        positionSet.Valid() = arm->m_measured_cp.Valid();
-        positionSet.Timestamp() = arm->m_measured_cp.Timestamp();
-        positionSet.ReferenceFrame() = arm->m_measured_cp.ReferenceFrame();
-        positionSet.MovingFrame() = arm->m_measured_cp.MovingFrame();
-        arm->mSetArmBaseFrame(positionSet);
+        // - set base frame for the arm if it changed, also re-send
+        // periodically in case the arm has been restarted
+        if (!arm->mBaseFrameSent.sent
+            || (arm->mBaseFrameSent.valid != arm->m_measured_cp.Valid())
+            || (arm->mBaseFrameSent.reference_frame != arm->m_measured_cp.ReferenceFrame())
+            || !arm->mBaseFrameSent.goal.Equal(armBase)
+            || ((currentTime - arm->mBaseFrameSent.time) > 1.0 * cmn_s)) {
+            prmPositionCartesianSet positionSet;
+            positionSet.Goal().Assign(arm->m_measured_cp.Position());
+            positionSet.Valid() = arm->m_measured_cp.Valid();
+            positionSet.Timestamp() = arm->m_measured_cp.Timestamp();
+            positionSet.ReferenceFrame() = arm->m_measured_cp.ReferenceFrame();
+            positionSet.MovingFrame() = arm->m_measured_cp.MovingFrame();
+            arm->mSetArmBaseFrame(positionSet);
+            arm->mBaseFrameSent.sent = true;
+            arm->mBaseFrameSent.goal.Assign(armBase);
+            arm->mBaseFrameSent.valid = arm->m_measured_cp.Valid();
+            arm->mBaseFrameSent.reference_frame = arm->m_measured_cp.ReferenceFrame();
+            arm->mBaseFrameSent.time = currentTime;
+        }
     }
 }
 
 void mtsIntuitiveResearchKitSUJ::Cleanup(void)
 {
+    m_messages.Stop();
     // Disable PWM
     SetLiftVelocity(0.0);
     PWM.DisablePWM(true);
@@ -965,9 +1084,6 @@ void mtsIntuitiveResearchKitSUJ::GetRobotData(void)
         }
     }
 
-    // 30 ms is to make sure A2D stabilizes
-    const double muxCycle = 30.0 * cmn_ms;
-
     // we can start reporting some joint values after the robot is powered
     const double currentTime = this->StateTable.GetTic();
 
@@ -977,9 +1093,9 @@ void mtsIntuitiveResearchKitSUJ::GetRobotData(void)
         GetAndConvertPotentiometerValues();
 
         // time to toggle
-        if (mVoltageSamplesCounter == mVoltageSamplesNumber) {
+        if (mVoltageSamplesComplete) {
             // toggle mux
-            mMuxTimer = currentTime + muxCycle;
+            mMuxTimer = currentTime + m_mux_scan.settle_time;
             if (mMuxIndexExpected == MUX_MAX_INDEX) {
                 NoMuxReset.SetValue(false);
                 mMuxIndexExpected = 0;
@@ -989,6 +1105,7 @@ void mtsIntuitiveResearchKitSUJ::GetRobotData(void)
             }
             // reset sample counter
             mVoltageSamplesCounter = 0;
+            mVoltageSamplesComplete = false;
         }
     }
 }
@@ -1002,8 +1119,8 @@ void mtsIntuitiveResearchKitSUJ::GetAndConvertPotentiometerValues(void)
     // compute pot index
     mMuxIndex = (mMuxState[0]?1:0) + (mMuxState[1]?2:0) + (mMuxState[2]?4:0) + (mMuxState[3]?8:0);
     if (mMuxIndex != mMuxIndexExpected) {
-        DispatchWarning(this->GetName() + ": unexpected multiplexer value.");
-        CMN_LOG_CLASS_RUN_ERROR << "GetAndConvertPotentiometerValues: mux from IO board, actual: " << mMuxIndex << ", expected: " << mMuxIndexExpected << std::endl;
+        m_messages.Send(m_mux_message_site, this->StateTable.GetTic(),
+                        static_cast<double>(mMuxIndex));
         ResetMux();
         SetHomed(false);
         return;
@@ -1016,128 +1133,190 @@ void mtsIntuitiveResearchKitSUJ::GetAndConvertPotentiometerValues(void)
     const size_t indexInArray = mMuxIndex % MUX_ARRAY_SIZE; // pot index in array, 0 to 5 (0 to 3 for third array)
 
     executionResult = RobotIO.GetAnalogInputVolts(mVoltages);
-    mVoltageSamples[mVoltageSamplesCounter].ForceAssign(mVoltages);
+    // running sum, averaged when all samples have been collected.
+    // Also keep track of min and max to detect stable signals
+    if (mVoltageSamplesCounter == 0) {
+        mVoltageSum.Assign(mVoltages);
+        m_mux_scan.sample_min.Assign(mVoltages);
+        m_mux_scan.sample_max.Assign(mVoltages);
+    } else {
+        mVoltageSum.Add(mVoltages);
+        for (size_t input = 0; input < mVoltages.size(); ++input) {
+            m_mux_scan.sample_min[input] = std::min(m_mux_scan.sample_min[input], mVoltages[input]);
+            m_mux_scan.sample_max[input] = std::max(m_mux_scan.sample_max[input], mVoltages[input]);
+        }
+    }
     mVoltageSamplesCounter++;
 
-    // if we have enough samples
-    if (mVoltageSamplesCounter == mVoltageSamplesNumber) {
-        // use mVoltages to store average
-        mVoltages.Zeros();
-        for (size_t index = 0;
-             index < mVoltageSamplesNumber;
-             ++index) {
-            mVoltages.Add(mVoltageSamples[index]);
-        }
-        mVoltages.Divide(mVoltageSamplesNumber);
-        // for each arm, i.e. SUJ1, SUJ2, SUJ3, ...
-        for (size_t armIndex = 0; armIndex < 4; ++armIndex) {
-            arm = Arms[armIndex];
-            // start stable when reading 1st joint on all arms
-            if (mMuxIndex == 0) {
-                arm->mStateTable.Start();
+    // check if we have enough samples for this mux index.  Misc.
+    // voltages are not used for kinematics so the minimum is enough.
+    // For pots, the minimum is enough if all samples are within the
+    // noise tolerance.
+    mVoltageSamplesComplete = (mVoltageSamplesCounter >= mVoltageSamplesNumber);
+    if (!mVoltageSamplesComplete
+        && (mVoltageSamplesCounter >= m_mux_scan.samples_min)) {
+        if (arrayIndex == 2) {
+            mVoltageSamplesComplete = true;
+        } else if (m_mux_scan.noise_tolerance > 0.0) {
+            bool stable = true;
+            for (size_t input = 0; input < mVoltages.size(); ++input) {
+                stable &= ((m_mux_scan.sample_max[input] - m_mux_scan.sample_min[input])
+                           <= m_mux_scan.noise_tolerance);
             }
-            // all 4 analog inputs are sent to all 4 arm data structures
-            if (arrayIndex < 2) {
-                arm->mVoltages[arrayIndex][indexInArray] = mVoltages[armIndex];
-            } else {
-                if (indexInArray == 2) {
-                    if ((armIndex == 0) || (armIndex == 1) || (armIndex == 2)) {
-                        Arms[3 - armIndex]->mVoltagesExtra[indexInArray] = mVoltages[armIndex];
-                    } else if (armIndex == 3) {
+            mVoltageSamplesComplete = stable;
+        }
+    }
 
-                    }
-                } else if ((indexInArray == 3) && (armIndex == 3)) {
-                    Arms[0 /* 3 - armIndex */]->mVoltagesExtra[2] = mVoltages[armIndex];
-                } else {
-                    // normal case
-                    arm->mVoltagesExtra[indexInArray] = mVoltages[armIndex];
-                }
-            }
-            // advance state table when all joints have been read
-            if (mMuxIndex == MUX_MAX_INDEX) {
-                arm->mPositions[0].Assign(arm->mVoltageToPositionOffsets[0]);
-                arm->mPositions[0].AddElementwiseProductOf(arm->mVoltageToPositionScales[0], arm->mVoltages[0]);
-                arm->mPositions[1].Assign(arm->mVoltageToPositionOffsets[1]);
-                arm->mPositions[1].AddElementwiseProductOf(arm->mVoltageToPositionScales[1], arm->mVoltages[1]);
-
-                // ignore values on ECM arm
-                if (arm->mType == mtsIntuitiveResearchKitSUJArmData::SUJ_ECM) {
-                    // ECM has only 4 joints
-                    arm->mPositions[0][4] = 0.0;
-                    arm->mPositions[0][5] = 0.0;
-                    arm->mPositions[1][4] = 0.0;
-                    arm->mPositions[1][5] = 0.0;
-                }
+    if (!mVoltageSamplesComplete) {
+        return;
+    }
 
-                // if the arm is clutched, we keep resetting mux counter
-                if (arm->mClutched > 0) {
-                    arm->mNumberOfMuxCyclesBeforeStable = 0;
-                }
+    // one row per mux index, one column per arm
+    mVoltagesByMux.Row(mMuxIndex).RatioOf(mVoltageSum, static_cast<double>(mVoltageSamplesCounter));
 
-                // check pots when the SUJ is not clutch and if the
-                // counter for update cartesian desired position is
-                // back to zero (pot values should now be stable).
-                if ((arm->mClutched == 0) && (arm->mNumberOfMuxCyclesBeforeStable >= NUMBER_OF_MUX_CYCLE_BEFORE_STABLE)) {
-                    // compare primary and secondary pots when arm is not clutched
-                    const double angleTolerance = 1.0 * cmnPI / 180.0;
-                    const double distanceTolerance = 2.0 * cmn_mm;
-                    arm->mPositionDifference.DifferenceOf(arm->mPositions[0], arm->mPositions[1]);
-                    if ((arm->mPositionDifference[0] > distanceTolerance) ||
-                        (arm->mPositionDifference.Ref(5, 1).MaxAbsElement() > angleTolerance)) {
-                        // send messages if this is new
-                        if (arm->mPotsAgree) {
-                            mInterface->SendWarning(this->GetName() + ": " + arm->mName.Data + " primary and secondary potentiometers don't seem to agree.");
-                            CMN_LOG_CLASS_RUN_WARNING << "GetAndConvertPotentiometerValues, error: " << std::endl
-                                                      << " - " << this->GetName() << ": " << arm->mName.Data << std::endl
-                                                      << " - primary:   " << arm->mPositions[0] << std::endl
-                                                      << " - secondary: " << arm->mPositions[1] << std::endl;
-                            arm->mPotsAgree = false;
-                        }
-                    } else {
-                        if (!arm->mPotsAgree) {
-                            mInterface->SendStatus(this->GetName() + ": " + arm->mName.Data + " primary and secondary potentiometers agree.");
-                            CMN_LOG_CLASS_RUN_VERBOSE << "GetAndConvertPotentiometerValues recovery" << std::endl
-                                                      << " - " << this->GetName() << ": " << arm->mName.Data << std::endl;
-                            arm->mPotsAgree = true;
-                        }
-                    }
-                }
+    // positions can be updated once all pots have been read, i.e.
+    // at the end of secondary pots (misc. voltages are not needed)
+    // or, for partial updates, at the end of primary pots
+    const bool fullUpdate = (mMuxIndex == (2 * MUX_ARRAY_SIZE - 1));
+    const bool partialUpdate = m_mux_scan.partial_updates && (mMuxIndex == (MUX_ARRAY_SIZE - 1));
 
-                // use average of positions reported by potentiometers
-                arm->m_measured_js.Position().SumOf(arm->mPositions[0],
-                                                  arm->mPositions[1]);
-                arm->m_measured_js.Position().Divide(2.0);
-                arm->m_measured_js.SetValid(true);
+    // convert all primary and secondary pots for all arms at once
+    if (fullUpdate || partialUpdate) {
+        mPotPositions.ElementwiseProductOf(mPotScales, mVoltagesByMux.Ref(2 * MUX_ARRAY_SIZE, 4));
+        mPotPositions.Add(mPotOffsets);
+    }
 
-                // Joint forward kinematics
-                arm->mJointGet.Assign(arm->m_measured_js.Position(), arm->mManipulator.links.size());
+    // for each arm, i.e. SUJ1, SUJ2, SUJ3, ...
+    for (size_t armIndex = 0; armIndex < 4; ++armIndex) {
+        arm = Arms[armIndex];
+        // start state table when reading 1st joint on all arms, or
+        // 1st secondary pot after a partial update
+        if ((mMuxIndex == 0)
+            || (m_mux_scan.partial_updates && (mMuxIndex == MUX_ARRAY_SIZE))) {
+            arm->mStateTable.Start();
+        }
+        // misc. voltages, all 4 analog inputs are sent to all 4
+        // arm data structures.  These are read after the state table
+        // advanced so they're saved in the next state table update
+        if (arrayIndex == 2) {
+            const double voltage = mVoltagesByMux.Element(mMuxIndex, armIndex);
+            if (indexInArray == 2) {
+                if ((armIndex == 0) || (armIndex == 1) || (armIndex == 2)) {
+                    Arms[3 - armIndex]->mVoltagesExtra[indexInArray] = voltage;
+                } else if (armIndex == 3) {
 
-                // this mux cycle might have started before brakes where engaged so we can set the valid flag
-                if (arm->mNumberOfMuxCyclesBeforeStable < NUMBER_OF_MUX_CYCLE_BEFORE_STABLE) {
-                    arm->mNumberOfMuxCyclesBeforeStable++;
-                } else {
-                    // at that point we know there has been a full mux cycle with brakes engaged
-                    // so we treat this as a fixed transformation until the SUJ move again (user clutch)
-                    arm->m_local_measured_cp.SetValid(true);
                 }
+            } else if ((indexInArray == 3) && (armIndex == 3)) {
+                Arms[0 /* 3 - armIndex */]->mVoltagesExtra[2] = voltage;
+            } else {
+                // normal case
+                arm->mVoltagesExtra[indexInArray] = voltage;
+            }
+        }
+        // update positions and advance state table
+        if (fullUpdate || partialUpdate) {
+            UpdateArmPositions(arm, armIndex, partialUpdate);
+        }
+    }
+}
 
-                // always update the global position valid flag to take into account base frame valid
-                arm->m_measured_cp.SetValid(arm->mBaseFrameValid && arm->m_local_measured_cp.Valid());
+void mtsIntuitiveResearchKitSUJ::UpdateArmPositions(mtsIntuitiveResearchKitSUJArmData * arm,
+                                                    const size_t armIndex,
+                                                    const bool primaryOnly)
+{
+    // copy voltages and positions computed for all arms
+    const size_t numberOfArrays = primaryOnly ? 1 : 2;
+    for (size_t potArray = 0; potArray < numberOfArrays; ++potArray) {
+        for (size_t pot = 0; pot < MUX_ARRAY_SIZE; ++pot) {
+            const size_t row = potArray * MUX_ARRAY_SIZE + pot;
+            arm->mVoltages[potArray][pot] = mVoltagesByMux.Element(row, armIndex);
+            arm->mPositions[potArray][pot] = mPotPositions.Element(row, armIndex);
+        }
+    }
 
-                // forward kinematic
-                vctFrm4x4 suj = arm->mManipulator.ForwardKinematics(arm->mJointGet, 6);
-                // pre and post transformations loaded from JSON file, base frame updated using events
-                arm->mPositionCartesianLocal = arm->mWorldToSUJ * suj * arm->mSUJToArmBase;
-                // update local only
-                arm->m_local_measured_cp.Position().From(arm->mPositionCartesianLocal);
-                arm->m_local_measured_cp.SetTimestamp(arm->m_measured_js.Timestamp());
-                arm->EventPositionCartesianLocal(arm->m_local_measured_cp);
+    // ignore values on ECM arm
+    if (arm->mType == mtsIntuitiveResearchKitSUJArmData::SUJ_ECM) {
+        // ECM has only 4 joints
+        arm->mPositions[0][4] = 0.0;
+        arm->mPositions[0][5] = 0.0;
+        arm->mPositions[1][4] = 0.0;
+        arm->mPositions[1][5] = 0.0;
+    }
 
-                // advance this arm state table
-                arm->mStateTable.Advance();
+    // if the arm is clutched, we keep resetting mux counter
+    if (arm->mClutched > 0) {
+        arm->mNumberOfMuxCyclesBeforeStable = 0;
+    }
+
+    // check pots when the SUJ is not clutch and if the
+    // counter for update cartesian desired position is
+    // back to zero (pot values should now be stable).
+    if (!primaryOnly
+        && (arm->mClutched == 0) && (arm->mNumberOfMuxCyclesBeforeStable >= NUMBER_OF_MUX_CYCLE_BEFORE_STABLE)) {
+        // compare primary and secondary pots when arm is not clutched
+        const double angleTolerance = 1.0 * cmnPI / 180.0;
+        const double distanceTolerance = 2.0 * cmn_mm;
+        arm->mPositionDifference.DifferenceOf(arm->mPositions[0], arm->mPositions[1]);
+        if ((arm->mPositionDifference[0] > distanceTolerance) ||
+            (arm->mPositionDifference.Ref(5, 1).MaxAbsElement() > angleTolerance)) {
+            // send messages if this is new
+            if (arm->mPotsAgree) {
+                mInterface->SendWarning(this->GetName() + ": " + arm->mName.Data + " primary and secondary potentiometers don't seem to agree.");
+                CMN_LOG_CLASS_RUN_WARNING << "GetAndConvertPotentiometerValues, error: " << std::endl
+                                          << " - " << this->GetName() << ": " << arm->mName.Data << std::endl
+                                          << " - primary:   " << arm->mPositions[0] << std::endl
+                                          << " - secondary: " << arm->mPositions[1] << std::endl;
+                arm->mPotsAgree = false;
+            }
+        } else {
+            if (!arm->mPotsAgree) {
+                mInterface->SendStatus(this->GetName() + ": " + arm->mName.Data + " primary and secondary potentiometers agree.");
+                CMN_LOG_CLASS_RUN_VERBOSE << "GetAndConvertPotentiometerValues recovery" << std::endl
+                                          << " - " << this->GetName() << ": " << arm->mName.Data << std::endl;
+                arm->mPotsAgree = true;
             }
         }
     }
+
+    // use average of positions reported by potentiometers, primary
+    // only for partial updates
+    if (primaryOnly) {
+        arm->m_measured_js.Position().Assign(arm->mPositions[0]);
+    } else {
+        arm->m_measured_js.Position().SumOf(arm->mPositions[0],
+                                          arm->mPositions[1]);
+        arm->m_measured_js.Position().Divide(2.0);
+    }
+    arm->m_measured_js.SetValid(true);
+
+    // Joint forward kinematics
+    arm->mJointGet.Assign(arm->m_measured_js.Position(), arm->mManipulator.links.size());
+
+    // this mux cycle might have started before brakes where engaged so we can set the valid flag
+    if (primaryOnly) {
+        // only full mux cycles count
+    } else if (arm->mNumberOfMuxCyclesBeforeStable < NUMBER_OF_MUX_CYCLE_BEFORE_STABLE) {
+        arm->mNumberOfMuxCyclesBeforeStable++;
+    } else {
+        // at that point we know there has been a full mux cycle with brakes engaged
+        // so we treat this as a fixed transformation until the SUJ move again (user clutch)
+        arm->m_local_measured_cp.SetValid(true);
+    }
+
+    // always update the global position valid flag to take into account base frame valid
+    arm->m_measured_cp.SetValid(arm->mBaseFrameValid && arm->m_local_measured_cp.Valid());
+
+    // forward kinematic
+    vctFrm4x4 suj = arm->mManipulator.ForwardKinematics(arm->mJointGet, 6);
+    // pre and post transformations loaded from JSON file, base frame updated using events
+    arm->mPositionCartesianLocal = arm->mWorldToSUJ * suj * arm->mSUJToArmBase;
+    // update local only
+    arm->m_local_measured_cp.Position().From(arm->mPositionCartesianLocal);
+    arm->m_local_measured_cp.SetTimestamp(arm->m_measured_js.Timestamp());
+    arm->EventPositionCartesianLocal(arm->m_local_measured_cp);
+
+    // advance this arm state table
+    arm->mStateTable.Advance();
 }
 
 void mtsIntuitiveResearchKitSUJ::SetDesiredState(const std::string & state)
@@ -0,0 +1,327 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-24
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <cisstCommon/cmnPortability.h>
+
+#if (CISST_OS == CISST_LINUX) || (CISST_OS == CISST_DARWIN)
+#define SHARED_MEMORY_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitSharedMemory.h>
+
+CMN_IMPLEMENT_SERVICES_DERIVED(mtsIntuitiveResearchKitSharedMemory, mtsTaskPeriodic);
+
+namespace {
+    inline void SharedMemoryCopy(const vctDoubleVec & source, double * destination, const size_t size) {
+        for (size_t index = 0; index < size; ++index) {
+            destination[index] = (index < source.size()) ? source.Element(index) : 0.0;
+        }
+    }
+
+    inline void SharedMemoryCopy(const vctFrm3 & frame, double * destination) {
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t col = 0; col < 3; ++col) {
+                destination[3 * row + col] = frame.Rotation().Element(row, col);
+            }
+            destination[9 + row] = frame.Translation().Element(row);
+        }
+    }
+}
+
+mtsIntuitiveResearchKitSharedMemory::mtsIntuitiveResearchKitSharedMemory(const std::string & componentName,
+                                                                         const double periodInSeconds):
+    mtsTaskPeriodic(componentName, periodInSeconds)
+{
+    m_segment_name = "/" + componentName;
+}
+
+mtsIntuitiveResearchKitSharedMemory::~mtsIntuitiveResearchKitSharedMemory()
+{
+    for (auto arm : m_arms) {
+        delete arm;
+    }
+}
+
+bool mtsIntuitiveResearchKitSharedMemory::Configure(const Json::Value & jsonConfig)
+{
+    // base component configuration
+    mtsComponent::ConfigureJSON(jsonConfig);
+
+    m_commands_enabled = jsonConfig.get("commands", false).asBool();
+
+    const Json::Value jsonArms = jsonConfig["arms"];
+    if (jsonArms.empty()) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: \"arms\" is required for " << this->GetName() << std::endl;
+        return false;
+    }
+    if ((jsonArms.size() + m_arms.size()) > SHARED_MEMORY_MAX_ARMS) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: too many arms for " << this->GetName()
+                                 << ", max is " << SHARED_MEMORY_MAX_ARMS << std::endl;
+        return false;
+    }
+
+    for (unsigned int index = 0; index < jsonArms.size(); ++index) {
+        const std::string name = jsonArms[index].asString();
+        if ((name == "") || (name.size() >= SHARED_MEMORY_NAME_SIZE)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: invalid name for arms[" << index << "] in "
+                                     << this->GetName() << std::endl;
+            return false;
+        }
+        if (this->GetInterfaceRequired(name)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: arm \"" << name << "\" is already used by "
+                                     << this->GetName() << std::endl;
+            return false;
+        }
+        ArmData * arm = new ArmData;
+        arm->m_name = name;
+        mtsInterfaceRequired * required = AddInterfaceRequired(name);
+        if (!required) {
+            delete arm;
+            return false;
+        }
+        required->AddFunction("measured_js", arm->measured_js);
+        required->AddFunction("setpoint_js", arm->setpoint_js);
+        required->AddFunction("measured_cp", arm->measured_cp);
+        required->AddFunction("measured_cv", arm->measured_cv);
+        required->AddFunction("operating_state", arm->operating_state);
+        if (m_commands_enabled) {
+            required->AddFunction("servo_jp", arm->servo_jp);
+            required->AddFunction("servo_cp", arm->servo_cp);
+        }
+        m_arms.push_back(arm);
+    }
+    return true;
+}
+
+std::vector<std::string> mtsIntuitiveResearchKitSharedMemory::ArmInterfaceNames(void) const
+{
+    std::vector<std::string> result;
+    for (auto arm : m_arms) {
+        result.push_back(arm->m_name);
+    }
+    return result;
+}
+
+void mtsIntuitiveResearchKitSharedMemory::Startup(void)
+{
+#ifdef SHARED_MEMORY_POSIX
+    // never reuse an existing segment, it might belong to another
+    // process and commands could be injected by other users
+    m_file_descriptor = shm_open(m_segment_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (m_file_descriptor < 0) {
+        if (errno == EEXIST) {
+            CMN_LOG_CLASS_INIT_ERROR << "Startup: " << this->GetName()
+                                     << ", shared memory \"" << m_segment_name
+                                     << "\" already exists, another console might be running.  If not, remove the segment left behind (e.g. /dev/shm"
+                                     << m_segment_name << ")" << std::endl;
+        } else {
+            CMN_LOG_CLASS_INIT_ERROR << "Startup: " << this->GetName()
+                                     << ", failed to create shared memory \"" << m_segment_name
+                                     << "\", " << strerror(errno) << std::endl;
+        }
+        return;
+    }
+    if (ftruncate(m_file_descriptor, sizeof(mtsSharedMemoryLayout)) != 0) {
+        CMN_LOG_CLASS_INIT_ERROR << "Startup: " << this->GetName()
+                                 << ", failed to resize shared memory \"" << m_segment_name << "\"" << std::endl;
+        Cleanup();
+        return;
+    }
+    void * address = mmap(nullptr, sizeof(mtsSharedMemoryLayout),
+                          PROT_READ | PROT_WRITE, MAP_SHARED, m_file_descriptor, 0);
+    if (address == MAP_FAILED) {
+        CMN_LOG_CLASS_INIT_ERROR << "Startup: " << this->GetName()
+                                 << ", failed to map shared memory \"" << m_segment_name << "\"" << std::endl;
+        Cleanup();
+        return;
+    }
+    m_layout = static_cast<mtsSharedMemoryLayout *>(address);
+
+    // new segment is filled with zeros, only set the non zero fields
+    m_layout->Version = SHARED_MEMORY_VERSION;
+    m_layout->NumberOfArms = static_cast<uint32_t>(m_arms.size());
+    m_layout->CommandsEnabled = m_commands_enabled ? 1 : 0;
+    for (size_t index = 0; index < m_arms.size(); ++index) {
+        strncpy(m_layout->Arms[index].Name, m_arms[index]->m_name.c_str(), SHARED_MEMORY_NAME_SIZE - 1);
+    }
+    // magic is set last so readers know the segment is ready
+    std::atomic_thread_fence(std::memory_order_release);
+    m_layout->Magic = SHARED_MEMORY_MAGIC;
+
+    CMN_LOG_CLASS_INIT_VERBOSE << "Startup: " << this->GetName()
+                               << ", created shared memory \"" << m_segment_name << "\"" << std::endl;
+#else
+    CMN_LOG_CLASS_INIT_ERROR << "Startup: " << this->GetName()
+                             << ", shared memory is only supported on POSIX systems" << std::endl;
+#endif
+}
+
+void mtsIntuitiveResearchKitSharedMemory::Run(void)
+{
+    ProcessQueuedCommands();
+    ProcessQueuedEvents();
+
+    if (!m_layout) {
+        return;
+    }
+
+    for (size_t index = 0; index < m_arms.size(); ++index) {
+        UpdateState(m_arms[index], m_layout->Arms[index]);
+        if (m_commands_enabled) {
+            ProcessCommand(m_arms[index], m_layout->Arms[index]);
+        }
+    }
+}
+
+void mtsIntuitiveResearchKitSharedMemory::Cleanup(void)
+{
+#ifdef SHARED_MEMORY_POSIX
+    if (m_layout) {
+        munmap(m_layout, sizeof(mtsSharedMemoryLayout));
+        m_layout = nullptr;
+    }
+    if (m_file_descriptor >= 0) {
+        close(m_file_descriptor);
+        m_file_descriptor = -1;
+        shm_unlink(m_segment_name.c_str());
+    }
+#endif
+    if (m_commands_dropped > 0) {
+        CMN_LOG_CLASS_RUN_VERBOSE << "Cleanup: " << this->GetName() << ", "
+                                  << m_commands_dropped << " command(s) overwritten before being processed" << std::endl;
+    }
+}
+
+void mtsIntuitiveResearchKitSharedMemory::UpdateState(ArmData * arm, mtsSharedMemoryArm & shared)
+{
+    mtsSharedMemoryArmState & state = arm->m_state;
+    state.Valid = 0;
+    double timestamp = 0.0;
+
+    if (arm->measured_js(arm->m_measured_js).IsOK()
+        && arm->m_measured_js.Valid()) {
+        state.Valid |= 1;
+        timestamp = std::max(timestamp, arm->m_measured_js.Timestamp());
+    }
+    if (arm->setpoint_js(arm->m_setpoint_js).IsOK()
+        && arm->m_setpoint_js.Valid()) {
+        state.Valid |= 2;
+        timestamp = std::max(timestamp, arm->m_setpoint_js.Timestamp());
+    }
+    if (arm->measured_cp(arm->m_measured_cp).IsOK()
+        && arm->m_measured_cp.Valid()) {
+        state.Valid |= 4;
+        timestamp = std::max(timestamp, arm->m_measured_cp.Timestamp());
+    }
+    if (arm->measured_cv(arm->m_measured_cv).IsOK()
+        && arm->m_measured_cv.Valid()) {
+        state.Valid |= 8;
+        timestamp = std::max(timestamp, arm->m_measured_cv.Timestamp());
+    }
+    arm->operating_state(arm->m_operating_state);
+
+    const size_t nbJoints = std::min(arm->m_measured_js.Position().size(),
+                                     static_cast<size_t>(SHARED_MEMORY_MAX_JOINTS));
+    state.NumberOfJoints = static_cast<uint32_t>(nbJoints);
+    state.Timestamp = timestamp;
+    state.OperatingState = static_cast<int32_t>(arm->m_operating_state.State());
+    state.IsHomed = arm->m_operating_state.IsHomed() ? 1 : 0;
+    state.IsBusy = arm->m_operating_state.IsBusy() ? 1 : 0;
+    SharedMemoryCopy(arm->m_measured_js.Position(), state.MeasuredPosition, nbJoints);
+    SharedMemoryCopy(arm->m_measured_js.Velocity(), state.MeasuredVelocity, nbJoints);
+    SharedMemoryCopy(arm->m_measured_js.Effort(), state.MeasuredEffort, nbJoints);
+    SharedMemoryCopy(arm->m_setpoint_js.Position(), state.SetpointPosition, nbJoints);
+    SharedMemoryCopy(arm->m_setpoint_js.Velocity(), state.SetpointVelocity, nbJoints);
+    SharedMemoryCopy(arm->m_setpoint_js.Effort(), state.SetpointEffort, nbJoints);
+    SharedMemoryCopy(arm->m_measured_cp.Position(), state.MeasuredFrame);
+    for (size_t index = 0; index < 3; ++index) {
+        state.MeasuredTwist[index] = arm->m_measured_cv.VelocityLinear().Element(index);
+        state.MeasuredTwist[index + 3] = arm->m_measured_cv.VelocityAngular().Element(index);
+    }
+
+    // publish in next slot of the ring, then move the head
+    const uint64_t head = shared.StateHead.load(std::memory_order_relaxed);
+    state.Counter = head;
+    WriteSlot(shared.State[head % SHARED_MEMORY_STATE_RING_SIZE], state);
+    shared.StateHead.store(head + 1, std::memory_order_release);
+}
+
+void mtsIntuitiveResearchKitSharedMemory::ProcessCommand(ArmData * arm, mtsSharedMemoryArm & shared)
+{
+    const uint64_t head = shared.CommandHead.load(std::memory_order_acquire);
+    if (head == arm->m_last_command) {
+        return;
+    }
+    // servo commands, only the latest one matters
+    m_commands_dropped += (head - arm->m_last_command - 1);
+    arm->m_last_command = head;
+
+    mtsSharedMemoryArmCommand & command = arm->m_command;
+    const mtsSharedMemoryArmCommand & slot = shared.Command[(head - 1) % SHARED_MEMORY_COMMAND_RING_SIZE];
+    // writer might be updating the slot, try a few times
+    bool read = false;
+    for (size_t attempt = 0; !read && (attempt < 3); ++attempt) {
+        read = ReadSlot(slot, command);
+    }
+    if (!read) {
+        ++m_commands_dropped;
+        return;
+    }
+
+    switch (command.Type) {
+    case mtsSharedMemoryArmCommand::SERVO_JP:
+        {
+            const size_t nbJoints = std::min(static_cast<size_t>(command.NumberOfJoints),
+                                             static_cast<size_t>(SHARED_MEMORY_MAX_JOINTS));
+            // SetSize doesn't allocate if the size doesn't change
+            arm->m_servo_jp.Goal().SetSize(nbJoints);
+            for (size_t index = 0; index < nbJoints; ++index) {
+                arm->m_servo_jp.Goal().Element(index) = command.Goal[index];
+            }
+            arm->m_servo_jp.SetTimestamp(command.Timestamp);
+            arm->servo_jp(arm->m_servo_jp);
+        }
+        break;
+    case mtsSharedMemoryArmCommand::SERVO_CP:
+        {
+            vctFrm3 & goal = arm->m_servo_cp.Goal();
+            for (size_t row = 0; row < 3; ++row) {
+                for (size_t col = 0; col < 3; ++col) {
+                    goal.Rotation().Element(row, col) = command.Frame[3 * row + col];
+                }
+                goal.Translation().Element(row) = command.Frame[9 + row];
+            }
+            // client might not send an orthonormal matrix
+            goal.Rotation().NormalizedSelf();
+            arm->m_servo_cp.SetTimestamp(command.Timestamp);
+            arm->servo_cp(arm->m_servo_cp);
+        }
+        break;
+    default:
+        break;
+    }
+}
@@ -6,7 +6,7 @@
   Author(s):  Peter Kazanzides
   Created on: 2013-12-02
 
-  (C) Copyright 2013-2014 Johns Hopkins University (JHU), All Rights Reserved.
+  (C) Copyright 2013-2021 Johns Hopkins University (JHU), All Rights Reserved.
 
 --- begin cisst license - do not edit ---
 
@@ -17,12 +17,37 @@ http://www.cisst.org/cisst/license.txt.
 --- end cisst license ---
 */
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitUDPStreamer.h>
 #include <cisstMultiTask/mtsInterfaceProvided.h>
 #include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <cisstMultiTask/mtsManagerLocal.h>
 #include <cisstParameterTypes/prmPositionCartesianGet.h>
 #include <cisstParameterTypes/prmEventButton.h>
 
+namespace {
+    // max size of UDP datagram
+    const size_t UDP_STREAMER_MAX_SIZE = 65507;
+    const size_t UDP_STREAMER_HEADER_SIZE = 24;
+    const size_t UDP_STREAMER_ARM_HEADER_SIZE = 16;
+
+    template <typename _elementType>
+    inline void UDPStreamerWrite(char * & cursor, const _elementType value) {
+        memcpy(cursor, &value, sizeof(_elementType));
+        cursor += sizeof(_elementType);
+    }
+
+    inline void UDPStreamerWrite(char * & cursor, const vctDoubleVec & values) {
+        const size_t size = values.size();
+        for (size_t index = 0; index < size; ++index) {
+            UDPStreamerWrite(cursor, values.Element(index));
+        }
+    }
+}
+
 CMN_IMPLEMENT_SERVICES_DERIVED(mtsIntuitiveResearchKitUDPStreamer, mtsTaskPeriodic)
 
 mtsIntuitiveResearchKitUDPStreamer::mtsIntuitiveResearchKitUDPStreamer(const std::string & name,
@@ -31,7 +56,9 @@ mtsIntuitiveResearchKitUDPStreamer::mtsIntuitiveResearchKitUDPStreamer(const std
     Socket(osaSocket::UDP),
     SocketConfigured(false),
     Clutch(false),
-    Coag(false)
+    Coag(false),
+    mMultiArm(false),
+    mSequence(0)
 {
     mtsInterfaceProvided * provided = AddInterfaceProvided("Configuration");
     if (provided) {
@@ -58,6 +85,9 @@ mtsIntuitiveResearchKitUDPStreamer::mtsIntuitiveResearchKitUDPStreamer(const std
 
 mtsIntuitiveResearchKitUDPStreamer::~mtsIntuitiveResearchKitUDPStreamer()
 {
+    for (auto arm : mArms) {
+        delete arm;
+    }
 }
 
 void mtsIntuitiveResearchKitUDPStreamer::Configure(const std::string &ipPort)
@@ -65,6 +95,122 @@ void mtsIntuitiveResearchKitUDPStreamer::Configure(const std::string &ipPort)
     SetDestination(ipPort);
 }
 
+bool mtsIntuitiveResearchKitUDPStreamer::Configure(const Json::Value & jsonConfig)
+{
+    Json::Value jsonValue;
+
+    // base component configuration
+    mtsComponent::ConfigureJSON(jsonConfig);
+
+    jsonValue = jsonConfig["destination"];
+    if (!jsonValue.empty()) {
+        SetDestination(jsonValue.asString());
+        if (!SocketConfigured) {
+            return false;
+        }
+    }
+
+    const Json::Value jsonArms = jsonConfig["arms"];
+    if (jsonArms.empty()) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: \"arms\" is required for " << this->GetName() << std::endl;
+        return false;
+    }
+
+    size_t maxSize = UDP_STREAMER_HEADER_SIZE;
+    for (unsigned int index = 0; index < jsonArms.size(); ++index) {
+        const Json::Value jsonArm = jsonArms[index];
+        ArmData * arm = new ArmData;
+        arm->m_name = jsonArm["name"].asString();
+        if (arm->m_name == "") {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: \"name\" is required for arms[" << index << "]" << std::endl;
+            delete arm;
+            return false;
+        }
+        if (this->GetInterfaceRequired(arm->m_name)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure: arm \"" << arm->m_name << "\" is already used by "
+                                     << this->GetName() << std::endl;
+            delete arm;
+            return false;
+        }
+        // fields
+        jsonValue = jsonArm["fields"];
+        if (jsonValue.empty()) {
+            arm->m_fields = FIELD_MEASURED_CP | FIELD_JAW;
+        } else {
+            for (unsigned int fieldIndex = 0; fieldIndex < jsonValue.size(); ++fieldIndex) {
+                const std::string field = jsonValue[fieldIndex].asString();
+                if (field == "measured_js") {
+                    arm->m_fields |= FIELD_MEASURED_JS;
+                } else if (field == "measured_cp") {
+                    arm->m_fields |= FIELD_MEASURED_CP;
+                } else if (field == "measured_cv") {
+                    arm->m_fields |= FIELD_MEASURED_CV;
+                } else if (field == "jaw") {
+                    arm->m_fields |= FIELD_JAW;
+                } else {
+                    CMN_LOG_CLASS_INIT_ERROR << "Configure: invalid field \"" << field << "\" for arm \""
+                                             << arm->m_name << "\", must be one of measured_js, measured_cp, measured_cv or jaw"
+                                             << std::endl;
+                    delete arm;
+                    return false;
+                }
+            }
+        }
+        const std::string jawCommand = jsonArm.get("jaw-command", "jaw/measured_js").asString();
+
+        // interface with only the functions needed
+        mtsInterfaceRequired * required = AddInterfaceRequired(arm->m_name);
+        if (!required) {
+            delete arm;
+            return false;
+        }
+        if (arm->m_fields & FIELD_MEASURED_JS) {
+            required->AddFunction("measured_js", arm->measured_js);
+            // joint positions, velocities and efforts, assume up to 16 joints
+            maxSize += 3 * 16 * sizeof(double);
+        }
+        if (arm->m_fields & FIELD_MEASURED_CP) {
+            required->AddFunction("measured_cp", arm->measured_cp);
+            maxSize += 7 * sizeof(double);
+        }
+        if (arm->m_fields & FIELD_MEASURED_CV) {
+            required->AddFunction("measured_cv", arm->measured_cv);
+            maxSize += 6 * sizeof(double);
+        }
+        if (arm->m_fields & FIELD_JAW) {
+            required->AddFunction(jawCommand, arm->jaw_measured_js);
+            maxSize += 3 * sizeof(double);
+        }
+        maxSize += UDP_STREAMER_ARM_HEADER_SIZE;
+        mArms.push_back(arm);
+    }
+
+    if (maxSize > UDP_STREAMER_MAX_SIZE) {
+        CMN_LOG_CLASS_INIT_ERROR << "Configure: too many arms for " << this->GetName()
+                                 << ", packet might exceed max UDP size" << std::endl;
+        return false;
+    }
+
+    // pre-allocate so Run doesn't allocate any memory
+    mPacket.resize(maxSize);
+    mMultiArm = true;
+
+    // legacy single arm interfaces are not used in multi-arm mode
+    RemoveInterfaceRequired("Arm");
+    RemoveInterfaceRequired("Clutch");
+    RemoveInterfaceRequired("Coag");
+    return true;
+}
+
+std::vector<std::string> mtsIntuitiveResearchKitUDPStreamer::ArmInterfaceNames(void) const
+{
+    std::vector<std::string> result;
+    for (auto arm : mArms) {
+        result.push_back(arm->m_name);
+    }
+    return result;
+}
+
 void mtsIntuitiveResearchKitUDPStreamer::Startup(void)
 {
 }
@@ -74,31 +220,155 @@ void mtsIntuitiveResearchKitUDPStreamer::Run(void)
     ProcessQueuedCommands();
     ProcessQueuedEvents();
 
-    if (SocketConfigured) {
-        // Packet format (9 doubles): buttons (clutch, coag), gripper, x, y, z, q0, qx, qy, qz
-        // For the buttons: 0=None, 1=Clutch, 2=Coag, 3=Both
-        double packet[9];
-        if (Clutch) {
-            packet[0] = 1.0;
-        } else {
-            packet[0] = 0.0;
+    if (!SocketConfigured) {
+        return;
+    }
+
+    if (mMultiArm) {
+        RunMultiArm();
+    } else {
+        RunSingleArm();
+    }
+}
+
+void mtsIntuitiveResearchKitUDPStreamer::RunSingleArm(void)
+{
+    // Packet format (9 doubles): buttons (clutch, coag), gripper, x, y, z, q0, qx, qy, qz
+    // For the buttons: 0=None, 1=Clutch, 2=Coag, 3=Both
+    double packet[9];
+    if (Clutch) {
+        packet[0] = 1.0;
+    } else {
+        packet[0] = 0.0;
+    }
+    if (Coag)
+        packet[0] += 2.0;
+    GetGripperPosition(packet[1]);
+    prmPositionCartesianGet posCart;
+    measured_cp(posCart);
+    vct3 pos = posCart.Position().Translation();
+    packet[2] = pos.X();
+    packet[3] = pos.Y();
+    packet[4] = pos.Z();
+    vctQuatRot3 qrot(posCart.Position().Rotation());
+    packet[5] = qrot.W();
+    packet[6] = qrot.X();
+    packet[7] = qrot.Y();
+    packet[8] = qrot.Z();
+    Socket.Send((char *)packet, sizeof(packet));
+}
+
+void mtsIntuitiveResearchKitUDPStreamer::RunMultiArm(void)
+{
+    char * cursor = mPacket.data() + UDP_STREAMER_HEADER_SIZE;
+    const char * end = mPacket.data() + mPacket.size();
+
+    unsigned short armIndex = 0;
+    for (auto arm : mArms) {
+        // arm header is written once we know what's valid
+        char * armHeader = cursor;
+        cursor += UDP_STREAMER_ARM_HEADER_SIZE;
+        unsigned short valid = 0;
+        unsigned short numberOfJoints = 0;
+        double timestamp = 0.0;
+
+        if (arm->m_fields & FIELD_MEASURED_JS) {
+            if (arm->measured_js(arm->m_measured_js).IsOK()
+                && arm->m_measured_js.Valid()) {
+                valid |= FIELD_MEASURED_JS;
+                timestamp = std::max(timestamp, arm->m_measured_js.Timestamp());
+            }
+            const vctDoubleVec & position = arm->m_measured_js.Position();
+            const vctDoubleVec & velocity = arm->m_measured_js.Velocity();
+            const vctDoubleVec & effort = arm->m_measured_js.Effort();
+            numberOfJoints = static_cast<unsigned short>(position.size());
+            // all vectors must have the same size, otherwise skip the data
+            if ((velocity.size() != numberOfJoints)
+                || (effort.size() != numberOfJoints)
+                || ((cursor + 3 * numberOfJoints * sizeof(double)) > end)) {
+                valid &= ~FIELD_MEASURED_JS;
+                numberOfJoints = 0;
+            } else {
+                UDPStreamerWrite(cursor, position);
+                UDPStreamerWrite(cursor, velocity);
+                UDPStreamerWrite(cursor, effort);
+            }
+        }
+
+        if (arm->m_fields & FIELD_MEASURED_CP) {
+            if (arm->measured_cp(arm->m_measured_cp).IsOK()
+                && arm->m_measured_cp.Valid()) {
+                valid |= FIELD_MEASURED_CP;
+                timestamp = std::max(timestamp, arm->m_measured_cp.Timestamp());
+            }
+            const vct3 & position = arm->m_measured_cp.Position().Translation();
+            const vctQuatRot3 rotation(arm->m_measured_cp.Position().Rotation(), VCT_NORMALIZE);
+            UDPStreamerWrite(cursor, position.X());
+            UDPStreamerWrite(cursor, position.Y());
+            UDPStreamerWrite(cursor, position.Z());
+            UDPStreamerWrite(cursor, rotation.W());
+            UDPStreamerWrite(cursor, rotation.X());
+            UDPStreamerWrite(cursor, rotation.Y());
+            UDPStreamerWrite(cursor, rotation.Z());
         }
-        if (Coag)
-            packet[0] += 2.0;
-        GetGripperPosition(packet[1]);
-        prmPositionCartesianGet posCart;
-        measured_cp(posCart);
-        vct3 pos = posCart.Position().Translation();
-        packet[2] = pos.X();
-        packet[3] = pos.Y();
-        packet[4] = pos.Z();
-        vctQuatRot3 qrot(posCart.Position().Rotation());
-        packet[5] = qrot.W();
-        packet[6] = qrot.X();
-        packet[7] = qrot.Y();
-        packet[8] = qrot.Z();
-        Socket.Send((char *)packet, sizeof(packet));
+
+        if (arm->m_fields & FIELD_MEASURED_CV) {
+            if (arm->measured_cv(arm->m_measured_cv).IsOK()
+                && arm->m_measured_cv.Valid()) {
+                valid |= FIELD_MEASURED_CV;
+                timestamp = std::max(timestamp, arm->m_measured_cv.Timestamp());
+            }
+            const vct3 & linear = arm->m_measured_cv.VelocityLinear();
+            const vct3 & angular = arm->m_measured_cv.VelocityAngular();
+            UDPStreamerWrite(cursor, linear.X());
+            UDPStreamerWrite(cursor, linear.Y());
+            UDPStreamerWrite(cursor, linear.Z());
+            UDPStreamerWrite(cursor, angular.X());
+            UDPStreamerWrite(cursor, angular.Y());
+            UDPStreamerWrite(cursor, angular.Z());
+        }
+
+        if (arm->m_fields & FIELD_JAW) {
+            double position = 0.0, velocity = 0.0, effort = 0.0;
+            if (arm->jaw_measured_js(arm->m_jaw_measured_js).IsOK()
+                && arm->m_jaw_measured_js.Valid()) {
+                valid |= FIELD_JAW;
+                timestamp = std::max(timestamp, arm->m_jaw_measured_js.Timestamp());
+            }
+            if (arm->m_jaw_measured_js.Position().size() > 0) {
+                position = arm->m_jaw_measured_js.Position().Element(0);
+            }
+            if (arm->m_jaw_measured_js.Velocity().size() > 0) {
+                velocity = arm->m_jaw_measured_js.Velocity().Element(0);
+            }
+            if (arm->m_jaw_measured_js.Effort().size() > 0) {
+                effort = arm->m_jaw_measured_js.Effort().Element(0);
+            }
+            UDPStreamerWrite(cursor, position);
+            UDPStreamerWrite(cursor, velocity);
+            UDPStreamerWrite(cursor, effort);
+        }
+
+        UDPStreamerWrite(armHeader, armIndex);
+        UDPStreamerWrite(armHeader, arm->m_fields);
+        UDPStreamerWrite(armHeader, valid);
+        UDPStreamerWrite(armHeader, numberOfJoints);
+        UDPStreamerWrite(armHeader, timestamp);
+        ++armIndex;
     }
+
+    // header
+    const uint32_t size = static_cast<uint32_t>(cursor - mPacket.data());
+    char * header = mPacket.data();
+    UDPStreamerWrite(header, static_cast<uint32_t>(UDP_STREAMER_MAGIC));
+    UDPStreamerWrite(header, static_cast<uint16_t>(UDP_STREAMER_VERSION));
+    UDPStreamerWrite(header, static_cast<uint16_t>(mArms.size()));
+    UDPStreamerWrite(header, static_cast<uint32_t>(mSequence));
+    UDPStreamerWrite(header, size);
+    UDPStreamerWrite(header, mtsManagerLocal::GetInstance()->GetTimeServer().GetRelativeTime());
+    ++mSequence;
+
+    Socket.Send(mPacket.data(), size);
 }
 
 void mtsIntuitiveResearchKitUDPStreamer::Cleanup(void)
@@ -16,18 +16,270 @@ http://www.cisst.org/cisst/license.txt.
 --- end cisst license ---
 */
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
 #include <sawIntuitiveResearchKit/mtsSocketBasePSM.h>
+#include <cisstVector/vctQuaternionRotation3.h>
 #include <cisstMultiTask/mtsInterfaceProvided.h>
 #include <cisstMultiTask/mtsManagerLocal.h>
 
+// little endian helpers for fixed layout packets, byte shifts so
+// result doesn't depend on host endianness
+namespace {
+    enum {POD_TYPE_COMMAND = 1, POD_TYPE_STATE = 2,
+          POD_TYPE_BUNDLE_COMMAND = 3, POD_TYPE_BUNDLE_STATE = 4,
+          POD_TYPE_REDUNDANT_COMMAND = 5};
+
+    inline void PodWrite32(char * buffer, const uint32_t value) {
+        for (size_t byte = 0; byte < 4; ++byte) {
+            buffer[byte] = static_cast<char>((value >> (8 * byte)) & 0xFF);
+        }
+    }
+
+    inline uint32_t PodRead32(const char * buffer) {
+        uint32_t value = 0;
+        for (size_t byte = 0; byte < 4; ++byte) {
+            value |= static_cast<uint32_t>(static_cast<unsigned char>(buffer[byte])) << (8 * byte);
+        }
+        return value;
+    }
+
+    inline void PodWriteDouble(char * buffer, const double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        PodWrite32(buffer, static_cast<uint32_t>(bits & 0xFFFFFFFF));
+        PodWrite32(buffer + 4, static_cast<uint32_t>(bits >> 32));
+    }
+
+    inline double PodReadDouble(const char * buffer) {
+        const uint64_t bits = static_cast<uint64_t>(PodRead32(buffer))
+            | (static_cast<uint64_t>(PodRead32(buffer + 4)) << 32);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // layout, offsets in bytes
+    // 0 magic, 4 version (16 bits) and type (16 bits), 8 id, 12 last id,
+    // 16 timestamp, 24 last timestamp, 32 state, 36 size,
+    // 40 rotation (9 doubles, row major), 112 translation (3 doubles), 136 jaw
+    inline void PodWriteHeader(char * buffer, const uint32_t type,
+                               const socketHeader & header,
+                               const socketMessages::StateType state) {
+        PodWrite32(buffer, POD_MAGIC);
+        PodWrite32(buffer + 4, POD_VERSION | (type << 16));
+        PodWrite32(buffer + 8, header.Id);
+        PodWrite32(buffer + 12, header.LastId);
+        PodWriteDouble(buffer + 16, header.Timestamp);
+        PodWriteDouble(buffer + 24, header.LastTimestamp);
+        PodWrite32(buffer + 32, static_cast<uint32_t>(state));
+        PodWrite32(buffer + 36, POD_MSG_SIZE);
+    }
+
+    inline bool PodReadHeader(const char * buffer, const size_t size, const uint32_t type,
+                              socketHeader & header,
+                              socketMessages::StateType & state) {
+        if ((size < POD_MSG_SIZE)
+            || (PodRead32(buffer) != POD_MAGIC)
+            || (PodRead32(buffer + 4) != (POD_VERSION | (type << 16)))
+            || (PodRead32(buffer + 36) != POD_MSG_SIZE)) {
+            return false;
+        }
+        header.Id = PodRead32(buffer + 8);
+        header.LastId = PodRead32(buffer + 12);
+        header.Timestamp = PodReadDouble(buffer + 16);
+        header.LastTimestamp = PodReadDouble(buffer + 24);
+        header.Size = POD_MSG_SIZE;
+        state = static_cast<socketMessages::StateType>(PodRead32(buffer + 32));
+        return true;
+    }
+
+    inline void PodWriteFrame(char * buffer, const vctFrm3 & frame) {
+        const vctMatRot3 & rotation = frame.Rotation();
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t col = 0; col < 3; ++col) {
+                PodWriteDouble(buffer + 8 * (3 * row + col), rotation.Element(row, col));
+            }
+            PodWriteDouble(buffer + 72 + 8 * row, frame.Translation().Element(row));
+        }
+    }
+
+    inline void PodReadFrame(const char * buffer, vctFrm3 & frame) {
+        vctMatRot3 rotation;
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t col = 0; col < 3; ++col) {
+                rotation.Element(row, col) = PodReadDouble(buffer + 8 * (3 * row + col));
+            }
+            frame.Translation().Element(row) = PodReadDouble(buffer + 72 + 8 * row);
+        }
+        // caller normalizes
+        frame.Rotation().Assign(rotation);
+    }
+
+    // bundle layout, same header as single arm packets but 32 is the
+    // number of arms and 36 the total size.  Records are 0 arm index,
+    // 4 arm id, 8 state, 16 rotation and translation, 112 jaw
+    inline void PodWriteBundleHeader(char * buffer, const uint32_t type,
+                                     const socketHeader & header,
+                                     const size_t nbArms) {
+        PodWrite32(buffer, POD_MAGIC);
+        PodWrite32(buffer + 4, POD_VERSION | (type << 16));
+        PodWrite32(buffer + 8, header.Id);
+        PodWrite32(buffer + 12, header.LastId);
+        PodWriteDouble(buffer + 16, header.Timestamp);
+        PodWriteDouble(buffer + 24, header.LastTimestamp);
+        PodWrite32(buffer + 32, static_cast<uint32_t>(nbArms));
+        PodWrite32(buffer + 36, static_cast<uint32_t>(POD_BUNDLE_HEADER_SIZE + nbArms * POD_RECORD_SIZE));
+    }
+
+    inline bool PodReadBundleHeader(const char * buffer, const size_t size, const uint32_t type,
+                                    socketHeader & header, size_t & nbArms) {
+        if ((size < POD_BUNDLE_HEADER_SIZE)
+            || (PodRead32(buffer) != POD_MAGIC)
+            || (PodRead32(buffer + 4) != (POD_VERSION | (type << 16)))) {
+            return false;
+        }
+        nbArms = PodRead32(buffer + 32);
+        const size_t expected = POD_BUNDLE_HEADER_SIZE + nbArms * POD_RECORD_SIZE;
+        if ((nbArms > POD_MAX_ARMS)
+            || (PodRead32(buffer + 36) != expected)
+            || (size < expected)) {
+            return false;
+        }
+        header.Id = PodRead32(buffer + 8);
+        header.LastId = PodRead32(buffer + 12);
+        header.Timestamp = PodReadDouble(buffer + 16);
+        header.LastTimestamp = PodReadDouble(buffer + 24);
+        header.Size = static_cast<int>(expected);
+        return true;
+    }
+
+    // records are also used for previous commands after a redundant
+    // command, index is then the position and 12 the timestamp
+    // relative to the packet timestamp (float)
+    inline void PodWriteRecord(char * buffer, const size_t index,
+                               const socketHeader & header,
+                               const socketMessages::StateType state,
+                               const vctFrm3 & frame, const double jaw) {
+        PodWrite32(buffer, static_cast<uint32_t>(index));
+        PodWrite32(buffer + 4, header.Id);
+        PodWrite32(buffer + 8, static_cast<uint32_t>(state));
+        PodWrite32(buffer + 12, 0);
+        PodWriteFrame(buffer + 16, frame);
+        PodWriteDouble(buffer + 112, jaw);
+    }
+
+    // returns false if record is for an unknown arm
+    inline bool PodReadRecordHeader(const char * buffer, const size_t nbArms,
+                                    size_t & index, unsigned int & id) {
+        index = PodRead32(buffer);
+        id = PodRead32(buffer + 4);
+        return (index < nbArms);
+    }
+
+    inline void PodWriteFloat(char * buffer, const float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        PodWrite32(buffer, bits);
+    }
+
+    inline float PodReadFloat(const char * buffer) {
+        const uint32_t bits = PodRead32(buffer);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // compact layout, same header as single arm packets up to 32
+    // then 32 distance to reference id (0 for keyframe), 33 state,
+    // 34 translation resolution, 38 rotation resolution (floats) and
+    // 42 values (translation, quaternion x, y, z, w and jaw) as zigzag
+    // varints, deltas if there is a reference
+    inline size_t CompactWriteVarint(char * buffer, const int64_t value) {
+        uint64_t zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+        size_t size = 0;
+        while (zigzag >= 0x80) {
+            buffer[size++] = static_cast<char>((zigzag & 0x7F) | 0x80);
+            zigzag >>= 7;
+        }
+        buffer[size++] = static_cast<char>(zigzag);
+        return size;
+    }
+
+    // returns 0 if buffer ends before the last byte
+    inline size_t CompactReadVarint(const char * buffer, const char * end, int64_t & value) {
+        uint64_t zigzag = 0;
+        size_t size = 0;
+        for (unsigned int shift = 0; shift < 64; shift += 7) {
+            if (buffer + size >= end) {
+                return 0;
+            }
+            const uint64_t byte = static_cast<unsigned char>(buffer[size++]);
+            zigzag |= (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                value = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+                return size;
+            }
+        }
+        return 0;
+    }
+
+    inline bool PodIsNewer(const unsigned int id, const unsigned int current) {
+        // restarted or newer, handles wrap around
+        return (id == 1) || (static_cast<int>(id - current) > 0);
+    }
+}
+
 mtsSocketBasePSM::mtsSocketBasePSM(const std::string & componentName, const double periodInSeconds,
                                    const std::string & ip, const unsigned int port, bool isServer) :
     mtsTaskPeriodic(componentName, periodInSeconds),
+    mWireFormat(WIRE_CISST),
+    mReceiveMode(RECEIVE_BLOCKING),
+    mReceivedTime(0.0),
+    mPlayoutDelay(0.0),
     mIsServer(isServer),
     mTimeServer(mtsComponentManager::GetInstance()->GetTimeServer()),
     mPacketsLost(0),
-    mPacketsDelayed(0)
+    mPacketsDelayed(0),
+    mPacketsCoalesced(0),
+    mLoopTime(0.0),
+    mClockOffset(0.0),
+    mOneWayLatency(0.0),
+    mJitter(0.0),
+    mLastCoalesced(0)
 {
+    mClock.Synchronized = false;
+    mClock.LastId = 0;
+    mClock.LastTransit = 0.0;
+    mClock.NbSamples = 0;
+    mClock.Next = 0;
+
+    // 1 micrometer, quaternion and jaw with 6 decimals
+    SetCompactResolution(1.0 * cmn_um, 1.0e-6);
+    mCompact.KeyframePeriod = 100;
+    mCompact.SinceKeyframe = 0;
+    mCompact.Acknowledged = 0;
+    mCompact.Unanswered = 0;
+    mCompact.MissingReference = 0;
+    for (size_t index = 0; index < COMPACT_HISTORY; ++index) {
+        mCompact.Sent[index].Id = 0;
+        mCompact.Received[index].Id = 0;
+    }
+
+    mReceiver.Middle = 1;
+    mReceiver.Back = 2;
+    mReceiver.Front = 0;
+    mReceiver.Received = 0;
+    mReceiver.Consumed = 0;
+    mReceiver.Running = false;
+
+    // first arm
+    mCommands.push_back(&Command.Data);
+    mStates.push_back(&State.Data);
+
     Command.Socket = new osaSocket(osaSocket::UDP);
     Command.IpPort = port;
     State.Socket = new osaSocket(osaSocket::UDP);
@@ -36,7 +288,11 @@ mtsSocketBasePSM::mtsSocketBasePSM(const std::string & componentName, const doub
 
     this->StateTable.AddData(mPacketsLost, "PacketsLost");
     this->StateTable.AddData(mPacketsDelayed, "PacketsDelayed");
+    this->StateTable.AddData(mPacketsCoalesced, "PacketsCoalesced");
     this->StateTable.AddData(mLoopTime, "LoopTime");
+    this->StateTable.AddData(mClockOffset, "ClockOffset");
+    this->StateTable.AddData(mOneWayLatency, "OneWayLatency");
+    this->StateTable.AddData(mJitter, "Jitter");
     this->StateTable.AddData(Command.Data.Header.Id, "CommandId");
     this->StateTable.AddData(State.Data.Header.Id, "StateId");
 
@@ -46,7 +302,11 @@ mtsSocketBasePSM::mtsSocketBasePSM(const std::string & componentName, const doub
         interfaceProvided->AddCommandReadState(this->StateTable, StateTable.PeriodStats, "period_statistics");
         interfaceProvided->AddCommandReadState(this->StateTable, mPacketsLost, "GetPacketsLost");
         interfaceProvided->AddCommandReadState(this->StateTable, mPacketsDelayed, "GetPacketsDelayed");
+        interfaceProvided->AddCommandReadState(this->StateTable, mPacketsCoalesced, "GetPacketsCoalesced");
         interfaceProvided->AddCommandReadState(this->StateTable, mLoopTime, "GetLoopTime");
+        interfaceProvided->AddCommandReadState(this->StateTable, mClockOffset, "GetClockOffset");
+        interfaceProvided->AddCommandReadState(this->StateTable, mOneWayLatency, "GetOneWayLatency");
+        interfaceProvided->AddCommandReadState(this->StateTable, mJitter, "GetJitter");
         if (mIsServer) {
             interfaceProvided->AddCommandReadState(this->StateTable, Command.Data.Header.Id, "GetLastReceivedPacketId");
             interfaceProvided->AddCommandReadState(this->StateTable, State.Data.Header.Id, "GetLastSentPacketId");
@@ -57,17 +317,93 @@ mtsSocketBasePSM::mtsSocketBasePSM(const std::string & componentName, const doub
     }
 }
 
+void mtsSocketBasePSM::Startup(void)
+{
+    if (mReceiveMode == RECEIVE_THREAD) {
+        mReceiver.Running = true;
+        mReceiver.Thread = std::thread(&mtsSocketBasePSM::ReceiveThread, this);
+    }
+}
+
 void mtsSocketBasePSM::Cleanup(void)
 {
+    if (mReceiver.Running) {
+        mReceiver.Running = false;
+        mReceiver.Thread.join();
+    }
     Command.Socket->Close();
     State.Socket->Close();
 }
 
+osaSocket * mtsSocketBasePSM::IncomingSocket(void)
+{
+    return mIsServer ? Command.Socket : State.Socket;
+}
+
+void mtsSocketBasePSM::ReceiveThread(void)
+{
+    osaSocket * socket = IncomingSocket();
+    while (mReceiver.Running) {
+        // timeout only used to check if thread should stop
+        const int bytesRead = socket->Receive(mReceiver.Buffer[mReceiver.Back], BUFFER_SIZE, 10.0 * cmn_ms);
+        if (bytesRead > 0) {
+            mReceiver.Size[mReceiver.Back] = bytesRead;
+            mReceiver.Time[mReceiver.Back] = mTimeServer.GetRelativeTime();
+            const unsigned int previous = mReceiver.Middle.exchange(mReceiver.Back | RECEIVE_FRESH);
+            mReceiver.Back = previous & RECEIVE_INDEX_MASK;
+            ++mReceiver.Received;
+        }
+    }
+}
+
+int mtsSocketBasePSM::ReceiveLatest(char * buffer)
+{
+    mLastCoalesced = 0;
+
+    if (mReceiveMode == RECEIVE_THREAD) {
+        if (!(mReceiver.Middle.load() & RECEIVE_FRESH)) {
+            return 0;
+        }
+        const unsigned int previous = mReceiver.Middle.exchange(mReceiver.Front);
+        mReceiver.Front = previous & RECEIVE_INDEX_MASK;
+        // packets overwritten by the receive thread since last call
+        const unsigned int received = mReceiver.Received;
+        const unsigned int newPackets = received - mReceiver.Consumed;
+        mReceiver.Consumed = received;
+        if (newPackets > 1) {
+            mLastCoalesced = newPackets - 1;
+        }
+        const int size = mReceiver.Size[mReceiver.Front];
+        mReceivedTime = mReceiver.Time[mReceiver.Front];
+        memcpy(buffer, mReceiver.Buffer[mReceiver.Front], size);
+        mPacketsCoalesced += mLastCoalesced;
+        return size;
+    }
+
+    osaSocket * socket = IncomingSocket();
+    int bytesRead = socket->Receive(buffer, BUFFER_SIZE, TIMEOUT);
+    if (bytesRead <= 0) {
+        return 0;
+    }
+    // dequeue all the datagrams and only use the latest one
+    int dataLeft = bytesRead;
+    while (dataLeft > 0) {
+        dataLeft = socket->Receive(buffer, BUFFER_SIZE, 0);
+        if (dataLeft > 0) {
+            bytesRead = dataLeft;
+            ++mLastCoalesced;
+        }
+    }
+    mReceivedTime = mTimeServer.GetRelativeTime();
+    mPacketsCoalesced += mLastCoalesced;
+    return bytesRead;
+}
+
 void mtsSocketBasePSM::UpdateStatistics(void)
 {
     int deltaPacket = 1;
     if (mIsServer) {
-        mLoopTime = mTimeServer.GetRelativeTime() - Command.Data.Header.LastTimestamp;
+        UpdateClock(Command.Data.Header);
         if (Command.Data.Header.Id == 1) {
             State.Data.Header.Id = 1;
             mPacketsLost = 0;
@@ -78,7 +414,7 @@ void mtsSocketBasePSM::UpdateStatistics(void)
             }
         }
     } else {
-        mLoopTime = mTimeServer.GetRelativeTime() - State.Data.Header.LastTimestamp;
+        UpdateClock(State.Data.Header);
         if (State.Data.Header.Id == 1) {
             Command.Data.Header.Id = 1;
             mPacketsLost = 0;
@@ -90,9 +426,434 @@ void mtsSocketBasePSM::UpdateStatistics(void)
         }
     }
 
+    // packets coalesced by ReceiveLatest were received, not lost
     if (deltaPacket == 0) {
        mPacketsDelayed++;
-    } else if (deltaPacket > 1) {
-        mPacketsLost += (deltaPacket - 1);
+    } else if (deltaPacket > static_cast<int>(mLastCoalesced + 1)) {
+        mPacketsLost += (deltaPacket - 1 - mLastCoalesced);
+    }
+    mLastCoalesced = 0;
+}
+
+void mtsSocketBasePSM::UpdateClock(const socketHeader & received)
+{
+    // only once per new packet
+    if (received.Id == mClock.LastId) {
+        return;
+    }
+    mClock.LastId = received.Id;
+    // remote didn't receive anything from us yet
+    if (received.LastTimestamp <= 0.0) {
+        return;
+    }
+
+    // NTP style, remote echoes our timestamp plus the time spent
+    // before replying
+    const double roundTrip = mReceivedTime - received.LastTimestamp;
+    if ((roundTrip < 0.0) || (roundTrip > 1.0 * cmn_s)) {
+        return;
+    }
+    mLoopTime = roundTrip;
+    mClock.RoundTrip[mClock.Next] = roundTrip;
+    mClock.Offset[mClock.Next] = received.Timestamp - 0.5 * (received.LastTimestamp + mReceivedTime);
+    mClock.Next = (mClock.Next + 1) % CLOCK_SAMPLES;
+    if (mClock.NbSamples < CLOCK_SAMPLES) {
+        ++mClock.NbSamples;
+    }
+
+    // offset from the sample with the shortest round trip, least
+    // affected by queuing delays
+    size_t best = 0;
+    for (size_t index = 1; index < mClock.NbSamples; ++index) {
+        if (mClock.RoundTrip[index] < mClock.RoundTrip[best]) {
+            best = index;
+        }
+    }
+    mClockOffset = mClock.Offset[best];
+
+    // one way latency and interarrival jitter
+    mOneWayLatency = mReceivedTime - RemoteToLocal(received.Timestamp);
+    if (mClock.Synchronized) {
+        const double difference = mOneWayLatency - mClock.LastTransit;
+        mJitter += (std::abs(difference) - mJitter) / 16.0;
+    }
+    mClock.LastTransit = mOneWayLatency;
+    mClock.Synchronized = true;
+}
+
+double mtsSocketBasePSM::EchoTimestamp(const socketHeader & received) const
+{
+    if (received.Timestamp <= 0.0) {
+        return 0.0;
+    }
+    return received.Timestamp + (mTimeServer.GetRelativeTime() - mReceivedTime);
+}
+
+size_t mtsSocketBasePSM::Encode(const socketCommandPSM & command, char * buffer)
+{
+    PodWriteHeader(buffer, POD_TYPE_COMMAND, command.Header, command.RobotControlState);
+    PodWriteFrame(buffer + 40, command.GoalPose);
+    PodWriteDouble(buffer + 136, command.GoalJaw);
+    return POD_MSG_SIZE;
+}
+
+size_t mtsSocketBasePSM::Encode(const socketStatePSM & state, char * buffer)
+{
+    PodWriteHeader(buffer, POD_TYPE_STATE, state.Header, state.RobotControlState);
+    PodWriteFrame(buffer + 40, state.CurrentPose);
+    PodWriteDouble(buffer + 136, state.CurrentJaw);
+    return POD_MSG_SIZE;
+}
+
+bool mtsSocketBasePSM::Decode(const char * buffer, const size_t size, socketCommandPSM & command)
+{
+    if (!PodReadHeader(buffer, size, POD_TYPE_COMMAND, command.Header, command.RobotControlState)) {
+        return false;
+    }
+    PodReadFrame(buffer + 40, command.GoalPose);
+    command.GoalJaw = PodReadDouble(buffer + 136);
+    return true;
+}
+
+bool mtsSocketBasePSM::Decode(const char * buffer, const size_t size, socketStatePSM & state)
+{
+    if (!PodReadHeader(buffer, size, POD_TYPE_STATE, state.Header, state.RobotControlState)) {
+        return false;
     }
+    PodReadFrame(buffer + 40, state.CurrentPose);
+    state.CurrentJaw = PodReadDouble(buffer + 136);
+    return true;
+}
+
+bool mtsSocketBasePSM::IsPOD(const char * buffer, const size_t size)
+{
+    return ((size >= 4) && (PodRead32(buffer) == POD_MAGIC));
+}
+
+bool mtsSocketBasePSM::IsCompact(const char * buffer, const size_t size)
+{
+    return (IsPOD(buffer, size)
+            && (size >= 8)
+            && ((PodRead32(buffer + 4) & 0xFFFF) == POD_VERSION_COMPACT));
+}
+
+size_t mtsSocketBasePSM::EncodeCompact(const socketCommandPSM & command, char * buffer)
+{
+    return EncodeCompact(POD_TYPE_COMMAND, command.Header, command.RobotControlState,
+                         command.GoalPose, command.GoalJaw, buffer);
+}
+
+size_t mtsSocketBasePSM::EncodeCompact(const socketStatePSM & state, char * buffer)
+{
+    return EncodeCompact(POD_TYPE_STATE, state.Header, state.RobotControlState,
+                         state.CurrentPose, state.CurrentJaw, buffer);
+}
+
+bool mtsSocketBasePSM::DecodeCompact(const char * buffer, const size_t size, socketCommandPSM & command)
+{
+    return DecodeCompact(buffer, size, POD_TYPE_COMMAND, command.Header, command.RobotControlState,
+                         command.GoalPose, command.GoalJaw);
+}
+
+bool mtsSocketBasePSM::DecodeCompact(const char * buffer, const size_t size, socketStatePSM & state)
+{
+    return DecodeCompact(buffer, size, POD_TYPE_STATE, state.Header, state.RobotControlState,
+                         state.CurrentPose, state.CurrentJaw);
+}
+
+size_t mtsSocketBasePSM::EncodeCompact(const uint32_t type, const socketHeader & header,
+                                       const socketMessages::StateType state,
+                                       const vctFrm3 & frame, const double jaw,
+                                       char * buffer)
+{
+    // quantize and save in history so later packets can be relative to this one
+    CompactValuesType & current = mCompact.Sent[header.Id % COMPACT_HISTORY];
+    current.Id = header.Id;
+    const double translationResolution = mCompact.ResolutionTranslation;
+    const double rotationResolution = mCompact.ResolutionRotation;
+    const vctQuatRot3 quaternion(frame.Rotation(), VCT_NORMALIZE);
+    for (size_t index = 0; index < 3; ++index) {
+        current.Values[index] = std::llround(frame.Translation().Element(index) / translationResolution);
+    }
+    current.Values[3] = std::llround(quaternion.X() / rotationResolution);
+    current.Values[4] = std::llround(quaternion.Y() / rotationResolution);
+    current.Values[5] = std::llround(quaternion.Z() / rotationResolution);
+    current.Values[6] = std::llround(quaternion.W() / rotationResolution);
+    current.Values[7] = std::llround(jaw / rotationResolution);
+
+    // reference is the last packet the other side received, if
+    // still in history
+    const CompactValuesType * reference = 0;
+    const unsigned int distance = header.Id - mCompact.Acknowledged;
+    if ((mCompact.SinceKeyframe < mCompact.KeyframePeriod)
+        && (mCompact.Acknowledged != 0)
+        && (distance > 0)
+        && (distance < COMPACT_HISTORY)) {
+        const CompactValuesType & candidate = mCompact.Sent[mCompact.Acknowledged % COMPACT_HISTORY];
+        if (candidate.Id == mCompact.Acknowledged) {
+            reference = &candidate;
+        }
+    }
+    if (reference) {
+        ++mCompact.SinceKeyframe;
+    } else {
+        mCompact.SinceKeyframe = 0;
+    }
+
+    PodWrite32(buffer, POD_MAGIC);
+    PodWrite32(buffer + 4, POD_VERSION_COMPACT | (type << 16));
+    PodWrite32(buffer + 8, header.Id);
+    PodWrite32(buffer + 12, header.LastId);
+    PodWriteDouble(buffer + 16, header.Timestamp);
+    PodWriteDouble(buffer + 24, header.LastTimestamp);
+    buffer[32] = static_cast<char>(reference ? distance : 0);
+    buffer[33] = static_cast<char>(state);
+    PodWriteFloat(buffer + 34, mCompact.ResolutionTranslation);
+    PodWriteFloat(buffer + 38, mCompact.ResolutionRotation);
+    size_t size = COMPACT_HEADER_SIZE;
+    for (size_t index = 0; index < COMPACT_VALUES; ++index) {
+        const int64_t value = reference ?
+            (current.Values[index] - reference->Values[index]) : current.Values[index];
+        size += CompactWriteVarint(buffer + size, value);
+    }
+    ++mCompact.Unanswered;
+    return size;
+}
+
+bool mtsSocketBasePSM::DecodeCompact(const char * buffer, const size_t size, const uint32_t type,
+                                     socketHeader & header, socketMessages::StateType & state,
+                                     vctFrm3 & frame, double & jaw)
+{
+    if ((size < COMPACT_HEADER_SIZE)
+        || (PodRead32(buffer) != POD_MAGIC)
+        || (PodRead32(buffer + 4) != (POD_VERSION_COMPACT | (type << 16)))) {
+        CMN_LOG_CLASS_RUN_ERROR << "DecodeCompact: invalid header, " << size << " bytes" << std::endl;
+        return false;
+    }
+    const unsigned int id = PodRead32(buffer + 8);
+    const unsigned int distance = static_cast<unsigned char>(buffer[32]);
+    const double translationResolution = PodReadFloat(buffer + 34);
+    const double rotationResolution = PodReadFloat(buffer + 38);
+    if (!(translationResolution > 0.0) || !(rotationResolution > 0.0)) {
+        CMN_LOG_CLASS_RUN_ERROR << "DecodeCompact: invalid resolution" << std::endl;
+        return false;
+    }
+
+    const CompactValuesType * reference = 0;
+    if (distance != 0) {
+        const unsigned int referenceId = id - distance;
+        const CompactValuesType & candidate = mCompact.Received[referenceId % COMPACT_HISTORY];
+        if ((distance >= COMPACT_HISTORY) || (referenceId == 0) || (candidate.Id != referenceId)) {
+            ++mCompact.MissingReference;
+            CMN_LOG_CLASS_RUN_DEBUG << "DecodeCompact: reference " << referenceId
+                                    << " not found for packet " << id << std::endl;
+            return false;
+        }
+        reference = &candidate;
+    }
+
+    int64_t values[COMPACT_VALUES];
+    const char * position = buffer + COMPACT_HEADER_SIZE;
+    const char * end = buffer + size;
+    for (size_t index = 0; index < COMPACT_VALUES; ++index) {
+        const size_t used = CompactReadVarint(position, end, values[index]);
+        if (used == 0) {
+            CMN_LOG_CLASS_RUN_ERROR << "DecodeCompact: truncated packet, " << size << " bytes" << std::endl;
+            return false;
+        }
+        position += used;
+        if (reference) {
+            values[index] += reference->Values[index];
+        }
+    }
+
+    // save for packets relative to this one
+    CompactValuesType & current = mCompact.Received[id % COMPACT_HISTORY];
+    current.Id = id;
+    std::copy(values, values + COMPACT_VALUES, current.Values);
+
+    header.Id = id;
+    header.LastId = PodRead32(buffer + 12);
+    header.Timestamp = PodReadDouble(buffer + 16);
+    header.LastTimestamp = PodReadDouble(buffer + 24);
+    header.Size = static_cast<int>(size);
+    state = static_cast<socketMessages::StateType>(static_cast<unsigned char>(buffer[33]));
+    for (size_t index = 0; index < 3; ++index) {
+        frame.Translation().Element(index) = values[index] * translationResolution;
+    }
+    const vctQuatRot3 quaternion(values[3] * rotationResolution,
+                                 values[4] * rotationResolution,
+                                 values[5] * rotationResolution,
+                                 values[6] * rotationResolution,
+                                 VCT_NORMALIZE);
+    frame.Rotation().FromNormalized(quaternion);
+    jaw = values[7] * rotationResolution;
+
+    mCompact.Acknowledged = header.LastId;
+    mCompact.Unanswered = 0;
+    return true;
+}
+
+size_t mtsSocketBasePSM::Encode(const std::vector<socketCommandPSM *> & commands, char * buffer)
+{
+    const size_t nbArms = std::min(commands.size(), static_cast<size_t>(POD_MAX_ARMS));
+    PodWriteBundleHeader(buffer, POD_TYPE_BUNDLE_COMMAND, commands[0]->Header, nbArms);
+    for (size_t index = 0; index < nbArms; ++index) {
+        const socketCommandPSM & command = *(commands[index]);
+        PodWriteRecord(buffer + POD_BUNDLE_HEADER_SIZE + index * POD_RECORD_SIZE,
+                       index, command.Header, command.RobotControlState,
+                       command.GoalPose, command.GoalJaw);
+    }
+    return POD_BUNDLE_HEADER_SIZE + nbArms * POD_RECORD_SIZE;
+}
+
+size_t mtsSocketBasePSM::Encode(const std::vector<socketStatePSM *> & states, char * buffer)
+{
+    const size_t nbArms = std::min(states.size(), static_cast<size_t>(POD_MAX_ARMS));
+    PodWriteBundleHeader(buffer, POD_TYPE_BUNDLE_STATE, states[0]->Header, nbArms);
+    for (size_t index = 0; index < nbArms; ++index) {
+        const socketStatePSM & state = *(states[index]);
+        PodWriteRecord(buffer + POD_BUNDLE_HEADER_SIZE + index * POD_RECORD_SIZE,
+                       index, state.Header, state.RobotControlState,
+                       state.CurrentPose, state.CurrentJaw);
+    }
+    return POD_BUNDLE_HEADER_SIZE + nbArms * POD_RECORD_SIZE;
+}
+
+bool mtsSocketBasePSM::Decode(const char * buffer, const size_t size,
+                              std::vector<socketCommandPSM *> & commands, uint32_t & updated)
+{
+    updated = 0;
+    socketHeader header;
+    size_t nbRecords;
+    if (!PodReadBundleHeader(buffer, size, POD_TYPE_BUNDLE_COMMAND, header, nbRecords)) {
+        return false;
+    }
+    // header is for the link, stored in first arm
+    commands[0]->Header = header;
+    for (size_t record = 0; record < nbRecords; ++record) {
+        const char * recordBuffer = buffer + POD_BUNDLE_HEADER_SIZE + record * POD_RECORD_SIZE;
+        size_t index;
+        unsigned int id;
+        if (!PodReadRecordHeader(recordBuffer, commands.size(), index, id)) {
+            continue;
+        }
+        socketCommandPSM & command = *(commands[index]);
+        if ((index != 0) && !PodIsNewer(id, command.Header.Id)) {
+            continue;
+        }
+        command.Header.Id = id;
+        command.RobotControlState = static_cast<socketMessages::StateType>(PodRead32(recordBuffer + 8));
+        PodReadFrame(recordBuffer + 16, command.GoalPose);
+        command.GoalJaw = PodReadDouble(recordBuffer + 112);
+        updated |= (1u << index);
+    }
+    return true;
+}
+
+bool mtsSocketBasePSM::Decode(const char * buffer, const size_t size,
+                              std::vector<socketStatePSM *> & states, uint32_t & updated)
+{
+    updated = 0;
+    socketHeader header;
+    size_t nbRecords;
+    if (!PodReadBundleHeader(buffer, size, POD_TYPE_BUNDLE_STATE, header, nbRecords)) {
+        return false;
+    }
+    states[0]->Header = header;
+    for (size_t record = 0; record < nbRecords; ++record) {
+        const char * recordBuffer = buffer + POD_BUNDLE_HEADER_SIZE + record * POD_RECORD_SIZE;
+        size_t index;
+        unsigned int id;
+        if (!PodReadRecordHeader(recordBuffer, states.size(), index, id)) {
+            continue;
+        }
+        socketStatePSM & state = *(states[index]);
+        if ((index != 0) && !PodIsNewer(id, state.Header.Id)) {
+            continue;
+        }
+        state.Header.Id = id;
+        state.RobotControlState = static_cast<socketMessages::StateType>(PodRead32(recordBuffer + 8));
+        PodReadFrame(recordBuffer + 16, state.CurrentPose);
+        state.CurrentJaw = PodReadDouble(recordBuffer + 112);
+        updated |= (1u << index);
+    }
+    return true;
+}
+
+bool mtsSocketBasePSM::IsBundle(const char * buffer, const size_t size)
+{
+    if (!IsPOD(buffer, size) || (size < 8)) {
+        return false;
+    }
+    const uint32_t type = PodRead32(buffer + 4) >> 16;
+    return ((type == POD_TYPE_BUNDLE_COMMAND) || (type == POD_TYPE_BUNDLE_STATE));
+}
+
+size_t mtsSocketBasePSM::EncodeRedundant(const socketCommandPSM & command,
+                                         const socketCommandPSM * previous, const size_t nbPrevious,
+                                         char * buffer)
+{
+    const size_t nbRecords = std::min(nbPrevious, static_cast<size_t>(POD_MAX_REDUNDANCY));
+    const size_t size = POD_MSG_SIZE + nbRecords * POD_RECORD_SIZE;
+    PodWriteHeader(buffer, POD_TYPE_REDUNDANT_COMMAND, command.Header, command.RobotControlState);
+    PodWrite32(buffer + 36, static_cast<uint32_t>(size));
+    PodWriteFrame(buffer + 40, command.GoalPose);
+    PodWriteDouble(buffer + 136, command.GoalJaw);
+    for (size_t index = 0; index < nbRecords; ++index) {
+        char * recordBuffer = buffer + POD_MSG_SIZE + index * POD_RECORD_SIZE;
+        PodWriteRecord(recordBuffer, index, previous[index].Header,
+                       previous[index].RobotControlState,
+                       previous[index].GoalPose, previous[index].GoalJaw);
+        PodWriteFloat(recordBuffer + 12,
+                      static_cast<float>(previous[index].Header.Timestamp - command.Header.Timestamp));
+    }
+    return size;
+}
+
+bool mtsSocketBasePSM::DecodeRedundant(const char * buffer, const size_t size,
+                                       socketCommandPSM & command,
+                                       socketCommandPSM * previous, size_t & nbPrevious)
+{
+    nbPrevious = 0;
+    if ((size < POD_MSG_SIZE)
+        || (PodRead32(buffer) != POD_MAGIC)
+        || (PodRead32(buffer + 4) != (POD_VERSION | (POD_TYPE_REDUNDANT_COMMAND << 16)))) {
+        return false;
+    }
+    const size_t expected = PodRead32(buffer + 36);
+    if ((expected < POD_MSG_SIZE)
+        || (expected > size)
+        || (((expected - POD_MSG_SIZE) % POD_RECORD_SIZE) != 0)) {
+        return false;
+    }
+    const size_t nbRecords = std::min((expected - POD_MSG_SIZE) / POD_RECORD_SIZE,
+                                      static_cast<size_t>(POD_MAX_REDUNDANCY));
+    command.Header.Id = PodRead32(buffer + 8);
+    command.Header.LastId = PodRead32(buffer + 12);
+    command.Header.Timestamp = PodReadDouble(buffer + 16);
+    command.Header.LastTimestamp = PodReadDouble(buffer + 24);
+    command.Header.Size = static_cast<int>(expected);
+    command.RobotControlState = static_cast<socketMessages::StateType>(PodRead32(buffer + 32));
+    PodReadFrame(buffer + 40, command.GoalPose);
+    command.GoalJaw = PodReadDouble(buffer + 136);
+    for (size_t index = 0; index < nbRecords; ++index) {
+        const char * recordBuffer = buffer + POD_MSG_SIZE + index * POD_RECORD_SIZE;
+        socketCommandPSM & record = previous[index];
+        record.Header = command.Header;
+        record.Header.Id = PodRead32(recordBuffer + 4);
+        record.Header.Timestamp = command.Header.Timestamp + PodReadFloat(recordBuffer + 12);
+        record.RobotControlState = static_cast<socketMessages::StateType>(PodRead32(recordBuffer + 8));
+        PodReadFrame(recordBuffer + 16, record.GoalPose);
+        record.GoalJaw = PodReadDouble(recordBuffer + 112);
+    }
+    nbPrevious = nbRecords;
+    return true;
+}
+
+bool mtsSocketBasePSM::IsRedundant(const char * buffer, const size_t size)
+{
+    return (IsPOD(buffer, size)
+            && (size >= 8)
+            && ((PodRead32(buffer + 4) >> 16) == POD_TYPE_REDUNDANT_COMMAND));
 }
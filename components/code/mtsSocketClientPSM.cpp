@@ -22,37 +22,91 @@ http://www.cisst.org/cisst/license.txt.
 CMN_IMPLEMENT_SERVICES_DERIVED(mtsSocketClientPSM, mtsTaskPeriodic);
 
 mtsSocketClientPSM::mtsSocketClientPSM(const std::string & componentName, const double periodInSeconds,
-                                       const std::string & ip, const unsigned int port) :
+                                       const std::string & ip, const unsigned int port,
+                                       const std::string & interfaceName) :
     mtsSocketBasePSM(componentName, periodInSeconds, ip, port, false)
 {
-    this->StateTable.AddData(m_measured_cp, "m_measured_cp");
-    m_jaw_measured_js.Position().resize(1);
-    this->StateTable.AddData(m_jaw_measured_js, "m_jaw_measured_js");
-    this->StateTable.AddData(m_operating_state, "m_operating_state");
-    mtsInterfaceProvided * interfaceProvided = AddInterfaceProvided("Arm");
-    if (interfaceProvided) {
-        interfaceProvided->AddMessageEvents();
-        interfaceProvided->AddCommandReadState(this->StateTable, m_measured_cp, "measured_cp");
-        interfaceProvided->AddCommandReadState(this->StateTable, m_jaw_measured_js, "jaw/measured_js");
-        interfaceProvided->AddCommandReadState(this->StateTable, m_operating_state, "operating_state");
-        interfaceProvided->AddCommandVoid(&mtsSocketClientPSM::Freeze,
-                                          this, "Freeze");
-        interfaceProvided->AddCommandWrite(&mtsSocketClientPSM::servo_cp,
-                                           this , "servo_cp");
-        interfaceProvided->AddCommandWrite(&mtsSocketClientPSM::jaw_servo_jp,
-                                           this , "jaw/servo_jp");
-        interfaceProvided->AddCommandWrite(&mtsSocketClientPSM::state_command,
-                                           this , "state_command");
-        interfaceProvided->AddEventWrite(operating_state_event, "operating_state",
-                                         m_operating_state);
+    mRedundancy.Number = 0;
+    mRedundancy.Size = 0;
+    mCompactProbe.Fallback = false;
+    mCompactProbe.SinceProbe = 0;
+
+    // first arm uses data from base class
+    ArmType * arm = CreateArm(interfaceName);
+    if (arm) {
+        arm->Command = &Command.Data;
+        arm->State = &State.Data;
+    }
+}
+
+mtsSocketClientPSM::~mtsSocketClientPSM()
+{
+    for (auto arm : mArms) {
+        delete arm;
     }
 }
 
+mtsSocketClientPSM::ArmType * mtsSocketClientPSM::CreateArm(const std::string & interfaceName)
+{
+    mtsInterfaceProvided * interfaceProvided = AddInterfaceProvided(interfaceName);
+    if (!interfaceProvided) {
+        CMN_LOG_CLASS_INIT_ERROR << "CreateArm: failed to create interface \""
+                                 << interfaceName << "\"" << std::endl;
+        return 0;
+    }
+    ArmType * arm = new ArmType;
+    arm->Command = &(arm->CommandData);
+    arm->State = &(arm->StateData);
+    arm->CurrentState = socketMessages::SCK_UNINITIALIZED;
+    arm->PreviousState = socketMessages::SCK_UNINITIALIZED;
+    arm->DesiredState = socketMessages::SCK_UNINITIALIZED;
+
+    // state table names must be unique, prefix all but first arm
+    const std::string prefix = mArms.empty() ? "" : (interfaceName + "_");
+    this->StateTable.AddData(arm->m_measured_cp, prefix + "m_measured_cp");
+    arm->m_jaw_measured_js.Position().resize(1);
+    this->StateTable.AddData(arm->m_jaw_measured_js, prefix + "m_jaw_measured_js");
+    this->StateTable.AddData(arm->m_operating_state, prefix + "m_operating_state");
+
+    interfaceProvided->AddMessageEvents();
+    interfaceProvided->AddCommandReadState(this->StateTable, arm->m_measured_cp, "measured_cp");
+    interfaceProvided->AddCommandReadState(this->StateTable, arm->m_jaw_measured_js, "jaw/measured_js");
+    interfaceProvided->AddCommandReadState(this->StateTable, arm->m_operating_state, "operating_state");
+    interfaceProvided->AddCommandVoid(&ArmType::Freeze,
+                                      arm, "Freeze");
+    interfaceProvided->AddCommandWrite(&ArmType::servo_cp,
+                                       arm, "servo_cp");
+    interfaceProvided->AddCommandWrite(&ArmType::jaw_servo_jp,
+                                       arm, "jaw/servo_jp");
+    interfaceProvided->AddCommandWrite(&ArmType::state_command,
+                                       arm, "state_command");
+    interfaceProvided->AddEventWrite(arm->operating_state_event, "operating_state",
+                                     arm->m_operating_state);
+    mArms.push_back(arm);
+    return arm;
+}
+
+bool mtsSocketClientPSM::AddArm(const std::string & interfaceName)
+{
+    if (mArms.size() >= POD_MAX_ARMS) {
+        CMN_LOG_CLASS_INIT_ERROR << "AddArm: can't add \"" << interfaceName
+                                 << "\", maximum number of arms is " << POD_MAX_ARMS << std::endl;
+        return false;
+    }
+    ArmType * arm = CreateArm(interfaceName);
+    if (!arm) {
+        return false;
+    }
+    arm->Command->Header.Size = CLIENT_MSG_SIZE;
+    mCommands.push_back(arm->Command);
+    mStates.push_back(arm->State);
+    // bundles only exist in fixed layout, not compact
+    mWireFormat = WIRE_POD;
+    return true;
+}
+
 void mtsSocketClientPSM::Configure(const std::string & CMN_UNUSED(fileName))
 {
-    DesiredState = socketMessages::SCK_UNINITIALIZED;
-    PreviousState = socketMessages::SCK_UNINITIALIZED;
-    CurrentState = socketMessages::SCK_UNINITIALIZED;
     Command.Data.Header.Size = CLIENT_MSG_SIZE;
     Command.Socket->SetDestination(IpAddress, Command.IpPort);
     State.Socket->AssignPort(State.IpPort);
@@ -68,11 +122,11 @@ void mtsSocketClientPSM::Run(void)
     SendPSMCommandData();
 }
 
-void mtsSocketClientPSM::UpdateApplication(void)
+void mtsSocketClientPSM::ArmType::UpdateApplication(void)
 {
     // update state and trigger event as needed
     PreviousState = CurrentState;
-    CurrentState = State.Data.RobotControlState;
+    CurrentState = State->RobotControlState;
     if (CurrentState != PreviousState) {
         switch (CurrentState) {
         case socketMessages::SCK_UNINITIALIZED:
@@ -93,19 +147,18 @@ void mtsSocketClientPSM::UpdateApplication(void)
         operating_state_event(m_operating_state);
     }
     m_measured_cp.Valid() = (CurrentState >= socketMessages::SCK_HOMED);
-    m_measured_cp.Position().FromNormalized(State.Data.CurrentPose);
-    m_jaw_measured_js.Position().at(0) = State.Data.CurrentJaw;
-    
+    m_measured_cp.Position().FromNormalized(State->CurrentPose);
+    m_jaw_measured_js.Position().at(0) = State->CurrentJaw;
 }
 
-void mtsSocketClientPSM::Freeze(void)
+void mtsSocketClientPSM::ArmType::Freeze(void)
 {
     DesiredState = socketMessages::SCK_CART_POS;
-    Command.Data.GoalPose.From(State.Data.CurrentPose);
-    Command.Data.GoalJaw = State.Data.CurrentJaw;
+    Command->GoalPose.From(State->CurrentPose);
+    Command->GoalJaw = State->CurrentJaw;
 }
 
-void mtsSocketClientPSM::state_command(const std::string & state)
+void mtsSocketClientPSM::ArmType::state_command(const std::string & state)
 {
     if (state == "disable") {
         DesiredState = socketMessages::SCK_UNINITIALIZED;
@@ -115,76 +168,132 @@ void mtsSocketClientPSM::state_command(const std::string & state)
         std::cerr << CMN_LOG_DETAILS << state << " state command not supported." << std::endl;
     }
 
-    Command.Data.RobotControlState = DesiredState;
-    Command.Data.GoalPose.From(State.Data.CurrentPose);
-    Command.Data.GoalJaw = State.Data.CurrentJaw;
+    Command->RobotControlState = DesiredState;
+    Command->GoalPose.From(State->CurrentPose);
+    Command->GoalJaw = State->CurrentJaw;
 }
 
-void mtsSocketClientPSM::servo_cp(const prmPositionCartesianSet & position)
+void mtsSocketClientPSM::ArmType::servo_cp(const prmPositionCartesianSet & position)
 {
     DesiredState = socketMessages::SCK_CART_POS;
-    Command.Data.GoalPose.From(position.Goal());
+    Command->GoalPose.From(position.Goal());
 }
 
-void mtsSocketClientPSM::jaw_servo_jp(const prmPositionJointSet & position)
+void mtsSocketClientPSM::ArmType::jaw_servo_jp(const prmPositionJointSet & position)
 {
     DesiredState = socketMessages::SCK_CART_POS;
-    Command.Data.GoalJaw = position.Goal().at(0);
+    Command->GoalJaw = position.Goal().at(0);
 }
 
 void mtsSocketClientPSM::ReceivePSMStateData(void)
 {
-    // Recv Scoket Data
-    size_t bytesRead = 0;
-    bytesRead = State.Socket->Receive(State.Buffer, BUFFER_SIZE, TIMEOUT);
+    // newest packet, either received now or by the receive thread
+    const int bytesRead = ReceiveLatest(State.Buffer);
     if (bytesRead > 0) {
-        if (bytesRead != State.Data.Header.Size){
-            std::cerr << CMN_LOG_DETAILS << "Incorrect bytes read " << bytesRead << ". Looking for " << State.Data.Header.Size << " bytes." << std::endl;
-        }
-
-        std::stringstream ss;
-        cmnDataFormat local, remote;
-        ss.write(State.Buffer, bytesRead);
-
-        // Dequeue all the datagrams and only use the latest one.
-        int readCounter = 0;
-        int dataLeft = bytesRead;
-        while (dataLeft > 0) {
-            dataLeft = State.Socket->Receive(State.Buffer, BUFFER_SIZE, 0);
-            if (dataLeft != 0) {
-                bytesRead = dataLeft;
+        // server replies using the format we sent but detect anyway
+        if (IsBundle(State.Buffer, bytesRead)) {
+            uint32_t updated;
+            if (!Decode(State.Buffer, bytesRead, mStates, updated)) {
+                CMN_LOG_CLASS_RUN_ERROR << "RecvPSMStateData: failed to decode multiple arms packet, "
+                                        << bytesRead << " bytes" << std::endl;
+                return;
             }
-
-            readCounter++;
+            for (size_t index = 0; index < mArms.size(); ++index) {
+                if (updated & (1u << index)) {
+                    mArms[index]->State->CurrentPose.NormalizedSelf();
+                    mArms[index]->UpdateApplication();
+                }
+            }
+            return;
         }
-
-        if (readCounter > 1) {
-            std::cerr << CMN_LOG_DETAILS << "Catching up : " << readCounter << std::endl;
+        if (IsCompact(State.Buffer, bytesRead)) {
+            if (!DecodeCompact(State.Buffer, bytesRead, State.Data)) {
+                return;
+            }
+            // server replied to a probe, it supports compact packets
+            if (mCompactProbe.Fallback) {
+                CMN_LOG_CLASS_RUN_WARNING << "RecvPSMStateData: server replied to compact packet, using compact format again" << std::endl;
+                mCompactProbe.Fallback = false;
+                mWireFormat = WIRE_COMPACT;
+            }
+        } else if (IsPOD(State.Buffer, bytesRead)) {
+            if (!Decode(State.Buffer, bytesRead, State.Data)) {
+                CMN_LOG_CLASS_RUN_ERROR << "RecvPSMStateData: failed to decode packet, "
+                                        << bytesRead << " bytes" << std::endl;
+                return;
+            }
+        } else {
+            std::stringstream ss;
+            cmnDataFormat local, remote;
+            ss.write(State.Buffer, bytesRead);
+            cmnData<socketStatePSM>::DeSerializeBinary(State.Data, ss, local, remote);
         }
 
-        ss.write(State.Buffer, bytesRead);
-        cmnData<socketStatePSM>::DeSerializeBinary(State.Data, ss, local, remote);
-
         State.Data.CurrentPose.NormalizedSelf();
-        UpdateApplication();
+        mArms[0]->UpdateApplication();
     } else {
-        CMN_LOG_CLASS_RUN_DEBUG << "RecvPSMStateData: UDP receive failed" << std::endl;
+        CMN_LOG_CLASS_RUN_DEBUG << "RecvPSMStateData: no new UDP packet" << std::endl;
     }
 }
 
 void mtsSocketClientPSM::SendPSMCommandData(void)
 {
-    // Update Header
-    Command.Data.Header.Id++;
+    for (auto arm : mArms) {
+        arm->Command->Header.Id++;
+        arm->Command->RobotControlState = arm->DesiredState;
+    }
+
+    // Update Header, first arm is used for the link
     Command.Data.Header.Timestamp = mTimeServer.GetRelativeTime();
     Command.Data.Header.LastId = State.Data.Header.Id;
-    Command.Data.Header.LastTimestamp = State.Data.Header.Timestamp;
-    Command.Data.RobotControlState = DesiredState;
+    Command.Data.Header.LastTimestamp = EchoTimestamp(State.Data.Header);
 
-    // Send Socket Data
-    std::stringstream ss;
-    cmnData<socketCommandPSM>::SerializeBinary(Command.Data, ss);
-    memcpy(Command.Buffer, ss.str().c_str(), ss.str().length());
+    // older servers don't reply to compact packets
+    if ((mWireFormat == WIRE_COMPACT)
+        && (mCompact.Unanswered > COMPACT_FALLBACK)) {
+        CMN_LOG_CLASS_RUN_WARNING << "SendPSMCommandData: no reply to compact packets, server might not support them, using fixed layout format" << std::endl;
+        mWireFormat = WIRE_POD;
+        mCompactProbe.Fallback = true;
+        mCompactProbe.SinceProbe = 0;
+    }
 
-    Command.Socket->Send(Command.Buffer, ss.str().size());
+    // keyframe so the server can decode it without reference
+    bool probe = false;
+    if (mCompactProbe.Fallback && (NumberOfArms() == 1)) {
+        ++mCompactProbe.SinceProbe;
+        if (mCompactProbe.SinceProbe >= COMPACT_PROBE) {
+            mCompactProbe.SinceProbe = 0;
+            mCompact.SinceKeyframe = mCompact.KeyframePeriod;
+            probe = true;
+        }
+    }
+
+    // Send Socket Data
+    if (NumberOfArms() > 1) {
+        const size_t size = Encode(mCommands, Command.Buffer);
+        Command.Socket->Send(Command.Buffer, size);
+    } else if ((mWireFormat == WIRE_COMPACT) || probe) {
+        const size_t size = EncodeCompact(Command.Data, Command.Buffer);
+        Command.Socket->Send(Command.Buffer, size);
+    } else if ((mWireFormat == WIRE_POD) && (mRedundancy.Number > 0)) {
+        const size_t size = EncodeRedundant(Command.Data, mRedundancy.Previous, mRedundancy.Size,
+                                            Command.Buffer);
+        Command.Socket->Send(Command.Buffer, size);
+        // keep last commands, oldest first
+        if (mRedundancy.Size < mRedundancy.Number) {
+            ++mRedundancy.Size;
+        } else {
+            std::rotate(mRedundancy.Previous, mRedundancy.Previous + 1,
+                        mRedundancy.Previous + mRedundancy.Size);
+        }
+        mRedundancy.Previous[mRedundancy.Size - 1] = Command.Data;
+    } else if (mWireFormat == WIRE_POD) {
+        const size_t size = Encode(Command.Data, Command.Buffer);
+        Command.Socket->Send(Command.Buffer, size);
+    } else {
+        std::stringstream ss;
+        cmnData<socketCommandPSM>::SerializeBinary(Command.Data, ss);
+        memcpy(Command.Buffer, ss.str().c_str(), ss.str().length());
+        Command.Socket->Send(Command.Buffer, ss.str().size());
+    }
 }
@@ -18,30 +18,93 @@ http://www.cisst.org/cisst/license.txt.
 
 #include <sawIntuitiveResearchKit/mtsSocketServerPSM.h>
 #include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <cisstMultiTask/mtsInterfaceProvided.h>
 #include <cisstParameterTypes/prmOperatingState.h>
 
 CMN_IMPLEMENT_SERVICES_DERIVED(mtsSocketServerPSM, mtsTaskPeriodic);
 
 mtsSocketServerPSM::mtsSocketServerPSM(const std::string & componentName, const double periodInSeconds,
-                                       const std::string & ip, const unsigned int port) :
-    mtsSocketBasePSM(componentName, periodInSeconds, ip, port, true)
+                                       const std::string & ip, const unsigned int port,
+                                       const std::string & interfaceName) :
+    mtsSocketBasePSM(componentName, periodInSeconds, ip, port, true),
+    mBundle(false)
 {
-    mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired("PSM");
-    if(interfaceRequired) {
-        interfaceRequired->AddFunction("measured_cp", measured_cp);
-        interfaceRequired->AddFunction("servo_cp", servo_cp);
-        interfaceRequired->AddFunction("jaw/servo_jp", jaw_servo_jp);
-        interfaceRequired->AddFunction("operating_state", operating_state);
-        interfaceRequired->AddFunction("state_command", state_command);
-        interfaceRequired->AddEventHandlerWrite(&mtsSocketServerPSM::ErrorEventHandler,
-                                                this, "error");
+    // first arm uses data from base class
+    ArmType * arm = CreateArm(interfaceName);
+    if (arm) {
+        arm->Command = &Command.Data;
+        arm->State = &State.Data;
+    }
+
+    mPlayout.Head = 0;
+    mPlayout.Tail = 0;
+    mPlayout.Late = 0;
+    mPlayout.Dropped = 0;
+    mPlayout.Recovered = 0;
+    this->StateTable.AddData(mPlayout.Late, "PlayoutLate");
+    this->StateTable.AddData(mPlayout.Dropped, "PlayoutDropped");
+    this->StateTable.AddData(mPlayout.Recovered, "PlayoutRecovered");
+    mtsInterfaceProvided * systemInterface = GetInterfaceProvided("System");
+    if (systemInterface) {
+        systemInterface->AddCommandReadState(this->StateTable, mPlayout.Late, "GetPlayoutLate");
+        systemInterface->AddCommandReadState(this->StateTable, mPlayout.Dropped, "GetPlayoutDropped");
+        systemInterface->AddCommandReadState(this->StateTable, mPlayout.Recovered, "GetPlayoutRecovered");
+    }
+}
+
+mtsSocketServerPSM::~mtsSocketServerPSM()
+{
+    for (auto arm : mArms) {
+        delete arm;
     }
 }
 
+mtsSocketServerPSM::ArmType * mtsSocketServerPSM::CreateArm(const std::string & interfaceName)
+{
+    mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired(interfaceName);
+    if (!interfaceRequired) {
+        CMN_LOG_CLASS_INIT_ERROR << "CreateArm: failed to create interface \""
+                                 << interfaceName << "\"" << std::endl;
+        return 0;
+    }
+    ArmType * arm = new ArmType;
+    arm->Command = &(arm->CommandData);
+    arm->State = &(arm->StateData);
+    arm->CurrentState = socketMessages::SCK_UNINITIALIZED;
+    arm->DesiredState = socketMessages::SCK_UNINITIALIZED;
+    arm->PlayoutLastId = 0;
+    interfaceRequired->AddFunction("measured_cp", arm->measured_cp);
+    interfaceRequired->AddFunction("servo_cp", arm->servo_cp);
+    // first arm is expected to be a PSM
+    interfaceRequired->AddFunction("jaw/servo_jp", arm->jaw_servo_jp,
+                                   mArms.empty() ? MTS_REQUIRED : MTS_OPTIONAL);
+    interfaceRequired->AddFunction("operating_state", arm->operating_state);
+    interfaceRequired->AddFunction("state_command", arm->state_command);
+    interfaceRequired->AddEventHandlerWrite(&ArmType::ErrorEventHandler,
+                                            arm, "error");
+    mArms.push_back(arm);
+    return arm;
+}
+
+bool mtsSocketServerPSM::AddArm(const std::string & interfaceName)
+{
+    if (mArms.size() >= POD_MAX_ARMS) {
+        CMN_LOG_CLASS_INIT_ERROR << "AddArm: can't add \"" << interfaceName
+                                 << "\", maximum number of arms is " << POD_MAX_ARMS << std::endl;
+        return false;
+    }
+    ArmType * arm = CreateArm(interfaceName);
+    if (!arm) {
+        return false;
+    }
+    arm->State->Header.Size = SERVER_MSG_SIZE;
+    mCommands.push_back(arm->Command);
+    mStates.push_back(arm->State);
+    return true;
+}
+
 void mtsSocketServerPSM::Configure(const std::string & CMN_UNUSED(fileName))
 {
-    DesiredState = socketMessages::SCK_UNINITIALIZED;
-    CurrentState = socketMessages::SCK_UNINITIALIZED;
     State.Data.Header.Size = SERVER_MSG_SIZE;
     State.Socket->SetDestination(IpAddress, State.IpPort);
     Command.Socket->AssignPort(Command.IpPort);
@@ -54,46 +117,49 @@ void mtsSocketServerPSM::Run(void)
 
     ReceivePSMCommandData();
     UpdateStatistics();
+    PlayoutRun();
     SendPSMStateData();
 }
 
-void mtsSocketServerPSM::ExecutePSMCommands(void)
+void mtsSocketServerPSM::ExecutePSMCommands(ArmType & arm, const socketCommandPSM & command)
 {
-    if (DesiredState != Command.Data.RobotControlState) {
-        DesiredState = Command.Data.RobotControlState;
-        switch (DesiredState) {
+    if (arm.DesiredState != command.RobotControlState) {
+        arm.DesiredState = command.RobotControlState;
+        switch (arm.DesiredState) {
         case socketMessages::SCK_UNINITIALIZED:
-            state_command(std::string("disable"));
+            arm.state_command(std::string("disable"));
             break;
         case socketMessages::SCK_HOMED:
-            if (CurrentState != socketMessages::SCK_HOMING) {
-                state_command(std::string("enable"));
-                state_command(std::string("home"));
+            if (arm.CurrentState != socketMessages::SCK_HOMING) {
+                arm.state_command(std::string("enable"));
+                arm.state_command(std::string("home"));
             }
             break;
         case socketMessages::SCK_CART_POS:
-            if (CurrentState != socketMessages::SCK_HOMING) {
-                state_command(std::string("enable"));
-                state_command(std::string("home"));
+            if (arm.CurrentState != socketMessages::SCK_HOMING) {
+                arm.state_command(std::string("enable"));
+                arm.state_command(std::string("home"));
             }
-            CurrentState = socketMessages::SCK_CART_POS;
+            arm.CurrentState = socketMessages::SCK_CART_POS;
             break;
         default:
-            std::cerr << CMN_LOG_DETAILS << Command.Data.RobotControlState << " state not supported. " << std::endl;
+            std::cerr << CMN_LOG_DETAILS << command.RobotControlState << " state not supported. " << std::endl;
             break;
         }
     }
 
     // Only send when in cartesian mode
-    switch (CurrentState) {
+    switch (arm.CurrentState) {
     case socketMessages::SCK_CART_POS:
         // send cartesian goal
-        m_setpoint_cp.Goal().From(Command.Data.GoalPose);
-        servo_cp(m_setpoint_cp);
+        arm.m_setpoint_cp.Goal().From(command.GoalPose);
+        arm.servo_cp(arm.m_setpoint_cp);
         // send jaw goal
-        m_jaw_setpoint_jp.Goal().SetSize(1);
-        m_jaw_setpoint_jp.Goal().Element(0) = Command.Data.GoalJaw;
-        jaw_servo_jp(m_jaw_setpoint_jp);
+        if (arm.jaw_servo_jp.IsValid()) {
+            arm.m_jaw_setpoint_jp.Goal().SetSize(1);
+            arm.m_jaw_setpoint_jp.Goal().Element(0) = command.GoalJaw;
+            arm.jaw_servo_jp(arm.m_jaw_setpoint_jp);
+        }
         break;
     default:
         break;
@@ -102,92 +168,186 @@ void mtsSocketServerPSM::ExecutePSMCommands(void)
 
 void mtsSocketServerPSM::ReceivePSMCommandData(void)
 {
-    // Recv Socket Data
-    int bytesRead = 0;
-    bytesRead = Command.Socket->Receive(Command.Buffer, BUFFER_SIZE, TIMEOUT);
+    // newest packet, either received now or by the receive thread
+    const int bytesRead = ReceiveLatest(Command.Buffer);
     if (bytesRead > 0) {
-        if (bytesRead != Command.Data.Header.Size) {
-            std::cerr << CMN_LOG_DETAILS << "Incorrect bytes read " << bytesRead << ". Looking for " << Command.Data.Header.Size << " bytes." << std::endl;
-        }
-
-        std::stringstream ss;
-        cmnDataFormat local, remote;
-        ss.write(Command.Buffer, bytesRead);
-
-        // Dequeue all the datagrams and only use the latest one.
-        int readCounter = 0;
-        int dataLeft = bytesRead;
-        while (dataLeft > 0) {
-            dataLeft = Command.Socket->Receive(Command.Buffer, BUFFER_SIZE, 0);
-            if (dataLeft != 0) {
-                bytesRead = dataLeft;
+        // detect format for each packet and reply using the same format
+        if (IsBundle(Command.Buffer, bytesRead)) {
+            mWireFormat = WIRE_POD;
+            mBundle = true;
+            uint32_t updated;
+            if (!Decode(Command.Buffer, bytesRead, mCommands, updated)) {
+                CMN_LOG_CLASS_RUN_ERROR << "RecvPSMCommandData: failed to decode multiple arms packet, "
+                                        << bytesRead << " bytes" << std::endl;
+                return;
+            }
+            for (size_t index = 0; index < mCommands.size(); ++index) {
+                if (updated & (1u << index)) {
+                    mCommands[index]->GoalPose.NormalizedSelf();
+                    PlayoutQueue(index, *(mCommands[index]), Command.Data.Header.Timestamp);
+                }
             }
-            readCounter++;
+            return;
         }
-
-        if (readCounter > 1) {
-            std::cerr << CMN_LOG_DETAILS << "Catching up : " << readCounter << std::endl;
+        mBundle = false;
+        if (IsCompact(Command.Buffer, bytesRead)) {
+            mWireFormat = WIRE_COMPACT;
+            if (!DecodeCompact(Command.Buffer, bytesRead, Command.Data)) {
+                return;
+            }
+        } else if (IsRedundant(Command.Buffer, bytesRead)) {
+            mWireFormat = WIRE_POD;
+            socketCommandPSM previous[POD_MAX_REDUNDANCY];
+            size_t nbPrevious;
+            if (!DecodeRedundant(Command.Buffer, bytesRead, Command.Data, previous, nbPrevious)) {
+                CMN_LOG_CLASS_RUN_ERROR << "RecvPSMCommandData: failed to decode redundant packet, "
+                                        << bytesRead << " bytes" << std::endl;
+                return;
+            }
+            // previous commands only make sense with a playout delay,
+            // commands already queued are ignored by PlayoutQueue
+            if ((mPlayoutDelay > 0.0) && mClock.Synchronized) {
+                for (size_t index = 0; index < nbPrevious; ++index) {
+                    if (previous[index].Header.Id > mArms[0]->PlayoutLastId) {
+                        previous[index].GoalPose.NormalizedSelf();
+                        PlayoutQueue(0, previous[index], previous[index].Header.Timestamp);
+                        ++mPlayout.Recovered;
+                    }
+                }
+            }
+        } else if (IsPOD(Command.Buffer, bytesRead)) {
+            mWireFormat = WIRE_POD;
+            if (!Decode(Command.Buffer, bytesRead, Command.Data)) {
+                CMN_LOG_CLASS_RUN_ERROR << "RecvPSMCommandData: failed to decode packet, "
+                                        << bytesRead << " bytes" << std::endl;
+                return;
+            }
+        } else {
+            mWireFormat = WIRE_CISST;
+            std::stringstream ss;
+            cmnDataFormat local, remote;
+            ss.write(Command.Buffer, bytesRead);
+            cmnData<socketCommandPSM>::DeSerializeBinary(Command.Data, ss, local, remote);
         }
 
-        ss.write(Command.Buffer, bytesRead);
-        cmnData<socketCommandPSM>::DeSerializeBinary(Command.Data, ss, local, remote);
-
         Command.Data.GoalPose.NormalizedSelf();
-        ExecutePSMCommands();
+        PlayoutQueue(0, Command.Data, Command.Data.Header.Timestamp);
 
     } else {
-        CMN_LOG_CLASS_RUN_DEBUG << "RecvPSMCommandData: UDP receive failed" << std::endl;
+        CMN_LOG_CLASS_RUN_DEBUG << "RecvPSMCommandData: no new UDP packet" << std::endl;
+    }
+}
+
+void mtsSocketServerPSM::PlayoutQueue(const size_t armIndex, const socketCommandPSM & command,
+                                      const double remoteTimestamp)
+{
+    ArmType & arm = *(mArms[armIndex]);
+    if ((mPlayoutDelay <= 0.0) || !mClock.Synchronized) {
+        ExecutePSMCommands(arm, command);
+        return;
+    }
+    // ignore packets older than last queued
+    if ((command.Header.Id <= arm.PlayoutLastId) && (command.Header.Id != 1)) {
+        return;
+    }
+    arm.PlayoutLastId = command.Header.Id;
+    // buffer full, drop oldest
+    if ((mPlayout.Head - mPlayout.Tail) >= PLAYOUT_SIZE) {
+        ++mPlayout.Tail;
+        ++mPlayout.Dropped;
+    }
+    const double playoutTime = RemoteToLocal(remoteTimestamp) + mPlayoutDelay;
+    if (playoutTime < mTimeServer.GetRelativeTime()) {
+        ++mPlayout.Late;
+    }
+    const size_t index = mPlayout.Head % PLAYOUT_SIZE;
+    mPlayout.Commands[index] = command;
+    mPlayout.Arms[index] = armIndex;
+    mPlayout.Times[index] = playoutTime;
+    ++mPlayout.Head;
+}
+
+void mtsSocketServerPSM::PlayoutRun(void)
+{
+    const double now = mTimeServer.GetRelativeTime();
+    size_t due[POD_MAX_ARMS];
+    const size_t nbArms = mArms.size();
+    for (size_t arm = 0; arm < nbArms; ++arm) {
+        due[arm] = PLAYOUT_SIZE;
+    }
+    while ((mPlayout.Tail != mPlayout.Head)
+           && (mPlayout.Times[mPlayout.Tail % PLAYOUT_SIZE] <= now)) {
+        const size_t index = mPlayout.Tail % PLAYOUT_SIZE;
+        due[mPlayout.Arms[index]] = index;
+        ++mPlayout.Tail;
+    }
+    for (size_t arm = 0; arm < nbArms; ++arm) {
+        if (due[arm] != PLAYOUT_SIZE) {
+            ExecutePSMCommands(*(mArms[arm]), mPlayout.Commands[due[arm]]);
+        }
     }
 }
 
-void mtsSocketServerPSM::UpdatePSMState(void)
+void mtsSocketServerPSM::UpdatePSMState(ArmType & arm)
 {
     // Update PSM State
     mtsExecutionResult executionResult;
 
     // Get Cartesian position
-    executionResult = measured_cp(m_measured_cp);
-    State.Data.CurrentPose.Assign(m_measured_cp.Position());
+    executionResult = arm.measured_cp(arm.m_measured_cp);
+    arm.State->CurrentPose.Assign(arm.m_measured_cp.Position());
 
     // Get Arm State
     prmOperatingState psmState;
-    operating_state(psmState);
+    arm.operating_state(psmState);
 
     // Switch to socket states
     if (psmState.State() != prmOperatingState::ENABLED) {
-        CurrentState = socketMessages::SCK_UNINITIALIZED;
+        arm.CurrentState = socketMessages::SCK_UNINITIALIZED;
     } else if (psmState.IsHomed()) {
-        if ((CurrentState != socketMessages::SCK_HOMED)
-            && (CurrentState != socketMessages::SCK_CART_POS)) {
-            CurrentState = socketMessages::SCK_HOMED;
+        if ((arm.CurrentState != socketMessages::SCK_HOMED)
+            && (arm.CurrentState != socketMessages::SCK_CART_POS)) {
+            arm.CurrentState = socketMessages::SCK_HOMED;
         }
     } else {
-        CurrentState = socketMessages::SCK_HOMING;
+        arm.CurrentState = socketMessages::SCK_HOMING;
     }
+    arm.State->RobotControlState = arm.CurrentState;
+    arm.State->Header.Id++;
 }
 
 void mtsSocketServerPSM::SendPSMStateData(void)
 {
-    UpdatePSMState();
+    for (auto arm : mArms) {
+        UpdatePSMState(*arm);
+    }
 
-    // Update Header
-    State.Data.Header.Id++;
+    // Update Header, first arm is used for the link
     State.Data.Header.Timestamp = mTimeServer.GetRelativeTime();
     State.Data.Header.LastId = Command.Data.Header.Id;
-    State.Data.Header.LastTimestamp = Command.Data.Header.Timestamp;
-    State.Data.RobotControlState = CurrentState;
+    State.Data.Header.LastTimestamp = EchoTimestamp(Command.Data.Header);
 
     // Send Socket Data
-    std::stringstream ss;
-    cmnData<socketStatePSM>::SerializeBinary(State.Data, ss);
-    memcpy(State.Buffer, ss.str().c_str(), ss.str().length());
-
-    State.Socket->Send(State.Buffer, ss.str().size());
+    if (mBundle) {
+        const size_t size = Encode(mStates, State.Buffer);
+        State.Socket->Send(State.Buffer, size);
+    } else if (mWireFormat == WIRE_COMPACT) {
+        const size_t size = EncodeCompact(State.Data, State.Buffer);
+        State.Socket->Send(State.Buffer, size);
+    } else if (mWireFormat == WIRE_POD) {
+        const size_t size = Encode(State.Data, State.Buffer);
+        State.Socket->Send(State.Buffer, size);
+    } else {
+        std::stringstream ss;
+        cmnData<socketStatePSM>::SerializeBinary(State.Data, ss);
+        memcpy(State.Buffer, ss.str().c_str(), ss.str().length());
+        State.Socket->Send(State.Buffer, ss.str().size());
+    }
 }
 
-void mtsSocketServerPSM::ErrorEventHandler(const mtsMessage & CMN_UNUSED(message))
+void mtsSocketServerPSM::ArmType::ErrorEventHandler(const mtsMessage & CMN_UNUSED(message))
 {
     // Send error message to the client
     //State.Data.Error = message;
-    State.Data.RobotControlState = socketMessages::SCK_UNINITIALIZED;
+    State->RobotControlState = socketMessages::SCK_UNINITIALIZED;
 }
@@ -5,7 +5,7 @@
   Author(s):  Anton Deguet
   Created on: 2016-02-05
 
-  (C) Copyright 2016-2018 Johns Hopkins University (JHU), All Rights Reserved.
+  (C) Copyright 2016-2021 Johns Hopkins University (JHU), All Rights Reserved.
 
   --- begin cisst license - do not edit ---
 
@@ -18,13 +18,20 @@
 
 #include <sawIntuitiveResearchKit/mtsStateMachine.h>
 
-void mtsStateMachine::AddState(const StateType state)
+mtsStateMachine::StateIndex mtsStateMachine::AddState(const StateType state)
 {
     if (StateExists(state)) {
         cmnThrow("mtsStateMachine::AddState: "
                  + mName + ", state " + state + " already exists");
     }
-    mStates[state] = false;
+    const StateIndex index = mStates.size();
+    StateInfo info;
+    info.Name = state;
+    info.AllowedDesired = false;
+    info.Enter = info.Run = info.Leave = info.Transition = 0;
+    mStates.push_back(info);
+    mIndices[state] = index;
+    return index;
 }
 
 void mtsStateMachine::AddStates(const std::vector<StateType> & states)
@@ -39,15 +46,29 @@ void mtsStateMachine::AddStates(const std::vector<StateType> & states)
 
 bool mtsStateMachine::StateExists(const StateType state) const
 {
-    const StateMap::const_iterator found
-        = mStates.find(state);
-    return (found != mStates.end());
+    return (mIndices.find(state) != mIndices.end());
+}
+
+mtsStateMachine::StateIndex mtsStateMachine::Index(const StateType & state) const
+{
+    return Index(state, "Index");
+}
+
+mtsStateMachine::StateIndex mtsStateMachine::Index(const StateType & state,
+                                                   const char * methodName) const
+{
+    const IndexMap::const_iterator found = mIndices.find(state);
+    if (found == mIndices.end()) {
+        cmnThrow("mtsStateMachine::" + std::string(methodName) + ": "
+                 + mName + ", state [" + state + "] doesn't exist.  Use AddState first.");
+    }
+    return found->second;
 }
 
 void mtsStateMachine::AddAllowedDesiredState(const StateType allowedState)
 {
     if (StateExists(allowedState)) {
-        mStates[allowedState] = true;
+        mStates[Index(allowedState)].AllowedDesired = true;
     } else {
         cmnThrow("mtsStateMachine::AddAllowedDesiredState: "
                  + mName + ", state " + allowedState + " needs to be added first");
@@ -58,14 +79,9 @@ void mtsStateMachine::Run(void)
 {
     // on first run, call enter callback for initial state
     if (mFirstRun) {
-        // update callbacks
-        UpdateCurrentCallbacks();
-
         // find new state enter callback
-        CallbackMap::iterator callback;
-        callback = mEnterCallbacks.find(mCurrentState);
-        if (callback != mEnterCallbacks.end()) {
-            callback->second->Execute();
+        if (mStates[mCurrentState].Enter) {
+            mStates[mCurrentState].Enter->Execute();
         }
 
         // user callback if provided
@@ -76,85 +92,80 @@ void mtsStateMachine::Run(void)
         mFirstRun = false;
     }
     // check if a transition should happen
-    if (mCurrentTransitionCallback) {
-        mCurrentTransitionCallback->Execute();
+    if (mStates[mCurrentState].Transition) {
+        mStates[mCurrentState].Transition->Execute();
     }
-    // run current state method
+    // run current state method, transition might have changed the current state
     if (mRunCallback) {
         mRunCallback->Execute();
     }
-    if (mCurrentRunCallback) {
-        mCurrentRunCallback->Execute();
+    if (mStates[mCurrentState].Run) {
+        mStates[mCurrentState].Run->Execute();
     }
 }
 
 void mtsStateMachine::SetDesiredState(const StateType & desiredState)
 {
-    const StateMap::const_iterator state
-        = mStates.find(desiredState);
-    if ((state != mStates.end()) // state exists
-        && (state->second)) {  // can be set as desired
+    const IndexMap::const_iterator found = mIndices.find(desiredState);
+    if ((found != mIndices.end()) // state exists
+        && mStates[found->second].AllowedDesired) {  // can be set as desired
+        SetDesiredState(found->second);
+        return;
+    }
+    cmnThrow("mtsStateMachine::SetDesiredState: "
+             + desiredState + ", doesn't exists or is not allowed as a desired state");
+}
+
+void mtsStateMachine::SetDesiredState(const StateIndex desiredState)
+{
+    if ((desiredState < mStates.size())
+        && mStates[desiredState].AllowedDesired) {
         mPreviousDesiredState = mDesiredState;
         mDesiredState = desiredState;
         mDesiredStateIsNotCurrent = (mDesiredState != mCurrentState);
         return;
     }
     cmnThrow("mtsStateMachine::SetDesiredState: "
-             + desiredState + ", doesn't exists or is not allowed as a desired state");
+             + mName + ", state index " + std::to_string(desiredState)
+             + " doesn't exists or is not allowed as a desired state");
 }
 
 void mtsStateMachine::SetCurrentState(const StateType & newState)
 {
     // check if this state exists
-    const StateMap::const_iterator state = mStates.find(newState);
-    if (state == mStates.end()) {
+    const IndexMap::const_iterator found = mIndices.find(newState);
+    if (found == mIndices.end()) {
         cmnThrow("mtsStateMachine::SetCurrentState: "
                  + newState + ", doesn't exists");
         return;
     }
+    SetCurrentState(found->second);
+}
 
-    CallbackMap::iterator callback;
+void mtsStateMachine::SetCurrentState(const StateIndex newState)
+{
+    if (newState >= mStates.size()) {
+        cmnThrow("mtsStateMachine::SetCurrentState: "
+                 + mName + ", state index " + std::to_string(newState) + " doesn't exists");
+        return;
+    }
 
-    // find current state leave callback
-    callback = mLeaveCallbacks.find(mCurrentState);
-    if (callback != mLeaveCallbacks.end()) {
-        callback->second->Execute();
+    // current state leave callback
+    if (mStates[mCurrentState].Leave) {
+        mStates[mCurrentState].Leave->Execute();
     }
-    // set the new state and update current callbacks
+    // set the new state
     mPreviousState = mCurrentState;
     mCurrentState = newState;
     mDesiredStateIsNotCurrent = (mDesiredState != mCurrentState);
 
-    // find new state enter callback
-    callback = mEnterCallbacks.find(mCurrentState);
-    if (callback != mEnterCallbacks.end()) {
-        callback->second->Execute();
+    // new state enter callback
+    if (mStates[mCurrentState].Enter) {
+        mStates[mCurrentState].Enter->Execute();
     }
 
     // user callback if provided
     if (mStateChangeCallback) {
         mStateChangeCallback->Execute();
     }
-
-    // update current callbacks
-    UpdateCurrentCallbacks();
-}
-
-void mtsStateMachine::UpdateCurrentCallbacks(void)
-{
-    CallbackMap::iterator callback;
-    // find state run callback
-    callback = mRunCallbacks.find(mCurrentState);
-    if (callback != mRunCallbacks.end()) {
-        mCurrentRunCallback = callback->second;
-    } else {
-        mCurrentRunCallback = 0;
-    }
-    // find transition callback
-    callback = mTransitionCallbacks.find(mCurrentState);
-    if (callback != mTransitionCallbacks.end()) {
-        mCurrentTransitionCallback = callback->second;
-    } else {
-        mCurrentTransitionCallback = 0;
-    }
 }
@@ -19,9 +19,11 @@ http://www.cisst.org/cisst/license.txt.
 
 // system include
 #include <iostream>
+#include <algorithm>
 
 // cisst
 #include <sawIntuitiveResearchKit/mtsTeleOperationECM.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
 
 #include <cisstCommon/cmnUnits.h>
 #include <cisstMultiTask/mtsInterfaceProvided.h>
@@ -52,8 +54,9 @@ mtsTeleOperationECM::~mtsTeleOperationECM()
 void mtsTeleOperationECM::Init(void)
 {
     // configure state machine
-    mTeleopState.AddState("SETTING_ARMS_STATE");
-    mTeleopState.AddState("ENABLED");
+    mTeleopStateIndex.DISABLED = mTeleopState.Index("DISABLED");
+    mTeleopStateIndex.SETTING_ARMS_STATE = mTeleopState.AddState("SETTING_ARMS_STATE");
+    mTeleopStateIndex.ENABLED = mTeleopState.AddState("ENABLED");
     mTeleopState.AddAllowedDesiredState("DISABLED");
     mTeleopState.AddAllowedDesiredState("ENABLED");
 
@@ -94,6 +97,7 @@ void mtsTeleOperationECM::Init(void)
     StateTable.AddData(mMTML.m_measured_cp, "MTML/measured_cp");
     StateTable.AddData(mMTMR.m_measured_cp, "MTMR/measured_cp");
     StateTable.AddData(mECM.m_measured_cp, "ECM/measured_cp");
+    StateTable.AddData(m_input_latency.Latency(), "input/latency");
 
     mConfigurationStateTable = new mtsStateTable(100, "Configuration");
     mConfigurationStateTable->SetAutomaticAdvance(false);
@@ -166,6 +170,11 @@ void mtsTeleOperationECM::Init(void)
     if (interfaceRequired) {
         interfaceRequired->AddEventHandlerWrite(&mtsTeleOperationECM::ClutchEventHandler, this, "Button");
     }
+    // same events, directly from source, see console "direct-inputs"
+    interfaceRequired = AddInterfaceRequired("ClutchDirect", MTS_OPTIONAL);
+    if (interfaceRequired) {
+        interfaceRequired->AddEventHandlerWrite(&mtsTeleOperationECM::ClutchEventHandler, this, "Button");
+    }
 
     mInterface = AddInterfaceProvided("Setting");
     if (mInterface) {
@@ -190,6 +199,9 @@ void mtsTeleOperationECM::Init(void)
         mInterface->AddCommandReadState(StateTable,
                                         mECM.m_measured_cp,
                                         "ECM/measured_cp");
+        mInterface->AddCommandReadState(StateTable,
+                                        m_input_latency.Latency(),
+                                        "input/latency");
         // events
         mInterface->AddEventWrite(MessageEvents.desired_state,
                                   "desired_state", std::string(""));
@@ -205,20 +217,18 @@ void mtsTeleOperationECM::Init(void)
 
 void mtsTeleOperationECM::Configure(const std::string & filename)
 {
-    std::ifstream jsonStream;
     Json::Value jsonConfig;
-    Json::Reader jsonReader;
 
     if (filename == "") {
         return;
     }
 
-    jsonStream.open(filename.c_str());
-    if (!jsonReader.parse(jsonStream, jsonConfig)) {
+    std::string jsonErrors;
+    if (!mtsIntuitiveResearchKitConfigCache::Parse(filename, jsonConfig, jsonErrors)) {
         CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
                                  << ": failed to parse configuration file \""
                                  << filename << "\"\n"
-                                 << jsonReader.getFormattedErrorMessages();
+                                 << jsonErrors;
         exit(EXIT_FAILURE);
     }
 
@@ -252,17 +262,58 @@ void mtsTeleOperationECM::Configure(const Json::Value & jsonConfig)
 void mtsTeleOperationECM::Startup(void)
 {
     CMN_LOG_CLASS_INIT_VERBOSE << "Startup" << std::endl;
+    // startup is called from the task's thread
+    m_real_time.Apply(this->GetName());
+    m_heartbeat.Configure(this->GetName(), ExpectedPeriod());
+    // allocate flight recorder buffers before the component starts running
+    std::vector<std::string> columns = {"following", "clutched"};
+    for (const std::string & prefix : {"MTML/measured_cp/", "MTMR/measured_cp/", "ECM/measured_cp/"}) {
+        for (const std::string & axis : {"x", "y", "z"}) {
+            columns.push_back(prefix + axis);
+        }
+    }
+    for (size_t joint = 0; joint < 4; ++joint) {
+        columns.push_back("ECM/servo_jp/" + std::to_string(joint));
+    }
+    const size_t nbSamples = (m_flight_recorder.duration > 0.0) ?
+        static_cast<size_t>(m_flight_recorder.duration / ExpectedPeriod()) : 0;
+    m_flight_recorder.history.Allocate(this->GetName(), columns, nbSamples,
+                                       m_flight_recorder.directory);
     set_scale(m_scale);
     set_following(false);
 }
 
 void mtsTeleOperationECM::Run(void)
 {
+    // heartbeat for the health monitor, updated when Run returns
+    mtsIntuitiveResearchKitHeartbeat::ScopedCycle heartbeat(m_heartbeat);
     ProcessQueuedCommands();
     ProcessQueuedEvents();
 
     // run based on state
     mTeleopState.Run();
+    FlightRecorderSample();
+}
+
+void mtsTeleOperationECM::FlightRecorderSample(void)
+{
+    double * sample = m_flight_recorder.history.Sample(StateTable.GetTic());
+    if (!sample) {
+        return;
+    }
+    sample[1] = m_following ? 1.0 : 0.0;
+    sample[2] = m_clutched ? 1.0 : 0.0;
+    double * cursor = sample + 3;
+    for (const vct3 * translation : {&mMTML.m_measured_cp.Position().Translation(),
+                                     &mMTMR.m_measured_cp.Position().Translation(),
+                                     &mECM.m_measured_cp.Position().Translation()}) {
+        std::copy(translation->Pointer(), translation->Pointer() + 3, cursor);
+        cursor += 3;
+    }
+    const vctDoubleVec & goal = mECM.m_servo_jp.Goal();
+    for (size_t joint = 0; joint < 4; ++joint) {
+        cursor[joint] = (joint < goal.size()) ? goal.Element(joint) : 0.0;
+    }
 }
 
 void mtsTeleOperationECM::Cleanup(void)
@@ -272,8 +323,9 @@ void mtsTeleOperationECM::Cleanup(void)
 
 void mtsTeleOperationECM::StateChanged(void)
 {
-    const std::string newState = mTeleopState.CurrentState();
+    const std::string & newState = mTeleopState.CurrentState();
     MessageEvents.current_state(newState);
+    m_flight_recorder.history.Event(StateTable.GetTic(), "state " + newState);
     mInterface->SendStatus(this->GetName() + ": current state is " + newState);
 }
 
@@ -287,14 +339,14 @@ void mtsTeleOperationECM::RunAllStates(void)
         CMN_LOG_CLASS_RUN_ERROR << "Run: call to MTML.measured_cp failed \""
                                 << executionResult << "\"" << std::endl;
         mInterface->SendError(this->GetName() + ": unable to get cartesian position from MTML");
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     }
     executionResult = mMTML.measured_cv(mMTML.m_measured_cv);
     if (!executionResult.IsOK()) {
         CMN_LOG_CLASS_RUN_ERROR << "Run: call to MTML.measured_cv failed \""
                                 << executionResult << "\"" << std::endl;
         mInterface->SendError(this->GetName() + ": unable to get cartesian velocity from MTML");
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     }
 
     // get MTMR Cartesian position
@@ -303,14 +355,14 @@ void mtsTeleOperationECM::RunAllStates(void)
         CMN_LOG_CLASS_RUN_ERROR << "Run: call to MTMR.measured_cp failed \""
                                 << executionResult << "\"" << std::endl;
         mInterface->SendError(this->GetName() + ": unable to get cartesian position from MTMR");
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     }
     executionResult = mMTMR.measured_cv(mMTMR.m_measured_cv);
     if (!executionResult.IsOK()) {
         CMN_LOG_CLASS_RUN_ERROR << "Run: call to MTMR.measured_cv failed \""
                                 << executionResult << "\"" << std::endl;
         mInterface->SendError(this->GetName() + ": unable to get cartesian velocity from MTMR");
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     }
 
     // get ECM Cartesian position for GUI
@@ -319,7 +371,7 @@ void mtsTeleOperationECM::RunAllStates(void)
         CMN_LOG_CLASS_RUN_ERROR << "Run: call to ECM.measured_cp failed \""
                                 << executionResult << "\"" << std::endl;
         mInterface->SendError(this->GetName() + ": unable to get cartesian position from ECM");
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     }
     // for motion computation
     executionResult = mECM.setpoint_js(mECM.m_setpoint_js);
@@ -327,37 +379,37 @@ void mtsTeleOperationECM::RunAllStates(void)
         CMN_LOG_CLASS_RUN_ERROR << "Run: call to ECM.setpoint_js failed \""
                                 << executionResult << "\"" << std::endl;
         mInterface->SendError(this->GetName() + ": unable to get joint state from ECM");
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     }
 
     // check if anyone wanted to disable anyway
-    if ((mTeleopState.DesiredState() == "DISABLED")
-        && (mTeleopState.CurrentState() != "DISABLED")) {
+    if (mTeleopState.IsDesiredState(mTeleopStateIndex.DISABLED)
+        && !mTeleopState.IsCurrentState(mTeleopStateIndex.DISABLED)) {
         set_following(false);
-        mTeleopState.SetCurrentState("DISABLED");
+        mTeleopState.SetCurrentState(mTeleopStateIndex.DISABLED);
         return;
     }
 
     // monitor state of arms if needed
-    if ((mTeleopState.CurrentState() != "DISABLED")
-        && (mTeleopState.CurrentState() != "SETTING_ARMS_STATE")) {
+    if (!mTeleopState.IsCurrentState(mTeleopStateIndex.DISABLED)
+        && !mTeleopState.IsCurrentState(mTeleopStateIndex.SETTING_ARMS_STATE)) {
         prmOperatingState state;
         mECM.operating_state(state);
         if ((state.State() != prmOperatingState::ENABLED)
             || !state.IsHomed()) {
-            mTeleopState.SetDesiredState("DISABLED");
+            mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
             mInterface->SendError(this->GetName() + ": ECM is not in state \"READY\" anymore");
         }
         mMTML.operating_state(state);
         if ((state.State() != prmOperatingState::ENABLED)
             || !state.IsHomed()) {
-            mTeleopState.SetDesiredState("DISABLED");
+            mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
             mInterface->SendError(this->GetName() + ": MTML is not in state \"READY\" anymore");
         }
         mMTMR.operating_state(state);
         if ((state.State() != prmOperatingState::ENABLED)
             || !state.IsHomed()) {
-            mTeleopState.SetDesiredState("DISABLED");
+            mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
             mInterface->SendError(this->GetName() + ": MTMR is not in state \"READY\" anymore");
         }
     }
@@ -365,8 +417,8 @@ void mtsTeleOperationECM::RunAllStates(void)
 
 void mtsTeleOperationECM::TransitionDisabled(void)
 {
-    if (mTeleopState.DesiredState() == "ENABLED") {
-        mTeleopState.SetCurrentState("SETTING_ARMS_STATE");
+    if (mTeleopState.IsDesiredState(mTeleopStateIndex.ENABLED)) {
+        mTeleopState.SetCurrentState(mTeleopStateIndex.SETTING_ARMS_STATE);
     }
 }
 
@@ -412,13 +464,13 @@ void mtsTeleOperationECM::TransitionSettingArmsState(void)
     if ((ecmState.State() == prmOperatingState::ENABLED) && ecmState.IsHomed()
         && (mtmlState.State() == prmOperatingState::ENABLED) && mtmlState.IsHomed()
         && (mtmrState.State() == prmOperatingState::ENABLED) && mtmrState.IsHomed()) {
-        mTeleopState.SetCurrentState("ENABLED");
+        mTeleopState.SetCurrentState(mTeleopStateIndex.ENABLED);
         return;
     }
     // check timer
     if ((StateTable.GetTic() - mInStateTimer) > 60.0 * cmn_s) {
         mInterface->SendError(this->GetName() + ": timed out while setting up arms state");
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     }
 }
 
@@ -459,7 +511,14 @@ void mtsTeleOperationECM::EnterEnabled(void)
     mInitial.Cw.Assign(mInitial.Up[0], mInitial.Up[1], 0);
     mInitial.Cw.NormalizedSelf();
 
-    mInitial.ECMPositionJoint = mECM.m_setpoint_js.Position();
+    // ECM has 4 joints, all computations below use fixed size vectors
+    if (mECM.m_setpoint_js.Position().size() != 4) {
+        mInterface->SendError(this->GetName() + ": ECM setpoint_js must have 4 joints");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
+        return;
+    }
+    mInitial.ECMPositionJoint.Assign(mECM.m_setpoint_js.Position().Pointer());
+    mECM.m_servo_jp.Goal().SetSize(4);
 
     // -5- store current rotation matrix for MTML, MTMR, and ECM
     vctEulerZYXRotation3 eulerAngles;
@@ -479,7 +538,10 @@ void mtsTeleOperationECM::EnterEnabled(void)
               << "d:  " << mInitial.d << std::endl
               << "Si: " << side << std::endl;
 #endif
-    mInitial.ECMPositionJoint = mECM.m_setpoint_js.Position();
+    // wrenches sent in RunEnabled, torques are never used
+    mMTML.m_body_servo_cf.Force().SetAll(0.0);
+    mMTMR.m_body_servo_cf.Force().SetAll(0.0);
+
     // check if by any chance the clutch pedal is pressed
     if (m_clutched) {
         Clutch(true);
@@ -495,19 +557,22 @@ void mtsTeleOperationECM::RunEnabled(void)
     }
 
     /* --- Forces on MTMs --- */
-    const vct3 frictionForceCoeff(-10.0, -10.0, -40.0);
-    const double distanceForceCoeff = 150.0;
+    static const vct3 frictionForceCoeff(-10.0, -10.0, -40.0);
+    static const double distanceForceCoeff = 150.0;
+
+    const vct3 & positionL = mMTML.m_measured_cp.Position().Translation();
+    const vct3 & positionR = mMTMR.m_measured_cp.Position().Translation();
 
     //-1- vector between MTMs
     vct3 vectorLR;
-    vectorLR.DifferenceOf(mMTMR.m_measured_cp.Position().Translation(),
-                          mMTML.m_measured_cp.Position().Translation());
+    vectorLR.DifferenceOf(positionR, positionL);
     // -2- mid-point, aka center of image
     vct3 c;
-    c.SumOf(mMTMR.m_measured_cp.Position().Translation(),
-            mMTML.m_measured_cp.Position().Translation());
+    c.SumOf(positionR, positionL);
     c.Multiply(0.5);
-    vct3 directionC = c.Normalized();
+    const double cNorm = c.Norm();
+    vct3 directionC;
+    directionC.RatioOf(c, cNorm);
     // -3- image up vector
     vct3 up;
     up.CrossProductOf(vectorLR, c);
@@ -516,85 +581,64 @@ void mtsTeleOperationECM::RunEnabled(void)
     vct3 side;
     side.CrossProductOf(c, up);
     side.NormalizedSelf();
-    // -5- find desired position for L and R
-    vct3 goalL(c);
-    goalL.AddProductOf(-mInitial.w, side);
-    goalL.AddProductOf(-mInitial.d, directionC);
-    vct3 goalR(c);
-    goalR.AddProductOf(mInitial.w, side);
-    goalR.AddProductOf(mInitial.d, directionC);
-
 
-    // compute forces on L and R based on error in position
-    vct3 forceFriction;
+    // -5- forces on L and R based on error with desired positions and friction
     vct3 force;
-    prmForceCartesianSet wrenchR, wrenchL;
-
+    vct3 forceFriction;
     // MTMR
-    // apply force
-    force.DifferenceOf(goalR,
-                       mMTMR.m_measured_cp.Position().Translation());
+    force.Assign(c);
+    force.AddProductOf(mInitial.w, side);
+    force.AddProductOf(mInitial.d, directionC);
+    force.Subtract(positionR);
     force.Multiply(distanceForceCoeff);
-    wrenchR.Force().Ref<3>(0).Assign(force);
-    // add friction force
     forceFriction.ElementwiseProductOf(frictionForceCoeff,
                                        mMTMR.m_measured_cv.VelocityLinear());
-    wrenchR.Force().Ref<3>(0).Add(forceFriction);
-    // apply
-    mMTMR.body_servo_cf(wrenchR);
-
+    mMTMR.m_body_servo_cf.Force().Ref<3>(0).SumOf(force, forceFriction);
+    mMTMR.body_servo_cf(mMTMR.m_body_servo_cf);
     // MTML
-    // apply force
-    force.DifferenceOf(goalL,
-                       mMTML.m_measured_cp.Position().Translation());
+    force.Assign(c);
+    force.AddProductOf(-mInitial.w, side);
+    force.AddProductOf(-mInitial.d, directionC);
+    force.Subtract(positionL);
     force.Multiply(distanceForceCoeff);
-    wrenchL.Force().Ref<3>(0).Assign(force);
-    // add friction force
     forceFriction.ElementwiseProductOf(frictionForceCoeff,
                                        mMTML.m_measured_cv.VelocityLinear());
-    wrenchL.Force().Ref<3>(0).Add(forceFriction);
-    // apply
-    mMTML.body_servo_cf(wrenchL);
+    mMTML.m_body_servo_cf.Force().Ref<3>(0).SumOf(force, forceFriction);
+    mMTML.body_servo_cf(mMTML.m_body_servo_cf);
 
     /* --- Joint Control --- */
     static const vct3 normXZ(0.0, 1.0, 0.0);
     static const vct3 normYZ(1.0, 0.0, 0.0);
     static const vct3 normXY(0.0, 0.0, 1.0);
-    // Initial ECM joints
-    vctVec goalJoints(mInitial.ECMPositionJoint);
-    // Change in directions and joints
-    vctVec changeJoints(4);
-    vctVec changeDir(4);
-    vct3 crossN;  // normal to direction of motion
+    // Change in directions
+    vct4 changeDir;
 
     // - Direction 0 - left/right, movement in the XZ plane
-    vct3  lr(c[0], 0.0, c[2]);
+    vct3 lr(c[0], 0.0, c[2]);
     lr.NormalizedSelf();
     if (mInitial.Lr.AlmostEqual(lr)) {
         changeDir[0] = 0.0;
     } else {
         changeDir[0] = -acos(vctDotProduct(mInitial.Lr, lr));
-        crossN = vctCrossProduct(mInitial.Lr, lr);
-        if (vctDotProduct(normXZ, crossN) < 0.0) {
+        if (vctDotProduct(normXZ, vctCrossProduct(mInitial.Lr, lr)) < 0.0) {
             changeDir[0] = -changeDir[0];
         }
     }
 
     // - Direction 1 - up/down, movement in the YZ plane
-    vct3  ud(0.0, c[1], c[2]);
+    vct3 ud(0.0, c[1], c[2]);
     ud.NormalizedSelf();
     if (mInitial.Ud.AlmostEqual(ud)) {
         changeDir[1] = 0.0;
     } else {
         changeDir[1] = acos(vctDotProduct(mInitial.Ud, ud));
-        crossN = vctCrossProduct(mInitial.Ud, ud);
-        if (vctDotProduct(normYZ, crossN) < 0.0) {
+        if (vctDotProduct(normYZ, vctCrossProduct(mInitial.Ud, ud)) < 0.0) {
             changeDir[1] = -changeDir[1];
         }
     }
 
     // - Direction 2 - in/out
-    changeDir[2] = m_scale * (mInitial.C.Norm() - c.Norm());
+    changeDir[2] = m_scale * (mInitial.C.Norm() - cNorm);
 
     // - Direction 3 - cc/ccw, movement in the XY plane
     vct3 cw(up[0], up[1], 0);
@@ -603,53 +647,47 @@ void mtsTeleOperationECM::RunEnabled(void)
         changeDir[3] = 0.0;
     } else {
         changeDir[3] = -acos(vctDotProduct(mInitial.Cw, cw));
-        crossN = vctCrossProduct(mInitial.Cw, cw);
-        if (vctDotProduct(normXY, crossN) < 0) {
+        if (vctDotProduct(normXY, vctCrossProduct(mInitial.Cw, cw)) < 0) {
             changeDir[3] = -changeDir[3];
         }
     }
 
     // adjusting movement for camera orientation
-    double totalChangeJoint3 = changeDir[3] + mInitial.ECMPositionJoint[3];
-    changeJoints[0] = changeDir[0] * cos(totalChangeJoint3) - changeDir[1] * sin(totalChangeJoint3);
-    changeJoints[1] = changeDir[1] * cos(totalChangeJoint3) + changeDir[0] * sin(totalChangeJoint3);
-    changeJoints[2] = changeDir[2];
-    changeJoints[3] = changeDir[3];
-
-    goalJoints.Add(changeJoints);
-    mECM.m_servo_jp.Goal().ForceAssign(goalJoints);
+    const double totalChangeJoint3 = changeDir[3] + mInitial.ECMPositionJoint[3];
+    const double cosJoint3 = cos(totalChangeJoint3);
+    const double sinJoint3 = sin(totalChangeJoint3);
+    m_ecm_goal_jp.Assign(mInitial.ECMPositionJoint);
+    m_ecm_goal_jp[0] += changeDir[0] * cosJoint3 - changeDir[1] * sinJoint3;
+    m_ecm_goal_jp[1] += changeDir[1] * cosJoint3 + changeDir[0] * sinJoint3;
+    m_ecm_goal_jp[2] += changeDir[2];
+    m_ecm_goal_jp[3] += changeDir[3];
+
+    mECM.m_servo_jp.Goal().Assign(m_ecm_goal_jp.Pointer());
     mECM.servo_jp(mECM.m_servo_jp);
 
     /* --- Lock Orientation --- */
 
-    //Calculate new rotations of MTMs
-    vctMatRot3 currMTMLRot;
-    vctMatRot3 currMTMRRot;
-    // Current ECM Rotation
+    // ECM rotation from joint goal, ECM kinematics uses Euler ZYX on joints 3, 0, 1
     vctEulerZYXRotation3 finalEulerAngles;
-    vctMatrixRotation3<double> currECMRot;
-    vctMatrixRotation3<double> finalECMRot;
-
-    finalEulerAngles.Assign(goalJoints[3], goalJoints[0], goalJoints[1]);
+    vctMatRot3 finalECMRot;
+    finalEulerAngles.Assign(m_ecm_goal_jp[3], m_ecm_goal_jp[0], m_ecm_goal_jp[1]);
     vctEulerToMatrixRotation3(finalEulerAngles, finalECMRot);
-    currECMRot = finalECMRot * mInitial.ECMRotEuler.Inverse();
-
-    // Set MTM Orientation
-    currMTMLRot = currECMRot.Inverse() * mInitial.MTMLRot;
-    currMTMRRot = currECMRot.Inverse() * mInitial.MTMRRot;
-
-    // set cartesian effort parameters
-    mMTML.body_set_cf_orientation_absolute(true);
-    mMTML.lock_orientation(currMTMLRot);
-    mMTMR.body_set_cf_orientation_absolute(true);
-    mMTMR.lock_orientation(currMTMRRot);
+    // inverse of ECM rotation since enabled, i.e. initial * final^-1
+    vctMatRot3 inverseECMRot;
+    inverseECMRot.ProductOf(mInitial.ECMRotEuler, finalECMRot.Inverse());
+
+    // set MTM orientation, body_set_cf_orientation_absolute is set in EnterEnabled
+    mMTML.m_lock_orientation.ProductOf(inverseECMRot, mInitial.MTMLRot);
+    mMTML.lock_orientation(mMTML.m_lock_orientation);
+    mMTMR.m_lock_orientation.ProductOf(inverseECMRot, mInitial.MTMRRot);
+    mMTMR.lock_orientation(mMTMR.m_lock_orientation);
 }
 
 void mtsTeleOperationECM::TransitionEnabled(void)
 {
     if (mTeleopState.DesiredStateIsNotCurrent()) {
         set_following(false);
-        mTeleopState.SetCurrentState(mTeleopState.DesiredState());
+        mTeleopState.SetCurrentState(mTeleopState.DesiredStateIndex());
     }
 }
 
@@ -661,38 +699,55 @@ void mtsTeleOperationECM::set_following(const bool following)
 
 void mtsTeleOperationECM::MTMLErrorEventHandler(const mtsMessage & message)
 {
-    mTeleopState.SetDesiredState("DISABLED");
+    mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     mInterface->SendError(this->GetName() + ": received from MTML [" + message.Message + "]");
+    m_flight_recorder.history.Event(StateTable.GetTic(), "error from MTML " + message.Message);
+    m_flight_recorder.history.Trigger(StateTable.GetTic(), "error from MTML");
 }
 
 void mtsTeleOperationECM::MTMRErrorEventHandler(const mtsMessage & message)
 {
-    mTeleopState.SetDesiredState("DISABLED");
+    mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     mInterface->SendError(this->GetName() + ": received from MTMR [" + message.Message + "]");
+    m_flight_recorder.history.Event(StateTable.GetTic(), "error from MTMR " + message.Message);
+    m_flight_recorder.history.Trigger(StateTable.GetTic(), "error from MTMR");
 }
 
 void mtsTeleOperationECM::ECMErrorEventHandler(const mtsMessage & message)
 {
-    mTeleopState.SetDesiredState("DISABLED");
+    mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     mInterface->SendError(this->GetName() + ": received from ECM [" + message.Message + "]");
+    m_flight_recorder.history.Event(StateTable.GetTic(), "error from ECM " + message.Message);
+    m_flight_recorder.history.Trigger(StateTable.GetTic(), "error from ECM");
 }
 
 void mtsTeleOperationECM::ClutchEventHandler(const prmEventButton & button)
 {
+    bool clutched = m_clutched;
     switch (button.Type()) {
     case prmEventButton::PRESSED:
-        m_clutched = true;
+        clutched = true;
         break;
     case prmEventButton::RELEASED:
-        m_clutched = false;
+        clutched = false;
         break;
     default:
         break;
     }
 
+    // same edge can be received from console and source directly,
+    // first one wins
+    if (clutched == m_clutched) {
+        return;
+    }
+    m_clutched = clutched;
+
     // if the teleoperation is activated
-    if (mTeleopState.DesiredState() == "ENABLED") {
+    if (mTeleopState.IsDesiredState(mTeleopStateIndex.ENABLED)) {
         Clutch(m_clutched);
+        if (m_clutched) {
+            m_input_latency.Update(button);
+        }
     }
 }
 
@@ -714,7 +769,7 @@ void mtsTeleOperationECM::Clutch(const bool & clutch)
     } else {
         m_clutched = false;
         mInterface->SendStatus(this->GetName() + ": console clutch released");
-        mTeleopState.SetCurrentState("SETTING_ARMS_STATE");
+        mTeleopState.SetCurrentState(mTeleopStateIndex.SETTING_ARMS_STATE);
     }
 }
 
@@ -0,0 +1,46 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-21
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <sawIntuitiveResearchKit/mtsTeleOperationExecutor.h>
+
+CMN_IMPLEMENT_SERVICES_DERIVED_ONEARG(mtsTeleOperationExecutor, mtsTaskPeriodic, mtsTaskPeriodicConstructorArg)
+
+mtsTeleOperationExecutor::mtsTeleOperationExecutor(const std::string & componentName,
+                                                   const double periodInSeconds):
+    mtsTaskPeriodic(componentName, periodInSeconds)
+{
+}
+
+mtsTeleOperationExecutor::mtsTeleOperationExecutor(const mtsTaskPeriodicConstructorArg & arg):
+    mtsTaskPeriodic(arg)
+{
+}
+
+void mtsTeleOperationExecutor::Startup(void)
+{
+    // startup is called from the task's thread
+    m_real_time.Apply(this->GetName());
+}
+
+void mtsTeleOperationExecutor::Run(void)
+{
+    ProcessQueuedCommands();
+    ProcessQueuedEvents();
+    // trigger all tele-operation components connected to ExecOut
+    RunEvent();
+}
@@ -18,10 +18,12 @@
 
 // system include
 #include <iostream>
+#include <algorithm>
 
 // cisst
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKit.h>
 #include <sawIntuitiveResearchKit/mtsTeleOperationPSM.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
 #include <cisstMultiTask/mtsInterfaceProvided.h>
 #include <cisstMultiTask/mtsInterfaceRequired.h>
 #include <cisstParameterTypes/prmOperatingState.h>
@@ -50,9 +52,10 @@ mtsTeleOperationPSM::~mtsTeleOperationPSM()
 void mtsTeleOperationPSM::Init(void)
 {
     // configure state machine
-    mTeleopState.AddState("SETTING_ARMS_STATE");
-    mTeleopState.AddState("ALIGNING_MTM");
-    mTeleopState.AddState("ENABLED");
+    mTeleopStateIndex.DISABLED = mTeleopState.Index("DISABLED");
+    mTeleopStateIndex.SETTING_ARMS_STATE = mTeleopState.AddState("SETTING_ARMS_STATE");
+    mTeleopStateIndex.ALIGNING_MTM = mTeleopState.AddState("ALIGNING_MTM");
+    mTeleopStateIndex.ENABLED = mTeleopState.AddState("ENABLED");
     mTeleopState.AddAllowedDesiredState("ENABLED");
     mTeleopState.AddAllowedDesiredState("ALIGNING_MTM");
     mTeleopState.AddAllowedDesiredState("DISABLED");
@@ -106,6 +109,7 @@ void mtsTeleOperationPSM::Init(void)
     this->StateTable.AddData(mMTM.m_setpoint_cp, "MTM/setpoint_cp");
     this->StateTable.AddData(mPSM.m_setpoint_cp, "PSM/setpoint_cp");
     this->StateTable.AddData(m_alignment_offset, "alignment_offset");
+    this->StateTable.AddData(m_input_latency.Latency(), "input/latency");
 
     mConfigurationStateTable = new mtsStateTable(100, "Configuration");
     mConfigurationStateTable->SetAutomaticAdvance(false);
@@ -120,12 +124,16 @@ void mtsTeleOperationPSM::Init(void)
     mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired("MTM");
     if (interfaceRequired) {
         interfaceRequired->AddFunction("measured_cp", mMTM.measured_cp);
+        interfaceRequired->AddFunction("measured_cv", mMTM.measured_cv, MTS_OPTIONAL);
         interfaceRequired->AddFunction("setpoint_cp", mMTM.setpoint_cp);
         interfaceRequired->AddFunction("move_cp", mMTM.move_cp);
+        interfaceRequired->AddFunction("align_cp", mMTM.align_cp, MTS_OPTIONAL);
         interfaceRequired->AddFunction("gripper/measured_js", mMTM.gripper_measured_js);
         interfaceRequired->AddFunction("lock_orientation", mMTM.lock_orientation, MTS_OPTIONAL);
         interfaceRequired->AddFunction("unlock_orientation", mMTM.unlock_orientation, MTS_OPTIONAL);
         interfaceRequired->AddFunction("body/servo_cf", mMTM.servo_cf_body);
+        interfaceRequired->AddFunction("body/set_cf_orientation_absolute", mMTM.body_set_cf_orientation_absolute, MTS_OPTIONAL);
+        interfaceRequired->AddFunction("body/cf_orientation_absolute", mMTM.body_cf_orientation_absolute, MTS_OPTIONAL);
         interfaceRequired->AddFunction("use_gravity_compensation", mMTM.use_gravity_compensation);
         interfaceRequired->AddFunction("operating_state", mMTM.operating_state);
         interfaceRequired->AddFunction("state_command", mMTM.state_command);
@@ -137,10 +145,12 @@ void mtsTeleOperationPSM::Init(void)
     if (interfaceRequired) {
         interfaceRequired->AddFunction("setpoint_cp", mPSM.setpoint_cp);
         interfaceRequired->AddFunction("servo_cp", mPSM.servo_cp);
+        interfaceRequired->AddFunction("servo_cp/latency", mPSM.servo_cp_latency, MTS_OPTIONAL);
         interfaceRequired->AddFunction("Freeze", mPSM.Freeze);
         interfaceRequired->AddFunction("jaw/setpoint_js", mPSM.jaw_setpoint_js, MTS_OPTIONAL);
         interfaceRequired->AddFunction("jaw/configuration_js", mPSM.jaw_configuration_js, MTS_OPTIONAL);
         interfaceRequired->AddFunction("jaw/servo_jp", mPSM.jaw_servo_jp, MTS_OPTIONAL);
+        interfaceRequired->AddFunction("body/measured_cf", mPSM.body_measured_cf, MTS_OPTIONAL);
         interfaceRequired->AddFunction("operating_state", mPSM.operating_state);
         interfaceRequired->AddFunction("state_command", mPSM.state_command);
         interfaceRequired->AddEventHandlerWrite(&mtsTeleOperationPSM::PSMErrorEventHandler,
@@ -152,6 +162,19 @@ void mtsTeleOperationPSM::Init(void)
     if (interfaceRequired) {
         interfaceRequired->AddEventHandlerWrite(&mtsTeleOperationPSM::ClutchEventHandler, this, "Button");
     }
+    // same events, directly from source, see console "direct-inputs"
+    interfaceRequired = AddInterfaceRequired("ClutchDirect", MTS_OPTIONAL);
+    if (interfaceRequired) {
+        interfaceRequired->AddEventHandlerWrite(&mtsTeleOperationPSM::ClutchEventHandler, this, "Button");
+    }
+    interfaceRequired = AddInterfaceRequired("OperatorPresentDirect", MTS_OPTIONAL);
+    if (interfaceRequired) {
+        interfaceRequired->AddEventHandlerWrite(&mtsTeleOperationPSM::OperatorPresentDirectEventHandler, this, "Button");
+    }
+    interfaceRequired = AddInterfaceRequired("CameraDirect", MTS_OPTIONAL);
+    if (interfaceRequired) {
+        interfaceRequired->AddEventHandlerWrite(&mtsTeleOperationPSM::CameraDirectEventHandler, this, "Button");
+    }
 
     interfaceRequired = AddInterfaceRequired("PSM-base-frame", MTS_OPTIONAL);
     if (interfaceRequired) {
@@ -164,6 +187,8 @@ void mtsTeleOperationPSM::Init(void)
         // commands
         mInterface->AddCommandReadState(StateTable, StateTable.PeriodStats,
                                         "period_statistics"); // mtsIntervalStatistics
+        mInterface->AddCommandRead(&mtsTeleOperationPSM::gui_snapshot, this,
+                                   "gui_snapshot");
 
         mInterface->AddCommandWrite(&mtsTeleOperationPSM::state_command, this,
                                     "state_command", std::string());
@@ -198,6 +223,9 @@ void mtsTeleOperationPSM::Init(void)
         mInterface->AddCommandReadState(this->StateTable,
                                         m_alignment_offset,
                                         "alignment_offset");
+        mInterface->AddCommandReadState(this->StateTable,
+                                        m_input_latency.Latency(),
+                                        "input/latency");
         // events
         mInterface->AddEventWrite(MessageEvents.desired_state,
                                   "desired_state", std::string(""));
@@ -223,20 +251,18 @@ void mtsTeleOperationPSM::Init(void)
 
 void mtsTeleOperationPSM::Configure(const std::string & filename)
 {
-    std::ifstream jsonStream;
     Json::Value jsonConfig;
-    Json::Reader jsonReader;
 
     if (filename == "") {
         return;
     }
 
-    jsonStream.open(filename.c_str());
-    if (!jsonReader.parse(jsonStream, jsonConfig)) {
+    std::string jsonErrors;
+    if (!mtsIntuitiveResearchKitConfigCache::Parse(filename, jsonConfig, jsonErrors)) {
         CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
                                  << ": failed to parse configuration file \""
                                  << filename << "\"\n"
-                                 << jsonReader.getFormattedErrorMessages();
+                                 << jsonErrors;
         exit(EXIT_FAILURE);
     }
 
@@ -381,17 +407,106 @@ void mtsTeleOperationPSM::Configure(const Json::Value & jsonConfig)
     if (!jsonValue.empty()) {
         m_align_mtm = jsonValue.asBool();
     }
+
+    // optional prediction to compensate latency
+    const Json::Value jsonPrediction = jsonConfig["prediction"];
+    if (!jsonPrediction.empty()) {
+        m_prediction.enabled = jsonPrediction.get("enabled", true).asBool();
+        jsonValue = jsonPrediction["horizon"];
+        if (!jsonValue.empty()) {
+            m_prediction.measured_horizon = false;
+            m_prediction.horizon = jsonValue.asDouble();
+            if (m_prediction.horizon < 0.0) {
+                CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
+                                         << ": \"prediction\": { \"horizon\": } must be a positive number.  Found "
+                                         << m_prediction.horizon << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        jsonValue = jsonPrediction["horizon-max"];
+        if (!jsonValue.empty()) {
+            m_prediction.horizon_max = jsonValue.asDouble();
+        }
+        // limits can be a single value or one per axis
+        std::vector<std::pair<std::string, vct3 *> > limits
+            = {{"translation-limit", &m_prediction.translation_limit},
+               {"rotation-limit", &m_prediction.rotation_limit}};
+        for (auto & limit : limits) {
+            jsonValue = jsonPrediction[limit.first];
+            if (jsonValue.empty()) {
+                continue;
+            }
+            if (jsonValue.isArray()) {
+                cmnDataJSON<vct3>::DeSerializeText(*(limit.second), jsonValue);
+            } else {
+                limit.second->SetAll(jsonValue.asDouble());
+            }
+            if (limit.second->Min() < 0.0) {
+                CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
+                                         << ": \"prediction\": { \"" << limit.first
+                                         << "\": } must be positive.  Found " << *(limit.second) << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // optional force feedback
+    const Json::Value jsonHaptic = jsonConfig["haptic-feedback"];
+    if (!jsonHaptic.empty()) {
+        m_haptic_feedback.enabled = jsonHaptic.get("enabled", true).asBool();
+        m_haptic_feedback.gain = jsonHaptic.get("gain", m_haptic_feedback.gain).asDouble();
+        m_haptic_feedback.cutoff = jsonHaptic.get("cutoff", m_haptic_feedback.cutoff).asDouble();
+        m_haptic_feedback.force_deadband = jsonHaptic.get("force-deadband", m_haptic_feedback.force_deadband).asDouble();
+        m_haptic_feedback.force_max = jsonHaptic.get("force-max", m_haptic_feedback.force_max).asDouble();
+        m_haptic_feedback.torque = jsonHaptic.get("torque", m_haptic_feedback.torque).asBool();
+        m_haptic_feedback.torque_deadband = jsonHaptic.get("torque-deadband", m_haptic_feedback.torque_deadband).asDouble();
+        m_haptic_feedback.torque_max = jsonHaptic.get("torque-max", m_haptic_feedback.torque_max).asDouble();
+        if ((m_haptic_feedback.gain < 0.0)
+            || (m_haptic_feedback.cutoff <= 0.0)
+            || (m_haptic_feedback.force_deadband < 0.0)
+            || (m_haptic_feedback.force_max < 0.0)
+            || (m_haptic_feedback.torque_deadband < 0.0)
+            || (m_haptic_feedback.torque_max < 0.0)) {
+            CMN_LOG_CLASS_INIT_ERROR << "Configure " << this->GetName()
+                                     << ": \"haptic-feedback\": \"gain\", \"cutoff\", deadbands and max values must be positive" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
 }
 
 void mtsTeleOperationPSM::Startup(void)
 {
     CMN_LOG_CLASS_INIT_VERBOSE << "Startup" << std::endl;
+    // startup is called from the task's thread
+    m_real_time.Apply(this->GetName());
+    m_heartbeat.Configure(this->GetName(), ExpectedPeriod());
+    // allocate flight recorder buffers before the component starts running
+    std::vector<std::string> columns = {"following", "clutched"};
+    for (const std::string & prefix : {"MTM/measured_cp/", "PSM/setpoint_cp/", "PSM/servo_cp/"}) {
+        for (const std::string & axis : {"x", "y", "z"}) {
+            columns.push_back(prefix + axis);
+        }
+    }
+    const size_t nbSamples = (m_flight_recorder.duration > 0.0) ?
+        static_cast<size_t>(m_flight_recorder.duration / ExpectedPeriod()) : 0;
+    m_flight_recorder.history.Allocate(this->GetName(), columns, nbSamples,
+                                       m_flight_recorder.directory);
     set_scale(m_scale);
     set_following(false);
     lock_rotation(m_rotation_locked);
     lock_translation(m_translation_locked);
     set_align_mtm(m_align_mtm);
 
+    // force feedback filter, first order low pass at the expected rate
+    const double tau = 1.0 / (2.0 * cmnPI * m_haptic_feedback.cutoff);
+    m_haptic_feedback.alpha = ExpectedPeriod() / (tau + ExpectedPeriod());
+    if (m_haptic_feedback.enabled
+        && (!mPSM.body_measured_cf.IsValid()
+            || !mMTM.body_set_cf_orientation_absolute.IsValid())) {
+        mInterface->SendError(this->GetName() + ": optional functions \"body/measured_cf\" (PSM) and \"body/set_cf_orientation_absolute\" (MTM) are required for haptic feedback, disabling haptic feedback");
+        m_haptic_feedback.enabled = false;
+    }
+
     // check if functions for jaw are connected
     if (!m_jaw.ignore) {
         if (!mPSM.jaw_setpoint_js.IsValid()
@@ -404,11 +519,60 @@ void mtsTeleOperationPSM::Startup(void)
 
 void mtsTeleOperationPSM::Run(void)
 {
+    // heartbeat for the health monitor, updated when Run returns
+    mtsIntuitiveResearchKitHeartbeat::ScopedCycle heartbeat(m_heartbeat);
     ProcessQueuedCommands();
     ProcessQueuedEvents();
 
     // run based on state
     mTeleopState.Run();
+    FlightRecorderSample();
+    if (m_gui_snapshot.requested.load(std::memory_order_relaxed)) {
+        const double now = StateTable.GetTic();
+        if ((now - m_gui_snapshot.last_publish) >= m_gui_snapshot.publish_interval) {
+            GUISnapshotPublish(now);
+        }
+    }
+}
+
+void mtsTeleOperationPSM::GUISnapshotPublish(const double now)
+{
+    m_gui_snapshot.last_publish = now;
+    m_gui_snapshot.requested = false;
+    mtsTeleOperationPSMSnapshot & snapshot = m_gui_snapshot.data;
+    m_gui_snapshot.mutex.Lock();
+    snapshot.MTM_measured_cp.From(mMTM.m_measured_cp);
+    snapshot.PSM_setpoint_cp.From(mPSM.m_setpoint_cp);
+    snapshot.registration_rotation.Assign(m_registration_rotation);
+    snapshot.alignment_offset.Assign(m_alignment_offset);
+    snapshot.timestamp = now;
+    m_gui_snapshot.mutex.Unlock();
+}
+
+void mtsTeleOperationPSM::gui_snapshot(mtsTeleOperationPSMSnapshot & snapshot) const
+{
+    m_gui_snapshot.mutex.Lock();
+    snapshot = m_gui_snapshot.data;
+    m_gui_snapshot.mutex.Unlock();
+    // ask Run to update the snapshot for next read
+    m_gui_snapshot.requested = true;
+}
+
+void mtsTeleOperationPSM::FlightRecorderSample(void)
+{
+    double * sample = m_flight_recorder.history.Sample(StateTable.GetTic());
+    if (!sample) {
+        return;
+    }
+    sample[1] = m_following ? 1.0 : 0.0;
+    sample[2] = m_clutched ? 1.0 : 0.0;
+    double * cursor = sample + 3;
+    for (const vct3 * translation : {&mMTM.m_measured_cp.Position().Translation(),
+                                     &mPSM.m_setpoint_cp.Position().Translation(),
+                                     &mPSM.m_servo_cp.Goal().Translation()}) {
+        std::copy(translation->Pointer(), translation->Pointer() + 3, cursor);
+        cursor += 3;
+    }
 }
 
 void mtsTeleOperationPSM::Cleanup(void)
@@ -418,32 +582,101 @@ void mtsTeleOperationPSM::Cleanup(void)
 
 void mtsTeleOperationPSM::MTMErrorEventHandler(const mtsMessage & message)
 {
-    mTeleopState.SetDesiredState("DISABLED");
+    mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     mInterface->SendError(this->GetName() + ": received from MTM [" + message.Message + "]");
+    m_flight_recorder.history.Event(StateTable.GetTic(), "error from MTM " + message.Message);
+    m_flight_recorder.history.Trigger(StateTable.GetTic(), "error from MTM");
 }
 
 void mtsTeleOperationPSM::PSMErrorEventHandler(const mtsMessage & message)
 {
-    mTeleopState.SetDesiredState("DISABLED");
+    mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     mInterface->SendError(this->GetName() + ": received from PSM [" + message.Message + "]");
+    m_flight_recorder.history.Event(StateTable.GetTic(), "error from PSM " + message.Message);
+    m_flight_recorder.history.Trigger(StateTable.GetTic(), "error from PSM");
 }
 
 void mtsTeleOperationPSM::ClutchEventHandler(const prmEventButton & button)
 {
+    bool clutched = m_clutched;
     switch (button.Type()) {
     case prmEventButton::PRESSED:
-        m_clutched = true;
+        clutched = true;
         break;
     case prmEventButton::RELEASED:
-        m_clutched = false;
+        clutched = false;
         break;
     default:
         break;
     }
 
+    // same edge can be received from console and source directly,
+    // first one wins
+    if (clutched == m_clutched) {
+        return;
+    }
+    m_clutched = clutched;
+
     // if the teleoperation is activated
-    if (mTeleopState.DesiredState() == "ENABLED") {
+    if (mTeleopState.IsDesiredState(mTeleopStateIndex.ENABLED)) {
         Clutch(m_clutched);
+        if (m_clutched) {
+            m_input_latency.Update(button);
+        }
+    }
+}
+
+void mtsTeleOperationPSM::OperatorPresentDirectEventHandler(const prmEventButton & button)
+{
+    switch (button.Type()) {
+    case prmEventButton::PRESSED:
+        m_operator_present_direct = true;
+        break;
+    case prmEventButton::RELEASED:
+        m_operator_present_direct = false;
+        break;
+    default:
+        return;
+    }
+    UpdateInputSuspended(button);
+}
+
+void mtsTeleOperationPSM::CameraDirectEventHandler(const prmEventButton & button)
+{
+    switch (button.Type()) {
+    case prmEventButton::PRESSED:
+        m_camera_pressed_direct = true;
+        break;
+    case prmEventButton::RELEASED:
+        m_camera_pressed_direct = false;
+        break;
+    default:
+        return;
+    }
+    UpdateInputSuspended(button);
+}
+
+void mtsTeleOperationPSM::UpdateInputSuspended(const prmEventButton & button)
+{
+    const bool suspended = !m_operator_present_direct || m_camera_pressed_direct;
+    if (suspended == m_input_suspended) {
+        return;
+    }
+    m_input_suspended = suspended;
+    if (!mTeleopState.IsCurrentState(mTeleopStateIndex.ENABLED)) {
+        return;
+    }
+    if (m_input_suspended) {
+        // stop now, console will update the teleoperation state
+        if (m_following) {
+            set_following(false);
+            mPSM.Freeze();
+            m_input_latency.Update(button);
+        }
+    } else if (!m_clutched) {
+        // console didn't change state, restart from current positions
+        mTeleopState.SetCurrentState(mTeleopStateIndex.SETTING_ARMS_STATE);
+        m_jaw_caught_up_after_clutch = false;
     }
 }
 
@@ -474,7 +707,7 @@ void mtsTeleOperationPSM::Clutch(const bool & clutch)
         mPSM.Freeze();
     } else {
         mInterface->SendStatus(this->GetName() + ": console clutch released");
-        mTeleopState.SetCurrentState("SETTING_ARMS_STATE");
+        mTeleopState.SetCurrentState(mTeleopStateIndex.SETTING_ARMS_STATE);
         m_back_from_clutch = true;
         m_jaw_caught_up_after_clutch = false;
     }
@@ -541,6 +774,8 @@ void mtsTeleOperationPSM::UpdateInitialState(void)
     m_alignment_offset_initial = m_alignment_offset;
     if (mBaseFrame.measured_cp.IsValid()) {
         mBaseFrame.CartesianInitial.From(mBaseFrame.m_measured_cp.Position());
+        // force update of cached base frame change
+        mBaseFrame.Version++;
     }
 }
 
@@ -573,12 +808,13 @@ void mtsTeleOperationPSM::lock_rotation(const bool & lock)
     // so force re-align
     if (lock == false) {
         set_following(false);
-        mTeleopState.SetCurrentState("DISABLED");
+        HapticFeedbackRestore();
+        mTeleopState.SetCurrentState(mTeleopStateIndex.DISABLED);
     } else {
         // update MTM/PSM previous position
         UpdateInitialState();
         // lock orientation if the arm is running
-        if (mTeleopState.CurrentState() == "ENABLED") {
+        if (mTeleopState.IsCurrentState(mTeleopStateIndex.ENABLED)) {
             mMTM.lock_orientation(mMTM.m_measured_cp.Position().Rotation());
         }
     }
@@ -610,15 +846,17 @@ void mtsTeleOperationPSM::set_align_mtm(const bool & alignMTM)
     mConfigurationStateTable->Advance();
     ConfigurationEvents.align_mtm(m_align_mtm);
     // force re-align if the teleop is already enabled
-    if (mTeleopState.CurrentState() == "ENABLED") {
-        mTeleopState.SetCurrentState("DISABLED");
+    if (mTeleopState.IsCurrentState(mTeleopStateIndex.ENABLED)) {
+        HapticFeedbackRestore();
+        mTeleopState.SetCurrentState(mTeleopStateIndex.DISABLED);
     }
 }
 
 void mtsTeleOperationPSM::StateChanged(void)
 {
-    const std::string newState = mTeleopState.CurrentState();
+    const std::string & newState = mTeleopState.CurrentState();
     MessageEvents.current_state(newState);
+    m_flight_recorder.history.Event(StateTable.GetTic(), "state " + newState);
     mInterface->SendStatus(this->GetName() + ": current state is " + newState);
 }
 
@@ -632,7 +870,7 @@ void mtsTeleOperationPSM::RunAllStates(void)
         CMN_LOG_CLASS_RUN_ERROR << "Run: call to MTM.measured_cp failed \""
                                 << executionResult << "\"" << std::endl;
         mInterface->SendError(this->GetName() + ": unable to get cartesian position from MTM");
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     }
     executionResult = mMTM.setpoint_cp(mMTM.m_setpoint_cp);
     if (!executionResult.IsOK()) {
@@ -640,13 +878,34 @@ void mtsTeleOperationPSM::RunAllStates(void)
                                 << executionResult << "\"" << std::endl;
     }
 
+    // data used for prediction
+    if (m_prediction.enabled) {
+        if (mMTM.measured_cv.IsValid()) {
+            mMTM.measured_cv(mMTM.m_measured_cv);
+        }
+        if (m_prediction.measured_horizon
+            && mPSM.servo_cp_latency.IsValid()) {
+            mPSM.servo_cp_latency(mPSM.m_servo_cp_latency);
+        }
+    }
+
     // get PSM Cartesian position
     executionResult = mPSM.setpoint_cp(mPSM.m_setpoint_cp);
     if (!executionResult.IsOK()) {
         CMN_LOG_CLASS_RUN_ERROR << "Run: call to PSM.setpoint_cp failed \""
                                 << executionResult << "\"" << std::endl;
         mInterface->SendError(this->GetName() + ": unable to get cartesian position from PSM");
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
+    }
+
+    // PSM wrench, in same cycle as pose for force feedback
+    if (m_haptic_feedback.enabled && m_following) {
+        executionResult = mPSM.body_measured_cf(mPSM.m_body_measured_cf);
+        if (!executionResult.IsOK()) {
+            CMN_LOG_CLASS_RUN_ERROR << "Run: call to PSM.body/measured_cf failed \""
+                                    << executionResult << "\"" << std::endl;
+            mPSM.m_body_measured_cf.SetValid(false);
+        }
     }
 
     // get base-frame cartesian position if available
@@ -656,32 +915,36 @@ void mtsTeleOperationPSM::RunAllStates(void)
             CMN_LOG_CLASS_RUN_ERROR << "Run: call to m_base_frame.measured_cp failed \""
                                     << executionResult << "\"" << std::endl;
             mInterface->SendError(this->GetName() + ": unable to get cartesian position from base frame");
-            mTeleopState.SetDesiredState("DISABLED");
+            mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
+        } else if (!mBaseFrame.Last.Equal(mBaseFrame.m_measured_cp.Position())) {
+            mBaseFrame.Last.Assign(mBaseFrame.m_measured_cp.Position());
+            mBaseFrame.Version++;
         }
     }
 
     // check if anyone wanted to disable anyway
-    if ((mTeleopState.DesiredState() == "DISABLED")
-        && (mTeleopState.CurrentState() != "DISABLED")) {
+    if (mTeleopState.IsDesiredState(mTeleopStateIndex.DISABLED)
+        && !mTeleopState.IsCurrentState(mTeleopStateIndex.DISABLED)) {
         set_following(false);
-        mTeleopState.SetCurrentState("DISABLED");
+        HapticFeedbackRestore();
+        mTeleopState.SetCurrentState(mTeleopStateIndex.DISABLED);
         return;
     }
 
     // monitor state of arms if needed
-    if ((mTeleopState.CurrentState() != "DISABLED")
-        && (mTeleopState.CurrentState() != "SETTING_ARMS_STATE")) {
+    if (!mTeleopState.IsCurrentState(mTeleopStateIndex.DISABLED)
+        && !mTeleopState.IsCurrentState(mTeleopStateIndex.SETTING_ARMS_STATE)) {
         prmOperatingState state;
         mPSM.operating_state(state);
         if ((state.State() != prmOperatingState::ENABLED)
             || !state.IsHomed()) {
-            mTeleopState.SetDesiredState("DISABLED");
+            mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
             mInterface->SendError(this->GetName() + ": PSM is not in state \"ENABLED\" anymore");
         }
         mMTM.operating_state(state);
         if ((state.State() != prmOperatingState::ENABLED)
             || !state.IsHomed()) {
-            mTeleopState.SetDesiredState("DISABLED");
+            mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
             mInterface->SendError(this->GetName() + ": MTM is not in state \"READY\" anymore");
         }
     }
@@ -689,8 +952,10 @@ void mtsTeleOperationPSM::RunAllStates(void)
 
 void mtsTeleOperationPSM::TransitionDisabled(void)
 {
+    // in case ENABLED was left through SETTING_ARMS_STATE (clutch)
+    HapticFeedbackRestore();
     if (mTeleopState.DesiredStateIsNotCurrent()) {
-        mTeleopState.SetCurrentState("SETTING_ARMS_STATE");
+        mTeleopState.SetCurrentState(mTeleopStateIndex.SETTING_ARMS_STATE);
     }
 }
 
@@ -726,7 +991,7 @@ void mtsTeleOperationPSM::TransitionSettingArmsState(void)
     mMTM.operating_state(mtmState);
     if ((psmState.State() == prmOperatingState::ENABLED) && psmState.IsHomed()
         && (mtmState.State() == prmOperatingState::ENABLED) && mtmState.IsHomed()) {
-        mTeleopState.SetCurrentState("ALIGNING_MTM");
+        mTeleopState.SetCurrentState(mTeleopStateIndex.ALIGNING_MTM);
         return;
     }
     // check timer
@@ -737,7 +1002,7 @@ void mtsTeleOperationPSM::TransitionSettingArmsState(void)
         if (!((mtmState.State() == prmOperatingState::ENABLED) && mtmState.IsHomed())) {
             mInterface->SendError(this->GetName() + ": timed out while setting up MTM state");
         }
-        mTeleopState.SetDesiredState("DISABLED");
+        mTeleopState.SetDesiredState(mTeleopStateIndex.DISABLED);
     }
 }
 
@@ -781,9 +1046,11 @@ void mtsTeleOperationPSM::RunAligningMTM(void)
         return;
     }
 
-    // set trajectory goal periodically, this will track PSM motion
+    // stream goal if the MTM supports it, otherwise set trajectory
+    // goal periodically, this will track PSM motion
+    const bool stream = mMTM.align_cp.IsValid();
     const double currentTime = StateTable.GetTic();
-    if ((currentTime - mTimeSinceLastAlign) > 10.0 * cmn_ms) {
+    if (stream || ((currentTime - mTimeSinceLastAlign) > 10.0 * cmn_ms)) {
         mTimeSinceLastAlign = currentTime;
         // Orientate MTM with PSM
         vctFrm4x4 mtmCartesianGoal;
@@ -793,7 +1060,11 @@ void mtsTeleOperationPSM::RunAligningMTM(void)
         mtmCartesianGoal.Rotation().FromNormalized(mtmRotation);
         // convert to prm type
         mMTM.m_move_cp.Goal().From(mtmCartesianGoal);
-        mMTM.move_cp(mMTM.m_move_cp);
+        if (stream) {
+            mMTM.align_cp(mMTM.m_move_cp);
+        } else {
+            mMTM.move_cp(mMTM.m_move_cp);
+        }
     }
 }
 
@@ -850,8 +1121,8 @@ void mtsTeleOperationPSM::TransitionAligningMTM(void)
     // finally check for transition
     if ((orientationError <= m_operator.orientation_tolerance)
         && m_operator.is_active) {
-        if (mTeleopState.DesiredState() == "ENABLED") {
-            mTeleopState.SetCurrentState("ENABLED");
+        if (mTeleopState.IsDesiredState(mTeleopStateIndex.ENABLED)) {
+            mTeleopState.SetCurrentState(mTeleopStateIndex.ENABLED);
         }
     } else {
         // check timer and issue a message
@@ -871,6 +1142,11 @@ void mtsTeleOperationPSM::TransitionAligningMTM(void)
 
 void mtsTeleOperationPSM::EnterEnabled(void)
 {
+    // console enabled the teleoperation, inputs are consistent
+    m_operator_present_direct = true;
+    m_camera_pressed_direct = false;
+    m_input_suspended = false;
+
     // update MTM/PSM previous position
     UpdateInitialState();
 
@@ -888,6 +1164,20 @@ void mtsTeleOperationPSM::EnterEnabled(void)
     // set forces to zero and lock/unlock orientation as needed
     prmForceCartesianSet wrench;
     mMTM.servo_cf_body(wrench);
+    if (m_haptic_feedback.enabled) {
+        // feedback wrench is computed in MTM base frame, save current
+        // setting so it can be restored when leaving ENABLED.  Back
+        // from clutch, the setting has already been saved
+        if (!m_haptic_feedback.orientation_absolute_saved) {
+            m_haptic_feedback.previous_orientation_absolute = false;
+            if (mMTM.body_cf_orientation_absolute.IsValid()) {
+                mMTM.body_cf_orientation_absolute(m_haptic_feedback.previous_orientation_absolute);
+            }
+            m_haptic_feedback.orientation_absolute_saved = true;
+        }
+        mMTM.body_set_cf_orientation_absolute(true);
+        m_haptic_feedback.filtered.SetAll(0.0);
+    }
     if (m_rotation_locked) {
         mMTM.lock_orientation(mMTM.m_measured_cp.Position().Rotation());
     } else {
@@ -906,9 +1196,12 @@ void mtsTeleOperationPSM::RunEnabled(void)
     if (mMTM.m_measured_cp.Valid()
         && mPSM.m_setpoint_cp.Valid()) {
         // follow mode
-        if (!m_clutched) {
+        if (!m_clutched && !m_input_suspended) {
             // compute mtm Cartesian motion
             vctFrm4x4 mtmPosition(mMTM.m_measured_cp.Position());
+            if (m_prediction.enabled) {
+                PredictMTMPosition(mtmPosition);
+            }
 
             // translation
             vct3 mtmTranslation;
@@ -935,18 +1228,28 @@ void mtsTeleOperationPSM::RunEnabled(void)
 
             // take into account changes in PSM base frame if any
             if (mBaseFrame.measured_cp.IsValid()) {
-                vctFrm4x4 baseFrame(mBaseFrame.m_measured_cp.Position());
-                vctFrm4x4 baseFrameChange = baseFrame.Inverse() * mBaseFrame.CartesianInitial;
+                if (mBaseFrame.ChangeVersion != mBaseFrame.Version) {
+                    vctFrm4x4 baseFrame(mBaseFrame.m_measured_cp.Position());
+                    mBaseFrame.Change = baseFrame.Inverse() * mBaseFrame.CartesianInitial;
+                    mBaseFrame.ChangeVersion = mBaseFrame.Version;
+                }
                 // update PSM position goal
-                psmCartesianGoal = baseFrameChange * psmCartesianGoal;
+                psmCartesianGoal = mBaseFrame.Change * psmCartesianGoal;
                 // update alignment offset
                 mtmPosition.Rotation().ApplyInverseTo(psmCartesianGoal.Rotation(), m_alignment_offset);
             }
 
             // PSM go this cartesian position
             mPSM.m_servo_cp.Goal().FromNormalized(psmCartesianGoal);
+            // propagate MTM timestamp so PSM can measure end-to-end latency
+            mPSM.m_servo_cp.SetTimestamp(mMTM.m_measured_cp.Timestamp());
             mPSM.servo_cp(mPSM.m_servo_cp);
 
+            // force feedback using PSM wrench read in this cycle
+            if (m_haptic_feedback.enabled) {
+                HapticFeedback();
+            }
+
             if (!m_jaw.ignore) {
                 // gripper
                 if (mMTM.gripper_measured_js.IsValid()) {
@@ -959,10 +1262,15 @@ void mtsTeleOperationPSM::RunEnabled(void)
                             m_jaw_caught_up_after_clutch = true;
                         }
                     }
-                    // pick the rate based on back from clutch or not
+                    // pick the rate based on back from clutch or not,
+                    // expected period until the state table has stats
+                    double period = StateTable.PeriodStats.PeriodAvg();
+                    if (period <= 0.0) {
+                        period = ExpectedPeriod();
+                    }
                     const double delta = m_jaw_caught_up_after_clutch ?
-                        m_jaw.rate * StateTable.PeriodStats.PeriodAvg()
-                        : m_jaw.rate_back_from_clutch * StateTable.PeriodStats.PeriodAvg();
+                        m_jaw.rate * period
+                        : m_jaw.rate_back_from_clutch * period;
                     // gripper ghost below, add to catch up
                     if (m_gripper_ghost <= (currentGripper - delta)) {
                         m_gripper_ghost += delta;
@@ -988,11 +1296,116 @@ void mtsTeleOperationPSM::RunEnabled(void)
     }
 }
 
+void mtsTeleOperationPSM::PredictMTMPosition(vctFrm4x4 & mtmPosition) const
+{
+    if (!mMTM.m_measured_cv.Valid()) {
+        return;
+    }
+    double horizon = m_prediction.horizon;
+    if (m_prediction.measured_horizon) {
+        horizon = mPSM.m_servo_cp_latency.Element(1); // average
+    }
+    if (horizon <= 0.0) {
+        return;
+    }
+    if (horizon > m_prediction.horizon_max) {
+        horizon = m_prediction.horizon_max;
+    }
+
+    // first order extrapolation, clamped per axis
+    vct3 translation, rotation;
+    translation.ProductOf(horizon, mMTM.m_measured_cv.VelocityLinear());
+    rotation.ProductOf(horizon, mMTM.m_measured_cv.VelocityAngular());
+    for (size_t axis = 0; axis < 3; ++axis) {
+        translation.Element(axis) = std::max(-m_prediction.translation_limit.Element(axis),
+                                             std::min(m_prediction.translation_limit.Element(axis),
+                                                      translation.Element(axis)));
+        rotation.Element(axis) = std::max(-m_prediction.rotation_limit.Element(axis),
+                                          std::min(m_prediction.rotation_limit.Element(axis),
+                                                   rotation.Element(axis)));
+    }
+    mtmPosition.Translation().Add(translation);
+
+    // angular velocity is expressed in MTM base frame
+    const double angle = rotation.Norm();
+    if (angle > cmnTypeTraits<double>::Tolerance()) {
+        const vctMatRot3 delta(vctAxAnRot3(rotation / angle, angle));
+        vctMatRot3 current;
+        current.FromRaw(mtmPosition.Rotation());
+        mtmPosition.Rotation().FromNormalized(delta * current);
+    }
+}
+
+void mtsTeleOperationPSM::HapticFeedback(void)
+{
+    if (!mPSM.m_body_measured_cf.Valid()) {
+        HapticFeedbackStop();
+        return;
+    }
+    // body wrench to PSM base, then MTM base using registration: psm = R * mtm
+    const vctFixedSizeVector<double, 6> & psmWrench = mPSM.m_body_measured_cf.Force();
+    vct3 body, psmBase, mtmBase;
+    vct6 wrench;
+    for (size_t offset = 0; offset < 6; offset += 3) {
+        body.Assign(psmWrench.Element(offset), psmWrench.Element(offset + 1), psmWrench.Element(offset + 2));
+        mPSM.m_setpoint_cp.Position().Rotation().ApplyTo(body, psmBase);
+        m_registration_rotation.ApplyInverseTo(psmBase, mtmBase);
+        // reaction, scaled for transparency (F_mtm . v_mtm = F_psm . v_psm)
+        mtmBase.Multiply(-m_haptic_feedback.gain * m_scale);
+        wrench.Ref<3>(offset).Assign(mtmBase);
+    }
+    if (!m_haptic_feedback.torque) {
+        wrench.Ref<3>(3).SetAll(0.0);
+    }
+
+    // low pass
+    m_haptic_feedback.filtered.Add(m_haptic_feedback.alpha * (wrench - m_haptic_feedback.filtered));
+
+    // deadband (continuous) and saturation on norms
+    const double deadbands[2] = {m_haptic_feedback.force_deadband, m_haptic_feedback.torque_deadband};
+    const double maxs[2] = {m_haptic_feedback.force_max, m_haptic_feedback.torque_max};
+    for (size_t index = 0; index < 2; ++index) {
+        vct3 value(m_haptic_feedback.filtered.Ref<3>(3 * index));
+        const double norm = value.Norm();
+        double scaledNorm = norm - deadbands[index];
+        if (scaledNorm <= 0.0) {
+            value.SetAll(0.0);
+        } else {
+            if (scaledNorm > maxs[index]) {
+                scaledNorm = maxs[index];
+            }
+            value.Multiply(scaledNorm / norm);
+        }
+        mMTM.m_servo_cf_body.Force().Ref<3>(3 * index).Assign(value);
+    }
+    mMTM.servo_cf_body(mMTM.m_servo_cf_body);
+    m_haptic_feedback.active = true;
+}
+
+void mtsTeleOperationPSM::HapticFeedbackStop(void)
+{
+    m_haptic_feedback.filtered.SetAll(0.0);
+    if (m_haptic_feedback.active) {
+        mMTM.m_servo_cf_body.Force().SetAll(0.0);
+        mMTM.servo_cf_body(mMTM.m_servo_cf_body);
+        m_haptic_feedback.active = false;
+    }
+}
+
+void mtsTeleOperationPSM::HapticFeedbackRestore(void)
+{
+    if (m_haptic_feedback.orientation_absolute_saved) {
+        mMTM.body_set_cf_orientation_absolute(m_haptic_feedback.previous_orientation_absolute);
+        m_haptic_feedback.orientation_absolute_saved = false;
+    }
+}
+
 void mtsTeleOperationPSM::TransitionEnabled(void)
 {
     if (mTeleopState.DesiredStateIsNotCurrent()) {
         set_following(false);
-        mTeleopState.SetCurrentState(mTeleopState.DesiredState());
+        HapticFeedbackRestore();
+        mTeleopState.SetCurrentState(mTeleopState.DesiredStateIndex());
     }
 }
 
@@ -1032,6 +1445,10 @@ void mtsTeleOperationPSM::UpdateGripperToJawConfiguration(void)
 
 void mtsTeleOperationPSM::set_following(const bool following)
 {
+    // make sure MTM doesn't keep the last feedback wrench
+    if (!following) {
+        HapticFeedbackStop();
+    }
     MessageEvents.following(following);
     m_following = following;
 }
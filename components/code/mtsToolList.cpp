@@ -17,6 +17,7 @@ http://www.cisst.org/cisst/license.txt.
 */
 
 #include <sawIntuitiveResearchKit/mtsToolList.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
 
 #include <cisstCommon/cmnPath.h>
 
@@ -41,15 +42,13 @@ bool mtsToolList::Load(const cmnPath & path,
 
     // load index of supported tools
     try {
-        std::ifstream jsonStream;
         Json::Value jsonConfig;
-        Json::Reader jsonReader;
 
-        jsonStream.open(fullFilename.c_str());
-        if (!jsonReader.parse(jsonStream, jsonConfig)) {
+        std::string jsonErrors;
+        if (!mtsIntuitiveResearchKitConfigCache::Parse(fullFilename, jsonConfig, jsonErrors)) {
             CMN_LOG_CLASS_INIT_ERROR << "ToolList::Load: failed to parse configuration file \""
                                      << fullFilename << "\"\n"
-                                     << jsonReader.getFormattedErrorMessages();
+                                     << jsonErrors;
             return false;
         }
 
@@ -235,6 +234,41 @@ bool mtsToolList::Find(const std::string & toolName, size_t & index) const
     return false;
 }
 
+bool mtsToolList::LoadDefinitions(const cmnPath & path)
+{
+    bool allLoaded = true;
+    mDefinitions.resize(mTools.size());
+    for (size_t index = 0; index < mTools.size(); ++index) {
+        DefinitionType & definition = mDefinitions.at(index);
+        if (definition.loaded) {
+            continue;
+        }
+        const std::string & file = mTools.at(index)->file;
+        if (cmnPath::Exists(file)) {
+            definition.file = file;
+        } else {
+            definition.file = path.Find(file);
+        }
+        if (definition.file == "") {
+            CMN_LOG_CLASS_INIT_WARNING << "ToolList::LoadDefinitions: failed to locate tool file \""
+                                       << file << "\" for " << Name(index) << std::endl;
+            allLoaded = false;
+            continue;
+        }
+        std::string jsonErrors;
+        if (!mtsIntuitiveResearchKitConfigCache::Parse(definition.file, definition.json, jsonErrors)) {
+            CMN_LOG_CLASS_INIT_WARNING << "ToolList::LoadDefinitions: failed to parse tool file \""
+                                       << definition.file << "\"\n"
+                                       << jsonErrors;
+            definition.json = Json::Value();
+            allLoaded = false;
+            continue;
+        }
+        definition.loaded = true;
+    }
+    return allLoaded;
+}
+
 std::string mtsToolList::File(const size_t & index) const
 {
     return mTools.at(index)->file;
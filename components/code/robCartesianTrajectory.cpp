@@ -0,0 +1,151 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#include <sawIntuitiveResearchKit/robCartesianTrajectory.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // below these, translation or rotation is considered null
+    const double DistanceEpsilon = 1.0e-6; // 1 micron
+    const double AngleEpsilon = 1.0e-6;
+}
+
+void robCartesianTrajectory::SetLimits(const double linearVelocity,
+                                       const double linearAcceleration,
+                                       const double angularVelocity,
+                                       const double angularAcceleration)
+{
+    mLinearVelocity = linearVelocity;
+    mLinearAcceleration = linearAcceleration;
+    mAngularVelocity = angularVelocity;
+    mAngularAcceleration = angularAcceleration;
+}
+
+void robCartesianTrajectory::Start(const vctFrm3 & start,
+                                   const vctFrm3 & goal,
+                                   const double time,
+                                   const double initialLinearVelocity,
+                                   const double initialAngularVelocity)
+{
+    mStart = start;
+    mGoal = goal;
+    mStartTime = time;
+
+    // path
+    mTranslation.DifferenceOf(goal.Translation(), start.Translation());
+    mDistance = mTranslation.Norm();
+    if (mDistance < DistanceEpsilon) {
+        mDistance = 0.0;
+    }
+    const vctAxAnRot3 delta(start.Rotation().Inverse() * goal.Rotation(), VCT_NORMALIZE);
+    mAxis.Assign(delta.Axis());
+    mAngle = delta.Angle();
+    if (mAngle < AngleEpsilon) {
+        mAngle = 0.0;
+    }
+
+    // limits on path parameter, the most constrained of translation and rotation
+    const double infinity = std::numeric_limits<double>::max();
+    double velocity = infinity;
+    double acceleration = infinity;
+    double initialVelocity = infinity;
+    if (mDistance > 0.0) {
+        velocity = std::min(velocity, mLinearVelocity / mDistance);
+        acceleration = std::min(acceleration, mLinearAcceleration / mDistance);
+        initialVelocity = std::min(initialVelocity, initialLinearVelocity / mDistance);
+    }
+    if (mAngle > 0.0) {
+        velocity = std::min(velocity, mAngularVelocity / mAngle);
+        acceleration = std::min(acceleration, mAngularAcceleration / mAngle);
+        initialVelocity = std::min(initialVelocity, initialAngularVelocity / mAngle);
+    }
+
+    mPathVelocity = 0.0;
+    if (velocity == infinity) {
+        // start and goal are the same
+        mInitialVelocity = mPeakVelocity = mAcceleration = 0.0;
+        mAccelerationTime = mCruiseTime = mDecelerationTime = 0.0;
+        return;
+    }
+
+    // initial velocity must allow to stop before the goal
+    mAcceleration = acceleration;
+    mInitialVelocity = std::max(0.0, std::min(initialVelocity,
+                                              std::min(velocity, std::sqrt(2.0 * mAcceleration))));
+
+    // triangular profile if the path is too short to reach max velocity
+    mPeakVelocity = velocity;
+    double accelerationDistance = (mPeakVelocity * mPeakVelocity - mInitialVelocity * mInitialVelocity) / (2.0 * mAcceleration);
+    double decelerationDistance = (mPeakVelocity * mPeakVelocity) / (2.0 * mAcceleration);
+    if ((accelerationDistance + decelerationDistance) > 1.0) {
+        mPeakVelocity = std::sqrt(mAcceleration + 0.5 * mInitialVelocity * mInitialVelocity);
+        accelerationDistance = (mPeakVelocity * mPeakVelocity - mInitialVelocity * mInitialVelocity) / (2.0 * mAcceleration);
+        decelerationDistance = (mPeakVelocity * mPeakVelocity) / (2.0 * mAcceleration);
+    }
+    mAccelerationTime = (mPeakVelocity - mInitialVelocity) / mAcceleration;
+    mDecelerationTime = mPeakVelocity / mAcceleration;
+    mCruiseTime = std::max(0.0, (1.0 - accelerationDistance - decelerationDistance) / mPeakVelocity);
+    mPathVelocity = mInitialVelocity;
+}
+
+bool robCartesianTrajectory::Evaluate(const double time, vctFrm3 & position)
+{
+    const double t = time - mStartTime;
+    const double duration = Duration();
+    if ((mPeakVelocity == 0.0) || (t >= duration)) {
+        position = mGoal;
+        mPathVelocity = 0.0;
+        return true;
+    }
+
+    // path parameter
+    double s;
+    if (t <= 0.0) {
+        s = 0.0;
+        mPathVelocity = mInitialVelocity;
+    } else if (t < mAccelerationTime) {
+        s = mInitialVelocity * t + 0.5 * mAcceleration * t * t;
+        mPathVelocity = mInitialVelocity + mAcceleration * t;
+    } else {
+        const double accelerationDistance = mInitialVelocity * mAccelerationTime
+            + 0.5 * mAcceleration * mAccelerationTime * mAccelerationTime;
+        if (t < (mAccelerationTime + mCruiseTime)) {
+            s = accelerationDistance + mPeakVelocity * (t - mAccelerationTime);
+            mPathVelocity = mPeakVelocity;
+        } else {
+            const double td = t - mAccelerationTime - mCruiseTime;
+            s = accelerationDistance + mPeakVelocity * mCruiseTime
+                + mPeakVelocity * td - 0.5 * mAcceleration * td * td;
+            mPathVelocity = mPeakVelocity - mAcceleration * td;
+        }
+    }
+    s = std::min(s, 1.0);
+
+    // translation is linear, rotation along the axis between start and goal
+    position.Translation().SumOf(mStart.Translation(), s * mTranslation);
+    if (mAngle > 0.0) {
+        position.Rotation().ProductOf(mStart.Rotation(),
+                                      vctMatRot3(vctAxAnRot3(mAxis, s * mAngle), VCT_NORMALIZE));
+    } else {
+        position.Rotation().Assign(mStart.Rotation());
+    }
+    return false;
+}
@@ -16,16 +16,19 @@ http://www.cisst.org/cisst/license.txt.
 --- end cisst license ---
 */
 
-#include "robGravityCompensationMTM.h"
+#include <sawIntuitiveResearchKit/robGravityCompensationMTM.h>
 #include <cisstCommon/cmnDataFunctionsJSON.h>
 #include <cisstCommon/cmnLogger.h>
 #include <cisstCommon/cmnConstants.h>
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
 #include <iostream>
 
 robGravityCompensationMTM::robGravityCompensationMTM(const robGravityCompensationMTM::Parameters & parameters, int version)
     : mParameters(parameters)
-    , mRegressor(parameters.JointCount(), parameters.DynamicParameterCount(), 0.0)
+    , mGravityRegressor(0.0)
+    , mPolynomialRegressor(0.0)
     , mOnes(parameters.JointCount(), 1.0)
     , mGravityEfforts(parameters.JointCount(), 0.0)
     , mTauPos(parameters.JointCount(), 0.0)
@@ -35,7 +38,10 @@ robGravityCompensationMTM::robGravityCompensationMTM(const robGravityCompensatio
     , mAlpha(parameters.JointCount(), 0.0)
     , mOneMinusAlpha(parameters.JointCount(), 0.0)
     , mVersion(version)
-{}
+{
+    mCache.TauPos.SetSize(parameters.JointCount(), 0.0);
+    mCache.TauNeg.SetSize(parameters.JointCount(), 0.0);
+}
 
 void robGravityCompensationMTM::AssignRegressor(const vctVec & q, vctMat & regressor)
 {
@@ -180,23 +186,277 @@ void robGravityCompensationMTM::AssignRegressor(const vctVec & q, vctMat & regre
     regressor.Element(5, 39) = q6 * q6 * q6 * q6;
 }
 
+void robGravityCompensationMTM::UpdateTrigonometry(const vctVec & q)
+{
+    // largest step for incremental updates
+    const double maxStep = 0.1;
+    bool exact = (mTrig.MaxError <= 0.0) || !mTrig.Valid;
+    double maxDelta = 0.0;
+    if (!exact) {
+        for (size_t j = 1; j < MODEL_JOINT_COUNT; ++j) {
+            maxDelta = std::max(maxDelta, std::abs(q[j] - mTrig.Q[j]));
+        }
+        // propagate previous error, truncation of series and rounding
+        const double d2 = maxDelta * maxDelta;
+        const double truncation = std::max(d2 * d2 * d2 * maxDelta / 5040.0,
+                                           d2 * d2 * d2 / 720.0);
+        const double bound = mTrig.ErrorBound * (1.0 + maxDelta) + truncation + 4.0 * DBL_EPSILON;
+        if ((maxDelta > maxStep) || (bound > mTrig.MaxError)) {
+            exact = true;
+        } else {
+            mTrig.ErrorBound = bound;
+        }
+    }
+
+    if (exact) {
+        for (size_t j = 1; j < MODEL_JOINT_COUNT; ++j) {
+            mTrig.Sin[j] = sin(q[j]);
+            mTrig.Cos[j] = cos(q[j]);
+        }
+        mTrig.Sin23 = sin(q[1] + q[2]);
+        mTrig.ErrorBound = 0.0;
+        mTrig.Valid = true;
+    } else {
+        // sin(a + d) = sin(a) cos(d) + cos(a) sin(d), same for cos
+        for (size_t j = 1; j < MODEL_JOINT_COUNT; ++j) {
+            const double d = q[j] - mTrig.Q[j];
+            const double d2 = d * d;
+            const double sd = d * (1.0 - d2 / 6.0 * (1.0 - d2 / 20.0));
+            const double cd = 1.0 - d2 / 2.0 * (1.0 - d2 / 12.0);
+            const double s = mTrig.Sin[j];
+            const double c = mTrig.Cos[j];
+            mTrig.Sin[j] = s * cd + c * sd;
+            mTrig.Cos[j] = c * cd - s * sd;
+        }
+        mTrig.Sin23 = mTrig.Sin[1] * mTrig.Cos[2] + mTrig.Cos[1] * mTrig.Sin[2];
+        ++mTrig.Incremental;
+    }
+    for (size_t j = 1; j < MODEL_JOINT_COUNT; ++j) {
+        mTrig.Q[j] = q[j];
+    }
+}
+
+void robGravityCompensationMTM::AssignSparseRegressor(const vctVec & q)
+{
+    constexpr double g = 9.81;
+    UpdateTrigonometry(q);
+    const double sq2 = mTrig.Sin[1];
+    const double cq2 = mTrig.Cos[1];
+    const double sq3 = mTrig.Sin[2];
+    const double cq3 = mTrig.Cos[2];
+    const double sq4 = mTrig.Sin[3];
+    const double cq4 = mTrig.Cos[3];
+    const double sq5 = mTrig.Sin[4];
+    const double cq5 = mTrig.Cos[4];
+    const double sq6 = mTrig.Sin[5];
+    const double cq6 = mTrig.Cos[5];
+    const double sq2pq3 = mTrig.Sin23;
+
+    // common products, multiplications are evaluated left to right
+    // as in AssignRegressor (e.g. g * cq2 * cq3 is (g * cq2) * cq3)
+    const double gc2 = g * cq2;
+    const double gs2 = g * sq2;
+    const double gc3 = g * cq3;
+    const double gc4 = g * cq4;
+    const double gc6 = g * cq6;
+    const double gc2c3 = gc2 * cq3;
+    const double gc2s3 = gc2 * sq3;
+    const double gc3s2 = gc3 * sq2;
+    const double gs2s3 = gs2 * sq3;
+    const double gc2c3c4 = gc2c3 * cq4;
+    const double gc4s2s3 = gc4 * sq2 * sq3;
+    const double gc4c5 = gc4 * cq5;
+    const double gc2c3c4c5 = gc2c3c4 * cq5;
+
+    // rows 1 and 2 share the same gravity terms
+    double * row1 = mGravityRegressor.Pointer(1, 0);
+    row1[0] = gs2;
+    row1[1] = gc2;
+    row1[2] = gc2c3 - gs2s3;
+    row1[3] = -gc2s3 - gc3s2;
+    row1[4] = gc2c3c4 - gc4s2s3;
+    row1[5] = gs2s3 * sq4 - gc2c3 * sq4;
+    row1[6] = gc4s2s3 * sq5 -
+        gc3 * cq5 * sq2 -
+        gc2c3c4 * sq5 -
+        gc2 * cq5 * sq3;
+    row1[7] = gc2c3c4c5 -
+        gc3s2 * sq5 -
+        gc2s3 * sq5 -
+        gc4c5 * sq2 * sq3;
+    row1[8] = gc2c3 * sq4 * sq6 +
+        gc2 * cq6 * sq3 * sq5 +
+        gc3 * cq6 * sq2 * sq5 -
+        gs2s3 * sq4 * sq6 +
+        gc4c5 * cq6 * sq2 * sq3 -
+        gc2c3c4c5 * cq6;
+    row1[9] = gc2c3 * cq6 * sq4 -
+        gc6 * sq2 * sq3 * sq4 -
+        gc2s3 * sq5 * sq6 -
+        gc3s2 * sq5 * sq6 -
+        gc4c5 * sq2 * sq3 * sq6 +
+        gc2c3c4c5 * sq6;
+    double * row2 = mGravityRegressor.Pointer(2, 0);
+    for (size_t c = 2; c < GRAVITY_PARAMETER_COUNT; ++c) {
+        row2[c] = row1[c];
+    }
+
+    const double gs23 = g * sq2pq3;
+    double * row3 = mGravityRegressor.Pointer(3, 0);
+    row3[4] = -(gs23 * sq4);
+    row3[5] = -(gs23 * cq4);
+    row3[6] = gs23 * sq4 * sq5;
+    row3[7] = -(gs23 * cq5 * sq4);
+    row3[8] = gs23 * (cq4 * sq6 + cq5 * cq6 * sq4);
+    row3[9] = gs23 * (cq4 * cq6 - cq5 * sq4 * sq6);
+
+    const double c2c3 = cq2 * cq3;
+    const double s2s3 = sq2 * sq3;
+    const double c2c4 = cq2 * cq4;
+    const double c3c4 = cq3 * cq4;
+    const double c2c3c5 = c2c3 * cq5;
+    const double c2c4c5 = c2c4 * cq5;
+    const double c3c4c5 = c3c4 * cq5;
+    const double c2c3s5 = c2c3 * sq5;
+    const double s2s3s5 = s2s3 * sq5;
+    const double c5s2s3 = cq5 * sq2 * sq3;
+    const double c2c4s3s5 = c2c4 * sq3 * sq5;
+    const double c3c4s2s5 = c3c4 * sq2 * sq5;
+    double * row4 = mGravityRegressor.Pointer(4, 0);
+    row4[6] = -g * (c2c3s5 - s2s3s5 +
+                    c2c4c5 * sq3 +
+                    c3c4c5 * sq2);
+    row4[7] = -g * (c5s2s3 - c2c3c5 +
+                    c2c4s3s5 +
+                    c3c4s2s5);
+    row4[8] = g * (cq5 * cq6 * sq2 * sq3 -
+                   c2c3c5 * cq6 +
+                   c2c4 * cq6 * sq3 * sq5 +
+                   c3c4 * cq6 * sq2 * sq5);
+    row4[9] = -g * (c5s2s3 * sq6 -
+                    c2c3c5 * sq6 +
+                    c2c4s3s5 * sq6 +
+                    c3c4s2s5 * sq6);
+
+    double * row5 = mGravityRegressor.Pointer(5, 0);
+    row5[8] = g * (cq2 * cq6 * sq3 * sq4 +
+                   cq3 * cq6 * sq2 * sq4 +
+                   c2c3s5 * sq6 -
+                   s2s3s5 * sq6 +
+                   c2c4c5 * sq3 * sq6 +
+                   c3c4c5 * sq2 * sq6);
+    row5[9] = g * (c2c3 * cq6 * sq5 -
+                   cq2 * sq3 * sq4 * sq6 -
+                   cq3 * sq2 * sq4 * sq6 -
+                   cq6 * sq2 * sq3 * sq5 +
+                   c2c4c5 * cq6 * sq3 +
+                   c3c4c5 * cq6 * sq2);
+
+    // polynomial terms for each joint
+    for (size_t r = 0; r < MODEL_JOINT_COUNT; ++r) {
+        const double qr = q[r];
+        double * poly = mPolynomialRegressor.Pointer(r, 0);
+        poly[0] = 1.0;
+        poly[1] = qr;
+        poly[2] = qr * qr;
+        poly[3] = poly[2] * qr;
+        poly[4] = poly[3] * qr;
+    }
+}
+
+void robGravityCompensationMTM::SparseRegressor(const vctVec & q, vctMat & regressor)
+{
+    AssignSparseRegressor(q);
+    regressor.SetAll(0.0);
+    for (size_t r = 0; r < MODEL_JOINT_COUNT; ++r) {
+        if (r > 0) {
+            for (size_t c = 2 * (r - 1); c < GRAVITY_PARAMETER_COUNT; ++c) {
+                regressor.Element(r, c) = mGravityRegressor.Element(r, c);
+            }
+        }
+        const size_t offset = GRAVITY_PARAMETER_COUNT + POLYNOMIAL_ORDER * r;
+        for (size_t k = 0; k < POLYNOMIAL_ORDER; ++k) {
+            regressor.Element(r, offset + k) = mPolynomialRegressor.Element(r, k);
+        }
+    }
+}
+
+void robGravityCompensationMTM::ComputeDirectionalEfforts(void)
+{
+    const double * pos = mParameters.Pos.Pointer();
+    const double * neg = mParameters.Neg.Pointer();
+    for (size_t r = 0; r < MODEL_JOINT_COUNT; ++r) {
+        // same summation order as dense regressor * parameters,
+        // skipping elements known to be zero
+        double tauPos = 0.0;
+        double tauNeg = 0.0;
+        if (r > 0) {
+            const double * gravity = mGravityRegressor.Pointer(r, 0);
+            for (size_t c = 2 * (r - 1); c < GRAVITY_PARAMETER_COUNT; ++c) {
+                tauPos += gravity[c] * pos[c];
+                tauNeg += gravity[c] * neg[c];
+            }
+        }
+        const double * poly = mPolynomialRegressor.Pointer(r, 0);
+        const size_t offset = GRAVITY_PARAMETER_COUNT + POLYNOMIAL_ORDER * r;
+        for (size_t k = 0; k < POLYNOMIAL_ORDER; ++k) {
+            tauPos += poly[k] * pos[offset + k];
+            tauNeg += poly[k] * neg[offset + k];
+        }
+        mTauPos[r] = tauPos;
+        mTauNeg[r] = tauNeg;
+    }
+    // last joints are not part of the model
+    for (size_t r = MODEL_JOINT_COUNT; r < mTauPos.size(); ++r) {
+        mTauPos[r] = 0.0;
+        mTauNeg[r] = 0.0;
+    }
+}
+
+void robGravityCompensationMTM::ComputeModelEfforts(const vctVec & q)
+{
+    if (mCache.Valid && (mCache.Tolerance > 0.0)) {
+        bool hit = true;
+        for (size_t j = 0; hit && (j < MODEL_JOINT_COUNT); ++j) {
+            hit = (std::abs(q[j] - mCache.Q[j]) <= mCache.Tolerance);
+        }
+        if (hit) {
+            ++mCache.Hits;
+            mTauPos.Assign(mCache.TauPos);
+            mTauNeg.Assign(mCache.TauNeg);
+            return;
+        }
+    }
+    AssignSparseRegressor(q);
+    ComputeDirectionalEfforts();
+    if (mCache.Tolerance > 0.0) {
+        for (size_t j = 0; j < MODEL_JOINT_COUNT; ++j) {
+            mCache.Q[j] = q[j];
+        }
+        mCache.TauPos.Assign(mTauPos);
+        mCache.TauNeg.Assign(mTauNeg);
+        mCache.Valid = true;
+    }
+}
+
 void robGravityCompensationMTM::AddGravityCompensationEfforts(const vctVec & q,
                                                               const vctVec & q_dot,
                                                               vctVec & totalEfforts)
 {
-    AssignRegressor(q, mRegressor);
     if ( 1 == mVersion ) {
+        ComputeModelEfforts(q);
         ComputeBetaVel(q_dot);
         mOnes.SetAll(1.0);
         mOneMinusBeta = mOnes.Subtract(mBeta);
-        mTauPos.ProductOf(mRegressor, mParameters.Pos).ElementwiseMultiply(mBeta);
-        mTauNeg.ProductOf(mRegressor, mParameters.Neg).ElementwiseMultiply(mOneMinusBeta);
+        mTauPos.ElementwiseMultiply(mBeta);
+        mTauNeg.ElementwiseMultiply(mOneMinusBeta);
     } else if ( 2 == mVersion ) {
+        ComputeModelEfforts(q);
         ComputeAlphaVel(q_dot);
         mOnes.SetAll(1.0);
         mOneMinusAlpha = mOnes.Subtract(mAlpha);
-        mTauPos.ProductOf(mRegressor, mParameters.Pos).ElementwiseMultiply(mAlpha);
-        mTauNeg.ProductOf(mRegressor, mParameters.Neg).ElementwiseMultiply(mOneMinusAlpha);
+        mTauPos.ElementwiseMultiply(mAlpha);
+        mTauNeg.ElementwiseMultiply(mOneMinusAlpha);
 
     } else {
         mTauPos.SetAll(0.0);
@@ -315,6 +575,20 @@ robGravityCompensationMTM::Create(const Json::Value & jsonConfig)
 
     robGravityCompensationMTM::Parameters params;
 
+    // the regressor is hard coded, make sure the sizes match
+    auto checkSizes = [&params]() {
+        if (params.DynamicParameterCount() != MODEL_PARAMETER_COUNT) {
+            return std::string("the number of dynamic parameters must be ") + std::to_string(MODEL_PARAMETER_COUNT);
+        }
+        if (params.Neg.size() != params.Pos.size()) {
+            return std::string("the number of negative and positive dynamic parameters must be the same");
+        }
+        if (params.JointCount() < MODEL_JOINT_COUNT) {
+            return std::string("the number of joints must be at least ") + std::to_string(MODEL_JOINT_COUNT);
+        }
+        return std::string("");
+    };
+
     if ( 1 == version) {
 
         GCMTM_GetParam("gc_dynamic_params_pos", params.Pos);
@@ -322,6 +596,10 @@ robGravityCompensationMTM::Create(const Json::Value & jsonConfig)
         GCMTM_GetParam("beta_vel_amplitude", params.BetaVelAmp);
         GCMTM_GetParam("safe_upper_torque_limit", params.UpperEffortsLimit);
         GCMTM_GetParam("safe_lower_torque_limit", params.LowerEffortsLimit);
+        const std::string sizeError = checkSizes();
+        if (!sizeError.empty()) {
+            return {nullptr, sizeError};
+        }
         return {new robGravityCompensationMTM(params,version), "version 1 is still supported but you should recalibrate your MTM for version 2"};
 
     }
@@ -334,6 +612,10 @@ robGravityCompensationMTM::Create(const Json::Value & jsonConfig)
         GCMTM_GetParam("db_vel_vec", params.DBVel);
         GCMTM_GetParam("sat_vec_vec", params.SatVel);
         GCMTM_GetParam("fric_comp_ratio_vec", params.FricCompRatio);
+        const std::string sizeError = checkSizes();
+        if (!sizeError.empty()) {
+            return {nullptr, sizeError};
+        }
         return {new robGravityCompensationMTM(params,version), ""};
     }
 
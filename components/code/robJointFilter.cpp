@@ -0,0 +1,442 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <cmath>
+
+#include <cisstCommon/cmnConstants.h>
+#include <cisstOSAbstraction/osaGetTime.h>
+
+#include <sawIntuitiveResearchKit/robJointFilter.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConfigCache.h>
+
+robJointFilter * robJointFilter::Create(const std::string & type)
+{
+    if (type == "low-pass") {
+        return new robJointFilterLowPass;
+    }
+    if (type == "notch") {
+        return new robJointFilterNotch;
+    }
+    if (type == "kalman-velocity") {
+        return new robJointFilterKalmanVelocity;
+    }
+    if (type == "adaptive-window-velocity") {
+        return new robJointFilterAdaptiveWindowVelocity;
+    }
+    if (type == "psm-compensation") {
+        return new robJointFilterPSMCompensation;
+    }
+    return 0;
+}
+
+std::string robJointFilter::SupportedTypes(void)
+{
+    return "\"low-pass\", \"notch\", \"kalman-velocity\", \"adaptive-window-velocity\" and \"psm-compensation\"";
+}
+
+
+bool robJointFilterSignal::FromJSON(const Json::Value & jsonConfig, Type & signal,
+                                    std::string & errorMessage)
+{
+    const Json::Value jsonSignal = jsonConfig["signal"];
+    if (jsonSignal.isNull()) {
+        return true;
+    }
+    const std::string name = jsonSignal.asString();
+    if (name == "position") {
+        signal = POSITION;
+    } else if (name == "velocity") {
+        signal = VELOCITY;
+    } else if (name == "effort") {
+        signal = EFFORT;
+    } else {
+        errorMessage = "\"signal\" must be \"position\", \"velocity\" or \"effort\", found \"" + name + "\"";
+        return false;
+    }
+    return true;
+}
+
+
+bool robJointFilterLowPass::Configure(const Json::Value & jsonConfig,
+                                      const ContextType & CMN_UNUSED(context),
+                                      std::string & errorMessage)
+{
+    if (!robJointFilterSignal::FromJSON(jsonConfig, mSignal, errorMessage)) {
+        return false;
+    }
+    const double cutoff = jsonConfig.get("cutoff", 0.0).asDouble();
+    if (cutoff <= 0.0) {
+        errorMessage = "\"cutoff\" frequency (Hz) must be strictly positive";
+        return false;
+    }
+    mTimeConstant = 1.0 / (2.0 * cmnPI * cutoff);
+    return true;
+}
+
+void robJointFilterLowPass::Resize(const size_t numberOfJoints)
+{
+    mPrevious.SetSize(numberOfJoints);
+    mFirst = true;
+}
+
+void robJointFilterLowPass::Filter(const double dt,
+                                   vctDoubleVec & position,
+                                   vctDoubleVec & velocity,
+                                   vctDoubleVec & effort)
+{
+    vctDoubleVec & signal = robJointFilterSignal::Select(mSignal, position, velocity, effort);
+    if (mFirst) {
+        mPrevious.Assign(signal);
+        mFirst = false;
+        return;
+    }
+    const double alpha = dt / (mTimeConstant + dt);
+    const size_t size = signal.size();
+    for (size_t index = 0; index < size; ++index) {
+        mPrevious.Element(index) += alpha * (signal.Element(index) - mPrevious.Element(index));
+        signal.Element(index) = mPrevious.Element(index);
+    }
+}
+
+
+bool robJointFilterNotch::Configure(const Json::Value & jsonConfig,
+                                    const ContextType & context,
+                                    std::string & errorMessage)
+{
+    if (!robJointFilterSignal::FromJSON(jsonConfig, mSignal, errorMessage)) {
+        return false;
+    }
+    const double frequency = jsonConfig.get("frequency", 0.0).asDouble();
+    const double quality = jsonConfig.get("quality", 1.0).asDouble();
+    if ((frequency <= 0.0) || (frequency >= (0.5 / context.period))) {
+        errorMessage = "\"frequency\" (Hz) must be strictly positive and lower than half the arm's frequency";
+        return false;
+    }
+    if (quality <= 0.0) {
+        errorMessage = "\"quality\" must be strictly positive";
+        return false;
+    }
+    // see Audio EQ cookbook, R. Bristow-Johnson
+    const double w0 = 2.0 * cmnPI * frequency * context.period;
+    const double alpha = std::sin(w0) / (2.0 * quality);
+    const double a0 = 1.0 + alpha;
+    mB0 = 1.0 / a0;
+    mB1 = -2.0 * std::cos(w0) / a0;
+    mB2 = 1.0 / a0;
+    mA1 = mB1;
+    mA2 = (1.0 - alpha) / a0;
+    return true;
+}
+
+void robJointFilterNotch::Resize(const size_t numberOfJoints)
+{
+    mZ1.SetSize(numberOfJoints);
+    mZ2.SetSize(numberOfJoints);
+    mFirst = true;
+}
+
+void robJointFilterNotch::Filter(const double CMN_UNUSED(dt),
+                                 vctDoubleVec & position,
+                                 vctDoubleVec & velocity,
+                                 vctDoubleVec & effort)
+{
+    vctDoubleVec & signal = robJointFilterSignal::Select(mSignal, position, velocity, effort);
+    const size_t size = signal.size();
+    if (mFirst) {
+        // steady state for current input, unit gain at DC
+        for (size_t index = 0; index < size; ++index) {
+            const double x = signal.Element(index);
+            mZ2.Element(index) = (mB2 - mA2) * x;
+            mZ1.Element(index) = (mB1 - mA1) * x + mZ2.Element(index);
+        }
+        mFirst = false;
+    }
+    for (size_t index = 0; index < size; ++index) {
+        const double x = signal.Element(index);
+        const double y = mB0 * x + mZ1.Element(index);
+        mZ1.Element(index) = mB1 * x - mA1 * y + mZ2.Element(index);
+        mZ2.Element(index) = mB2 * x - mA2 * y;
+        signal.Element(index) = y;
+    }
+}
+
+
+bool robJointFilterKalmanVelocity::Configure(const Json::Value & jsonConfig,
+                                             const ContextType & CMN_UNUSED(context),
+                                             std::string & errorMessage)
+{
+    mProcessNoise = jsonConfig.get("process-noise", mProcessNoise).asDouble();
+    mMeasurementNoise = jsonConfig.get("measurement-noise", mMeasurementNoise).asDouble();
+    mFilterPosition = jsonConfig.get("filter-position", mFilterPosition).asBool();
+    if ((mProcessNoise <= 0.0) || (mMeasurementNoise <= 0.0)) {
+        errorMessage = "\"process-noise\" and \"measurement-noise\" must be strictly positive";
+        return false;
+    }
+    return true;
+}
+
+void robJointFilterKalmanVelocity::Resize(const size_t numberOfJoints)
+{
+    mPosition.SetSize(numberOfJoints);
+    mVelocity.SetSize(numberOfJoints);
+    mP00.SetSize(numberOfJoints);
+    mP01.SetSize(numberOfJoints);
+    mP11.SetSize(numberOfJoints);
+    mFirst = true;
+}
+
+void robJointFilterKalmanVelocity::Filter(const double dt,
+                                          vctDoubleVec & position,
+                                          vctDoubleVec & velocity,
+                                          vctDoubleVec & CMN_UNUSED(effort))
+{
+    const size_t size = position.size();
+    if (mFirst) {
+        mPosition.Assign(position);
+        mVelocity.Assign(velocity);
+        mP00.SetAll(mMeasurementNoise);
+        mP01.SetAll(0.0);
+        mP11.SetAll(1.0);
+        mFirst = false;
+        return;
+    }
+    const double q = mProcessNoise;
+    const double dt2 = dt * dt;
+    for (size_t index = 0; index < size; ++index) {
+        // predict, constant velocity model
+        double & p = mPosition.Element(index);
+        double & v = mVelocity.Element(index);
+        double & P00 = mP00.Element(index);
+        double & P01 = mP01.Element(index);
+        double & P11 = mP11.Element(index);
+        p += dt * v;
+        P00 += 2.0 * dt * P01 + dt2 * P11 + q * dt2 * dt / 3.0;
+        P01 += dt * P11 + q * dt2 / 2.0;
+        P11 += q * dt;
+        // update with measured position
+        const double S = P00 + mMeasurementNoise;
+        const double K0 = P00 / S;
+        const double K1 = P01 / S;
+        const double innovation = position.Element(index) - p;
+        p += K0 * innovation;
+        v += K1 * innovation;
+        P11 -= K1 * P01;
+        P01 -= K0 * P01;
+        P00 -= K0 * P00;
+        // output
+        velocity.Element(index) = v;
+        if (mFilterPosition) {
+            position.Element(index) = p;
+        }
+    }
+}
+
+
+bool robJointFilterAdaptiveWindowVelocity::Configure(const Json::Value & jsonConfig,
+                                                     const ContextType & CMN_UNUSED(context),
+                                                     std::string & errorMessage)
+{
+    const int window = jsonConfig.get("window", static_cast<int>(mWindow)).asInt();
+    if (window < 2) {
+        errorMessage = "\"window\" must be at least 2 samples";
+        return false;
+    }
+    mWindow = static_cast<size_t>(window);
+    mNoise = jsonConfig.get("noise", mNoise).asDouble();
+    if (mNoise <= 0.0) {
+        errorMessage = "\"noise\" must be strictly positive";
+        return false;
+    }
+    return true;
+}
+
+void robJointFilterAdaptiveWindowVelocity::Resize(const size_t numberOfJoints)
+{
+    mNumberOfJoints = numberOfJoints;
+    mTimes.SetSize(mWindow);
+    mPositions.SetSize(mWindow * numberOfJoints);
+    mHead = 0;
+    mCount = 0;
+    mTime = 0.0;
+}
+
+void robJointFilterAdaptiveWindowVelocity::Filter(const double dt,
+                                                  vctDoubleVec & position,
+                                                  vctDoubleVec & velocity,
+                                                  vctDoubleVec & CMN_UNUSED(effort))
+{
+    // add latest sample
+    mTime += dt;
+    mHead = (mHead + 1) % mWindow;
+    mTimes.Element(mHead) = mTime;
+    double * latest = mPositions.Pointer(mHead * mNumberOfJoints);
+    for (size_t joint = 0; joint < mNumberOfJoints; ++joint) {
+        latest[joint] = position.Element(joint);
+    }
+    if (mCount < mWindow) {
+        ++mCount;
+    }
+    // keep measured velocity until we have enough samples
+    if (mCount < 2) {
+        return;
+    }
+
+    for (size_t joint = 0; joint < mNumberOfJoints; ++joint) {
+        const double yk = latest[joint];
+        double estimate = velocity.Element(joint);
+        // grow window until a sample is too far from the fitted line
+        for (size_t n = 1; n < mCount; ++n) {
+            const size_t first = (mHead + mWindow - n) % mWindow;
+            const double slope = (yk - mPositions.Element(first * mNumberOfJoints + joint))
+                / (mTime - mTimes.Element(first));
+            bool fits = true;
+            for (size_t j = 1; j < n; ++j) {
+                const size_t sample = (mHead + mWindow - j) % mWindow;
+                const double predicted = yk - slope * (mTime - mTimes.Element(sample));
+                if (std::abs(mPositions.Element(sample * mNumberOfJoints + joint) - predicted) > mNoise) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (!fits) {
+                break;
+            }
+            estimate = slope;
+        }
+        velocity.Element(joint) = estimate;
+    }
+}
+
+
+bool robJointFilterPSMCompensation::Configure(const Json::Value & jsonConfig,
+                                              const ContextType & context,
+                                              std::string & errorMessage)
+{
+    const std::string file = jsonConfig.get("file", "").asString();
+    const std::string fullname = context.config_path.Find(file);
+    if (fullname == "") {
+        errorMessage = "can't find compensation \"file\" \"" + file + "\"";
+        return false;
+    }
+    Json::Value jsonCompensation;
+    if (!mtsIntuitiveResearchKitConfigCache::Parse(fullname, jsonCompensation, errorMessage)) {
+        return false;
+    }
+    robPSMCompensation compensation;
+    if (!compensation.Configure(jsonCompensation, errorMessage)) {
+        return false;
+    }
+    const robPSMCompensation::ParametersType * parameters = compensation.Find(context.arm_name);
+    if (!parameters) {
+        errorMessage = "no parameters for " + context.arm_name + " in \"" + fullname + "\"";
+        return false;
+    }
+    mParameters = *parameters;
+    return true;
+}
+
+void robJointFilterPSMCompensation::Filter(const double CMN_UNUSED(dt),
+                                           vctDoubleVec & position,
+                                           vctDoubleVec & CMN_UNUSED(velocity),
+                                           vctDoubleVec & effort)
+{
+    if (position.size() > 2) {
+        robPSMCompensation::Compensate(mParameters, position, effort);
+    }
+}
+
+
+robJointFilterChain::~robJointFilterChain()
+{
+    for (auto & stage : mStages) {
+        delete stage.filter;
+    }
+}
+
+bool robJointFilterChain::Configure(const Json::Value & jsonFilters,
+                                    const robJointFilter::ContextType & context,
+                                    std::string & errorMessage)
+{
+    if (!jsonFilters.isArray()) {
+        errorMessage = "filters must be defined using an array";
+        return false;
+    }
+    mPeriod = context.period;
+    for (unsigned int index = 0; index < jsonFilters.size(); ++index) {
+        const Json::Value jsonFilter = jsonFilters[index];
+        const std::string type = jsonFilter.get("type", "").asString();
+        StageType stage;
+        stage.filter = robJointFilter::Create(type);
+        if (!stage.filter) {
+            errorMessage = "unknown filter type \"" + type + "\" for filter "
+                + std::to_string(index) + ", supported types are " + robJointFilter::SupportedTypes();
+            return false;
+        }
+        stage.name = jsonFilter.get("name", type + "[" + std::to_string(index) + "]").asString();
+        stage.budget = jsonFilter.get("budget", 0.0).asDouble();
+        // add first so filter is deleted in destructor even if configuration fails
+        mStages.push_back(stage);
+        if (!stage.filter->Configure(jsonFilter, context, errorMessage)) {
+            errorMessage = stage.name + ": " + errorMessage;
+            return false;
+        }
+    }
+    mNumberOfJoints = 0;
+    return true;
+}
+
+bool robJointFilterChain::Filter(const double time, prmStateJoint & state)
+{
+    const size_t numberOfJoints = state.Position().size();
+    if ((state.Velocity().size() != numberOfJoints)
+        || (state.Effort().size() != numberOfJoints)) {
+        return true;
+    }
+
+    // number of joints changed, only allocation
+    if (numberOfJoints != mNumberOfJoints) {
+        for (auto & stage : mStages) {
+            stage.filter->Resize(numberOfJoints);
+        }
+        mNumberOfJoints = numberOfJoints;
+        mPreviousTime = 0.0;
+    }
+
+    // actual time since last call, nominal period on first call
+    double dt = time - mPreviousTime;
+    if ((mPreviousTime == 0.0) || (dt <= 0.0)) {
+        dt = mPeriod;
+    }
+    mPreviousTime = time;
+
+    bool result = true;
+    for (auto & stage : mStages) {
+        if (stage.budget > 0.0) {
+            const double start = osaGetTime();
+            stage.filter->Filter(dt, state.Position(), state.Velocity(), state.Effort());
+            if ((osaGetTime() - start) > stage.budget) {
+                mLastOverrun = stage.name;
+                ++mOverruns;
+                result = false;
+            }
+        } else {
+            stage.filter->Filter(dt, state.Position(), state.Velocity(), state.Effort());
+        }
+    }
+    return result;
+}
@@ -0,0 +1,418 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-16
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <cisstVector/vctTransformationTypes.h>
+
+#include <sawIntuitiveResearchKit/robManipulatorBatch.h>
+#include <sawIntuitiveResearchKit/robManipulatorEvaluator.h>
+
+namespace {
+    // frames in structure of arrays, pointers to rows of the poses
+    // matrix for a given block
+    struct FramesBlock {
+        double * R[9];
+        double * t[3];
+        size_t size;
+    };
+
+    // F = F * C
+    void MultiplyConstant(FramesBlock & frames, const vctFrm4x4 & C)
+    {
+        const double
+            c00 = C.Element(0, 0), c01 = C.Element(0, 1), c02 = C.Element(0, 2), c03 = C.Element(0, 3),
+            c10 = C.Element(1, 0), c11 = C.Element(1, 1), c12 = C.Element(1, 2), c13 = C.Element(1, 3),
+            c20 = C.Element(2, 0), c21 = C.Element(2, 1), c22 = C.Element(2, 2), c23 = C.Element(2, 3);
+        for (size_t row = 0; row < 3; ++row) {
+            double * a = frames.R[3 * row];
+            double * b = frames.R[3 * row + 1];
+            double * c = frames.R[3 * row + 2];
+            double * t = frames.t[row];
+            for (size_t p = 0; p < frames.size; ++p) {
+                const double x = a[p], y = b[p], z = c[p];
+                a[p] = x * c00 + y * c10 + z * c20;
+                b[p] = x * c01 + y * c11 + z * c21;
+                c[p] = x * c02 + y * c12 + z * c22;
+                t[p] += x * c03 + y * c13 + z * c23;
+            }
+        }
+    }
+
+    // F = F * Rz(q)
+    void MultiplyHinge(FramesBlock & frames, const double * q)
+    {
+        for (size_t p = 0; p < frames.size; ++p) {
+            const double c = std::cos(q[p]);
+            const double s = std::sin(q[p]);
+            for (size_t row = 0; row < 3; ++row) {
+                double & x = frames.R[3 * row][p];
+                double & y = frames.R[3 * row + 1][p];
+                const double x0 = x;
+                x =  x0 * c + y * s;
+                y = -x0 * s + y * c;
+            }
+        }
+    }
+
+    // F = F * Tz(q)
+    void MultiplySlider(FramesBlock & frames, const double * q)
+    {
+        for (size_t row = 0; row < 3; ++row) {
+            const double * z = frames.R[3 * row + 2];
+            double * t = frames.t[row];
+            for (size_t p = 0; p < frames.size; ++p) {
+                t[p] += q[p] * z[p];
+            }
+        }
+    }
+
+    template <typename _matrixType>
+    void SetPoseColumn(_matrixType & poses, const size_t index, const vctFrm4x4 & pose)
+    {
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t col = 0; col < 3; ++col) {
+                poses.Element(3 * row + col, index) = pose.Element(row, col);
+            }
+            poses.Element(row + 9, index) = pose.Element(row, 3);
+        }
+    }
+
+    template <typename _matrixType>
+    void GetPoseColumn(const _matrixType & poses, const size_t index, vctFrm4x4 & pose)
+    {
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t col = 0; col < 3; ++col) {
+                pose.Element(row, col) = poses.Element(3 * row + col, index);
+            }
+            pose.Element(row, 3) = poses.Element(row + 9, index);
+        }
+    }
+
+    // run function over [0, nbPoses) split in contiguous blocks
+    template <typename _function>
+    void RunBlocks(const size_t nbThreads, const size_t nbPoses, _function function)
+    {
+        if (nbThreads <= 1) {
+            function(0, nbPoses, 0);
+            return;
+        }
+        const size_t blockSize = (nbPoses + nbThreads - 1) / nbThreads;
+        std::vector<std::thread> threads;
+        size_t thread = 0;
+        for (size_t begin = 0; begin < nbPoses; begin += blockSize, ++thread) {
+            const size_t end = std::min(begin + blockSize, nbPoses);
+            threads.push_back(std::thread(function, begin, end, thread));
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+robManipulatorBatch::robManipulatorBatch(void):
+    mManipulator(0),
+    mNumberOfThreads(1),
+    mWarmStart(true),
+    mGeneric(false),
+    mBase(vctFrm4x4::Identity()),
+    mToolOffset(vctFrm4x4::Identity())
+{
+}
+
+bool robManipulatorBatch::Configure(const robManipulator & manipulator)
+{
+    mManipulator = &manipulator;
+    mGeneric = false;
+    const size_t nbLinks = manipulator.links.size();
+    mConstants.resize(nbLinks);
+    mAxisAtEnd.resize(nbLinks);
+    mIsHinge.resize(nbLinks);
+
+    // arbitrary value to check decomposition
+    const double qTest = 0.7;
+    vctMatRot3 rotation;
+    rotation.From(vctAxAnRot3(vct3(0.0, 0.0, 1.0), qTest));
+    vctFrm4x4 motion, expected;
+    vctFrm4x4 chain = manipulator.Rtw0;
+    for (size_t index = 0; index < nbLinks; ++index) {
+        const robKinematics * kinematics = manipulator.links[index].GetKinematics();
+        // standard DH: joint motion, then constant part.  modified DH:
+        // constant part, then joint motion
+        mAxisAtEnd[index] = (kinematics->GetConvention() != robKinematics::STANDARD_DH);
+        mIsHinge[index] = (kinematics->GetType() == robJoint::HINGE);
+        mConstants[index] = manipulator.links[index].ForwardKinematics(0.0);
+        chain = chain * mConstants[index];
+
+        // make sure the decomposition is valid for this link
+        motion = vctFrm4x4::Identity();
+        if (mIsHinge[index]) {
+            motion.Rotation().Assign(rotation);
+        } else {
+            motion.Translation().Assign(0.0, 0.0, qTest);
+        }
+        if (mAxisAtEnd[index]) {
+            expected = mConstants[index] * motion;
+        } else {
+            expected = motion * mConstants[index];
+        }
+        if (!expected.AlmostEqual(manipulator.links[index].ForwardKinematics(qTest), 1e-9)) {
+            mGeneric = true;
+        }
+    }
+    mBase = manipulator.Rtw0;
+
+    // tool offset is constant, compute it once using the full
+    // forward kinematics from robManipulator
+    const vctDoubleVec zeros(nbLinks, 0.0);
+    chain.ApplyInverseTo(manipulator.ForwardKinematics(zeros), mToolOffset);
+
+    return !mGeneric;
+}
+
+void robManipulatorBatch::SetNumberOfThreads(const size_t numberOfThreads)
+{
+    mNumberOfThreads = std::max(numberOfThreads, static_cast<size_t>(1));
+}
+
+void robManipulatorBatch::ForwardKinematics(const vctDoubleMat & joints,
+                                            vctDoubleMat & poses) const
+{
+    const size_t nbPoses = joints.cols();
+    if ((poses.rows() != POSE_ROWS)
+        || (poses.cols() != nbPoses)
+        || (poses.col_stride() != 1)) {
+        poses.SetSize(POSE_ROWS, nbPoses, VCT_ROW_MAJOR);
+    }
+    ForwardKinematics(ConstMatrixRefType(joints), MatrixRefType(poses));
+}
+
+void robManipulatorBatch::ForwardKinematics(const ConstMatrixRefType & joints,
+                                            MatrixRefType poses) const
+{
+    CMN_ASSERT(mManipulator);
+    CMN_ASSERT(joints.rows() == NumberOfLinks());
+    // structure of arrays, values for a given joint must be contiguous
+    CMN_ASSERT(joints.col_stride() == 1);
+    const size_t nbPoses = joints.cols();
+    CMN_ASSERT(poses.rows() == POSE_ROWS);
+    CMN_ASSERT(poses.cols() == nbPoses);
+    CMN_ASSERT(poses.col_stride() == 1);
+
+    RunBlocks(std::min(mNumberOfThreads, nbPoses), nbPoses,
+              [&](const size_t begin, const size_t end, const size_t) {
+                  ForwardKinematicsBlock(joints, poses, begin, end);
+              });
+}
+
+void robManipulatorBatch::ForwardKinematicsBlock(const ConstMatrixRefType & joints,
+                                                 MatrixRefType & poses,
+                                                 const size_t begin,
+                                                 const size_t end) const
+{
+    // generic implementation, one pose at a time
+    if (mGeneric) {
+        vctDoubleVec q(joints.rows());
+        vctFrm4x4 pose;
+        for (size_t index = begin; index < end; ++index) {
+            q.Assign(joints.Column(index));
+            pose = mManipulator->ForwardKinematics(q);
+            SetPose(poses, index, pose);
+        }
+        return;
+    }
+
+    FramesBlock frames;
+    frames.size = end - begin;
+    for (size_t row = 0; row < 9; ++row) {
+        frames.R[row] = poses.Pointer(row, begin);
+    }
+    for (size_t row = 0; row < 3; ++row) {
+        frames.t[row] = poses.Pointer(row + 9, begin);
+    }
+
+    // initialize with base frame
+    for (size_t row = 0; row < 3; ++row) {
+        for (size_t col = 0; col < 3; ++col) {
+            std::fill(frames.R[3 * row + col], frames.R[3 * row + col] + frames.size,
+                      mBase.Element(row, col));
+        }
+        std::fill(frames.t[row], frames.t[row] + frames.size,
+                  mBase.Element(row, 3));
+    }
+
+    // walk the chain, one link at a time for all poses
+    const size_t nbLinks = NumberOfLinks();
+    for (size_t index = 0; index < nbLinks; ++index) {
+        const double * q = joints.Pointer(index, begin);
+        if (mAxisAtEnd[index]) {
+            MultiplyConstant(frames, mConstants[index]);
+        }
+        if (mIsHinge[index]) {
+            MultiplyHinge(frames, q);
+        } else {
+            MultiplySlider(frames, q);
+        }
+        if (!mAxisAtEnd[index]) {
+            MultiplyConstant(frames, mConstants[index]);
+        }
+    }
+    MultiplyConstant(frames, mToolOffset);
+}
+
+size_t robManipulatorBatch::InverseKinematics(const std::vector<robManipulator *> & manipulators,
+                                              const vctDoubleMat & poses,
+                                              vctDoubleMat & joints,
+                                              std::vector<robManipulator::Errno> & errors) const
+{
+    return InverseKinematics(manipulators, ConstMatrixRefType(poses), MatrixRefType(joints), errors);
+}
+
+size_t robManipulatorBatch::InverseKinematics(const std::vector<robManipulator *> & manipulators,
+                                              const ConstMatrixRefType & poses,
+                                              MatrixRefType joints,
+                                              std::vector<robManipulator::Errno> & errors) const
+{
+    CMN_ASSERT(!manipulators.empty());
+    CMN_ASSERT(poses.rows() == POSE_ROWS);
+    CMN_ASSERT(joints.cols() == poses.cols());
+    const size_t nbPoses = poses.cols();
+    errors.resize(nbPoses);
+
+    RunBlocks(std::min(manipulators.size(), nbPoses), nbPoses,
+              [&](const size_t begin, const size_t end, const size_t thread) {
+                  InverseKinematicsBlock(manipulators[thread], poses, joints, errors, begin, end);
+              });
+
+    size_t nbFailures = 0;
+    for (const auto & error : errors) {
+        if (error != robManipulator::ESUCCESS) {
+            ++nbFailures;
+        }
+    }
+    return nbFailures;
+}
+
+void robManipulatorBatch::InverseKinematicsBlock(robManipulator * manipulator,
+                                                 const ConstMatrixRefType & poses,
+                                                 MatrixRefType & joints,
+                                                 std::vector<robManipulator::Errno> & errors,
+                                                 const size_t begin,
+                                                 const size_t end) const
+{
+    CMN_ASSERT(manipulator);
+    vctDoubleVec q(joints.rows());
+    vctFrm4x4 goal;
+    bool previousValid = false;
+    for (size_t index = begin; index < end; ++index) {
+        // use previous solution if possible, otherwise initial guess
+        if (!mWarmStart || !previousValid) {
+            q.Assign(joints.Column(index));
+        }
+        GetPose(poses, index, goal);
+        errors[index] = manipulator->InverseKinematics(q, goal);
+        previousValid = (errors[index] == robManipulator::ESUCCESS);
+        joints.Column(index).Assign(q);
+    }
+}
+
+void robManipulatorBatch::Jacobians(const vctDoubleMat & joints,
+                                    vctDoubleMat & bodyJacobians,
+                                    vctDoubleMat & spatialJacobians) const
+{
+    const size_t nbRows = JACOBIAN_ROWS * NumberOfLinks();
+    const size_t nbPoses = joints.cols();
+    if ((bodyJacobians.rows() != nbRows)
+        || (bodyJacobians.cols() != nbPoses)) {
+        bodyJacobians.SetSize(nbRows, nbPoses, VCT_ROW_MAJOR);
+    }
+    if ((spatialJacobians.rows() != nbRows)
+        || (spatialJacobians.cols() != nbPoses)) {
+        spatialJacobians.SetSize(nbRows, nbPoses, VCT_ROW_MAJOR);
+    }
+    Jacobians(ConstMatrixRefType(joints), MatrixRefType(bodyJacobians), MatrixRefType(spatialJacobians));
+}
+
+void robManipulatorBatch::Jacobians(const ConstMatrixRefType & joints,
+                                    MatrixRefType bodyJacobians,
+                                    MatrixRefType spatialJacobians) const
+{
+    CMN_ASSERT(mManipulator);
+    CMN_ASSERT(joints.rows() == NumberOfLinks());
+    const size_t nbRows = JACOBIAN_ROWS * NumberOfLinks();
+    const size_t nbPoses = joints.cols();
+    CMN_ASSERT((bodyJacobians.rows() == nbRows) && (bodyJacobians.cols() == nbPoses));
+    CMN_ASSERT((spatialJacobians.rows() == nbRows) && (spatialJacobians.cols() == nbPoses));
+
+    RunBlocks(std::min(mNumberOfThreads, nbPoses), nbPoses,
+              [&](const size_t begin, const size_t end, const size_t) {
+                  JacobiansBlock(joints, bodyJacobians, spatialJacobians, begin, end);
+              });
+}
+
+void robManipulatorBatch::JacobiansBlock(const ConstMatrixRefType & joints,
+                                         MatrixRefType & bodyJacobians,
+                                         MatrixRefType & spatialJacobians,
+                                         const size_t begin,
+                                         const size_t end) const
+{
+    // evaluator keeps intermediate frames, one per thread
+    robManipulatorEvaluator evaluator;
+    evaluator.Configure(*mManipulator);
+    const size_t nbLinks = NumberOfLinks();
+    vctDoubleVec q(nbLinks);
+    vctFrm4x4 pose;
+    vctDoubleMat body(JACOBIAN_ROWS, nbLinks, VCT_ROW_MAJOR);
+    vctDoubleMat spatial(JACOBIAN_ROWS, nbLinks, VCT_ROW_MAJOR);
+    for (size_t index = begin; index < end; ++index) {
+        q.Assign(joints.Column(index));
+        evaluator.Evaluate(*mManipulator, q, pose, body, spatial);
+        for (size_t row = 0; row < JACOBIAN_ROWS; ++row) {
+            for (size_t col = 0; col < nbLinks; ++col) {
+                bodyJacobians.Element(row * nbLinks + col, index) = body.Element(row, col);
+                spatialJacobians.Element(row * nbLinks + col, index) = spatial.Element(row, col);
+            }
+        }
+    }
+}
+
+void robManipulatorBatch::SetPose(vctDoubleMat & poses, const size_t index,
+                                  const vctFrm4x4 & pose)
+{
+    SetPoseColumn(poses, index, pose);
+}
+
+void robManipulatorBatch::GetPose(const vctDoubleMat & poses, const size_t index,
+                                  vctFrm4x4 & pose)
+{
+    GetPoseColumn(poses, index, pose);
+}
+
+void robManipulatorBatch::SetPose(MatrixRefType & poses, const size_t index,
+                                  const vctFrm4x4 & pose)
+{
+    SetPoseColumn(poses, index, pose);
+}
+
+void robManipulatorBatch::GetPose(const ConstMatrixRefType & poses, const size_t index,
+                                  vctFrm4x4 & pose)
+{
+    GetPoseColumn(poses, index, pose);
+}
@@ -0,0 +1,190 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-06
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#include <sawIntuitiveResearchKit/robManipulatorEvaluator.h>
+#include <sawIntuitiveResearchKit/robManipulatorFixed.h>
+
+robManipulatorEvaluator::robManipulatorEvaluator(void):
+    mToolOffset(vctFrm4x4::Identity()),
+    mSinglePass(false),
+    mFixedManipulator(nullptr),
+    mFixedSize(nullptr)
+{
+}
+
+void robManipulatorEvaluator::Configure(const robManipulator & manipulator)
+{
+    const size_t nbLinks = manipulator.links.size();
+    mFrames.resize(nbLinks + 1);
+    mAxisAtEnd.resize(nbLinks);
+    mIsHinge.resize(nbLinks);
+    for (size_t index = 0; index < nbLinks; ++index) {
+        const robKinematics * kinematics = manipulator.links[index].GetKinematics();
+        // standard DH rotates along z of previous frame, modified along z of new frame
+        mAxisAtEnd[index] = (kinematics->GetConvention() != robKinematics::STANDARD_DH);
+        mIsHinge[index] = (kinematics->GetType() == robJoint::HINGE);
+    }
+
+    // fixed size implementation, already validated against the
+    // generic one by ConfigureFixedSize
+    mFixedManipulator = nullptr;
+    mFixedSize = dynamic_cast<const robManipulatorFixedBase *>(&manipulator);
+    if (mFixedSize && mFixedSize->IsFixedSize()) {
+        mFixedManipulator = &manipulator;
+    } else {
+        mFixedSize = nullptr;
+    }
+
+    // tools with links depend on joint values, not supported
+    mSinglePass = true;
+    for (const auto tool : manipulator.tools) {
+        if (tool && !tool->links.empty()) {
+            mSinglePass = false;
+        }
+    }
+    if (!mSinglePass) {
+        return;
+    }
+
+    // tool offset is constant, compute it once using the full
+    // forward kinematics from robManipulator
+    const vctDoubleVec zeros(nbLinks, 0.0);
+    ComputeFrames(manipulator, zeros);
+    const vctFrm4x4 withTool = manipulator.ForwardKinematics(zeros);
+    mFrames[nbLinks].ApplyInverseTo(withTool, mToolOffset);
+
+    // make sure derived classes don't override the kinematics, use
+    // a couple of arbitrary configurations
+    vctDoubleVec q(nbLinks);
+    for (size_t index = 0; index < nbLinks; ++index) {
+        q[index] = 0.1 * static_cast<double>(index + 1);
+    }
+    mSinglePass = MatchesManipulator(manipulator, q);
+    if (mSinglePass) {
+        for (size_t index = 0; index < nbLinks; ++index) {
+            q[index] = -0.05 * static_cast<double>(nbLinks - index);
+        }
+        mSinglePass = MatchesManipulator(manipulator, q);
+    }
+}
+
+bool robManipulatorEvaluator::MatchesManipulator(const robManipulator & manipulator,
+                                                 const vctDoubleVec & q)
+{
+    const size_t nbLinks = mAxisAtEnd.size();
+    vctDoubleMat body(6, nbLinks), spatial(6, nbLinks);
+    vctDoubleMat bodyExpected(6, nbLinks), spatialExpected(6, nbLinks);
+    vctFrm4x4 pose;
+    EvaluateSinglePass(manipulator, q, pose, body, spatial);
+    manipulator.JacobianBody(q, bodyExpected);
+    manipulator.JacobianSpatial(q, spatialExpected);
+    const double tolerance = 1.0e-9;
+    return pose.AlmostEqual(manipulator.ForwardKinematics(q), tolerance)
+        && body.AlmostEqual(bodyExpected, tolerance)
+        && spatial.AlmostEqual(spatialExpected, tolerance);
+}
+
+void robManipulatorEvaluator::ComputeFrames(const robManipulator & manipulator,
+                                            const vctDoubleVec & q)
+{
+    const size_t nbLinks = mAxisAtEnd.size();
+    CMN_ASSERT(q.size() >= nbLinks);
+    mFrames[0] = manipulator.Rtw0;
+    for (size_t index = 0; index < nbLinks; ++index) {
+        mFrames[index + 1] = mFrames[index] * manipulator.links[index].ForwardKinematics(q[index]);
+    }
+}
+
+void robManipulatorEvaluator::Evaluate(const robManipulator & manipulator,
+                                       const vctDoubleVec & q,
+                                       vctFrm4x4 & pose)
+{
+    if (!mSinglePass || (&manipulator == mFixedManipulator)) {
+        pose = manipulator.ForwardKinematics(q);
+        return;
+    }
+    ComputeFrames(manipulator, q);
+    pose = mFrames[mAxisAtEnd.size()] * mToolOffset;
+}
+
+void robManipulatorEvaluator::Evaluate(const robManipulator & manipulator,
+                                       const vctDoubleVec & q,
+                                       vctFrm4x4 & pose,
+                                       vctDoubleMat & bodyJacobian,
+                                       vctDoubleMat & spatialJacobian)
+{
+    if (&manipulator == mFixedManipulator) {
+        mFixedSize->ForwardKinematicsAndJacobians(q, pose, bodyJacobian, spatialJacobian);
+        return;
+    }
+    if (!mSinglePass) {
+        pose = manipulator.ForwardKinematics(q);
+        manipulator.JacobianBody(q, bodyJacobian);
+        manipulator.JacobianSpatial(q, spatialJacobian);
+        return;
+    }
+    EvaluateSinglePass(manipulator, q, pose, bodyJacobian, spatialJacobian);
+}
+
+void robManipulatorEvaluator::EvaluateSinglePass(const robManipulator & manipulator,
+                                                 const vctDoubleVec & q,
+                                                 vctFrm4x4 & pose,
+                                                 vctDoubleMat & bodyJacobian,
+                                                 vctDoubleMat & spatialJacobian)
+{
+    const size_t nbLinks = mAxisAtEnd.size();
+    CMN_ASSERT(bodyJacobian.rows() == 6);
+    CMN_ASSERT(bodyJacobian.cols() >= nbLinks);
+    CMN_ASSERT(spatialJacobian.rows() == 6);
+    CMN_ASSERT(spatialJacobian.cols() >= nbLinks);
+
+    ComputeFrames(manipulator, q);
+    pose = mFrames[nbLinks] * mToolOffset;
+
+    const vct3 tip = pose.Translation();
+    vct3 axis, lever, linear, angular, bodyLinear, bodyAngular;
+
+    for (size_t index = 0; index < nbLinks; ++index) {
+        const vctFrm4x4 & frame = mAxisAtEnd[index] ? mFrames[index + 1] : mFrames[index];
+        axis = frame.Rotation().Column(2).Ref<3>();
+        if (mIsHinge[index]) {
+            lever.DifferenceOf(tip, frame.Translation());
+            linear.CrossProductOf(axis, lever);
+            angular.Assign(axis);
+        } else {
+            linear.Assign(axis);
+            angular.SetAll(0.0);
+        }
+        // spatial, i.e. expressed in base frame
+        spatialJacobian.Element(0, index) = linear.X();
+        spatialJacobian.Element(1, index) = linear.Y();
+        spatialJacobian.Element(2, index) = linear.Z();
+        spatialJacobian.Element(3, index) = angular.X();
+        spatialJacobian.Element(4, index) = angular.Y();
+        spatialJacobian.Element(5, index) = angular.Z();
+        // body, same but expressed in tool frame
+        pose.Rotation().ApplyInverseTo(linear, bodyLinear);
+        pose.Rotation().ApplyInverseTo(angular, bodyAngular);
+        bodyJacobian.Element(0, index) = bodyLinear.X();
+        bodyJacobian.Element(1, index) = bodyLinear.Y();
+        bodyJacobian.Element(2, index) = bodyLinear.Z();
+        bodyJacobian.Element(3, index) = bodyAngular.X();
+        bodyJacobian.Element(4, index) = bodyAngular.Y();
+        bodyJacobian.Element(5, index) = bodyAngular.Z();
+    }
+}
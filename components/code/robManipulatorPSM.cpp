@@ -0,0 +1,223 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-14
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#include <sawIntuitiveResearchKit/robManipulatorPSM.h>
+
+#include <cisstCommon/cmnUnits.h>
+#include <cisstCommon/cmnConstants.h>
+#include <cmath>
+
+namespace {
+    // signed angle to rotate from a to b along axis, a and b are
+    // assumed to be perpendicular to axis
+    double SignedAngle(const vct3 & a, const vct3 & b, const vct3 & axis) {
+        vct3 cross;
+        cross.CrossProductOf(a, b);
+        return atan2(vctDotProduct(cross, axis), vctDotProduct(a, b));
+    }
+
+    // find value closest to reference modulo 2 pi
+    double ClosestAngle(const double angle, const double reference) {
+        return angle + 2.0 * cmnPI * std::round((reference - angle) / (2.0 * cmnPI));
+    }
+}
+
+robManipulatorPSM::robManipulatorPSM(const std::vector<robKinematics *> linkParms,
+                                     const vctFrame4x4<double> &Rtw0)
+    : robManipulator(linkParms, Rtw0)
+{
+}
+
+robManipulatorPSM::robManipulatorPSM(const std::string &robotfilename,
+                                     const vctFrame4x4<double> &Rtw0)
+    : robManipulator(robotfilename, Rtw0)
+{
+}
+
+robManipulatorPSM::robManipulatorPSM(const vctFrame4x4<double> &Rtw0)
+    : robManipulator(Rtw0)
+{
+}
+
+void robManipulatorPSM::LocalForwardKinematics(const vctDynamicVector<double> & q,
+                                               const int N,
+                                               vctFrame4x4<double> & frame) const
+{
+    frame = vctFrm4x4::Identity();
+    for (int index = 0; index < N; ++index) {
+        frame = frame * links[index].ForwardKinematics(q[index]);
+    }
+}
+
+robManipulator::Errno
+robManipulatorPSM::InverseKinematics(vctDynamicVector<double> & q,
+                                     const vctFrame4x4<double> & Rts,
+                                     double tolerance,
+                                     size_t Niterations,
+                                     double LAMBDA)
+{
+    mUsedIterative = false;
+
+    if (q.size() != links.size()) {
+        std::stringstream ss;
+        ss << "robManipulatorPSM::InverseKinematics: expected " << links.size()
+           << " joints values but received " << q.size();
+        mLastError = ss.str();
+        CMN_LOG_RUN_ERROR << mLastError << std::endl;
+        return robManipulator::EFAILURE;
+    }
+
+    if (links.size() != 6) {
+        std::stringstream ss;
+        ss << "robManipulatorPSM::InverseKinematics: closed form requires 6 links, manipulator has "
+           << links.size();
+        mLastError = ss.str();
+        CMN_LOG_RUN_ERROR << mLastError << std::endl;
+        return robManipulator::EFAILURE;
+    }
+
+    // take Rtw0 into account
+    vctFrm4x4 Rt06t, Rt06; // t for "with tool"
+    Rtw0.ApplyInverseTo(Rts, Rt06t);
+
+    // take tool into account -> Rt06 from Rt06t
+    if (tools.size() > 1) {
+        mLastError = "robManipulatorPSM::InverseKinematics: the manipulator has more than one tool attached";
+        CMN_LOG_RUN_ERROR << mLastError << std::endl;
+        return robManipulator::EFAILURE;
+    } else if (tools.size() == 1) {
+        CMN_ASSERT(tools[0]);
+        Rt06t.ApplyTo(tools[0]->Rtw0.Inverse(), Rt06);
+    } else {
+        Rt06 = Rt06t;
+    }
+
+    // constant offsets from DH parameters, computed at zero position
+    // so we don't depend on the exact DH values for each tool
+    mJoints.SetSize(6);
+    mJoints.SetAll(0.0);
+    vctFrm4x4 Rt03, Rt04, Rt05, Rt06z;
+    LocalForwardKinematics(mJoints, 3, Rt03);
+    Rt04 = Rt03 * links[3].ForwardKinematics(0.0);
+    Rt05 = Rt04 * links[4].ForwardKinematics(0.0);
+    Rt06z = Rt05 * links[5].ForwardKinematics(0.0);
+    // insertion offset between RCM and wrist pitch axis along shaft
+    const double insertionOffset = vctDotProduct(Rt04.Translation(),
+                                                 Rt03.Rotation().Column(2).Ref<3>());
+    // distance between pitch and yaw axis
+    const double pitchToYaw = (Rt06z.Translation() - Rt05.Translation()).Norm();
+    // pitch axis is along +/- x5 x z6 depending on DH alpha
+    vct3 pitchAxis;
+    pitchAxis.CrossProductOf(Rt05.Rotation().Column(0).Ref<3>(),
+                             Rt06z.Rotation().Column(2).Ref<3>());
+    const double pitchAxisSign =
+        (vctDotProduct(pitchAxis, Rt05.Rotation().Column(2).Ref<3>()) < 0.0) ? -1.0 : 1.0;
+
+    // goal yaw axis and position
+    const vct3 p6 = Rt06.Translation();
+    const vct3 z6 = Rt06.Rotation().Column(2).Ref<3>();
+    const vct3 x6 = Rt06.Rotation().Column(0).Ref<3>();
+
+    // pitch to yaw link is perpendicular to the yaw axis and in the
+    // plane defined by the yaw axis and the RCM point
+    vct3 x5 = p6 - vctDotProduct(p6, z6) * z6;
+    const double x5Norm = x5.Norm();
+    if (x5Norm < 0.1 * cmn_mm) {
+        // yaw axis goes through (or close to) RCM, the plane is not
+        // defined so use the iterative solver
+        mUsedIterative = true;
+        return robManipulator::InverseKinematics(q, Rts, tolerance, Niterations, LAMBDA);
+    }
+    x5.Divide(x5Norm);
+    const vct3 p5 = p6 - pitchToYaw * x5;
+
+    const double depth = p5.Norm();
+    // we should not allow anything in the cannula but at least make
+    // sure it's numerically stable
+    if (depth < 0.1 * cmn_mm) {
+        mLastError = "robManipulatorPSM::InverseKinematics: cartesian goal is too close to RCM point";
+        CMN_LOG_RUN_ERROR << mLastError << std::endl;
+        return robManipulator::EFAILURE;
+    }
+    mDistanceToRCM = depth;
+
+    // if we encounter a joint limit, keep computing a solution but at
+    // the end return failure
+    bool hasReachedJointLimit = false;
+
+    // first 3 joints, same as ECM
+    const double x = p5.X();
+    const double y = p5.Y();
+    const double z = p5.Z();
+    q[0] = ClosestAngle(atan2(x, -z), q[0]);
+    q[1] = -asin(y / depth);
+    q[2] = depth - insertionOffset;
+
+    if (ClampJointValueAndUpdateError(0, q[0], 1e-5)) {
+        hasReachedJointLimit = true;
+    }
+    if (ClampJointValueAndUpdateError(1, q[1], 1e-5)) {
+        hasReachedJointLimit = true;
+    }
+    if (ClampJointValueAndUpdateError(2, q[2], 1e-5)) {
+        hasReachedJointLimit = true;
+    }
+
+    // wrist, use joint axes computed with forward kinematics for each
+    // joint, all joints past the current one set to zero
+    const double previousRoll = q[3];
+    mJoints.Ref(3, 0).Assign(q.Ref(3, 0));
+    LocalForwardKinematics(mJoints, 3, Rt03);
+
+    // roll, align pitch axis
+    Rt04 = Rt03 * links[3].ForwardKinematics(0.0);
+    Rt05 = Rt04 * links[4].ForwardKinematics(0.0);
+    vct3 z5;
+    z5.CrossProductOf(x5, z6);
+    z5.Multiply(pitchAxisSign);
+    q[3] = SignedAngle(Rt05.Rotation().Column(2).Ref<3>(), z5,
+                       Rt04.Rotation().Column(2).Ref<3>());
+    q[3] = ClosestAngle(q[3], previousRoll);
+    if (ClampJointValueAndUpdateError(3, q[3], 1e-5)) {
+        hasReachedJointLimit = true;
+    }
+
+    // pitch, align pitch to yaw link
+    Rt04 = Rt03 * links[3].ForwardKinematics(q[3]);
+    Rt05 = Rt04 * links[4].ForwardKinematics(0.0);
+    q[4] = SignedAngle(Rt05.Rotation().Column(0).Ref<3>(), x5,
+                       Rt05.Rotation().Column(2).Ref<3>());
+    if (ClampJointValueAndUpdateError(4, q[4], 1e-5)) {
+        hasReachedJointLimit = true;
+    }
+
+    // yaw
+    Rt05 = Rt04 * links[4].ForwardKinematics(q[4]);
+    Rt06z = Rt05 * links[5].ForwardKinematics(0.0);
+    q[5] = SignedAngle(Rt06z.Rotation().Column(0).Ref<3>(), x6,
+                       Rt06z.Rotation().Column(2).Ref<3>());
+    if (ClampJointValueAndUpdateError(5, q[5], 1e-5)) {
+        hasReachedJointLimit = true;
+    }
+
+    if (hasReachedJointLimit) {
+        return robManipulator::EFAILURE;
+    }
+
+    return robManipulator::ESUCCESS;
+}
@@ -16,6 +16,8 @@ http://www.cisst.org/cisst/license.txt.
 --- end cisst license ---
 */
 
+#include <cisstOSAbstraction/osaGetTime.h>
+
 #include <sawIntuitiveResearchKit/robManipulatorPSMSnake.h>
 
 robManipulatorPSMSnake::robManipulatorPSMSnake(const std::vector<robKinematics *> linkParms,
@@ -54,17 +56,48 @@ void robManipulatorPSMSnake::Resize(void)
     m.A.SetAll(0.0);
     m.b.SetSize(6, 1, VCT_COL_MAJOR);
     m.b.SetAll(0.0);
+
+    // sizes don't change so we can allocate the solver workspace once
+    m.lsei.Allocate(m.E, m.A, m.G);
+    m.best.SetSize(links.size());
 }
 
 vctReturnDynamicVector<double>
 robManipulatorPSMSnake::ConstrainedRMRC(const vctDynamicVector<double> & q,
                                         const vctFixedSizeVector<double, 6> & vw)
+{
+    Resize();
+    ConstrainedRMRCInternal(q, vw);
+    return vctReturnDynamicVector<double>(m.lsei.GetX().Column(0));
+}
+
+void robManipulatorPSMSnake::ConstrainedRMRCInternal(const vctDynamicVector<double> & q,
+                                                     const vctFixedSizeVector<double, 6> & vw)
 {
     JacobianSpatial(q, m.A);
     m.b.Column(0) = vw;
-    m.lsei.Allocate(m.E, m.A, m.G);
     m.lsei.Solve(m.E, m.f, m.A, m.b, m.G, m.h);
-    return vctReturnDynamicVector<double>(m.lsei.GetX().Column(0));
+}
+
+void robManipulatorPSMSnake::PoseError(const vctDynamicVector<double> & q,
+                                       const vctFrame4x4<double> & Rts,
+                                       vctFixedSizeVector<double, 6> & error) const
+{
+    // Evaluate the forward kinematics
+    vctFrame4x4<double,VCT_ROW_MAJOR> Rt = ForwardKinematics( q );
+
+    // compute the translation error
+    error[0] = Rts[0][3] - Rt[0][3];
+    error[1] = Rts[1][3] - Rt[1][3];
+    error[2] = Rts[2][3] - Rt[2][3];
+
+    // compute the orientation error
+    vctFixedSizeVector<double,3> dr = 0.5 * ( (Rt.Rotation().Column(0) % Rts.Rotation().Column(0)) +
+                                              (Rt.Rotation().Column(1) % Rts.Rotation().Column(1)) +
+                                              (Rt.Rotation().Column(2) % Rts.Rotation().Column(2)) );
+    error[3] = dr[0];
+    error[4] = dr[1];
+    error[5] = dr[2];
 }
 
 robManipulator::Errno
@@ -94,32 +127,19 @@ robManipulatorPSMSnake::InverseKinematics(vctDynamicVector<double> & q,
     double ndq = 1.0;               // norm of the iteration error
     size_t i = 0;
     // loop until Niter are executed or the error is bellow the tolerance
+    vctFixedSizeVector<double,6> e;
     for (i = 0; i < Niterations && tolerance < ndq; i++) {
 
-        // Evaluate the forward kinematics
-        vctFrame4x4<double,VCT_ROW_MAJOR> Rt = ForwardKinematics( q );
-
-        // compute the translation error
-        vctFixedSizeVector<double,3> dt( Rts[0][3] - Rt[0][3],
-                                         Rts[1][3] - Rt[1][3],
-                                         Rts[2][3] - Rt[2][3] );
-
-        // compute the orientation error
-        // This is the orientation error
-        vctFixedSizeVector<double,3> dr = 0.5 * ( (Rt.Rotation().Column(0) % Rts.Rotation().Column(0)) +
-                                                  (Rt.Rotation().Column(1) % Rts.Rotation().Column(1)) +
-                                                  (Rt.Rotation().Column(2) % Rts.Rotation().Column(2)) );
+        // combined translation and orientation errors in one R^6 vector
+        PoseError(q, Rts, e);
 
-        // combine both errors in one R^6 vector
-        vctFixedSizeVector<double,6> e( dt[0], dt[1], dt[2], dr[0], dr[1], dr[2] );
-
-        vctDynamicVector<double> dq = ConstrainedRMRC( q, e );
+        ConstrainedRMRCInternal(q, e);
 
         // compute the L2 norm of the error
-        ndq = dq.Norm();
+        ndq = m.lsei.GetX().Column(0).Norm();
 
         // update the solution
-        q.Add(dq);
+        q.Add(m.lsei.GetX().Column(0));
     }
 
     NormalizeAngles(q);
@@ -129,3 +149,81 @@ robManipulatorPSMSnake::InverseKinematics(vctDynamicVector<double> & q,
     }
     return robManipulator::ESUCCESS;
 }
+
+void robManipulatorPSMSnake::SetBoundedBudget(const size_t maxIterations,
+                                              const double maxTime)
+{
+    mBoundedMaxIterations = maxIterations;
+    mBoundedMaxTime = maxTime;
+}
+
+robManipulator::Errno
+robManipulatorPSMSnake::InverseKinematicsBounded(vctDynamicVector<double> & q,
+                                                 const vctFrame4x4<double> & Rts,
+                                                 const vctDynamicVector<double> & qdPredicted,
+                                                 const double dt,
+                                                 const double tolerance)
+{
+    const double startTime = osaGetTime();
+    mBoundedStatus.converged = false;
+    mBoundedStatus.iterations = 0;
+    mBoundedStatus.residual = 0.0;
+    mBoundedStatus.elapsed = 0.0;
+
+    if ((q.size() != links.size()) || (links.size() == 0)) {
+        CMN_LOG_RUN_ERROR << CMN_LOG_DETAILS
+                          << ": robManipulatorPSMSnake::InverseKinematicsBounded: expected " << links.size() << " joints values. "
+                          << " Got " << q.size()
+                          << std::endl;
+        return robManipulator::EFAILURE;
+    }
+
+    Resize();
+
+    // warm start using predicted velocity
+    if (qdPredicted.size() == q.size()) {
+        q.AddProductOf(dt, qdPredicted);
+    }
+
+    double ndq = 1.0;               // norm of the last increment
+    double bestResidual = cmnTypeTraits<double>::PlusInfinityOrMaximum();
+    vctFixedSizeVector<double,6> e;
+    while (true) {
+        // error for current solution, keep best one so far
+        PoseError(q, Rts, e);
+        const double residual = e.Norm();
+        if (residual < bestResidual) {
+            bestResidual = residual;
+            m.best.Assign(q);
+        }
+        // converged
+        if (ndq <= tolerance) {
+            mBoundedStatus.converged = true;
+            break;
+        }
+        // out of budget
+        if ((mBoundedStatus.iterations >= mBoundedMaxIterations)
+            || ((mBoundedMaxTime > 0.0)
+                && ((osaGetTime() - startTime) >= mBoundedMaxTime))) {
+            break;
+        }
+        // next iteration
+        ConstrainedRMRCInternal(q, e);
+        ndq = m.lsei.GetX().Column(0).Norm();
+        q.Add(m.lsei.GetX().Column(0));
+        mBoundedStatus.iterations++;
+    }
+
+    // use best partial solution if we didn't converge
+    if (!mBoundedStatus.converged) {
+        q.Assign(m.best);
+    }
+    NormalizeAngles(q);
+
+    mBoundedStatus.residual = bestResidual;
+    mBoundedStatus.elapsed = osaGetTime() - startTime;
+    if (mBoundedStatus.converged) {
+        return robManipulator::ESUCCESS;
+    }
+    return robManipulator::EFAILURE;
+}
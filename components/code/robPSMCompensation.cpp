@@ -0,0 +1,108 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <cisstCommon/cmnLogger.h>
+#include <sawIntuitiveResearchKit/robPSMCompensation.h>
+
+bool robPSMCompensation::Configure(const Json::Value & jsonConfig,
+                                   std::string & errorMessage)
+{
+    mArms.clear();
+
+    // multiple arms
+    const Json::Value jsonArms = jsonConfig["arms"];
+    if (!jsonArms.isNull()) {
+        if (!jsonArms.isObject()) {
+            errorMessage = "\"arms\" must be an object, i.e. {\"PSM1\": {...}, \"PSM2\": ...}";
+            return false;
+        }
+        for (const auto & armName : jsonArms.getMemberNames()) {
+            if (!ConfigureArm(jsonArms[armName]["parameters"], mArms[armName], errorMessage)) {
+                errorMessage = armName + ": " + errorMessage;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // single arm, original format
+    return ConfigureArm(jsonConfig["parameters"], mArms[""], errorMessage);
+}
+
+const robPSMCompensation::ParametersType * robPSMCompensation::Find(const std::string & armName) const
+{
+    ArmsMap::const_iterator found = mArms.find(armName);
+    if (found == mArms.end()) {
+        found = mArms.find("");
+    }
+    if (found == mArms.end()) {
+        return 0;
+    }
+    return &(found->second);
+}
+
+bool robPSMCompensation::ConfigureArm(const Json::Value & jsonParameters,
+                                      ParametersType & parameters,
+                                      std::string & errorMessage)
+{
+    if (!jsonParameters.isArray() || (jsonParameters.size() == 0)) {
+        errorMessage = "configuration needs a non empty array \"parameters\"";
+        return false;
+    }
+
+    for (size_t joint = 0; joint < 2; ++joint) {
+        parameters.compliance[joint].SetAll(0.0);
+        parameters.torque_offset[joint].SetAll(0.0);
+        parameters.backlash[joint] = 0.0;
+    }
+
+    for (unsigned int index = 0; index < jsonParameters.size(); ++index) {
+        const Json::Value parameter = jsonParameters[index];
+        const Json::Value jsonName = parameter["parameter"];
+        if (jsonName.empty()) {
+            errorMessage = "can't find \"parameter\" for parameters[" + std::to_string(index) + "]";
+            return false;
+        }
+        const std::string name = jsonName.asString();
+        // some files use "value" instead of "value-a"
+        const double a = parameter.get("value-a", parameter.get("value", 0.0)).asDouble();
+        const double b = parameter.get("value-b", 0.0).asDouble();
+        const double c = parameter.get("value-c", 0.0).asDouble();
+        const double d = parameter.get("value-d", 0.0).asDouble();
+        if (name == "compliance_first") {
+            parameters.compliance[0].Assign(a, b, c, d);
+        } else if (name == "torque_offset_first") {
+            // constant
+            parameters.torque_offset[0].Assign(0.0, a);
+        } else if (name == "backlash_first") {
+            parameters.backlash[0] = a;
+        } else if (name == "compliance_second") {
+            parameters.compliance[1].Assign(a, b, c, d);
+        } else if (name == "torque_offset_second") {
+            // linear function of insertion
+            parameters.torque_offset[1].Assign(a, b);
+        } else if (name == "backlash_second") {
+            parameters.backlash[1] = a;
+        } else {
+            // newer files might have parameters we don't use yet
+            CMN_LOG_INIT_WARNING << "robPSMCompensation::ConfigureArm: ignoring unknown parameter \""
+                                 << name << "\"" << std::endl;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,201 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <cisstCommon/cmnConstants.h>
+#include <cisstCommon/cmnUnits.h>
+
+#include <sawIntuitiveResearchKit/robReachabilityMap.h>
+
+namespace {
+    // values sampled per wrist joint to find the wrist reach
+    const size_t ReachabilityWristSamples = 5;
+    // extra distance added to the wrist reach
+    const double ReachabilityWristMargin = 1.0 * cmn_mm;
+}
+
+void robReachabilityMap::Clear(void)
+{
+    m_angles.clear();
+    m_nb_azimuth = 0;
+    m_nb_elevation = 0;
+}
+
+bool robReachabilityMap::Build(const robManipulator & manipulator,
+                               const double resolution,
+                               std::string & errorMessage)
+{
+    Clear();
+    const size_t nbLinks = manipulator.links.size();
+    if (nbLinks < 4) {
+        errorMessage = "manipulator must have at least 4 links";
+        return false;
+    }
+    if (resolution <= 0.0) {
+        errorMessage = "resolution must be strictly positive";
+        return false;
+    }
+
+    vctDoubleVec lower(nbLinks), upper(nbLinks);
+    for (size_t index = 0; index < nbLinks; ++index) {
+        lower.at(index) = manipulator.links[index].GetKinematics()->PositionMin();
+        upper.at(index) = manipulator.links[index].GetKinematics()->PositionMax();
+    }
+    vctDoubleVec q(nbLinks);
+    q.SumOf(lower, upper);
+    q.Multiply(0.5);
+
+    // samples are in the RCM frame, i.e. without the base offset
+    m_base_inverse.InverseOf(manipulator.Rtw0);
+
+    // distance from RCM to wrist center only depends on insertion
+    m_radius_min = std::numeric_limits<double>::max();
+    m_radius_max = 0.0;
+    const size_t insertionSamples = 11;
+    for (size_t sample = 0; sample < insertionSamples; ++sample) {
+        vctDoubleVec qInsertion(q);
+        qInsertion.at(2) = lower.at(2) + (upper.at(2) - lower.at(2)) * sample / (insertionSamples - 1);
+        const double radius = (m_base_inverse * manipulator.ForwardKinematics(qInsertion, 4)).Translation().Norm();
+        m_radius_min = std::min(m_radius_min, radius);
+        m_radius_max = std::max(m_radius_max, radius);
+    }
+    if (m_radius_max <= 0.0) {
+        errorMessage = "wrist center doesn't move away from the RCM";
+        return false;
+    }
+
+    // wrist reach, sample all joints after the 4th link
+    size_t nbWristSamples = 1;
+    for (size_t index = 3; index < nbLinks; ++index) {
+        nbWristSamples *= ReachabilityWristSamples;
+    }
+    m_wrist_reach = 0.0;
+    vctDoubleVec qWrist(q);
+    qWrist.at(2) = upper.at(2);
+    for (size_t sample = 0; sample < nbWristSamples; ++sample) {
+        size_t remainder = sample;
+        for (size_t index = 3; index < nbLinks; ++index) {
+            const size_t step = remainder % ReachabilityWristSamples;
+            remainder /= ReachabilityWristSamples;
+            qWrist.at(index) = lower.at(index)
+                + (upper.at(index) - lower.at(index)) * step / (ReachabilityWristSamples - 1);
+        }
+        const vct3 wrist = manipulator.ForwardKinematics(qWrist, 4).Translation();
+        const vct3 tip = manipulator.ForwardKinematics(qWrist).Translation();
+        m_wrist_reach = std::max(m_wrist_reach, (tip - wrist).Norm());
+    }
+    m_wrist_reach += ReachabilityWristMargin;
+
+    // mark cells reached by the wrist center, sampling the first
+    // two joints at half the grid resolution
+    m_resolution = resolution;
+    m_nb_azimuth = static_cast<size_t>(std::ceil(2.0 * cmnPI / resolution));
+    m_nb_elevation = static_cast<size_t>(std::ceil(cmnPI / resolution));
+    std::vector<bool> reached(m_nb_azimuth * m_nb_elevation, false);
+    const double step = 0.5 * resolution;
+    vctDoubleVec qDirection(q);
+    qDirection.at(2) = upper.at(2);
+    for (double q0 = lower.at(0); q0 <= upper.at(0) + step; q0 += step) {
+        qDirection.at(0) = std::min(q0, upper.at(0));
+        for (double q1 = lower.at(1); q1 <= upper.at(1) + step; q1 += step) {
+            qDirection.at(1) = std::min(q1, upper.at(1));
+            const vct3 wrist = (m_base_inverse * manipulator.ForwardKinematics(qDirection, 4)).Translation();
+            const double norm = wrist.Norm();
+            if (norm > 0.0) {
+                reached[Cell(wrist / norm)] = true;
+            }
+        }
+    }
+
+    // lower bound of angle to closest reached cell, cell centers can
+    // be up to a cell diagonal away from the directions (sampled or
+    // tested) so remove twice the resolution
+    std::vector<vct3> reachedDirections;
+    for (size_t azimuth = 0; azimuth < m_nb_azimuth; ++azimuth) {
+        for (size_t elevation = 0; elevation < m_nb_elevation; ++elevation) {
+            if (reached[azimuth * m_nb_elevation + elevation]) {
+                reachedDirections.push_back(CellDirection(azimuth, elevation));
+            }
+        }
+    }
+    if (reachedDirections.empty()) {
+        errorMessage = "no direction reached";
+        return false;
+    }
+    m_angles.resize(m_nb_azimuth * m_nb_elevation);
+    for (size_t azimuth = 0; azimuth < m_nb_azimuth; ++azimuth) {
+        for (size_t elevation = 0; elevation < m_nb_elevation; ++elevation) {
+            const size_t cell = azimuth * m_nb_elevation + elevation;
+            if (reached[cell]) {
+                m_angles[cell] = 0.0f;
+                continue;
+            }
+            const vct3 direction = CellDirection(azimuth, elevation);
+            double maxDot = -1.0;
+            for (const auto & other : reachedDirections) {
+                maxDot = std::max(maxDot, direction.DotProduct(other));
+            }
+            const double angle = std::acos(std::min(1.0, maxDot)) - 2.0 * resolution;
+            m_angles[cell] = static_cast<float>(std::max(0.0, angle));
+        }
+    }
+    return true;
+}
+
+bool robReachabilityMap::Reachable(const vct3 & position) const
+{
+    if (m_angles.empty()) {
+        return true;
+    }
+    // from base frame to RCM frame
+    vct3 local;
+    m_base_inverse.ApplyTo(position, local);
+    const double radius = local.Norm();
+    if ((radius > (m_radius_max + m_wrist_reach))
+        || (radius < (m_radius_min - m_wrist_reach))) {
+        return false;
+    }
+    if (radius <= m_wrist_reach) {
+        return true;
+    }
+    // distance from position to the cone of possible wrist centers
+    const double angle = m_angles[Cell(local / radius)];
+    const double distance = (angle < cmnPI_2) ? radius * std::sin(angle) : radius;
+    return (distance <= m_wrist_reach);
+}
+
+size_t robReachabilityMap::Cell(const vct3 & direction) const
+{
+    const double azimuth = std::atan2(direction.Y(), direction.X()) + cmnPI;
+    const double elevation = std::asin(std::max(-1.0, std::min(1.0, direction.Z()))) + cmnPI_2;
+    const size_t indexAzimuth = std::min(static_cast<size_t>(azimuth / m_resolution), m_nb_azimuth - 1);
+    const size_t indexElevation = std::min(static_cast<size_t>(elevation / m_resolution), m_nb_elevation - 1);
+    return indexAzimuth * m_nb_elevation + indexElevation;
+}
+
+vct3 robReachabilityMap::CellDirection(const size_t azimuth, const size_t elevation) const
+{
+    const double a = (azimuth + 0.5) * m_resolution - cmnPI;
+    const double e = std::min((elevation + 0.5) * m_resolution, cmnPI) - cmnPI_2;
+    return vct3(std::cos(e) * std::cos(a),
+                std::cos(e) * std::sin(a),
+                std::sin(e));
+}
@@ -0,0 +1,168 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-08
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#include <cmath>
+
+#include <sawIntuitiveResearchKit/robWrenchEstimator.h>
+
+robWrenchEstimator::robWrenchEstimator(void):
+    mMethod(SVD),
+    mDamping(1e-9),
+    mNumberOfJoints(0)
+{
+}
+
+void robWrenchEstimator::Configure(const size_t numberOfJoints)
+{
+    mNumberOfJoints = numberOfJoints;
+    mJacobianTranspose.SetSize(numberOfJoints, 6);
+    mPInverseData.Allocate(mJacobianTranspose);
+}
+
+bool robWrenchEstimator::EstimateBody(const vctDoubleMat & bodyJacobian,
+                                      const vctDoubleVec & effort,
+                                      vctDoubleVec & bodyWrench)
+{
+    const size_t nbJoints = mNumberOfJoints;
+    CMN_ASSERT(bodyJacobian.rows() == 6);
+    CMN_ASSERT(bodyJacobian.cols() == nbJoints);
+    CMN_ASSERT(effort.size() == nbJoints);
+    CMN_ASSERT(bodyWrench.size() == 6);
+
+    if (mMethod == SVD) {
+        mJacobianTranspose.Assign(bodyJacobian.Transpose());
+        nmrPInverse(mJacobianTranspose, mPInverseData);
+        bodyWrench.ProductOf(mPInverseData.PInverse(), effort);
+        return true;
+    }
+
+    // damped least squares
+    if (nbJoints >= 6) {
+        // w = (J J^T + d I)^-1 J tau, 6x6 system
+        for (size_t r = 0; r < 6; ++r) {
+            for (size_t c = 0; c <= r; ++c) {
+                double sum = 0.0;
+                for (size_t k = 0; k < nbJoints; ++k) {
+                    sum += bodyJacobian.Element(r, k) * bodyJacobian.Element(c, k);
+                }
+                mNormal.Element(r, c) = sum;
+            }
+            mNormal.Element(r, r) += mDamping;
+            double sum = 0.0;
+            for (size_t k = 0; k < nbJoints; ++k) {
+                sum += bodyJacobian.Element(r, k) * effort.Element(k);
+            }
+            mRhs.Element(r) = sum;
+        }
+        if (!Cholesky(6)) {
+            bodyWrench.SetAll(0.0);
+            return false;
+        }
+        CholeskySolve(6);
+        for (size_t r = 0; r < 6; ++r) {
+            bodyWrench.Element(r) = mRhs.Element(r);
+        }
+        return true;
+    }
+
+    // less than 6 joints, w = J (J^T J + d I)^-1 tau, NxN system
+    for (size_t r = 0; r < nbJoints; ++r) {
+        for (size_t c = 0; c <= r; ++c) {
+            double sum = 0.0;
+            for (size_t k = 0; k < 6; ++k) {
+                sum += bodyJacobian.Element(k, r) * bodyJacobian.Element(k, c);
+            }
+            mNormal.Element(r, c) = sum;
+        }
+        mNormal.Element(r, r) += mDamping;
+        mRhs.Element(r) = effort.Element(r);
+    }
+    if (!Cholesky(nbJoints)) {
+        bodyWrench.SetAll(0.0);
+        return false;
+    }
+    CholeskySolve(nbJoints);
+    for (size_t r = 0; r < 6; ++r) {
+        double sum = 0.0;
+        for (size_t k = 0; k < nbJoints; ++k) {
+            sum += bodyJacobian.Element(r, k) * mRhs.Element(k);
+        }
+        bodyWrench.Element(r) = sum;
+    }
+    return true;
+}
+
+void robWrenchEstimator::BodyToSpatial(const vctMatRot3 & rotation,
+                                       const vctDoubleVec & bodyWrench,
+                                       vctDoubleVec & spatialWrench)
+{
+    CMN_ASSERT(bodyWrench.size() == 6);
+    CMN_ASSERT(spatialWrench.size() == 6);
+    vct3 body, spatial;
+    // force
+    body.Assign(bodyWrench.Ref(3, 0));
+    rotation.ApplyTo(body, spatial);
+    spatialWrench.Ref(3, 0).Assign(spatial);
+    // torque
+    body.Assign(bodyWrench.Ref(3, 3));
+    rotation.ApplyTo(body, spatial);
+    spatialWrench.Ref(3, 3).Assign(spatial);
+}
+
+bool robWrenchEstimator::Cholesky(const size_t size)
+{
+    for (size_t j = 0; j < size; ++j) {
+        double diagonal = mNormal.Element(j, j);
+        for (size_t k = 0; k < j; ++k) {
+            diagonal -= mNormal.Element(j, k) * mNormal.Element(j, k);
+        }
+        if (diagonal <= 0.0) {
+            return false;
+        }
+        diagonal = std::sqrt(diagonal);
+        mNormal.Element(j, j) = diagonal;
+        for (size_t i = j + 1; i < size; ++i) {
+            double sum = mNormal.Element(i, j);
+            for (size_t k = 0; k < j; ++k) {
+                sum -= mNormal.Element(i, k) * mNormal.Element(j, k);
+            }
+            mNormal.Element(i, j) = sum / diagonal;
+        }
+    }
+    return true;
+}
+
+void robWrenchEstimator::CholeskySolve(const size_t size)
+{
+    // forward substitution, L y = b
+    for (size_t i = 0; i < size; ++i) {
+        double sum = mRhs.Element(i);
+        for (size_t k = 0; k < i; ++k) {
+            sum -= mNormal.Element(i, k) * mRhs.Element(k);
+        }
+        mRhs.Element(i) = sum / mNormal.Element(i, i);
+    }
+    // backward substitution, L^T x = y
+    for (size_t i = size; i-- > 0; ) {
+        double sum = mRhs.Element(i);
+        for (size_t k = i + 1; k < size; ++k) {
+            sum -= mNormal.Element(k, i) * mRhs.Element(k);
+        }
+        mRhs.Element(i) = sum / mNormal.Element(i, i);
+    }
+}
@@ -46,6 +46,15 @@ namespace mtsIntuitiveResearchKit {
         const double ratio_a = 1.0;
     }
 
+    // default number of waypoints for move_jp_queue and move_cp_queue
+    const size_t TrajectoryQueueSize = 256;
+
+    // state tables, default size for the arm jacobians is the same as
+    // the main state table.  Readers need a few slots to get
+    // consistent values while the table advances
+    const size_t JacobianStateTableSize = 256;
+    const size_t MinimumStateTableSize = 4;
+
     // PSM constants
     namespace PSM {
         // distance in joint space for insertion
@@ -69,6 +78,13 @@ namespace mtsIntuitiveResearchKit {
         const double EffortMax = 0.4;
     }
 
+    namespace MTMOrientationLock {
+        // above this orientation error, use full inverse kinematics
+        const double IncrementalMaxError = 2.0 * cmnPI_180; // in radians
+        // wrist close to singular, use full inverse kinematics
+        const double IncrementalMinDeterminant = 0.05;
+    }
+
     // teleoperation constants
     namespace TeleOperationPSM {
         const double Scale = 0.2;
@@ -19,7 +19,12 @@ http://www.cisst.org/cisst/license.txt.
 #ifndef _mtsIntuitiveResearchKitArm_h
 #define _mtsIntuitiveResearchKitArm_h
 
-#include <cisstNumerical/nmrPInverse.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <cisstOSAbstraction/osaMutex.h>
+#include <cisstOSAbstraction/osaGetTime.h>
 
 #include <cisstMultiTask/mtsTaskPeriodic.h>
 #include <cisstParameterTypes/prmOperatingState.h>
@@ -42,6 +47,16 @@ http://www.cisst.org/cisst/license.txt.
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKit.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
 #include <sawIntuitiveResearchKit/mtsStateMachine.h>
+#include <sawIntuitiveResearchKit/mtsLatestCommand.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitFlightRecorder.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitMessages.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitCalibrationSnapshot.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRealTime.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitHealth.h>
+#include <sawIntuitiveResearchKit/robManipulatorEvaluator.h>
+#include <sawIntuitiveResearchKit/robWrenchEstimator.h>
+#include <sawIntuitiveResearchKit/robCartesianTrajectory.h>
+#include <sawIntuitiveResearchKit/robJointFilter.h>
 
 // forward declarations
 class osaCartesianImpedanceController;
@@ -49,6 +64,8 @@ class osaCartesianImpedanceController;
 // Always include last
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
 
+class mtsIntuitiveResearchKitRecorderChannel;
+
 class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
 {
     CMN_DECLARE_SERVICES(CMN_NO_DYNAMIC_CREATION, CMN_LOG_ALLOW_DEFAULT);
@@ -70,11 +87,72 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
         m_calibration_mode = mode;
     }
 
+    /*! By default Configure exits on errors.  If false, errors are
+      only logged and ConfigurationFailed returns true, used by the
+      console to configure arms from other threads. */
+    inline void SetExitOnConfigurationFailure(const bool exitOnFailure) {
+        m_exit_on_configuration_failure = exitOnFailure;
+    }
+
+    inline bool ConfigurationFailed(void) const {
+        return m_configuration_failed;
+    }
+
+    /*! Real-time settings (priority, CPU affinity...) applied to the
+      component's thread in Startup.  Must be called before the
+      component is started. */
+    inline void SetRealTime(const mtsIntuitiveResearchKitRealTime & realTime) {
+        m_real_time = realTime;
+    }
+
+    /*! Period used for computations (flight recorder, timing...) when
+      the arm doesn't have its own thread, i.e. created with a period
+      of 0 and triggered by the IO's ExecOut.  Ignored otherwise. */
+    inline void SetChainedPeriod(const double period) {
+        // keep default so ExpectedPeriod never returns 0
+        if (period > 0.0) {
+            m_chained_period = period;
+        }
+    }
+
+    /*! Period of the arm's thread or chained period if the arm
+      doesn't have its own thread. */
+    inline double ExpectedPeriod(void) const {
+        const double period = this->GetPeriodicity();
+        return (period > 0.0) ? period : m_chained_period;
+    }
+
+    /*! Save data in a recorder channel at the end of each Run, see
+      mtsIntuitiveResearchKitRecorder.  The channel is not owned by
+      the arm and must be set before the arm is started. */
+    inline void SetRecorderChannel(mtsIntuitiveResearchKitRecorderChannel * channel) {
+        m_recorder_channel = channel;
+    }
+
+    /*! Configure the flight recorder, history of the last few
+      seconds saved to a file when the arm faults.  Duration in
+      seconds, 0 to disable.  Must be called before the arm is
+      started. */
+    inline void SetFlightRecorder(const double duration, const std::string & directory) {
+        m_flight_recorder.duration = duration;
+        m_flight_recorder.directory = directory;
+    }
+
  protected:
 
     /*! Define wrench reference frame */
     typedef enum {WRENCH_UNDEFINED, WRENCH_SPATIAL, WRENCH_BODY} WrenchType;
 
+    /*! Used by all methods called from Configure instead of exit,
+      the error must be logged before.  Configure then exits or sets
+      ConfigurationFailed, see SetExitOnConfigurationFailure. */
+    struct ConfigurationError {};
+    inline void ConfigurationFailure(void) const {
+        throw ConfigurationError();
+    }
+    bool m_exit_on_configuration_failure = true;
+    bool m_configuration_failed = false;
+
     /*! Load m_base_frame and DH parameters from JSON */
     void ConfigureDH(const Json::Value & jsonConfig, const std::string & filename);
     void ConfigureDH(const std::string & filename);
@@ -93,7 +171,8 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
     virtual void CreateManipulator(void);
     virtual void Init(void);
 
-    void UpdateConfigurationJointKinematic(void);
+    /*! Prepare and swap in data sized using the current
+      Manipulator, see KinematicsDataType. */
     void ResizeKinematicsData(void);
 
     /*! Verify that the state transition is possible, initialize
@@ -139,6 +218,16 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
     virtual void SetGoalHomingArm(void) = 0;
     virtual void RunHoming(void);
 
+    /*! Calibration snapshot, see "calibration-snapshot".  Save is
+      called each time the arm enters HOMED, Restore when a snapshot
+      has been validated.  Derived classes can use extra to store
+      their own homing steps (e.g. PSM adapter and tool engaged). */
+    void CalibrationSnapshotSave(void);
+    void CalibrationSnapshotUpdate(void);
+    bool CalibrationSnapshotValidate(void);
+    inline virtual void CalibrationSnapshotExtra(Json::Value & CMN_UNUSED(extra)) const {};
+    inline virtual void CalibrationSnapshotRestore(const Json::Value & CMN_UNUSED(extra)) {};
+
     // transitions to state HOMED are defined
     // in derived classes.
 
@@ -160,8 +249,56 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
     // state table for configuration parameters
     mtsStateTable mStateTableConfiguration;
 
+    // state table for jacobians, size can be reduced if history is
+    // not needed (see "state-tables")
+    mtsStateTable mStateTableJacobian;
+
+    /*! Add data to a state table and keep track of it for the
+      memory report (see state_tables_memory).  Should be used
+      instead of mtsStateTable::AddData for the arm's tables. */
+    template <typename _elementType>
+    inline void AddStateData(mtsStateTable & table, _elementType & data, const std::string & name) {
+        table.AddData(data, name);
+        m_state_tables_memory.push_back({&table, name,
+                                         [&data]() {return cmnData<_elementType>::SerializeBinaryByteSize(data);}});
+    }
+    inline void AddStateData(mtsStateTable & table, mtsStdString & data, const std::string & name) {
+        table.AddData(data, name);
+        m_state_tables_memory.push_back({&table, name,
+                                         [&data]() {return sizeof(data) + data.Data.size();}});
+    }
+
+    /*! Approximate memory used by the arm's state tables, history
+      length times the size of each row, using current sizes for
+      dynamic data (e.g. joint vectors, jacobians). */
+    struct StateTableDataType {
+        const mtsStateTable * table;
+        std::string name;
+        std::function<size_t(void)> size;
+    };
+    std::vector<StateTableDataType> m_state_tables_memory;
+    void state_tables_memory(std::string & report) const;
+
     /*! Wrapper to convert vector of joint values to prmPositionJointSet and send to PID */
     virtual void servo_jp_internal(const vctDoubleVec & newPosition);
+
+    /*! Predictive joint limit guard, see "limit-guard".  Applied on
+      the PID goal before it is sent, only in state HOMED.  For each
+      joint moving toward a limit, the largest step that still allows
+      to stop before the limit using the deceleration is computed and
+      the whole step is scaled down so the direction is preserved.
+      Joints already past a limit can't move further out. */
+    void LimitGuard(vctDoubleVec & goal);
+    void LimitGuardActivate(const bool active);
+    struct {
+        bool enabled = false;
+        bool active = false;
+        double margin = 0.0;
+        vctDoubleVec deceleration; // empty to use joint trajectory acceleration
+        vctDoubleVec lower, upper, decelerationUsed;
+        size_t scaled = 0;
+        double time_last_message = 0.0;
+    } m_limit_guard;
     virtual void servo_jf_internal(const vctDoubleVec & newEffort);
     inline virtual void update_feed_forward(vctDoubleVec & CMN_UNUSED(feedForward)) {};
 
@@ -174,6 +311,9 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
     virtual void servo_cp(const prmPositionCartesianSet & newPosition);
     virtual void servo_cr(const prmPositionCartesianSet & difference);
     virtual void move_cp(const prmPositionCartesianSet & newPosition);
+    virtual void move_jp_queue(const prmPositionJointSet & newPosition);
+    virtual void move_cp_queue(const prmPositionCartesianSet & newPosition);
+    virtual void trajectory_queue_clear(void);
     virtual void servo_jf(const prmForceTorqueJointSet & newEffort);
     virtual void spatial_servo_cf(const prmForceCartesianSet & newForce);
     virtual void body_servo_cf(const prmForceCartesianSet & newForce);
@@ -237,10 +377,10 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
       tool or endoscope is away from the RCM point. */
     virtual bool IsSafeForCartesianControl(void) const = 0;
 
-    /*! Counter to total number of consecutive times the user is
-      trying to switch to cartesian control space when it's not
-      safe.  Used to throttle error messages. */
-    size_t mSafeForCartesianControlCounter;
+    /*! Time of last message sent when the user is trying to switch
+      to cartesian control space when it's not safe.  Used to throttle
+      messages in time so it doesn't depend on the arm's period. */
+    double mSafeForCartesianControlTimeLastMessage;
 
     // Interface to PID component
     mtsInterfaceRequired * PIDInterface;
@@ -278,6 +418,8 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
         mtsFunctionWrite UsePotsForSafetyCheck;
         mtsFunctionVoid  BrakeRelease;
         mtsFunctionVoid  BrakeEngage;
+        mtsFunctionRead  measured_js; // actuator encoders, optional
+        mtsFunctionRead  GetAnalogInputPosSI; // actuator pots, optional
     } IO;
 
     // Main provided interface
@@ -292,10 +434,101 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
 
     robManipulator * Manipulator;
     std::string mConfigurationFile;
+    // parsed content of mConfigurationFile for tool changes
+    Json::Value mConfigurationDH;
 
     // cache cartesian goal position and increment
     bool m_new_pid_goal;
     prmPositionCartesianSet CartesianSetParam;
+
+    /*! End-to-end latency of servo_cp, i.e. time between the servo_cp
+      goal timestamp (set by the sender, teleoperation uses the MTM
+      measured_cp timestamp) and the joint setpoint sent to the PID.
+      Last, average and max in seconds.  Samples without timestamp or
+      from a different time base (negative or over 1 second) are
+      ignored. */
+    vct3 m_servo_cp_latency;
+    size_t m_servo_cp_latency_samples;
+    void ServoCpLatencyUpdate(void);
+
+    /*! Servo commands are not queued, the provided interface stores
+      the latest value (latest wins) and ServoCommandsProcess applies
+      them once per Run, after ExecOut and after the queued commands
+      so they're never applied before a command queued earlier in the
+      same period (e.g. move or state change).  When a client streams faster
+      than the arm's period, superseded commands are skipped instead
+      of going through ArmIsReady, SetControlSpaceAndMode...  The
+      sequence preserves the order between different servo
+      commands.  Relative commands (servo_jr, servo_cr) are still
+      queued since they can't be merged. */
+    enum ServoCommandIndex {
+        SERVO_JP = 0,
+        SERVO_CP,
+        SERVO_JF,
+        BODY_SERVO_CF,
+        SPATIAL_SERVO_CF,
+        SERVO_NUMBER_OF_COMMANDS
+    };
+    struct {
+        std::atomic<size_t> sequence;
+        mtsLatestCommand<prmPositionJointSet> servo_jp;
+        mtsLatestCommand<prmPositionCartesianSet> servo_cp;
+        mtsLatestCommand<prmForceTorqueJointSet> servo_jf;
+        mtsLatestCommand<prmForceCartesianSet> body_servo_cf;
+        mtsLatestCommand<prmForceCartesianSet> spatial_servo_cf;
+    } m_servo_commands;
+    void servo_jp_latest(const prmPositionJointSet & newPosition);
+    void servo_cp_latest(const prmPositionCartesianSet & newPosition);
+    void servo_jf_latest(const prmForceTorqueJointSet & newEffort);
+    void body_servo_cf_latest(const prmForceCartesianSet & newForce);
+    void spatial_servo_cf_latest(const prmForceCartesianSet & newForce);
+    void ServoCommandsProcess(void);
+    void servo_statistics(mtsIntuitiveResearchKitServoStatistics & statistics) const;
+    void servo_statistics_reset(void);
+
+    /*! Optional recorder, see SetRecorderChannel */
+    mtsIntuitiveResearchKitRecorderChannel * m_recorder_channel = nullptr;
+    void RecorderPush(void);
+
+    /*! Flight recorder, see SetFlightRecorder.  Commands is a bit
+      mask of commands received during the current period. */
+    struct {
+        mtsIntuitiveResearchKitFlightRecorder history;
+        double duration = 5.0 * cmn_s;
+        std::string directory;
+        unsigned int commands = 0;
+    } m_flight_recorder;
+    enum {FLIGHT_SERVO_JP = 1, FLIGHT_SERVO_JF = 2, FLIGHT_SERVO_CP = 4,
+          FLIGHT_SERVO_CF = 8, FLIGHT_MOVE_JP = 16, FLIGHT_MOVE_CP = 32};
+    void FlightRecorderSample(void);
+
+    /*! Optional interpolation between consecutive servo_jp/servo_cp
+      goals for clients streaming slower than the arm.  The time
+      between two goals is computed using the command timestamps (or
+      the time they're received if not set) and the arm moves from
+      the last setpoint sent to the new goal over that duration, so
+      the motion is delayed by one client period but doesn't have
+      steps.  If two goals are more than max_interval apart, the new
+      goal is used directly. */
+    typedef enum {SERVO_INTERPOLATION_NONE,
+                  SERVO_INTERPOLATION_LINEAR,
+                  SERVO_INTERPOLATION_MINIMUM_JERK} ServoInterpolationType;
+    struct {
+        ServoInterpolationType type = SERVO_INTERPOLATION_NONE;
+        double max_interval = 0.05 * cmn_s;
+        bool new_goal = false;
+        double goal_time = 0.0;
+        // current segment
+        bool active = false;
+        double previous_goal_time = 0.0;
+        double start_time = 0.0;
+        double duration = 0.0;
+        vctDoubleVec start_jp, goal_jp, jp;
+        vctFrm3 start_cp, goal_cp, cp;
+    } m_servo_interpolation;
+    /*! Start new segment if there's a new goal and returns the
+      ratio (between 0 and 1) for the current time. */
+    double ServoInterpolationRatio(void);
     vctFrm3 mCartesianRelative;
 
     // internal kinematics
@@ -319,18 +552,266 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
     prmConfigurationJoint m_pid_configuration_js, m_kin_configuration_js;
 
     // efforts
-    vctDoubleMat m_body_jacobian, m_body_jacobian_transpose, m_spatial_jacobian, m_spatial_jacobian_transpose;
+    vctDoubleMat m_body_jacobian, m_spatial_jacobian;
     WrenchType m_cf_type;
     prmForceCartesianSet m_cf_set;
     bool m_body_cf_orientation_absolute;
-    prmForceTorqueJointSet
-        mTorqueSetParam, // number of joints PID, used in servo_jf_internal
-        mEffortJointSet; // number of joints for kinematics
-    vctDoubleVec mEffortJoint; // number of joints for kinematics, more convenient type than prmForceTorqueJointSet
-    // to estimate wrench from joint efforts
-    nmrPInverseDynamicData mJacobianPInverseData;
+    prmForceTorqueJointSet mTorqueSetParam; // number of joints PID, used in servo_jf_internal
     prmForceCartesianGet m_body_measured_cf, m_spatial_measured_cf;
 
+    /*! Wrench estimation from joint efforts.  By default the wrench
+      is computed in GetRobotData (eager) and read from the state
+      table.  In lazy mode, the arm only publishes the jacobian and
+      efforts (lock free, see mtsLatestCommand) and the wrench is
+      computed by the first read of body/measured_cf or
+      spatial/measured_cf after each update, in the caller's thread.
+      The mutex is used between readers, the arm's thread only takes
+      it to swap the estimator and buffers (SwapKinematicsData), never
+      when publishing.  In lazy mode, the wrench saved in the state
+      table is not valid. */
+    struct WrenchInputs {
+        vctDoubleMat jacobian;
+        vctDoubleVec effort;
+        vctMatRot3 rotation_local, rotation;
+        double timestamp = 0.0;
+        bool valid = false;
+    };
+    mutable struct {
+        // from configuration file, applied to each new estimator
+        robWrenchEstimator::MethodType method = robWrenchEstimator::SVD;
+        double damping = 1e-9; // same as robWrenchEstimator
+        bool lazy = false;
+        bool published_valid = false;
+        // lazy readers, also held to swap m_kinematics
+        osaMutex readers_mutex;
+        // outputs
+        vctDoubleVec wrench, spatial_wrench; // 6
+        prmForceCartesianGet body_cf, spatial_cf;
+        mtsStateTable::Accessor<prmForceCartesianGet> * body_cf_accessor = nullptr;
+        mtsStateTable::Accessor<prmForceCartesianGet> * spatial_cf_accessor = nullptr;
+    } m_wrench_estimation;
+
+    /*! Data sized using the number of joints of the kinematic chain,
+      or configured for a given manipulator.  PrepareKinematicsData
+      doesn't modify the arm so it can be called from any thread
+      (e.g. PSM tool change), SwapKinematicsData then swaps pointers
+      in the control thread.  Jacobians and configuration_js are
+      registered in state tables so they stay arm members and are
+      only resized/assigned by SwapKinematicsData. */
+    struct KinematicsDataType {
+        size_t number_of_joints = 0;
+        prmConfigurationJoint configuration_js; // names and types converted
+        // forward kinematics and jacobians computed in a single pass
+        robManipulatorEvaluator evaluator;
+        robWrenchEstimator estimator;
+        // filled by GetRobotData, arm's thread only
+        WrenchInputs wrench_staging;
+        // lazy mode, latest inputs for readers
+        mtsLatestCommand<WrenchInputs> wrench_latest;
+        prmForceTorqueJointSet effort_set; // servo_jf
+        vctDoubleVec effort; // more convenient type than prmForceTorqueJointSet
+        vctDoubleVec effort_preload; // control_servo_cf
+    } * m_kinematics = nullptr;
+
+    /*! Not real-time safe, manipulator is not const as the fixed size
+      kinematics (if any) are configured here. */
+    void PrepareKinematicsData(robManipulator & manipulator,
+                               const size_t numberOfJoints,
+                               KinematicsDataType & data) const;
+    /*! data then holds the previous kinematics data. */
+    void SwapKinematicsData(KinematicsDataType * & data);
+
+    /*! Estimate body and spatial wrench from inputs, results are
+      saved in m_wrench_estimation body_cf and spatial_cf. */
+    void EstimateWrench(const WrenchInputs & inputs) const;
+    /*! Let lazy readers know the inputs are not valid anymore. */
+    void WrenchInputsInvalidate(void);
+    void body_measured_cf(prmForceCartesianGet & wrench) const;
+    void spatial_measured_cf(prmForceCartesianGet & wrench) const;
+
+    /*! Demand driven computation of derived state.  When enabled,
+      GetRobotData only computes setpoint_cp (and local), measured_cv,
+      jacobians and wrenches if they've been read recently (see
+      timeout) or if the current control mode needs them (cartesian
+      effort or user defined).  These quantities are published using
+      read commands that save the time of the last request before
+      reading the latest value from the state table.  Note that the
+      first read after a period of inactivity might return an invalid
+      value and that data collection on the state table doesn't count
+      as a request. */
+    mutable struct {
+        bool demand_driven = false;
+        double timeout = 1.0 * cmn_s;
+        // time of last request, set from the caller's thread
+        std::atomic<double> setpoint_cp{0.0};
+        std::atomic<double> measured_cv{0.0};
+        std::atomic<double> jacobian{0.0};
+        std::atomic<double> measured_cf{0.0};
+        // state table accessors to read latest values
+        mtsStateTable::Accessor<prmPositionCartesianGet> * local_setpoint_cp_accessor = nullptr;
+        mtsStateTable::Accessor<prmPositionCartesianGet> * setpoint_cp_accessor = nullptr;
+        mtsStateTable::Accessor<prmVelocityCartesianGet> * measured_cv_accessor = nullptr;
+        mtsStateTable::Accessor<vctDoubleMat> * body_jacobian_accessor = nullptr;
+        mtsStateTable::Accessor<vctDoubleMat> * spatial_jacobian_accessor = nullptr;
+    } m_derived_state;
+
+    bool DerivedStateNeeded(const std::atomic<double> & lastRequest) const;
+    void DerivedStateRequest(std::atomic<double> & lastRequest) const;
+    void local_setpoint_cp(prmPositionCartesianGet & pose) const;
+    void setpoint_cp(prmPositionCartesianGet & pose) const;
+    void measured_cv(prmVelocityCartesianGet & velocity) const;
+    void body_jacobian(vctDoubleMat & jacobian) const;
+    void spatial_jacobian(vctDoubleMat & jacobian) const;
+    void body_cf_orientation_absolute(bool & absolute) const;
+
+    /*! Compute setpoint_cp and local/setpoint_cp from kinematics
+      setpoint_js.  Called by GetRobotData when needed, derived
+      classes should call it before using m_setpoint_cp if the
+      derived state is demand driven. */
+    void UpdateSetpointCartesian(void);
+
+    /*! Per stage timing of Run.  Stages are exclusive (e.g. time
+      spent in GetRobotData is not counted in state machine) and
+      measured with osaGetTime.  Statistics are accumulated in fixed
+      size containers in Run and copied to a snapshot at most every
+      publish_interval so the read command timing_statistics doesn't
+      access data used by the control loop. */
+    enum TimingStage {
+        TIMING_EVENTS = 0,
+        TIMING_ROBOT_DATA,
+        TIMING_STATE_MACHINE,
+        TIMING_CONTROL,
+        TIMING_SERVO_CF,
+        TIMING_PID,
+        TIMING_COMMANDS,
+        TIMING_TOTAL,
+        TIMING_NUMBER_OF_STAGES
+    };
+    enum {TIMING_NUMBER_OF_BUCKETS = 8};
+    typedef vctFixedSizeVector<double, TIMING_NUMBER_OF_STAGES> TimingStagesType;
+
+    mutable struct {
+        bool enabled = true;
+        double publish_interval = 0.5 * cmn_s;
+        double last_publish = 0.0;
+        bool reset_requested = false;
+        // fraction of period for histogram bucket upper bounds
+        double bucket_ratios[TIMING_NUMBER_OF_BUCKETS - 1] = {0.25, 0.5, 0.75, 1.0, 1.25, 1.5, 2.0};
+        // current iteration, time is charged to the active stage
+        // everytime the stage changes
+        TimingStagesType current;
+        double start = 0.0, mark = 0.0;
+        TimingStage active = TIMING_EVENTS;
+        TimingStage stack[TIMING_NUMBER_OF_STAGES];
+        size_t depth = 0;
+        // accumulated
+        size_t iterations = 0;
+        size_t deadline_misses = 0;
+        TimingStagesType sum, max;
+        vctFixedSizeVector<size_t, TIMING_NUMBER_OF_BUCKETS> histogram;
+        // copy for read command
+        osaMutex mutex;
+        mtsIntuitiveResearchKitArmTiming snapshot;
+    } m_timing;
+
+    void TimingInit(void);
+    void TimingReset(void);
+    void TimingEnd(void);
+    void TimingPublish(const double now);
+    /*! Charge elapsed time to active stage and switch to stage */
+    inline void TimingSwitch(const TimingStage stage) {
+        if (m_timing.enabled) {
+            const double now = osaGetTime();
+            m_timing.current[m_timing.active] += now - m_timing.mark;
+            m_timing.mark = now;
+            m_timing.active = stage;
+        }
+    }
+    /*! Nested stage, must be followed by TimingExit */
+    inline void TimingEnter(const TimingStage stage) {
+        if (m_timing.enabled && (m_timing.depth < TIMING_NUMBER_OF_STAGES)) {
+            m_timing.stack[m_timing.depth] = m_timing.active;
+            ++m_timing.depth;
+            TimingSwitch(stage);
+        }
+    }
+    inline void TimingExit(void) {
+        if (m_timing.enabled && (m_timing.depth > 0)) {
+            --m_timing.depth;
+            TimingSwitch(m_timing.stack[m_timing.depth]);
+        }
+    }
+    void timing_statistics(mtsIntuitiveResearchKitArmTiming & timing) const;
+    void timing_statistics_reset(void);
+
+    /*! Copy of all data displayed by the arm widgets so the GUI
+      can refresh with a single read.  The snapshot is only updated
+      by Run if it has been read since the last update, at most every
+      publish_interval, so there's no cost when no widget is used. */
+    mutable struct {
+        std::atomic<bool> requested{false};
+        double publish_interval = 20.0 * cmn_ms;
+        double last_publish = 0.0;
+        osaMutex mutex;
+        mtsIntuitiveResearchKitArmSnapshot data;
+        // every sample between snapshots for plots, ring buffer
+        // preallocated in Init and only used by Run
+        size_t plot_head = 0;
+        size_t plot_count = 0;
+        vctDoubleVec plot_time;
+        vctDoubleVec plot_tool_effort;
+    } m_gui_snapshot;
+
+    void GUISnapshotPublish(const double now);
+    /*! For derived classes, data specific to the arm (e.g. jaw).
+      Called by Run, data is already locked. */
+    inline virtual void GUISnapshotDerived(mtsIntuitiveResearchKitArmSnapshot & CMN_UNUSED(snapshot)) {};
+    /*! Add a sample to the plot buffer, only while widgets read the snapshot */
+    void GUIPlotSample(const double now);
+    /*! For derived classes, effort plotted by the widget at full
+      rate.  Returns false if the arm has nothing to plot. */
+    inline virtual bool GUIPlotToolEffort(double & CMN_UNUSED(effort)) const {
+        return false;
+    }
+    void gui_snapshot(mtsIntuitiveResearchKitArmSnapshot & snapshot) const;
+
+    /*! Single read for bridges (ROS, Python...) instead of separate
+      reads for measured_js, setpoint_js, measured_cp, setpoint_cp,
+      measured_cv, body/measured_cf and operating_state.  All values
+      from StateTable are read at the same index so they are coherent
+      in time.  The operating state comes from its own state table
+      (latest).  Like the individual reads, this counts as a request
+      for demand driven derived state. */
+    struct {
+        mtsStateTable::Accessor<prmStateJoint> * measured_js_accessor = nullptr;
+        mtsStateTable::Accessor<prmStateJoint> * setpoint_js_accessor = nullptr;
+        mtsStateTable::Accessor<prmPositionCartesianGet> * measured_cp_accessor = nullptr;
+        mtsStateTable::Accessor<prmForceCartesianGet> * body_measured_cf_accessor = nullptr;
+        mtsStateTable::Accessor<prmOperatingState> * operating_state_accessor = nullptr;
+    } m_measured_bundle;
+    void measured_bundle(mtsIntuitiveResearchKitArmMeasured & bundle) const;
+
+    /*! Preallocated buffers used by GetRobotData so the control loop
+      doesn't allocate any memory.  Sized in ResizeKinematicsData. */
+    struct {
+        vctBoolVec actuator_amp_status;
+        vctBoolVec brake_amp_status;
+        vctDoubleVec cartesian_velocity; // 6
+        // debug builds only, number of cycles during which at least
+        // one buffer's data pointer changed (i.e. it was resized)
+        size_t moved_buffers = 0;
+        std::vector<const void *> pointers;
+    } m_robot_data_buffers;
+
+    /*! Save pointers to preallocated buffers, in debug builds
+      GetRobotData checks that these pointers don't change.  This only
+      detects buffers that have been resized, temporaries allocated
+      and freed during the cycle are not detected and allocations are
+      not counted, see the allocation counter in
+      tests/mainBenchmarks.cpp for this. */
+    void SaveRobotDataBuffersPointers(void);
+    void CheckRobotDataBuffersPointers(void);
+
     // cartesian impendance controller
     osaCartesianImpedanceController * mCartesianImpedanceController;
     bool m_cartesian_impedance;
@@ -349,9 +830,15 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
     prmVelocityCartesianGet m_measured_cv;
     vctFrm4x4 CartesianPositionFrm;
 
+    mtsIntuitiveResearchKitRealTime m_real_time;
+    mtsIntuitiveResearchKitHeartbeat m_heartbeat;
+    double m_chained_period = mtsIntuitiveResearchKit::IOPeriod;
+
     // Base frame
     vctFrm4x4 m_base_frame;
     bool m_base_frame_valid;
+    // last goal received by set_base_frame, before normalization
+    vctFrm3 m_base_frame_goal;
 
     bool m_powered = false;
 
@@ -364,6 +851,15 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
     size_t mArmNotReadyCounter;
     double mArmNotReadyTimeLastMessage;
 
+    /*! Rate limited messages for sites that can fire every cycle,
+      sites are registered in Init and messages are sent at the end
+      of Run, see mtsIntuitiveResearchKitMessages. */
+    mtsIntuitiveResearchKitMessages m_messages;
+    struct {
+        size_t servo_cp_ik;
+        size_t joint_filter_budget;
+    } m_message_sites;
+
     /*! Set joint velocity ratio for trajectory generation.  Computes
       joint velocities based on maximum joint velocities.  Ratio must
       be greater than 0 and lesser or equal to 1. */
@@ -389,6 +885,14 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
       needs to be called every time the ratios are changed. */
     virtual void trajectory_j_update_reflexxes(void);
 
+    /*! Make sure Reflexxes is configured before starting a
+      trajectory.  Reflexxes is only reconfigured if the nominal
+      period changed since the last call to
+      trajectory_j_update_reflexxes, the current position and velocity
+      are provided at each evaluation so a new goal doesn't require
+      any allocation and keeps the current velocity. */
+    void trajectory_j_warm_reflexxes(void);
+
     /*! Sets control space and mode.  If none are user defined, the
       callbacks will be using the methods provided in this class.
       If either the space or mode is "USER", a callback must be
@@ -455,7 +959,24 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
       methods must ensure that all elements are set properly, i.e. the
       input vector is not set to zero by default. */
     virtual void control_servo_cf_preload(vctDoubleVec & effortPreload,
-                                          vctDoubleVec & wrenchPreload);
+                                          vct6 & wrenchPreload);
+
+    /*! Preallocated buffers used by control_servo_cf so the effort
+      pipeline doesn't allocate any memory.  Sized in
+      ResizeKinematicsData. */
+    struct {
+        vct6 wrench;
+        vct6 wrench_preload;
+        // effort preload is sized by number of joints, see m_kinematics
+    } m_servo_cf_buffers;
+
+    /*! effort = jacobian^T * wrench + effortPreload, jacobian is 6xN
+      and effort must be already sized to N.  Uses a fixed size
+      implementation for 4, 6, 7 and 8 joints. */
+    static void JacobianTransposeProduct(const vctDoubleMat & jacobian,
+                                         const vct6 & wrench,
+                                         const vctDoubleVec & effortPreload,
+                                         vctDoubleVec & effort);
 
     struct {
         robReflexxes Reflexxes;
@@ -472,6 +993,8 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
         mtsFunctionWrite ratio_event;
         vctDoubleVec goal;
         vctDoubleVec goal_v;
+        vctDoubleVec goal_relative; // preallocated for move_jr
+        double reflexxes_period = 0.0; // last period sent to Reflexxes
         vctDoubleVec goal_error;
         vctDoubleVec goal_tolerance;
         vctDoubleVec jerk_max;
@@ -480,14 +1003,106 @@ class CISST_EXPORT mtsIntuitiveResearchKitArm: public mtsTaskPeriodic
         mtsFunctionWrite goal_reached_event; // sends true if goal reached, false otherwise
     } m_trajectory_j;
 
+    /*! Cartesian trajectory used by move_cp, straight line and slerp
+      with linear and angular limits, scaled by the joint trajectory
+      ratios.  Evaluated in control_move_cp, inverse kinematics is
+      warm started from the previous solution.  Uses
+      m_trajectory_j.is_active and the control_move_jp_on_start/stop
+      methods so events are the same for joint and cartesian
+      trajectories. */
+    struct {
+        robCartesianTrajectory generator;
+        double v_linear = 0.1; // m/s
+        double a_linear = 0.2;
+        double v_angular = 90.0 * cmnPI_180; // rad/s
+        double a_angular = 180.0 * cmnPI_180;
+        bool is_active = false;
+        vctFrm3 cp; // current goal in base frame
+        vctDoubleVec jp; // IK solution
+    } m_trajectory_c;
+
+    /*! Start a cartesian trajectory to goal (arm base frame), from
+      the current trajectory point and velocity if a cartesian
+      trajectory is active.  When updateBusy is false, the busy flag
+      and its event are left unchanged (used to blend waypoints). */
+    void trajectory_c_start(const vctFrm3 & goal, const bool updateBusy = true);
+
+    /*! Waypoint queue used by move_jp_queue and move_cp_queue.
+      Waypoints are stored in a preallocated ring buffer and all
+      waypoints in the queue must be in the same space.  When the
+      remaining time to the current waypoint is lower than blend_time,
+      the trajectory generator is restarted towards the next waypoint
+      from the current position and velocity so the arm doesn't stop.
+      The waypoint_reached event is sent with the index of each
+      waypoint when passed, goal_reached is only sent at the end of
+      the queue.  Any other motion command empties the queue. */
+    struct TrajectoryWaypoint {
+        vctDoubleVec jp; // joint goal, PID space
+        vctFrm3 cp; // cartesian goal, arm base frame
+    };
+    struct {
+        std::vector<TrajectoryWaypoint> waypoints;
+        size_t head = 0; // next waypoint to start
+        size_t size = 0; // number of waypoints not started yet
+        mtsIntuitiveResearchKitArmTypes::ControlSpace space;
+        bool is_active = false; // current trajectory comes from the queue
+        int index = -1; // index of current waypoint since queue started
+        double blend_time = 50.0 * cmn_ms;
+        mtsFunctionWrite waypoint_reached_event;
+    } m_trajectory_queue;
+
+    /*! Returns slot for a new waypoint or 0 if the queue is full or
+      waypoints already queued are in a different space. */
+    TrajectoryWaypoint * trajectory_queue_push(const std::string & methodName,
+                                               const mtsIntuitiveResearchKitArmTypes::ControlSpace space);
+
+    /*! Start trajectory towards next waypoint, returns false if the
+      queue is empty. */
+    bool trajectory_queue_next(void);
+
+    /*! Drop all waypoints, doesn't stop the current trajectory. */
+    void trajectory_queue_reset(void);
+
+    /*! Allocate ring buffer, called from Init and Configure. */
+    void trajectory_queue_allocate(const size_t capacity);
+
+    /*! Filters applied on the kinematic joint state in GetRobotData,
+      configured using "joint-filters".  Budget overruns are reported
+      at most once per second. */
+    robJointFilterChain m_joint_filters;
+
     // homing
     bool m_encoders_biased_from_pots = false; // encoders biased from pots
     bool m_encoders_biased = false; // encoder might have to be biased on joint limits (MTM roll)
     bool m_re_home = false; // force re-biasing encoder even if values are found on FPGA
+    mtsIntuitiveResearchKitCalibrationSnapshot m_calibration_snapshot;
+    bool m_calibration_restored = false; // homing skipped using a valid snapshot
     bool m_homing_goes_to_zero;
     bool mHomingBiasEncoderRequested;
     double mHomingTimer;
 
+    /*! Adaptive encoder bias, see "encoder-bias".  Pots are averaged
+      in the arm's thread until the standard error of the mean is
+      below tolerance for all actuators (or max samples is reached)
+      and the encoders are then set to the average.  The IO bias with
+      a single sample is still used first to check for preloads. */
+    struct {
+        bool enabled = false;
+        bool sampling = false;
+        size_t min_samples = 50;
+        size_t max_samples = 1970;
+        double revolute_tolerance = 0.05 * cmnPI_180;
+        double prismatic_tolerance = 0.05 * cmn_mm;
+        size_t nb_samples;
+        double last_timestamp;
+        vctDoubleVec mean, m2, tolerance;
+        prmStateJoint pots;
+    } m_encoder_bias;
+    void EncoderBiasStart(void);
+    /*! Add latest pots, returns true when converged or max samples
+      has been reached. */
+    bool EncoderBiasSample(void);
+
     // flag to determine if this is connected to actual IO/hardware or simulated
     bool m_simulated;
 
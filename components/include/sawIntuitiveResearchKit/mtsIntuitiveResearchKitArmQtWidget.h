@@ -34,8 +34,12 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstParameterTypes/prmPositionJointSetQtWidget.h>
 #include <cisstParameterTypes/prmOperatingStateQtWidget.h>
 
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
+
 #include <QWidget>
 
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitQtRefresh.h>
+
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitQtExport.h>
 
 class QCheckBox;
@@ -74,6 +78,7 @@ private:
     //! setup GUI
     void setupUi(void);
     int TimerPeriodInMilliseconds;
+    mtsIntuitiveResearchKitQtRefresh RefreshPolicy;
 
 protected:
     struct ArmStruct {
@@ -83,10 +88,17 @@ protected:
         mtsFunctionRead measured_cf_body;
         mtsFunctionWrite move_jp;
         mtsFunctionRead period_statistics;
+        mtsFunctionRead gui_snapshot;
         mtsEventReceiverWrite trajectory_j_ratio;
         mtsFunctionWrite trajectory_j_set_ratio;
     } Arm;
 
+    /*! All data displayed, retrieved with a single read if the arm
+      provides gui_snapshot.  Derived classes should check
+      SnapshotValid before using it. */
+    mtsIntuitiveResearchKitArmSnapshot Snapshot;
+    bool SnapshotValid = false;
+
     // so derived class has access to custom parts of widget
     QVBoxLayout * MainLayout;
     QHBoxLayout * EffortLayout;
@@ -0,0 +1,130 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitCalibrationSnapshot_h
+#define _mtsIntuitiveResearchKitCalibrationSnapshot_h
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <json/json.h>
+
+#include <cisstVector/vctDynamicVectorTypes.h>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Calibration state saved once an arm is homed so the rest of the
+  homing procedure can be skipped after a software only restart,
+  i.e. while the controllers stayed powered and the encoder preloads
+  are still valid.
+
+  The snapshot contains the controller serial number, the time it
+  was saved, the offsets between encoders and potentiometers (all in
+  actuator space) and some arm specific data (e.g. PSM adapter and
+  tool engaged).  It is only considered valid if the serial number
+  is the same, the snapshot is recent enough and the current offsets
+  between encoders and potentiometers match the saved ones.  The
+  latter detects encoders that have been re-initialized as well as
+  multi-turn potentiometers (MTM roll) when the joint moved while
+  the software was not running.
+
+  The file is saved in the directory provided in the arm
+  configuration file, with the name <arm>-calibration.json.  Files
+  are written and removed by a separate thread so the arm's thread
+  never waits for the disk, only the latest request is kept if the
+  writer is late.  Arm specific data (e.g. engaged) is only meant to
+  be used if "restore-engaged" is set. */
+class CISST_EXPORT mtsIntuitiveResearchKitCalibrationSnapshot
+{
+public:
+    mtsIntuitiveResearchKitCalibrationSnapshot(void) = default;
+    ~mtsIntuitiveResearchKitCalibrationSnapshot();
+
+    /*! Load "calibration-snapshot" from the arm configuration.
+      Snapshots are disabled unless a "directory" is provided. */
+    bool Configure(const Json::Value & jsonConfig,
+                   const std::string & armName,
+                   std::string & errorMessage);
+
+    inline bool Enabled(void) const {
+        return !m_filename.empty();
+    }
+
+    inline const std::string & Filename(void) const {
+        return m_filename;
+    }
+
+    /*! Opt-in to restore arm specific state (e.g. PSM adapter and
+      tool engaged), false by default so engagement is never skipped
+      based on files. */
+    inline bool RestoreEngaged(void) const {
+        return m_restore_engaged;
+    }
+
+    /*! Save the snapshot in the background, file is first written
+      with a temporary name then renamed so a crash never leaves a
+      partial file.  Returns false if the data is invalid, write
+      errors are logged by the writer thread. */
+    bool Save(const std::string & serialNumber,
+              const vctDoubleVec & encoders,
+              const vctDoubleVec & potentiometers,
+              const Json::Value & extra,
+              std::string & errorMessage);
+
+    /*! Check if the saved snapshot matches the current encoders and
+      potentiometers.  Prismatic flags are used to select tolerances
+      per actuator, if empty all actuators are considered revolute.
+      Arm specific data is returned in extra if valid. */
+    bool Validate(const std::string & serialNumber,
+                  const vctDoubleVec & encoders,
+                  const vctDoubleVec & potentiometers,
+                  const vctBoolVec & prismatic,
+                  Json::Value & extra,
+                  std::string & errorMessage) const;
+
+    /*! Remove the snapshot file in the background, used when the
+      arm is un-homed so further restarts perform a full homing. */
+    void Invalidate(void);
+
+protected:
+    typedef enum {REQUEST_NONE, REQUEST_SAVE, REQUEST_REMOVE} RequestType;
+
+    void Request(const RequestType type, const Json::Value & snapshot);
+    void WriterThread(void);
+    bool Write(const Json::Value & snapshot, std::string & errorMessage) const;
+
+    std::string m_arm_name;
+    std::string m_filename;
+    double m_revolute_tolerance;
+    double m_prismatic_tolerance;
+    double m_max_age;
+    bool m_restore_engaged = false;
+
+    // latest request for the writer thread
+    RequestType m_request = REQUEST_NONE;
+    Json::Value m_request_snapshot;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+};
+
+#endif // _mtsIntuitiveResearchKitCalibrationSnapshot_h
@@ -0,0 +1,61 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitConfigCache_h
+#define _mtsIntuitiveResearchKitConfigCache_h
+
+#include <string>
+
+#include <json/json.h>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Optional on disk cache for parsed JSON configuration files.  When
+  a cache directory is set, each parsed file is saved in a compact
+  binary form keyed by the file path, its modification time (with
+  nanoseconds on Linux and macOS) and its size.  Later calls to Parse for the same unchanged file read the
+  binary form and skip the JSON parser.  Without cache directory
+  (default), Parse is equivalent to Json::Reader::parse.  Parse can
+  be called from multiple threads, files are written to a temporary
+  file first and then renamed so concurrent writers don't corrupt the
+  cache. */
+class CISST_EXPORT mtsIntuitiveResearchKitConfigCache
+{
+public:
+    /*! Set cache directory, empty string to disable the cache.  The
+      directory must exist and should be set before any file is
+      parsed. */
+    static void SetDirectory(const std::string & directory);
+    static const std::string & Directory(void);
+
+    /*! Parse a JSON file, uses the cache if enabled.  Returns false
+      and sets the error message if the file can't be parsed. */
+    static bool Parse(const std::string & filename,
+                      Json::Value & jsonValue,
+                      std::string & errorMessage);
+
+    /*! Number of files read from cache and parsed since start. */
+    static size_t Hits(void);
+    static size_t Misses(void);
+
+protected:
+    static std::string & DirectoryReference(void);
+};
+
+#endif // _mtsIntuitiveResearchKitConfigCache_h
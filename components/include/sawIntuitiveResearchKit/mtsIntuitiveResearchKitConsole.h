@@ -20,6 +20,15 @@ http://www.cisst.org/cisst/license.txt.
 #ifndef _mtsIntuitiveResearchKitConsole_h
 #define _mtsIntuitiveResearchKitConsole_h
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <cisstMultiTask/mtsTaskFromSignal.h>
 #include <cisstMultiTask/mtsDelayedConnections.h>
 #include <cisstParameterTypes/prmOperatingState.h>
@@ -29,6 +38,7 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstParameterTypes/prmPositionCartesianSet.h>
 
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKit.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRealTime.h>
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
 
 // for ROS console
@@ -62,6 +72,10 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
                       SIMULATION_KINEMATIC,
                       SIMULATION_DYNAMIC} SimulationType;
 
+        /*! Periodic runs in own thread, chained runs in the IO thread
+          using the IO's ExecOut event, after the PID */
+        typedef enum {EXECUTION_PERIODIC, EXECUTION_CHAINED_IO} ExecutionType;
+
         friend class mtsIntuitiveResearchKitConsole;
         friend class mtsIntuitiveResearchKitConsoleQt;
         friend class dvrk::console;
@@ -117,14 +131,27 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
         std::string m_arm_interface_name;
         std::string m_arm_configuration_file;
         double m_arm_period;
+        ExecutionType m_execution = EXECUTION_PERIODIC;
+        mtsIntuitiveResearchKitRealTime m_real_time;
         // socket
         std::string m_IP;
         int m_port;
         bool m_socket_server;
+        bool m_socket_pod = false; // use fixed layout packets, see mtsSocketBasePSM
+        bool m_socket_compact = false; // quantized, delta encoded packets
+        double m_socket_compact_translation = 1.0e-6; // see mtsSocketBasePSM::SetCompactResolution
+        double m_socket_compact_rotation = 1.0e-6;
+        unsigned int m_socket_compact_keyframe = 100;
+        bool m_socket_receive_thread = false; // see mtsSocketBasePSM::SetReceiveMode
+        double m_socket_playout_delay = 0.0; // see mtsSocketBasePSM::SetPlayoutDelay
+        unsigned int m_socket_redundancy = 0; // see mtsSocketClientPSM::SetRedundancy
         std::string m_socket_component_name;
+        std::string m_socket_bridge; // arms sharing the same connection
         // generic arm
         bool m_generic;
         bool m_skip_ROS_bridge;
+        // arms sharing a power group are powered in sequence
+        std::string m_power_group;
 
         // base frame
         // (name and frame) OR (component and interface)
@@ -179,6 +206,9 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
     protected:
         std::string m_name;
         TeleopECMType m_type;
+        mtsIntuitiveResearchKitRealTime m_real_time;
+        // period of the thread running the teleop if it doesn't have its own
+        double m_chained_period = mtsIntuitiveResearchKit::TeleopPeriod;
         mtsFunctionWrite state_command;
         mtsInterfaceRequired * InterfaceRequired;
     };
@@ -186,6 +216,9 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
     class TeleopPSM {
     public:
         typedef enum {TELEOP_PSM, TELEOP_PSM_DERIVED, TELEOP_PSM_GENERIC} TeleopPSMType;
+        /*! Periodic runs in own thread, chained modes run in the arm
+          thread using the arm's ExecOut event */
+        typedef enum {EXECUTION_PERIODIC, EXECUTION_CHAINED_PSM, EXECUTION_CHAINED_MTM} ExecutionType;
         friend class mtsIntuitiveResearchKitConsole;
         friend class mtsIntuitiveResearchKitConsoleQt;
         friend class dvrk::console;
@@ -202,18 +235,35 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
         /*! Accessors */
         const std::string & Name(void) const;
 
-        /*! Turn on/off selected */
+        /*! Selected, use console's SetTeleopPSMSelected to change so
+          the pair tables are kept up to date */
         inline const bool & Selected(void) const {
             return mSelected;
         }
-        inline void SetSelected(const bool selected) {
-            mSelected = selected;
-        }
+
+        /*! Last state command sent by the console, used to only send
+          commands to teleops that need to change */
+        typedef enum {COMMAND_NONE, COMMAND_DISABLE, COMMAND_ENABLE, COMMAND_ALIGN_MTM} StateCommandType;
 
     protected:
+        /*! Desired state from teleop, resets last command if the
+          teleop state doesn't match (stale echo or changed by
+          someone else) */
+        void DesiredStateEventHandler(const std::string & state);
+
         bool mSelected;
+        // indices in console pair tables
+        size_t m_index;
+        size_t m_mtm_index;
+        size_t m_psm_index;
+        StateCommandType m_last_state_command = COMMAND_NONE;
+        bool m_selection_event_pending = true;
         std::string m_name;
         TeleopPSMType m_type;
+        ExecutionType m_execution;
+        mtsIntuitiveResearchKitRealTime m_real_time;
+        // period of the thread running the teleop if it doesn't have its own
+        double m_chained_period = mtsIntuitiveResearchKit::TeleopPeriod;
         std::string mMTMName;
         std::string mPSMName;
         mtsFunctionWrite state_command;
@@ -222,7 +272,9 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
     };
 
     mtsIntuitiveResearchKitConsole(const std::string & componentName);
-    inline virtual ~mtsIntuitiveResearchKitConsole() {}
+    inline virtual ~mtsIntuitiveResearchKitConsole() {
+        PowerSequenceWatchdogStop();
+    }
 
     /*! Tells the application to run in calibration mode, i.e. turn
       off all checks using potentiometers and force encoder re-bias
@@ -232,11 +284,24 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
     const bool & calibration_mode(void) const;
     void calibration_mode(bool & result) const;
 
+    /*! Name of the computer running this console for distributed
+      configurations, see "distributed" in the console configuration
+      file.  Overrides "distributed":"host", must be called before
+      Configure. */
+    void set_host(const std::string & host);
+    const std::string & host(void) const;
+
     /*! Configure console using JSON file. To test is the configuration
       succeeded, used method Configured().
     */
     void Configure(const std::string & filename);
 
+    /*! Run the configuration steps added by Arm::ConfigurePID and
+      Arm::ConfigureArm, called by Configure.  Must be called by
+      applications using Arm::ConfigurePID and Arm::ConfigureArm
+      directly, before Arm::Connect. */
+    void RunStartupTasks(void);
+
     /*! Method to check if the configuration was successful, ideally called
       after a call to Configure.
     */
@@ -275,13 +340,17 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
     typedef std::map<std::string, TeleopPSM *> TeleopPSMList;
     TeleopPSMList mTeleopsPSM;
 
-    /*! List to manage the teleopPSM components for each PSM */
-    typedef std::multimap<std::string, TeleopPSM *> TeleopPSMByPSMList;
-    TeleopPSMByPSMList mTeleopsPSMByPSM;
-
-    /*! List to manage the teleopPSM components for each MTM */
-    typedef std::multimap<std::string, TeleopPSM *> TeleopPSMByMTMList;
-    TeleopPSMByMTMList mTeleopsPSMByMTM;
+    /*! Integer indexed tables for MTM/PSM pairs, names are only used
+      to find the indices when a command is received.  For each MTM
+      and PSM, index of the selected teleop or -1.  Teleops for each
+      MTM are kept in the order they were configured (for cycling). */
+    struct {
+        std::vector<TeleopPSM *> teleops;
+        std::map<std::string, size_t> mtm_indices, psm_indices;
+        std::vector<std::string> mtm_names, psm_names;
+        std::vector<std::vector<size_t> > teleops_by_mtm;
+        std::vector<int> selected_by_mtm, selected_by_psm;
+    } m_teleop_psm_pairs;
 
     /*! Name of default MTM to cycle teleops if no name is provided */
     std::string mTeleopMTMToCycle;
@@ -289,42 +358,206 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
     /*! Single ECM bimanual teleoperation */
     TeleopECM * mTeleopECM;
 
+    /*! Optional executor to run all tele-operation components in a
+      single thread, see mtsTeleOperationExecutor */
+    struct {
+        bool enabled = false;
+        double period = mtsIntuitiveResearchKit::TeleopPeriod;
+        int cpu = -1;
+        std::string name = "teleop-executor";
+    } m_teleop_executor;
+
     /*! daVinci Head Sensor */
     mtsDaVinciHeadSensor * mDaVinciHeadSensor;
 
     /*! daVinci Endoscope Focus */
     mtsDaVinciEndoscopeFocus * mDaVinciEndoscopeFocus;
 
+    /*! Arm configuration steps added by Arm::ConfigurePID and
+      Arm::ConfigureArm.  The optional configure step (file parsing,
+      kinematics, tools...) only uses the arm's own component and can
+      run in parallel with other arms, it must return false instead
+      of exiting on errors.  The finish step adds the component to the
+      manager and connects it, it runs in the console's thread in the
+      order tasks were added. */
+    struct StartupTask {
+        std::string arm;
+        std::string stage;
+        std::function<bool(void)> configure;
+        std::function<void(void)> finish;
+        bool succeeded = true;
+        std::string error;
+        double configure_time = 0.0;
+        double finish_time = 0.0;
+    };
+
+    struct {
+        bool parallel = false;
+        unsigned int threads = 0; // 0 to use hardware concurrency
+        bool report = false;      // print timing report
+        std::vector<StartupTask> tasks;
+    } m_startup;
+
+    void AddStartupTask(const std::string & arm,
+                        const std::string & stage,
+                        const std::function<bool(void)> & configure,
+                        const std::function<void(void)> & finish);
+
     /*! Find all arm data from JSON configuration. */
     bool ConfigureArmJSON(const Json::Value & jsonArm,
                           const std::string & ioComponentName,
                           const cmnPath & configPath);
     bool AddArmInterfaces(Arm * arm);
 
+    /*! Parse the optional "real-time" section of a component, see
+      mtsIntuitiveResearchKitRealTime.  Settings are saved to check
+      for conflicts once all components are configured. */
+    bool ConfigureRealTimeJSON(const Json::Value & jsonRealTime,
+                               const std::string & name,
+                               const double & period,
+                               mtsIntuitiveResearchKitRealTime & realTime);
+    std::vector<mtsIntuitiveResearchKitRealTime::TaskType> m_real_time_tasks;
+
+    /*! Default execution for arms using the IO, from "io":"arm-execution" */
+    Arm::ExecutionType m_arm_execution = Arm::EXECUTION_PERIODIC;
+
     // these two methods have exact same implementation.it would be
     // nice to have a base class, or template this
     bool AddTeleopECMInterfaces(TeleopECM * teleop);
     bool AddTeleopPSMInterfaces(TeleopPSM * teleop);
 
+    /*! Create a multi-arm UDP streamer, see
+      mtsIntuitiveResearchKitUDPStreamer. */
+    bool ConfigureStreamerJSON(const Json::Value & jsonStreamer);
+
+    /*! Create a shared memory publisher, see
+      mtsIntuitiveResearchKitSharedMemory. */
+    bool ConfigureSharedMemoryJSON(const Json::Value & jsonSharedMemory);
+
+    /*! Create a binary recorder and attach it to the arms, see
+      mtsIntuitiveResearchKitRecorder. */
+    bool ConfigureRecorderJSON(const Json::Value & jsonRecorder);
+
+    /*! Configure the flight recorder for all research kit arms and
+      tele-operation components created by the console. */
+    bool ConfigureFlightRecorderJSON(const Json::Value & jsonFlightRecorder);
+
+    /*! Create the proximity monitor for patient side arms, see
+      mtsIntuitiveResearchKitProximityMonitor.  Stop events disable
+      the tele-operation of both PSMs until the operator re-engages. */
+    bool ConfigureProximityMonitorJSON(const Json::Value & jsonProximity);
+    void ProximityStopEventHandler(const prmKeyValue & arms);
+
+    /*! Open the health table and create the health monitor, see
+      mtsIntuitiveResearchKitHealthMonitor.  Must be called after
+      all components are created, a hook is added to the IO to
+      monitor its thread. */
+    bool ConfigureHealthMonitorJSON(const Json::Value & jsonHealth);
+
     bool ConfigureECMTeleopJSON(const Json::Value & jsonTeleop);
     bool ConfigurePSMTeleopJSON(const Json::Value & jsonTeleop);
 
+    /*! Distributed deployment, i.e. the same configuration file used
+      on multiple computers.  Each arm (and its IO/PID) runs on its
+      "host", PSM tele-operations run on the MTM's host and reach
+      PSMs on other hosts through the socket bridge.  Sections with a
+      "host" (streamers, recorder...) are only created on that host.
+      Must be called before the arms are configured. */
+    bool ConfigureDistributedJSON(const Json::Value & jsonConfig);
+    /*! True if not distributed or the arm runs on this host */
+    bool IsLocalArm(const std::string & armName) const;
+    /*! True if not distributed or the section's "host" is this host or not defined */
+    bool IsLocalSection(const Json::Value & jsonSection) const;
+    /*! Add required interfaces for the statistics of all socket bridges */
+    void AddDistributedLinks(void);
+    struct DistributedLink {
+        std::string component; // socket bridge
+        std::string remote_host;
+        mtsFunctionRead GetOneWayLatency;
+    };
+    struct {
+        std::string host; // this computer, empty if not distributed
+        std::map<std::string, std::string> hosts; // IP address by host name
+        std::map<std::string, std::string> arm_hosts; // host by arm name
+        std::map<std::string, std::string> psm_peers; // MTM host by PSM name, for PSMs with cross-host teleops
+        std::list<DistributedLink> links;
+    } m_distributed;
+    void distributed_links(std::vector<std::string> & links) const;
+    void distributed_latencies(vctDoubleVec & latencies) const;
+
     void power_off(void);
     void power_on(void);
     void home(void);
     void DisableFaultyArms(void);
+
+    /*! Power and homing sequence.  Arms sharing the same
+      "power-group" are powered at most "simultaneous" at a time, the
+      next arm in the group is powered as soon as one reports ENABLED
+      or fails.  An arm fails if it reports FAULT, goes back to
+      DISABLED after it started powering or is not ready "timeout"
+      seconds after its request.  Arms without group are powered
+      right away and all arms home in parallel once powered.  The time
+      each arm was requested, powered and ready is sent as status once
+      all arms are ready and can be queried using
+      "power_sequence_timeline". */
+    struct PowerSequenceEntry {
+        std::string group;
+        double requested = -1.0;
+        double powered = -1.0;
+        double ready = -1.0;
+        bool started = false; // busy or enabled since request
+        bool fault = false;
+    };
+    struct {
+        size_t simultaneous = 1;
+        double timeout = 60.0; // per arm, from request to ready
+        std::string command; // "enable" or "home", empty when idle
+        double start_time = 0.0;
+        std::map<std::string, std::deque<Arm *> > pending; // by group
+        std::map<std::string, size_t> powering; // by group
+        std::map<std::string, PowerSequenceEntry> arms;
+    } m_power_sequence;
+    void PowerSequenceStart(const std::string & command);
+    void PowerSequenceRequest(Arm * arm);
+    void PowerSequenceUpdate(const std::string & armName,
+                             const prmOperatingState & currentState);
+    void PowerSequencePowered(PowerSequenceEntry & entry, const double now);
+    void PowerSequenceCheckTimeouts(void);
+    void PowerSequenceCheckDone(const double now);
+
+    /*! The console only runs on commands and events, this thread
+      wakes it up periodically while a power sequence is in progress
+      so timeouts are detected even if no arm sends an event. */
+    struct {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stop = false;
+    } m_power_sequence_watchdog;
+    void PowerSequenceWatchdogStart(void);
+    void PowerSequenceWatchdogStop(void);
+    void power_sequence_timeline(std::string & timeline) const;
     void teleop_enable(const bool & enable);
     void cycle_teleop_psm_by_mtm(const std::string & mtmName);
     void select_teleop_psm(const prmKeyValue & mtmPsm);
     bool GetPSMSelectedForMTM(const std::string & mtmName, std::string & psmName) const;
     bool GetMTMSelectedForPSM(const std::string & psmName, std::string & mtmName) const;
-    void EventSelectedTeleopPSMs(void) const;
+    /*! Update selection flag and pair tables, selection event is
+      sent on next call to EventSelectedTeleopPSMs if changed */
+    void SetTeleopPSMSelected(TeleopPSM * teleop, const bool selected);
+    /*! Only sends the command if it's different from the last one */
+    void TeleopPSMStateCommand(TeleopPSM * teleop, const TeleopPSM::StateCommandType command);
+    /*! Emit selected/unselected events for teleops that changed since
+      last call, or all if requested */
+    void EventSelectedTeleopPSMs(const bool all = false);
     void UpdateTeleopState(void);
     void set_scale(const double & scale);
     void set_volume(const double & volume);
     void beep(const vctDoubleVec & values); // duration, frequency, volume
     void string_to_speech(const std::string & text);
     bool mHasIO;
+    // "gui" section, used by mtsIntuitiveResearchKitConsoleQt for the refresh policy
+    Json::Value m_gui_configuration;
     void ClutchEventHandler(const prmEventButton & button);
     void CameraEventHandler(const prmEventButton & button);
     void OperatorPresentEventHandler(const prmEventButton & button);
@@ -347,6 +580,8 @@ class CISST_EXPORT mtsIntuitiveResearchKitConsole: public mtsTaskFromSignal
     } console_events;
     bool mOperatorPresent;
     bool mCameraPressed;
+    // connect teleops directly to footpedals and operator present sources
+    bool m_direct_inputs = true;
 
     std::string m_IO_component_name; // for actuator IOs
 
@@ -21,7 +21,6 @@ http://www.cisst.org/cisst/license.txt.
 #define _mtsIntuitiveResearchKitConsoleQtWidget_h
 
 #include <cisstMultiTask/mtsComponent.h>
-#include <cisstMultiTask/mtsMessageQtWidget.h>
 #include <cisstParameterTypes/prmEventButton.h>
 #include <cisstParameterTypes/prmKeyValue.h>
 
@@ -35,6 +34,8 @@ class QCheckBox;
 
 #include <QWidget>
 
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitMessageQtWidget.h>
+
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitQtExport.h>
 
 class CISST_EXPORT mtsIntuitiveResearchKitConsoleQtWidget: public QWidget, public mtsComponent
@@ -147,7 +148,7 @@ protected:
     QCheckBox * QCBEnableDirectControl;
     QPushButton * QPBComponentViewer;
     QTabWidget * QTWidgets;
-    mtsMessageQtWidget * QMMessage;
+    mtsIntuitiveResearchKitMessageQtWidget * QMMessage;
 };
 
 CMN_DECLARE_SERVICES_INSTANTIATION(mtsIntuitiveResearchKitConsoleQtWidget);
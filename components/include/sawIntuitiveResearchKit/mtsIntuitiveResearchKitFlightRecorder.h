@@ -0,0 +1,119 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-28
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitFlightRecorder_h
+#define _mtsIntuitiveResearchKitFlightRecorder_h
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Always on, in memory history of the last few seconds of a
+  component's data.  All buffers are allocated in Allocate so adding
+  a sample or an event is just a copy in a preallocated slot, the
+  oldest data is overwritten.  Trigger copies the history and a
+  separate thread saves it to a CSV file so the component's thread
+  never waits for the disk.  Triggers are ignored while a dump is in
+  progress or if the previous trigger happened less than a history
+  duration ago.  Sample, Event and Trigger must all be called from
+  the owner's thread.
+
+  The file is saved in the directory provided to Allocate, with the
+  name <name>-flight-<date>.csv.  Lines starting with "#" contain the
+  trigger reason and the events (e.g. state transitions) then the
+  samples follow with the column names on the first line. */
+class CISST_EXPORT mtsIntuitiveResearchKitFlightRecorder
+{
+public:
+    mtsIntuitiveResearchKitFlightRecorder(void);
+    ~mtsIntuitiveResearchKitFlightRecorder();
+
+    /*! Allocate buffers and start the thread used to save files.
+      Number of samples is the history duration divided by the
+      component's period.  The first column is always the time and
+      is added automatically.  Capacity of 0 disables the recorder. */
+    void Allocate(const std::string & name,
+                  const std::vector<std::string> & columns,
+                  const size_t numberOfSamples,
+                  const std::string & directory);
+
+    inline bool Enabled(void) const {
+        return (m_capacity > 0);
+    }
+
+    /*! Pointer to the next sample, the caller must set all
+      columns (besides time).  Returns nullptr if not enabled. */
+    inline double * Sample(const double time) {
+        if (m_capacity == 0) {
+            return nullptr;
+        }
+        double * sample = m_samples.data() + (m_head % m_capacity) * m_sample_size;
+        ++m_head;
+        sample[0] = time;
+        return sample;
+    }
+
+    /*! Add an event, text longer than EVENT_SIZE is truncated. */
+    void Event(const double time, const std::string & text);
+
+    /*! Save the history to a file, returns false if ignored. */
+    bool Trigger(const double time, const std::string & reason);
+
+    enum {EVENT_SIZE = 120, NUMBER_OF_EVENTS = 64};
+
+protected:
+    struct EventType {
+        double time;
+        char text[EVENT_SIZE];
+    };
+
+    void WriterThread(void);
+
+    std::string m_name;
+    std::string m_directory;
+    std::vector<std::string> m_columns;
+    size_t m_sample_size = 0;
+    size_t m_capacity = 0;
+    size_t m_head = 0;
+    std::vector<double> m_samples;
+    size_t m_event_head = 0;
+    std::vector<EventType> m_events;
+    double m_last_trigger = 0.0;
+    bool m_triggered = false;
+
+    // data copied on trigger, owned by writer until m_dumping is false
+    std::atomic<bool> m_dumping;
+    std::vector<double> m_dump_samples;
+    size_t m_dump_head = 0;
+    std::vector<EventType> m_dump_events;
+    size_t m_dump_event_head = 0;
+    EventType m_dump_reason;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+};
+
+#endif // _mtsIntuitiveResearchKitFlightRecorder_h
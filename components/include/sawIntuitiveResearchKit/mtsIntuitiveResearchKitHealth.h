@@ -0,0 +1,291 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-11-29
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitHealth_h
+#define _mtsIntuitiveResearchKitHealth_h
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+#include <cisstCommon/cmnUnits.h>
+#include <cisstVector/vctDynamicVectorTypes.h>
+#include <cisstOSAbstraction/osaMutex.h>
+#include <cisstMultiTask/mtsTaskPeriodic.h>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+// magic number, "DVRH", and version of health table layout
+#define HEALTH_MAGIC 0x48525644
+#define HEALTH_VERSION 1
+#define HEALTH_MAX_TASKS 32
+#define HEALTH_NAME_SIZE 32
+
+/*! \name Health table layout.
+
+  Plain old data so external monitors can map the segment without
+  cisst, see mtsIntuitiveResearchKitSharedMemory.  Each task has a
+  single writer (its own thread) and all fields updated at runtime are
+  lock free atomics so readers never block the writers.  Times are in
+  nanoseconds from the monotonic clock (CLOCK_MONOTONIC on Linux) so
+  they can be compared across processes.  Registered is set last, a
+  reader should ignore tasks with Registered equal to 0. */
+//@{
+struct mtsHealthTask {
+    char Name[HEALTH_NAME_SIZE];
+    // expected period in seconds, 0 for tasks triggered by another task
+    double Period;
+    std::atomic<uint32_t> Registered;
+    uint32_t Padding;
+    // incremented at the end of each cycle
+    std::atomic<uint64_t> Heartbeat;
+    // start of the last cycle
+    std::atomic<int64_t> CycleStart;
+    // duration of the last complete cycle
+    std::atomic<int64_t> CycleTime;
+    // number of cycles longer than Period
+    std::atomic<uint64_t> Overruns;
+};
+
+struct mtsHealthLayout {
+    uint32_t Magic;
+    uint32_t Version;
+    std::atomic<uint32_t> NumberOfTasks;
+    uint32_t Padding;
+    mtsHealthTask Tasks[HEALTH_MAX_TASKS];
+};
+//@}
+
+/*! Process wide health table.  The table is disabled until Open is
+  called (by the console when "health-monitor" is configured), then
+  tasks register on their first cycle so Open must be called before
+  the components are started.  The table is placed in a POSIX shared
+  memory segment so external tools can monitor the dVRK, on other
+  systems or if the segment can't be created, the table is only
+  available in the process. */
+class CISST_EXPORT mtsIntuitiveResearchKitHealthTable
+{
+public:
+    static mtsIntuitiveResearchKitHealthTable & Instance(void);
+
+    /*! Create the table, segmentName must start with "/".  The
+      segment is only accessible by the current user and an existing
+      segment is never reused.  Returns false if the shared memory
+      segment couldn't be created (e.g. it already exists), the table
+      is then allocated in the process. */
+    bool Open(const std::string & segmentName);
+    void Close(void);
+
+    inline bool IsOpen(void) const {
+        return (m_layout != nullptr);
+    }
+
+    /*! Add a task to the table, returns nullptr if the table is not
+      open or full. */
+    mtsHealthTask * Register(const std::string & name, const double period);
+
+    inline const mtsHealthLayout * Layout(void) const {
+        return m_layout;
+    }
+
+    /*! Monotonic time in nanoseconds, same clock as the table. */
+    static int64_t Now(void);
+
+protected:
+    mtsIntuitiveResearchKitHealthTable(void) = default;
+    ~mtsIntuitiveResearchKitHealthTable();
+
+    osaMutex m_mutex;
+    std::string m_segment_name;
+    int m_file_descriptor = -1;
+    bool m_shared = false;
+    mtsHealthLayout * m_layout = nullptr;
+};
+
+/*! Writer side of the health table, each task owns one and updates
+  it from its own thread.  Registration happens on the first cycle so
+  the cost is a null pointer test if the table is not open.  Use
+  ScopedCycle at the top of Run so early returns are handled. */
+class CISST_EXPORT mtsIntuitiveResearchKitHeartbeat
+{
+public:
+    inline void Configure(const std::string & name, const double period) {
+        m_name = name;
+        m_period = period;
+    }
+
+    inline void Begin(void) {
+        if (!m_registered) {
+            m_registered = true;
+            m_task = mtsIntuitiveResearchKitHealthTable::Instance().Register(m_name, m_period);
+        }
+        if (m_task) {
+            m_start = mtsIntuitiveResearchKitHealthTable::Now();
+            m_task->CycleStart.store(m_start, std::memory_order_relaxed);
+        }
+    }
+
+    inline void End(void) {
+        if (m_task) {
+            const int64_t duration = mtsIntuitiveResearchKitHealthTable::Now() - m_start;
+            m_task->CycleTime.store(duration, std::memory_order_relaxed);
+            if ((m_period > 0.0) && (duration > static_cast<int64_t>(m_period * 1.0e9))) {
+                m_task->Overruns.fetch_add(1, std::memory_order_relaxed);
+            }
+            m_task->Heartbeat.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    /*! For hooks called from a thread we don't own, one beat per
+      call and the cycle time is the time since the previous beat, an
+      overrun is counted if it's more than twice the period. */
+    inline void Beat(void) {
+        if (!m_registered) {
+            m_registered = true;
+            m_task = mtsIntuitiveResearchKitHealthTable::Instance().Register(m_name, m_period);
+        }
+        if (m_task) {
+            const int64_t now = mtsIntuitiveResearchKitHealthTable::Now();
+            if (m_start != 0) {
+                const int64_t interval = now - m_start;
+                m_task->CycleTime.store(interval, std::memory_order_relaxed);
+                if ((m_period > 0.0) && (interval > static_cast<int64_t>(2.0 * m_period * 1.0e9))) {
+                    m_task->Overruns.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            m_start = now;
+            m_task->CycleStart.store(now, std::memory_order_relaxed);
+            m_task->Heartbeat.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    class ScopedCycle {
+    public:
+        inline ScopedCycle(mtsIntuitiveResearchKitHeartbeat & heartbeat):
+            m_heartbeat(heartbeat) {
+            m_heartbeat.Begin();
+        }
+        inline ~ScopedCycle() {
+            m_heartbeat.End();
+        }
+    private:
+        mtsIntuitiveResearchKitHeartbeat & m_heartbeat;
+    };
+
+protected:
+    std::string m_name;
+    double m_period = 0.0;
+    bool m_registered = false;
+    mtsHealthTask * m_task = nullptr;
+    int64_t m_start = 0;
+};
+
+/*! Heartbeat for a component we don't own (e.g. mtsRobotIO1394).
+  This task has no thread, it must be connected to the ExecOut
+  interface of the target component so its Run is called from the
+  target's thread, see mtsIntuitiveResearchKitRealTimeHook. */
+class CISST_EXPORT mtsIntuitiveResearchKitHeartbeatHook: public mtsTaskPeriodic
+{
+    CMN_DECLARE_SERVICES(CMN_NO_DYNAMIC_CREATION, CMN_LOG_ALLOW_DEFAULT);
+
+public:
+    mtsIntuitiveResearchKitHeartbeatHook(const std::string & componentName,
+                                         const std::string & targetName,
+                                         const double targetPeriod);
+    ~mtsIntuitiveResearchKitHeartbeatHook() {}
+
+    void Configure(const std::string & CMN_UNUSED(filename) = "") {};
+    void Startup(void) {};
+    void Run(void);
+    void Cleanup(void) {};
+
+protected:
+    mtsIntuitiveResearchKitHeartbeat m_heartbeat;
+};
+
+CMN_DECLARE_SERVICES_INSTANTIATION(mtsIntuitiveResearchKitHeartbeatHook);
+
+/*! Supervisor for the health table.  Runs in its own low priority
+  thread (SCHED_OTHER with nice 10 on Linux) and only reads the
+  table, it doesn't add any command or event to the control loops.
+  A task is stalled if its last cycle started more than
+  "stall-factor" periods ago (or "stall-timeout" for tasks without
+  period, whichever is larger), stalls are not evaluated when the
+  monitor itself was late.  Overruns are counted by the tasks
+  themselves.  Changes are reported with the usual
+  error/warning/status events and the state of all tasks is
+  available with read commands on the "HealthMonitor" interface. */
+class CISST_EXPORT mtsIntuitiveResearchKitHealthMonitor: public mtsTaskPeriodic
+{
+    CMN_DECLARE_SERVICES(CMN_NO_DYNAMIC_CREATION, CMN_LOG_ALLOW_DEFAULT);
+
+public:
+    mtsIntuitiveResearchKitHealthMonitor(const std::string & componentName,
+                                         const double periodInSeconds);
+    ~mtsIntuitiveResearchKitHealthMonitor() {}
+
+    void Configure(const std::string & CMN_UNUSED(filename) = "") {};
+
+    /*! Configure from JSON, optional "stall-factor" (number of
+      periods, defaults to 5) and "stall-timeout" (seconds, defaults
+      to 50 ms). */
+    bool Configure(const Json::Value & jsonConfig);
+
+    void Startup(void);
+    void Run(void);
+    void Cleanup(void) {};
+
+protected:
+    struct TaskData {
+        std::string m_name;
+        int64_t m_stall_threshold;
+        uint64_t m_overruns = 0;
+        bool m_stalled = false;
+    };
+
+    void AddTasks(const mtsHealthLayout & layout, const uint32_t numberOfTasks);
+    void UpdateTask(const size_t index, const mtsHealthTask & task,
+                    const int64_t now, const bool late);
+
+    double m_stall_factor = 5.0;
+    double m_stall_timeout = 50.0 * cmn_ms;
+    int64_t m_last_run = 0;
+    // throttle overrun warnings, per task
+    double m_overrun_report_period = 1.0;
+    std::vector<double> m_last_overrun_report;
+
+    std::vector<TaskData> m_tasks;
+
+    // state table, one element per task
+    std::string m_task_names;
+    vctDoubleVec m_cycle_times;
+    vctDoubleVec m_ages;
+    vctUIntVec m_overruns;
+    vctBoolVec m_stalled;
+    unsigned int m_number_of_stalls = 0;
+
+    mtsInterfaceProvided * m_interface = nullptr;
+};
+
+CMN_DECLARE_SERVICES_INSTANTIATION(mtsIntuitiveResearchKitHealthMonitor);
+
+#endif // _mtsIntuitiveResearchKitHealth_h
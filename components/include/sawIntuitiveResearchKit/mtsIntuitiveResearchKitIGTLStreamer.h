@@ -0,0 +1,103 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-11-15
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitIGTLStreamer_h
+#define _mtsIntuitiveResearchKitIGTLStreamer_h
+
+#include <cisstMultiTask/mtsTaskPeriodic.h>
+#include <cisstParameterTypes/prmStateJoint.h>
+#include <cisstParameterTypes/prmPositionCartesianGet.h>
+#include <cisstParameterTypes/prmVelocityCartesianGet.h>
+#include <cisstParameterTypes/prmForceCartesianGet.h>
+#include <cisstParameterTypes/prmOperatingState.h>
+
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Decimated arm state for OpenIGTLink bridges.
+
+  The streamer reads the arm state once per period with the
+  "measured_bundle" command (required interface "Arm") so all values
+  come from the same state table index.  Each client (e.g. one
+  mtsIGTLCRTKBridge per 3D Slicer instance) connects to its own
+  provided interface instead of the arm's interface.  Client
+  interfaces have the CRTK read commands used by the bridges
+  (measured_js, setpoint_js, measured_cp, setpoint_cp, measured_cv,
+  body/measured_cf and operating_state) and a void event "frame".
+  The data of a client is only updated at the client's rate and only
+  if the arm published new data, then the event is triggered.  The
+  load on the arm is one read per period regardless of the number of
+  clients and fields. */
+class CISST_EXPORT mtsIntuitiveResearchKitIGTLStreamer: public mtsTaskPeriodic
+{
+    CMN_DECLARE_SERVICES(CMN_DYNAMIC_CREATION_ONEARG, CMN_LOG_ALLOW_DEFAULT);
+
+public:
+    mtsIntuitiveResearchKitIGTLStreamer(const std::string & componentName, const double periodInSeconds);
+    mtsIntuitiveResearchKitIGTLStreamer(const mtsTaskPeriodicConstructorArg & arg);
+    ~mtsIntuitiveResearchKitIGTLStreamer();
+
+    /*! Configure from a JSON file with "clients", an array of
+      objects with "name" (provided interface) and "rate" (frames per
+      second, defaults to 30).  Rates above the component's rate are
+      capped, i.e. every period. */
+    void Configure(const std::string & filename = "");
+    virtual void Configure(const Json::Value & jsonConfig);
+
+    /*! Add a client, must be called before the component is
+      connected.  Returns false if the name is already used. */
+    bool AddClient(const std::string & name, const double rate);
+
+    void Startup(void);
+    void Run(void);
+    void Cleanup(void);
+
+protected:
+    void Init(void);
+
+    struct ClientType {
+        std::string m_name;
+        unsigned int m_decimation = 1;
+        unsigned int m_counter = 0;
+        double m_last_timestamp = 0.0;
+        prmStateJoint m_measured_js;
+        prmStateJoint m_setpoint_js;
+        prmPositionCartesianGet m_measured_cp;
+        prmPositionCartesianGet m_setpoint_cp;
+        prmVelocityCartesianGet m_measured_cv;
+        prmForceCartesianGet m_body_measured_cf;
+        prmOperatingState m_operating_state;
+        mtsFunctionVoid frame_event;
+    };
+
+    /*! Copy the last bundle read from the arm to a client's data */
+    void Publish(ClientType * client);
+
+    struct {
+        mtsFunctionRead measured_bundle;
+    } m_arm;
+
+    mtsIntuitiveResearchKitArmMeasured m_bundle;
+    std::vector<ClientType *> m_clients;
+};
+
+CMN_DECLARE_SERVICES_INSTANTIATION(mtsIntuitiveResearchKitIGTLStreamer);
+
+#endif // _mtsIntuitiveResearchKitIGTLStreamer_h
@@ -106,11 +106,25 @@ protected:
       calling mtsIntuitiveResearchKitArm::GetRobotData. */
     void GetRobotData(void) override;
 
+    /*! Add gripper to GUI snapshot */
+    inline void GUISnapshotDerived(mtsIntuitiveResearchKitArmSnapshot & snapshot) override {
+        snapshot.tool_js.From(m_gripper_measured_js);
+    }
+
     // see base class
     void control_servo_cf_orientation_locked(void) override;
     void SetControlEffortActiveJoints(void) override;
     void control_servo_cf_preload(vctDoubleVec & effortPreload,
-                                  vctDoubleVec & wrenchPreload) override;
+                                  vct6 & wrenchPreload) override;
+
+    /*! Single jacobian step on the 3 wrist joints (pitch, yaw, roll)
+      to maintain the locked orientation, warm started from the
+      previous solution and using the measured values of the first 3
+      joints, which are in effort mode.  Returns false if the step
+      can't be used (orientation error too large or wrist close to
+      singular), caller should then use the full inverse
+      kinematics. */
+    bool orientation_locked_incremental_step(void);
 
     /*! Lock master orientation when in cartesian effort mode */
     virtual void lock_orientation(const vctMatRot3 & orientation);
@@ -118,6 +132,24 @@ protected:
 
     void control_add_gravity_compensation(vctDoubleVec & efforts) override;
 
+    /*! Stream an alignment goal, used by teleoperation to align the
+      MTM orientation with the PSM.  Goals can be sent at any rate,
+      control_align_cp tracks the latest goal at the arm rate with
+      the cartesian trajectory velocity and acceleration limits
+      (scaled by the joint trajectory ratios).  Uses the user control
+      mode in cartesian space. */
+    virtual void align_cp(const prmPositionCartesianSet & goal);
+    void control_align_cp(void);
+
+    struct {
+        vctFrm3 goal; // in base frame
+        vctFrm3 cp;   // current position sent to IK
+        vctDoubleVec jp; // IK solution, used to warm start
+        double v_linear;
+        double v_angular;
+        double time;
+    } m_align;
+
     // Functions for events
     struct {
         mtsFunctionWrite orientation_locked;
@@ -140,7 +172,21 @@ protected:
 
     robGravityCompensationMTM * GravityCompensationMTM = 0;
 
+    //! Gravity compensation cache settings and hits, see robGravityCompensationMTM
+    struct {
+        double tolerance = 0.0;
+        double max_error = 0.0;
+        unsigned int hits = 0;
+    } m_gravity_compensation_cache;
+
     double m_platform_gain = mtsIntuitiveResearchKit::MTMPlatform::Gain;
+
+    //! Last solution for orientation lock, used to warm start
+    struct {
+        bool warm = false;
+        vctDoubleVec joints;
+        vctFrm4x4 pose;
+    } m_orientation_lock;
 };
 
 CMN_DECLARE_SERVICES_INSTANTIATION(mtsIntuitiveResearchKitMTM);
@@ -0,0 +1,126 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitMessageQtWidget_h
+#define _mtsIntuitiveResearchKitMessageQtWidget_h
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <cisstMultiTask/mtsMessage.h>
+
+#include <QWidget>
+#include <QAbstractListModel>
+#include <QTime>
+
+class mtsInterfaceRequired;
+class QListView;
+class QLabel;
+class QPushButton;
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitQtExport.h>
+
+/*! Message history for the message widget.  Messages are kept in a
+  fixed size ring buffer, the oldest messages are removed when the
+  buffer is full.  A message identical to the last one only increments
+  its count. */
+class CISST_EXPORT mtsIntuitiveResearchKitMessageQtModel: public QAbstractListModel
+{
+public:
+    typedef enum {LEVEL_STATUS, LEVEL_WARNING, LEVEL_ERROR} LevelType;
+
+    struct EntryType {
+        LevelType level;
+        QTime time;
+        QString text;
+        size_t count;
+    };
+
+    mtsIntuitiveResearchKitMessageQtModel(const size_t capacity, QObject * parent = 0);
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+    /*! Append all entries at once, one insert signal per call. */
+    void Append(const std::vector<EntryType> & entries);
+    void Clear(void);
+
+protected:
+    inline EntryType & Entry(const size_t row) {
+        return m_entries[(m_first + row) % m_entries.size()];
+    }
+    inline const EntryType & Entry(const size_t row) const {
+        return m_entries[(m_first + row) % m_entries.size()];
+    }
+
+    std::vector<EntryType> m_entries;
+    size_t m_first;
+    size_t m_size;
+};
+
+/*! Replacement for mtsMessageQtWidget that can handle message storms.
+  Event handlers run in the sender's thread and only queue messages
+  (with repeated messages coalesced) in a bounded buffer.  A timer in
+  the GUI thread moves queued messages to the model at a fixed rate
+  and the list view only renders visible rows. */
+class CISST_EXPORT mtsIntuitiveResearchKitMessageQtWidget: public QWidget
+{
+    Q_OBJECT;
+
+public:
+    mtsIntuitiveResearchKitMessageQtWidget(QWidget * parent = 0);
+    ~mtsIntuitiveResearchKitMessageQtWidget() {}
+
+    /*! Add event handlers for error, warning and status. */
+    void SetInterfaceRequired(mtsInterfaceRequired * interfaceRequired);
+    void setupUi(void);
+
+    enum {HISTORY_SIZE = 1000,      // rows kept in model
+          PENDING_SIZE = 200,       // messages queued between updates
+          MAX_ROWS_PER_UPDATE = 50, // rows added per update
+          UPDATE_PERIOD_MS = 100};
+
+private slots:
+    void timerEvent(QTimerEvent * event);
+    void SlotClear(void);
+
+protected:
+    void ErrorEventHandler(const mtsMessage & message);
+    void WarningEventHandler(const mtsMessage & message);
+    void StatusEventHandler(const mtsMessage & message);
+    void Queue(const mtsIntuitiveResearchKitMessageQtModel::LevelType level,
+               const std::string & text);
+
+    // protected by mutex, filled by event handlers
+    std::mutex m_mutex;
+    std::vector<mtsIntuitiveResearchKitMessageQtModel::EntryType> m_pending;
+    size_t m_dropped;
+
+    // GUI thread only
+    std::vector<mtsIntuitiveResearchKitMessageQtModel::EntryType> m_updating;
+    size_t m_dropped_total;
+
+    mtsIntuitiveResearchKitMessageQtModel * m_model;
+    QListView * QLVMessages;
+    QLabel * QLDropped;
+    QPushButton * QPBClear;
+};
+
+#endif // _mtsIntuitiveResearchKitMessageQtWidget_h
@@ -0,0 +1,141 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitMessages_h
+#define _mtsIntuitiveResearchKitMessages_h
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+class mtsInterfaceProvided;
+
+/*! Rate limited messages for code running in a control loop.  Each
+  place that can send a message repeatedly is registered once as a
+  site with its level, text and minimum period.  Send only counts
+  occurrences and, if the period for the site has elapsed, queues a
+  small fixed size entry (site, count, time and optional value).  A
+  separate thread formats the messages and writes them to the log.
+  The owner's thread then sends the formatted messages using
+  Dispatch, this never waits for the formatting thread.
+
+  AddSite must be called before Start.  Send and Dispatch must be
+  called from the owner's thread.  Entries are dropped (and counted)
+  if the queue is full. */
+class CISST_EXPORT mtsIntuitiveResearchKitMessages
+{
+public:
+    typedef enum {LEVEL_STATUS, LEVEL_WARNING, LEVEL_ERROR} LevelType;
+    typedef std::function<void(const LevelType, const std::string &)> SenderType;
+
+    mtsIntuitiveResearchKitMessages(void);
+    ~mtsIntuitiveResearchKitMessages();
+
+    /*! Register a site, returns the identifier to use with Send.
+      Text is prefixed by the name provided to Start. */
+    size_t AddSite(const LevelType level,
+                   const std::string & text,
+                   const double period = 1.0);
+
+    /*! Start the formatting thread. */
+    void Start(const std::string & name);
+    void Stop(void);
+
+    /*! Count an occurrence, queues a message if the site's period
+      has elapsed since the last message.  Doesn't allocate. */
+    inline void Send(const size_t site, const double time) {
+        SendInternal(site, time, false, 0.0);
+    }
+
+    /*! Same as Send with a value appended to the message. */
+    inline void Send(const size_t site, const double time, const double value) {
+        SendInternal(site, time, true, value);
+    }
+
+    /*! Reset the period for a site so the next occurrence is sent
+      right away, e.g. once the condition is cleared. */
+    inline void Reset(const size_t site) {
+        m_sites[site].last_sent = -1.0e9;
+        m_sites[site].count = 0;
+    }
+
+    /*! Total number of occurrences for a site. */
+    inline size_t Total(const size_t site) const {
+        return m_sites[site].total;
+    }
+
+    /*! Send formatted messages, returns immediately if the
+      formatting thread is busy. */
+    void Dispatch(const SenderType & sender);
+    void Dispatch(mtsInterfaceProvided * interfaceProvided);
+
+    enum {QUEUE_SIZE = 64};
+
+protected:
+    struct SiteType {
+        LevelType level;
+        std::string text;
+        double period;
+        double last_sent;
+        size_t count;  // since last message sent
+        size_t total;
+    };
+
+    struct EntryType {
+        size_t site;
+        size_t count;
+        double time;
+        bool has_value;
+        double value;
+    };
+
+    struct MessageType {
+        LevelType level;
+        std::string text;
+    };
+
+    void SendInternal(const size_t site, const double time,
+                      const bool hasValue, const double value);
+    void FormattingThread(void);
+
+    std::string m_name;
+    std::vector<SiteType> m_sites;
+
+    // single producer, single consumer queue
+    std::vector<EntryType> m_queue;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+    std::atomic<size_t> m_dropped;
+
+    // formatted messages, protected by mutex
+    std::mutex m_mutex;
+    std::vector<MessageType> m_formatted;
+    std::atomic<bool> m_pending;
+    std::vector<MessageType> m_dispatching;
+
+    std::thread m_thread;
+    std::atomic<bool> m_stop;
+};
+
+#endif // _mtsIntuitiveResearchKitMessages_h
@@ -20,9 +20,18 @@ http://www.cisst.org/cisst/license.txt.
 #ifndef _mtsIntuitiveResearchKitPSM_h
 #define _mtsIntuitiveResearchKitPSM_h
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cisstVector/vctFixedSizeMatrixTypes.h>
 #include <cisstParameterTypes/prmActuatorJointCoupling.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArm.h>
 #include <sawIntuitiveResearchKit/mtsToolList.h>
+#include <sawIntuitiveResearchKit/robPSMCompensation.h>
+#include <sawIntuitiveResearchKit/robReachabilityMap.h>
 
 // Always include last
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
@@ -35,9 +44,14 @@ class CISST_EXPORT mtsIntuitiveResearchKitPSM: public mtsIntuitiveResearchKitArm
  public:
     mtsIntuitiveResearchKitPSM(const std::string & componentName, const double periodInSeconds);
     mtsIntuitiveResearchKitPSM(const mtsTaskPeriodicConstructorArg & arg);
-    inline ~mtsIntuitiveResearchKitPSM() override {};
+    inline ~mtsIntuitiveResearchKitPSM() override {
+        StopToolPreparation();
+    };
     void set_simulated(void) override;
 
+    void Run(void) override;
+    void Cleanup(void) override;
+
  protected:
 
     void load_tool_list(const cmnPath & path,
@@ -51,6 +65,13 @@ class CISST_EXPORT mtsIntuitiveResearchKitPSM: public mtsIntuitiveResearchKitArm
                        const cmnPath & configPath,
                        const std::string & filename) override;
     virtual bool ConfigureTool(const std::string & filename);
+    virtual bool ConfigureTool(const Json::Value & jsonConfig,
+                               const std::string & fullFilename);
+    /*! Configure tool from list, uses the definition pre-parsed by
+      PostConfigure if available. */
+    bool ConfigureTool(const size_t & index);
+    /*! Path used to locate tool definition files. */
+    cmnPath ToolPath(void) const;
 
     /*! Configuration methods */
     inline size_t NumberOfJoints(void) const override {
@@ -66,6 +87,19 @@ class CISST_EXPORT mtsIntuitiveResearchKitPSM: public mtsIntuitiveResearchKitArm
     }
 
     void UpdateStateJointKinematics(void) override;
+
+    /*! Add jaw to GUI snapshot */
+    inline void GUISnapshotDerived(mtsIntuitiveResearchKitArmSnapshot & snapshot) override {
+        snapshot.tool_js.From(m_jaw_measured_js);
+    }
+    /*! Jaw effort plotted by the PSM widget */
+    inline bool GUIPlotToolEffort(double & effort) const override {
+        if (m_jaw_measured_js.Effort().size() == 0) {
+            return false;
+        }
+        effort = m_jaw_measured_js.Effort().at(0);
+        return true;
+    }
     void ToJointsPID(const vctDoubleVec &jointsKinematics, vctDoubleVec &jointsPID) override;
 
 
@@ -86,6 +120,12 @@ class CISST_EXPORT mtsIntuitiveResearchKitPSM: public mtsIntuitiveResearchKitArm
     void SetGoalHomingArm(void) override;
     void TransitionHomed(void); // for adapter/tool detection
 
+    /*! Save/restore adapter and tool engaged in calibration snapshot.
+      Restored values are only used if the same tool (name) is
+      detected, they are reset when the adapter or tool is removed. */
+    void CalibrationSnapshotExtra(Json::Value & extra) const override;
+    void CalibrationSnapshotRestore(const Json::Value & extra) override;
+
     // methods used in change coupling/engaging
     void RunChangingCoupling(void);
     void UpdateConfigurationJointPID(const bool toolPresent);
@@ -139,6 +179,7 @@ class CISST_EXPORT mtsIntuitiveResearchKitPSM: public mtsIntuitiveResearchKitArm
         bool IsPresent;
         bool NeedEngage = false;
         bool IsEngaged = false;
+        bool RestoredEngaged = false; // from calibration snapshot
     } Adapter;
 
     struct {
@@ -146,6 +187,7 @@ class CISST_EXPORT mtsIntuitiveResearchKitPSM: public mtsIntuitiveResearchKitArm
         bool IsPresent;
         bool NeedEngage = false;
         bool IsEngaged = false;
+        std::string RestoredEngaged; // tool name from calibration snapshot
     } Tool;
     //@}
 
@@ -190,6 +232,139 @@ class CISST_EXPORT mtsIntuitiveResearchKitPSM: public mtsIntuitiveResearchKitArm
     /*! 5mm tools with 8 joints */
     bool mSnakeLike = false;
 
+    /*! Fixed size mapping between PID joints (7) and kinematic
+      joints (6 or 8 for snake like tools).  Matrices are rebuilt
+      only when the tool type or coupling changes.  Position, velocity
+      and effort are converted together using a single product.  Only
+      the first 6 PID joints are computed from kinematics, the jaw is
+      handled separately. */
+    struct {
+        size_t nb_kinematics = 0; // 0 means mapping needs to be rebuilt
+        vctFixedSizeMatrix<double, 8, 7> kinematics_from_pid;
+        vctFixedSizeMatrix<double, 6, 8> pid_from_kinematics;
+        vctFixedSizeMatrix<double, 7, 3> pid; // columns are position, velocity, effort
+        vctFixedSizeMatrix<double, 8, 3> kinematics;
+        vctFixedSizeVector<double, 8> kinematics_joints;
+        vctFixedSizeVector<double, 6> pid_joints;
+    } m_joint_mapping;
+    void UpdateJointMapping(void);
+    void MapStateJointKinematics(const prmStateJoint & pid,
+                                 prmStateJoint & kinematics,
+                                 const bool velocity);
+
+    /*! Inverse kinematics for tools with 6 joints, closed form can
+      be selected in the tool configuration file using
+      "kinematic-type". */
+    enum KinematicType {
+        PSM_ITERATIVE,
+        PSM_CLOSED
+    } mKinematicType = PSM_ITERATIVE;
+
+    /*! Tool configuration computed from the tool definition file.
+      When a tool is inserted it is prepared by a background thread
+      (all parsing, kinematics and buffers sized for the new number of
+      joints) and the control thread swaps it in at the beginning of
+      Run, see ToolPreparationProcess.  At configuration time,
+      ConfigureTool prepares and applies it immediately. */
+    struct ToolPreparationType {
+        size_t sequence = 0;
+        size_t index = 0;
+        bool valid = false;
+        bool snake_like = false;
+        KinematicType kinematic_type = PSM_ITERATIVE;
+        robManipulator * manipulator = nullptr;
+        robManipulator * tool_offset = nullptr; // attached to manipulator
+        vctFrm4x4 tool_offset_transformation;
+        prmActuatorJointCoupling coupling;
+        prmConfigurationJoint jaw_configuration_js;
+        vctDoubleVec engage_lower_position, engage_upper_position;
+        robReachabilityMap reachability;
+        KinematicsDataType * kinematics = nullptr;
+        // list of tools to dispose, see m_tool_preparation.retired
+        ToolPreparationType * next_retired = nullptr;
+    };
+
+    /*! Doesn't modify the arm, can be called from any thread. */
+    bool PrepareTool(const Json::Value & jsonConfig,
+                     const std::string & fullFilename,
+                     const vctFrm4x4 & Rtw0,
+                     ToolPreparationType & tool) const;
+    /*! Swap in prepared tool, tool then holds the previous
+      manipulator and kinematics data so they can be disposed outside
+      the control thread. */
+    void ApplyTool(ToolPreparationType & tool);
+    static void DisposeTool(ToolPreparationType & tool);
+
+    void RequestToolPreparation(const size_t & index);
+    void CancelToolPreparation(void);
+    void ToolPreparationLoop(void);
+    void ToolPreparationProcess(void);
+    void RetireTool(ToolPreparationType * tool);
+    void StopToolPreparation(void);
+
+    struct {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stop = false;
+        // last request, protected by mutex
+        bool requested = false;
+        size_t index = 0;
+        vctFrm4x4 Rtw0;
+        // incremented by control thread for each request or cancellation
+        size_t sequence = 0;
+        // result from preparation thread
+        std::atomic<ToolPreparationType *> ready{nullptr};
+        // applied or stale tools to dispose, lock free list pushed
+        // by control thread and emptied by preparation thread
+        std::atomic<ToolPreparationType *> retired{nullptr};
+    } m_tool_preparation;
+
+    /*! Bounded inverse kinematics for snake like tools, solver is
+      warm started using previous solution and velocity.  Partial
+      solutions are accepted if the residual is small enough. */
+    struct {
+        bool bounded = false;
+        size_t max_iterations = 20;
+        double max_time = 0.0; // in seconds, 0 means no time limit
+        double max_residual = 0.1 * cmn_mm;
+        // warm start
+        bool previous_valid = false;
+        double previous_time = 0.0;
+        vctDoubleVec previous, velocity, no_velocity;
+        size_t not_converged = 0;
+    } m_snake_ik;
+
+    robManipulator::Errno InverseKinematicsSnakeBounded(vctDoubleVec & jointSet,
+                                                        const vctFrm4x4 & cartesianGoal);
+
+    /*! Optional map used to reject goals out of reach before solving
+      the inverse kinematics, see "reachability-map" and
+      robReachabilityMap.  The map is built when the tool is prepared
+      (not in the control thread) and swapped with the tool's
+      manipulator. */
+    struct {
+        bool enabled = false;
+        double resolution = 2.0 * cmnPI_180;
+        robReachabilityMap map;
+    } m_reachability;
+
+    /*! Rate limited inverse kinematics warnings, IK is called at the
+      arm rate while following a servo goal */
+    struct {
+        size_t too_close_to_rcm;
+        size_t out_of_reach;
+        size_t snake_equality;
+    } m_ik_message_sites;
+
+    /*! Compliance and backlash compensation applied on measured
+      joint positions in UpdateStateJointKinematics, parameters are a
+      copy of this arm's entry in the "compensation" file. */
+    struct {
+        bool enabled = false;
+        robPSMCompensation::ParametersType parameters;
+    } m_compensation;
+
     robManipulator * ToolOffset = nullptr;
     vctFrm4x4 ToolOffsetTransformation;
 
@@ -201,6 +376,29 @@ class CISST_EXPORT mtsIntuitiveResearchKitPSM: public mtsIntuitiveResearchKitArm
     unsigned int EngagingStage; // 0 requested
     unsigned int LastEngagingStage;
 
+    /*! Early detection of adapter/tool engagement, see
+      "engage-detection".  Each of the last 4 actuators is latched
+      once its tracking error goes over the threshold, i.e. the disk
+      is engaged and reached a mechanical limit.  When all are latched
+      the remaining phases are skipped and the disks go back to zero.
+      Phase durations are reported once engaged. */
+    struct {
+        bool enabled = false;
+        double tracking_error = 10.0 * cmnPI_180;
+        vctBoolVec engaged;
+        double start_time;
+        double phase_start_time;
+        std::vector<double> phases;
+    } m_engage_detection;
+    void EngagingStart(const double currentTime);
+    void EngagingPhaseEnd(const double currentTime);
+    /*! Returns true if all disks are engaged and the remaining phases
+      have been skipped */
+    bool EngagingSkipIfDetected(const double currentTime,
+                                const std::string & what);
+    void EngagingReport(const double currentTime,
+                        const std::string & what);
+
     struct {
         bool Started;
         std::string NextState;
@@ -20,6 +20,7 @@ http://www.cisst.org/cisst/license.txt.
 #define _mtsIntuitiveResearchKitPSMQtWidget_h
 
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmQtWidget.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitQtPlotDecimator.h>
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitQtExport.h>
 
 
@@ -68,6 +69,12 @@ private:
     vctPlot2DBase::Signal * m_signal_jaw;
     vctPlot2DBase::Signal * m_signal_jaw_zero;
 
+    // all samples from the arm, decimated to the plot's width
+    void PlotJawSamples(void);
+    mtsIntuitiveResearchKitQtPlotDecimator m_jaw_decimator;
+    int m_jaw_plot_width = 0;
+    double m_jaw_plot_timestamp = 0.0;
+
     struct {
         mtsFunctionRead measured_js;
         mtsFunctionRead configuration_js;
@@ -0,0 +1,126 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitProximityMonitor_h
+#define _mtsIntuitiveResearchKitProximityMonitor_h
+
+#include <vector>
+
+#include <json/json.h>
+
+#include <cisstVector/vctFixedSizeVectorTypes.h>
+#include <cisstVector/vctTransformationTypes.h>
+#include <cisstMultiTask/mtsTaskPeriodic.h>
+#include <cisstParameterTypes/prmPositionCartesianGet.h>
+#include <cisstParameterTypes/prmKeyValue.h>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Monitor distances between patient side arms (PSMs and ECM).
+  Each arm is modeled by two capsules, the instrument shaft from the
+  tool tip to the RCM and the instrument body, from the RCM away from
+  the patient along the shaft axis.  Both are computed from the arm's
+  measured_cp and base_frame (RCM provided by the SUJ) so all arms
+  must share the same reference frame, i.e. base frames must be set.
+  Pairs of arms with different reference frames are ignored, e.g. if
+  the SUJ are not available each arm is in its own base frame and all
+  RCMs would be at the origin.
+
+  The component runs in its own low priority thread and only reads
+  the arms' state tables so it doesn't add any latency to the arms'
+  control loops.  Capsules are sorted along the axis with the largest
+  spread (sweep and prune) and only pairs with overlapping bounding
+  boxes, inflated by the warning distance, are tested using the exact
+  segment to segment distance.  When two arms get closer than the
+  warning distance a warning is sent, when closer than the stop
+  distance the event "proximity_stop" is emitted with both arm names
+  (repeated every 0.5 second until the arms move away). */
+class CISST_EXPORT mtsIntuitiveResearchKitProximityMonitor: public mtsTaskPeriodic
+{
+    CMN_DECLARE_SERVICES(CMN_NO_DYNAMIC_CREATION, CMN_LOG_ALLOW_DEFAULT);
+
+public:
+    mtsIntuitiveResearchKitProximityMonitor(const std::string & componentName,
+                                            const double periodInSeconds);
+    ~mtsIntuitiveResearchKitProximityMonitor();
+
+    void Configure(const std::string & CMN_UNUSED(filename) = "") {};
+
+    /*! Configure from JSON, expects "arms", an array of arm names
+      used for the required interfaces.  Optional "radius" (shaft),
+      "body-radius", "body-length", "warning-distance" and
+      "stop-distance", all in meters. */
+    bool Configure(const Json::Value & jsonConfig);
+
+    void Startup(void);
+    void Run(void);
+    void Cleanup(void) {};
+
+    /*! Name of the required interfaces created for each arm. */
+    std::vector<std::string> ArmInterfaceNames(void) const;
+
+    /*! Minimum distance between segments [p1, q1] and [p2, q2]. */
+    static double SegmentsDistance(const vct3 & p1, const vct3 & q1,
+                                   const vct3 & p2, const vct3 & q2);
+
+protected:
+    typedef enum {LEVEL_CLEAR, LEVEL_WARNING, LEVEL_STOP} LevelType;
+
+    struct ArmData {
+        std::string m_name;
+        mtsFunctionRead measured_cp;
+        mtsFunctionRead base_frame;
+        prmPositionCartesianGet m_measured_cp;
+        vctFrm4x4 m_base_frame;
+        bool m_valid = false;
+    };
+
+    struct Capsule {
+        size_t arm;
+        vct3 p, q;
+        double radius;
+        vct3 lower, upper; // inflated bounding box
+    };
+
+    void UpdateCapsules(void);
+    void UpdatePair(const size_t arm1, const size_t arm2,
+                    const double distance, const double now);
+
+    std::vector<ArmData *> m_arms;
+    std::vector<Capsule> m_capsules;
+    std::vector<size_t> m_sorted;
+    // per pair of arms, index is arm1 * number of arms + arm2 with arm1 < arm2
+    std::vector<double> m_pair_distances;
+    std::vector<LevelType> m_pair_levels;
+    std::vector<double> m_pair_last_stop;
+
+    double m_radius = 0.005;
+    double m_body_radius = 0.04;
+    double m_body_length = 0.3;
+    double m_warning_distance = 0.05;
+    double m_stop_distance = 0.02;
+
+    double m_minimum_distance;
+    mtsInterfaceProvided * m_interface = nullptr;
+    mtsFunctionWrite proximity_stop;
+};
+
+CMN_DECLARE_SERVICES_INSTANTIATION(mtsIntuitiveResearchKitProximityMonitor);
+
+#endif // _mtsIntuitiveResearchKitProximityMonitor_h
@@ -0,0 +1,99 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-11-22
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitQtPlotDecimator_h
+#define _mtsIntuitiveResearchKitQtPlotDecimator_h
+
+#include <cstddef>
+
+/*! Min/max decimation for time plots.  Samples are grouped in
+  buckets, one per pixel column of the plot, and each bucket is
+  replaced by its minimum and maximum in chronological order.  Peaks
+  are preserved while the number of points sent to the plot only
+  depends on the plot's width, not the arm's rate.  To be used with
+  vctPlot2DBase::Signal, the signal size should be set to
+  NumberOfPoints. */
+class mtsIntuitiveResearchKitQtPlotDecimator
+{
+public:
+    /*! Set time span displayed (in seconds) and plot width (in
+      pixels).  Current bucket is dropped. */
+    inline void SetResolution(const double timeSpan, const int pixels) {
+        m_columns = (pixels > 1) ? static_cast<size_t>(pixels) : 1;
+        m_bucket_duration = timeSpan / static_cast<double>(m_columns);
+        m_empty = true;
+    }
+
+    /*! Number of points needed to display the whole time span */
+    inline size_t NumberOfPoints(void) const {
+        return 2 * m_columns;
+    }
+
+    /*! Add a sample, samples must be in chronological order.  When a
+      bucket is complete, calls append(time, value) for its minimum
+      and maximum.  Returns the number of points appended. */
+    template <typename _appendType>
+    inline size_t Add(const double time, const double value, _appendType append) {
+        size_t added = 0;
+        if (!m_empty && (time >= m_start + m_bucket_duration)) {
+            added = Flush(append);
+        }
+        if (m_empty) {
+            m_empty = false;
+            m_start = time;
+            m_min_time = m_max_time = time;
+            m_min = m_max = value;
+        } else if (value < m_min) {
+            m_min = value;
+            m_min_time = time;
+        } else if (value > m_max) {
+            m_max = value;
+            m_max_time = time;
+        }
+        return added;
+    }
+
+protected:
+    template <typename _appendType>
+    inline size_t Flush(_appendType append) {
+        m_empty = true;
+        if (m_min_time == m_max_time) {
+            append(m_min_time, m_min);
+            return 1;
+        }
+        if (m_min_time < m_max_time) {
+            append(m_min_time, m_min);
+            append(m_max_time, m_max);
+        } else {
+            append(m_max_time, m_max);
+            append(m_min_time, m_min);
+        }
+        return 2;
+    }
+
+    size_t m_columns = 1;
+    double m_bucket_duration = 0.0;
+    bool m_empty = true;
+    double m_start = 0.0;
+    double m_min_time = 0.0;
+    double m_min = 0.0;
+    double m_max_time = 0.0;
+    double m_max = 0.0;
+};
+
+#endif // _mtsIntuitiveResearchKitQtPlotDecimator_h
@@ -0,0 +1,90 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitQtRefresh_h
+#define _mtsIntuitiveResearchKitQtRefresh_h
+
+#include <json/json.h>
+
+class QWidget;
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitQtExport.h>
+
+/*! Global refresh policy shared by all dVRK widgets.  Each widget
+  owns an instance and calls Due at the beginning of its timerEvent,
+  the refresh is skipped if the widget is not visible (hidden tab,
+  minimized window) or if the refresh period hasn't elapsed.  The
+  period is adjusted at runtime: it is increased when the time spent
+  refreshing widgets exceeds the CPU budget and when running on
+  battery, decreased back to the configured period otherwise.  The
+  widget timers are not modified so the refresh period can't be
+  shorter than the period used to create the widgets.  All methods
+  must be called from the Qt thread. */
+class CISST_EXPORT mtsIntuitiveResearchKitQtRefresh
+{
+public:
+    /*! Configure from the "gui" section of the console
+      configuration file, all fields are optional:
+      - "period": refresh period in seconds, 0.05 by default
+      - "period-max": maximum period when throttled, 1.0 by default
+      - "cpu-budget": fraction of one core used by all widgets
+        refreshes before throttling, 0.1 by default, 0 to disable
+      - "battery-period": period used on battery, 0.2 by default
+        (Linux only)
+      - "report-interval": log refresh statistics every N seconds, 0
+        (default) to disable */
+    static bool Configure(const Json::Value & jsonConfig);
+
+    /*! Returns true if the widget should refresh now.  When true,
+      the caller must call End once done so the time can be
+      accounted for. */
+    bool Due(const QWidget * widget);
+    void End(void);
+
+    /*! Measures the refresh time between construction and
+      destruction, for timerEvent methods with multiple returns. */
+    class Scope {
+    public:
+        inline Scope(mtsIntuitiveResearchKitQtRefresh & refresh):
+            mRefresh(refresh) {}
+        inline ~Scope() {
+            mRefresh.End();
+        }
+    private:
+        mtsIntuitiveResearchKitQtRefresh & mRefresh;
+    };
+
+    /*! Current refresh period, in seconds. */
+    static double Period(void);
+
+    /*! Fraction of one core used by widget refreshes over the last
+      evaluation window (about one second). */
+    static double Load(void);
+
+    /*! Total time spent refreshing widgets since the beginning, in
+      seconds.  On Linux this is the CPU time of the Qt thread,
+      elapsed time otherwise. */
+    static double TotalTime(void);
+
+protected:
+    double mLastRefresh = 0.0;
+    double mStart = 0.0;
+};
+
+#endif // _mtsIntuitiveResearchKitQtRefresh_h
@@ -0,0 +1,122 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitRealTime_h
+#define _mtsIntuitiveResearchKitRealTime_h
+
+#include <string>
+#include <vector>
+
+#include <cisstMultiTask/mtsTaskPeriodic.h>
+#include <json/json.h>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Real-time settings for a thread: SCHED_FIFO priority, CPU
+  affinity, memory locking and stack prefaulting.  Settings are
+  applied to the calling thread so Apply must be called from the
+  component's thread, i.e. in Startup.  Only supported on Linux, the
+  process needs the proper limits (e.g. rtprio and memlock in
+  /etc/security/limits.conf) or failures are reported as errors and
+  the component runs with default attributes. */
+class CISST_EXPORT mtsIntuitiveResearchKitRealTime
+{
+public:
+    /*! Configure from JSON, all fields are optional:
+      - "priority": SCHED_FIFO priority, 1 to 99, 0 (default) to
+        keep the default scheduler
+      - "cpus": array of CPU indices for the thread affinity
+      - "lock-memory": call mlockall for current and future pages
+        (process wide), false by default
+      - "stack-prefault": number of bytes of stack to touch so later
+        page faults are avoided, 0 by default */
+    bool Configure(const Json::Value & jsonConfig, std::string & errorMessage);
+
+    /*! True if any setting is different from default. */
+    bool IsSet(void) const;
+
+    /*! Apply settings to calling thread, name is used for log
+      messages.  Returns false if any setting failed. */
+    bool Apply(const std::string & name) const;
+
+    inline void SetCPU(const int cpu) {
+        m_cpus.clear();
+        if (cpu >= 0) {
+            m_cpus.push_back(cpu);
+        }
+    }
+
+    inline const std::vector<int> & CPUs(void) const {
+        return m_cpus;
+    }
+
+    inline int Priority(void) const {
+        return m_priority;
+    }
+
+    /*! Task description used to check the configuration of all
+      threads, see CheckConflicts. */
+    struct TaskType {
+        std::string name;
+        double period;
+        mtsIntuitiveResearchKitRealTime settings;
+    };
+
+    /*! Log a warning for each pair of high rate tasks (period lower
+      or equal to highRatePeriod) pinned to the same CPU.  Returns the
+      number of conflicts found. */
+    static size_t CheckConflicts(const std::vector<TaskType> & tasks,
+                                 const double highRatePeriod = 2.0 * cmn_ms);
+
+protected:
+    int m_priority = 0;
+    std::vector<int> m_cpus;
+    bool m_lock_memory = false;
+    size_t m_stack_prefault = 0;
+};
+
+/*! Apply real-time settings to the thread of a component we don't
+  own (e.g. mtsRobotIO1394).  This task has no thread, it must be
+  connected to the ExecOut interface of the target component so its
+  Run is called from the target's thread.  Settings are applied on the
+  first Run. */
+class CISST_EXPORT mtsIntuitiveResearchKitRealTimeHook: public mtsTaskPeriodic
+{
+    CMN_DECLARE_SERVICES(CMN_NO_DYNAMIC_CREATION, CMN_LOG_ALLOW_DEFAULT);
+
+public:
+    mtsIntuitiveResearchKitRealTimeHook(const std::string & componentName,
+                                        const std::string & targetName,
+                                        const mtsIntuitiveResearchKitRealTime & settings);
+    ~mtsIntuitiveResearchKitRealTimeHook() {}
+
+    void Configure(const std::string & CMN_UNUSED(filename) = "") {};
+    void Startup(void) {};
+    void Run(void);
+    void Cleanup(void) {};
+
+protected:
+    std::string m_target_name;
+    mtsIntuitiveResearchKitRealTime m_settings;
+    bool m_applied = false;
+};
+
+CMN_DECLARE_SERVICES_INSTANTIATION(mtsIntuitiveResearchKitRealTimeHook);
+
+#endif // _mtsIntuitiveResearchKitRealTime_h
@@ -0,0 +1,237 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-27
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitRecorder_h
+#define _mtsIntuitiveResearchKitRecorder_h
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <vector>
+
+#include <cisstMultiTask/mtsTaskPeriodic.h>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+// "DVRKREC1", first 8 bytes of recorder files
+#define RECORDER_MAGIC "DVRKREC1"
+#define RECORDER_VERSION 1
+
+/*! Fixed size records produced by one arm.  The arm (producer)
+  writes a record at the end of each Run and the recorder (consumer)
+  drains all available records in its own thread.  Single producer,
+  single consumer ring, the producer never waits: if the ring is full
+  the record is dropped and counted.  Each record is an array of
+  doubles, the columns are defined by the fields (see FieldType) and
+  the number of joints:
+  - time (state table tic, in seconds)
+  - valid (bit mask, same as fields)
+  - measured_js: N positions, N velocities, N efforts
+  - setpoint_js: N positions, N velocities, N efforts
+  - measured_cp: 3x3 rotation (row major) and translation
+  - body/measured_cf: force and torque
+  Vectors shorter than N are padded with zeros. */
+class CISST_EXPORT mtsIntuitiveResearchKitRecorderChannel
+{
+public:
+    typedef enum {FIELD_MEASURED_JS = 1,
+                  FIELD_SETPOINT_JS = 2,
+                  FIELD_MEASURED_CP = 4,
+                  FIELD_BODY_MEASURED_CF = 8} FieldType;
+
+    mtsIntuitiveResearchKitRecorderChannel(const std::string & name,
+                                           const unsigned int fields,
+                                           const size_t numberOfJoints,
+                                           const size_t capacity);
+
+    inline const std::string & Name(void) const {
+        return m_name;
+    }
+
+    inline unsigned int Fields(void) const {
+        return m_fields;
+    }
+
+    inline size_t NumberOfJoints(void) const {
+        return m_number_of_joints;
+    }
+
+    /*! Number of doubles per record. */
+    inline size_t RecordSize(void) const {
+        return m_record_size;
+    }
+
+    /*! Names of all columns, in record order. */
+    std::vector<std::string> ColumnNames(void) const;
+
+    /*! Producer side.  Returns a pointer to the next record or
+      nullptr if the ring is full.  Commit must be called once the
+      record has been filled. */
+    inline double * Reserve(void) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if ((head - m_tail.load(std::memory_order_acquire)) >= m_capacity) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return m_buffer.data() + (head % m_capacity) * m_record_size;
+    }
+
+    inline void Commit(void) {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /*! Consumer side.  Number of records available and pointer to
+      the oldest one, records are contiguous up to the end of the
+      ring so the count might be lower than the total available. */
+    inline size_t Available(const double * & records) const {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t index = tail % m_capacity;
+        records = m_buffer.data() + index * m_record_size;
+        return std::min(head - tail, m_capacity - index);
+    }
+
+    inline void Release(const size_t count) {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    inline size_t Dropped(void) const {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+protected:
+    std::string m_name;
+    unsigned int m_fields;
+    size_t m_number_of_joints;
+    size_t m_record_size;
+    size_t m_capacity;
+    std::vector<double> m_buffer;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+    std::atomic<size_t> m_dropped;
+};
+
+/*! Record arm data at full rate in a binary file.  Arms fill a
+  mtsIntuitiveResearchKitRecorderChannel (see
+  mtsIntuitiveResearchKitArm::SetRecorderChannel) and the recorder's
+  thread periodically copies all new records to the file, which is
+  memory mapped and grown by chunks.  File format:
+  - 8 bytes: RECORDER_MAGIC
+  - uint32: version
+  - uint32: size of the schema in bytes (S)
+  - S bytes: schema, JSON text padded with spaces to 8 bytes,
+    {"arms": [{"name": ..., "columns": [...], "record-size": ...}]}
+  - records: uint32 arm index (in schema), uint32 unused, then
+    record-size doubles
+  All values use the host byte order.  Use
+  sawIntuitiveResearchKitRecorderConvert to convert to CSV. */
+class CISST_EXPORT mtsIntuitiveResearchKitRecorder: public mtsTaskPeriodic
+{
+    CMN_DECLARE_SERVICES(CMN_NO_DYNAMIC_CREATION, CMN_LOG_ALLOW_DEFAULT);
+
+public:
+    mtsIntuitiveResearchKitRecorder(const std::string & componentName,
+                                    const double periodInSeconds);
+    ~mtsIntuitiveResearchKitRecorder();
+
+    void Configure(const std::string & CMN_UNUSED(filename) = "") {};
+
+    /*! Set the output file name, must be called before Startup. */
+    inline void SetFileName(const std::string & fileName) {
+        m_file_name = fileName;
+    }
+
+    /*! Create a channel for an arm, the channel is owned by the
+      recorder.  Must be called before Startup. */
+    mtsIntuitiveResearchKitRecorderChannel * AddChannel(const std::string & name,
+                                                        const unsigned int fields,
+                                                        const size_t numberOfJoints);
+
+    void Startup(void);
+    void Run(void);
+    void Cleanup(void);
+
+protected:
+    /*! Copy data to the memory mapped file, maps a new chunk when
+      needed.  Returns false if the file can't be grown. */
+    bool Write(const void * data, const size_t size);
+    bool MapChunk(const size_t offset);
+    void Drain(void);
+
+    std::string m_file_name;
+    std::vector<mtsIntuitiveResearchKitRecorderChannel *> m_channels;
+    size_t m_chunk_size;
+    int m_file_descriptor;
+    char * m_chunk;
+    size_t m_chunk_offset;  // offset of current chunk in file
+    size_t m_chunk_used;    // bytes used in current chunk
+    bool m_error;
+    size_t m_records;
+};
+
+CMN_DECLARE_SERVICES_INSTANTIATION(mtsIntuitiveResearchKitRecorder);
+
+/*! Read files created by mtsIntuitiveResearchKitRecorder, records
+  are read one at a time so files can be larger than memory. */
+class CISST_EXPORT mtsIntuitiveResearchKitRecorderReader
+{
+public:
+    /*! Open file and parse header.  Returns false with an error
+      message if the file can't be read or the version is not
+      supported. */
+    bool Open(const std::string & fileName, std::string & errorMessage);
+
+    inline size_t NumberOfArms(void) const {
+        return m_arms.size();
+    }
+
+    inline const std::string & ArmName(const size_t arm) const {
+        return m_arms.at(arm).name;
+    }
+
+    inline const std::vector<std::string> & ColumnNames(const size_t arm) const {
+        return m_arms.at(arm).columns;
+    }
+
+    /*! Index of arm by name, -1 if not found. */
+    int ArmIndex(const std::string & name) const;
+
+    /*! Index of column for a given arm, -1 if not found. */
+    int ColumnIndex(const size_t arm, const std::string & column) const;
+
+    /*! Read next record, returns false at the end of the file or if
+      the file is truncated or corrupted (see Truncated). */
+    bool Next(size_t & arm, std::vector<double> & record);
+
+    inline bool Truncated(void) const {
+        return m_truncated;
+    }
+
+protected:
+    struct ArmType {
+        std::string name;
+        std::vector<std::string> columns;
+        size_t record_size;
+    };
+    std::ifstream m_file;
+    std::vector<ArmType> m_arms;
+    bool m_truncated = false;
+};
+
+#endif // _mtsIntuitiveResearchKitRecorder_h
@@ -19,12 +19,17 @@ http://www.cisst.org/cisst/license.txt.
 #ifndef _mtsIntuitiveResearchKitSUJ_h
 #define _mtsIntuitiveResearchKitSUJ_h
 
+#include <cisstCommon/cmnUnits.h>
 #include <cisstMultiTask/mtsTaskPeriodic.h>
 #include <cisstParameterTypes/prmEventButton.h>
 #include <cisstParameterTypes/prmPositionCartesianGet.h>
 #include <cisstParameterTypes/prmOperatingState.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKit.h>
 #include <sawIntuitiveResearchKit/mtsStateMachine.h>
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRealTime.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitHealth.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitMessages.h>
 
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
 
@@ -50,7 +55,33 @@ public:
 
     void set_simulated(void);
 
+    /*! Real-time settings (priority, CPU affinity...) applied to the
+      component's thread in Startup.  Must be called before the
+      component is started. */
+    inline void SetRealTime(const mtsIntuitiveResearchKitRealTime & realTime) {
+        m_real_time = realTime;
+    }
+
+    /*! Period used to compute the number of samples per mux index
+      when the SUJ doesn't have its own thread, see
+      mtsIntuitiveResearchKitArm::SetChainedPeriod.  Must be called
+      before Configure. */
+    inline void SetChainedPeriod(const double period) {
+        // keep default so ExpectedPeriod never returns 0
+        if (period > 0.0) {
+            m_chained_period = period;
+        }
+    }
+
+    inline double ExpectedPeriod(void) const {
+        const double period = this->GetPeriodicity();
+        return (period > 0.0) ? period : m_chained_period;
+    }
+
 protected:
+    mtsIntuitiveResearchKitRealTime m_real_time;
+    mtsIntuitiveResearchKitHeartbeat m_heartbeat;
+    double m_chained_period = mtsIntuitiveResearchKit::ArmPeriod;
 
     void Init(void);
 
@@ -60,6 +91,9 @@ protected:
     /*! Logic used to read the potentiometer values and updated the
       appropriate joint values based on the mux state. */
     void GetAndConvertPotentiometerValues(void);
+    void UpdateArmPositions(mtsIntuitiveResearchKitSUJArmData * arm,
+                            const size_t armIndex,
+                            const bool primaryOnly);
 
     void UpdateOperatingStateAndBusy(const prmOperatingState::StateType & state,
                                      const bool isBusy);
@@ -143,6 +177,9 @@ protected:
     double mMuxTimer;
     vctBoolVec mMuxState;
     size_t mMuxIndex, mMuxIndexExpected;
+    /*! Rate limited messages, mux errors can happen every cycle */
+    mtsIntuitiveResearchKitMessages m_messages;
+    size_t m_mux_message_site;
 
     // Functions to control motor on SUJ3
     struct {
@@ -160,10 +197,33 @@ protected:
     double mPreviousTic;
     vctDoubleVec mBrakeCurrents;
 
-    vctDynamicVector<vctDoubleVec> mVoltageSamples;
-    const size_t mVoltageSamplesNumber;
+    size_t mVoltageSamplesNumber; // maximum number of samples per mux index
     size_t mVoltageSamplesCounter;
+    bool mVoltageSamplesComplete;
+    /*! Multiplexer scan settings, see "mux" in configuration file.
+      The scan moves to the next mux index after samples_min samples
+      if all samples are within noise_tolerance (volts, 0 to always
+      use mVoltageSamplesNumber samples).  Partial updates publish
+      positions based on primary pots only, half way through the
+      scan.  The default number of samples is computed from
+      "sample-time" (seconds) and the SUJ period, "samples-max" and
+      "samples-min" override it. */
+    struct {
+        double settle_time = 30.0 * cmn_ms; // to make sure A2D stabilizes
+        size_t samples_min;
+        double noise_tolerance = 0.0;
+        bool partial_updates = false;
+        vctDoubleVec sample_min, sample_max;
+    } m_mux_scan;
     vctDoubleVec mVoltages;
+    // running sum of analog inputs for current mux index
+    vctDoubleVec mVoltageSum;
+    /*! Averaged voltages, one row per mux index and one column per
+      analog input (i.e. arm).  Pot scales, offsets and positions use
+      the same layout for the first 12 rows (primary then secondary
+      pots) so all arms are converted in a single pass. */
+    vctDoubleMat mVoltagesByMux;
+    vctDoubleMat mPotScales, mPotOffsets, mPotPositions;
     vctFixedSizeVector<mtsIntuitiveResearchKitSUJArmData *, 4> Arms;
     size_t ECMIndex;
 
@@ -0,0 +1,222 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-24
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsIntuitiveResearchKitSharedMemory_h
+#define _mtsIntuitiveResearchKitSharedMemory_h
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include <cisstMultiTask/mtsTaskPeriodic.h>
+#include <cisstParameterTypes/prmStateJoint.h>
+#include <cisstParameterTypes/prmPositionCartesianGet.h>
+#include <cisstParameterTypes/prmVelocityCartesianGet.h>
+#include <cisstParameterTypes/prmPositionJointSet.h>
+#include <cisstParameterTypes/prmPositionCartesianSet.h>
+#include <cisstParameterTypes/prmOperatingState.h>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+// magic number, "DVRM", and version of shared memory layout
+#define SHARED_MEMORY_MAGIC 0x4D525644
+#define SHARED_MEMORY_VERSION 1
+#define SHARED_MEMORY_MAX_ARMS 8
+#define SHARED_MEMORY_MAX_JOINTS 16
+#define SHARED_MEMORY_NAME_SIZE 32
+#define SHARED_MEMORY_STATE_RING_SIZE 8
+#define SHARED_MEMORY_COMMAND_RING_SIZE 4
+
+/*! \name Shared memory layout.
+
+  All structures are plain old data so they can be used by processes
+  that don't use cisst, the only requirement is a C++11 compiler
+  (lock free std::atomic).  Each slot is protected by a sequence lock:
+  the writer increments Sequence before and after updating the slot so
+  an odd value indicates a write in progress.  Readers copy the slot
+  then check that Sequence didn't change, see
+  mtsIntuitiveResearchKitSharedMemory::ReadSlot.  Rings have a
+  single writer and Head counts the number of slots written, the
+  latest slot is at index (Head - 1) % ring size.  Positions are in
+  meters and radians, frames are stored as a 3x3 row major rotation
+  followed by the translation. */
+//@{
+struct mtsSharedMemoryArmState {
+    std::atomic<uint32_t> Sequence;
+    uint32_t NumberOfJoints;
+    uint64_t Counter;
+    double Timestamp;
+    // see prmOperatingState::StateType
+    int32_t OperatingState;
+    uint32_t IsHomed;
+    uint32_t IsBusy;
+    // bit mask for validity in order measured_js, setpoint_js, measured_cp, measured_cv
+    uint32_t Valid;
+    double MeasuredPosition[SHARED_MEMORY_MAX_JOINTS];
+    double MeasuredVelocity[SHARED_MEMORY_MAX_JOINTS];
+    double MeasuredEffort[SHARED_MEMORY_MAX_JOINTS];
+    double SetpointPosition[SHARED_MEMORY_MAX_JOINTS];
+    double SetpointVelocity[SHARED_MEMORY_MAX_JOINTS];
+    double SetpointEffort[SHARED_MEMORY_MAX_JOINTS];
+    double MeasuredFrame[12];
+    double MeasuredTwist[6];
+};
+
+struct mtsSharedMemoryArmCommand {
+    typedef enum {NONE = 0, SERVO_JP = 1, SERVO_CP = 2} CommandType;
+    std::atomic<uint32_t> Sequence;
+    // see CommandType
+    uint32_t Type;
+    uint32_t NumberOfJoints;
+    uint32_t Padding;
+    double Timestamp;
+    double Goal[SHARED_MEMORY_MAX_JOINTS];
+    double Frame[12];
+};
+
+struct mtsSharedMemoryArm {
+    char Name[SHARED_MEMORY_NAME_SIZE];
+    std::atomic<uint64_t> StateHead;
+    mtsSharedMemoryArmState State[SHARED_MEMORY_STATE_RING_SIZE];
+    std::atomic<uint64_t> CommandHead;
+    mtsSharedMemoryArmCommand Command[SHARED_MEMORY_COMMAND_RING_SIZE];
+};
+
+struct mtsSharedMemoryLayout {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t NumberOfArms;
+    // 0 if the commands are ignored
+    uint32_t CommandsEnabled;
+    mtsSharedMemoryArm Arms[SHARED_MEMORY_MAX_ARMS];
+};
+//@}
+
+/*! Publish the state of multiple arms in a POSIX shared memory
+  segment and optionally accept servo_jp/servo_cp commands from the
+  same segment.  This is meant for consumers running on the same
+  computer, reading the state doesn't require any system call.  The
+  segment name is "/" + component name, it is created in Startup and
+  removed in Cleanup.  The segment is only accessible by the user
+  running the console and Startup fails if it already exists.  Only
+  available on POSIX systems. */
+class CISST_EXPORT mtsIntuitiveResearchKitSharedMemory: public mtsTaskPeriodic
+{
+    CMN_DECLARE_SERVICES(CMN_NO_DYNAMIC_CREATION, CMN_LOG_ALLOW_DEFAULT);
+
+public:
+    mtsIntuitiveResearchKitSharedMemory(const std::string & componentName,
+                                        const double periodInSeconds);
+    ~mtsIntuitiveResearchKitSharedMemory();
+
+    void Configure(const std::string & CMN_UNUSED(filename) = "") {};
+
+    /*! Configure from JSON, expects "arms", an array of arm names
+      (used for the required interfaces and in the shared memory
+      layout) and optionally "commands" (boolean, false by default)
+      to accept commands from the shared memory. */
+    bool Configure(const Json::Value & jsonConfig);
+
+    void Startup(void);
+    void Run(void);
+    void Cleanup(void);
+
+    /*! Name of the required interfaces created for each arm. */
+    std::vector<std::string> ArmInterfaceNames(void) const;
+
+    /*! Name of the shared memory segment. */
+    inline const std::string & SegmentName(void) const {
+        return m_segment_name;
+    }
+
+    /*! Read a slot protected by a sequence lock.  Returns false if
+      the slot is being written, the caller should try again. */
+    template <typename _slotType>
+    static bool ReadSlot(const _slotType & slot, _slotType & copy);
+
+    /*! Write a slot protected by a sequence lock, single writer. */
+    template <typename _slotType>
+    static void WriteSlot(_slotType & slot, const _slotType & data);
+
+protected:
+    struct ArmData {
+        std::string m_name;
+        mtsFunctionRead measured_js;
+        mtsFunctionRead setpoint_js;
+        mtsFunctionRead measured_cp;
+        mtsFunctionRead measured_cv;
+        mtsFunctionRead operating_state;
+        mtsFunctionWrite servo_jp;
+        mtsFunctionWrite servo_cp;
+        prmStateJoint m_measured_js;
+        prmStateJoint m_setpoint_js;
+        prmPositionCartesianGet m_measured_cp;
+        prmVelocityCartesianGet m_measured_cv;
+        prmOperatingState m_operating_state;
+        prmPositionJointSet m_servo_jp;
+        prmPositionCartesianSet m_servo_cp;
+        uint64_t m_last_command = 0;
+        // local copies so Run doesn't touch shared memory more than needed
+        mtsSharedMemoryArmState m_state;
+        mtsSharedMemoryArmCommand m_command;
+    };
+
+    void UpdateState(ArmData * arm, mtsSharedMemoryArm & shared);
+    void ProcessCommand(ArmData * arm, mtsSharedMemoryArm & shared);
+
+    std::vector<ArmData *> m_arms;
+    bool m_commands_enabled = false;
+    std::string m_segment_name;
+    int m_file_descriptor = -1;
+    mtsSharedMemoryLayout * m_layout = nullptr;
+    size_t m_commands_dropped = 0;
+};
+
+CMN_DECLARE_SERVICES_INSTANTIATION(mtsIntuitiveResearchKitSharedMemory);
+
+template <typename _slotType>
+bool mtsIntuitiveResearchKitSharedMemory::ReadSlot(const _slotType & slot, _slotType & copy)
+{
+    const uint32_t before = slot.Sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+        return false;
+    }
+    // copy everything but the sequence
+    memcpy(reinterpret_cast<char *>(&copy) + sizeof(slot.Sequence),
+           reinterpret_cast<const char *>(&slot) + sizeof(slot.Sequence),
+           sizeof(_slotType) - sizeof(slot.Sequence));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint32_t after = slot.Sequence.load(std::memory_order_relaxed);
+    copy.Sequence.store(after, std::memory_order_relaxed);
+    return (before == after);
+}
+
+template <typename _slotType>
+void mtsIntuitiveResearchKitSharedMemory::WriteSlot(_slotType & slot, const _slotType & data)
+{
+    const uint32_t sequence = slot.Sequence.load(std::memory_order_relaxed);
+    slot.Sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(reinterpret_cast<char *>(&slot) + sizeof(slot.Sequence),
+           reinterpret_cast<const char *>(&data) + sizeof(slot.Sequence),
+           sizeof(_slotType) - sizeof(slot.Sequence));
+    slot.Sequence.store(sequence + 2, std::memory_order_release);
+}
+
+#endif // _mtsIntuitiveResearchKitSharedMemory_h
@@ -6,7 +6,7 @@
   Author(s):  Peter Kazanzides
   Created on: 2013-12-02
 
-  (C) Copyright 2013-2014 Johns Hopkins University (JHU), All Rights Reserved.
+  (C) Copyright 2013-2021 Johns Hopkins University (JHU), All Rights Reserved.
 
 --- begin cisst license - do not edit ---
 
@@ -23,16 +23,59 @@ http://www.cisst.org/cisst/license.txt.
 
 #include <cisstOSAbstraction/osaSocket.h>
 #include <cisstMultiTask/mtsTaskPeriodic.h>
+#include <cisstParameterTypes/prmStateJoint.h>
+#include <cisstParameterTypes/prmPositionCartesianGet.h>
+#include <cisstParameterTypes/prmVelocityCartesianGet.h>
 
 #include <cisstMultiTask/mtsForwardDeclarations.h>
 class prmEventButton;
 
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
 
+// magic number, "DVRS", and version for multi-arm packets
+#define UDP_STREAMER_MAGIC 0x53525644
+#define UDP_STREAMER_VERSION 1
+
+/*! UDP streamer.
+
+  By default, i.e. if the component is not configured using a JSON
+  object, the streamer sends a 9 doubles packet for a single arm
+  (interface "Arm") and the buttons "Clutch" and "Coag".
+
+  When configured with a JSON object, the streamer sends a single
+  datagram per period for all the configured arms, using one required
+  interface per arm (named after the arm).  Each arm can select the
+  data to send ("measured_js", "measured_cp", "measured_cv" and/or
+  "jaw").  All values use the host byte order.  The packet starts
+  with a 24 bytes header:
+  - uint32: magic number UDP_STREAMER_MAGIC
+  - uint16: version UDP_STREAMER_VERSION
+  - uint16: number of arms
+  - uint32: sequence number, incremented for each packet sent
+  - uint32: total size of packet in bytes
+  - double: time of the packet (relative time in seconds)
+
+  followed by one block per arm:
+  - uint16: index of the arm, i.e. order in configuration file
+  - uint16: fields included in the block, see FieldType
+  - uint16: fields that are valid
+  - uint16: number of joints (N)
+  - double: most recent timestamp of all data read for this arm
+  - measured_js: N positions, N velocities, N efforts
+  - measured_cp: x, y, z, qw, qx, qy, qz
+  - measured_cv: vx, vy, vz, wx, wy, wz
+  - jaw: position, velocity, effort
+*/
 class CISST_EXPORT mtsIntuitiveResearchKitUDPStreamer : public mtsTaskPeriodic
 {
     CMN_DECLARE_SERVICES(CMN_NO_DYNAMIC_CREATION, CMN_LOG_ALLOW_DEFAULT);
 
+ public:
+    typedef enum {FIELD_MEASURED_JS = 1,
+                  FIELD_MEASURED_CP = 2,
+                  FIELD_MEASURED_CV = 4,
+                  FIELD_JAW = 8} FieldType;
+
  protected:
 
     osaSocket Socket;
@@ -47,6 +90,30 @@ class CISST_EXPORT mtsIntuitiveResearchKitUDPStreamer : public mtsTaskPeriodic
     void EventHandlerManipClutch(const prmEventButton &button);
     void EventHandlerCoag(const prmEventButton &button);
 
+    /*! Send the legacy single arm packet */
+    void RunSingleArm(void);
+
+    /*! Send one packet for all arms */
+    void RunMultiArm(void);
+
+    // multi-arm mode
+    struct ArmData {
+        std::string m_name;
+        unsigned short m_fields = 0;
+        mtsFunctionRead measured_js;
+        mtsFunctionRead measured_cp;
+        mtsFunctionRead measured_cv;
+        mtsFunctionRead jaw_measured_js;
+        prmStateJoint m_measured_js;
+        prmPositionCartesianGet m_measured_cp;
+        prmVelocityCartesianGet m_measured_cv;
+        prmStateJoint m_jaw_measured_js;
+    };
+    bool mMultiArm;
+    std::vector<ArmData *> mArms;
+    std::vector<char> mPacket;
+    unsigned int mSequence;
+
  public:
     /*! Constructor
         \param name Name of the component
@@ -64,6 +131,23 @@ class CISST_EXPORT mtsIntuitiveResearchKitUDPStreamer : public mtsTaskPeriodic
     */
     void Configure(const std::string &ipPort);
 
+    /*! Configure multi-arm streaming.  Expected fields are
+      "destination" (IP address and port number, separated by ':')
+      and "arms", an array of objects with "name" (used for the
+      required interface), "fields" (array of strings from
+      "measured_js", "measured_cp", "measured_cv" and "jaw", defaults
+      to "measured_cp" and "jaw") and "jaw-command" (read command used
+      for the jaw, defaults to "jaw/measured_js").  Returns false if
+      the configuration is invalid.  Arms can't be added or removed
+      once the component has been started.  The legacy "Arm",
+      "Clutch" and "Coag" required interfaces are removed. */
+    bool Configure(const Json::Value & jsonConfig);
+
+    /*! Name of the required interfaces created for each arm in
+      multi-arm mode, in the same order as the arm index in the
+      packets. */
+    std::vector<std::string> ArmInterfaceNames(void) const;
+
     void Startup(void);
 
     void Run(void);
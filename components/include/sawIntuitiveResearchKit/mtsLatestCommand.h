@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-25
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsLatestCommand_h
+#define _mtsLatestCommand_h
+
+#include <atomic>
+#include <cstddef>
+
+/*! Single slot for a command argument where the latest value wins.
+  Write can be called from any thread (i.e. non queued command) and
+  overwrites the previous value if it hasn't been used yet.  Fetch
+  and Value are called by the component's thread.  Values are stored
+  in a triple buffer so the consumer never waits for a writer;
+  writers only wait for each other.  Used for servo commands, when a
+  client streams faster than the component's period only the most
+  recent setpoint is processed. */
+template <class _argumentType>
+class mtsLatestCommand
+{
+public:
+    mtsLatestCommand(void):
+        mMiddle(1),
+        mBack(2),
+        mFront(0),
+        mReceived(0),
+        mSuperseded(0)
+    {
+        mWriting.clear();
+        mSequences[0] = mSequences[1] = mSequences[2] = 0;
+    }
+
+    /*! Store new value, sequence is used by the consumer to
+      preserve the order of commands sent to different slots. */
+    void Write(const _argumentType & value, const size_t sequence) {
+        while (mWriting.test_and_set(std::memory_order_acquire)) {}
+        mBuffers[mBack] = value;
+        mSequences[mBack] = sequence;
+        const unsigned int previous = mMiddle.exchange(mBack | FRESH, std::memory_order_acq_rel);
+        mBack = previous & INDEX_MASK;
+        if (previous & FRESH) {
+            mSuperseded.fetch_add(1, std::memory_order_relaxed);
+        }
+        mReceived.fetch_add(1, std::memory_order_relaxed);
+        mWriting.clear(std::memory_order_release);
+    }
+
+    /*! Check if a new value has been written since last call and
+      if so, make it available using Value. */
+    bool Fetch(void) {
+        if (!(mMiddle.load(std::memory_order_acquire) & FRESH)) {
+            return false;
+        }
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    /*! Last value fetched. */
+    inline const _argumentType & Value(void) const {
+        return mBuffers[mFront];
+    }
+
+    /*! Sequence provided with last value fetched. */
+    inline size_t Sequence(void) const {
+        return mSequences[mFront];
+    }
+
+    /*! Number of values written. */
+    inline size_t Received(void) const {
+        return mReceived.load(std::memory_order_relaxed);
+    }
+
+    /*! Number of values overwritten before being fetched. */
+    inline size_t Superseded(void) const {
+        return mSuperseded.load(std::memory_order_relaxed);
+    }
+
+    inline void ResetCounters(void) {
+        mReceived.store(0, std::memory_order_relaxed);
+        mSuperseded.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    enum {FRESH = 4, INDEX_MASK = 3};
+    _argumentType mBuffers[3];
+    size_t mSequences[3];
+    // index of buffer shared between writer and reader, with fresh flag
+    std::atomic<unsigned int> mMiddle;
+    // index used by writers, protected by mWriting
+    unsigned int mBack;
+    // index used by reader
+    unsigned int mFront;
+    std::atomic_flag mWriting;
+    std::atomic<size_t> mReceived;
+    std::atomic<size_t> mSuperseded;
+};
+
+#endif // _mtsLatestCommand_h
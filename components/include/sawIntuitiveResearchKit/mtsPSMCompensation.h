@@ -5,7 +5,7 @@
   Author(s):  Grace Chrysilla
   Created on: 2017-07-18
 
-  (C) Copyright 2013-2017 Johns Hopkins University (JHU), All Rights Reserved.
+  (C) Copyright 2013-2021 Johns Hopkins University (JHU), All Rights Reserved.
 
 --- begin cisst license - do not edit ---
 
@@ -24,6 +24,13 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstMultiTask/mtsTaskPeriodic.h>
 #include <cisstParameterTypes/prmStateJoint.h>
 
+#include <sawIntuitiveResearchKit/robPSMCompensation.h>
+
+/*! Stand alone component to compute the compensated joint state of a
+  PSM, reading the joint state from the PID component.  The same
+  compensation can be applied directly in the PSM component (see
+  "compensation" in the PSM configuration file) which avoids an extra
+  thread and provides the compensated state in the same cycle. */
 class mtsPSMCompensation: public mtsTaskPeriodic {
 	CMN_DECLARE_SERVICES(CMN_NO_DYNAMIC_CREATION, CMN_LOG_ALLOW_DEFAULT);
 
@@ -34,19 +41,13 @@ protected:
 	// functions used in the interface required to send commands to PID component
 	mtsFunctionRead GetJointState;
 
-	// json value for joint 1
-	double complianceA1, complianceB1, complianceC1, complianceD1;
-	double torqueOffsetA1;
-	double backlash1;
-
-	// json value for joint 2
-	double complianceA2, complianceB2, complianceC2, complianceD2;
-	double torqueOffsetA2, torqueOffsetB2;
-	double backlash2;
+	// parameters from JSON, one arm or multiple arms using component name
+	robPSMCompensation mCompensation;
+	const robPSMCompensation::ParametersType * mParameters = 0;
 
 	void SetupInterfaces(void); // setting up both requiredInterface and providedInterface
 	void ComputeCompensation();
-	prmStateJoint GetCorrectedJointState() const;
+	const prmStateJoint & GetCorrectedJointState() const;
 
 public:
 	mtsPSMCompensation(const std::string & componentName, double periodInSecond);
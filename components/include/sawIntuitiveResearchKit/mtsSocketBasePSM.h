@@ -19,6 +19,11 @@ http://www.cisst.org/cisst/license.txt.
 #ifndef _mtsSocketBasePSM_h
 #define _mtsSocketBasePSM_h
 
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
 #include <cisstCommon/cmnUnits.h>
 #include <cisstOSAbstraction/osaSocket.h>
 #include <cisstMultiTask/mtsTaskPeriodic.h>
@@ -31,6 +36,21 @@ http://www.cisst.org/cisst/license.txt.
 
 #define TIMEOUT 4.0 * cmn_ms
 
+// fixed layout binary packets, see mtsSocketBasePSM::Encode/Decode
+#define POD_MAGIC 0x4B525644 // "DVRK" in little endian
+#define POD_VERSION 1
+#define POD_MSG_SIZE 144
+// multiple arms in a single packet, header then one record per arm
+#define POD_BUNDLE_HEADER_SIZE 40
+#define POD_RECORD_SIZE 120
+#define POD_MAX_ARMS 8
+// single arm command followed by previous commands, same record layout
+#define POD_MAX_REDUNDANCY 6
+// compact packets, quantized values with deltas, header then varints
+#define POD_VERSION_COMPACT 2
+#define COMPACT_HEADER_SIZE 42
+#define COMPACT_MAX_SIZE 122
+
 class mtsSocketBasePSM : public mtsTaskPeriodic
 {
 
@@ -40,11 +60,165 @@ public:
                      bool isServer);
     ~mtsSocketBasePSM() {}
 
-    void Startup(void) {}
+    void Startup(void);
     void Cleanup(void);
     void UpdateStatistics(void);
 
+    /*! Receive mode.  BLOCKING receives in Run with a timeout of
+      TIMEOUT.  THREAD uses a dedicated thread to receive packets, the
+      latest packet is handed over using a lock free triple buffer so
+      Run never blocks.  In both cases, packets received between two
+      iterations are coalesced and only the newest one is used.  Must
+      be set before the component is started. */
+    typedef enum {RECEIVE_BLOCKING, RECEIVE_THREAD} ReceiveModeType;
+
+    inline void SetReceiveMode(const ReceiveModeType mode) {
+        mReceiveMode = mode;
+    }
+
+    /*! Wire format.  CISST uses cmnData binary serialization (legacy,
+      native endianness and sizes).  POD uses a fixed layout, little
+      endian packet encoded and decoded in place, starting with
+      POD_MAGIC and POD_VERSION so receivers can detect the format of
+      each packet.  COMPACT uses the same header with version
+      POD_VERSION_COMPACT followed by quantized values (translation,
+      rotation quaternion and jaw), encoded as variable length integers
+      relative to the last packet acknowledged by the other side (see
+      SetCompactResolution).  The server replies using the format
+      received, a client falls back to POD if its compact packets are
+      not answered (i.e. older server or link down) and keeps sending
+      a compact packet once in a while, compact is used again as soon
+      as the server replies with a compact packet. */
+    typedef enum {WIRE_CISST, WIRE_POD, WIRE_COMPACT} WireFormatType;
+
+    inline void SetWireFormat(const WireFormatType format) {
+        mWireFormat = format;
+    }
+
+    inline WireFormatType WireFormat(void) const {
+        return mWireFormat;
+    }
+
+    /*! Encode in buffer using the fixed layout, returns number of bytes
+      used.  Buffer must be at least POD_MSG_SIZE. */
+    static size_t Encode(const socketCommandPSM & command, char * buffer);
+    static size_t Encode(const socketStatePSM & state, char * buffer);
+
+    /*! Decode from buffer, returns false if the packet doesn't use the
+      fixed layout (magic number, version, type or size). */
+    static bool Decode(const char * buffer, const size_t size, socketCommandPSM & command);
+    static bool Decode(const char * buffer, const size_t size, socketStatePSM & state);
+
+    /*! Check if buffer starts with the fixed layout magic number,
+      this includes compact packets */
+    static bool IsPOD(const char * buffer, const size_t size);
+
+    /*! Check if buffer is a compact packet */
+    static bool IsCompact(const char * buffer, const size_t size);
+
+    /*! Compact format settings.  Translation resolution is in meters,
+      rotation resolution is used for the quaternion components and
+      the jaw.  Values are relative to the last packet acknowledged,
+      a keyframe (absolute values) is sent at least every
+      keyframePeriod packets.  Resolutions are sent in each packet so
+      both sides can use different settings. */
+    inline void SetCompactResolution(const double translation, const double rotation) {
+        // decoder uses the single precision values sent
+        mCompact.ResolutionTranslation = static_cast<float>(translation);
+        mCompact.ResolutionRotation = static_cast<float>(rotation);
+    }
+
+    inline void SetCompactKeyframePeriod(const unsigned int period) {
+        mCompact.KeyframePeriod = period;
+    }
+
+    /*! Multiple arms in one packet (fixed layout only).  The packet
+      header (ids and timestamps) is the header of the first arm, it
+      is used for the link statistics and clock synchronization.
+      Each arm has a record tagged with its index and its own
+      sequence number (Header.Id).  Decode only updates arms with a
+      newer sequence number (or restarted, i.e. 1) and sets the
+      corresponding bits in updated.  Records for unknown arms are
+      ignored. */
+    static size_t Encode(const std::vector<socketCommandPSM *> & commands, char * buffer);
+    static size_t Encode(const std::vector<socketStatePSM *> & states, char * buffer);
+    static bool Decode(const char * buffer, const size_t size,
+                       std::vector<socketCommandPSM *> & commands, uint32_t & updated);
+    static bool Decode(const char * buffer, const size_t size,
+                       std::vector<socketStatePSM *> & states, uint32_t & updated);
+
+    /*! Check if buffer is a multiple arms packet */
+    static bool IsBundle(const char * buffer, const size_t size);
+
+    /*! Fixed layout command followed by the previous commands sent
+      (up to POD_MAX_REDUNDANCY, oldest first) so the receiver can
+      recover commands from lost packets without retransmission.
+      Timestamps of previous commands are sent relative to the
+      packet's timestamp. */
+    static size_t EncodeRedundant(const socketCommandPSM & command,
+                                  const socketCommandPSM * previous, const size_t nbPrevious,
+                                  char * buffer);
+    static bool DecodeRedundant(const char * buffer, const size_t size,
+                                socketCommandPSM & command,
+                                socketCommandPSM * previous, size_t & nbPrevious);
+
+    /*! Check if buffer is a command with redundancy */
+    static bool IsRedundant(const char * buffer, const size_t size);
+
+    /*! Number of arms sharing this connection. */
+    inline size_t NumberOfArms(void) const {
+        return mCommands.size();
+    }
+
+    /*! Playout delay, only used by the server.  Commands are applied
+      at their send time (converted from the remote clock using the
+      estimated offset) plus this delay so network jitter doesn't
+      change when commands are applied.  A delay of 0 (default)
+      applies commands as soon as they are received. */
+    inline void SetPlayoutDelay(const double delay) {
+        mPlayoutDelay = delay;
+    }
+
+    enum {CLOCK_SAMPLES = 32};
+    enum {COMPACT_VALUES = 8, COMPACT_HISTORY = 64, COMPACT_FALLBACK = 500};
+
 protected:
+    WireFormatType mWireFormat;
+    ReceiveModeType mReceiveMode;
+
+    /*! Get the newest packet received on the incoming socket
+      (Command for server, State for client), copied in buffer.
+      Returns the number of bytes or 0 if no new packet. */
+    int ReceiveLatest(char * buffer);
+
+    /*! Compact format, not static since values are relative to
+      previous packets.  Buffer must be at least COMPACT_MAX_SIZE.
+      Decode returns false if the packet is invalid or the reference
+      packet is not known (lost or too old), the other side will
+      eventually send a keyframe. */
+    size_t EncodeCompact(const socketCommandPSM & command, char * buffer);
+    size_t EncodeCompact(const socketStatePSM & state, char * buffer);
+    bool DecodeCompact(const char * buffer, const size_t size, socketCommandPSM & command);
+    bool DecodeCompact(const char * buffer, const size_t size, socketStatePSM & state);
+
+    struct CompactValuesType {
+        unsigned int Id;
+        int64_t Values[COMPACT_VALUES];
+    };
+
+    // compact format, history of quantized values sent and received
+    struct {
+        float ResolutionTranslation;
+        float ResolutionRotation;
+        unsigned int KeyframePeriod;
+        unsigned int SinceKeyframe;
+        unsigned int Acknowledged; // last id received by other side
+        unsigned int Unanswered; // packets sent since last received
+        unsigned int MissingReference;
+        CompactValuesType Sent[COMPACT_HISTORY];
+        CompactValuesType Received[COMPACT_HISTORY];
+    } mCompact;
+
     // UDP details
     struct {
         socketCommandPSM Data;
@@ -60,15 +234,83 @@ protected:
         char Buffer[BUFFER_SIZE];
     } State;
 
+    /*! Local time when the packet returned by ReceiveLatest was
+      received. */
+    double mReceivedTime;
+
+    /*! Timestamp to send back in LastTimestamp, i.e. the timestamp
+      of the last packet received plus the time spent locally since
+      it was received.  The other side can then compute the round
+      trip without our processing time (NTP style). */
+    double EchoTimestamp(const socketHeader & received) const;
+
+    /*! Convert a timestamp from the remote clock to the local clock,
+      only valid if mClock.Synchronized. */
+    inline double RemoteToLocal(const double remoteTime) const {
+        return remoteTime - mClockOffset;
+    }
+
+    // clock synchronization, updated for each new packet
+    struct {
+        bool Synchronized;
+        unsigned int LastId;
+        double LastTransit;
+        size_t NbSamples;
+        size_t Next;
+        double RoundTrip[CLOCK_SAMPLES];
+        double Offset[CLOCK_SAMPLES];
+    } mClock;
+
+    double mPlayoutDelay;
+
+    /*! Data for all arms, first arm uses Command.Data and
+      State.Data.  Derived classes add arms. */
+    std::vector<socketCommandPSM *> mCommands;
+    std::vector<socketStatePSM *> mStates;
+
     std::string IpAddress;
     bool mIsServer;
     const osaTimeServer & mTimeServer;
-    socketMessages::StateType CurrentState, DesiredState;
 
 private:
+    size_t EncodeCompact(const uint32_t type, const socketHeader & header,
+                         const socketMessages::StateType state,
+                         const vctFrm3 & frame, const double jaw,
+                         char * buffer);
+    bool DecodeCompact(const char * buffer, const size_t size, const uint32_t type,
+                       socketHeader & header, socketMessages::StateType & state,
+                       vctFrm3 & frame, double & jaw);
+
     unsigned int mPacketsLost;
     unsigned int mPacketsDelayed;
+    unsigned int mPacketsCoalesced;
     double mLoopTime;
+    double mClockOffset;   // remote minus local clock
+    double mOneWayLatency; // using estimated offset
+    double mJitter;        // RFC 3550 style interarrival jitter
+
+    void UpdateClock(const socketHeader & received);
+
+    // number of packets skipped by last ReceiveLatest, these are not lost
+    unsigned int mLastCoalesced;
+
+    osaSocket * IncomingSocket(void);
+    void ReceiveThread(void);
+
+    // triple buffer, the receive thread writes in back and publishes
+    // by swapping with middle, Run swaps middle with front
+    enum {RECEIVE_FRESH = 4, RECEIVE_INDEX_MASK = 3};
+    struct {
+        char Buffer[3][BUFFER_SIZE];
+        int Size[3];
+        double Time[3];
+        std::atomic<unsigned int> Middle;
+        unsigned int Back, Front;
+        std::atomic<unsigned int> Received;
+        unsigned int Consumed;
+        std::atomic<bool> Running;
+        std::thread Thread;
+    } mReceiver;
 };
 
 #endif // _mtsSocketBasePSM_h
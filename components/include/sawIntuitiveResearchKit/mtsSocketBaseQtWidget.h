@@ -21,6 +21,7 @@ http://www.cisst.org/cisst/license.txt.
 
 #include <cisstMultiTask/mtsComponent.h>
 #include <cisstMultiTask/mtsQtWidgetIntervalStatistics.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitQtRefresh.h>
 
 class mtsSocketBaseQtWidget: public QWidget, public mtsComponent
 {
@@ -45,12 +46,16 @@ private:
     //! setup GUI
     void setupUi(void);
     int TimerPeriodInMilliseconds;
+    mtsIntuitiveResearchKitQtRefresh RefreshPolicy;
 
 protected:
     struct {
         mtsFunctionRead GetPacketsLost;
         mtsFunctionRead GetPacketsDelayed;
         mtsFunctionRead GetLoopTime;
+        mtsFunctionRead GetOneWayLatency;
+        mtsFunctionRead GetJitter;
+        mtsFunctionRead GetClockOffset;
         mtsFunctionRead GetLastReceivedPacketId;
         mtsFunctionRead GetLastSentPacketId;
         mtsFunctionRead period_statistics;
@@ -58,6 +63,9 @@ protected:
         QLabel * QLPacketsLost;
         QLabel * QLPacketsDelayed;
         QLabel * QLLoopTime;
+        QLabel * QLOneWayLatency;
+        QLabel * QLJitter;
+        QLabel * QLClockOffset;
         QLabel * QLLastReceivedPacketId;
         QLabel * QLLastSentPacketId;
     } SocketBase;
@@ -19,6 +19,8 @@ http://www.cisst.org/cisst/license.txt.
 #ifndef _mtsSocketClientPSM_h
 #define _mtsSocketClientPSM_h
 
+#include <algorithm>
+
 #include <sawIntuitiveResearchKit/mtsSocketBasePSM.h>
 #include <cisstParameterTypes/prmOperatingState.h>
 #include <cisstParameterTypes/prmPositionCartesianGet.h>
@@ -32,30 +34,76 @@ class mtsSocketClientPSM: public mtsSocketBasePSM
 
 public :
     mtsSocketClientPSM(const std::string & componentName, const double periodInSeconds,
-                       const std::string & ip, const unsigned int port);
+                       const std::string & ip, const unsigned int port,
+                       const std::string & interfaceName = "Arm");
     mtsSocketClientPSM(const mtsTaskPeriodicConstructorArg & arg);
+    ~mtsSocketClientPSM();
 
     void Configure(const std::string & fileName = "");
     void Run(void);
 
+    /*! Add an arm sharing the same connection, must be called before
+      the component is connected.  Creates a provided interface for
+      the remote arm with the same index on the server side.
+      Multiple arms use the fixed layout wire format. */
+    bool AddArm(const std::string & interfaceName);
+
+    /*! Number of previous commands sent with each command so the
+      server can recover lost packets (see
+      mtsSocketBasePSM::EncodeRedundant), 0 to disable.  Only used
+      for a single arm with the POD format.  Commands recovered are
+      only applied if the server uses a playout delay. */
+    inline void SetRedundancy(const size_t nbPrevious) {
+        mRedundancy.Number = std::min(nbPrevious, static_cast<size_t>(POD_MAX_REDUNDANCY));
+    }
+
 protected:
-    void state_command(const std::string & state);
+    /*! Data for one arm, the first arm uses Command.Data and
+      State.Data from the base class. */
+    struct ArmType {
+        socketCommandPSM * Command;
+        socketStatePSM * State;
+        socketCommandPSM CommandData;
+        socketStatePSM StateData;
+        socketMessages::StateType CurrentState;
+        socketMessages::StateType PreviousState;
+        socketMessages::StateType DesiredState;
+
+        prmPositionCartesianGet m_measured_cp;
+        prmStateJoint m_jaw_measured_js;
+        prmOperatingState m_operating_state;
+        mtsFunctionWrite operating_state_event;
+
+        void state_command(const std::string & state);
+        void Freeze(void);
+        void servo_cp(const prmPositionCartesianSet & position);
+        void jaw_servo_jp(const prmPositionJointSet & position);
+        void UpdateApplication(void);
+    };
+
+    ArmType * CreateArm(const std::string & interfaceName);
 
-    void Freeze(void);
-    void servo_cp(const prmPositionCartesianSet & position);
-    void jaw_servo_jp(const prmPositionJointSet & position);
-    void UpdateApplication(void);
     void ReceivePSMStateData(void);
     void SendPSMCommandData(void);
 
 private:
-    prmPositionCartesianGet m_measured_cp;
-    prmStateJoint m_jaw_measured_js;
-    mtsInterfaceProvided * mInterface;
-
-    socketMessages::StateType PreviousState;
-    prmOperatingState m_operating_state;
-    mtsFunctionWrite operating_state_event;
+    std::vector<ArmType *> mArms;
+
+    // last commands sent, oldest first
+    struct {
+        size_t Number;
+        size_t Size;
+        socketCommandPSM Previous[POD_MAX_REDUNDANCY];
+    } mRedundancy;
+
+    // after falling back to POD, a compact keyframe is sent every
+    // COMPACT_PROBE packets and compact is used again if the server
+    // replies with a compact packet
+    enum {COMPACT_PROBE = 1000};
+    struct {
+        bool Fallback;
+        unsigned int SinceProbe;
+    } mCompactProbe;
 };
 
 CMN_DECLARE_SERVICES_INSTANTIATION(mtsSocketClientPSM);
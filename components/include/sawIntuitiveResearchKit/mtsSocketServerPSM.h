@@ -30,30 +30,80 @@ class mtsSocketServerPSM: public mtsSocketBasePSM
 
 public :
     mtsSocketServerPSM(const std::string & componentName, const double periodInSeconds,
-                       const std::string & ip, const unsigned int port);
+                       const std::string & ip, const unsigned int port,
+                       const std::string & interfaceName = "PSM");
     mtsSocketServerPSM(const mtsTaskPeriodicConstructorArg & arg);
+    ~mtsSocketServerPSM();
 
     void Configure(const std::string & fileName = "");
     void Run(void);
 
+    /*! Add an arm sharing the same connection, must be called before
+      the component is connected.  Creates a required interface
+      which should be connected to the arm (PSM, ECM or MTM,
+      jaw/servo_jp is optional).  Multiple arms require the fixed
+      layout wire format. */
+    bool AddArm(const std::string & interfaceName);
+
+    enum {PLAYOUT_SIZE = 64};
+
 protected:
-    void ExecutePSMCommands(void);
-    void UpdatePSMState(void);
+    /*! Data for one arm, the first arm uses Command.Data and
+      State.Data from the base class. */
+    struct ArmType {
+        socketCommandPSM * Command;
+        socketStatePSM * State;
+        socketCommandPSM CommandData;
+        socketStatePSM StateData;
+        socketMessages::StateType CurrentState;
+        socketMessages::StateType DesiredState;
+        unsigned int PlayoutLastId;
+
+        mtsFunctionWrite servo_cp;
+        mtsFunctionWrite jaw_servo_jp;
+        mtsFunctionRead measured_cp;
+        mtsFunctionWrite state_command;
+        mtsFunctionRead operating_state;
+
+        prmPositionCartesianGet m_measured_cp;
+        prmPositionCartesianSet m_setpoint_cp;
+        prmPositionJointSet m_jaw_setpoint_jp;
+
+        void ErrorEventHandler(const mtsMessage & message);
+    };
+
+    ArmType * CreateArm(const std::string & interfaceName);
+
+    void ExecutePSMCommands(ArmType & arm, const socketCommandPSM & command);
+    /*! Queue command in playout buffer or execute right away if
+      there's no playout delay or the clock is not synchronized yet.
+      Per arm records don't have timestamps so the caller provides
+      the remote time, either the packet's or the recovered command's. */
+    void PlayoutQueue(const size_t armIndex, const socketCommandPSM & command,
+                      const double remoteTimestamp);
+    /*! Execute the newest command due for each arm */
+    void PlayoutRun(void);
+    void UpdatePSMState(ArmType & arm);
     void ReceivePSMCommandData(void);
     void SendPSMStateData(void);
-    void ErrorEventHandler(const mtsMessage & message);
 
 private:
-    mtsFunctionWrite servo_cp;
-    mtsFunctionWrite jaw_servo_jp;
-    mtsFunctionRead measured_cp;
-
-    mtsFunctionWrite state_command;
-    mtsFunctionRead operating_state;
-
-    prmPositionCartesianGet m_measured_cp;
-    prmPositionCartesianSet m_setpoint_cp;
-    prmPositionJointSet m_jaw_setpoint_jp;
+    std::vector<ArmType *> mArms;
+
+    // reply with multiple arms packets if received
+    bool mBundle;
+
+    // playout (jitter) buffer, fixed size ring
+    struct {
+        socketCommandPSM Commands[PLAYOUT_SIZE];
+        size_t Arms[PLAYOUT_SIZE];
+        double Times[PLAYOUT_SIZE];
+        size_t Head;
+        size_t Tail;
+        unsigned int Late;
+        unsigned int Dropped;
+        unsigned int Recovered;
+    } mPlayout;
 };
 
 CMN_DECLARE_SERVICES_INSTANTIATION(mtsSocketServerPSM);
@@ -5,7 +5,7 @@
   Author(s):  Anton Deguet
   Created on: 2016-02-05
 
-  (C) Copyright 2016-2020 Johns Hopkins University (JHU), All Rights Reserved.
+  (C) Copyright 2016-2021 Johns Hopkins University (JHU), All Rights Reserved.
 
 --- begin cisst license - do not edit ---
 
@@ -19,6 +19,10 @@ http://www.cisst.org/cisst/license.txt.
 #ifndef _mtsStateMachine_h
 #define _mtsStateMachine_h
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include <cisstMultiTask/mtsCallableVoidMethod.h>
 
 /*
@@ -31,10 +35,18 @@ http://www.cisst.org/cisst/license.txt.
  */
 
 
+/*! State machine with a dense table of states.  States are added
+  by name and each state gets an index (in order of creation, the
+  initial state is 0).  Callbacks are stored per state in the table so
+  Run doesn't perform any lookup.  Methods using state names are meant
+  for configuration and user commands, methods using indices can be
+  used in periodic code since they don't perform any lookup, string
+  comparison or allocation. */
 class mtsStateMachine
 {
 public:
     typedef std::string StateType;
+    typedef size_t StateIndex;
 
     inline mtsStateMachine(const std::string & name, const StateType initialState):
         mName(name),
@@ -42,21 +54,25 @@ public:
         mDesiredStateIsNotCurrent(false),
         mRunCallback(0),
         mStateChangeCallback(0),
-        mCurrentState(initialState),
-        mDesiredState(initialState),
-        mPreviousState(initialState),
-        mPreviousDesiredState(initialState)
+        mCurrentState(0),
+        mDesiredState(0),
+        mPreviousState(0),
+        mPreviousDesiredState(0)
     {
         AddState(initialState);
     }
 
-    /*! Add a state. */
-    void AddState(const StateType state);
+    /*! Add a state, returns the index of the new state. */
+    StateIndex AddState(const StateType state);
 
     void AddStates(const std::vector<StateType> & states);
 
     bool StateExists(const StateType state) const;
 
+    /*! Index of a state, throws if the state doesn't exist.  Users
+      should keep the index of states used in periodic code. */
+    StateIndex Index(const StateType & state) const;
+
     /*! Add an allowed desired state.  One can only use
       SetDesiredState with allowed states. */
     void AddAllowedDesiredState(const StateType allowedState);
@@ -64,11 +80,7 @@ public:
     /*! Set the Run callback for a given state. */
     //@{
     inline void SetRunCallback(const StateType state, mtsCallableVoidBase * callback) {
-        if (!StateExists(state)) {
-            cmnThrow("mtsStateMachine::SetRunCallback: "
-                     + mName + ", state [" + state + "] doesn't exist.  Use AddState first.");
-        }
-        mRunCallbacks[state] = callback;
+        mStates[Index(state, "SetRunCallback")].Run = callback;
     }
     template <class __classType>
     inline void SetRunCallback(const StateType state,
@@ -95,11 +107,7 @@ public:
       called only once, before the Run callback. */
     //@{
     inline void SetEnterCallback(const StateType state, mtsCallableVoidBase * callback) {
-        if (!StateExists(state)) {
-            cmnThrow("mtsStateMachine::SetEnterCallback: "
-                     + mName + ", state [" + state + "] doesn't exist.  Use AddState first.");
-        }
-        mEnterCallbacks[state] = callback;
+        mStates[Index(state, "SetEnterCallback")].Enter = callback;
     }
     template <class __classType>
     inline void SetEnterCallback(const StateType state,
@@ -113,11 +121,7 @@ public:
       leaving the current state. */
     //@{
     inline void SetLeaveCallback(const StateType state, mtsCallableVoidBase * callback) {
-        if (!StateExists(state)) {
-            cmnThrow("mtsStateMachine::SetLeaveCallback: "
-                     + mName + ", state [" + state + "] doesn't exist.  Use AddState first.");
-        }
-        mLeaveCallbacks[state] = callback;
+        mStates[Index(state, "SetLeaveCallback")].Leave = callback;
     }
     template <class __classType>
     inline void SetLeaveCallback(const StateType state,
@@ -131,11 +135,7 @@ public:
       is called after the Run callback for the current state. */
     //@{
     inline void SetTransitionCallback(const StateType state, mtsCallableVoidBase * callback) {
-        if (!StateExists(state)) {
-            cmnThrow("mtsStateMachine::SetTransitionCallback: "
-                     + mName + ", state [" + state + "] doesn't exist.  Use AddState first.");
-        }
-        mTransitionCallbacks[state] = callback;
+        mStates[Index(state, "SetTransitionCallback")].Transition = callback;
     }
     template <class __classType>
     inline void SetTransitionCallback(const StateType state,
@@ -159,32 +159,58 @@ public:
 
     void Run(void);
 
+    /*! State names, references to the names stored in the states
+      table, i.e. no copy. */
+    //@{
     inline const StateType & CurrentState(void) const {
-        return mCurrentState;
+        return mStates[mCurrentState].Name;
     }
 
     inline const StateType & DesiredState(void) const {
-        return mDesiredState;
+        return mStates[mDesiredState].Name;
     }
 
     inline const StateType & PreviousState(void) const {
-        return mPreviousState;
+        return mStates[mPreviousState].Name;
     }
 
     inline const StateType & PreviousDesiredState(void) const {
-        return mPreviousDesiredState;
+        return mStates[mPreviousDesiredState].Name;
+    }
+    //@}
+
+    /*! State indices, see Index. */
+    //@{
+    inline StateIndex CurrentStateIndex(void) const {
+        return mCurrentState;
     }
 
+    inline StateIndex DesiredStateIndex(void) const {
+        return mDesiredState;
+    }
+
+    inline bool IsCurrentState(const StateIndex state) const {
+        return (mCurrentState == state);
+    }
+
+    inline bool IsDesiredState(const StateIndex state) const {
+        return (mDesiredState == state);
+    }
+    //@}
+
     /*! Set the desired state.  This will check if the state is a
       possible desired state. */
+    //@{
     void SetDesiredState(const StateType & desiredState);
+    void SetDesiredState(const StateIndex desiredState);
+    //@}
 
     /*! Set the current state.  This will check if the state is a
-      valid state.  Leave and enter callbacks will also be called.
-      Finally all callback pointers for the current state (run and
-      transition) will be updated to avoid a callback lookup by state
-      name in the Run method. */
+      valid state.  Leave and enter callbacks will also be called. */
+    //@{
     void SetCurrentState(const StateType & newState);
+    void SetCurrentState(const StateIndex newState);
+    //@}
 
     /*! Check if the desired and current states are different.  This
         allows to avoid a string compare to determine if a transition
@@ -195,32 +221,37 @@ public:
 
 protected:
 
-    void UpdateCurrentCallbacks(void);
+    /*! Index lookup with error message for the given method name. */
+    StateIndex Index(const StateType & state, const char * methodName) const;
 
     std::string mName;
     bool mFirstRun;
     bool mDesiredStateIsNotCurrent;
 
-    typedef std::map<StateType, mtsCallableVoidBase *> CallbackMap;
+    /*! Row of the states table. */
+    struct StateInfo {
+        StateType Name;
+        bool AllowedDesired; // if true, can be used set desired state
+        mtsCallableVoidBase * Enter,
+                            * Run,
+                            * Leave,
+                            * Transition;
+    };
+
+    typedef std::vector<StateInfo> StatesTable;
+    StatesTable mStates;
 
-    CallbackMap mEnterCallbacks,
-                mRunCallbacks,
-                mLeaveCallbacks,
-                mTransitionCallbacks;
+    // only used to find index from name
+    typedef std::map<StateType, StateIndex> IndexMap;
+    IndexMap mIndices;
 
     mtsCallableVoidBase * mRunCallback,
-                        * mCurrentRunCallback,
-                        * mCurrentTransitionCallback,
                         * mStateChangeCallback;
 
-    StateType mCurrentState,
+    StateIndex mCurrentState,
         mDesiredState,
         mPreviousState,
         mPreviousDesiredState;
-    
-    // if true, can be used set desired state
-    typedef std::map<StateType, bool> StateMap;
-    StateMap mStates;
 
 private:
     // default constructor disabled
@@ -24,10 +24,16 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstParameterTypes/prmPositionCartesianGet.h>
 #include <cisstParameterTypes/prmVelocityCartesianGet.h>
 #include <cisstParameterTypes/prmPositionCartesianSet.h>
+#include <cisstParameterTypes/prmForceCartesianSet.h>
 #include <cisstParameterTypes/prmStateJoint.h>
 #include <cisstParameterTypes/prmPositionJointSet.h>
 
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKit.h>
 #include <sawIntuitiveResearchKit/mtsStateMachine.h>
+#include <sawIntuitiveResearchKit/mtsTeleOperationInputLatency.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitFlightRecorder.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRealTime.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitHealth.h>
 
 // always include last
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
@@ -49,7 +55,44 @@ public:
 
     void set_scale(const double & scale);
 
+    /*! Configure the flight recorder, history of the last few
+      seconds saved to a file when an error is received from one of
+      the arms.  Duration in seconds, 0 to disable.  Must be called
+      before the component is started. */
+    inline void SetFlightRecorder(const double duration, const std::string & directory) {
+        m_flight_recorder.duration = duration;
+        m_flight_recorder.directory = directory;
+    }
+
+    /*! Real-time settings (priority, CPU affinity...) applied to the
+      component's thread in Startup.  Must be called before the
+      component is started. */
+    inline void SetRealTime(const mtsIntuitiveResearchKitRealTime & realTime) {
+        m_real_time = realTime;
+    }
+
+    /*! Period used for computations (flight recorder, rates) when the
+      component doesn't have its own thread, i.e. created with a
+      period of 0 and triggered by an ExecOut event.  Ignored
+      otherwise. */
+    inline void SetChainedPeriod(const double period) {
+        // keep default so ExpectedPeriod never returns 0
+        if (period > 0.0) {
+            m_chained_period = period;
+        }
+    }
+
+    /*! Period of the component's thread or chained period if it
+      doesn't have its own thread. */
+    inline double ExpectedPeriod(void) const {
+        const double period = this->GetPeriodicity();
+        return (period > 0.0) ? period : m_chained_period;
+    }
+
 protected:
+    mtsIntuitiveResearchKitRealTime m_real_time;
+    mtsIntuitiveResearchKitHeartbeat m_heartbeat;
+    double m_chained_period = mtsIntuitiveResearchKit::TeleopPeriod;
 
     virtual void Init(void);
 
@@ -59,6 +102,7 @@ protected:
     void ECMErrorEventHandler(const mtsMessage & message);
 
     void ClutchEventHandler(const prmEventButton & button);
+    mtsTeleOperationInputLatency m_input_latency;
     void Clutch(const bool & clutch);
 
     // Functions for events
@@ -99,6 +143,9 @@ protected:
 
         prmPositionCartesianGet m_measured_cp;
         prmVelocityCartesianGet m_measured_cv;
+        // preallocated, only the force part is updated in RunEnabled
+        prmForceCartesianSet m_body_servo_cf;
+        vctMatRot3 m_lock_orientation;
     } mMTMR, mMTML;
 
     struct {
@@ -120,6 +167,10 @@ protected:
     bool m_clutched;
 
     mtsStateMachine mTeleopState;
+    // state indices, to avoid string comparisons in periodic code
+    struct {
+        mtsStateMachine::StateIndex DISABLED, SETTING_ARMS_STATE, ENABLED;
+    } mTeleopStateIndex;
     double mInStateTimer;
 
     struct TeleopState {
@@ -133,11 +184,21 @@ protected:
         vctMatRot3 MTMLRot; //initial rotation of MTML
         vctMatRot3 MTMRRot; //initial rotation of MTMR
         vctMatrixRotation3<double> ECMRotEuler; //initial rotation of ECM calc using Euler angles
-        vctVec ECMPositionJoint;
+        vct4 ECMPositionJoint;
     } mInitial;
 
+    // ECM joint goal computed in RunEnabled
+    vct4 m_ecm_goal_jp;
+
     bool m_following;
     void set_following(const bool following);
+
+    struct {
+        mtsIntuitiveResearchKitFlightRecorder history;
+        double duration = 5.0 * cmn_s;
+        std::string directory;
+    } m_flight_recorder;
+    void FlightRecorderSample(void);
 };
 
 CMN_DECLARE_SERVICES_INSTANTIATION(mtsTeleOperationECM);
@@ -27,6 +27,8 @@ http://www.cisst.org/cisst/license.txt.
 
 #include <QSplitter>
 
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitQtRefresh.h>
+
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitQtExport.h>
 
 class QDoubleSpinBox;
@@ -70,6 +72,7 @@ private:
     //! setup TeleOperationECM controller GUI
     void setupUi(void);
     int TimerPeriodInMilliseconds;
+    mtsIntuitiveResearchKitQtRefresh m_refresh;
 
     void DesiredStateEventHandler(const std::string & state);
     void CurrentStateEventHandler(const std::string & state);
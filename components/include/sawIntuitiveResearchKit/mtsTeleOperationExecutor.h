@@ -0,0 +1,66 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-21
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsTeleOperationExecutor_h
+#define _mtsTeleOperationExecutor_h
+
+#include <cisstMultiTask/mtsTaskPeriodic.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRealTime.h>
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Periodic task used to run multiple tele-operation components in a
+  single thread.  Each tele-operation component is created with a
+  period of 0 and its "ExecIn" required interface is connected to the
+  executor's "ExecOut" provided interface.  At each iteration, the
+  executor triggers all connected components in the order they've been
+  connected.  Tele-operation components keep their own provided
+  interfaces and state tables.  The executor thread can optionally be
+  pinned to a given CPU core and use real-time settings (Linux only,
+  see mtsIntuitiveResearchKitRealTime). */
+class CISST_EXPORT mtsTeleOperationExecutor: public mtsTaskPeriodic
+{
+    CMN_DECLARE_SERVICES(CMN_DYNAMIC_CREATION_ONEARG, CMN_LOG_ALLOW_DEFAULT);
+
+public:
+    mtsTeleOperationExecutor(const std::string & componentName, const double periodInSeconds);
+    mtsTeleOperationExecutor(const mtsTaskPeriodicConstructorArg & arg);
+    inline ~mtsTeleOperationExecutor() {}
+
+    void Configure(const std::string & CMN_UNUSED(filename) = "") {};
+    void Startup(void);
+    void Run(void);
+    void Cleanup(void) {};
+
+    /*! Pin executor thread to a given CPU core, -1 to let the
+      scheduler decide.  Must be called before the task is started. */
+    inline void SetCPU(const int cpu) {
+        m_real_time.SetCPU(cpu);
+    }
+
+    /*! Real-time settings applied in Startup, overrides SetCPU. */
+    inline void SetRealTime(const mtsIntuitiveResearchKitRealTime & realTime) {
+        m_real_time = realTime;
+    }
+
+protected:
+    mtsIntuitiveResearchKitRealTime m_real_time;
+};
+
+CMN_DECLARE_SERVICES_INSTANTIATION(mtsTeleOperationExecutor);
+
+#endif // _mtsTeleOperationExecutor_h
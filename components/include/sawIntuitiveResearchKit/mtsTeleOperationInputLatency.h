@@ -0,0 +1,67 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _mtsTeleOperationInputLatency_h
+#define _mtsTeleOperationInputLatency_h
+
+#include <cisstVector/vctFixedSizeVectorTypes.h>
+#include <cisstMultiTask/mtsManagerLocal.h>
+#include <cisstParameterTypes/prmEventButton.h>
+
+/*! Latency between an input edge (clutch pressed, operator not
+  present...) and the time the tele-operation component has stopped
+  the arms.  Uses the timestamp of the button event set by the source
+  (IO or head sensor), events without timestamp are ignored.  Values
+  are last, exponential moving average and max, same as the arm's
+  servo_cp/latency. */
+class mtsTeleOperationInputLatency
+{
+public:
+    inline void Update(const prmEventButton & button) {
+        const double edgeTime = button.Timestamp();
+        if (edgeTime <= 0.0) {
+            return;
+        }
+        const double latency = mtsManagerLocal::GetInstance()->GetTimeServer().GetRelativeTime() - edgeTime;
+        if ((latency < 0.0) || (latency > 1.0 * cmn_s)) {
+            return;
+        }
+        m_latency[0] = latency;
+        if (m_samples == 0) {
+            m_latency[1] = latency;
+            m_latency[2] = latency;
+        } else {
+            m_latency[1] += 0.1 * (latency - m_latency[1]);
+            if (latency > m_latency[2]) {
+                m_latency[2] = latency;
+            }
+        }
+        ++m_samples;
+    }
+
+    /*! Data to add to the state table. */
+    inline vct3 & Latency(void) {
+        return m_latency;
+    }
+
+protected:
+    vct3 m_latency = vct3(0.0); // last, average, max
+    size_t m_samples = 0;
+};
+
+#endif // _mtsTeleOperationInputLatency_h
@@ -19,16 +19,27 @@
 #ifndef _mtsTeleOperationPSM_h
 #define _mtsTeleOperationPSM_h
 
+#include <atomic>
+
+#include <cisstOSAbstraction/osaMutex.h>
 #include <cisstMultiTask/mtsTaskPeriodic.h>
 #include <cisstParameterTypes/prmEventButton.h>
 #include <cisstParameterTypes/prmPositionCartesianGet.h>
 #include <cisstParameterTypes/prmPositionCartesianSet.h>
+#include <cisstParameterTypes/prmVelocityCartesianGet.h>
+#include <cisstParameterTypes/prmForceCartesianGet.h>
+#include <cisstParameterTypes/prmForceCartesianSet.h>
 #include <cisstParameterTypes/prmStateJoint.h>
 #include <cisstParameterTypes/prmConfigurationJoint.h>
 #include <cisstParameterTypes/prmPositionJointSet.h>
 
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKit.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
 #include <sawIntuitiveResearchKit/mtsStateMachine.h>
+#include <sawIntuitiveResearchKit/mtsTeleOperationInputLatency.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitFlightRecorder.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitRealTime.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitHealth.h>
 
 // always include last
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
@@ -49,12 +60,50 @@ class CISST_EXPORT mtsTeleOperationPSM: public mtsTaskPeriodic
     void Cleanup(void);
 
     void set_scale(const double & scale);
+
+    /*! Configure the flight recorder, history of the last few
+      seconds saved to a file when an error is received from one of
+      the arms.  Duration in seconds, 0 to disable.  Must be called
+      before the component is started. */
+    inline void SetFlightRecorder(const double duration, const std::string & directory) {
+        m_flight_recorder.duration = duration;
+        m_flight_recorder.directory = directory;
+    }
+
+    /*! Real-time settings (priority, CPU affinity...) applied to the
+      component's thread in Startup.  Must be called before the
+      component is started. */
+    inline void SetRealTime(const mtsIntuitiveResearchKitRealTime & realTime) {
+        m_real_time = realTime;
+    }
+
+    /*! Period used for computations (flight recorder, rates) when the
+      component doesn't have its own thread, i.e. created with a
+      period of 0 and triggered by an ExecOut event.  Ignored
+      otherwise. */
+    inline void SetChainedPeriod(const double period) {
+        // keep default so ExpectedPeriod never returns 0
+        if (period > 0.0) {
+            m_chained_period = period;
+        }
+    }
+
+    /*! Period of the component's thread or chained period if it
+      doesn't have its own thread. */
+    inline double ExpectedPeriod(void) const {
+        const double period = this->GetPeriodicity();
+        return (period > 0.0) ? period : m_chained_period;
+    }
+
     void set_registration_rotation(const vctMatRot3 & rotation);
     void lock_rotation(const bool & lock);
     void lock_translation(const bool & lock);
     void set_align_mtm(const bool & alignMTM);
 
  protected:
+    mtsIntuitiveResearchKitRealTime m_real_time;
+    mtsIntuitiveResearchKitHeartbeat m_heartbeat;
+    double m_chained_period = mtsIntuitiveResearchKit::TeleopPeriod;
 
     virtual void Init(void);
 
@@ -63,6 +112,17 @@ class CISST_EXPORT mtsTeleOperationPSM: public mtsTaskPeriodic
     void PSMErrorEventHandler(const mtsMessage & message);
 
     void ClutchEventHandler(const prmEventButton & button);
+    /*! Inputs connected directly to the source (IO or head sensor),
+      see console "direct-inputs".  Loss of operator presence or camera
+      pressed stop the PSM right away, the console then updates the
+      teleoperation state. */
+    void OperatorPresentDirectEventHandler(const prmEventButton & button);
+    void CameraDirectEventHandler(const prmEventButton & button);
+    void UpdateInputSuspended(const prmEventButton & button);
+    bool m_operator_present_direct = true;
+    bool m_camera_pressed_direct = false;
+    bool m_input_suspended = false;
+    mtsTeleOperationInputLatency m_input_latency;
     void Clutch(const bool & clutch);
 
     // Functions for events
@@ -100,12 +160,16 @@ class CISST_EXPORT mtsTeleOperationPSM: public mtsTaskPeriodic
 
     struct {
         mtsFunctionRead  measured_cp;
+        mtsFunctionRead  measured_cv;
         mtsFunctionRead  setpoint_cp;
         mtsFunctionWrite move_cp;
+        mtsFunctionWrite align_cp;
         mtsFunctionRead  gripper_measured_js;
         mtsFunctionWrite lock_orientation;
         mtsFunctionVoid  unlock_orientation;
         mtsFunctionWrite servo_cf_body;
+        mtsFunctionWrite body_set_cf_orientation_absolute;
+        mtsFunctionRead  body_cf_orientation_absolute;
         mtsFunctionWrite use_gravity_compensation;
 
         mtsFunctionRead  operating_state;
@@ -113,18 +177,22 @@ class CISST_EXPORT mtsTeleOperationPSM: public mtsTaskPeriodic
 
         prmStateJoint m_gripper_measured_js;
         prmPositionCartesianGet m_measured_cp;
+        prmVelocityCartesianGet m_measured_cv;
         prmPositionCartesianGet m_setpoint_cp;
         prmPositionCartesianSet m_move_cp;
+        prmForceCartesianSet m_servo_cf_body;
         vctFrm4x4 CartesianInitial;
     } mMTM;
 
     struct {
         mtsFunctionRead  setpoint_cp;
         mtsFunctionWrite servo_cp;
+        mtsFunctionRead  servo_cp_latency;
         mtsFunctionVoid  Freeze;
         mtsFunctionRead  jaw_setpoint_js;
         mtsFunctionRead  jaw_configuration_js;
         mtsFunctionWrite jaw_servo_jp;
+        mtsFunctionRead  body_measured_cf;
 
         mtsFunctionRead  operating_state;
         mtsFunctionWrite state_command;
@@ -133,7 +201,9 @@ class CISST_EXPORT mtsTeleOperationPSM: public mtsTaskPeriodic
         prmConfigurationJoint m_jaw_configuration_js;
         prmPositionCartesianGet m_setpoint_cp;
         prmPositionCartesianSet m_servo_cp;
+        vct3                    m_servo_cp_latency; // last, average, max
         prmPositionJointSet     m_jaw_servo_jp;
+        prmForceCartesianGet    m_body_measured_cf;
         vctFrm4x4 CartesianInitial;
     } mPSM;
 
@@ -141,6 +211,12 @@ class CISST_EXPORT mtsTeleOperationPSM: public mtsTaskPeriodic
         mtsFunctionRead  measured_cp;
         prmPositionCartesianGet m_measured_cp;
         vctFrm4x4 CartesianInitial;
+        // change detection, Change is only recomputed when the base
+        // frame or CartesianInitial have been updated
+        vctFrm3 Last;
+        size_t Version = 0;
+        size_t ChangeVersion = 0;
+        vctFrm4x4 Change;
     } mBaseFrame;
 
     double m_scale = mtsIntuitiveResearchKit::TeleOperationPSM::Scale;
@@ -148,6 +224,18 @@ class CISST_EXPORT mtsTeleOperationPSM: public mtsTaskPeriodic
     vctMatRot3 m_alignment_offset,
         m_alignment_offset_initial; // rotation offset between MTM and PSM when tele-operation goes in follow mode
 
+    /*! Copy of all data displayed by the widget, see
+      mtsIntuitiveResearchKitArm::gui_snapshot */
+    mutable struct {
+        std::atomic<bool> requested{false};
+        double publish_interval = 20.0 * cmn_ms;
+        double last_publish = 0.0;
+        osaMutex mutex;
+        mtsTeleOperationPSMSnapshot data;
+    } m_gui_snapshot;
+    void GUISnapshotPublish(const double now);
+    void gui_snapshot(mtsTeleOperationPSMSnapshot & snapshot) const;
+
     // conversion from gripper (MTM) to jaw (PSM)
     // j = s * g + o
     // g = (j - o) / s
@@ -188,6 +276,50 @@ class CISST_EXPORT mtsTeleOperationPSM: public mtsTaskPeriodic
         bool was_active_before_clutch = false;
     } m_operator;
 
+    /*! Optional first order prediction of the MTM pose to compensate
+      for the pipeline latency.  The MTM pose is extrapolated using
+      the MTM measured_cv over the prediction horizon.  If the horizon
+      is not set, the average servo_cp latency measured by the PSM is
+      used.  Each axis is clamped to avoid overshoot. */
+    struct {
+        bool enabled = false;
+        bool measured_horizon = true;
+        double horizon = 0.0;
+        double horizon_max = 0.1 * cmn_s;
+        vct3 translation_limit = vct3(5.0 * cmn_mm);  // per axis
+        vct3 rotation_limit = vct3(5.0 * cmnPI_180);  // per axis
+    } m_prediction;
+
+    void PredictMTMPosition(vctFrm4x4 & mtmPosition) const;
+
+    /*! Optional force feedback, the wrench measured on the PSM
+      (body/measured_cf) is rotated to the MTM base frame using the
+      PSM orientation and the registration rotation, scaled, filtered
+      and sent to the MTM (body/servo_cf with absolute orientation)
+      every cycle in follow mode.  The MTM applies the reaction to the
+      wrench exerted by the PSM.  Forces (and torques if enabled) below
+      the deadband are ignored and the norm is capped. */
+    struct {
+        bool enabled = false;
+        double gain = 1.0; // on top of m_scale
+        double cutoff = 20.0; // Hz, low pass
+        double alpha = 1.0; // computed in Startup
+        double force_deadband = 0.2; // N
+        double force_max = 3.0; // N
+        bool torque = false;
+        double torque_deadband = 0.005; // Nm
+        double torque_max = 0.05; // Nm
+        vct6 filtered;
+        bool active = false; // non zero wrench sent to MTM
+        // MTM setting before EnterEnabled, restored when leaving ENABLED
+        bool orientation_absolute_saved = false;
+        bool previous_orientation_absolute = false;
+    } m_haptic_feedback;
+
+    void HapticFeedback(void);
+    void HapticFeedbackStop(void);
+    void HapticFeedbackRestore(void);
+
     bool m_clutched = false;
     bool m_back_from_clutch = false;
     bool m_jaw_caught_up_after_clutch = false;
@@ -199,11 +331,22 @@ class CISST_EXPORT mtsTeleOperationPSM: public mtsTaskPeriodic
     mtsStateTable * mConfigurationStateTable;
 
     mtsStateMachine mTeleopState;
+    // state indices, to avoid string comparisons in periodic code
+    struct {
+        mtsStateMachine::StateIndex DISABLED, SETTING_ARMS_STATE, ALIGNING_MTM, ENABLED;
+    } mTeleopStateIndex;
     double mInStateTimer;
     double mTimeSinceLastAlign;
 
     bool m_following;
     void set_following(const bool following);
+
+    struct {
+        mtsIntuitiveResearchKitFlightRecorder history;
+        double duration = 5.0 * cmn_s;
+        std::string directory;
+    } m_flight_recorder;
+    void FlightRecorderSample(void);
 };
 
 CMN_DECLARE_SERVICES_INSTANTIATION(mtsTeleOperationPSM);
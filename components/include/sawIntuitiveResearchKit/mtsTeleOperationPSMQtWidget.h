@@ -25,8 +25,12 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstParameterTypes/prmPositionCartesianGet.h>
 #include <cisstParameterTypes/prmPositionCartesianGetQtWidget.h>
 
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
+
 #include <QSplitter>
 
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitQtRefresh.h>
+
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitQtExport.h>
 
 class QCheckBox;
@@ -80,6 +84,7 @@ private:
     //! setup TeleOperationPSM controller GUI
     void setupUi(void);
     int TimerPeriodInMilliseconds;
+    mtsIntuitiveResearchKitQtRefresh m_refresh;
 
     void DesiredStateEventHandler(const std::string & state);
     void CurrentStateEventHandler(const std::string & state);
@@ -101,6 +106,7 @@ protected:
         mtsFunctionRead alignment_offset;
         mtsFunctionRead registration_rotation;
         mtsFunctionRead period_statistics;
+        mtsFunctionRead gui_snapshot;
     } TeleOperation;
 
 private:
@@ -118,6 +124,7 @@ private:
     vctMatRot3 m_alignment_offset;
     vctQtWidgetRotationDoubleRead * QVRAlignOffset;
     vctMatRot3 m_registration_rotation;
+    mtsTeleOperationPSMSnapshot m_snapshot;
 
     // timing
     mtsIntervalStatistics m_interval_statistics;
@@ -20,8 +20,13 @@ http://www.cisst.org/cisst/license.txt.
 #ifndef _mtsToolList_h
 #define _mtsToolList_h
 
+#include <unordered_map>
+
 #include <cisstCommon/cmnGenericObject.h>
 #include <cisstCommon/cmnLogger.h>
+#include <cisstCommon/cmnPath.h>
+
+#include <json/json.h>
 
 #include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitToolTypes.h>
 
@@ -54,6 +59,27 @@ class CISST_EXPORT mtsToolList
 
     std::string Generation(const size_t & index) const;
 
+    /*! Locate and parse the definition files of all tools in the
+      list so the definition can be used without any file I/O when a
+      tool is inserted.  Tools whose file can't be found or parsed
+      are reported and skipped, see HasDefinition.  Returns false if
+      any tool has been skipped. */
+    bool LoadDefinitions(const cmnPath & path);
+
+    inline bool HasDefinition(const size_t & index) const {
+        return (index < mDefinitions.size()) && mDefinitions[index].loaded;
+    }
+
+    /*! Parsed content and full path of a tool definition file, can
+      only be used if HasDefinition is true. */
+    inline const Json::Value & Definition(const size_t & index) const {
+        return mDefinitions.at(index).json;
+    }
+
+    inline const std::string & DefinitionFile(const size_t & index) const {
+        return mDefinitions.at(index).file;
+    }
+
     inline size_t size(void) const {
         return mTools.size();
     }
@@ -77,8 +103,16 @@ class CISST_EXPORT mtsToolList
     std::vector<mtsIntuitiveResearchKitToolDescription *> mTools;
 
     // for faster searches and checks when adding tools
-    std::multimap<std::string, size_t> mToolsByModel; // e.g. 400006
-    std::multimap<std::string, size_t> mToolsByNameModel; // e.g. LARGE_NEEDLE_DRIVER_400006
+    std::unordered_multimap<std::string, size_t> mToolsByModel; // e.g. 400006
+    std::unordered_multimap<std::string, size_t> mToolsByNameModel; // e.g. LARGE_NEEDLE_DRIVER_400006
+
+    // pre-parsed tool definition files, same indices as mTools
+    struct DefinitionType {
+        std::string file;
+        Json::Value json;
+        bool loaded = false;
+    };
+    std::vector<DefinitionType> mDefinitions;
 };
 
 #endif // _mtsToolList_h
@@ -0,0 +1,110 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#ifndef _robCartesianTrajectory_h
+#define _robCartesianTrajectory_h
+
+#include <cisstVector/vctTransformationTypes.h>
+
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Straight line cartesian trajectory between two frames.  The
+  translation is linear and the rotation follows the shortest arc
+  (slerp), both are synchronized using a single trapezoidal velocity
+  profile on the path parameter so the linear and angular velocity
+  and acceleration limits are all satisfied.  The trajectory can
+  start with a non zero velocity along the new path so a new goal
+  sent during a motion doesn't stop the arm abruptly.  All methods
+  use fixed size data and don't allocate memory. */
+class CISST_EXPORT robCartesianTrajectory
+{
+public:
+    robCartesianTrajectory(void) {}
+    ~robCartesianTrajectory() {}
+
+    /*! Linear (m/s, m/s^2) and angular (rad/s, rad/s^2) limits,
+      all must be strictly positive. */
+    void SetLimits(const double linearVelocity,
+                   const double linearAcceleration,
+                   const double angularVelocity,
+                   const double angularAcceleration);
+
+    /*! Start a new trajectory at the given time.  Initial velocities
+      are the current linear and angular speeds (norms), they are
+      reduced if needed so the trajectory can stop at the goal. */
+    void Start(const vctFrm3 & start,
+               const vctFrm3 & goal,
+               const double time,
+               const double initialLinearVelocity = 0.0,
+               const double initialAngularVelocity = 0.0);
+
+    /*! Compute the frame at the given time.  Returns true once the
+      goal is reached. */
+    bool Evaluate(const double time, vctFrm3 & position);
+
+    /*! Linear and angular speeds computed during the last call to
+      Evaluate. */
+    inline double LinearVelocity(void) const {
+        return mPathVelocity * mDistance;
+    }
+
+    inline double AngularVelocity(void) const {
+        return mPathVelocity * mAngle;
+    }
+
+    /*! Total duration of the current trajectory. */
+    inline double Duration(void) const {
+        return mAccelerationTime + mCruiseTime + mDecelerationTime;
+    }
+
+    /*! Time left before reaching the goal, 0 if already reached. */
+    inline double RemainingTime(const double time) const {
+        const double remaining = mStartTime + Duration() - time;
+        return (remaining > 0.0) ? remaining : 0.0;
+    }
+
+    inline const vctFrm3 & Goal(void) const {
+        return mGoal;
+    }
+
+protected:
+    // limits
+    double mLinearVelocity = 0.1;
+    double mLinearAcceleration = 0.2;
+    double mAngularVelocity = 1.0;
+    double mAngularAcceleration = 2.0;
+
+    // path
+    vctFrm3 mStart, mGoal;
+    vct3 mTranslation; // goal - start
+    double mDistance = 0.0;
+    vct3 mAxis;
+    double mAngle = 0.0;
+
+    // profile on path parameter s in [0, 1]
+    double mStartTime = 0.0;
+    double mInitialVelocity = 0.0;
+    double mPeakVelocity = 0.0;
+    double mAcceleration = 0.0;
+    double mAccelerationTime = 0.0;
+    double mCruiseTime = 0.0;
+    double mDecelerationTime = 0.0;
+    double mPathVelocity = 0.0;
+};
+
+#endif // _robCartesianTrajectory_h
@@ -0,0 +1,169 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):
+  Created on: 2018
+
+  (C) Copyright 2018, Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _robGravityCompensationMTM_h
+#define _robGravityCompensationMTM_h
+
+#include <cisstVector/vctDynamicMatrixTypes.h>
+#include <cisstVector/vctDynamicVectorTypes.h>
+#include <cisstVector/vctFixedSizeMatrixTypes.h>
+#include <json/json.h>
+
+// always include last
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+class CISST_EXPORT robGravityCompensationMTM
+{
+public:
+    struct CreationResult {
+        robGravityCompensationMTM * Pointer = nullptr;
+        std::string ErrorMessage = "";
+    };
+
+    struct Parameters {
+
+        vctVec Pos;
+        vctVec Neg;
+        vctVec BetaVelAmp;
+        vctVec UpperEffortsLimit;
+        vctVec LowerEffortsLimit;
+        vctVec DBVel;
+        vctVec SatVel;
+        vctVec FricCompRatio;
+
+        size_t JointCount(void) const {
+            return UpperEffortsLimit.size();
+        }
+        size_t DynamicParameterCount(void) const {
+            return Pos.size();
+        }
+    };
+
+    /*! Number of joints and parameters used by the model */
+    enum {
+        MODEL_JOINT_COUNT = 6,
+        MODEL_PARAMETER_COUNT = 40,
+        GRAVITY_PARAMETER_COUNT = 10,
+        POLYNOMIAL_ORDER = 5
+    };
+
+    static CreationResult Create(const Json::Value & jsonConfig);
+    robGravityCompensationMTM(const Parameters & parameters,int version);
+    void AddGravityCompensationEfforts(const vctVec & q, const vctVec & q_dot,
+                                       vctVec & totalEfforts);
+
+    /*! Reuse the model efforts (before velocity dependent weights and
+      limits) if no joint moved more than tolerance (in radians) since
+      the last evaluation.  Joints are compared to the last evaluated
+      position so the error doesn't accumulate.  0 disables the cache
+      (default). */
+    inline void SetCacheTolerance(const double tolerance) {
+        mCache.Tolerance = tolerance;
+    }
+
+    /*! Update sine and cosine of the joints using angle addition from
+      the previous evaluation instead of calling sin/cos.  A bound on
+      the accumulated error is maintained (truncated series and
+      rounding) and exact values are computed when it exceeds maxError
+      or if a joint moved more than 0.1 radians.  0 disables
+      incremental updates (default). */
+    inline void SetIncrementalMaxError(const double maxError) {
+        mTrig.MaxError = maxError;
+    }
+
+    /*! Number of evaluations using the cached efforts */
+    inline unsigned int CacheHits(void) const {
+        return mCache.Hits;
+    }
+
+    /*! Number of evaluations using incremental sine and cosine */
+    inline unsigned int IncrementalUpdates(void) const {
+        return mTrig.Incremental;
+    }
+
+    /*! Dense regressor (joints x parameters), reference
+      implementation.  Not used at runtime but kept to validate
+      AssignSparseRegressor. */
+    static void AssignRegressor(const vctVec & q, vctMat & regressor);
+
+    /*! Dense copy of the regressor computed by
+      AssignSparseRegressor, to compare with AssignRegressor.  The
+      regressor must be MODEL_JOINT_COUNT x MODEL_PARAMETER_COUNT. */
+    void SparseRegressor(const vctVec & q, vctMat & regressor);
+
+private:
+    /*! Compute only non zero elements of the regressor.  Rows 1 and
+      2 share the same gravity terms and common products are
+      computed once.  Operations are performed in the same order as
+      AssignRegressor so results are identical. */
+    void AssignSparseRegressor(const vctVec & q);
+
+    /*! Sine and cosine of joints 2 to 6 and of q2 + q3 used by
+      AssignSparseRegressor, exact or incremental. */
+    void UpdateTrigonometry(const vctVec & q);
+
+    /*! Compute regressor * positive and negative parameters in a
+      single pass over the non zero elements, result is stored in
+      mTauPos and mTauNeg. */
+    void ComputeDirectionalEfforts(void);
+
+    void LimitEfforts(vctVec & efforts) const;
+    void ComputeAlphaVel(const vctVec & q_dot);
+    void ComputeBetaVel(const vctVec & q_dot);
+
+    const Parameters mParameters;
+    // gravity terms, row r only uses columns 2 * (r - 1) and up, row 0 is null
+    vctFixedSizeMatrix<double, MODEL_JOINT_COUNT, GRAVITY_PARAMETER_COUNT> mGravityRegressor;
+    // polynomial terms, i.e. q^0 to q^4 for each joint
+    vctFixedSizeMatrix<double, MODEL_JOINT_COUNT, POLYNOMIAL_ORDER> mPolynomialRegressor;
+    vctVec mOnes;
+    vctVec mGravityEfforts;
+    vctVec mTauPos;
+    vctVec mTauNeg;
+    vctVec mBeta;
+    vctVec mOneMinusBeta;
+    vctVec mAlpha;
+    vctVec mOneMinusAlpha;
+    const int mVersion = 0;
+
+    // sine and cosine of model joints, index is joint index
+    struct {
+        double MaxError = 0.0;
+        double ErrorBound = 0.0;
+        bool Valid = false;
+        double Q[MODEL_JOINT_COUNT];
+        double Sin[MODEL_JOINT_COUNT];
+        double Cos[MODEL_JOINT_COUNT];
+        double Sin23 = 0.0; // sin(q2 + q3)
+        unsigned int Incremental = 0;
+    } mTrig;
+
+    // model efforts for last evaluated position
+    struct {
+        double Tolerance = 0.0;
+        bool Valid = false;
+        double Q[MODEL_JOINT_COUNT];
+        vctVec TauPos;
+        vctVec TauNeg;
+        unsigned int Hits = 0;
+    } mCache;
+
+    /*! Compute model efforts in mTauPos and mTauNeg, from cache if possible */
+    void ComputeModelEfforts(const vctVec & q);
+};
+
+#endif // _robGravityCompensationMTM_h
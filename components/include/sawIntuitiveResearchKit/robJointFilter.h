@@ -0,0 +1,266 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _robJointFilter_h
+#define _robJointFilter_h
+
+#include <string>
+#include <vector>
+
+#include <cisstCommon/cmnPath.h>
+#include <cisstVector/vctDynamicVectorTypes.h>
+#include <cisstParameterTypes/prmStateJoint.h>
+#include <json/json.h>
+
+#include <sawIntuitiveResearchKit/robPSMCompensation.h>
+
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Base class for filters applied on the measured joint state in
+  the arm's thread (see robJointFilterChain).  Filters can allocate
+  memory in Configure and Resize but Filter must not allocate. */
+class CISST_EXPORT robJointFilter
+{
+public:
+    /*! Information provided to all filters when configured. */
+    struct ContextType {
+        std::string arm_name;
+        double period; // nominal period of the arm
+        cmnPath config_path; // to find files
+    };
+
+    robJointFilter(void) {}
+    virtual ~robJointFilter() {}
+
+    /*! Configure from JSON, "type" and "budget" are handled by the
+      chain and can be ignored. */
+    virtual bool Configure(const Json::Value & jsonConfig,
+                           const ContextType & context,
+                           std::string & errorMessage) = 0;
+
+    /*! Called when the number of joints changes (e.g. PSM tool
+      change) and before the first call to Filter.  Resets the filter
+      internal state. */
+    virtual void Resize(const size_t numberOfJoints) = 0;
+
+    /*! Filter in place.  dt is the time since the previous call. */
+    virtual void Filter(const double dt,
+                        vctDoubleVec & position,
+                        vctDoubleVec & velocity,
+                        vctDoubleVec & effort) = 0;
+
+    /*! Create a filter based on its type name, returns 0 if the type
+      is unknown. */
+    static robJointFilter * Create(const std::string & type);
+
+    /*! Names of supported types, for error messages. */
+    static std::string SupportedTypes(void);
+};
+
+
+/*! Which signal a filter is applied on. */
+class CISST_EXPORT robJointFilterSignal
+{
+public:
+    typedef enum {POSITION, VELOCITY, EFFORT} Type;
+    static bool FromJSON(const Json::Value & jsonConfig, Type & signal,
+                         std::string & errorMessage);
+    static inline vctDoubleVec & Select(const Type signal,
+                                        vctDoubleVec & position,
+                                        vctDoubleVec & velocity,
+                                        vctDoubleVec & effort) {
+        switch (signal) {
+        case POSITION:
+            return position;
+        case EFFORT:
+            return effort;
+        default:
+            return velocity;
+        }
+    }
+};
+
+
+/*! First order low pass filter, "cutoff" frequency in Hz and
+  "signal" (velocity by default). */
+class CISST_EXPORT robJointFilterLowPass: public robJointFilter
+{
+public:
+    bool Configure(const Json::Value & jsonConfig,
+                   const ContextType & context,
+                   std::string & errorMessage) override;
+    void Resize(const size_t numberOfJoints) override;
+    void Filter(const double dt,
+                vctDoubleVec & position,
+                vctDoubleVec & velocity,
+                vctDoubleVec & effort) override;
+protected:
+    robJointFilterSignal::Type mSignal = robJointFilterSignal::VELOCITY;
+    double mTimeConstant = 0.0;
+    bool mFirst = true;
+    vctDoubleVec mPrevious;
+};
+
+
+/*! Second order notch (band stop) filter, "frequency" in Hz,
+  "quality" factor and "signal" (velocity by default).  Coefficients
+  are computed for the arm's nominal period. */
+class CISST_EXPORT robJointFilterNotch: public robJointFilter
+{
+public:
+    bool Configure(const Json::Value & jsonConfig,
+                   const ContextType & context,
+                   std::string & errorMessage) override;
+    void Resize(const size_t numberOfJoints) override;
+    void Filter(const double dt,
+                vctDoubleVec & position,
+                vctDoubleVec & velocity,
+                vctDoubleVec & effort) override;
+protected:
+    robJointFilterSignal::Type mSignal = robJointFilterSignal::VELOCITY;
+    // normalized biquad coefficients
+    double mB0, mB1, mB2, mA1, mA2;
+    bool mFirst = true;
+    // direct form II transposed state
+    vctDoubleVec mZ1, mZ2;
+};
+
+
+/*! Velocity estimation using a constant velocity Kalman filter per
+  joint, position is the measurement.  "process-noise" is the
+  acceleration noise density and "measurement-noise" the position
+  noise variance.  The filtered velocity replaces the measured
+  velocity, the position is left unchanged unless "filter-position"
+  is true. */
+class CISST_EXPORT robJointFilterKalmanVelocity: public robJointFilter
+{
+public:
+    bool Configure(const Json::Value & jsonConfig,
+                   const ContextType & context,
+                   std::string & errorMessage) override;
+    void Resize(const size_t numberOfJoints) override;
+    void Filter(const double dt,
+                vctDoubleVec & position,
+                vctDoubleVec & velocity,
+                vctDoubleVec & effort) override;
+protected:
+    double mProcessNoise = 1.0;
+    double mMeasurementNoise = 1.0e-8;
+    bool mFilterPosition = false;
+    bool mFirst = true;
+    // state and covariance (symmetric, P00, P01, P11) per joint
+    vctDoubleVec mPosition, mVelocity, mP00, mP01, mP11;
+};
+
+
+/*! Velocity estimation using first order adaptive window finite
+  differences (Janabi-Sharifi et al., 2000).  For each joint, the
+  longest window (up to "window" samples) such that all positions in
+  the window are within "noise" of the line fitted between the first
+  and last samples is used.  This gives long windows (smooth) at low
+  velocity and short windows (low latency) during fast motions.  The
+  estimated velocity replaces the measured velocity. */
+class CISST_EXPORT robJointFilterAdaptiveWindowVelocity: public robJointFilter
+{
+public:
+    bool Configure(const Json::Value & jsonConfig,
+                   const ContextType & context,
+                   std::string & errorMessage) override;
+    void Resize(const size_t numberOfJoints) override;
+    void Filter(const double dt,
+                vctDoubleVec & position,
+                vctDoubleVec & velocity,
+                vctDoubleVec & effort) override;
+protected:
+    size_t mWindow = 16;
+    double mNoise = 1.0e-5;
+    size_t mNumberOfJoints = 0;
+    // ring buffers of past samples, positions are stored sample after sample
+    vctDoubleVec mTimes, mPositions;
+    size_t mHead = 0;
+    size_t mCount = 0;
+    double mTime = 0.0;
+};
+
+
+/*! PSM compliance and backlash compensation (see
+  robPSMCompensation), "file" is searched in the configuration
+  path. */
+class CISST_EXPORT robJointFilterPSMCompensation: public robJointFilter
+{
+public:
+    bool Configure(const Json::Value & jsonConfig,
+                   const ContextType & context,
+                   std::string & errorMessage) override;
+    void Resize(const size_t CMN_UNUSED(numberOfJoints)) override {}
+    void Filter(const double dt,
+                vctDoubleVec & position,
+                vctDoubleVec & velocity,
+                vctDoubleVec & effort) override;
+protected:
+    robPSMCompensation::ParametersType mParameters;
+};
+
+
+/*! Ordered list of joint filters configured from the arm JSON
+  "joint-filters" array.  Each stage can have a "budget" in seconds,
+  if the stage takes longer, Filter returns false and the stage name
+  is available using LastOverrun. */
+class CISST_EXPORT robJointFilterChain
+{
+public:
+    robJointFilterChain(void) {}
+    ~robJointFilterChain();
+
+    bool Configure(const Json::Value & jsonFilters,
+                   const robJointFilter::ContextType & context,
+                   std::string & errorMessage);
+
+    inline bool Empty(void) const {
+        return mStages.empty();
+    }
+
+    /*! Apply all filters in place, time is the current time.
+      Returns false if any stage exceeded its budget. */
+    bool Filter(const double time, prmStateJoint & state);
+
+    /*! Name of the last stage that exceeded its budget. */
+    inline const std::string & LastOverrun(void) const {
+        return mLastOverrun;
+    }
+
+    /*! Total number of budget overruns since configuration. */
+    inline size_t Overruns(void) const {
+        return mOverruns;
+    }
+
+protected:
+    struct StageType {
+        std::string name;
+        robJointFilter * filter;
+        double budget;
+    };
+    std::vector<StageType> mStages;
+    double mPeriod = 0.0;
+    double mPreviousTime = 0.0;
+    size_t mNumberOfJoints = 0;
+    std::string mLastOverrun;
+    size_t mOverruns = 0;
+};
+
+#endif // _robJointFilter_h
@@ -0,0 +1,201 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-16
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#ifndef _robManipulatorBatch_h
+#define _robManipulatorBatch_h
+
+#include <vector>
+#include <cisstVector/vctDynamicMatrixTypes.h>
+#include <cisstVector/vctDynamicMatrixRef.h>
+#include <cisstVector/vctDynamicConstMatrixRef.h>
+#include <cisstRobot/robManipulator.h>
+
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Forward and inverse kinematics for a large number of poses, for
+  example to validate a trajectory offline before sending it to the
+  arm.
+
+  All data uses a structure of arrays layout, one column per pose in
+  row major matrices.  Joint values are stored in a matrix with one
+  row per joint.  Poses are stored in a matrix with 12 rows, the
+  first 9 rows are the rotation matrix elements (row major) and the
+  last 3 rows are the translation.  Use SetPose and GetPose to
+  convert from/to vctFrm4x4.
+
+  For forward kinematics, the link transformations are decomposed
+  into a constant part computed once in Configure and a rotation or
+  translation along the joint axis.  The chain is then evaluated one
+  link at a time for all poses so the inner loops have no branches,
+  a constant stride and don't depend on each other (i.e. the
+  compiler can use SIMD instructions).  If a link can't be
+  decomposed (uncommon kinematic convention), the generic
+  robManipulator::ForwardKinematics is used for each pose.
+
+  Inverse kinematics uses the solver of the manipulator(s) provided,
+  i.e. closed form for ECM, PSM (if selected) and MTM (if selected).
+  Since solvers are not thread safe, one manipulator instance must
+  be provided per thread.  Errors are reported per pose.
+
+  Jacobians (body and spatial) use robManipulatorEvaluator, one per
+  thread.
+
+  In all cases, the poses are divided in contiguous blocks, one
+  block per thread.
+
+  All methods have an overload using matrix references so data
+  owned by the caller can be used without copies, e.g. C-contiguous
+  NumPy arrays in Python bindings:
+  \code
+  vctDynamicConstMatrixRef<double> joints(nbLinks, nbPoses, nbPoses, 1, jointsPointer);
+  vctDynamicMatrixRef<double> poses(robManipulatorBatch::POSE_ROWS, nbPoses, nbPoses, 1, posesPointer);
+  batch.ForwardKinematics(joints, poses);
+  \endcode
+  These don't allocate memory for the results and never call back
+  the caller so bindings can release the interpreter lock (Python
+  GIL) for the duration of the call. */
+class CISST_EXPORT robManipulatorBatch
+{
+public:
+    enum {POSE_ROWS = 12, JACOBIAN_ROWS = 6};
+
+    typedef vctDynamicConstMatrixRef<double> ConstMatrixRefType;
+    typedef vctDynamicMatrixRef<double> MatrixRefType;
+
+    robManipulatorBatch(void);
+    ~robManipulatorBatch() {}
+
+    /*! Pre-compute constant link transformations, base frame and
+      tool offset.  Configure must be called everytime the
+      manipulator links or tools change.  Returns false if at least
+      one link can't be decomposed, forward kinematics will then use
+      the slower, generic implementation. */
+    bool Configure(const robManipulator & manipulator);
+
+    /*! Number of links the batch was configured for. */
+    inline size_t NumberOfLinks(void) const {
+        return mConstants.size();
+    }
+
+    /*! Number of threads used for forward kinematics and jacobians.  1, the
+      default, means all computations happen in the caller's
+      thread. */
+    void SetNumberOfThreads(const size_t numberOfThreads);
+
+    inline size_t NumberOfThreads(void) const {
+        return mNumberOfThreads;
+    }
+
+    /*! For inverse kinematics, use the solution of the previous pose
+      as initial guess.  This is the default and works well for
+      trajectories.  If false, the joint values provided for each
+      pose are used. */
+    inline void SetWarmStart(const bool warmStart) {
+        mWarmStart = warmStart;
+    }
+
+    inline bool WarmStart(void) const {
+        return mWarmStart;
+    }
+
+    /*! Forward kinematics for all poses, including the manipulator's
+      base (Rtw0) and tool offset.  joints must have one row per
+      link, poses is resized to 12 rows and as many columns as
+      joints. */
+    void ForwardKinematics(const vctDoubleMat & joints,
+                           vctDoubleMat & poses) const;
+
+    /*! Same as above but poses must already have 12 rows and as
+      many columns as joints, with contiguous columns (row major). */
+    void ForwardKinematics(const ConstMatrixRefType & joints,
+                           MatrixRefType poses) const;
+
+    /*! Inverse kinematics for all poses.  manipulators must contain
+      at least one manipulator, the number of manipulators determines
+      the number of threads.  All manipulators should have the same
+      kinematic chain.  joints is used as initial guess (see
+      SetWarmStart) and contains the solutions.  Returns the number
+      of poses for which inverse kinematics failed, see errors for
+      results per pose. */
+    size_t InverseKinematics(const std::vector<robManipulator *> & manipulators,
+                             const vctDoubleMat & poses,
+                             vctDoubleMat & joints,
+                             std::vector<robManipulator::Errno> & errors) const;
+
+    size_t InverseKinematics(const std::vector<robManipulator *> & manipulators,
+                             const ConstMatrixRefType & poses,
+                             MatrixRefType joints,
+                             std::vector<robManipulator::Errno> & errors) const;
+
+    /*! Body and spatial jacobians for all poses, same as
+      robManipulator::JacobianBody and JacobianSpatial.  Each column
+      contains a 6 by number of links jacobian, row major (i.e. element
+      [r, c] of the jacobian is at row r * NumberOfLinks() + c).
+      Jacobians are resized if needed. */
+    void Jacobians(const vctDoubleMat & joints,
+                   vctDoubleMat & bodyJacobians,
+                   vctDoubleMat & spatialJacobians) const;
+
+    /*! Same as above but jacobians must already have 6 * number of
+      links rows and as many columns as joints. */
+    void Jacobians(const ConstMatrixRefType & joints,
+                   MatrixRefType bodyJacobians,
+                   MatrixRefType spatialJacobians) const;
+
+    /*! Set and get pose at a given index (i.e. column). */
+    static void SetPose(vctDoubleMat & poses, const size_t index,
+                        const vctFrm4x4 & pose);
+    static void GetPose(const vctDoubleMat & poses, const size_t index,
+                        vctFrm4x4 & pose);
+    static void SetPose(MatrixRefType & poses, const size_t index,
+                        const vctFrm4x4 & pose);
+    static void GetPose(const ConstMatrixRefType & poses, const size_t index,
+                        vctFrm4x4 & pose);
+
+private:
+    /*! Forward kinematics for poses in [begin, end). */
+    void ForwardKinematicsBlock(const ConstMatrixRefType & joints,
+                                MatrixRefType & poses,
+                                const size_t begin,
+                                const size_t end) const;
+
+    void InverseKinematicsBlock(robManipulator * manipulator,
+                                const ConstMatrixRefType & poses,
+                                MatrixRefType & joints,
+                                std::vector<robManipulator::Errno> & errors,
+                                const size_t begin,
+                                const size_t end) const;
+
+    void JacobiansBlock(const ConstMatrixRefType & joints,
+                        MatrixRefType & bodyJacobians,
+                        MatrixRefType & spatialJacobians,
+                        const size_t begin,
+                        const size_t end) const;
+
+    const robManipulator * mManipulator;
+    size_t mNumberOfThreads;
+    bool mWarmStart;
+    bool mGeneric; // at least one link can't be decomposed
+    std::vector<vctFrm4x4> mConstants; // link transformation for joint value 0
+    std::vector<bool> mAxisAtEnd; // modified DH, joint motion applied after constant part
+    std::vector<bool> mIsHinge;
+    vctFrm4x4 mBase;
+    vctFrm4x4 mToolOffset;
+};
+
+#endif // _robManipulatorBatch_h
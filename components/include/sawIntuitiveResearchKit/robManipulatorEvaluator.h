@@ -0,0 +1,121 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-06
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#ifndef _robManipulatorEvaluator_h
+#define _robManipulatorEvaluator_h
+
+#include <vector>
+#include <cisstRobot/robManipulator.h>
+
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+class robManipulatorFixedBase;
+
+/*! Evaluate the forward kinematics along with the body and spatial
+  jacobians in a single traversal of the kinematic chain.  The
+  robManipulator methods ForwardKinematics, JacobianBody and
+  JacobianSpatial each walk the whole chain (JacobianSpatial even
+  calls ForwardKinematics internally).  This class keeps the
+  intermediate frames and derives both jacobians from them.
+
+  Results are expected to be identical to robManipulator
+  (i.e. spatial jacobian in base frame using the tool tip linear
+  velocity, body jacobian in tool frame).  Configure must be called
+  everytime the manipulator links or tools change.
+
+  The single pass only knows about the links and a constant tool
+  offset.  If the manipulator has tools with their own links or if
+  its virtual methods (ForwardKinematics, JacobianBody,
+  JacobianSpatial) don't match the links (i.e. custom kinematics in
+  a derived class), Configure detects it and Evaluate uses the
+  manipulator's methods instead.
+
+  For manipulators with a fixed size implementation
+  (robManipulatorFixed, configured with ConfigureFixedSize),
+  Evaluate uses it directly. */
+class CISST_EXPORT robManipulatorEvaluator
+{
+public:
+    robManipulatorEvaluator(void);
+    ~robManipulatorEvaluator() {}
+
+    /*! Pre-allocate internal data and compute the tool offset (if
+      any) for a given manipulator.  This is not real-time safe. */
+    void Configure(const robManipulator & manipulator);
+
+    /*! Number of links the evaluator was configured for. */
+    inline size_t NumberOfLinks(void) const {
+        return mAxisAtEnd.size();
+    }
+
+    /*! Check if the single pass is used, false if Evaluate falls
+      back on the manipulator's methods. */
+    inline bool IsSinglePass(void) const {
+        return mSinglePass;
+    }
+
+    /*! Check if the manipulator's fixed size implementation is
+      used. */
+    inline bool IsFixedSize(void) const {
+        return (mFixedSize != nullptr);
+    }
+
+    /*! Forward kinematics, including the manipulator's base (Rtw0)
+      and tool offset, and both jacobians.  Jacobians must be
+      pre-allocated with 6 rows and at least as many columns as
+      links. */
+    void Evaluate(const robManipulator & manipulator,
+                  const vctDoubleVec & q,
+                  vctFrm4x4 & pose,
+                  vctDoubleMat & bodyJacobian,
+                  vctDoubleMat & spatialJacobian);
+
+    /*! Forward kinematics only. */
+    void Evaluate(const robManipulator & manipulator,
+                  const vctDoubleVec & q,
+                  vctFrm4x4 & pose);
+
+private:
+    /*! Compute all intermediate frames, mFrames[i] is the pose of
+      link i in the manipulator's world frame (i.e. including
+      Rtw0). */
+    void ComputeFrames(const robManipulator & manipulator,
+                       const vctDoubleVec & q);
+
+    /*! Compare the single pass to the manipulator's methods for a
+      given joint configuration. */
+    bool MatchesManipulator(const robManipulator & manipulator,
+                            const vctDoubleVec & q);
+
+    void EvaluateSinglePass(const robManipulator & manipulator,
+                            const vctDoubleVec & q,
+                            vctFrm4x4 & pose,
+                            vctDoubleMat & bodyJacobian,
+                            vctDoubleMat & spatialJacobian);
+
+    std::vector<vctFrm4x4> mFrames;
+    std::vector<bool> mAxisAtEnd; // modified DH, joint axis is z of frame after link
+    std::vector<bool> mIsHinge;
+    vctFrm4x4 mToolOffset;
+    bool mSinglePass;
+    // manipulator the evaluator was configured for, if fixed size
+    const robManipulator * mFixedManipulator;
+    const robManipulatorFixedBase * mFixedSize;
+};
+
+#endif // _robManipulatorEvaluator_h
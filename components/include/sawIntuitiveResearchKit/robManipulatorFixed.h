@@ -0,0 +1,329 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-10
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#ifndef _robManipulatorFixed_h
+#define _robManipulatorFixed_h
+
+#include <cmath>
+
+#include <cisstVector/vctFixedSizeVectorTypes.h>
+#include <cisstVector/vctFixedSizeMatrixTypes.h>
+#include <cisstRobot/robManipulator.h>
+
+/*! Interface to the fixed size implementation of robManipulatorFixed
+  without the template parameters, used by robManipulatorEvaluator
+  and the arms. */
+class robManipulatorFixedBase
+{
+public:
+    virtual ~robManipulatorFixedBase() {}
+
+    /*! Cache the constant part of each link, must be called after
+      the links and tools are loaded (and everytime they change).
+      Returns false if the kinematic chain can't use the fixed size
+      implementation, all methods then use the generic one. */
+    virtual bool ConfigureFixedSize(void) = 0;
+
+    virtual bool IsFixedSize(void) const = 0;
+
+    /*! Forward kinematics (including Rtw0 and tool offset) and both
+      jacobians, jacobians must have 6 rows and at least as many
+      columns as joints.  Kinematic chain must be fixed size, see
+      IsFixedSize. */
+    virtual void ForwardKinematicsAndJacobians(const vctDynamicVector<double> & q,
+                                               vctFrame4x4<double> & pose,
+                                               vctDynamicMatrix<double> & bodyJacobian,
+                                               vctDynamicMatrix<double> & spatialJacobian) const = 0;
+};
+
+/*! Manipulator with a number of joints known at compile time.  The
+  kinematic chain is still loaded from a file (DH parameters) but
+  ConfigureFixedSize caches each link's transformation for a zero
+  joint value so forward kinematics don't call the links'
+  (virtual) ForwardKinematics.  Each joint only adds a rotation or
+  translation along z, applied in place on fixed size frames.  Both
+  jacobians are derived from the intermediate frames, stored on the
+  stack, so nothing is allocated.
+
+  The template parameter _baseType allows to keep the inverse
+  kinematics of existing classes, e.g. robManipulatorECM (analytical)
+  or robManipulatorMTM.  Since ForwardKinematics, JacobianBody and
+  JacobianSpatial are virtual, iterative inverse kinematics from the
+  base class also benefit from the fixed size implementation.
+
+  If the number of links loaded doesn't match _numberOfJoints, if
+  the tool attached has its own links, if a link doesn't use DH
+  parameters or if _baseType overrides the kinematics (checked in
+  ConfigureFixedSize), all methods fall back to the generic
+  implementation so results are always identical to the base
+  class. */
+template <size_t _numberOfJoints, class _baseType = robManipulator>
+class robManipulatorFixed: public _baseType, public robManipulatorFixedBase
+{
+public:
+    enum {NUMBER_OF_JOINTS = _numberOfJoints};
+    typedef _baseType BaseType;
+    typedef vctFixedSizeVector<double, _numberOfJoints> JointsType;
+    typedef vctFixedSizeMatrix<double, 6, _numberOfJoints> JacobianType;
+
+    robManipulatorFixed(const vctFrame4x4<double> & Rtw0 = vctFrame4x4<double>()):
+        BaseType(Rtw0),
+        m_configured(false)
+    {}
+
+    ~robManipulatorFixed() {}
+
+    bool ConfigureFixedSize(void) override {
+        m_configured = false;
+        if ((this->links.size() != _numberOfJoints) || !ToolIsOffset()) {
+            return false;
+        }
+        for (size_t index = 0; index < _numberOfJoints; ++index) {
+            const robKinematics * kinematics = this->links[index].GetKinematics();
+            const robJoint::Type type = kinematics->GetType();
+            if ((type != robJoint::HINGE) && (type != robJoint::SLIDER)) {
+                return false;
+            }
+            m_is_hinge[index] = (type == robJoint::HINGE);
+            // standard DH rotates along z of previous frame, modified along z of new frame
+            m_axis_at_end[index] = (kinematics->GetConvention() != robKinematics::STANDARD_DH);
+            m_link_zero[index] = this->links[index].ForwardKinematics(0.0);
+        }
+        m_configured = true;
+
+        // compare to base class using a couple of arbitrary
+        // configurations, base class might have custom kinematics
+        vctDynamicVector<double> q(_numberOfJoints);
+        vctDynamicMatrix<double> body(6, _numberOfJoints), spatial(6, _numberOfJoints);
+        vctDynamicMatrix<double> bodyExpected(6, _numberOfJoints), spatialExpected(6, _numberOfJoints);
+        vctFrame4x4<double> pose;
+        const double tolerance = 1.0e-9;
+        for (size_t test = 0; (test < 2) && m_configured; ++test) {
+            for (size_t index = 0; index < _numberOfJoints; ++index) {
+                q[index] = (test == 0)
+                    ? 0.1 * static_cast<double>(index + 1)
+                    : -0.05 * static_cast<double>(_numberOfJoints - index);
+            }
+            ForwardKinematicsAndJacobians(q, pose, body, spatial);
+            BaseType::JacobianBody(q, bodyExpected);
+            BaseType::JacobianSpatial(q, spatialExpected);
+            m_configured = pose.AlmostEqual(BaseType::ForwardKinematics(q), tolerance)
+                && body.AlmostEqual(bodyExpected, tolerance)
+                && spatial.AlmostEqual(spatialExpected, tolerance);
+        }
+        return m_configured;
+    }
+
+    /*! Check if the loaded kinematic chain can use the fixed size
+      implementation. */
+    inline bool IsFixedSize(void) const override {
+        return m_configured
+            && (this->links.size() == _numberOfJoints)
+            && ToolIsOffset();
+    }
+
+    /*! Overload base class method, uses fixed size implementation if
+      possible.  Partial chains (N >= 0) use the generic
+      implementation. */
+    vctFrame4x4<double>
+    ForwardKinematics(const vctDynamicVector<double> & q,
+                      int N = -1) const override {
+        if ((N < 0)
+            && (q.size() >= _numberOfJoints)
+            && IsFixedSize()) {
+            vctFrame4x4<double> frames[_numberOfJoints + 1];
+            vctFrame4x4<double> result;
+            Frames(q.Pointer(), q.stride(), frames, result);
+            return result;
+        }
+        return BaseType::ForwardKinematics(q, N);
+    }
+
+    /*! Overload base class methods, use fixed size implementation
+      if possible. */
+    //@{
+    bool JacobianBody(const vctDynamicVector<double> & q,
+                      vctDynamicMatrix<double> & J) const override {
+        if (!UseFixedSize(q, J)) {
+            return BaseType::JacobianBody(q, J);
+        }
+        vctFrame4x4<double> frames[_numberOfJoints + 1];
+        vctFrame4x4<double> pose;
+        Frames(q.Pointer(), q.stride(), frames, pose);
+        Jacobians(frames, pose, &J, static_cast<vctDynamicMatrix<double> *>(nullptr));
+        return true;
+    }
+
+    bool JacobianSpatial(const vctDynamicVector<double> & q,
+                         vctDynamicMatrix<double> & J) const override {
+        if (!UseFixedSize(q, J)) {
+            return BaseType::JacobianSpatial(q, J);
+        }
+        vctFrame4x4<double> frames[_numberOfJoints + 1];
+        vctFrame4x4<double> pose;
+        Frames(q.Pointer(), q.stride(), frames, pose);
+        Jacobians(frames, pose, static_cast<vctDynamicMatrix<double> *>(nullptr), &J);
+        return true;
+    }
+    //@}
+
+    void ForwardKinematicsAndJacobians(const vctDynamicVector<double> & q,
+                                       vctFrame4x4<double> & pose,
+                                       vctDynamicMatrix<double> & bodyJacobian,
+                                       vctDynamicMatrix<double> & spatialJacobian) const override {
+        CMN_ASSERT(q.size() >= _numberOfJoints);
+        CMN_ASSERT((bodyJacobian.rows() == 6) && (bodyJacobian.cols() >= _numberOfJoints));
+        CMN_ASSERT((spatialJacobian.rows() == 6) && (spatialJacobian.cols() >= _numberOfJoints));
+        vctFrame4x4<double> frames[_numberOfJoints + 1];
+        Frames(q.Pointer(), q.stride(), frames, pose);
+        Jacobians(frames, pose, &bodyJacobian, &spatialJacobian);
+    }
+
+    /*! Forward kinematics using a fixed size vector.  Kinematic chain
+      must be fixed size, see IsFixedSize. */
+    inline void ForwardKinematics(const JointsType & q,
+                                  vctFrame4x4<double> & pose) const {
+        CMN_ASSERT(IsFixedSize());
+        vctFrame4x4<double> frames[_numberOfJoints + 1];
+        Frames(q.Pointer(), q.stride(), frames, pose);
+    }
+
+    /*! Forward kinematics and both jacobians using fixed size
+      containers.  Kinematic chain must be fixed size, see
+      IsFixedSize. */
+    inline void ForwardKinematicsAndJacobians(const JointsType & q,
+                                              vctFrame4x4<double> & pose,
+                                              JacobianType & bodyJacobian,
+                                              JacobianType & spatialJacobian) const {
+        CMN_ASSERT(IsFixedSize());
+        vctFrame4x4<double> frames[_numberOfJoints + 1];
+        Frames(q.Pointer(), q.stride(), frames, pose);
+        Jacobians(frames, pose, &bodyJacobian, &spatialJacobian);
+    }
+
+protected:
+    /*! Only supports a single tool defined as a constant offset. */
+    inline bool ToolIsOffset(void) const {
+        if (this->tools.empty()) {
+            return true;
+        }
+        return ((this->tools.size() == 1)
+                && (this->tools[0] != 0)
+                && this->tools[0]->links.empty());
+    }
+
+    inline bool UseFixedSize(const vctDynamicVector<double> & q,
+                             const vctDynamicMatrix<double> & J) const {
+        return (q.size() >= _numberOfJoints)
+            && (J.rows() == 6)
+            && (J.cols() == _numberOfJoints)
+            && IsFixedSize();
+    }
+
+    /*! frames[i] is the pose before link i in the manipulator's
+      world frame (i.e. including Rtw0), frames[N] is the last link
+      and pose includes the tool offset.  The link's transformation
+      for q is its transformation for 0 with a rotation (hinge) or
+      translation (slider) along z, before it for standard DH and
+      after it for modified DH. */
+    template <typename _strideType>
+    inline void Frames(const double * q, const _strideType stride,
+                       vctFrame4x4<double> frames[],
+                       vctFrame4x4<double> & pose) const {
+        frames[0] = this->Rtw0;
+        for (size_t index = 0; index < _numberOfJoints; ++index) {
+            const double joint = q[index * stride];
+            if (m_axis_at_end[index]) {
+                frames[index + 1].ProductOf(frames[index], m_link_zero[index]);
+                MoveAlongZ(index, joint, frames[index + 1]);
+            } else {
+                vctFrame4x4<double> moved(frames[index]);
+                MoveAlongZ(index, joint, moved);
+                frames[index + 1].ProductOf(moved, m_link_zero[index]);
+            }
+        }
+        if (this->tools.empty()) {
+            pose = frames[_numberOfJoints];
+        } else {
+            pose.ProductOf(frames[_numberOfJoints], this->tools[0]->Rtw0);
+        }
+    }
+
+    /*! frame = frame * Rz(joint) or frame * Tz(joint), in place */
+    inline void MoveAlongZ(const size_t index, const double joint,
+                           vctFrame4x4<double> & frame) const {
+        if (m_is_hinge[index]) {
+            const double c = std::cos(joint);
+            const double s = std::sin(joint);
+            for (size_t row = 0; row < 3; ++row) {
+                const double x = frame.Element(row, 0);
+                const double y = frame.Element(row, 1);
+                frame.Element(row, 0) = c * x + s * y;
+                frame.Element(row, 1) = c * y - s * x;
+            }
+        } else {
+            for (size_t row = 0; row < 3; ++row) {
+                frame.Element(row, 3) += joint * frame.Element(row, 2);
+            }
+        }
+    }
+
+    /*! Spatial jacobian in base frame using the tool tip linear
+      velocity, body jacobian in tool frame, same as robManipulator.
+      Either jacobian can be null. */
+    template <class _matrixType>
+    inline void Jacobians(const vctFrame4x4<double> frames[],
+                          const vctFrame4x4<double> & pose,
+                          _matrixType * bodyJacobian,
+                          _matrixType * spatialJacobian) const {
+        vctFixedSizeVector<double, 3> axis, lever, linear, angular, bodyLinear, bodyAngular;
+        for (size_t index = 0; index < _numberOfJoints; ++index) {
+            const vctFrame4x4<double> & frame = m_axis_at_end[index] ? frames[index + 1] : frames[index];
+            axis.Assign(frame.Element(0, 2), frame.Element(1, 2), frame.Element(2, 2));
+            if (m_is_hinge[index]) {
+                lever.DifferenceOf(pose.Translation(), frame.Translation());
+                linear.CrossProductOf(axis, lever);
+                angular.Assign(axis);
+            } else {
+                linear.Assign(axis);
+                angular.SetAll(0.0);
+            }
+            if (spatialJacobian) {
+                for (size_t row = 0; row < 3; ++row) {
+                    spatialJacobian->Element(row, index) = linear[row];
+                    spatialJacobian->Element(row + 3, index) = angular[row];
+                }
+            }
+            if (bodyJacobian) {
+                pose.Rotation().ApplyInverseTo(linear, bodyLinear);
+                pose.Rotation().ApplyInverseTo(angular, bodyAngular);
+                for (size_t row = 0; row < 3; ++row) {
+                    bodyJacobian->Element(row, index) = bodyLinear[row];
+                    bodyJacobian->Element(row + 3, index) = bodyAngular[row];
+                }
+            }
+        }
+    }
+
+    bool m_configured;
+    vctFrame4x4<double> m_link_zero[_numberOfJoints];
+    bool m_axis_at_end[_numberOfJoints];
+    bool m_is_hinge[_numberOfJoints];
+};
+
+#endif // _robManipulatorFixed_h
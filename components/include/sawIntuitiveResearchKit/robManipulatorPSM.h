@@ -0,0 +1,82 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-14
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#ifndef _robManipulatorPSM_h
+#define _robManipulatorPSM_h
+
+#include <cisstRobot/robManipulator.h>
+
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Closed form inverse kinematics for PSM with classic 6 joints
+  tools (i.e. not snake like).  The position of the wrist pitch
+  axis is computed from the yaw axis and the pitch to yaw offset,
+  this determines the first 3 joints (RCM).  The wrist joints are
+  then computed using the joint axes.  It assumes the kinematic
+  chain is the standard dVRK PSM (modified DH, see share/kinematic
+  and share/tool).
+
+  If the goal is degenerated (wrist yaw axis going through RCM
+  point), it falls back on the iterative solver from robManipulator. */
+class CISST_EXPORT robManipulatorPSM: public robManipulator
+{
+
+public:
+    robManipulatorPSM(const vctFrame4x4<double>& Rtw0 = vctFrame4x4<double>());
+
+    robManipulatorPSM(const std::string& robotfilename,
+                      const vctFrame4x4<double>& Rtw0 = vctFrame4x4<double>());
+
+    robManipulatorPSM(const std::vector<robKinematics *> linkParms,
+                      const vctFrame4x4<double>& Rtw0 = vctFrame4x4<double>());
+
+    ~robManipulatorPSM() {}
+
+    robManipulator::Errno
+    InverseKinematics(vctDynamicVector<double> & q,
+                      const vctFrame4x4<double> & Rts,
+                      double tolerance = 1e-12,
+                      size_t Niterations = 1000,
+                      double LAMBDA = 0.001);
+
+    /*! Distance between the RCM point and the wrist pitch axis (origin
+      of the 4th frame) for the last solution of InverseKinematics.
+      This avoids an extra forward kinematics for the RCM safety
+      checks. */
+    inline double DistanceToRCM(void) const {
+        return mDistanceToRCM;
+    }
+
+    /*! Indicates if the last call to InverseKinematics used the
+      iterative solver. */
+    inline bool UsedIterative(void) const {
+        return mUsedIterative;
+    }
+
+protected:
+    /*! Forward kinematics up to link N, without Rtw0. */
+    void LocalForwardKinematics(const vctDynamicVector<double> & q,
+                                const int N,
+                                vctFrame4x4<double> & frame) const;
+
+    double mDistanceToRCM = 0.0;
+    bool mUsedIterative = false;
+    vctDynamicVector<double> mJoints;
+};
+
+#endif // _robManipulatorPSM_h
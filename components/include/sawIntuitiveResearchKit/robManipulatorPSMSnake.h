@@ -49,9 +49,56 @@ public:
                       size_t Niterations = 1000,
                       double LAMBDA = 0.001);
 
+    /*! Status of last call to InverseKinematicsBounded. */
+    typedef struct {
+        bool converged;
+        size_t iterations;
+        double residual; // norm of combined translation/orientation error for the solution returned
+        double elapsed;  // in seconds
+    } BoundedStatusType;
+
+    /*! Budget for InverseKinematicsBounded.  A maximum time of 0
+      means no time limit. */
+    void SetBoundedBudget(const size_t maxIterations,
+                          const double maxTime);
+
+    /*! Inverse kinematics with a bounded number of iterations and
+      time, to be used in the control loop.  The initial guess is
+      q + qdPredicted * dt, i.e. q should be the previous solution
+      and qdPredicted the predicted joint velocity (can be empty).
+      If the solver doesn't converge within its budget, q is set to
+      the best partial solution found (smallest residual) and
+      EFAILURE is returned.  See BoundedStatus for details.  This
+      method doesn't allocate any memory after first call. */
+    robManipulator::Errno
+    InverseKinematicsBounded(vctDynamicVector<double> & q,
+                             const vctFrame4x4<double> & Rts,
+                             const vctDynamicVector<double> & qdPredicted,
+                             const double dt,
+                             const double tolerance = 1e-12);
+
+    inline const BoundedStatusType & BoundedStatus(void) const {
+        return mBoundedStatus;
+    }
+
 private:
     void Resize(void);
 
+    /*! Compute the pose error, translation and orientation, in
+      manipulator base frame. */
+    void PoseError(const vctDynamicVector<double> & q,
+                   const vctFrame4x4<double> & Rts,
+                   vctFixedSizeVector<double, 6> & error) const;
+
+    /*! Same as ConstrainedRMRC without memory allocation, result is
+      stored in m.lsei.GetX(). */
+    void ConstrainedRMRCInternal(const vctDynamicVector<double> & q,
+                                 const vctFixedSizeVector<double, 6> & vw);
+
+    BoundedStatusType mBoundedStatus = {false, 0, 0.0, 0.0};
+    size_t mBoundedMaxIterations = 20;
+    double mBoundedMaxTime = 0.0;
+
     struct {
         // Ex = f
         vctDynamicMatrix<double> E;
@@ -67,6 +114,9 @@ private:
 
         // solver
         nmrLSEISolver lsei;
+
+        // best solution for bounded IK
+        vctDynamicVector<double> best;
     } m;
 };
 
@@ -0,0 +1,94 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _robPSMCompensation_h
+#define _robPSMCompensation_h
+
+#include <map>
+#include <string>
+
+#include <cisstVector/vctFixedSizeVectorTypes.h>
+#include <cisstVector/vctDynamicVectorTypes.h>
+#include <json/json.h>
+
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Compliance and backlash compensation for the first two joints of
+  a PSM (outer yaw and pitch).  For each joint, the correction is:
+  \f$ q_i = q_i - (b_i + c_i(q_3)) (\tau_i - o_i(q_3)) \f$ where the
+  compliance \f$ c_i \f$ is a cubic polynomial and the torque offset
+  \f$ o_i \f$ a linear polynomial of the insertion joint.
+  Polynomials are evaluated using Horner's scheme on fixed size data
+  so the compensation can be applied in the arm's thread, right after
+  the joint state is read, without any memory allocation.
+
+  One instance can hold the parameters for multiple PSMs (see
+  Configure), each arm then retrieves its own parameters using
+  Find. */
+class CISST_EXPORT robPSMCompensation
+{
+public:
+    /*! Parameters for one arm, polynomial coefficients are stored
+      highest degree first, i.e. (a, b, c, d) for \f$ ax^3 + bx^2 + cx + d \f$. */
+    struct ParametersType {
+        vctFixedSizeVector<double, 4> compliance[2];
+        vctFixedSizeVector<double, 2> torque_offset[2];
+        double backlash[2];
+    };
+
+    robPSMCompensation(void) {}
+    ~robPSMCompensation() {}
+
+    /*! Configure from JSON, either a single arm using the
+      "parameters" array (original format, stored with an empty
+      name) or multiple arms using "arms": {"PSM1": {"parameters":
+      [...]}, "PSM2": ...}.  Unknown parameter names are ignored with
+      a warning.  Returns false and sets the error message if the
+      configuration is invalid. */
+    bool Configure(const Json::Value & jsonConfig, std::string & errorMessage);
+
+    /*! Parameters for a given arm.  If the arm is not found and the
+      configuration used the single arm format, returns the single arm
+      parameters.  Returns 0 if not found. */
+    const ParametersType * Find(const std::string & armName) const;
+
+    /*! Apply compensation in place on positions for joints 0 and 1,
+      position and effort must have at least 3 elements. */
+    static inline void Compensate(const ParametersType & parameters,
+                                  vctDoubleVec & position,
+                                  const vctDoubleVec & effort) {
+        const double insertion = position.Element(2);
+        for (size_t joint = 0; joint < 2; ++joint) {
+            const vctFixedSizeVector<double, 4> & c = parameters.compliance[joint];
+            const double compliance = ((c.Element(0) * insertion + c.Element(1)) * insertion + c.Element(2)) * insertion + c.Element(3);
+            const double offset = parameters.torque_offset[joint].Element(0) * insertion
+                + parameters.torque_offset[joint].Element(1);
+            position.Element(joint) -= (parameters.backlash[joint] + compliance) * (effort.Element(joint) - offset);
+        }
+    }
+
+protected:
+    static bool ConfigureArm(const Json::Value & jsonParameters,
+                             ParametersType & parameters,
+                             std::string & errorMessage);
+
+    typedef std::map<std::string, ParametersType> ArmsMap;
+    ArmsMap mArms;
+};
+
+#endif // _robPSMCompensation_h
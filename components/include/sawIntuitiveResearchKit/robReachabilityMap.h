@@ -0,0 +1,101 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+#ifndef _robReachabilityMap_h
+#define _robReachabilityMap_h
+
+#include <string>
+#include <vector>
+
+#include <cisstVector/vctFixedSizeVectorTypes.h>
+#include <cisstVector/vctTransformationTypes.h>
+#include <cisstRobot/robManipulator.h>
+
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Conservative reachability test for RCM based arms (PSM), used to
+  reject goals that are obviously out of reach before running the
+  inverse kinematics.
+
+  The wrist center (frame after the 4th link, on the shaft axis) can
+  only be along directions reached by the first two joints and at a
+  distance from the RCM set by the insertion joint.  The tool tip is
+  within the wrist reach (computed by sampling the last joints) of
+  the wrist center.  Directions are stored in an RCM centered
+  spherical grid (azimuth/elevation), each cell holds a lower bound
+  of the angle between the cell and the directions reached.  A goal
+  is rejected only if it is further than the wrist reach from all
+  possible wrist centers so this never rejects a reachable goal.
+
+  Build is not real-time safe, Reachable is O(1) and doesn't
+  allocate.  The map is built in the RCM frame, i.e. the
+  manipulator's base frame without the base offset (Rtw0), so
+  Reachable transforms positions by the inverse of the base offset
+  used in Build. */
+class CISST_EXPORT robReachabilityMap
+{
+public:
+    robReachabilityMap(void) {}
+    ~robReachabilityMap() {}
+
+    /*! Build the map using the manipulator's joint limits,
+      resolution is the size of cells in radians. */
+    bool Build(const robManipulator & manipulator,
+               const double resolution,
+               std::string & errorMessage);
+
+    inline bool Valid(void) const {
+        return !m_angles.empty();
+    }
+
+    void Clear(void);
+
+    /*! Returns false if the position (in the manipulator's base
+      frame) is out of reach.  Always true if the map is not
+      valid. */
+    bool Reachable(const vct3 & position) const;
+
+    inline double RadiusMin(void) const {
+        return m_radius_min;
+    }
+
+    inline double RadiusMax(void) const {
+        return m_radius_max;
+    }
+
+    inline double WristReach(void) const {
+        return m_wrist_reach;
+    }
+
+protected:
+    size_t Cell(const vct3 & direction) const;
+    vct3 CellDirection(const size_t azimuth, const size_t elevation) const;
+
+    double m_resolution = 0.0;
+    size_t m_nb_azimuth = 0;
+    size_t m_nb_elevation = 0;
+    double m_radius_min = 0.0;
+    double m_radius_max = 0.0;
+    double m_wrist_reach = 0.0;
+    // inverse of the manipulator's Rtw0 when the map was built
+    vctFrm4x4 m_base_inverse;
+    // lower bound of angle to reachable directions, per cell
+    std::vector<float> m_angles;
+};
+
+#endif // _robReachabilityMap_h
@@ -0,0 +1,111 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-08
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+  --- begin cisst license - do not edit ---
+
+  This software is provided "as is" under an open source license, with
+  no warranty.  The complete license can be found in license.txt and
+  http://www.cisst.org/cisst/license.txt.
+
+  --- end cisst license ---
+*/
+
+#ifndef _robWrenchEstimator_h
+#define _robWrenchEstimator_h
+
+#include <cisstVector/vctDynamicVectorTypes.h>
+#include <cisstVector/vctDynamicMatrixTypes.h>
+#include <cisstVector/vctFixedSizeMatrixTypes.h>
+#include <cisstVector/vctTransformationTypes.h>
+#include <cisstNumerical/nmrPInverse.h>
+
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitExport.h>
+
+/*! Estimate the cartesian wrench from joint efforts, i.e. solve
+  \f$ J^{T} w = \tau \f$ in the least squares sense.
+
+  Two methods are available.  SVD (default) uses nmrPInverse on
+  \f$ J^{T} \f$ (more robust but expensive).  DAMPED_LEAST_SQUARES
+  solves the normal equations using a Cholesky decomposition, the
+  linear system is at most 6x6 (6 joints and up use \f$ J J^{T} \f$, less
+  than 6 joints \f$ J^{T} J \f$) so it uses fixed size storage and
+  doesn't allocate any memory.  The damping is added to the diagonal
+  of the normal matrix to handle configurations close to
+  singularities. */
+class CISST_EXPORT robWrenchEstimator
+{
+public:
+    typedef enum {SVD, DAMPED_LEAST_SQUARES} MethodType;
+
+    robWrenchEstimator(void);
+    ~robWrenchEstimator() {}
+
+    /*! Pre-allocate memory for a given number of joints.  This is
+      not real-time safe. */
+    void Configure(const size_t numberOfJoints);
+
+    inline void SetMethod(const MethodType method) {
+        mMethod = method;
+    }
+
+    inline MethodType Method(void) const {
+        return mMethod;
+    }
+
+    inline void SetDamping(const double damping) {
+        mDamping = damping;
+    }
+
+    inline double Damping(void) const {
+        return mDamping;
+    }
+
+    /*! Estimate the body wrench (force and torque, in tool frame)
+      from the body jacobian and joint efforts.  The wrench vector
+      must be of size 6.  Returns false if the solver failed (matrix
+      not positive definite), the wrench is then set to 0. */
+    bool EstimateBody(const vctDoubleMat & bodyJacobian,
+                      const vctDoubleVec & effort,
+                      vctDoubleVec & bodyWrench);
+
+    /*! Compute the spatial wrench from the body wrench.  The body
+      and spatial jacobians are both defined at the tool tip, one in
+      tool frame and one in the manipulator's base frame so the
+      adjoint reduces to a rotation of both force and torque.
+      rotation is the orientation of the tool in the manipulator's
+      base frame.  This is equivalent to solving for the spatial
+      jacobian but avoids a second decomposition. */
+    static void BodyToSpatial(const vctMatRot3 & rotation,
+                              const vctDoubleVec & bodyWrench,
+                              vctDoubleVec & spatialWrench);
+
+private:
+    /*! Cholesky decomposition of the top left size x size block of
+      mNormal, in place, lower triangle.  Returns false if the
+      matrix is not positive definite. */
+    bool Cholesky(const size_t size);
+
+    /*! Solve using the Cholesky decomposition computed in mNormal,
+      mRhs is overwritten by the solution. */
+    void CholeskySolve(const size_t size);
+
+    MethodType mMethod;
+    double mDamping;
+    size_t mNumberOfJoints;
+
+    // for SVD
+    vctDoubleMat mJacobianTranspose;
+    nmrPInverseDynamicData mPInverseData;
+
+    // for damped least squares
+    vctFixedSizeMatrix<double, 6, 6, VCT_ROW_MAJOR> mNormal;
+    vctFixedSizeVector<double, 6> mRhs;
+};
+
+#endif // _robWrenchEstimator_h
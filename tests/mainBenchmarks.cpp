@@ -0,0 +1,645 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-    */
+/* ex: set filetype=cpp softtabstop=4 shiftwidth=4 tabstop=4 cindent expandtab: */
+
+/*
+  Author(s):  Anton Deguet
+  Created on: 2021-09-30
+
+  (C) Copyright 2021 Johns Hopkins University (JHU), All Rights Reserved.
+
+--- begin cisst license - do not edit ---
+
+This software is provided "as is" under an open source license, with
+no warranty.  The complete license can be found in license.txt and
+http://www.cisst.org/cisst/license.txt.
+
+--- end cisst license ---
+*/
+
+/*
+  Micro-benchmarks for the hot paths of the arms and tele-operation.
+  Kinematics, gravity compensation and socket serialization are
+  measured in a single thread, results are exact.  Arm GetRobotData,
+  control_servo_cf and tele-operation Run are measured on a
+  simulated system (console with kinematic simulated MTMR and PSM1)
+  using the arms' own per stage timing statistics, allocations are
+  counted for the whole process and divided by the number of arm
+  iterations so they are an upper bound.  Results can be saved in a
+  JSON file to track performance across releases and compiler flags.
+*/
+
+// system
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+// cisst/saw
+#include <cisstCommon/cmnPath.h>
+#include <cisstCommon/cmnUnits.h>
+#include <cisstCommon/cmnCommandLineOptions.h>
+#include <cisstCommon/cmnDataFunctionsJSON.h>
+#include <cisstOSAbstraction/osaSleep.h>
+#include <cisstOSAbstraction/osaGetTime.h>
+#include <cisstMultiTask/mtsManagerLocal.h>
+#include <cisstMultiTask/mtsInterfaceRequired.h>
+#include <cisstMultiTask/mtsIntervalStatistics.h>
+#include <cisstParameterTypes/prmOperatingState.h>
+#include <cisstParameterTypes/prmForceCartesianSet.h>
+#include <cisstParameterTypes/prmEventButton.h>
+
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitConfig.h>
+#include <sawIntuitiveResearchKit/sawIntuitiveResearchKitRevision.h>
+#include <sawIntuitiveResearchKit/robManipulatorECM.h>
+#include <sawIntuitiveResearchKit/robManipulatorMTM.h>
+#include <sawIntuitiveResearchKit/robManipulatorPSM.h>
+#include <sawIntuitiveResearchKit/robManipulatorPSMSnake.h>
+#include <sawIntuitiveResearchKit/robManipulatorEvaluator.h>
+#include <sawIntuitiveResearchKit/robManipulatorFixed.h>
+#include <sawIntuitiveResearchKit/mtsSocketBasePSM.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitConsole.h>
+#include <sawIntuitiveResearchKit/mtsIntuitiveResearchKitArmTypes.h>
+#include <sawIntuitiveResearchKit/robGravityCompensationMTM.h>
+
+// count all allocations, relaxed since we only need totals
+namespace {
+    std::atomic<size_t> Allocations(0);
+}
+
+void * operator new(std::size_t size)
+{
+    Allocations.fetch_add(1, std::memory_order_relaxed);
+    void * pointer = std::malloc(size ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void * operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void * pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void * pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void * pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void * pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+// prevents the compiler from removing computations
+volatile double Sink = 0.0;
+
+class BenchmarkSuite
+{
+public:
+    BenchmarkSuite(const double minimumTime):
+        m_minimum_time(minimumTime)
+    {}
+
+    /*! Run function in batches until minimum time is reached, first
+      batch is used to warm up and is not counted. */
+    void Run(const std::string & name, std::function<void(void)> function) {
+        function();
+        size_t batch = 1;
+        size_t iterations = 0;
+        size_t allocations = 0;
+        double elapsed = 0.0;
+        while (elapsed < m_minimum_time) {
+            const size_t allocationsStart = Allocations.load();
+            const double start = osaGetTime();
+            for (size_t index = 0; index < batch; ++index) {
+                function();
+            }
+            elapsed += osaGetTime() - start;
+            allocations += Allocations.load() - allocationsStart;
+            iterations += batch;
+            if (batch < 1000000) {
+                batch *= 2;
+            }
+        }
+        Add(name, iterations,
+            elapsed / static_cast<double>(iterations),
+            static_cast<double>(allocations) / static_cast<double>(iterations));
+    }
+
+    void Add(const std::string & name, const size_t iterations,
+             const double timePerOperation, const double allocationsPerOperation) {
+        Json::Value result;
+        result["name"] = name;
+        result["iterations"] = static_cast<Json::UInt64>(iterations);
+        result["ns-per-op"] = timePerOperation * 1.0e9;
+        result["allocations-per-op"] = allocationsPerOperation;
+        m_results.append(result);
+        std::cout << std::left << std::setw(40) << name
+                  << std::right << std::setw(14) << std::fixed << std::setprecision(1)
+                  << timePerOperation * 1.0e9 << " ns/op"
+                  << std::setw(10) << std::setprecision(2)
+                  << allocationsPerOperation << " allocs/op" << std::endl;
+    }
+
+    inline const Json::Value & Results(void) const {
+        return m_results;
+    }
+
+protected:
+    double m_minimum_time;
+    Json::Value m_results;
+};
+
+bool LoadJSON(const std::string & directory, const std::string & filename,
+              Json::Value & jsonConfig)
+{
+    cmnPath path;
+    path.Add(std::string(sawIntuitiveResearchKit_SOURCE_DIR) + "/../share/" + directory, cmnPath::TAIL);
+    const std::string fullname = path.Find(filename);
+    if (fullname == "") {
+        std::cerr << "Error: can't find " << filename << " in share/" << directory << std::endl;
+        return false;
+    }
+    std::ifstream jsonStream(fullname.c_str());
+    Json::Reader jsonReader;
+    if (!jsonReader.parse(jsonStream, jsonConfig)) {
+        std::cerr << "Error: failed to parse " << fullname << ": "
+                  << jsonReader.getFormattedErrorMessages() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// load arm kinematics and optional tool, same as the arm components
+bool LoadManipulator(robManipulator & manipulator,
+                     const std::string & kinematicFile,
+                     const std::string & toolFile = "")
+{
+    Json::Value jsonConfig;
+    if (!LoadJSON("kinematic", kinematicFile, jsonConfig)
+        || (manipulator.LoadRobot(jsonConfig["DH"]) != robManipulator::ESUCCESS)) {
+        return false;
+    }
+    if (toolFile != "") {
+        Json::Value jsonTool;
+        if (!LoadJSON("tool", toolFile, jsonTool)
+            || (manipulator.LoadRobot(jsonTool["DH"]) != robManipulator::ESUCCESS)) {
+            return false;
+        }
+        const Json::Value jsonToolTip = jsonTool["tooltip-offset"];
+        if (!jsonToolTip.isNull()) {
+            vctFrm4x4 toolTip;
+            cmnDataJSON<vctFrm4x4>::DeSerializeText(toolTip, jsonToolTip);
+            manipulator.Attach(new robManipulator(toolTip));
+        }
+    }
+    return true;
+}
+
+template <size_t _numberOfJoints, class _baseType>
+bool BenchmarkKinematics(BenchmarkSuite & suite,
+                         const std::string & name,
+                         const std::string & kinematicFile,
+                         const std::string & toolFile = "")
+{
+    typedef robManipulatorFixed<_numberOfJoints, _baseType> ManipulatorType;
+    ManipulatorType manipulator;
+    if (!LoadManipulator(manipulator, kinematicFile, toolFile)
+        || (manipulator.links.size() != _numberOfJoints)) {
+        std::cerr << "Error: failed to load kinematics for " << name << std::endl;
+        return false;
+    }
+    if (!manipulator.ConfigureFixedSize()) {
+        std::cerr << "Warning: fixed size kinematics not available for " << name << std::endl;
+    }
+
+    // middle of joint space, away from RCM for insertion stage
+    vctDoubleVec lower(_numberOfJoints), upper(_numberOfJoints);
+    manipulator.GetJointLimits(lower, upper);
+    vctDoubleVec q(_numberOfJoints), guess(_numberOfJoints), solution(_numberOfJoints);
+    for (size_t index = 0; index < _numberOfJoints; ++index) {
+        const double ratio = 0.4 + 0.03 * index;
+        q[index] = lower[index] + ratio * (upper[index] - lower[index]);
+    }
+    const vctFrm4x4 pose = manipulator.ForwardKinematics(q);
+    // IK starts from a guess close to the solution, as in control loop
+    guess.SumOf(q, vctDoubleVec(_numberOfJoints, 0.5 * cmnPI_180));
+
+    vctDoubleMat jacobian(6, _numberOfJoints);
+    suite.Run(name + "/fk", [&]() {
+            Sink = manipulator.ForwardKinematics(q).Translation().X();
+        });
+    suite.Run(name + "/ik", [&]() {
+            solution.Assign(guess);
+            manipulator.InverseKinematics(solution, pose);
+            Sink = solution[0];
+        });
+    suite.Run(name + "/jacobian-body", [&]() {
+            manipulator.JacobianBody(q, jacobian);
+            Sink = jacobian.Element(0, 0);
+        });
+    suite.Run(name + "/jacobian-spatial", [&]() {
+            manipulator.JacobianSpatial(q, jacobian);
+            Sink = jacobian.Element(0, 0);
+        });
+
+    // fixed size API used by the arms when possible
+    if (manipulator.IsFixedSize()) {
+        typename ManipulatorType::JointsType qFixed;
+        vctFrm4x4 poseFixed;
+        qFixed.Assign(q);
+        suite.Run(name + "/fk-fixed", [&]() {
+                manipulator.ForwardKinematics(qFixed, poseFixed);
+                Sink = poseFixed.Translation().X();
+            });
+        typename ManipulatorType::JacobianType bodyFixed, spatialFixed;
+        suite.Run(name + "/fk-jacobians-fixed", [&]() {
+                manipulator.ForwardKinematicsAndJacobians(qFixed, poseFixed, bodyFixed, spatialFixed);
+                Sink = bodyFixed.Element(0, 0);
+            });
+    }
+
+    // single pass used by the arms for pose and both jacobians
+    robManipulatorEvaluator evaluator;
+    evaluator.Configure(manipulator);
+    vctDoubleMat body(6, _numberOfJoints), spatial(6, _numberOfJoints);
+    vctFrm4x4 poseEvaluator;
+    suite.Run(name + "/evaluator", [&]() {
+            evaluator.Evaluate(manipulator, q, poseEvaluator, body, spatial);
+            Sink = body.Element(0, 0);
+        });
+    return true;
+}
+
+bool BenchmarkGravityCompensation(BenchmarkSuite & suite)
+{
+    Json::Value jsonConfig;
+    if (!LoadJSON("jhu-dVRK", "gc-MTMR-28247.json", jsonConfig)) {
+        return false;
+    }
+    auto result = robGravityCompensationMTM::Create(jsonConfig);
+    if (!result.Pointer) {
+        std::cerr << "Error: failed to create gravity compensation: " << result.ErrorMessage << std::endl;
+        return false;
+    }
+    robGravityCompensationMTM * gravity = result.Pointer;
+    vctDoubleVec q(7, 0.2), qd(7, 0.01), efforts(7, 0.0);
+    vctDoubleMat regressor(robGravityCompensationMTM::MODEL_JOINT_COUNT,
+                           robGravityCompensationMTM::MODEL_PARAMETER_COUNT, 0.0);
+    suite.Run("gravity-compensation-MTM/assign-regressor", [&]() {
+            robGravityCompensationMTM::AssignRegressor(q, regressor);
+            Sink = regressor.Element(1, 0);
+        });
+    suite.Run("gravity-compensation-MTM/add-efforts", [&]() {
+            efforts.SetAll(0.0);
+            gravity->AddGravityCompensationEfforts(q, qd, efforts);
+            Sink = efforts[1];
+        });
+    // slow motion, most evaluations within cache tolerance
+    gravity->SetCacheTolerance(1.0e-4);
+    suite.Run("gravity-compensation-MTM/add-efforts-cached", [&]() {
+            q[1] += 1.0e-5;
+            efforts.SetAll(0.0);
+            gravity->AddGravityCompensationEfforts(q, qd, efforts);
+            Sink = efforts[1];
+        });
+    gravity->SetCacheTolerance(0.0);
+    gravity->SetIncrementalMaxError(1.0e-9);
+    suite.Run("gravity-compensation-MTM/add-efforts-incremental", [&]() {
+            q.Add(1.0e-4);
+            efforts.SetAll(0.0);
+            gravity->AddGravityCompensationEfforts(q, qd, efforts);
+            Sink = efforts[1];
+        });
+    delete gravity;
+    return true;
+}
+
+void BenchmarkSocket(BenchmarkSuite & suite)
+{
+    socketStatePSM state;
+    socketCommandPSM command;
+    state.CurrentPose.Translation().Assign(0.01, 0.02, -0.1);
+    command.GoalPose.Translation().Assign(0.01, 0.02, -0.1);
+    char buffer[BUFFER_SIZE];
+    size_t size = 0;
+
+    // legacy wire format, same as server and client
+    suite.Run("socket/cisst-serialize-state", [&]() {
+            std::stringstream ss;
+            cmnData<socketStatePSM>::SerializeBinary(state, ss);
+            Sink = static_cast<double>(ss.str().size());
+        });
+    std::string serialized;
+    {
+        std::stringstream ss;
+        cmnData<socketCommandPSM>::SerializeBinary(command, ss);
+        serialized = ss.str();
+    }
+    suite.Run("socket/cisst-deserialize-command", [&]() {
+            std::stringstream ss;
+            ss.write(serialized.data(), serialized.size());
+            cmnDataFormat local, remote;
+            cmnData<socketCommandPSM>::DeSerializeBinary(command, ss, local, remote);
+            Sink = command.GoalJaw;
+        });
+
+    // fixed layout
+    suite.Run("socket/pod-encode-state", [&]() {
+            size = mtsSocketBasePSM::Encode(state, buffer);
+            Sink = static_cast<double>(size);
+        });
+    size = mtsSocketBasePSM::Encode(command, buffer);
+    suite.Run("socket/pod-decode-command", [&]() {
+            mtsSocketBasePSM::Decode(buffer, size, command);
+            Sink = command.GoalJaw;
+        });
+}
+
+// component used to drive the simulated system
+class BenchmarkDriver: public mtsComponent
+{
+public:
+    BenchmarkDriver(const std::string & name):
+        mtsComponent(name),
+        m_following(false)
+    {
+        mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired("Console");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("power_on", Console.power_on);
+            interfaceRequired->AddFunction("home", Console.home);
+            interfaceRequired->AddFunction("teleop_enable", Console.teleop_enable);
+            interfaceRequired->AddFunction("emulate_operator_present", Console.emulate_operator_present);
+        }
+        AddArmInterface("MTM", MTM);
+        AddArmInterface("PSM", PSM);
+        interfaceRequired = AddInterfaceRequired("Teleop");
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("period_statistics", Teleop.period_statistics);
+            interfaceRequired->AddEventHandlerWrite(&BenchmarkDriver::FollowingEventHandler,
+                                                    this, "following", MTS_EVENT_NOT_QUEUED);
+        }
+    }
+
+    struct {
+        mtsFunctionVoid power_on;
+        mtsFunctionVoid home;
+        mtsFunctionWrite teleop_enable;
+        mtsFunctionWrite emulate_operator_present;
+    } Console;
+
+    struct ArmType {
+        mtsFunctionRead operating_state;
+        mtsFunctionRead timing_statistics;
+        mtsFunctionVoid timing_statistics_reset;
+        mtsFunctionWrite body_servo_cf;
+    } MTM, PSM;
+
+    struct {
+        mtsFunctionRead period_statistics;
+    } Teleop;
+
+    std::atomic<bool> m_following;
+
+    void FollowingEventHandler(const bool & following) {
+        m_following = following;
+    }
+
+protected:
+    void AddArmInterface(const std::string & name, ArmType & arm) {
+        mtsInterfaceRequired * interfaceRequired = AddInterfaceRequired(name);
+        if (interfaceRequired) {
+            interfaceRequired->AddFunction("operating_state", arm.operating_state);
+            interfaceRequired->AddFunction("timing_statistics", arm.timing_statistics);
+            interfaceRequired->AddFunction("timing_statistics_reset", arm.timing_statistics_reset);
+            interfaceRequired->AddFunction("body/servo_cf", arm.body_servo_cf);
+        }
+    }
+};
+
+bool WaitFor(std::function<bool(void)> condition, const double timeout)
+{
+    const double start = osaGetTime();
+    while (!condition()) {
+        if ((osaGetTime() - start) > timeout) {
+            return false;
+        }
+        osaSleep(10.0 * cmn_ms);
+    }
+    return true;
+}
+
+// reset arm timing, wait and report average time for a stage
+bool MeasureArmStage(BenchmarkSuite & suite,
+                     const std::string & name,
+                     BenchmarkDriver::ArmType & arm,
+                     const std::string & stage,
+                     const double duration)
+{
+    arm.timing_statistics_reset();
+    // timing statistics are published every 0.5 second
+    osaSleep(0.6 * cmn_s);
+    const size_t allocationsStart = Allocations.load();
+    mtsIntuitiveResearchKitArmTiming start, end;
+    arm.timing_statistics(start);
+    osaSleep(duration);
+    arm.timing_statistics(end);
+    const size_t allocations = Allocations.load() - allocationsStart;
+    const size_t iterations = end.iterations() - start.iterations();
+    for (size_t index = 0; index < end.stage_names().size(); ++index) {
+        if (end.stage_names().at(index) == stage) {
+            if (iterations == 0) {
+                break;
+            }
+            suite.Add(name, end.iterations(),
+                      end.stage_average().at(index),
+                      static_cast<double>(allocations) / static_cast<double>(iterations));
+            return true;
+        }
+    }
+    std::cerr << "Error: no timing statistics found for stage \"" << stage
+              << "\" (" << name << ")" << std::endl;
+    return false;
+}
+
+bool BenchmarkSystem(BenchmarkSuite & suite, const double duration)
+{
+    // generate console configuration, both arms simulated
+    Json::Value jsonConfig;
+    jsonConfig["io"]["physical-footpedals-required"] = false;
+    Json::Value jsonArm;
+    jsonArm["name"] = "MTMR";
+    jsonArm["type"] = "MTM";
+    jsonArm["simulation"] = "KINEMATIC";
+    jsonArm["arm"] = "arm/MTMR_KIN_SIMULATED.json";
+    jsonConfig["arms"].append(jsonArm);
+    jsonArm["name"] = "PSM1";
+    jsonArm["type"] = "PSM";
+    jsonArm["arm"] = "arm/PSM_KIN_SIMULATED_LARGE_NEEDLE_DRIVER_400006.json";
+    jsonConfig["arms"].append(jsonArm);
+    Json::Value jsonTeleop;
+    jsonTeleop["mtm"] = "MTMR";
+    jsonTeleop["psm"] = "PSM1";
+    jsonTeleop["configure-parameter"]["ignore-jaw"] = true;
+    jsonTeleop["configure-parameter"]["align-mtm"] = false;
+    jsonConfig["psm-teleops"].append(jsonTeleop);
+
+    const std::string configFile = cmnPath::GetWorkingDirectory() + "/dvrk-benchmarks.json";
+    {
+        std::ofstream configStream(configFile);
+        Json::StyledWriter writer;
+        configStream << writer.write(jsonConfig);
+    }
+
+    mtsManagerLocal * componentManager = mtsManagerLocal::GetInstance();
+    mtsIntuitiveResearchKitConsole * console = new mtsIntuitiveResearchKitConsole("console");
+    console->Configure(configFile);
+    if (!console->Configured()) {
+        std::cerr << "Error: failed to configure console, check cisstLog for error messages" << std::endl;
+        return false;
+    }
+    componentManager->AddComponent(console);
+    console->Connect();
+
+    BenchmarkDriver * driver = new BenchmarkDriver("benchmark");
+    componentManager->AddComponent(driver);
+    componentManager->Connect(driver->GetName(), "Console", "console", "Main");
+    componentManager->Connect(driver->GetName(), "MTM", "MTMR", "Arm");
+    componentManager->Connect(driver->GetName(), "PSM", "PSM1", "Arm");
+    componentManager->Connect(driver->GetName(), "Teleop", "MTMR-PSM1", "Setting");
+
+    componentManager->CreateAllAndWait(2.0 * cmn_s);
+    componentManager->StartAllAndWait(2.0 * cmn_s);
+
+    bool result = true;
+    prmOperatingState mtmState, psmState;
+
+    // power and home
+    driver->Console.power_on();
+    driver->Console.home();
+    if (!WaitFor([&]() {
+                driver->MTM.operating_state(mtmState);
+                driver->PSM.operating_state(psmState);
+                return mtmState.IsHomed() && psmState.IsHomed();
+            }, 20.0 * cmn_s)) {
+        std::cerr << "Error: timeout while homing arms" << std::endl;
+        result = false;
+    }
+
+    // tele-operation following, arms run GetRobotData and teleop RunEnabled
+    if (result) {
+        driver->Console.teleop_enable(true);
+        prmEventButton button;
+        button.SetType(prmEventButton::PRESSED);
+        driver->Console.emulate_operator_present(button);
+        if (!WaitFor([&]() {
+                    return driver->m_following.load();
+                }, 20.0 * cmn_s)) {
+            std::cerr << "Error: timeout while engaging tele-operation" << std::endl;
+            result = false;
+        }
+    }
+
+    if (result) {
+        result &= MeasureArmStage(suite, "arm-MTM/get-robot-data", driver->MTM, "robot_data", duration);
+        result &= MeasureArmStage(suite, "arm-PSM/get-robot-data", driver->PSM, "robot_data", duration);
+        // teleop computation time includes RunAllStates, i.e. the whole Run
+        mtsIntervalStatistics statistics;
+        driver->Teleop.period_statistics(statistics);
+        suite.Add("teleop-PSM/run-enabled", statistics.NumberOfSamples(),
+                  statistics.ComputeAvg(), 0.0);
+        driver->Console.teleop_enable(false);
+        osaSleep(0.5 * cmn_s);
+
+        // PSM effort control with a null wrench
+        prmForceCartesianSet wrench;
+        wrench.Force().SetAll(0.0);
+        driver->PSM.body_servo_cf(wrench);
+        result &= MeasureArmStage(suite, "arm-PSM/control-servo-cf", driver->PSM, "servo_cf", duration);
+    }
+
+    componentManager->KillAllAndWait(2.0 * cmn_s);
+    componentManager->Cleanup();
+    return result;
+}
+
+int main(int argc, char ** argv)
+{
+    // log configuration
+    cmnLogger::SetMask(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskDefaultLog(CMN_LOG_ALLOW_ALL);
+    cmnLogger::SetMaskFunction(CMN_LOG_ALLOW_ALL);
+    cmnLogger::AddChannel(std::cerr, CMN_LOG_ALLOW_ERRORS);
+
+    // parse options
+    cmnCommandLineOptions options;
+    double minimumTime = 0.2 * cmn_s;
+    double duration = 2.0 * cmn_s;
+    std::string outputFile;
+    options.AddOptionOneValue("t", "minimum-time",
+                              "minimum time spent per micro-benchmark, in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &minimumTime);
+    options.AddOptionOneValue("d", "duration",
+                              "duration of each measurement on the simulated system, in seconds",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &duration);
+    options.AddOptionNoValue("s", "skip-system",
+                             "skip benchmarks using the simulated system (arms and tele-operation)");
+    options.AddOptionOneValue("o", "output",
+                              "JSON file to save results",
+                              cmnCommandLineOptions::OPTIONAL_OPTION, &outputFile);
+    std::string errorMessage;
+    if (!options.Parse(argc, argv, errorMessage)) {
+        std::cerr << "Error: " << errorMessage << std::endl;
+        options.PrintUsage(std::cerr);
+        return -1;
+    }
+
+    BenchmarkSuite suite(minimumTime);
+    bool result = true;
+    result &= BenchmarkKinematics<4, robManipulatorECM>(suite, "kinematics-ECM", "ecm.json");
+    result &= BenchmarkKinematics<7, robManipulatorMTM>(suite, "kinematics-MTM", "mtmr.json");
+    result &= BenchmarkKinematics<6, robManipulatorPSM>(suite, "kinematics-PSM",
+                                                        "psm.json", "LARGE_NEEDLE_DRIVER_400006.json");
+    result &= BenchmarkKinematics<8, robManipulatorPSMSnake>(suite, "kinematics-PSM-snake",
+                                                             "psm.json", "NEEDLE_DRIVER_400117.json");
+    result &= BenchmarkGravityCompensation(suite);
+    BenchmarkSocket(suite);
+    if (!options.IsSet("skip-system")) {
+        result &= BenchmarkSystem(suite, duration);
+    }
+
+    if (!outputFile.empty()) {
+        Json::Value jsonResult;
+        jsonResult["version"] = sawIntuitiveResearchKit_VERSION;
+#if defined(__VERSION__)
+        jsonResult["compiler"] = __VERSION__;
+#endif
+#if defined(NDEBUG)
+        jsonResult["assertions"] = false;
+#else
+        jsonResult["assertions"] = true;
+#endif
+        jsonResult["benchmarks"] = suite.Results();
+        std::ofstream outputStream(outputFile);
+        Json::StyledWriter writer;
+        outputStream << writer.write(jsonResult);
+    }
+
+    cmnLogger::Kill();
+    return result ? 0 : -1;
+}
@@ -19,6 +19,7 @@ http://www.cisst.org/cisst/license.txt.
 #include "robManipulatorTest.h"
 
 #include <cisstCommon/cmnPath.h>
+#include <cisstCommon/cmnRandomSequence.h>
 #include <cisstCommon/cmnUnits.h>
 
 #include <sawIntuitiveResearchKit/sawIntuitiveResearchKitConfig.h>
@@ -108,8 +109,212 @@ public:
 };
 
 
+class ManipulatorTestDataPSM: public ManipulatorTestData {
+public:
+    ManipulatorTestDataPSM(void)
+    {
+        Name = "PSM";
+        NumberOfLinks = 6;
+        Manipulator = new robManipulatorFixed<6, robManipulatorPSM>;
+    };
+
+    void CheckIKResults(void) {
+        vctDoubleVec jointErrors(NumberOfLinks), jointErrorsAbsolute(NumberOfLinks);
+        jointErrors.DifferenceOf(SolutionJoints, ActualJoints);
+        jointErrorsAbsolute.AbsOf(jointErrors);
+
+        std::string details =
+            "Actual joints: " + (ActualJoints * cmn180_PI).ToString() + "\n"
+            "Solution     : " + (SolutionJoints * cmn180_PI).ToString() + "\n"
+            "Error        : " + (jointErrors * cmn180_PI).ToString() + "\n";
+
+        // compare joint values, DH uses 1.5708 for pi/2 so
+        // solution is not exact
+        for (size_t index = 0; index < NumberOfLinks; ++index) {
+            const double tolerance = (index == 2) ? (0.001 * cmn_mm) : (0.01 * cmnPI_180);
+            CPPUNIT_ASSERT_MESSAGE("Joint " + std::to_string(index) + " solution is incorrect\n" + details,
+                                   (jointErrorsAbsolute[index] < tolerance));
+        }
+
+        // translation
+        vct3 positionTranslationError = ActualPose.Translation() - SolutionPose.Translation();
+        CPPUNIT_ASSERT_MESSAGE("Cartesian translation error is too high\n" + details,
+                               positionTranslationError.Norm() < 0.005 * cmn_mm);
+
+        // rotation
+        vctMatRot3 positionRotationError;
+        ActualPose.Rotation().ApplyInverseTo(SolutionPose.Rotation(), positionRotationError);
+        CPPUNIT_ASSERT_MESSAGE("Cartesian rotation error is too high\n" + details,
+                               vctAxAnRot3(positionRotationError).Angle() < 0.01 * cmnPI_180);
+
+        // distance to RCM computed by IK
+        const robManipulatorPSM * psm = dynamic_cast<robManipulatorPSM *>(Manipulator);
+        CPPUNIT_ASSERT(psm);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(Manipulator->ForwardKinematics(SolutionJoints, 4).Translation().Norm(),
+                                     psm->DistanceToRCM(), 0.001 * cmn_mm);
+    }
+};
+
+
+// snake like tools, only used to compare kinematics
+class ManipulatorTestDataPSMSnake: public ManipulatorTestData {
+public:
+    ManipulatorTestDataPSMSnake(void)
+    {
+        Name = "PSM snake";
+        NumberOfLinks = 8;
+        Manipulator = new robManipulatorPSMSnake;
+    };
+
+    void CheckIKResults(void) {
+    }
+};
+
+
+class ManipulatorTestDataPSMSnakeFixed: public ManipulatorTestDataPSMSnake {
+public:
+    ManipulatorTestDataPSMSnakeFixed(void)
+    {
+        Name = "PSM snake fixed size";
+        delete Manipulator;
+        Manipulator = new robManipulatorFixed<8, robManipulatorPSMSnake>;
+    };
+};
+
+
+class ManipulatorTestDataPSMGeneric: public ManipulatorTestDataPSM {
+public:
+    ManipulatorTestDataPSMGeneric(void)
+    {
+        Name = "PSM generic";
+        delete Manipulator;
+        Manipulator = new robManipulatorPSM;
+    };
+};
+
+
+// manipulator with custom forward kinematics, the evaluator should
+// use it instead of the links
+class robManipulatorCustom: public robManipulator {
+public:
+    vctFrame4x4<double>
+    ForwardKinematics(const vctDynamicVector<double> & q,
+                      int N = -1) const override {
+        vctFrame4x4<double> offset;
+        offset.Translation().Assign(0.0, 0.0, 1.0 * cmn_cm);
+        return robManipulator::ForwardKinematics(q, N) * offset;
+    }
+};
+
+
+class ManipulatorTestDataECMCustom: public ManipulatorTestDataECM {
+public:
+    ManipulatorTestDataECMCustom(void)
+    {
+        Name = "ECM custom forward kinematics";
+        delete Manipulator;
+        Manipulator = new robManipulatorCustom;
+    };
+};
+
+
+class ManipulatorTestDataECMCustomFixed: public ManipulatorTestDataECM {
+public:
+    ManipulatorTestDataECMCustomFixed(void)
+    {
+        Name = "ECM custom forward kinematics fixed size";
+        delete Manipulator;
+        Manipulator = new robManipulatorFixed<4, robManipulatorCustom>;
+    };
+};
+
+
+class ManipulatorTestDataECMFixed: public ManipulatorTestDataECM {
+public:
+    ManipulatorTestDataECMFixed(void)
+    {
+        Name = "ECM fixed size";
+        delete Manipulator;
+        Manipulator = new robManipulatorFixed<4, robManipulatorECM>;
+    };
+};
+
+
+class ManipulatorTestDataMTMFixed: public ManipulatorTestDataMTM {
+public:
+    ManipulatorTestDataMTMFixed(void)
+    {
+        Name = "MTM fixed size";
+        delete Manipulator;
+        Manipulator = new robManipulatorFixed<7, robManipulatorMTM>;
+    };
+};
+
+
+// compare fixed size implementation to generic one
+template <size_t _numberOfJoints, class _baseType>
+void CompareFixed(ManipulatorTestData & generic, ManipulatorTestData & fixed)
+{
+    typedef robManipulatorFixed<_numberOfJoints, _baseType> FixedType;
+    FixedType * manipulator = dynamic_cast<FixedType *>(fixed.Manipulator);
+    CPPUNIT_ASSERT(manipulator);
+    CPPUNIT_ASSERT_MESSAGE("Fixed size not available for " + fixed.Name,
+                           manipulator->IsFixedSize());
+
+    typename FixedType::JointsType q;
+    vctFrm4x4 pose, poseFixed;
+    vctDoubleMat body(6, _numberOfJoints), spatial(6, _numberOfJoints);
+    vctDoubleMat bodyVirtual(6, _numberOfJoints), spatialVirtual(6, _numberOfJoints);
+    typename FixedType::JacobianType bodyFixed, spatialFixed;
+
+    const size_t nbSamples = 20;
+    for (size_t sample = 0; sample <= nbSamples; ++sample) {
+        const double ratio = static_cast<double>(sample) / static_cast<double>(nbSamples);
+        for (size_t index = 0; index < _numberOfJoints; ++index) {
+            const double jointRatio = fmod(ratio + 0.37 * index, 1.0);
+            generic.ActualJoints[index] = generic.LowerLimits[index]
+                + jointRatio * (generic.UpperLimits[index] - generic.LowerLimits[index]);
+        }
+        q.Assign(generic.ActualJoints);
+
+        // forward kinematics, dynamic and fixed size API
+        pose = generic.Manipulator->ForwardKinematics(generic.ActualJoints);
+        CPPUNIT_ASSERT_MESSAGE("Fixed size forward kinematics differs for " + fixed.Name,
+                               pose.AlmostEqual(fixed.Manipulator->ForwardKinematics(generic.ActualJoints), 1e-12));
+        manipulator->ForwardKinematics(q, poseFixed);
+        CPPUNIT_ASSERT(pose.AlmostEqual(poseFixed, 1e-12));
+        // partial chain should use the generic implementation
+        CPPUNIT_ASSERT(generic.Manipulator->ForwardKinematics(generic.ActualJoints, 2).AlmostEqual(fixed.Manipulator->ForwardKinematics(generic.ActualJoints, 2), 1e-12));
+
+        // jacobians, generic vs fixed size using virtual methods and fixed size API
+        generic.Manipulator->JacobianBody(generic.ActualJoints, body);
+        generic.Manipulator->JacobianSpatial(generic.ActualJoints, spatial);
+        fixed.Manipulator->JacobianBody(generic.ActualJoints, bodyVirtual);
+        fixed.Manipulator->JacobianSpatial(generic.ActualJoints, spatialVirtual);
+        CPPUNIT_ASSERT_MESSAGE("Fixed size body jacobian differs for " + fixed.Name,
+                               body.AlmostEqual(bodyVirtual, 1e-9));
+        CPPUNIT_ASSERT_MESSAGE("Fixed size spatial jacobian differs for " + fixed.Name,
+                               spatial.AlmostEqual(spatialVirtual, 1e-9));
+        manipulator->ForwardKinematicsAndJacobians(q, poseFixed, bodyFixed, spatialFixed);
+        CPPUNIT_ASSERT(pose.AlmostEqual(poseFixed, 1e-12));
+        for (size_t row = 0; row < 6; ++row) {
+            for (size_t col = 0; col < _numberOfJoints; ++col) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(body.Element(row, col), bodyFixed.Element(row, col), 1e-9);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(spatial.Element(row, col), spatialFixed.Element(row, col), 1e-9);
+            }
+        }
+    }
+
+    // evaluator should use the fixed size implementation
+    robManipulatorEvaluator evaluator;
+    evaluator.Configure(*(fixed.Manipulator));
+    CPPUNIT_ASSERT(evaluator.IsFixedSize());
+}
+
+
 void robManipulatorTest::SetupTestData(ManipulatorTestData & data,
-                                       const std::string & filename)
+                                       const std::string & filename,
+                                       const std::string & toolFilename)
 {
     // find the file
     cmnPath path;
@@ -136,10 +341,43 @@ void robManipulatorTest::SetupTestData(ManipulatorTestData & data,
     CPPUNIT_ASSERT_MESSAGE("Failed while loading from JSON \"DH\" value in " + configFile,
                            data.Manipulator->LoadRobot(jsonDH) == robManipulator::ESUCCESS);
 
+    // tool links are appended to the arm links, same as PSM
+    if (toolFilename != "") {
+        cmnPath toolPath;
+        toolPath.Add(std::string(sawIntuitiveResearchKit_SOURCE_DIR) + "/../share/tool", cmnPath::TAIL);
+        const std::string toolFile = toolPath.Find(toolFilename);
+        CPPUNIT_ASSERT_MESSAGE("Can't find full path for " + toolFilename,
+                               toolFile != std::string(""));
+        std::ifstream toolStream;
+        Json::Value jsonTool;
+        toolStream.open(toolFile.c_str());
+        CPPUNIT_ASSERT_MESSAGE("Failed to parse JSON file " + toolFile + ": " + jsonReader.getFormattedErrorMessages(),
+                               jsonReader.parse(toolStream, jsonTool));
+        CPPUNIT_ASSERT_MESSAGE("Failed while loading from JSON \"DH\" value in " + toolFile,
+                               data.Manipulator->LoadRobot(jsonTool["DH"]) == robManipulator::ESUCCESS);
+        const Json::Value jsonToolTip = jsonTool["tooltip-offset"];
+        if (!jsonToolTip.isNull()) {
+            vctFrm4x4 toolTip;
+            for (Json::ArrayIndex row = 0; row < 4; ++row) {
+                for (Json::ArrayIndex col = 0; col < 4; ++col) {
+                    toolTip.Element(row, col) = jsonToolTip[row][col].asDouble();
+                }
+            }
+            data.Manipulator->Attach(new robManipulator(toolTip));
+        }
+    }
+
     // verify number of links in robManipulator
     CPPUNIT_ASSERT_EQUAL_MESSAGE("Expected number of links for " + filename,
                                  data.NumberOfLinks, data.Manipulator->links.size());
 
+    // fixed size kinematics need to be configured once all links
+    // are loaded, see CompareFixed for tests
+    robManipulatorFixedBase * fixedSize = dynamic_cast<robManipulatorFixedBase *>(data.Manipulator);
+    if (fixedSize) {
+        fixedSize->ConfigureFixedSize();
+    }
+
     // allocate test data
     data.LowerLimits.SetSize(data.NumberOfLinks);
     data.UpperLimits.SetSize(data.NumberOfLinks);
@@ -231,3 +469,388 @@ void robManipulatorTest::TestMTMIKSampleJointSpace(void)
 
     TestSampleJointSpace(data);
 }
+
+
+void robManipulatorTest::CompareEvaluator(ManipulatorTestData & data,
+                                          const bool singlePass)
+{
+    robManipulatorEvaluator evaluator;
+    evaluator.Configure(*(data.Manipulator));
+    CPPUNIT_ASSERT_EQUAL(data.NumberOfLinks, evaluator.NumberOfLinks());
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("Evaluator single pass for " + data.Name,
+                                 singlePass, evaluator.IsSinglePass());
+
+    vctDoubleMat bodyExpected(6, data.NumberOfLinks), spatialExpected(6, data.NumberOfLinks);
+    vctDoubleMat body(6, data.NumberOfLinks), spatial(6, data.NumberOfLinks);
+    vctFrm4x4 pose;
+
+    // sample joint space between limits
+    const size_t nbSamples = 20;
+    for (size_t sample = 0; sample <= nbSamples; ++sample) {
+        const double ratio = static_cast<double>(sample) / static_cast<double>(nbSamples);
+        for (size_t index = 0; index < data.NumberOfLinks; ++index) {
+            // use a different ratio per joint to avoid symmetric configurations
+            const double jointRatio = fmod(ratio + 0.37 * index, 1.0);
+            data.ActualJoints[index] = data.LowerLimits[index]
+                + jointRatio * (data.UpperLimits[index] - data.LowerLimits[index]);
+        }
+        data.ActualPose = data.Manipulator->ForwardKinematics(data.ActualJoints);
+        data.Manipulator->JacobianBody(data.ActualJoints, bodyExpected);
+        data.Manipulator->JacobianSpatial(data.ActualJoints, spatialExpected);
+
+        evaluator.Evaluate(*(data.Manipulator), data.ActualJoints, pose, body, spatial);
+
+        CPPUNIT_ASSERT_MESSAGE("Evaluator forward kinematics differs for " + data.Name,
+                               pose.AlmostEqual(data.ActualPose, 1e-9));
+        CPPUNIT_ASSERT_MESSAGE("Evaluator body jacobian differs for " + data.Name,
+                               body.AlmostEqual(bodyExpected, 1e-9));
+        CPPUNIT_ASSERT_MESSAGE("Evaluator spatial jacobian differs for " + data.Name,
+                               spatial.AlmostEqual(spatialExpected, 1e-9));
+
+        // forward kinematics only
+        evaluator.Evaluate(*(data.Manipulator), data.ActualJoints, pose);
+        CPPUNIT_ASSERT_MESSAGE("Evaluator forward kinematics (only) differs for " + data.Name,
+                               pose.AlmostEqual(data.ActualPose, 1e-9));
+    }
+}
+
+void robManipulatorTest::TestECMEvaluator(void)
+{
+    ManipulatorTestDataECM data;
+    SetupTestData(data, "ecm.json");
+    CompareEvaluator(data);
+}
+
+void robManipulatorTest::TestMTMEvaluator(void)
+{
+    ManipulatorTestDataMTM data;
+    SetupTestData(data, "mtmr.json");
+    CompareEvaluator(data);
+}
+
+void robManipulatorTest::TestPSMEvaluator(void)
+{
+    // tool links appended to arm links and tool tip offset, as used by the PSM
+    ManipulatorTestDataPSMGeneric generic;
+    SetupTestData(generic, "psm.json", "LARGE_NEEDLE_DRIVER_400006.json");
+    CompareEvaluator(generic);
+    ManipulatorTestDataPSM fixed;
+    SetupTestData(fixed, "psm.json", "LARGE_NEEDLE_DRIVER_400006.json");
+    CompareEvaluator(fixed);
+    CompareFixed<6, robManipulatorPSM>(generic, fixed);
+}
+
+void robManipulatorTest::TestPSMSnakeEvaluator(void)
+{
+    ManipulatorTestDataPSMSnake generic;
+    SetupTestData(generic, "psm.json", "NEEDLE_DRIVER_400117.json");
+    CompareEvaluator(generic);
+    ManipulatorTestDataPSMSnakeFixed fixed;
+    SetupTestData(fixed, "psm.json", "NEEDLE_DRIVER_400117.json");
+    CompareEvaluator(fixed);
+    CompareFixed<8, robManipulatorPSMSnake>(generic, fixed);
+}
+
+void robManipulatorTest::TestCustomEvaluator(void)
+{
+    ManipulatorTestDataECMCustom data;
+    SetupTestData(data, "ecm.json");
+    CompareEvaluator(data, false);
+    // fixed size can't be used on top of custom kinematics
+    ManipulatorTestDataECMCustomFixed fixed;
+    SetupTestData(fixed, "ecm.json");
+    CPPUNIT_ASSERT(!dynamic_cast<robManipulatorFixedBase *>(fixed.Manipulator)->IsFixedSize());
+    CompareEvaluator(fixed, false);
+}
+
+void robManipulatorTest::CompareWrenchEstimator(ManipulatorTestData & data)
+{
+    robWrenchEstimator svd, dls;
+    svd.Configure(data.NumberOfLinks);
+    svd.SetMethod(robWrenchEstimator::SVD);
+    dls.Configure(data.NumberOfLinks);
+    dls.SetMethod(robWrenchEstimator::DAMPED_LEAST_SQUARES);
+
+    vctDoubleMat body(6, data.NumberOfLinks), spatial(6, data.NumberOfLinks);
+    vctDoubleVec effort(data.NumberOfLinks);
+    vctDoubleVec wrenchSVD(6), wrenchDLS(6), spatialExpected(6), spatialWrench(6);
+
+    const size_t nbSamples = 20;
+    for (size_t sample = 0; sample <= nbSamples; ++sample) {
+        const double ratio = static_cast<double>(sample) / static_cast<double>(nbSamples);
+        for (size_t index = 0; index < data.NumberOfLinks; ++index) {
+            // stay away from joint limits and singularities
+            const double jointRatio = 0.2 + 0.6 * fmod(ratio + 0.37 * index, 1.0);
+            data.ActualJoints[index] = data.LowerLimits[index]
+                + jointRatio * (data.UpperLimits[index] - data.LowerLimits[index]);
+            effort[index] = 0.1 * (static_cast<double>(index) + 1.0) * (ratio - 0.5);
+        }
+        data.ActualPose = data.Manipulator->ForwardKinematics(data.ActualJoints);
+        data.Manipulator->JacobianBody(data.ActualJoints, body);
+        data.Manipulator->JacobianSpatial(data.ActualJoints, spatial);
+
+        CPPUNIT_ASSERT(svd.EstimateBody(body, effort, wrenchSVD));
+        CPPUNIT_ASSERT(dls.EstimateBody(body, effort, wrenchDLS));
+        CPPUNIT_ASSERT_MESSAGE("Damped least squares wrench differs from SVD for " + data.Name,
+                               wrenchDLS.AlmostEqual(wrenchSVD, 1e-5));
+
+        // spatial from body using adjoint vs. SVD on spatial jacobian
+        vctDoubleMat spatialTranspose(spatial.Transpose());
+        nmrPInverseDynamicData pinvData(spatialTranspose);
+        nmrPInverse(spatialTranspose, pinvData);
+        spatialExpected.ProductOf(pinvData.PInverse(), effort);
+        vctMatRot3 rotation;
+        rotation.Assign(data.ActualPose.Rotation());
+        robWrenchEstimator::BodyToSpatial(rotation, wrenchSVD, spatialWrench);
+        CPPUNIT_ASSERT_MESSAGE("Spatial wrench from body differs from SVD for " + data.Name,
+                               spatialWrench.AlmostEqual(spatialExpected, 1e-5));
+    }
+}
+
+void robManipulatorTest::TestECMWrenchEstimator(void)
+{
+    ManipulatorTestDataECM data;
+    SetupTestData(data, "ecm.json");
+    CompareWrenchEstimator(data);
+}
+
+void robManipulatorTest::TestMTMWrenchEstimator(void)
+{
+    ManipulatorTestDataMTM data;
+    SetupTestData(data, "mtmr.json");
+    CompareWrenchEstimator(data);
+}
+
+void robManipulatorTest::TestECMFixed(void)
+{
+    ManipulatorTestDataECM generic;
+    SetupTestData(generic, "ecm.json");
+    ManipulatorTestDataECMFixed fixed;
+    SetupTestData(fixed, "ecm.json");
+    CompareFixed<4, robManipulatorECM>(generic, fixed);
+    // inverse kinematics using fixed size forward kinematics
+    fixed.Increments.SetAll(3.0 * cmnPI_180); // use 3 degrees sampling
+    fixed.Increments.at(2) = 2.0 * cmn_cm; // except for the translation stage
+    TestSampleJointSpace(fixed);
+}
+
+void robManipulatorTest::TestMTMFixed(void)
+{
+    ManipulatorTestDataMTM generic;
+    SetupTestData(generic, "mtmr.json");
+    ManipulatorTestDataMTMFixed fixed;
+    SetupTestData(fixed, "mtmr.json");
+    CompareFixed<7, robManipulatorMTM>(generic, fixed);
+    // inverse kinematics using fixed size forward kinematics
+    fixed.Increments.SetAll(15.0 * cmnPI_180); // use 15 degrees sampling
+    fixed.LowerLimits.at(6) = -cmnPI;
+    fixed.UpperLimits.at(6) =  cmnPI;
+    TestSampleJointSpace(fixed);
+}
+
+void robManipulatorTest::TestPSMIKSampleJointSpace(void)
+{
+    // load manipulator
+    ManipulatorTestDataPSM data;
+    SetupTestData(data, "psm.json", "LARGE_NEEDLE_DRIVER_400006.json");
+
+    data.Increments.SetAll(10.0 * cmnPI_180); // use 10 degrees sampling
+    data.Increments.at(3) = 40.0 * cmnPI_180; // roll doesn't need as many samples
+    data.Increments.at(2) = 4.0 * cmn_cm; // except for the translation stage
+    // stay away from RCM, wrist would be in cannula
+    data.LowerLimits.at(2) = 5.0 * cmn_cm;
+
+    TestSampleJointSpace(data);
+}
+
+void robManipulatorTest::CompareBatch(ManipulatorTestData & data,
+                                      ManipulatorTestData & other)
+{
+    robManipulatorBatch batch;
+    CPPUNIT_ASSERT(batch.Configure(*(data.Manipulator)));
+    CPPUNIT_ASSERT_EQUAL(data.NumberOfLinks, batch.NumberOfLinks());
+
+    // trajectory within joint limits
+    const size_t nbPoses = 1000;
+    vctDoubleMat joints(data.NumberOfLinks, nbPoses, VCT_ROW_MAJOR);
+    for (size_t pose = 0; pose < nbPoses; ++pose) {
+        const double ratio = static_cast<double>(pose) / static_cast<double>(nbPoses);
+        for (size_t index = 0; index < data.NumberOfLinks; ++index) {
+            // stay away from joint limits and singularities
+            const double jointRatio = 0.2 + 0.6 * (0.5 + 0.5 * sin(2.0 * cmnPI * (ratio + 0.37 * index)));
+            joints.Element(index, pose) = data.LowerLimits[index]
+                + jointRatio * (data.UpperLimits[index] - data.LowerLimits[index]);
+        }
+    }
+
+    // forward kinematics, single and multiple threads
+    vctDoubleMat poses, posesThreads;
+    vctFrm4x4 pose;
+    batch.ForwardKinematics(joints, poses);
+    batch.SetNumberOfThreads(3);
+    batch.ForwardKinematics(joints, posesThreads);
+    CPPUNIT_ASSERT(poses.AlmostEqual(posesThreads, 1e-12));
+    for (size_t index = 0; index < nbPoses; ++index) {
+        data.ActualJoints.Assign(joints.Column(index));
+        data.ActualPose = data.Manipulator->ForwardKinematics(data.ActualJoints);
+        robManipulatorBatch::GetPose(poses, index, pose);
+        CPPUNIT_ASSERT_MESSAGE("Batch forward kinematics differs for " + data.Name,
+                               pose.AlmostEqual(data.ActualPose, 1e-9));
+    }
+
+    // forward kinematics on caller's memory (e.g. NumPy arrays)
+    std::vector<double> posesBuffer(robManipulatorBatch::POSE_ROWS * nbPoses);
+    batch.ForwardKinematics(robManipulatorBatch::ConstMatrixRefType(joints),
+                            robManipulatorBatch::MatrixRefType(robManipulatorBatch::POSE_ROWS, nbPoses,
+                                                               nbPoses, 1, posesBuffer.data()));
+    CPPUNIT_ASSERT(poses.AlmostEqual(robManipulatorBatch::ConstMatrixRefType(robManipulatorBatch::POSE_ROWS, nbPoses,
+                                                                             nbPoses, 1, posesBuffer.data()),
+                                     1e-12));
+
+    // jacobians, compare to robManipulator
+    vctDoubleMat bodyJacobians, spatialJacobians;
+    vctDoubleMat bodyExpected(6, data.NumberOfLinks), spatialExpected(6, data.NumberOfLinks);
+    batch.Jacobians(joints, bodyJacobians, spatialJacobians);
+    CPPUNIT_ASSERT_EQUAL(6 * data.NumberOfLinks, bodyJacobians.rows());
+    CPPUNIT_ASSERT_EQUAL(nbPoses, spatialJacobians.cols());
+    for (size_t index = 0; index < nbPoses; index += 10) {
+        data.ActualJoints.Assign(joints.Column(index));
+        data.Manipulator->JacobianBody(data.ActualJoints, bodyExpected);
+        data.Manipulator->JacobianSpatial(data.ActualJoints, spatialExpected);
+        for (size_t r = 0; r < 6; ++r) {
+            for (size_t c = 0; c < data.NumberOfLinks; ++c) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(bodyExpected.Element(r, c),
+                                             bodyJacobians.Element(r * data.NumberOfLinks + c, index), 1e-9);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(spatialExpected.Element(r, c),
+                                             spatialJacobians.Element(r * data.NumberOfLinks + c, index), 1e-9);
+            }
+        }
+    }
+
+    // inverse kinematics using two threads, initial guess is first pose
+    vctDoubleMat solutions(data.NumberOfLinks, nbPoses, VCT_ROW_MAJOR);
+    for (size_t index = 0; index < nbPoses; ++index) {
+        solutions.Column(index).Assign(joints.Column(0));
+    }
+    std::vector<robManipulator *> manipulators;
+    manipulators.push_back(data.Manipulator);
+    manipulators.push_back(other.Manipulator);
+    std::vector<robManipulator::Errno> errors;
+    const size_t nbFailures = batch.InverseKinematics(manipulators, poses, solutions, errors);
+    CPPUNIT_ASSERT_EQUAL(nbPoses, errors.size());
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("Batch inverse kinematics failed for " + data.Name,
+                                 static_cast<size_t>(0), nbFailures);
+    for (size_t index = 0; index < nbPoses; ++index) {
+        data.SolutionJoints.Assign(solutions.Column(index));
+        data.SolutionPose = data.Manipulator->ForwardKinematics(data.SolutionJoints);
+        robManipulatorBatch::GetPose(poses, index, pose);
+        const vct3 translationError = pose.Translation() - data.SolutionPose.Translation();
+        CPPUNIT_ASSERT_MESSAGE("Batch inverse kinematics translation error is too high for " + data.Name,
+                               translationError.Norm() < 0.005 * cmn_mm);
+    }
+}
+
+void robManipulatorTest::TestECMBatch(void)
+{
+    ManipulatorTestDataECM data, other;
+    SetupTestData(data, "ecm.json");
+    SetupTestData(other, "ecm.json");
+    CompareBatch(data, other);
+}
+
+void robManipulatorTest::TestMTMBatch(void)
+{
+    ManipulatorTestDataMTM data, other;
+    SetupTestData(data, "mtmr.json");
+    SetupTestData(other, "mtmr.json");
+    CompareBatch(data, other);
+}
+
+void robManipulatorTest::TestGravityCompensationMTMRegressor(void)
+{
+    const std::string filename = "gc-MTMR-28247.json";
+    cmnPath path;
+    path.Add(std::string(sawIntuitiveResearchKit_SOURCE_DIR) + "/../share/jhu-dVRK", cmnPath::TAIL);
+    const std::string configFile = path.Find(filename);
+    CPPUNIT_ASSERT_MESSAGE("Can't find full path for " + filename,
+                           configFile != std::string(""));
+    std::ifstream jsonStream;
+    Json::Value jsonConfig;
+    Json::Reader jsonReader;
+    jsonStream.open(configFile.c_str());
+    CPPUNIT_ASSERT_MESSAGE("Failed to parse JSON file " + configFile + ": " + jsonReader.getFormattedErrorMessages(),
+                           jsonReader.parse(jsonStream, jsonConfig));
+    auto result = robGravityCompensationMTM::Create(jsonConfig);
+    CPPUNIT_ASSERT_MESSAGE("Failed to create gravity compensation: " + result.ErrorMessage,
+                           result.Pointer);
+    robGravityCompensationMTM * gravity = result.Pointer;
+
+    // sparse regressor skips zeros, same operations as dense so
+    // results should be identical.  Dense only assigns non zero
+    // elements so start with zeros
+    vctDoubleMat dense(robGravityCompensationMTM::MODEL_JOINT_COUNT,
+                       robGravityCompensationMTM::MODEL_PARAMETER_COUNT, 0.0);
+    vctDoubleMat sparse(robGravityCompensationMTM::MODEL_JOINT_COUNT,
+                        robGravityCompensationMTM::MODEL_PARAMETER_COUNT);
+    vctDoubleVec q(7);
+    cmnRandomSequence & randomSequence = cmnRandomSequence::GetInstance();
+    randomSequence.SetSeed(28247);
+    const size_t nbSamples = 1000;
+    for (size_t sample = 0; sample < nbSamples; ++sample) {
+        for (size_t index = 0; index < q.size(); ++index) {
+            randomSequence.ExtractRandomValue<double>(-cmnPI, cmnPI, q[index]);
+        }
+        robGravityCompensationMTM::AssignRegressor(q, dense);
+        gravity->SparseRegressor(q, sparse);
+        for (size_t r = 0; r < dense.rows(); ++r) {
+            for (size_t c = 0; c < dense.cols(); ++c) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("Sparse regressor differs for q = " + q.ToString()
+                                                     + ", element " + std::to_string(r) + ", " + std::to_string(c),
+                                                     dense.Element(r, c), sparse.Element(r, c), 1e-12);
+            }
+        }
+    }
+    delete gravity;
+}
+
+void robManipulatorTest::TestPSMReachabilityMap(void)
+{
+    ManipulatorTestDataPSM data;
+    SetupTestData(data, "psm.json", "LARGE_NEEDLE_DRIVER_400006.json");
+    // base offset similar to a PSM mounted on a SUJ
+    vctFrm4x4 base;
+    base.Rotation().From(vctAxAnRot3(vct3(1.0, 1.0, 0.0).Normalized(), 60.0 * cmnPI_180));
+    base.Translation().Assign(0.1, -0.3, 0.2);
+    data.Manipulator->Rtw0.Assign(base);
+
+    robReachabilityMap map;
+    std::string errorMessage;
+    CPPUNIT_ASSERT_MESSAGE("Failed to build reachability map: " + errorMessage,
+                           map.Build(*(data.Manipulator), 2.0 * cmnPI_180, errorMessage));
+
+    // tool tips computed in the base frame must be reachable
+    vctDoubleVec q(data.NumberOfLinks);
+    cmnRandomSequence & randomSequence = cmnRandomSequence::GetInstance();
+    randomSequence.SetSeed(58);
+    const size_t nbSamples = 1000;
+    for (size_t sample = 0; sample < nbSamples; ++sample) {
+        for (size_t index = 0; index < q.size(); ++index) {
+            randomSequence.ExtractRandomValue<double>(data.LowerLimits[index], data.UpperLimits[index], q[index]);
+        }
+        const vct3 tip = data.Manipulator->ForwardKinematics(q).Translation();
+        CPPUNIT_ASSERT_MESSAGE("Reachable tool tip rejected for q = " + q.ToString(),
+                               map.Reachable(tip));
+    }
+
+    // RCM is at the base offset, positions past the max radius from
+    // the RCM are out of reach even if close to the base origin
+    const double radius = map.RadiusMax() + map.WristReach() + 1.0 * cmn_cm;
+    const vct3 rcm(base.Translation());
+    CPPUNIT_ASSERT(map.Reachable(rcm));
+    vct3 farAway(rcm);
+    farAway.Add(radius * rcm.Normalized());
+    CPPUNIT_ASSERT(!map.Reachable(farAway));
+    vct3 towardOrigin(rcm);
+    towardOrigin.Subtract(radius * rcm.Normalized());
+    CPPUNIT_ASSERT(!map.Reachable(towardOrigin));
+}
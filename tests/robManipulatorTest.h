@@ -22,6 +22,14 @@ http://www.cisst.org/cisst/license.txt.
 #include <cisstVector/vctDynamicVectorTypes.h>
 #include <sawIntuitiveResearchKit/robManipulatorECM.h>
 #include <sawIntuitiveResearchKit/robManipulatorMTM.h>
+#include <sawIntuitiveResearchKit/robManipulatorPSM.h>
+#include <sawIntuitiveResearchKit/robManipulatorPSMSnake.h>
+#include <sawIntuitiveResearchKit/robManipulatorEvaluator.h>
+#include <sawIntuitiveResearchKit/robManipulatorBatch.h>
+#include <sawIntuitiveResearchKit/robWrenchEstimator.h>
+#include <sawIntuitiveResearchKit/robManipulatorFixed.h>
+#include <sawIntuitiveResearchKit/robGravityCompensationMTM.h>
+#include <sawIntuitiveResearchKit/robReachabilityMap.h>
 
 class ManipulatorTestData {
 public:
@@ -47,12 +55,28 @@ protected:
     {
         CPPUNIT_TEST(TestECMIKSampleJointSpace);
         CPPUNIT_TEST(TestMTMIKSampleJointSpace);
+        CPPUNIT_TEST(TestECMEvaluator);
+        CPPUNIT_TEST(TestMTMEvaluator);
+        CPPUNIT_TEST(TestPSMEvaluator);
+        CPPUNIT_TEST(TestPSMSnakeEvaluator);
+        CPPUNIT_TEST(TestCustomEvaluator);
+        CPPUNIT_TEST(TestECMWrenchEstimator);
+        CPPUNIT_TEST(TestMTMWrenchEstimator);
+        CPPUNIT_TEST(TestECMFixed);
+        CPPUNIT_TEST(TestMTMFixed);
+        CPPUNIT_TEST(TestPSMIKSampleJointSpace);
+        CPPUNIT_TEST(TestECMBatch);
+        CPPUNIT_TEST(TestMTMBatch);
+        CPPUNIT_TEST(TestGravityCompensationMTMRegressor);
+        CPPUNIT_TEST(TestPSMReachabilityMap);
     }
     CPPUNIT_TEST_SUITE_END();
 
-    // helper method to load kinematics with some basic tests
+    // helper method to load kinematics with some basic tests, tool
+    // file is optional and used for PSM
     void SetupTestData(ManipulatorTestData & data,
-                       const std::string & filename);
+                       const std::string & filename,
+                       const std::string & toolFilename = "");
 
     void ComputeAndTestIK(ManipulatorTestData & data);
 
@@ -60,6 +84,20 @@ protected:
     // returns joint values as well as forward kinematic
     void TestSampleJointSpace(ManipulatorTestData & data);
 
+    // compare single pass evaluator to robManipulator FK and
+    // jacobians, singlePass is false for manipulators the evaluator
+    // can't handle (i.e. falls back on robManipulator methods)
+    void CompareEvaluator(ManipulatorTestData & data,
+                          const bool singlePass = true);
+
+    // compare damped least squares wrench estimation to SVD
+    void CompareWrenchEstimator(ManipulatorTestData & data);
+
+    // compare batch kinematics to robManipulator, second manipulator
+    // is used for multi-threaded inverse kinematics
+    void CompareBatch(ManipulatorTestData & data,
+                      ManipulatorTestData & other);
+
 public:
 
     void setUp(void) {
@@ -71,6 +109,34 @@ public:
     void TestECMIKSampleJointSpace(void);
 
     void TestMTMIKSampleJointSpace(void);
+
+    void TestECMEvaluator(void);
+
+    void TestMTMEvaluator(void);
+
+    void TestPSMEvaluator(void);
+
+    void TestPSMSnakeEvaluator(void);
+
+    void TestCustomEvaluator(void);
+
+    void TestECMWrenchEstimator(void);
+
+    void TestMTMWrenchEstimator(void);
+
+    void TestECMFixed(void);
+
+    void TestMTMFixed(void);
+
+    void TestPSMIKSampleJointSpace(void);
+
+    void TestECMBatch(void);
+
+    void TestMTMBatch(void);
+
+    void TestGravityCompensationMTMRegressor(void);
+
+    void TestPSMReachabilityMap(void);
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(robManipulatorTest);